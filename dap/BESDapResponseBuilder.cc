@@ -51,7 +51,14 @@
 #include <fstream>
 
 #include <cstring>
+#include <cstdlib>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
 
 //#define DODS_DEBUG
 #define CLEAR_LOCAL_DATA
@@ -123,6 +130,8 @@ using namespace libdap;
 
 const string CRLF = "\r\n";             // Change here, expr-test.cc
 const string BES_KEY_TIMEOUT_CANCEL = "BES.CancelTimeoutOnSend";
+const string DAP_KEY_READ_THREADS = "DAP.ParallelRead.Threads";
+const string DAP_KEY_READ_HANDLERS = "DAP.ParallelRead.Handlers";
 
 #define MODULE "dap"
 #define prolog std::string("BESDapResponseBuilder::").append(__func__).append("() - ")
@@ -142,6 +151,11 @@ void BESDapResponseBuilder::initialize()
         if (cancel_timeout_on_send == "yes" || cancel_timeout_on_send == "true")
             d_cancel_timeout_on_send = true;
     }
+
+    int threads = TheBESKeys::TheKeys()->read_int_key(DAP_KEY_READ_THREADS, 1);
+    if (threads > 1) d_read_threads = threads;
+
+    TheBESKeys::TheKeys()->get_values(DAP_KEY_READ_HANDLERS, d_parallel_read_handlers, found);
 }
 
 BESDapResponseBuilder::~BESDapResponseBuilder()
@@ -1068,17 +1082,21 @@ BESDapResponseBuilder::intern_dap2_data(BESResponseObject *obj, BESDataHandlerIn
 
     // Iterate through the variables in the DataDDS and read
     // in the data if the variable has the send flag set.
+    vector<BaseType*> vars;
     for (DDS::Vars_iter i = dds->var_begin(), e = dds->var_end(); i != e; ++i) {
-        if ((*i)->send_p()) {
-            try {
-                (*i)->intern_data(eval, *dds);
-            }
-            catch(std::exception &e) {
-                throw BESSyntaxUserError(string("Caught a C++ standard exception while working on '") + (*i)->name() + "' The error was: " + e.what(), __FILE__, __LINE__);
-            }
-        }
+        if ((*i)->send_p())
+            vars.push_back(*i);
     }
 
+    intern_vars(vars, dhi.container ? dhi.container->get_container_type() : "", [&eval, dds](BaseType *var) {
+        try {
+            var->intern_data(eval, *dds);
+        }
+        catch(std::exception &e) {
+            throw BESSyntaxUserError(string("Caught a C++ standard exception while working on '") + var->name() + "' The error was: " + e.what(), __FILE__, __LINE__);
+        }
+    });
+
     BESDEBUG(MODULE, prolog << "END"<< endl);
 
     return dds;
@@ -1723,6 +1741,7 @@ BESDapResponseBuilder::intern_dap4_data(BESResponseObject *obj, BESDataHandlerIn
     // in the data if the variable has the send flag set.
     //D4Group* root_grp = dmr->root();
     
+    vector<BaseType*> vars;
     for (D4Group::Vars_iter i = root_grp->var_begin(), e = root_grp->var_end(); i != e; ++i) {
         BESDEBUG("dap", "BESDapResponseBuilder::intern_dap4_data() - "<< (*i)->name() <<endl);
         if ((*i)->send_p()) {
@@ -1735,10 +1754,12 @@ BESDapResponseBuilder::intern_dap4_data(BESResponseObject *obj, BESDataHandlerIn
                          BESDEBUG("dap", "BESDapResponseBuilder::intern_dap4_data() attribute name is "<<name <<endl);
              }
 #endif
-            (*i)->intern_data();
+            vars.push_back(*i);
         }
     }
 
+    intern_vars(vars, dhi.container ? dhi.container->get_container_type() : "", [](BaseType *var) { var->intern_data(); });
+
     for (D4Group::groupsIter gi = root_grp->grp_begin(), ge = root_grp->grp_end(); gi != ge; ++gi) {
         BESDEBUG("dap", "BESDapResponseBuilder::intern_dap4_data() root group- "<< (*gi)->name() <<endl);
         intern_dap4_data_grp(*gi);
@@ -1748,6 +1769,77 @@ BESDapResponseBuilder::intern_dap4_data(BESResponseObject *obj, BESDataHandlerIn
     return dmr;
 }
 
+/**
+ * @brief Read the values of variables
+ *
+ * The variables are read one after the other unless the container's handler
+ * is listed in DAP.ParallelRead.Handlers, in which case up to
+ * DAP.ParallelRead.Threads of them are read at once. Most of the time spent
+ * reading from remote (e.g., DMR++) data is waiting for the network, so
+ * reading several variables at once takes about as long as reading the
+ * slowest one. Only list handlers whose read() methods are thread safe.
+ *
+ * If any read fails, the first error is rethrown once the reads underway
+ * have finished.
+ *
+ * @param vars Read these variables
+ * @param container_type The type (handler name) of the container
+ * @param read Read one variable
+ */
+void BESDapResponseBuilder::intern_vars(const vector<BaseType*> &vars, const string &container_type,
+    const std::function<void(BaseType*)> &read)
+{
+    unsigned int threads = min(d_read_threads, (unsigned int) vars.size());
+    if (threads > 1
+        && find(d_parallel_read_handlers.begin(), d_parallel_read_handlers.end(), container_type)
+            == d_parallel_read_handlers.end())
+        threads = 1;
+
+    if (threads <= 1) {
+        for (vector<BaseType*>::const_iterator i = vars.begin(), e = vars.end(); i != e; ++i)
+            read(*i);
+        return;
+    }
+
+    BESDEBUG(MODULE, prolog << "Reading " << vars.size() << " variables, " << threads << " at a time" << endl);
+
+    std::atomic<size_t> next(0);
+    std::mutex error_lock;
+    std::exception_ptr error;
+
+    auto reader = [&]() {
+        size_t i;
+        while ((i = next++) < vars.size()) {
+            try {
+                read(vars[i]);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (!error) error = std::current_exception();
+                next = vars.size();     // start no more reads
+            }
+        }
+    };
+
+    // This thread is one of the readers
+    vector<std::thread> readers;
+    try {
+        for (unsigned int t = 1; t < threads; ++t)
+            readers.push_back(std::thread(reader));
+    }
+    catch (std::system_error &e) {
+        ERROR_LOG(prolog << "Could not start a thread to read data: " << e.what() << endl);
+    }
+
+    reader();
+
+    for (vector<std::thread>::iterator t = readers.begin(), e = readers.end(); t != e; ++t)
+        t->join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
 void BESDapResponseBuilder::intern_dap4_data_grp(libdap::D4Group* grp) {
     for (D4Group::Vars_iter i = grp->var_begin(), e = grp->var_end(); i != e; ++i) {
         BESDEBUG("dap", "BESDapResponseBuilder::intern_dap4_data() - "<< (*i)->name() <<endl);
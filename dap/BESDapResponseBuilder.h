@@ -26,6 +26,8 @@
 #define _response_builder_h
 
 #include <string>
+#include <vector>
+#include <functional>
 //#include <D4Group.h>
 
 #define DAP_PROTOCOL_VERSION "3.2"
@@ -38,6 +40,7 @@ class BESResponseObject;
 class BRDRequestHandler;
 
 namespace libdap {
+    class BaseType;
     class ConstraintEvaluator;
     class DDS;
     class DAS;
@@ -66,6 +69,9 @@ protected:
 
 	bool d_cancel_timeout_on_send;  /// Should a timeout be cancelled once transmission starts?
 
+	unsigned int d_read_threads;    /// Read up to this many variables at once
+	std::vector<std::string> d_parallel_read_handlers; /// ... for these handlers
+
 	/**
 	 * Time, if any, that the client will wait for an async response.
 	 * An empty string (length=0) means the client didn't supply an async parameter
@@ -88,6 +94,8 @@ protected:
 
 	void send_dap4_data_using_ce(std::ostream &out, libdap::DMR &dmr, bool with_mime_headersr);
     void intern_dap4_data_grp(libdap::D4Group* grp);
+    void intern_vars(const std::vector<libdap::BaseType*> &vars, const std::string &container_type,
+        const std::function<void(libdap::BaseType*)> &read);
 
 public:
 
@@ -96,7 +104,7 @@ public:
 	 version information. */
 	BESDapResponseBuilder(): d_dataset(""), d_dap2ce(""), d_dap4ce(""), d_dap4function(""),
 	    d_btp_func_ce(""), d_timeout(0), d_default_protocol(DAP_PROTOCOL_VERSION),
-	    d_cancel_timeout_on_send(false), d_async_accepted(""), d_store_result("")
+	    d_cancel_timeout_on_send(false), d_read_threads(1), d_async_accepted(""), d_store_result("")
 	{
 		initialize();
 	}
@@ -61,7 +61,9 @@
 
 #include "BESInternalError.h"
 #include "BESInternalFatalError.h"
+#include "BESMetrics.h"
 
+#include "SharedMetadataCache.h"
 #include "GlobalMetadataStore.h"
 
 #define DEBUG_KEY "metadata_store"
@@ -105,10 +107,9 @@ GlobalMetadataStore *GlobalMetadataStore::d_instance = 0;
 bool GlobalMetadataStore::d_enabled = true;
 
 /**
- * Hacked from GNU wc (in coreutils). This was found to be
- * faster than a memory mapped file read.
- *
- * https://stackoverflow.com/questions/17925051/fast-textfile-reading-in-c
+ * Write a response held in the store to a stream. The bytes are copied
+ * with BESUtil::file_to_stream(), which sends them straight from the file
+ * to the socket when the stream writes to the front end.
  *
  * @note This is a static method so the function will be scoped with this
  * class.
@@ -120,8 +121,6 @@ bool GlobalMetadataStore::d_enabled = true;
  */
 void GlobalMetadataStore::transfer_bytes(int fd, ostream &os)
 {
-    static const int BUFFER_SIZE = 16*1024;
-
 #if _POSIX_C_SOURCE >= 200112L
     /* Advise the kernel of our access pattern.  */
     int status = posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
@@ -129,16 +128,14 @@ void GlobalMetadataStore::transfer_bytes(int fd, ostream &os)
         ERROR_LOG(prolog << "Error calling posix_advise() in the GlobalMetadataStore: " << strerror(status) << endl);
 #endif
 
-    char buf[BUFFER_SIZE + 1];
-
-    while(int bytes_read = read(fd, buf, BUFFER_SIZE))
-    {
-        if(bytes_read == -1)
-            throw BESInternalError("Could not read dds from the metadata store.", __FILE__, __LINE__);
-        if (!bytes_read)
-            break;
-
-        os.write(buf, bytes_read);
+    // When 'os' writes to the PPT connection, the response is sent from the
+    // file to the socket without being copied through the stream.
+    try {
+        BESUtil::file_to_stream(fd, os);
+    }
+    catch (BESInternalError &e) {
+        throw BESInternalError("Could not transfer the response from the metadata store: " + e.get_message(),
+            __FILE__, __LINE__);
     }
 }
 
@@ -228,6 +225,45 @@ void GlobalMetadataStore::insert_xml_base(int fd, ostream &os, const string &xml
     transfer_bytes(fd, os);
 }
 
+/**
+ * @brief like insert_xml_base(int, ostream &, const string &), for a response
+ * held in memory
+ *
+ * @param response The DMR or DMR++ response
+ * @param os Write to this C++ stream
+ * @param xml_base Value of the xml:base attribute.
+ */
+void GlobalMetadataStore::insert_xml_base(const string &response, ostream &os, const string &xml_base)
+{
+    // transfer the prolog (<?xml version="1.0" encoding="ISO‌-8859-1"?>)
+    string::size_type dataset = response.find('>');
+    if (dataset == string::npos) {
+        os << response;
+        return;
+    }
+    ++dataset;
+    os.write(response.data(), dataset);
+
+    string::size_type dataset_end = response.find('>', dataset);
+    string::size_type attr = response.find("xml:base", dataset);
+    // the old value, '="..."'
+    string::size_type value_start = attr == string::npos ? string::npos : response.find('"', attr);
+    string::size_type value_end = value_start == string::npos ? string::npos : response.find('"', value_start + 1);
+    if (attr < dataset_end && value_end != string::npos) {
+        os.write(response.data() + dataset, attr + 8 - dataset);
+        os << "=\"" << xml_base << "\"";
+        os.write(response.data() + value_end + 1, response.size() - value_end - 1);
+    }
+    else if (dataset_end != string::npos) {
+        os.write(response.data() + dataset, dataset_end - dataset);
+        os << " xml:base=\"" << xml_base << "\"";
+        os.write(response.data() + dataset_end, response.size() - dataset_end);
+    }
+    else {
+        os.write(response.data() + dataset, response.size() - dataset);
+    }
+}
+
 unsigned long GlobalMetadataStore::get_cache_size_from_config()
 {
     bool found;
@@ -743,10 +779,18 @@ GlobalMetadataStore::get_read_lock_helper(const string &name, const string &suff
     MDSReadLock lock(item_name, get_read_lock(item_name, fd), this);
     BESDEBUG(DEBUG_KEY, __func__ << "() MDS lock for " << item_name << ": " << lock() <<  endl);
 
-    if (lock())
+    static BESMetric mds_hits(BESMetrics::counter, METRICS_CACHE_HITS, "Cache lookups that were hits", "cache=\"mds\"");
+    static BESMetric mds_misses(BESMetrics::counter, METRICS_CACHE_MISSES, "Cache lookups that were misses",
+        "cache=\"mds\"");
+
+    if (lock()) {
         INFO_LOG(prolog << "MDS Cache hit for '" << name << "' and response " << object_name << endl);
-    else
+        mds_hits.add();
+    }
+    else {
         INFO_LOG(prolog << "MDS Cache miss for '" << name << "' and response " << object_name << endl);
+        mds_misses.add();
+    }
 
     return lock;
  }
@@ -1008,6 +1052,76 @@ GlobalMetadataStore::get_cache_lmt(const string &fileName, const string &suffix)
 	return statbuf.st_mtime;
 }//end get_cache_lmt()
 
+/**
+ * The key for a MDS item in the SharedMetadataCache. This includes the inode,
+ * size and modification time of the item so that a replaced item is never
+ * found.
+ */
+static string shared_key(const string &item_name, const struct stat &buf)
+{
+    ostringstream oss;
+    oss << "mds:" << item_name << ':' << buf.st_ino << ':' << buf.st_size << ':' << buf.st_mtime;
+    return oss.str();
+}
+
+/**
+ * @brief Get a response using the SharedMetadataCache
+ *
+ * If the response is in the shared cache, the store is not read. If it is
+ * not, the response is read from the store (with a read lock) and added to
+ * the shared cache.
+ *
+ * @param name Granule name
+ * @param suffix One of 'dds_r', 'das_r', 'dmr_r' or 'dmrpp_r'
+ * @param object_name One of DDS, DAS, DMR or DMR++; used for logging.
+ * @param response Value-result parameter; the response
+ * @return False if the shared cache is not configured, the response is too
+ * large for it or the response is not in the store. The caller should read
+ * the store as usual.
+ */
+bool
+GlobalMetadataStore::get_shared_response(const string &name, const string &suffix, const string &object_name,
+    string &response)
+{
+    SharedMetadataCache *shared = SharedMetadataCache::get_instance();
+    if (!shared)
+        return false;
+
+    string item_name = get_cache_file_name(get_hash(name + suffix), false);
+    struct stat buf;
+    if (stat(item_name.c_str(), &buf) == -1 || (unsigned long long) buf.st_size > shared->get_max_record_size())
+        return false;
+
+    if (shared->get(shared_key(item_name, buf), response)) {
+        VERBOSE("Metadata store: Shared cache hit: read " << object_name << " response for '" << name << "'." << endl);
+        return true;
+    }
+
+    int fd; // value-result parameter;
+    if (!get_read_lock(item_name, fd))
+        return false;
+
+    try {
+        // The item might have been replaced since the call to stat()
+        if (fstat(fd, &buf) == -1)
+            throw BESInternalError("Could not stat '" + item_name + "' in the metadata store.", __FILE__, __LINE__);
+
+        ostringstream oss;
+        transfer_bytes(fd, oss);
+        response = oss.str();
+        unlock_and_close(item_name); // closes fd
+    }
+    catch (...) {
+        unlock_and_close(item_name);
+        throw;
+    }
+
+    VERBOSE("Metadata store: Cache hit: read " << object_name << " response for '" << name << "'." << endl);
+    shared->put(shared_key(item_name, buf), response);
+
+    return true;
+}
+
 ///@name write_response_helper
 ///@{
 /**
@@ -1021,6 +1135,12 @@ GlobalMetadataStore::get_cache_lmt(const string &fileName, const string &suffix)
 void
 GlobalMetadataStore::write_response_helper(const string &name, ostream &os, const string &suffix, const string &object_name)
 {
+    string response;
+    if (get_shared_response(name, suffix, object_name, response)) {
+        os.write(response.data(), response.size());
+        return;
+    }
+
     string item_name = get_cache_file_name(get_hash(name + suffix), false);
     int fd; // value-result parameter;
     if (get_read_lock(item_name, fd)) {
@@ -1052,6 +1172,12 @@ void
 GlobalMetadataStore::write_response_helper(const string &name, ostream &os, const string &suffix, const string &xml_base,
     const string &object_name)
 {
+    string response;
+    if (get_shared_response(name, suffix, object_name, response)) {
+        insert_xml_base(response, os, xml_base);
+        return;
+    }
+
     string item_name = get_cache_file_name(get_hash(name + suffix), false);
     int fd; // value-result parameter;
     if (get_read_lock(item_name, fd)) {
@@ -1155,7 +1281,14 @@ bool
 GlobalMetadataStore::remove_response_helper(const string& name, const string &suffix, const string &object_name)
 {
     string hash = get_hash(name + suffix);
-    if (unlink(get_cache_file_name(hash, false).c_str()) == 0) {
+    string item_name = get_cache_file_name(hash, false);
+
+    SharedMetadataCache *shared = SharedMetadataCache::get_instance();
+    struct stat buf;
+    if (shared && stat(item_name.c_str(), &buf) == 0)
+        shared->remove(shared_key(item_name, buf));
+
+    if (unlink(item_name.c_str()) == 0) {
         VERBOSE("Metadata store: Removed " << object_name << " response for '" << hash << "'." << endl);
         d_ledger_entry.append(" ").append(hash);
         return true;
@@ -76,6 +76,10 @@ namespace bes {
  * - _BES.LogTimeLocal_: Use local or GMT time for the ledger entries; default is
  *   to use GMT
  *
+ * If the SharedMetadataCache is configured, responses read from the store are
+ * also held there so that the beslistener processes share them and most
+ * requests for a response do not touch the disk.
+ *
  * @note To change the xml:base attribute in the DMR response use
  * `DMR::set_request_xml_base()`.
  *
@@ -168,6 +172,9 @@ protected:
 
     bool store_dap_response(StreamDAP &writer, const std::string &key, const std::string &name, const std::string &response_name);
 
+    bool get_shared_response(const std::string &name, const std::string &suffix, const std::string &object_name,
+        std::string &response);
+
     void write_response_helper(const std::string &name, std::ostream &os, const std::string &suffix,
         const std::string &object_name);
 
@@ -179,6 +186,7 @@ protected:
 
     static void transfer_bytes(int fd, std::ostream &os);
     static void insert_xml_base(int fd, std::ostream &os, const std::string &xml_base);
+    static void insert_xml_base(const std::string &response, std::ostream &os, const std::string &xml_base);
 
 public:
     /**
@@ -34,10 +34,16 @@
 #include <DapObj.h>
 #include <InternalErr.h>
 
+#include "BESMetrics.h"
+
 #include "ObjMemCache.h"
 
 // using namespace bes {
 
+static BESMetric objmem_hits(BESMetrics::counter, METRICS_CACHE_HITS, "Cache lookups that were hits", "cache=\"objmem\"");
+static BESMetric objmem_misses(BESMetrics::counter, METRICS_CACHE_MISSES, "Cache lookups that were misses",
+    "cache=\"objmem\"");
+
 using namespace std;
 using namespace libdap;
 
@@ -135,6 +141,11 @@ DapObj *ObjMemCache::get(const string &key)
         index.insert(index_pair_t(key, d_age));
     }
 
+    if (cached_obj)
+        objmem_hits.add();
+    else
+        objmem_misses.add();
+
     return cached_obj;
 }
 
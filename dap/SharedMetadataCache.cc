@@ -0,0 +1,647 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "TheBESKeys.h"
+#include "BESLog.h"
+#include "BESDebug.h"
+#include "BESError.h"
+#include "BESInternalError.h"
+
+#include "SharedMetadataCache.h"
+
+#define DEBUG_KEY "shared_cache"
+
+#ifdef HAVE_ATEXIT
+#define AT_EXIT(x) atexit((x))
+#else
+#define AT_EXIT(x)
+#endif
+
+#define prolog std::string("SharedMetadataCache::").append(__func__).append("() - ")
+
+using namespace std;
+
+namespace bes {
+
+// The index and header live in memory shared by several processes, so the
+// atomics must not fall back on a (per process) lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "SharedMetadataCache needs lock-free 64-bit atomics");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "SharedMetadataCache needs lock-free 32-bit atomics");
+
+static const string PATH_KEY = "DAP.SharedMetadataCache.path";
+static const string SIZE_KEY = "DAP.SharedMetadataCache.size";
+static const string ENTRIES_KEY = "DAP.SharedMetadataCache.entries";
+
+static const uint64_t default_cache_size = 64;      // MB
+static const uint64_t default_cache_entries = 16384;
+
+static const char magic[8] = "BESSMC1";
+static const uint32_t layout_version = 2;  // 2: records start on word boundaries
+
+// Slot hash values; the hash of a key is never one of these
+static const uint64_t EMPTY = 0;
+static const uint64_t TOMBSTONE = 1;
+
+static const uint64_t max_probe = 32;
+static const int max_read_attempts = 8;
+static const uint64_t no_slot = numeric_limits<uint64_t>::max();
+
+// The arena is accessed in words of this size; records start on a word boundary
+typedef std::atomic<uint64_t> arena_word;
+static const uint64_t word_size = sizeof(uint64_t);
+
+struct SharedMetadataCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t slot_count;
+    uint64_t arena_size;
+
+    std::atomic<uint64_t> head;     // Where the next record will be written
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> inserts;
+    std::atomic<uint64_t> evictions;
+};
+
+struct SharedMetadataCache::Slot {
+    std::atomic<uint64_t> seq;      // Odd while a writer changes the slot or its record
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> offset;   // of the record in the arena; the key then the value
+    std::atomic<uint32_t> key_length;
+    std::atomic<uint32_t> value_length;
+    std::atomic<uint64_t> last_used;    // seconds; approximate LRU for evictions
+};
+
+static uint64_t round_up(uint64_t n, uint64_t m)
+{
+    return (n + m - 1) / m * m;
+}
+
+uint64_t SharedMetadataCache::header_bytes()
+{
+    return round_up(sizeof(Header), 64);
+}
+
+SharedMetadataCache *SharedMetadataCache::d_instance = 0;
+bool SharedMetadataCache::d_enabled = true;
+
+/**
+ * @brief Get the SharedMetadataCache using the given parameters
+ *
+ * This class is a singleton. The first call to either of the get_instance()
+ * methods makes the instance; subsequent calls return it.
+ *
+ * @param path The file to map. If this is the empty string, the cache is
+ * disabled.
+ * @param arena_size Bytes of space for records
+ * @param entries Number of slots in the index; rounded up to a power of two
+ * @return A pointer to the cache or null if the cache is disabled or could
+ * not be built.
+ */
+SharedMetadataCache *
+SharedMetadataCache::get_instance(const string &path, uint64_t arena_size, uint64_t entries)
+{
+    if (d_enabled && d_instance == 0) {
+        if (path.empty()) {
+            d_enabled = false;
+        }
+        else {
+            try {
+                d_instance = new SharedMetadataCache(path, arena_size, entries);
+                AT_EXIT(delete_instance);
+            }
+            catch (BESError &e) {
+                // A broken cache should not break the requests that use it
+                ERROR_LOG(prolog << "Could not build the shared metadata cache: " << e.get_message() << endl);
+                d_enabled = false;
+            }
+        }
+    }
+
+    BESDEBUG(DEBUG_KEY, prolog << "d_instance: " << (void *) d_instance << endl);
+
+    return d_instance;
+}
+
+/**
+ * @brief Get the SharedMetadataCache using the values in the BES keys
+ * @return A pointer to the cache or null if the cache is disabled.
+ * @see get_instance(const string &, uint64_t, uint64_t)
+ */
+SharedMetadataCache *
+SharedMetadataCache::get_instance()
+{
+    if (d_enabled && d_instance == 0) {
+        bool found;
+        string path;
+        TheBESKeys::TheKeys()->get_value(PATH_KEY, path, found);
+
+        uint64_t size = default_cache_size;
+        string value;
+        TheBESKeys::TheKeys()->get_value(SIZE_KEY, value, found);
+        if (found) {
+            istringstream iss(value);
+            iss >> size;
+        }
+
+        uint64_t entries = default_cache_entries;
+        TheBESKeys::TheKeys()->get_value(ENTRIES_KEY, value, found);
+        if (found) {
+            istringstream iss(value);
+            iss >> entries;
+        }
+
+        if (!path.empty())
+            INFO_LOG(prolog << "Shared metadata cache: " << path << ", " << size << "MB, " << entries << " entries" << endl);
+
+        return get_instance(path, size * 1024 * 1024, entries);
+    }
+
+    return d_instance;
+}
+
+/**
+ * @brief Map the cache file, making and formatting it if needed
+ * @param path The file to map
+ * @param arena_size Bytes of space for records
+ * @param entries Number of slots in the index; rounded up to a power of two
+ * @exception BESInternalError if the file cannot be opened, sized or mapped
+ */
+SharedMetadataCache::SharedMetadataCache(const string &path, uint64_t arena_size, uint64_t entries) :
+    d_fd(-1), d_path(path), d_map(0), d_map_size(0), d_header(0), d_slots(0), d_arena(0), d_slot_mask(0),
+    d_arena_size(0)
+{
+    if (arena_size == 0 || entries == 0)
+        throw BESInternalError("The shared metadata cache size and number of entries must not be zero.", __FILE__,
+                               __LINE__);
+
+    uint64_t slot_count = 1;
+    while (slot_count < entries)
+        slot_count <<= 1;
+
+    d_fd = open(path.c_str(), O_RDWR | O_CREAT, 0660);
+    if (d_fd == -1)
+        throw BESInternalError("Could not open the shared metadata cache '" + path + "': " + strerror(errno),
+                               __FILE__, __LINE__);
+
+    try {
+        map_file(round_up(arena_size, 64), slot_count);
+    }
+    catch (...) {
+        if (d_map) munmap(d_map, d_map_size);
+        close(d_fd);
+        throw;
+    }
+}
+
+SharedMetadataCache::~SharedMetadataCache()
+{
+    if (d_map) munmap(d_map, d_map_size);
+    if (d_fd != -1) close(d_fd);
+}
+
+void SharedMetadataCache::map_file(uint64_t arena_size, uint64_t slot_count)
+{
+    uint64_t arena_offset = round_up(header_bytes() + slot_count * sizeof(Slot), 64);
+    d_map_size = arena_offset + arena_size;
+
+    lock_file();
+    try {
+        struct stat buf;
+        if (fstat(d_fd, &buf) == -1)
+            throw BESInternalError("Could not stat the shared metadata cache: " + string(strerror(errno)), __FILE__,
+                                   __LINE__);
+
+        if ((uint64_t) buf.st_size != d_map_size && ftruncate(d_fd, d_map_size) == -1)
+            throw BESInternalError("Could not size the shared metadata cache: " + string(strerror(errno)), __FILE__,
+                                   __LINE__);
+
+        void *map = mmap(0, d_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, d_fd, 0);
+        if (map == MAP_FAILED)
+            throw BESInternalError("Could not map the shared metadata cache: " + string(strerror(errno)), __FILE__,
+                                   __LINE__);
+
+        d_map = static_cast<char *>(map);
+        d_header = reinterpret_cast<Header *>(d_map);
+        d_slots = reinterpret_cast<Slot *>(d_map + header_bytes());
+        d_arena = d_map + arena_offset;
+        d_slot_mask = slot_count - 1;
+        d_arena_size = arena_size;
+
+        if (memcmp(d_header->magic, magic, sizeof(magic)) != 0 || d_header->version != layout_version
+            || d_header->header_size != header_bytes() || d_header->slot_count != slot_count
+            || d_header->arena_size != arena_size) {
+            format();
+        }
+    }
+    catch (...) {
+        unlock_file();
+        throw;
+    }
+    unlock_file();
+}
+
+/**
+ * Clear the header and index. Called with the file locked.
+ */
+void SharedMetadataCache::format()
+{
+    INFO_LOG(prolog << "Initializing the shared metadata cache " << d_path << endl);
+
+    memset(d_map, 0, header_bytes() + (d_slot_mask + 1) * sizeof(Slot));
+
+    d_header->version = layout_version;
+    d_header->header_size = header_bytes();
+    d_header->slot_count = d_slot_mask + 1;
+    d_header->arena_size = d_arena_size;
+    memcpy(d_header->magic, magic, sizeof(magic));
+
+    msync(d_map, header_bytes(), MS_SYNC);
+}
+
+void SharedMetadataCache::lock_file()
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    while (fcntl(d_fd, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR)
+            throw BESInternalError("Could not lock the shared metadata cache: " + string(strerror(errno)), __FILE__,
+                                   __LINE__);
+    }
+}
+
+void SharedMetadataCache::unlock_file()
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+
+    fcntl(d_fd, F_SETLK, &lock);
+}
+
+/// FNV-1a, moved out of the range used to mark empty and retired slots
+uint64_t SharedMetadataCache::hash(const string &key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (string::const_iterator i = key.begin(), e = key.end(); i != e; ++i) {
+        h ^= static_cast<unsigned char>(*i);
+        h *= 1099511628211ULL;
+    }
+
+    return h <= TOMBSTONE ? h + 2 : h;
+}
+
+/**
+ * Find the slot that holds \arg key. Only writers call this, with the
+ * locks held, so the slots cannot change underneath it.
+ * @return The slot index or no_slot
+ */
+uint64_t SharedMetadataCache::find_slot(const string &key, uint64_t h)
+{
+    for (uint64_t i = 0; i < max_probe; ++i) {
+        uint64_t index = (h + i) & d_slot_mask;
+        Slot &slot = d_slots[index];
+        uint64_t slot_hash = slot.hash.load(memory_order_relaxed);
+        if (slot_hash == EMPTY)
+            return no_slot;
+
+        if (slot_hash == h && slot.key_length.load(memory_order_relaxed) == key.size()
+            && memcmp(d_arena + slot.offset.load(memory_order_relaxed), key.data(), key.size()) == 0)
+            return index;
+    }
+
+    return no_slot;
+}
+
+/**
+ * Remove a slot from the index. Readers that started to use the slot before
+ * this will see the change in its sequence number and discard what they read.
+ * If the next slot is empty, no probe sequence continues past this one and
+ * it can be marked empty instead of retired.
+ */
+void SharedMetadataCache::retire(uint64_t index)
+{
+    Slot &slot = d_slots[index];
+    uint64_t seq = slot.seq.load(memory_order_relaxed);
+    slot.seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    bool next_is_empty = d_slots[(index + 1) & d_slot_mask].hash.load(memory_order_relaxed) == EMPTY;
+    slot.hash.store(next_is_empty ? EMPTY : TOMBSTONE, memory_order_relaxed);
+
+    slot.seq.store(seq + 2, memory_order_release);
+}
+
+/// Retire every entry whose record overlaps [offset, offset + length) in the arena
+void SharedMetadataCache::retire_overlapping(uint64_t offset, uint64_t length)
+{
+    for (uint64_t index = 0; index <= d_slot_mask; ++index) {
+        Slot &slot = d_slots[index];
+        if (slot.hash.load(memory_order_relaxed) <= TOMBSTONE)
+            continue;
+
+        uint64_t start = slot.offset.load(memory_order_relaxed);
+        uint64_t end = start + slot.key_length.load(memory_order_relaxed) + slot.value_length.load(memory_order_relaxed);
+        if (start < offset + length && offset < end)
+            retire(index);
+    }
+}
+
+/**
+ * Copy part of the arena. Each word is loaded with a relaxed atomic load, so
+ * a concurrent write is not a data race; the caller uses the slot's sequence
+ * number to find out whether what it copied is valid.
+ */
+void SharedMetadataCache::read_arena(uint64_t offset, char *dest, uint64_t length) const
+{
+    const arena_word *words = reinterpret_cast<const arena_word *>(d_arena);
+    while (length > 0) {
+        uint64_t skip = offset % word_size;
+        uint64_t bytes = min(word_size - skip, length);
+        uint64_t word = words[offset / word_size].load(memory_order_relaxed);
+        memcpy(dest, reinterpret_cast<const char *>(&word) + skip, bytes);
+        dest += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+}
+
+/// Compare \arg s with the arena at \arg offset, reading it as read_arena() does
+bool SharedMetadataCache::arena_equals(uint64_t offset, const string &s) const
+{
+    const arena_word *words = reinterpret_cast<const arena_word *>(d_arena);
+    const char *src = s.data();
+    uint64_t length = s.size();
+    while (length > 0) {
+        uint64_t skip = offset % word_size;
+        uint64_t bytes = min(word_size - skip, length);
+        uint64_t word = words[offset / word_size].load(memory_order_relaxed);
+        if (memcmp(src, reinterpret_cast<const char *>(&word) + skip, bytes) != 0)
+            return false;
+        src += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+
+    return true;
+}
+
+/**
+ * Write part of the arena using relaxed atomic stores. Called with the locks
+ * held. A partial word is read, changed and written back; only the record
+ * being written uses the rest of that word.
+ */
+void SharedMetadataCache::write_arena(uint64_t offset, const char *src, uint64_t length)
+{
+    arena_word *words = reinterpret_cast<arena_word *>(d_arena);
+    while (length > 0) {
+        uint64_t skip = offset % word_size;
+        uint64_t bytes = min(word_size - skip, length);
+        arena_word &w = words[offset / word_size];
+        uint64_t word = bytes == word_size ? 0 : w.load(memory_order_relaxed);
+        memcpy(reinterpret_cast<char *>(&word) + skip, src, bytes);
+        w.store(word, memory_order_relaxed);
+        src += bytes;
+        offset += bytes;
+        length -= bytes;
+    }
+}
+
+/**
+ * @brief Look up a key
+ *
+ * This does not lock. The key is compared with the record in the arena and
+ * the value copied out, then the slot's sequence number is checked; if a
+ * writer changed the slot or reused the space in the meantime, the copy is
+ * discarded and the read is retried.
+ *
+ * @param key The key
+ * @param value Value-result parameter; set to the cached value on a hit
+ * @return True if the key was found, false otherwise
+ */
+bool SharedMetadataCache::get(const string &key, string &value)
+{
+    if (key.empty())
+        return false;
+
+    uint64_t h = hash(key);
+
+    for (uint64_t i = 0; i < max_probe; ++i) {
+        Slot &slot = d_slots[(h + i) & d_slot_mask];
+
+        for (int attempt = 0; attempt < max_read_attempts; ++attempt) {
+            uint64_t seq = slot.seq.load(memory_order_acquire);
+            if (seq & 1)
+                continue;   // a writer has the slot
+
+            uint64_t slot_hash = slot.hash.load(memory_order_relaxed);
+            if (slot_hash == EMPTY) {
+                d_header->misses.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+
+            if (slot_hash != h)
+                break;
+
+            uint64_t offset = slot.offset.load(memory_order_relaxed);
+            uint64_t key_length = slot.key_length.load(memory_order_relaxed);
+            uint64_t value_length = slot.value_length.load(memory_order_relaxed);
+            if (key_length != key.size() || offset + key_length + value_length > d_arena_size) {
+                if (slot.seq.load(memory_order_acquire) == seq)
+                    break;  // A different key with the same hash
+                continue;
+            }
+
+            bool same_key = arena_equals(offset, key);
+            if (same_key) {
+                value.resize(value_length);
+                if (value_length > 0) read_arena(offset + key_length, &value[0], value_length);
+            }
+
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.seq.load(memory_order_relaxed) != seq)
+                continue;
+
+            if (!same_key)
+                break;
+
+            uint64_t now = time(0);
+            if (slot.last_used.load(memory_order_relaxed) != now)
+                slot.last_used.store(now, memory_order_relaxed);
+
+            d_header->hits.fetch_add(1, memory_order_relaxed);
+
+            BESDEBUG(DEBUG_KEY, prolog << "Hit for '" << key << "' (" << value.size() << " bytes)" << endl);
+            return true;
+        }
+    }
+
+    d_header->misses.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+/**
+ * @brief Add or replace a value
+ *
+ * The record is written at the head of the arena; any entries whose records
+ * it overwrites are removed first. If the key's probe window has no free
+ * slot, the entry in that window that was used least recently is evicted.
+ *
+ * @param key The key
+ * @param value The value
+ * @return True if the value was cached, false if it is too large
+ * @exception BESInternalError if the cache file cannot be locked
+ */
+bool SharedMetadataCache::put(const string &key, const string &value)
+{
+    uint64_t record_size = key.size() + value.size();
+    if (key.empty() || record_size > get_max_record_size() || value.size() > numeric_limits<uint32_t>::max())
+        return false;
+
+    uint64_t h = hash(key);
+
+    std::lock_guard<std::mutex> lock(d_write_mutex);
+    lock_file();
+
+    uint64_t old = find_slot(key, h);
+    if (old != no_slot)
+        retire(old);
+
+    uint64_t span = round_up(record_size, word_size);
+    uint64_t offset = d_header->head.load(memory_order_relaxed);
+    if (offset + span > d_arena_size)
+        offset = 0;
+
+    retire_overlapping(offset, span);
+
+    uint64_t target = no_slot;
+    uint64_t oldest = no_slot;
+    uint64_t oldest_time = numeric_limits<uint64_t>::max();
+    for (uint64_t i = 0; i < max_probe; ++i) {
+        uint64_t index = (h + i) & d_slot_mask;
+        uint64_t slot_hash = d_slots[index].hash.load(memory_order_relaxed);
+        if (slot_hash <= TOMBSTONE) {
+            target = index;
+            break;
+        }
+
+        uint64_t last_used = d_slots[index].last_used.load(memory_order_relaxed);
+        if (last_used < oldest_time) {
+            oldest_time = last_used;
+            oldest = index;
+        }
+    }
+
+    if (target == no_slot) {
+        retire(oldest);
+        target = oldest;
+        d_header->evictions.fetch_add(1, memory_order_relaxed);
+    }
+
+    // No live entry refers to this part of the arena now. A reader that
+    // loaded a retired slot's sequence number before it was retired must see
+    // that change if it sees any of the new record.
+    atomic_thread_fence(memory_order_release);
+    write_arena(offset, key.data(), key.size());
+    write_arena(offset + key.size(), value.data(), value.size());
+
+    Slot &slot = d_slots[target];
+    uint64_t seq = slot.seq.load(memory_order_relaxed);
+    slot.seq.store(seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.offset.store(offset, memory_order_relaxed);
+    slot.key_length.store(key.size(), memory_order_relaxed);
+    slot.value_length.store(value.size(), memory_order_relaxed);
+    slot.last_used.store(time(0), memory_order_relaxed);
+    slot.hash.store(h, memory_order_relaxed);
+
+    slot.seq.store(seq + 2, memory_order_release);
+
+    d_header->head.store(offset + span, memory_order_relaxed);
+    d_header->inserts.fetch_add(1, memory_order_relaxed);
+
+    unlock_file();
+
+    BESDEBUG(DEBUG_KEY, prolog << "Added '" << key << "' (" << value.size() << " bytes) at " << offset << endl);
+
+    return true;
+}
+
+/**
+ * @brief Remove a key, if it is in the cache
+ * @param key The key
+ */
+void SharedMetadataCache::remove(const string &key)
+{
+    if (key.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock(d_write_mutex);
+    lock_file();
+
+    uint64_t index = find_slot(key, hash(key));
+    if (index != no_slot)
+        retire(index);
+
+    unlock_file();
+}
+
+void SharedMetadataCache::dump(ostream &os) const
+{
+    uint64_t live = 0;
+    for (uint64_t index = 0; index <= d_slot_mask; ++index)
+        if (d_slots[index].hash.load(memory_order_relaxed) > TOMBSTONE) ++live;
+
+    os << "SharedMetadataCache" << endl;
+    os << "Path: " << d_path << endl;
+    os << "Arena size: " << d_arena_size << ", head: " << d_header->head.load() << endl;
+    os << "Entries: " << live << " of " << d_slot_mask + 1 << endl;
+    os << "Hits: " << d_header->hits.load() << ", misses: " << d_header->misses.load() << ", inserts: "
+       << d_header->inserts.load() << ", evictions: " << d_header->evictions.load() << endl;
+}
+
+} // namespace bes
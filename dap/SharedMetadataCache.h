@@ -0,0 +1,142 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef DAP_SHAREDMETADATACACHE_H_
+#define DAP_SHAREDMETADATACACHE_H_
+
+#include <cstdint>
+
+#include <string>
+#include <ostream>
+#include <mutex>
+
+namespace bes {
+
+/**
+ * @brief A cache of serialized metadata shared by all of the BES processes
+ *
+ * Each connection to the BES is served by a forked beslistener, so the
+ * per-process ObjMemCache starts out empty for every client. This cache
+ * holds serialized metadata (DAS, DMR and MDS responses, ...) in a
+ * memory-mapped file that every beslistener maps, so a response built by
+ * one process can be used by all the others.
+ *
+ * The file holds a header, an open-addressing hash index and an arena. The
+ * arena is used as a ring: new records are written at the head and the
+ * index entries for the records they overwrite are retired first. When the
+ * probe window for a key is full, the entry used least recently is evicted,
+ * so the policy is an approximation of LRU.
+ *
+ * Readers do not lock. Each index slot has a sequence number that writers
+ * make odd while they change the slot or the record it points to; a reader
+ * copies the record and then checks that the sequence number did not
+ * change. Because a reader may copy bytes a writer is changing, the arena
+ * is read and written as relaxed atomic 64-bit words, never with memcpy().
+ * Writers are serialized with a mutex (threads) and a fcntl() lock on the
+ * file (processes).
+ *
+ * BES Keys used:
+ * - _DAP.SharedMetadataCache.path_: The file to map. If this is not set,
+ *   the cache is disabled and get_instance() returns null.
+ * - _DAP.SharedMetadataCache.size_: Size of the arena in megabytes; the
+ *   default is 64.
+ * - _DAP.SharedMetadataCache.entries_: Number of index slots, rounded up to
+ *   a power of two; the default is 16384.
+ *
+ * @note All of the processes that use the file must be configured with the
+ * same size and number of entries. A file with a different layout is
+ * reinitialized by the first process that maps it.
+ */
+class SharedMetadataCache {
+private:
+    struct Header;
+    struct Slot;
+
+    int d_fd;
+    std::string d_path;
+
+    char *d_map;
+    uint64_t d_map_size;
+
+    Header *d_header;
+    Slot *d_slots;
+    char *d_arena;
+
+    uint64_t d_slot_mask;
+    uint64_t d_arena_size;
+
+    // fcntl() locks are per process; this keeps the threads of one process out
+    std::mutex d_write_mutex;
+
+    static bool d_enabled;
+    static SharedMetadataCache *d_instance;
+
+    // Called by atexit()
+    static void delete_instance() {
+        delete d_instance;
+        d_instance = 0;
+    }
+
+    static uint64_t hash(const std::string &key);
+    static uint64_t header_bytes();
+
+    void map_file(uint64_t arena_size, uint64_t entries);
+    void format();
+
+    void lock_file();
+    void unlock_file();
+
+    uint64_t find_slot(const std::string &key, uint64_t h);
+    void retire(uint64_t index);
+    void retire_overlapping(uint64_t offset, uint64_t length);
+
+    void read_arena(uint64_t offset, char *dest, uint64_t length) const;
+    bool arena_equals(uint64_t offset, const std::string &s) const;
+    void write_arena(uint64_t offset, const char *src, uint64_t length);
+
+    friend class SharedMetadataCacheTest;
+
+protected:
+    SharedMetadataCache(const std::string &path, uint64_t arena_size, uint64_t entries);
+
+public:
+    virtual ~SharedMetadataCache();
+
+    static SharedMetadataCache *get_instance(const std::string &path, uint64_t arena_size, uint64_t entries);
+    static SharedMetadataCache *get_instance();
+
+    bool get(const std::string &key, std::string &value);
+    bool put(const std::string &key, const std::string &value);
+    void remove(const std::string &key);
+
+    /// @brief The largest record (key and value) the cache will hold
+    uint64_t get_max_record_size() const { return d_arena_size / 4; }
+
+    std::string get_path() const { return d_path; }
+
+    virtual void dump(std::ostream &os) const;
+};
+
+} // namespace bes
+
+#endif /* DAP_SHAREDMETADATACACHE_H_ */
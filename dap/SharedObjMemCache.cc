@@ -0,0 +1,190 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <sys/stat.h>
+
+#include <cstdio>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <DapObj.h>
+#include <DAS.h>
+
+#include "BESDebug.h"
+#include "BESInternalError.h"
+
+#include "SharedMetadataCache.h"
+#include "SharedObjMemCache.h"
+
+#define DEBUG_KEY "shared_cache"
+
+#define prolog std::string("SharedObjMemCache::").append(__func__).append("() - ")
+
+using namespace std;
+using namespace libdap;
+
+/**
+ * The key used in the shared cache. If \arg key names a file, include its
+ * size and modification time so that entries for an older version of the
+ * file are never found.
+ */
+string SharedObjMemCache::shared_key(const string &key) const
+{
+    ostringstream oss;
+    oss << d_prefix << key;
+
+    struct stat buf;
+    if (stat(key.c_str(), &buf) == 0)
+        oss << ':' << buf.st_size << ':' << buf.st_mtime;
+
+    return oss.str();
+}
+
+/**
+ * @brief Add an object to this process's cache and the shared cache
+ *
+ * A failure to add the object to the shared cache is not an error; the
+ * object is still cached in this process.
+ *
+ * @param obj Pointer to be cached
+ * @param key Associate this key with the cached object
+ * @see ObjMemCache::add()
+ */
+void SharedObjMemCache::add(DapObj *obj, const string &key)
+{
+    ObjMemCache::add(obj, key);
+
+    if (!d_shared)
+        return;
+
+    try {
+        string blob;
+        d_serialize(obj, blob);
+        d_shared->put(shared_key(key), blob);
+    }
+    catch (...) {
+        BESDEBUG(DEBUG_KEY, prolog << "Could not add '" << key << "' to the shared cache." << endl);
+    }
+}
+
+/**
+ * @brief Remove the object from this process's cache and the shared cache
+ * @param key
+ */
+void SharedObjMemCache::remove(const string &key)
+{
+    ObjMemCache::remove(key);
+
+    if (d_shared)
+        d_shared->remove(shared_key(key));
+}
+
+/**
+ * @brief Get the cached pointer
+ *
+ * If the object is not in this process's cache, look in the shared cache.
+ * An object found there is rebuilt and added to this process's cache, which
+ * manages its storage just as if add() had been called.
+ *
+ * @param key
+ * @return The cached object or null
+ */
+DapObj *SharedObjMemCache::get(const string &key)
+{
+    DapObj *obj = ObjMemCache::get(key);
+    if (obj || !d_shared)
+        return obj;
+
+    string skey = shared_key(key);
+    string blob;
+    if (!d_shared->get(skey, blob))
+        return 0;
+
+    try {
+        obj = d_deserialize(blob);
+    }
+    catch (...) {
+        BESDEBUG(DEBUG_KEY, prolog << "Could not rebuild '" << key << "' from the shared cache." << endl);
+        d_shared->remove(skey);
+        return 0;
+    }
+
+    BESDEBUG(DEBUG_KEY, prolog << "Shared cache hit for '" << key << "'" << endl);
+
+    ObjMemCache::add(obj, key);
+    return obj;
+}
+
+/**
+ * @brief Serialize a DAS
+ *
+ * The first line holds the name of the DAS's current container (often
+ * empty) and the rest is the DAS response.
+ */
+void SharedObjMemCache::serialize_das(DapObj *obj, string &blob)
+{
+    DAS *das = dynamic_cast<DAS *>(obj);
+    if (!das)
+        throw BESInternalError("Expected a DAS object.", __FILE__, __LINE__);
+
+    ostringstream oss;
+    oss << das->container_name() << '\n';
+    das->print(oss);
+
+    blob = oss.str();
+}
+
+/**
+ * @brief Build a DAS using the text written by serialize_das()
+ */
+DapObj *SharedObjMemCache::deserialize_das(const string &blob)
+{
+    string::size_type eol = blob.find('\n');
+    if (eol == string::npos || eol + 1 == blob.size())
+        throw BESInternalError("Malformed DAS in the shared cache.", __FILE__, __LINE__);
+
+    FILE *in = fmemopen(const_cast<char *>(blob.data() + eol + 1), blob.size() - eol - 1, "r");
+    if (!in)
+        throw BESInternalError("Could not read the DAS from the shared cache.", __FILE__, __LINE__);
+
+    auto_ptr<DAS> das(new DAS);
+    try {
+        das->parse(in);
+        fclose(in);
+    }
+    catch (...) {
+        fclose(in);
+        throw;
+    }
+
+    // The DAS was printed with the container as a top-level table; make it current again
+    string container = blob.substr(0, eol);
+    if (!container.empty())
+        das->container_name(container);
+
+    return das.release();
+}
@@ -0,0 +1,85 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef DAP_SHAREDOBJMEMCACHE_H_
+#define DAP_SHAREDOBJMEMCACHE_H_
+
+#include <string>
+
+#include "ObjMemCache.h"
+
+namespace bes {
+class SharedMetadataCache;
+}
+
+/**
+ * @brief An ObjMemCache backed by the SharedMetadataCache
+ *
+ * Objects are held in this process's ObjMemCache as before, and added to
+ * the SharedMetadataCache in serialized form so that the other beslistener
+ * processes can use them. A get() that misses in this process looks in the
+ * shared cache, rebuilds the object and adds it to the local cache.
+ *
+ * The serializer and deserializer are supplied by the caller since only the
+ * handler knows how to rebuild its objects. Objects that hold handler state
+ * that is not part of their text representation (e.g., the DDS and DMR
+ * objects whose variables read data) should not be shared this way.
+ *
+ * The shared keys include the prefix and, when the key names a file, the
+ * file's size and modification time, so a changed file is not served from
+ * the shared cache.
+ */
+class SharedObjMemCache: public ObjMemCache {
+public:
+    /// Write the object's text representation to the string
+    typedef void (*serializer_t)(libdap::DapObj *obj, std::string &blob);
+    /// Build a new object from the text written by the serializer
+    typedef libdap::DapObj *(*deserializer_t)(const std::string &blob);
+
+private:
+    bes::SharedMetadataCache *d_shared;
+    std::string d_prefix;
+    serializer_t d_serialize;
+    deserializer_t d_deserialize;
+
+    std::string shared_key(const std::string &key) const;
+
+public:
+    SharedObjMemCache(unsigned int entries_threshold, float purge_threshold, bes::SharedMetadataCache *shared,
+                      const std::string &prefix, serializer_t serialize, deserializer_t deserialize) :
+        ObjMemCache(entries_threshold, purge_threshold), d_shared(shared), d_prefix(prefix),
+        d_serialize(serialize), d_deserialize(deserialize) { }
+
+    virtual ~SharedObjMemCache() { }
+
+    virtual void add(libdap::DapObj *obj, const std::string &key);
+
+    virtual void remove(const std::string &key);
+
+    virtual libdap::DapObj *get(const std::string &key);
+
+    static void serialize_das(libdap::DapObj *obj, std::string &blob);
+    static libdap::DapObj *deserialize_das(const std::string &blob);
+};
+
+#endif /* DAP_SHAREDOBJMEMCACHE_H_ */
@@ -0,0 +1,262 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef DAP_TEXTFORMATTER_H_
+#define DAP_TEXTFORMATTER_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <ostream>
+#include <string>
+
+namespace bes {
+
+/**
+ * @brief Format numbers as text, quickly
+ *
+ * The text responses (ASCII, JSON, CovJSON, w10n) print every value of an
+ * array with operator<<(), which builds a sentry and looks up the locale's
+ * num_put facet for each number. This class formats the values into a
+ * buffer instead and writes the buffer to the stream in large blocks.
+ * Integers are formatted two digits at a time from a table; floating point
+ * values are formatted by snprintf() with the same "%.*g" conversion the
+ * stream uses, so the text is exactly what operator<<() prints with the
+ * stream's default float field and the given precision.
+ *
+ * put_shortest() prints the fewest digits that read back as the same value.
+ * That's not what operator<<() does, so the handlers only use it where the
+ * shorter text is wanted.
+ *
+ * Without a stream, the text is kept in the buffer; use str() to get it.
+ *
+ * @note This is all in the header so the handlers can use it without
+ * linking with the dap module.
+ */
+class TextFormatter {
+private:
+    std::ostream *d_strm;
+    std::string d_buf;
+    size_t d_flush_size;
+    int d_precision;
+
+    TextFormatter(const TextFormatter &);
+    TextFormatter &operator=(const TextFormatter &);
+
+    static const char *digit_pairs()
+    {
+        static const char pairs[] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+        return pairs;
+    }
+
+    void maybe_flush()
+    {
+        if (d_strm && d_buf.size() >= d_flush_size) flush();
+    }
+
+    void put_unsigned(unsigned long long v, bool negative)
+    {
+        char tmp[24];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+        const char *pairs = digit_pairs();
+
+        while (v >= 100) {
+            unsigned int i = (v % 100) * 2;
+            v /= 100;
+            *--p = pairs[i + 1];
+            *--p = pairs[i];
+        }
+        if (v >= 10) {
+            unsigned int i = v * 2;
+            *--p = pairs[i + 1];
+            *--p = pairs[i];
+        }
+        else {
+            *--p = '0' + v;
+        }
+        if (negative) *--p = '-';
+
+        d_buf.append(p, end - p);
+        maybe_flush();
+    }
+
+    template<typename T> void put_signed(T v)
+    {
+        if (v < 0)
+            put_unsigned(0ULL - (unsigned long long) v, true);
+        else
+            put_unsigned(v, false);
+    }
+
+    // Format with snprintf() straight into the buffer
+    void put_g(double v, int precision)
+    {
+        size_t len = d_buf.size();
+        d_buf.resize(len + 32);
+        int n = snprintf(&d_buf[len], 32, "%.*g", precision, v);
+        if (n >= 32) {
+            d_buf.resize(len + n + 1);
+            n = snprintf(&d_buf[len], n + 1, "%.*g", precision, v);
+        }
+        d_buf.resize(len + (n > 0 ? n : 0));
+        maybe_flush();
+    }
+
+public:
+    /**
+     * @brief Write to a stream
+     * @param strm Write the text here. The precision used for floating point
+     * values starts as the stream's precision.
+     * @param flush_size Write the buffer to the stream once it holds this
+     * many bytes.
+     */
+    explicit TextFormatter(std::ostream &strm, size_t flush_size = 64 * 1024) :
+        d_strm(&strm), d_flush_size(flush_size), d_precision(strm.precision())
+    {
+        d_buf.reserve(flush_size + 64);
+    }
+
+    /// @brief Build the text in memory; floating point precision is 6
+    TextFormatter() : d_strm(0), d_flush_size(0), d_precision(6) { }
+
+    ~TextFormatter()
+    {
+        try {
+            flush();
+        }
+        catch (...) {
+            // A stream set to throw; the caller is already handling an error
+        }
+    }
+
+    /// @brief Write the buffered text to the stream, if there is one
+    void flush()
+    {
+        if (d_strm && !d_buf.empty()) {
+            d_strm->write(d_buf.data(), d_buf.size());
+            d_buf.clear();
+        }
+    }
+
+    /// @brief The text that has not been written to a stream
+    const std::string &str() const { return d_buf; }
+
+    void clear() { d_buf.clear(); }
+
+    int precision() const { return d_precision; }
+
+    /// @brief Set the precision used for floating point values; returns the old one
+    int precision(int p)
+    {
+        int old = d_precision;
+        d_precision = p;
+        return old;
+    }
+
+    void write(const char *s, size_t n) { d_buf.append(s, n); maybe_flush(); }
+
+    // Text
+    void put(char c) { d_buf.push_back(c); maybe_flush(); }
+    void put(const char *s) { write(s, strlen(s)); }
+    void put(const std::string &s) { write(s.data(), s.size()); }
+
+    // Numbers. Note that unsigned and signed char are numbers (DAP Byte
+    // and Int8) while char is text.
+    void put(unsigned char v) { put_unsigned(v, false); }
+    void put(unsigned short v) { put_unsigned(v, false); }
+    void put(unsigned int v) { put_unsigned(v, false); }
+    void put(unsigned long v) { put_unsigned(v, false); }
+    void put(unsigned long long v) { put_unsigned(v, false); }
+
+    void put(signed char v) { put_signed(v); }
+    void put(short v) { put_signed(v); }
+    void put(int v) { put_signed(v); }
+    void put(long v) { put_signed(v); }
+    void put(long long v) { put_signed(v); }
+
+    // operator<<() converts a float to double, too.
+    void put(float v) { put_g(v, d_precision); }
+    void put(double v) { put_g(v, d_precision); }
+
+    /**
+     * @brief Write values with a separator between them
+     * @param values The values, e.g., from libdap::Vector::get_buf()
+     * @param n How many
+     * @param sep Written between each pair of values
+     */
+    template<typename T> void put_values(const T *values, size_t n, const char *sep)
+    {
+        size_t sep_len = strlen(sep);
+        for (size_t i = 0; i < n; ++i) {
+            if (i) d_buf.append(sep, sep_len);
+            put(values[i]);
+        }
+    }
+
+    /**
+     * @brief Write the shortest text that reads back as this value
+     *
+     * This is the "%.*g" text with the fewest digits (at least DBL_DIG, 15)
+     * that strtod() converts back to v. Values with fewer significant digits
+     * print without trailing zeros, as they do with "%g".
+     */
+    void put_shortest(double v)
+    {
+        char tmp[32];
+        int n = 0;
+        for (int p = 15; p <= 17; ++p) {
+            n = snprintf(tmp, sizeof(tmp), "%.*g", p, v);
+            if (p == 17 || v != v || strtod(tmp, 0) == v) break;
+        }
+        write(tmp, n);
+    }
+
+    /// @brief Write the shortest text that reads back as this float (6 to 9 digits)
+    void put_shortest(float v)
+    {
+        char tmp[32];
+        int n = 0;
+        for (int p = 6; p <= 9; ++p) {
+            n = snprintf(tmp, sizeof(tmp), "%.*g", p, (double) v);
+            if (p == 9 || v != v || strtof(tmp, 0) == v) break;
+        }
+        write(tmp, n);
+    }
+};
+
+} // namespace bes
+
+#endif /* DAP_TEXTFORMATTER_H_ */
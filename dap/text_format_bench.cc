@@ -0,0 +1,174 @@
+// This file is part of the BES, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Authors: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+// Time writing arrays of numbers as comma-separated text the way the text
+// responses (ASCII, JSON, CovJSON, w10n) used to - copy the values out of
+// the array and print each one with operator<<() - and with TextFormatter.
+// Both write to a string stream; the two texts must be the same. Also times
+// TextFormatter::put_shortest(), which prints different (shorter) text.
+//
+// Build with 'make text_format_bench'.
+
+#include <unistd.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+
+#include "TextFormatter.h"
+
+using namespace std;
+
+static void usage(const char *name) {
+    cerr << name << " [-n <values>] | -h" << endl;
+}
+
+static double seconds_since(const chrono::steady_clock::time_point &start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+template<typename T>
+static string with_ostream(const vector<T> &values, int precision, double &seconds) {
+    ostringstream oss;
+    auto start = chrono::steady_clock::now();
+
+    // What the handlers did: copy the values, then print them one at a time
+    vector<T> src(values.size());
+    copy(values.begin(), values.end(), src.begin());
+    streamsize prec = oss.precision(precision);
+    for (size_t i = 0; i < src.size(); ++i) {
+        if (i) oss << ", ";
+        oss << src[i];
+    }
+    oss.precision(prec);
+
+    seconds = seconds_since(start);
+    return oss.str();
+}
+
+template<typename T>
+static string with_formatter(const vector<T> &values, int precision, double &seconds) {
+    ostringstream oss;
+    auto start = chrono::steady_clock::now();
+
+    bes::TextFormatter out(oss);
+    out.precision(precision);
+    out.put_values(values.data(), values.size(), ", ");
+    out.flush();
+
+    seconds = seconds_since(start);
+    return oss.str();
+}
+
+template<typename T>
+static string with_shortest(const vector<T> &values, double &seconds) {
+    ostringstream oss;
+    auto start = chrono::steady_clock::now();
+
+    bes::TextFormatter out(oss);
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i) out.write(", ", 2);
+        out.put_shortest(values[i]);
+    }
+    out.flush();
+
+    seconds = seconds_since(start);
+    return oss.str();
+}
+
+static void report(const string &what, size_t bytes, double seconds) {
+    cerr << "    " << what << ": " << bytes << " bytes in " << seconds << "s, "
+         << bytes / seconds / (1024 * 1024) << " MB/s" << endl;
+}
+
+template<typename T>
+static bool run(const string &type, const vector<T> &values, int precision) {
+    double os_seconds, fmt_seconds;
+    string os_text = with_ostream(values, precision, os_seconds);
+    string fmt_text = with_formatter(values, precision, fmt_seconds);
+
+    cerr << type << " (" << values.size() << " values):" << endl;
+    report("operator<<()", os_text.size(), os_seconds);
+    report("TextFormatter", fmt_text.size(), fmt_seconds);
+    cerr << "    speedup: " << os_seconds / fmt_seconds << endl;
+
+    if (os_text != fmt_text) {
+        cerr << "    ERROR: the two texts differ" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+template<typename T>
+static void run_shortest(const string &type, const vector<T> &values) {
+    double seconds;
+    string text = with_shortest(values, seconds);
+    report(type + " put_shortest()", text.size(), seconds);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = 2000000;
+
+    int c;
+    while ((c = getopt(argc, argv, "hn:")) != -1) {
+        switch (c) {
+            case 'n':
+                n = atol(optarg);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    // Values like those in a satellite granule: scaled integers, and
+    // floating point values with a mix of magnitudes.
+    srandom(42);
+    vector<int16_t> shorts(n);
+    vector<int32_t> ints(n);
+    vector<float> floats(n);
+    vector<double> doubles(n);
+    for (size_t i = 0; i < n; ++i) {
+        shorts[i] = random() % 65536 - 32768;
+        ints[i] = random() - RAND_MAX / 2;
+        floats[i] = (random() % 100000) / 100.0f - 500.0f;
+        doubles[i] = sin(i * 0.001) * pow(10.0, random() % 10 - 3);
+    }
+
+    bool ok = true;
+    ok = run("Int16", shorts, 6) && ok;
+    ok = run("Int32", ints, 6) && ok;
+    ok = run("Float32", floats, 6) && ok;
+    ok = run("Float64", doubles, 15) && ok;
+
+    run_shortest("Float32", floats);
+    run_shortest("Float64", doubles);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -40,7 +40,12 @@
 #endif
 
 #include <unistd.h>  // for stat
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 #include <ObjectType.h>
 #include <EncodingType.h>
@@ -50,6 +55,7 @@
 #include <DAS.h>
 #include <DDS.h>
 #include <Str.h>
+#include <Byte.h>
 #include <DDXParserSAX2.h>
 #include <D4AsyncUtil.h>
 
@@ -69,6 +75,7 @@
 #include <test/TestByte.h>
 
 #include "BESDebug.h"
+#include "BESInternalError.h"
 #include "TheBESKeys.h"
 #include "BESDapResponseBuilder.h"
 #include "BESDapFunctionResponseCache.h"
@@ -785,6 +792,127 @@ public:
     }
 
 
+    // Count the variables read and the most read at once
+    struct ReadLog {
+        std::mutex lock;
+        set<BaseType*> read;
+        set<std::thread::id> threads;
+        std::atomic<int> reading;
+        std::atomic<int> most_reading;
+
+        ReadLog() : reading(0), most_reading(0) {}
+
+        void read_var(BaseType *var)
+        {
+            int now = ++reading;
+            int most = most_reading;
+            while (now > most && !most_reading.compare_exchange_weak(most, now))
+                ;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                CPPUNIT_ASSERT(read.insert(var).second);
+                threads.insert(std::this_thread::get_id());
+            }
+            // Long enough for the other readers to start
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            --reading;
+        }
+    };
+
+    static vector<BaseType*> make_vars(unsigned int n)
+    {
+        vector<BaseType*> vars;
+        for (unsigned int i = 0; i < n; ++i)
+            vars.push_back(new Byte("v" + long_to_string(i)));
+        return vars;
+    }
+
+    static void delete_vars(vector<BaseType*> &vars)
+    {
+        for (vector<BaseType*>::iterator i = vars.begin(), e = vars.end(); i != e; ++i)
+            delete *i;
+        vars.clear();
+    }
+
+    // The variables of a handler listed in DAP.ParallelRead.Handlers are read by several threads
+    void intern_vars_parallel_test()
+    {
+        DBG(cerr << endl << plog << "BEGIN" << endl);
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "4");
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Handlers", "test");
+        BESDapResponseBuilder builder;
+        CPPUNIT_ASSERT(builder.d_read_threads == 4);
+
+        vector<BaseType*> vars = make_vars(16);
+        ReadLog log;
+        builder.intern_vars(vars, "test", [&log](BaseType *var) { log.read_var(var); });
+
+        DBG(cerr << plog << "threads: " << log.threads.size() << " most at once: " << log.most_reading << endl);
+        CPPUNIT_ASSERT(log.read.size() == vars.size());
+        CPPUNIT_ASSERT(log.threads.size() > 1 && log.threads.size() <= 4);
+        CPPUNIT_ASSERT(log.most_reading > 1 && log.most_reading <= 4);
+
+        // Other handlers' variables are read one at a time by this thread
+        ReadLog serial_log;
+        builder.intern_vars(vars, "other", [&serial_log](BaseType *var) { serial_log.read_var(var); });
+        CPPUNIT_ASSERT(serial_log.read.size() == vars.size());
+        CPPUNIT_ASSERT(serial_log.most_reading == 1);
+        CPPUNIT_ASSERT(serial_log.threads.size() == 1);
+        CPPUNIT_ASSERT(*serial_log.threads.begin() == std::this_thread::get_id());
+
+        delete_vars(vars);
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "");
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Handlers", "");
+        DBG(cerr << plog << "END" << endl);
+    }
+
+    // The first error is rethrown once the reads underway finish
+    void intern_vars_error_test()
+    {
+        DBG(cerr << endl << plog << "BEGIN" << endl);
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "4");
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Handlers", "test");
+        BESDapResponseBuilder builder;
+
+        vector<BaseType*> vars = make_vars(16);
+        ReadLog log;
+        try {
+            builder.intern_vars(vars, "test", [&log, &vars](BaseType *var) {
+                log.read_var(var);
+                if (var == vars[2]) throw BESInternalError("Could not read v2", __FILE__, __LINE__);
+            });
+            CPPUNIT_FAIL("Expected a BESInternalError");
+        }
+        catch (BESInternalError &e) {
+            CPPUNIT_ASSERT(e.get_message() == "Could not read v2");
+        }
+
+        // No read is still running and no new one was started after the error
+        CPPUNIT_ASSERT(log.reading == 0);
+        CPPUNIT_ASSERT(log.read.size() < vars.size());
+
+        delete_vars(vars);
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "");
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Handlers", "");
+        DBG(cerr << plog << "END" << endl);
+    }
+
+    // DAP.ParallelRead.Threads is read with TheBESKeys::read_int_key()
+    void read_threads_key_test()
+    {
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "8");
+        CPPUNIT_ASSERT(BESDapResponseBuilder().d_read_threads == 8);
+
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "many");
+        CPPUNIT_ASSERT(BESDapResponseBuilder().d_read_threads == 1);
+
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "-3");
+        CPPUNIT_ASSERT(BESDapResponseBuilder().d_read_threads == 1);
+
+        TheBESKeys::TheKeys()->set_key("DAP.ParallelRead.Threads", "");
+        CPPUNIT_ASSERT(BESDapResponseBuilder().d_read_threads == 1);
+    }
+
     void dummy_test(){
         DBG(cerr << endl << plog << "BEGIN" << endl);
         DBG(cerr << plog << "NOTHING WILL BE DONE." << endl);
@@ -801,6 +929,10 @@ CPPUNIT_TEST_SUITE( ResponseBuilderTest );
         CPPUNIT_TEST(invoke_server_side_function_test);
         CPPUNIT_TEST(dummy_test);
 
+    CPPUNIT_TEST(intern_vars_parallel_test);
+    CPPUNIT_TEST(intern_vars_error_test);
+    CPPUNIT_TEST(read_threads_key_test);
+
 #if 0
     // FIXME These tests have baselines that rely on hash values that are
     // machine dependent. jhrg 3/4/15
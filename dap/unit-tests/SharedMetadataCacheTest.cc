@@ -0,0 +1,348 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+
+#include "SharedMetadataCache.h"
+
+#include "test_config.h"
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+using namespace CppUnit;
+using namespace std;
+
+namespace bes {
+
+static const string c_cache_name = string(TEST_BUILD_DIR) + "/shared_mds_test.bin";
+
+class SharedMetadataCacheTest: public TestFixture {
+private:
+    static string value_for(int i, unsigned int size)
+    {
+        ostringstream oss;
+        oss << "value_" << i << "_";
+        string value = oss.str();
+        value.resize(size, static_cast<char>('a' + i % 26));
+        return value;
+    }
+
+    static string key_for(int i)
+    {
+        ostringstream oss;
+        oss << "/data/granule_" << i << ".nc:das";
+        return oss.str();
+    }
+
+public:
+    SharedMetadataCacheTest()
+    {
+    }
+
+    ~SharedMetadataCacheTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,shared_cache");
+        // Formatting the file is logged
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append("/bes.conf");
+        unlink(c_cache_name.c_str());
+    }
+
+    void tearDown()
+    {
+        unlink(c_cache_name.c_str());
+    }
+
+    void put_get_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+
+        string value;
+        CPPUNIT_ASSERT(!cache.get("/data/x.nc:das", value));
+
+        CPPUNIT_ASSERT(cache.put("/data/x.nc:das", "Attributes {\n}\n"));
+        CPPUNIT_ASSERT(cache.get("/data/x.nc:das", value));
+        CPPUNIT_ASSERT_EQUAL(string("Attributes {\n}\n"), value);
+
+        // An empty value is a value
+        CPPUNIT_ASSERT(cache.put("/data/empty.nc:das", ""));
+        CPPUNIT_ASSERT(cache.get("/data/empty.nc:das", value));
+        CPPUNIT_ASSERT(value.empty());
+
+        CPPUNIT_ASSERT(!cache.get("/data/x.nc:dmr", value));
+
+        DBG(cache.dump(cerr));
+    }
+
+    void overwrite_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+
+        CPPUNIT_ASSERT(cache.put("key", "first"));
+        CPPUNIT_ASSERT(cache.put("key", "second"));
+
+        string value;
+        CPPUNIT_ASSERT(cache.get("key", value));
+        CPPUNIT_ASSERT_EQUAL(string("second"), value);
+    }
+
+    void remove_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+
+        CPPUNIT_ASSERT(cache.put("key", "value"));
+        cache.remove("key");
+
+        string value;
+        CPPUNIT_ASSERT(!cache.get("key", value));
+
+        // Removing something that is not there is not an error
+        cache.remove("key");
+        cache.remove("not there");
+    }
+
+    void too_large_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 64 * 1024, 1024);
+
+        CPPUNIT_ASSERT(!cache.put("key", string(cache.get_max_record_size(), 'x')));
+        CPPUNIT_ASSERT(cache.put("key", string(cache.get_max_record_size() - 3, 'x')));
+    }
+
+    // The arena is a ring; old records are overwritten by new ones
+    void wrap_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 64 * 1024, 1024);
+
+        for (int i = 0; i < 200; ++i)
+            CPPUNIT_ASSERT(cache.put(key_for(i), value_for(i, 1000)));
+
+        DBG(cache.dump(cerr));
+
+        string value;
+        CPPUNIT_ASSERT(!cache.get(key_for(0), value));
+        CPPUNIT_ASSERT(!cache.get(key_for(100), value));
+
+        // About 60 records fit; the last 50 must all be there
+        for (int i = 150; i < 200; ++i) {
+            CPPUNIT_ASSERT(cache.get(key_for(i), value));
+            CPPUNIT_ASSERT_EQUAL(value_for(i, 1000), value);
+        }
+    }
+
+    // With fewer slots than keys, entries are evicted from the index
+    void eviction_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 1024 * 1024, 16);
+
+        for (int i = 0; i < 100; ++i)
+            CPPUNIT_ASSERT(cache.put(key_for(i), value_for(i, 100)));
+
+        DBG(cache.dump(cerr));
+
+        string value;
+        CPPUNIT_ASSERT(cache.get(key_for(99), value));
+        CPPUNIT_ASSERT_EQUAL(value_for(99, 100), value);
+
+        int found = 0;
+        for (int i = 0; i < 100; ++i) {
+            if (cache.get(key_for(i), value)) {
+                CPPUNIT_ASSERT_EQUAL(value_for(i, 100), value);
+                ++found;
+            }
+        }
+        CPPUNIT_ASSERT_EQUAL(16, found);
+    }
+
+    // A second mapping of the same file sees the first one's entries
+    void reopen_test()
+    {
+        {
+            SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+            CPPUNIT_ASSERT(cache.put("key", "value"));
+        }
+
+        string value;
+        {
+            SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+            CPPUNIT_ASSERT(cache.get("key", value));
+            CPPUNIT_ASSERT_EQUAL(string("value"), value);
+        }
+
+        // A different layout means the file is reinitialized
+        SharedMetadataCache cache(c_cache_name, 2 * 1024 * 1024, 1024);
+        CPPUNIT_ASSERT(!cache.get("key", value));
+    }
+
+    // This is how the beslistener processes share the cache
+    void fork_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 1024 * 1024, 1024);
+        CPPUNIT_ASSERT(cache.put("from the parent", "parent value"));
+
+        pid_t pid = fork();
+        CPPUNIT_ASSERT(pid != -1);
+        if (pid == 0) {
+            string value;
+            bool ok = cache.get("from the parent", value) && value == "parent value";
+            ok = ok && cache.put("from the child", "child value");
+            for (int i = 0; i < 100; ++i)
+                ok = ok && cache.put(key_for(i), value_for(i, 500));
+            _exit(ok ? 0 : 1);
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        string value;
+        CPPUNIT_ASSERT(cache.get("from the child", value));
+        CPPUNIT_ASSERT_EQUAL(string("child value"), value);
+        for (int i = 0; i < 100; ++i) {
+            CPPUNIT_ASSERT(cache.get(key_for(i), value));
+            CPPUNIT_ASSERT_EQUAL(value_for(i, 500), value);
+        }
+    }
+
+    // Readers in one process while another process writes
+    void concurrent_test()
+    {
+        SharedMetadataCache cache(c_cache_name, 256 * 1024, 256);
+
+        pid_t pid = fork();
+        CPPUNIT_ASSERT(pid != -1);
+        if (pid == 0) {
+            for (int n = 0; n < 100; ++n)
+                for (int i = 0; i < 200; ++i)
+                    cache.put(key_for(i), value_for(i + n, 2000));
+            _exit(0);
+        }
+
+        // Whatever is read must be a whole value that was written for that key
+        int hits = 0;
+        int status = 0;
+        while (waitpid(pid, &status, WNOHANG) == 0) {
+            for (int i = 0; i < 200; ++i) {
+                string value;
+                if (cache.get(key_for(i), value)) {
+                    ++hits;
+                    CPPUNIT_ASSERT_EQUAL((size_t) 2000, value.size());
+                    CPPUNIT_ASSERT(value.compare(0, 6, "value_") == 0);
+                    CPPUNIT_ASSERT_EQUAL(value[1999], value[value.find('_', 6) + 1]);
+                }
+            }
+        }
+        DBG(cerr << "hits: " << hits << endl);
+
+        CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    CPPUNIT_TEST_SUITE( SharedMetadataCacheTest );
+
+    CPPUNIT_TEST(put_get_test);
+    CPPUNIT_TEST(overwrite_test);
+    CPPUNIT_TEST(remove_test);
+    CPPUNIT_TEST(too_large_test);
+    CPPUNIT_TEST(wrap_test);
+    CPPUNIT_TEST(eviction_test);
+    CPPUNIT_TEST(reopen_test);
+    CPPUNIT_TEST(fork_test);
+    CPPUNIT_TEST(concurrent_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedMetadataCacheTest);
+
+} // namespace bes
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dDh");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;
+            bes_debug = true;
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: SharedMetadataCacheTest has the following tests:" << endl;
+            const std::vector<Test*> &tests = bes::SharedMetadataCacheTest::suite()->getTests();
+            unsigned int prefix_len = bes::SharedMetadataCacheTest::suite()->getName().append("::").length();
+            for (std::vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = bes::SharedMetadataCacheTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include <GetOpt.h>
+#include <debug.h>
+
+#include "TextFormatter.h"
+
+static bool debug = false;
+static bool debug_2 = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+#undef DBG2
+#define DBG2(x) do { if (debug_2) (x); } while(false);
+
+using namespace CppUnit;
+using namespace std;
+using namespace bes;
+
+class TextFormatterTest: public TestFixture {
+private:
+    // The text operator<<() writes for 'values', separated by ", "
+    template<typename T> string with_ostream(const vector<T> &values, int precision)
+    {
+        ostringstream oss;
+        oss.precision(precision);
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (i) oss << ", ";
+            oss << values[i];
+        }
+        return oss.str();
+    }
+
+    template<typename T> string with_formatter(const vector<T> &values, int precision)
+    {
+        TextFormatter out;
+        out.precision(precision);
+        out.put_values(values.data(), values.size(), ", ");
+        return out.str();
+    }
+
+public:
+    TextFormatterTest()
+    {
+    }
+
+    ~TextFormatterTest()
+    {
+    }
+
+    void integer_test()
+    {
+        vector<short> s = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, numeric_limits<short>::min(),
+            numeric_limits<short>::max() };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(s, 6), with_formatter(s, 6));
+
+        vector<unsigned short> us = { 0, 7, 65535 };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(us, 6), with_formatter(us, 6));
+
+        vector<int> i = { 0, -7, 1000000, 2147483647, numeric_limits<int>::min() };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(i, 6), with_formatter(i, 6));
+
+        vector<unsigned int> ui = { 0, 4294967295U, 1000000000U };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(ui, 6), with_formatter(ui, 6));
+
+        vector<long long> ll = { numeric_limits<long long>::min(), numeric_limits<long long>::max(), -10 };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(ll, 6), with_formatter(ll, 6));
+
+        vector<unsigned long long> ull = { numeric_limits<unsigned long long>::max(), 10 };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(ull, 6), with_formatter(ull, 6));
+    }
+
+    // Bytes are numbers, not characters
+    void byte_test()
+    {
+        vector<unsigned char> b = { 0, 9, 28, 238, 255 };
+        CPPUNIT_ASSERT_EQUAL(string("0, 9, 28, 238, 255"), with_formatter(b, 6));
+
+        vector<signed char> sb = { -128, -1, 0, 127 };
+        CPPUNIT_ASSERT_EQUAL(string("-128, -1, 0, 127"), with_formatter(sb, 6));
+    }
+
+    void float_test()
+    {
+        vector<float> f = { 0.0f, -0.0f, 1.0f, 3.14159265f, 1e-7f, 123456789.0f, -2.5e30f,
+            numeric_limits<float>::infinity(), -numeric_limits<float>::infinity() };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(f, 6), with_formatter(f, 6));
+        CPPUNIT_ASSERT_EQUAL(with_ostream(f, 9), with_formatter(f, 9));
+
+        vector<double> d = { 0.0, 10245.1234, 0.0314159265358979, 0.15707963267949, 1e300, -4.9e-324,
+            M_PI * 1e15, 1.0 / 3.0 };
+        CPPUNIT_ASSERT_EQUAL(with_ostream(d, 6), with_formatter(d, 6));
+        CPPUNIT_ASSERT_EQUAL(with_ostream(d, 15), with_formatter(d, 15));
+        CPPUNIT_ASSERT_EQUAL(with_ostream(d, 17), with_formatter(d, 17));
+    }
+
+    void random_test()
+    {
+        srandom(1);
+        vector<int> i(1000);
+        vector<float> f(1000);
+        vector<double> d(1000);
+        for (int n = 0; n < 1000; ++n) {
+            i[n] = random() - RAND_MAX / 2;
+            f[n] = (random() - RAND_MAX / 2) / 1000.0f;
+            d[n] = sin(n) * pow(10.0, random() % 40 - 20);
+        }
+
+        CPPUNIT_ASSERT_EQUAL(with_ostream(i, 6), with_formatter(i, 6));
+        CPPUNIT_ASSERT_EQUAL(with_ostream(f, 6), with_formatter(f, 6));
+        CPPUNIT_ASSERT_EQUAL(with_ostream(d, 15), with_formatter(d, 15));
+    }
+
+    void text_test()
+    {
+        TextFormatter out;
+        out.put('[');
+        out.put("a");
+        out.put(string("bc"));
+        out.write(", ", 2);
+        out.put(42);
+        out.put(']');
+        CPPUNIT_ASSERT_EQUAL(string("[abc, 42]"), out.str());
+    }
+
+    // The text is written to the stream in blocks and when it's flushed
+    void stream_test()
+    {
+        ostringstream oss;
+        oss.precision(15);
+        {
+            TextFormatter out(oss, 16);
+            CPPUNIT_ASSERT_EQUAL(15, out.precision());
+
+            vector<int> values(100, 12345);
+            out.put_values(values.data(), values.size(), ",");
+            DBG(cerr << "Written before the flush: " << oss.str().size() << endl);
+            CPPUNIT_ASSERT(oss.str().size() > 0);
+            CPPUNIT_ASSERT(out.str().size() < 16);
+        }
+
+        CPPUNIT_ASSERT_EQUAL((size_t) 100 * 6 - 1, oss.str().size());
+    }
+
+    void shortest_test()
+    {
+        TextFormatter out;
+        out.put_shortest(0.1);
+        CPPUNIT_ASSERT_EQUAL(string("0.1"), out.str());
+
+        out.clear();
+        out.put_shortest(0.1f);
+        CPPUNIT_ASSERT_EQUAL(string("0.1"), out.str());
+
+        out.clear();
+        out.put_shortest(1.0 / 3.0);
+        CPPUNIT_ASSERT_EQUAL(string("0.3333333333333333"), out.str());
+
+        // Every value reads back as itself
+        srandom(2);
+        for (int n = 0; n < 1000; ++n) {
+            double d = sin(n) * pow(10.0, random() % 40 - 20);
+            out.clear();
+            out.put_shortest(d);
+            CPPUNIT_ASSERT_EQUAL(d, strtod(out.str().c_str(), 0));
+
+            float f = d;
+            out.clear();
+            out.put_shortest(f);
+            CPPUNIT_ASSERT_EQUAL(f, strtof(out.str().c_str(), 0));
+        }
+    }
+
+    CPPUNIT_TEST_SUITE( TextFormatterTest );
+
+    CPPUNIT_TEST(integer_test);
+    CPPUNIT_TEST(byte_test);
+    CPPUNIT_TEST(float_test);
+    CPPUNIT_TEST(random_test);
+    CPPUNIT_TEST(text_test);
+    CPPUNIT_TEST(stream_test);
+    CPPUNIT_TEST(shortest_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TextFormatterTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dDh");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'D':
+            debug_2 = 1;
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: TextFormatterTest has the following tests:" << endl;
+            const std::vector<Test*> &tests = TextFormatterTest::suite()->getTests();
+            unsigned int prefix_len = TextFormatterTest::suite()->getName().append("::").length();
+            for (std::vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = TextFormatterTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -0,0 +1,491 @@
+// BESCacheIndex.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "BESInternalError.h"
+#include "BESDebug.h"
+#include "BESLog.h"
+
+#include "BESCacheIndex.h"
+
+// Symbols used with BESDEBUG.
+#define CACHE "cache"
+#define LOCK "cache-lock"
+
+#define prolog std::string("BESCacheIndex::").append(__func__).append("() - ")
+
+using namespace std;
+
+// The index lives in memory shared by several processes, so the atomics
+// must not fall back on a (per process) lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "BESCacheIndex needs lock-free 64-bit atomics");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "BESCacheIndex needs lock-free 32-bit atomics");
+
+static const char magic[8] = "BESCIX1";
+static const uint32_t layout_version = 1;
+
+// The header is followed by the slots, shard by shard
+static const uint64_t header_bytes = 4096;
+
+// Bytes of the index file used as locks. No data are read or written
+// using these locks; they only name the things being locked.
+static const off_t purge_lock_byte = 0;
+static const off_t shard_lock_base = 64;
+
+static const uint64_t min_slots_per_shard = 16;
+
+// Slot states
+static const uint32_t EMPTY = 0;
+static const uint32_t USED = 1;
+static const uint32_t TOMBSTONE = 2;
+
+static const uint64_t no_slot = numeric_limits<uint64_t>::max();
+
+struct BESCacheIndex::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t shard_count;
+    uint64_t slots_per_shard;
+    uint64_t slot_size;
+
+    std::atomic<uint32_t> valid;
+    std::atomic<uint64_t> size;     // Total size of the files, in bytes
+    std::atomic<uint64_t> count;    // Number of USED slots
+};
+
+struct BESCacheIndex::Slot {
+    std::atomic<uint32_t> state;
+    uint32_t name_length;
+    std::atomic<uint64_t> hash;
+    std::atomic<uint64_t> size;
+    std::atomic<int64_t> atime;     // seconds; read without a lock when choosing files to purge
+    char name[BESCacheIndex::max_name_length + 1];
+};
+
+const unsigned int BESCacheIndex::shard_count;
+const unsigned int BESCacheIndex::max_name_length;
+
+static inline string get_errno()
+{
+    char *s_err = strerror(errno);
+    if (s_err)
+        return s_err;
+    else
+        return "Unknown error.";
+}
+
+/**
+ * @brief Map the index file, making it if needed
+ *
+ * If the file does not exist or was made for a different number of entries,
+ * it is (re)formatted and the new index is not valid. The caller must keep
+ * other processes from using the index while this runs.
+ *
+ * @param path The index file
+ * @param entries The number of entries the index should hold; rounded up
+ * to a multiple of the number of shards.
+ * @exception BESInternalError if the file cannot be opened, sized or mapped
+ */
+BESCacheIndex::BESCacheIndex(const string &path, uint64_t entries) :
+    d_fd(-1), d_path(path), d_map(0), d_map_size(0), d_header(0), d_slots(0), d_slots_per_shard(0)
+{
+    static_assert(sizeof(Header) <= (size_t) shard_lock_base, "The BESCacheIndex header overlaps the lock bytes");
+
+    if (entries == 0)
+        throw BESInternalError(prolog + "The cache index must have room for at least one entry.", __FILE__, __LINE__);
+
+    d_slots_per_shard = max(min_slots_per_shard, (entries + shard_count - 1) / shard_count);
+    d_map_size = header_bytes + shard_count * d_slots_per_shard * sizeof(Slot);
+
+    d_fd = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+    if (d_fd == -1)
+        throw BESInternalError(prolog + "Could not open the cache index " + path + ": " + get_errno(), __FILE__,
+            __LINE__);
+
+    try {
+        struct stat buf;
+        if (fstat(d_fd, &buf) == -1)
+            throw BESInternalError(prolog + "Could not stat the cache index: " + get_errno(), __FILE__, __LINE__);
+
+        if ((uint64_t) buf.st_size != d_map_size && ftruncate(d_fd, d_map_size) == -1)
+            throw BESInternalError(prolog + "Could not size the cache index: " + get_errno(), __FILE__, __LINE__);
+
+        void *map = mmap(0, d_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, d_fd, 0);
+        if (map == MAP_FAILED)
+            throw BESInternalError(prolog + "Could not map the cache index: " + get_errno(), __FILE__, __LINE__);
+
+        d_map = static_cast<char *>(map);
+        d_header = reinterpret_cast<Header *>(d_map);
+        d_slots = reinterpret_cast<Slot *>(d_map + header_bytes);
+
+        if (memcmp(d_header->magic, magic, sizeof(magic)) != 0 || d_header->version != layout_version
+            || d_header->shard_count != shard_count || d_header->slots_per_shard != d_slots_per_shard
+            || d_header->slot_size != sizeof(Slot)) {
+            format();
+        }
+    }
+    catch (...) {
+        if (d_map) munmap(d_map, d_map_size);
+        close(d_fd);
+        throw;
+    }
+
+    BESDEBUG(CACHE, prolog << path << ": " << get_capacity() << " entries, " << get_count() << " used" << endl);
+}
+
+/**
+ * Closing the file releases every lock this process holds on it, so the
+ * index must outlive any use of its locks.
+ */
+BESCacheIndex::~BESCacheIndex()
+{
+    if (d_map) munmap(d_map, d_map_size);
+    if (d_fd != -1) close(d_fd);
+}
+
+void BESCacheIndex::format()
+{
+    INFO_LOG(prolog << "Initializing the cache index " << d_path << endl);
+
+    memset(d_map, 0, d_map_size);
+
+    d_header->version = layout_version;
+    d_header->shard_count = shard_count;
+    d_header->slots_per_shard = d_slots_per_shard;
+    d_header->slot_size = sizeof(Slot);
+    memcpy(d_header->magic, magic, sizeof(magic));
+}
+
+/// @brief Does the index hold every file in the cache?
+bool BESCacheIndex::is_valid() const
+{
+    return d_header->valid.load(memory_order_acquire) != 0;
+}
+
+/// @brief Mark the index as (not) valid. @return True if it was valid
+bool BESCacheIndex::set_valid(bool valid)
+{
+    return d_header->valid.exchange(valid ? 1 : 0, memory_order_acq_rel) != 0;
+}
+
+/// @brief The total size of the files in the index, in bytes
+uint64_t BESCacheIndex::get_size() const
+{
+    return d_header->size.load(memory_order_acquire);
+}
+
+/// @brief The number of files in the index
+uint64_t BESCacheIndex::get_count() const
+{
+    return d_header->count.load(memory_order_acquire);
+}
+
+/// FNV-1a
+uint64_t BESCacheIndex::hash(const string &name)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (string::const_iterator i = name.begin(), e = name.end(); i != e; ++i) {
+        h ^= static_cast<unsigned char>(*i);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+// Subtract from the total size without wrapping around; the size is only
+// as accurate as the sizes of the files when they were added.
+void BESCacheIndex::sub_size(uint64_t size)
+{
+    uint64_t current = d_header->size.load(memory_order_relaxed);
+    while (!d_header->size.compare_exchange_weak(current, current > size ? current - size : 0,
+        memory_order_acq_rel)) {
+    }
+}
+
+/**
+ * Find the slot that holds \arg name. Probing starts at a place in the
+ * name's shard chosen by its hash and does not leave the shard.
+ *
+ * @return The slot or no_slot
+ */
+uint64_t BESCacheIndex::find(const string &name, uint64_t h) const
+{
+    uint64_t first = (h % shard_count) * d_slots_per_shard;
+    uint64_t start = (h / shard_count) % d_slots_per_shard;
+
+    for (uint64_t probe = 0; probe < d_slots_per_shard; ++probe) {
+        uint64_t slot = first + (start + probe) % d_slots_per_shard;
+        const Slot &s = d_slots[slot];
+
+        uint32_t state = s.state.load(memory_order_acquire);
+        if (state == EMPTY)
+            return no_slot;
+
+        if (state == USED && s.hash.load(memory_order_relaxed) == h && s.name_length == name.size()
+            && memcmp(s.name, name.data(), name.size()) == 0)
+            return slot;
+    }
+
+    return no_slot;
+}
+
+/**
+ * @brief Add a file to the index, or update its size if it is there
+ *
+ * Needs a write lock on the name's shard.
+ *
+ * @param name The file
+ * @param size Its size in bytes
+ * @param atime Its last access time
+ * @return False if the name is too long or the shard is full
+ */
+bool BESCacheIndex::add(const string &name, uint64_t size, time_t atime)
+{
+    if (name.size() > max_name_length)
+        return false;
+
+    uint64_t h = hash(name);
+    uint64_t slot = find(name, h);
+    if (slot != no_slot) {
+        Slot &s = d_slots[slot];
+        sub_size(s.size.load(memory_order_relaxed));
+        s.size.store(size, memory_order_relaxed);
+        s.atime.store(atime, memory_order_relaxed);
+        d_header->size.fetch_add(size, memory_order_acq_rel);
+        return true;
+    }
+
+    uint64_t first = (h % shard_count) * d_slots_per_shard;
+    uint64_t start = (h / shard_count) % d_slots_per_shard;
+
+    for (uint64_t probe = 0; probe < d_slots_per_shard; ++probe) {
+        Slot &s = d_slots[first + (start + probe) % d_slots_per_shard];
+        if (s.state.load(memory_order_acquire) != USED) {
+            memcpy(s.name, name.data(), name.size());
+            s.name[name.size()] = '\0';
+            s.name_length = name.size();
+            s.hash.store(h, memory_order_relaxed);
+            s.size.store(size, memory_order_relaxed);
+            s.atime.store(atime, memory_order_relaxed);
+            s.state.store(USED, memory_order_release);
+
+            d_header->size.fetch_add(size, memory_order_acq_rel);
+            d_header->count.fetch_add(1, memory_order_acq_rel);
+
+            BESDEBUG(CACHE, prolog << name << " (" << size << " bytes)" << endl);
+            return true;
+        }
+    }
+
+    BESDEBUG(CACHE, prolog << "No room for " << name << " in shard " << h % shard_count << endl);
+    return false;
+}
+
+/**
+ * @brief Record a use of the file
+ *
+ * Needs a (read or write) lock on the name's shard.
+ *
+ * @return False if the file is not in the index
+ */
+bool BESCacheIndex::touch(const string &name, time_t atime)
+{
+    uint64_t slot = find(name, hash(name));
+    if (slot == no_slot)
+        return false;
+
+    d_slots[slot].atime.store(atime, memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Remove a file from the index
+ *
+ * Needs a write lock on the name's shard.
+ *
+ * @return False if the file is not in the index
+ */
+bool BESCacheIndex::remove(const string &name)
+{
+    uint64_t slot = find(name, hash(name));
+    if (slot == no_slot)
+        return false;
+
+    remove_slot(slot);
+    return true;
+}
+
+/**
+ * @brief Get the file held by a slot
+ *
+ * Needs a lock on the slot's shard.
+ *
+ * @param slot The slot, from get_slots_by_age()
+ * @param name Value-result parameter; the name of the file
+ * @param size Value-result parameter; its size in bytes
+ * @return False if the slot does not hold a file
+ */
+bool BESCacheIndex::get_slot(uint64_t slot, string &name, uint64_t &size) const
+{
+    const Slot &s = d_slots[slot];
+    if (s.state.load(memory_order_acquire) != USED)
+        return false;
+
+    name.assign(s.name, s.name_length);
+    size = s.size.load(memory_order_relaxed);
+    return true;
+}
+
+/// @brief Remove the file held by a slot. Needs a write lock on the slot's shard.
+void BESCacheIndex::remove_slot(uint64_t slot)
+{
+    Slot &s = d_slots[slot];
+    if (s.state.load(memory_order_acquire) != USED)
+        return;
+
+    // The probe sequence for another name can go through this slot, so
+    // the slot is marked, not emptied.
+    s.state.store(TOMBSTONE, memory_order_release);
+
+    sub_size(s.size.load(memory_order_relaxed));
+    d_header->count.fetch_sub(1, memory_order_acq_rel);
+}
+
+/// @brief Remove every file from the index. Needs write locks on all of the shards.
+void BESCacheIndex::clear()
+{
+    memset(static_cast<void *>(d_slots), 0, shard_count * d_slots_per_shard * sizeof(Slot));
+    d_header->size.store(0, memory_order_release);
+    d_header->count.store(0, memory_order_release);
+}
+
+/**
+ * @brief The slots that hold files, least recently used first
+ *
+ * This does not lock the index, so the slots can change before they are
+ * used; get_slot() must be called with the slot's shard locked to see what
+ * the slot holds.
+ *
+ * @param slots Value-result parameter; the last access time and slot of
+ * each file.
+ */
+void BESCacheIndex::get_slots_by_age(vector<pair<time_t, uint64_t> > &slots) const
+{
+    slots.reserve(get_count());
+
+    for (uint64_t slot = 0, e = get_capacity(); slot < e; ++slot) {
+        const Slot &s = d_slots[slot];
+        if (s.state.load(memory_order_acquire) == USED)
+            slots.push_back(make_pair((time_t) s.atime.load(memory_order_relaxed), slot));
+    }
+
+    sort(slots.begin(), slots.end());
+}
+
+bool BESCacheIndex::set_lock(short type, off_t start, off_t len, bool wait)
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = start;
+    lock.l_len = len;
+
+    while (fcntl(d_fd, wait ? F_SETLKW : F_SETLK, &lock) == -1) {
+        if (!wait && (errno == EAGAIN || errno == EACCES))
+            return false;
+
+        if (errno != EINTR)
+            throw BESInternalError(prolog + "Could not lock the cache index " + d_path + ": " + get_errno(), __FILE__,
+                __LINE__);
+    }
+
+    return true;
+}
+
+/// @brief Lock a shard; blocks. @param type F_RDLCK or F_WRLCK
+void BESCacheIndex::lock_shard(unsigned int shard, short type)
+{
+    BESDEBUG(LOCK, prolog << "shard: " << shard << (type == F_WRLCK ? " (write)" : " (read)") << endl);
+
+    set_lock(type, shard_lock_base + shard, 1, true);
+}
+
+/// @brief Lock a shard if no other process has it locked. @return True if locked
+bool BESCacheIndex::try_lock_shard(unsigned int shard, short type)
+{
+    return set_lock(type, shard_lock_base + shard, 1, false);
+}
+
+/// @note Does not throw, so it can be used in a destructor
+void BESCacheIndex::unlock_shard(unsigned int shard)
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start = shard_lock_base + shard;
+    lock.l_len = 1;
+
+    if (fcntl(d_fd, F_SETLK, &lock) == -1)
+        ERROR_LOG(prolog << "Could not unlock shard " << shard << " of the cache index " << d_path << ": "
+            << get_errno() << endl);
+}
+
+/// @brief Lock all of the shards in one operation; blocks. @param type F_RDLCK or F_WRLCK
+void BESCacheIndex::lock_all_shards(short type)
+{
+    set_lock(type, shard_lock_base, shard_count, true);
+}
+
+void BESCacheIndex::unlock_all_shards()
+{
+    set_lock(F_UNLCK, shard_lock_base, shard_count, false);
+}
+
+/// @brief Get the purge lock if no other process is purging. @return True if locked
+bool BESCacheIndex::try_lock_purge()
+{
+    return set_lock(F_WRLCK, purge_lock_byte, 1, false);
+}
+
+void BESCacheIndex::unlock_purge()
+{
+    set_lock(F_UNLCK, purge_lock_byte, 1, false);
+}
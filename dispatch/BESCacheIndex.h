@@ -0,0 +1,163 @@
+// BESCacheIndex.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef BESCacheIndex_h_
+#define BESCacheIndex_h_ 1
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <cstdint>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ * @brief An index of the files in a BESFileLockingCache
+ *
+ * The index is a memory-mapped file in the cache directory that every
+ * process using the cache maps. It records the name, size and last access
+ * time of each file in the cache and the total size of the cache, so adding
+ * a file to the cache, finding out how big the cache is and choosing the
+ * files to purge do not read the cache directory or stat(2) its files.
+ *
+ * The index is an open-addressing hash table split into shards. A name's
+ * shard is chosen by its hash and its entry is always in that shard. Each
+ * shard is guarded by a fcntl(2) lock on a byte of the index file, so
+ * processes working with files in different shards do not wait for one
+ * another. Another byte is the purge lock; it keeps two processes from
+ * purging at the same time. The total size and number of entries are
+ * updated with atomic operations, so they can be read without a lock.
+ *
+ * If a shard has no room for an entry, the index is marked as not valid.
+ * BESFileLockingCache then uses the cache directory, as it did before the
+ * index was added, until it rebuilds the index from the directory.
+ *
+ * @note Like the rest of BESFileLockingCache, the locks are per process.
+ * Every process that uses a cache must use the same index settings.
+ */
+class BESCacheIndex {
+private:
+    struct Header;
+    struct Slot;
+
+    int d_fd;
+    std::string d_path;
+
+    char *d_map;
+    uint64_t d_map_size;
+
+    Header *d_header;
+    Slot *d_slots;
+
+    uint64_t d_slots_per_shard;
+
+    static uint64_t hash(const std::string &name);
+
+    uint64_t find(const std::string &name, uint64_t h) const;
+    void sub_size(uint64_t size);
+
+    void format();
+    bool set_lock(short type, off_t start, off_t len, bool wait);
+
+    BESCacheIndex(const BESCacheIndex &);
+    BESCacheIndex &operator=(const BESCacheIndex &);
+
+public:
+    static const unsigned int shard_count = 64;
+
+    /// The longest name the index can hold
+    static const unsigned int max_name_length = 479;
+
+    BESCacheIndex(const std::string &path, uint64_t entries);
+    virtual ~BESCacheIndex();
+
+    const std::string &get_path() const { return d_path; }
+
+    bool is_valid() const;
+    bool set_valid(bool valid);
+
+    uint64_t get_size() const;
+    uint64_t get_count() const;
+
+    /// @brief Number of entries the index can hold
+    uint64_t get_capacity() const { return shard_count * d_slots_per_shard; }
+
+    unsigned int shard(const std::string &name) const { return hash(name) % shard_count; }
+
+    /// @brief The shard that holds slot \arg slot
+    unsigned int slot_shard(uint64_t slot) const { return slot / d_slots_per_shard; }
+
+    // These need the lock for the name's shard; add() and remove() a write lock
+    bool add(const std::string &name, uint64_t size, time_t atime);
+    bool touch(const std::string &name, time_t atime);
+    bool remove(const std::string &name);
+
+    // These need the lock for the slot's shard; remove_slot() a write lock
+    bool get_slot(uint64_t slot, std::string &name, uint64_t &size) const;
+    void remove_slot(uint64_t slot);
+
+    // Called with all of the shards write locked
+    void clear();
+
+    void get_slots_by_age(std::vector<std::pair<time_t, uint64_t> > &slots) const;
+
+    void lock_shard(unsigned int shard, short type);
+    bool try_lock_shard(unsigned int shard, short type);
+    void unlock_shard(unsigned int shard);
+
+    void lock_all_shards(short type);
+    void unlock_all_shards();
+
+    bool try_lock_purge();
+    void unlock_purge();
+
+    /**
+     * @brief Hold a shard lock until the end of a scope
+     */
+    class ShardLock {
+    private:
+        BESCacheIndex &d_index;
+        unsigned int d_shard;
+
+        ShardLock(const ShardLock &);
+        ShardLock &operator=(const ShardLock &);
+
+    public:
+        /// @brief Lock the shard that holds \arg name; F_RDLCK or F_WRLCK
+        ShardLock(BESCacheIndex &index, const std::string &name, short type) :
+            d_index(index), d_shard(index.shard(name))
+        {
+            d_index.lock_shard(d_shard, type);
+        }
+
+        ~ShardLock()
+        {
+            d_index.unlock_shard(d_shard);
+        }
+    };
+};
+
+#endif // BESCacheIndex_h_
@@ -36,6 +36,7 @@
 
 #include "BESContainerStorageList.h"
 #include "BESContainerStorage.h"
+#include "BESContainerStorageVolatile.h"
 #include "BESSyntaxUserError.h"
 #include "BESContainer.h"
 #include "TheBESKeys.h"
@@ -327,6 +328,25 @@ BESContainerStorageList::delete_container(const std::string &sym_name)
     }
 }
 
+/** @brief delete the containers defined by clients
+ *
+ * Remove all of the containers held in volatile stores; containers read
+ * from files are kept. A pre-forked beslistener calls this between client
+ * connections, so it starts each connection with the containers a newly
+ * forked beslistener would have.
+ */
+void
+BESContainerStorageList::delete_volatile_containers()
+{
+    BESContainerStorageList::persistence_list *pl = _first;
+    while (pl) {
+        if (dynamic_cast<BESContainerStorageVolatile *>(pl->_persistence_obj))
+            (void) pl->_persistence_obj->del_containers();
+
+        pl = pl->_next;
+    }
+}
+
 /** @brief show information for each container in each persistence store
  *
  * For each container in each persistent store, add infomation about each of
@@ -96,6 +96,7 @@ public:
     // the ContainerStorage from the Container creation. jhrg 1/8/19
     virtual BESContainer *look_for(const std::string &sym_name);
     virtual void delete_container(const std::string &sym_name);
+    virtual void delete_volatile_containers();
 
     virtual void show_containers(BESInfo &info);
 
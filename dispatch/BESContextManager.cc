@@ -71,6 +71,17 @@ void BESContextManager::unset_context(const string &name)
     _context_list.erase(name);
 }
 
+/** @brief remove all of the contexts
+ *
+ * A pre-forked beslistener calls this between client connections so that
+ * one client's contexts are not used for the next client's commands.
+ */
+void BESContextManager::clear_contexts()
+{
+    BESDEBUG(MODULE, prolog << "Removing " << _context_list.size() << " contexts" << endl);
+    _context_list.clear();
+}
+
 /** @brief retrieve the value of the specified context from the BES
  *
  * Finds the specified context and returns its value
@@ -67,6 +67,7 @@ public:
 
     virtual void set_context(const std::string &name, const std::string &value);
     virtual void unset_context(const std::string &name);
+    virtual void clear_contexts();
     virtual std::string get_context(const std::string &name, bool &found);
     virtual int get_context_int(const std::string &name, bool &found);
 
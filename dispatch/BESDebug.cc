@@ -35,9 +35,11 @@
 #include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <vector>
 
 #include <pthread.h>
 
@@ -50,6 +52,89 @@ using namespace std;
 ostream *BESDebug::_debug_strm = NULL;
 bool BESDebug::_debug_strm_created = false;
 map<string, bool> BESDebug::_debug_map;
+atomic<bool> BESDebug::_any_set(false);
+
+namespace {
+
+// The handles that have been used, so Set() can update them. Allocated once
+// and never deleted so handles destroyed at exit can still remove themselves.
+struct HandleRegistry {
+    mutex lock;
+    vector<BESDebugHandle *> handles;
+};
+
+HandleRegistry &handle_registry()
+{
+    static HandleRegistry *registry = new HandleRegistry;
+    return *registry;
+}
+
+// Serializes the writes to the debug stream so messages from different
+// threads are not interleaved.
+mutex &debug_write_mutex()
+{
+    static mutex *write_mutex = new mutex;
+    return *write_mutex;
+}
+
+}
+
+/** @brief Read the value of the handle's context and record the handle
+ *
+ * @return The value of the context
+ */
+bool BESDebugHandle::attach()
+{
+    HandleRegistry &registry = handle_registry();
+    lock_guard<mutex> lock(registry.lock);
+
+    int state = d_state.load();
+    if (state < 0) {
+        registry.handles.push_back(this);
+        state = BESDebug::IsSet(d_name) ? 1 : 0;
+        d_state.store(state);
+    }
+
+    return state != 0;
+}
+
+BESDebugHandle::~BESDebugHandle()
+{
+    if (d_state.load() < 0) return;
+
+    HandleRegistry &registry = handle_registry();
+    lock_guard<mutex> lock(registry.lock);
+    registry.handles.erase(remove(registry.handles.begin(), registry.handles.end(), this), registry.handles.end());
+}
+
+/** @brief Update the handles, and the flag IsSet() tests, after a context changes
+ */
+void BESDebug::update_handles()
+{
+    bool any_set = false;
+    for (debug_citer i = _debug_map.begin(), e = _debug_map.end(); i != e && !any_set; ++i)
+        any_set = i->second;
+    _any_set.store(any_set);
+
+    HandleRegistry &registry = handle_registry();
+    lock_guard<mutex> lock(registry.lock);
+    for (BESDebugHandle *handle : registry.handles)
+        handle->d_state.store(IsSet(handle->d_name) ? 1 : 0);
+}
+
+/** @brief Write one message to the debug stream
+ *
+ * BESDEBUG() builds each message in a string and writes it with this, so
+ * messages written by different threads are not mixed together.
+ *
+ * @param msg The message
+ */
+void BESDebug::Write(const string &msg)
+{
+    lock_guard<mutex> lock(debug_write_mutex());
+    ostream *strm = _debug_strm ? _debug_strm : &cerr;
+    *strm << msg << flush;
+}
 
 
 /** @brief Returns debug log line prefix containing date&time, pid, and thread id.
@@ -61,7 +146,8 @@ string get_debug_log_line_prefix()
     ostringstream strm;
     // Time Field
     const time_t sctime = time(NULL);
-    const struct tm *sttime = localtime(&sctime);
+    struct tm sttime_r;
+    const struct tm *sttime = localtime_r(&sctime, &sttime_r);
     char zone_name[10];
     strftime(zone_name, sizeof(zone_name), "%Z", sttime);
 
@@ -36,8 +36,10 @@
 #ifndef I_BESDebug_h
 #define I_BESDebug_h 1
 
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 #include <mutex>
 
@@ -65,11 +67,23 @@ static std::mutex bes_debug_log_mutex;
 #if 0
 #define BESDEBUG( x, y ) do { std::unique_lock<std::mutex> lck (bes_debug_log_mutex); if( BESDebug::IsSet( x ) ) {  *(BESDebug::GetStrm()) << get_debug_log_line_prefix() << "["<< x << "] " << y; } } while( 0 )
 #else
-#define BESDEBUG( x, y ) do { if( BESDebug::IsSet( x ) ) *(BESDebug::GetStrm()) << get_debug_log_line_prefix() << "["<< x << "] " << y ; } while( 0 )
+#define BESDEBUG( x, y ) do { if( BESDebug::Level( x ) <= BES_DEBUG_MAX_LEVEL && BESDebug::IsSet( x ) ) { \
+    std::ostringstream bes_debug_oss_; bes_debug_oss_ << get_debug_log_line_prefix() << "["<< x << "] " << y ; \
+    BESDebug::Write( bes_debug_oss_.str() ); } } while( 0 )
 #endif
 
 #endif // NDEBUG
 
+/** @brief The most verbose debug channel compiled into the BES
+ *
+ * BESDEBUG() statements for a BESDebugChannel whose level is greater than
+ * this are removed by the compiler. Set it with configure's --with-debug-level.
+ * Contexts named by strings have level 1.
+ */
+#ifndef BES_DEBUG_MAX_LEVEL
+#define BES_DEBUG_MAX_LEVEL 9
+#endif
+
 #ifdef NDEBUG
 #define BESISDEBUG( x ) (false)
 #else
@@ -96,6 +110,70 @@ static std::mutex bes_debug_log_mutex;
 #define BESISDEBUG( x ) BESDebug::IsSet( x )
 #endif
 
+/** @brief A debug context looked up once and then tested without a map lookup
+ *
+ * The first time is_set() is called the handle reads the context's value
+ * from BESDebug and records itself so that BESDebug::Set() can update it.
+ * After that, is_set() is one atomic load. Use BESDebugChannel to declare
+ * handles.
+ */
+class BESDebugHandle {
+private:
+    std::string d_name;
+    std::atomic<int> d_state; // -1 until first used, then 0 or 1
+
+    bool attach();
+
+    friend class BESDebug;
+
+public:
+    explicit BESDebugHandle(const std::string &name) : d_name(name), d_state(-1)
+    {
+    }
+
+    BESDebugHandle(const BESDebugHandle &) = delete;
+    BESDebugHandle &operator=(const BESDebugHandle &) = delete;
+
+    ~BESDebugHandle();
+
+    const std::string &name() const
+    {
+        return d_name;
+    }
+
+    bool is_set()
+    {
+        int state = d_state.load(std::memory_order_relaxed);
+        return state < 0 ? attach() : state != 0;
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &strm, const BESDebugHandle &handle)
+{
+    return strm << handle.name();
+}
+
+/** @brief A debug context handle with a verbosity level
+ *
+ * Declare these once, at file scope, for contexts used in loops:
+ *
+ * static BESDebugChannel<3> dmrpp_3("dmrpp:3");
+ * ...
+ * BESDEBUG(dmrpp_3, "Chunk: " << i << endl);
+ *
+ * If Level is greater than BES_DEBUG_MAX_LEVEL, the BESDEBUG statements
+ * that use the channel are compiled out.
+ */
+template<int Level = 1>
+class BESDebugChannel: public BESDebugHandle {
+public:
+    static const int level = Level;
+
+    explicit BESDebugChannel(const std::string &name) : BESDebugHandle(name)
+    {
+    }
+};
+
 class BESDebug {
 private:
     typedef std::map<std::string, bool> DebugMap;
@@ -104,8 +182,13 @@ private:
     static std::ostream *_debug_strm;
     static bool _debug_strm_created;
 
+    // True if any context is set; lets IsSet() skip building a string
+    static std::atomic<bool> _any_set;
+
     typedef DebugMap::iterator _debug_iter;
 
+    static void update_handles();
+
 public:
     typedef DebugMap::const_iterator debug_citer;
 
@@ -134,6 +217,7 @@ public:
             }
         }
         _debug_map[flagName] = value;
+        update_handles();
     }
 
     /** @brief register the specified debug flag
@@ -157,6 +241,7 @@ public:
             else {
                 _debug_map[flagName] = true;
             }
+            update_handles();
         }
     }
 
@@ -167,6 +252,9 @@ public:
      */
     static bool IsSet(const std::string &flagName)
     {
+        if (!_any_set.load(std::memory_order_relaxed))
+            return false;
+
         debug_citer i = _debug_map.find(flagName);
         if (i != _debug_map.end())
             return (*i).second;
@@ -178,6 +266,48 @@ public:
             return false;
     }
 
+    /** @brief see if the debug context flagName is set to true
+     *
+     * When no context is set, this returns without making a std::string.
+     */
+    static bool IsSet(const char *flagName)
+    {
+        return _any_set.load(std::memory_order_relaxed) && IsSet(std::string(flagName));
+    }
+
+    /** @brief see if the debug context of a handle is set to true
+     */
+    static bool IsSet(BESDebugHandle &handle)
+    {
+        return handle.is_set();
+    }
+
+    /** @brief the verbosity level of a debug context
+     *
+     * Used by BESDEBUG() to compile out the statements of channels above
+     * BES_DEBUG_MAX_LEVEL.
+     */
+    static constexpr int Level(const char *)
+    {
+        return 1;
+    }
+
+    static int Level(const std::string &)
+    {
+        return 1;
+    }
+
+    static int Level(const BESDebugHandle &)
+    {
+        return 1;
+    }
+
+    template<int L>
+    static constexpr int Level(const BESDebugChannel<L> &)
+    {
+        return L;
+    }
+
     /** @brief return the debug stream
      *
      * Can be a file output stream or cerr
@@ -226,6 +356,8 @@ public:
         }
     }
 
+    static void Write(const std::string &msg);
+
     static void SetUp(const std::string &values);
     static void Help(std::ostream &strm);
     static bool IsContextName(const std::string &name);
@@ -49,6 +49,7 @@
 #endif
 
 #include "BESStatusResponseHandler.h"
+#include "BESMetricsResponseHandler.h"
 #include "BESServicesResponseHandler.h"
 #include "BESStreamResponseHandler.h"
 
@@ -111,6 +112,7 @@ int BESDefaultModule::initialize(int, char**)
 
     BESResponseHandlerList::TheList()->add_handler( VERS_RESPONSE, BESVersionResponseHandler::VersionResponseBuilder);
     BESResponseHandlerList::TheList()->add_handler( STATUS_RESPONSE, BESStatusResponseHandler::StatusResponseBuilder);
+    BESResponseHandlerList::TheList()->add_handler( METRICS_RESPONSE, BESMetricsResponseHandler::MetricsResponseBuilder);
     BESResponseHandlerList::TheList()->add_handler( SERVICE_RESPONSE, BESServicesResponseHandler::ResponseBuilder);
     BESResponseHandlerList::TheList()->add_handler( STREAM_RESPONSE, BESStreamResponseHandler::BESStreamResponseBuilder);
     BESResponseHandlerList::TheList()->add_handler( SETCONTAINER, BESSetContainerResponseHandler::SetContainerResponseBuilder);
@@ -156,6 +158,7 @@ int BESDefaultModule::terminate(void)
 
     BESResponseHandlerList::TheList()->remove_handler( VERS_RESPONSE );
     BESResponseHandlerList::TheList()->remove_handler( STATUS_RESPONSE );
+    BESResponseHandlerList::TheList()->remove_handler( METRICS_RESPONSE );
     BESResponseHandlerList::TheList()->remove_handler( SERVICE_RESPONSE );
     BESResponseHandlerList::TheList()->remove_handler( STREAM_RESPONSE );
     BESResponseHandlerList::TheList()->remove_handler( SETCONTAINER );
@@ -38,6 +38,7 @@ using std::ostream;
 
 #include "BESDefinitionStorageList.h"
 #include "BESDefinitionStorage.h"
+#include "BESDefinitionStorageVolatile.h"
 #include "BESDefine.h"
 #include "BESInfo.h"
 
@@ -255,6 +256,22 @@ BESDefinitionStorageList::look_for(const string &def_name)
     return ret_def;
 }
 
+/** @brief delete the definitions made by clients
+ *
+ * Remove all of the definitions held in volatile stores. A pre-forked
+ * beslistener calls this between client connections.
+ */
+void BESDefinitionStorageList::delete_volatile_definitions()
+{
+    BESDefinitionStorageList::persistence_list *pl = _first;
+    while (pl) {
+        if (dynamic_cast<BESDefinitionStorageVolatile *>(pl->_persistence_obj))
+            (void) pl->_persistence_obj->del_definitions();
+
+        pl = pl->_next;
+    }
+}
+
 /** @brief show information for each definition in each persistence store
  *
  * For each definition in each persistent store, add infomation about each of
@@ -88,6 +88,7 @@ public:
     virtual BESDefinitionStorage *find_persistence(const std::string &persist_name);
 
     virtual BESDefine * look_for(const std::string &def_name);
+    virtual void delete_volatile_definitions();
 
     virtual void show_definitions(BESInfo &info);
 
@@ -43,13 +43,16 @@
 #include <vector>
 #include <cstring>
 #include <cerrno>
+#include <ctime>
 
 #include "BESInternalError.h"
 
 #include "BESUtil.h"
 #include "BESDebug.h"
 #include "BESLog.h"
+#include "TheBESKeys.h"
 
+#include "BESCacheIndex.h"
 #include "BESFileLockingCache.h"
 
 // Symbols used with BESDEBUG.
@@ -58,6 +61,10 @@
 #define LOCK_STATUS "cache-lock-status"
 
 #define CACHE_CONTROL "cache_control"
+#define CACHE_INDEX "cache_index"
+
+#define USE_INDEX_KEY "BES.FileLockingCache.UseIndex"
+#define INDEX_ENTRIES_KEY "BES.FileLockingCache.IndexEntries"
 
 #define prolog std::string("BESFileLockingCache::").append(__func__).append("() - ")
 
@@ -70,6 +77,8 @@ static const unsigned long long BYTES_PER_MEG = 1048576ULL;
 // 2^64 / 2^20 == 2^44
 static const unsigned long long MAX_CACHE_SIZE_IN_MEGABYTES = (1ULL << 44);
 
+static const int DEFAULT_INDEX_ENTRIES = 16384;
+
 /** @brief Make an instance of FileLockingCache
  *
  * Instantiate the FileLockingClass, using the given values for the cache
@@ -93,11 +102,22 @@ static const unsigned long long MAX_CACHE_SIZE_IN_MEGABYTES = (1ULL << 44);
  */
 BESFileLockingCache::BESFileLockingCache(const string &cache_dir, const string &prefix, unsigned long long size) :
     d_cache_dir(cache_dir), d_prefix(prefix), d_max_cache_size_in_bytes(size), d_target_size(0), d_cache_info(""),
-    d_cache_info_fd(-1)
+    d_cache_info_fd(-1), d_index(0)
 {
     m_initialize_cache_info();
 }
 
+BESFileLockingCache::~BESFileLockingCache()
+{
+    delete d_index;
+    d_index = 0;
+
+    if (d_cache_info_fd != -1) {
+        close(d_cache_info_fd);
+        d_cache_info_fd = -1;
+    }
+}
+
 /** @brief Initialize an instance of FileLockingCache
  *
  * Initialize and instance of FileLockingCache using the passed values for the
@@ -418,6 +438,8 @@ bool BESFileLockingCache::m_initialize_cache_info()
         }
 
         BESDEBUG(CACHE,prolog << "d_cache_info_fd: " << d_cache_info_fd << endl);
+
+        m_initialize_index();
     }
 
     BESDEBUG(CACHE,prolog << "END [" << "CACHE IS " << (cache_enabled()?"ENABLED]":"DISABLED]") << endl);
@@ -425,6 +447,65 @@ bool BESFileLockingCache::m_initialize_cache_info()
     return status;
 }
 
+/**
+ * Open the cache index if the BES keys ask for one. If the index is new or
+ * not valid, build it from the cache directory. A cache index that cannot
+ * be opened is logged and the cache is used without one.
+ */
+void BESFileLockingCache::m_initialize_index()
+{
+    delete d_index;
+    d_index = 0;
+
+    bool use_index = false;
+    int entries = DEFAULT_INDEX_ENTRIES;
+    try {
+        use_index = TheBESKeys::TheKeys()->read_bool_key(USE_INDEX_KEY, false);
+        entries = TheBESKeys::TheKeys()->read_int_key(INDEX_ENTRIES_KEY, DEFAULT_INDEX_ENTRIES);
+    }
+    catch (BESError &e) {
+        // No configuration; some programs and tests use the cache without one
+        BESDEBUG(CACHE, prolog << "Could not read the cache index keys: " << e.get_message() << endl);
+    }
+
+    if (!use_index)
+        return;
+
+    string index_path = BESUtil::assemblePath(d_cache_dir, d_prefix + CACHE_INDEX, true);
+
+    // Until d_index is set, this locks only the cache info file
+    lock_cache_write();
+    try {
+        d_index = new BESCacheIndex(index_path, entries > 0 ? entries : DEFAULT_INDEX_ENTRIES);
+        d_index->lock_all_shards(F_WRLCK);
+
+        if (!d_index->is_valid()) {
+            CacheFiles contents;
+            unsigned long long size = m_collect_cache_dir_info(contents);
+            m_build_index(contents);
+
+            INFO_LOG(prolog << "Built the cache index " << index_path << ": " << contents.size() << " files, "
+                << (unsigned long) size << " bytes" << endl);
+        }
+
+        unlock_cache();
+    }
+    catch (BESError &e) {
+        unlock_cache();
+
+        // A broken index should not break the cache
+        ERROR_LOG(prolog << "Could not use the cache index " << index_path << ": " << e.get_message() << endl);
+        delete d_index;
+        d_index = 0;
+    }
+}
+
+/// Use the index only when it holds every file in the cache.
+inline bool BESFileLockingCache::m_use_index() const
+{
+    return d_index && d_index->is_valid();
+}
+
 static const string chars_excluded_from_filenames = "<>=,/()\\\"\':? []()$";
 
 /**
@@ -533,9 +614,26 @@ static bool getSharedLock(const string &file_name, int &ref_fd)
  * the file is/was not in the cache.
  * @throws Error if the attempt to get the (shared) lock failed for any
  * reason other than that the file does/did not exist.
+ *
+ * @note With a cache index, this locks only the index shard that holds
+ * \arg target and records the use of the file in the index.
  */
 bool BESFileLockingCache::get_read_lock(const string &target, int &fd)
 {
+#if USE_GET_SHARED_LOCK
+    if (m_use_index()) {
+        BESCacheIndex::ShardLock shard_lock(*d_index, target, F_RDLCK);
+
+        bool status = getSharedLock(target, fd);
+        if (status) {
+            m_record_descriptor(target, fd);
+            d_index->touch(target, time(0));
+        }
+
+        return status;
+    }
+#endif
+
     lock_cache_read();
 
     bool status = true;
@@ -588,9 +686,24 @@ bool BESFileLockingCache::get_read_lock(const string &target, int &fd)
  * descriptor reference is undefined - but likely -1).
  *
  * @throws BESBESInternalErroror if any error except EEXIST is returned by open(2) or
- * if fcntl(2) returns an error. */
+ * if fcntl(2) returns an error.
+ *
+ * @note With a cache index, this locks only the index shard that holds
+ * \arg target. */
 bool BESFileLockingCache::create_and_lock(const string &target, int &fd)
 {
+    if (m_use_index()) {
+        BESCacheIndex::ShardLock shard_lock(*d_index, target, F_WRLCK);
+
+        bool status = createLockedFile(target, fd);
+
+        BESDEBUG(LOCK, prolog << "target: " << target << " (status: " << status << ", fd: " << fd << ")" << endl);
+
+        if (status) m_record_descriptor(target, fd);
+
+        return status;
+    }
+
     lock_cache_write();
 
     bool status = createLockedFile(target, fd);
@@ -642,6 +755,8 @@ void BESFileLockingCache::exclusive_to_shared_lock(int fd)
  *
  * @note This is intended to be used internally only but might be useful in
  * some settings.
+ *
+ * @note If the cache has an index, all of its shards are locked too.
  */
 void BESFileLockingCache::lock_cache_write()
 {
@@ -652,11 +767,14 @@ void BESFileLockingCache::lock_cache_write()
             __LINE__);
     }
 
+    if (d_index) d_index->lock_all_shards(F_WRLCK);
+
     BESDEBUG(LOCK_STATUS,  prolog << "lock status: " << lockStatus(d_cache_info_fd) << endl);
 }
 
 /** Get a shared lock on the 'cache info' file.
  *
+ * @note If the cache has an index, all of its shards are locked too.
  */
 void BESFileLockingCache::lock_cache_read()
 {
@@ -667,6 +785,8 @@ void BESFileLockingCache::lock_cache_read()
             __LINE__);
     }
 
+    if (d_index) d_index->lock_all_shards(F_RDLCK);
+
     BESDEBUG(LOCK_STATUS,  prolog << "lock status: " << lockStatus(d_cache_info_fd) << endl);
 }
 
@@ -679,6 +799,8 @@ void BESFileLockingCache::unlock_cache()
 {
     BESDEBUG(LOCK,  prolog << "d_cache_info_fd: " << d_cache_info_fd << endl);
 
+    if (d_index) d_index->unlock_all_shards();
+
     if (fcntl(d_cache_info_fd, F_SETLK, lock(F_UNLCK)) == -1) {
         throw BESInternalError(prolog +"An error occurred trying to unlock the cache-control file" + get_errno(), __FILE__,
             __LINE__);
@@ -723,11 +845,42 @@ void BESFileLockingCache::unlock_and_close(const string &file_name)
  * method for its duration. This updates the cache info file and returns
  * the new size.
  *
+ * With a cache index, the file is added to the index, which holds the
+ * cache size, and only the index shard that holds \arg target is locked.
+ * If the index has no room for the file, the index is not used until the
+ * next purge rebuilds it from the cache directory.
+ *
  * @param target The name of the file
  * @return The new size of the cache
  */
 unsigned long long BESFileLockingCache::update_cache_info(const string &target)
 {
+    bool index_full = false;
+    if (m_use_index()) {
+        struct stat buf;
+        if (stat(target.c_str(), &buf) != 0)
+            throw BESInternalError(prolog + "Could not read the size of the new file: " + target + " : " + get_errno(), __FILE__,
+                __LINE__);
+
+        bool added;
+        {
+            BESCacheIndex::ShardLock shard_lock(*d_index, target, F_WRLCK);
+            added = d_index->add(target, buf.st_size, time(0));
+        }
+
+        if (added) {
+            BESDEBUG(CACHE,  prolog << "cache size updated to: " << d_index->get_size() << endl);
+            return d_index->get_size();
+        }
+
+        // Only the process that finds the index full starts the cache info file
+        // at the size held in the index.
+        index_full = d_index->set_valid(false);
+        if (index_full)
+            INFO_LOG(prolog << "The cache index " << d_index->get_path() << " is full; it will be rebuilt by the next purge."
+                << " Consider increasing " << INDEX_ENTRIES_KEY << endl);
+    }
+
     unsigned long long current_size;
     try {
         lock_cache_write();
@@ -736,7 +889,9 @@ unsigned long long BESFileLockingCache::update_cache_info(const string &target)
             throw BESInternalError(prolog + "Could not rewind to front of cache info file.", __FILE__, __LINE__);
 
         // read the size from the cache info file
-        if (read(d_cache_info_fd, &current_size, sizeof(unsigned long long)) != sizeof(unsigned long long))
+        if (index_full)
+            current_size = d_index->get_size();
+        else if (read(d_cache_info_fd, &current_size, sizeof(unsigned long long)) != sizeof(unsigned long long))
             throw BESInternalError(prolog + "Could not get read size info from the cache info file!", __FILE__, __LINE__);
 
         struct stat buf;
@@ -777,12 +932,15 @@ bool BESFileLockingCache::cache_too_big(unsigned long long current_size) const
 /** @brief Get the cache size.
  *
  * Read the size information from the cache info file and return it.
- * This methods locks the cache.
+ * This methods locks the cache. With a cache index, the size is read from
+ * the index without a lock.
  *
  * @return The size of the cache.
  */
 unsigned long long BESFileLockingCache::get_cache_size()
 {
+    if (m_use_index()) return d_index->get_size();
+
     unsigned long long current_size;
     try {
         lock_cache_read();
@@ -817,11 +975,14 @@ unsigned long long BESFileLockingCache::m_collect_cache_dir_info(CacheFiles &con
     struct dirent *dit;
     vector<string> files;
     // go through the cache directory and collect all of the files that
-    // start with the matching prefix
+    // start with the matching prefix, except the cache info and index files.
+    // The names are built the way get_cache_file_name() builds them so they
+    // match the names callers use.
     while ((dit = readdir(dip)) != NULL) {
         string dirEntry = dit->d_name;
-        if (dirEntry.compare(0, d_prefix.length(), d_prefix) == 0 && dirEntry != d_cache_info) {
-            files.push_back(d_cache_dir + "/" + dirEntry);
+        if (dirEntry.compare(0, d_prefix.length(), d_prefix) == 0 && dirEntry != d_prefix + CACHE_CONTROL
+            && dirEntry != d_prefix + CACHE_INDEX) {
+            files.push_back(BESUtil::assemblePath(d_cache_dir, dirEntry, true));
         }
     }
 
@@ -851,6 +1012,27 @@ unsigned long long BESFileLockingCache::m_collect_cache_dir_info(CacheFiles &con
     return current_size;
 }
 
+/**
+ * Private. Replace the contents of the cache index with \arg contents. If
+ * the index cannot hold all of the files, it is left marked as not valid.
+ * Called with the whole cache locked for writing.
+ */
+void BESFileLockingCache::m_build_index(const CacheFiles &contents)
+{
+    d_index->clear();
+
+    for (CacheFiles::const_iterator i = contents.begin(), e = contents.end(); i != e; ++i) {
+        if (!d_index->add(i->name, i->size, i->time)) {
+            d_index->set_valid(false);
+            INFO_LOG(prolog << "The cache index " << d_index->get_path() << " cannot hold the " << contents.size()
+                << " files in " << d_cache_dir << ". Consider increasing " << INDEX_ENTRIES_KEY << endl);
+            return;
+        }
+    }
+
+    d_index->set_valid(true);
+}
+
 /**
  * A non-blocking call to get an exclusive (write) lock on a file in the cache.
  * Because this cache uses per-process advisory locking, it's possible to
@@ -912,6 +1094,78 @@ bool BESFileLockingCache::get_exclusive_lock_nb(const string &target, int &fd)
     return getExclusiveLockNB(target, fd);
 }
 
+/**
+ * Private. Purge files using the cache index. The files are chosen from the
+ * index, least recently used first, and each is removed holding only the
+ * lock for its index shard. Shards and files other processes are using are
+ * skipped, as are all files when another process is already purging; that
+ * process will bring the size of the cache down.
+ *
+ * @param new_file Do not delete this file; see update_and_purge().
+ */
+void BESFileLockingCache::m_purge_with_index(const string &new_file)
+{
+    BESDEBUG(CACHE, prolog << "Current and target size (in MB) "
+        << d_index->get_size()/BYTES_PER_MEG << ", " << d_target_size/BYTES_PER_MEG << endl);
+
+    if (!cache_too_big(d_index->get_size())) return;
+
+    if (!d_index->try_lock_purge()) {
+        BESDEBUG(CACHE, prolog << "Another process is purging the cache." << endl);
+        return;
+    }
+
+    try {
+        vector<pair<time_t, uint64_t> > slots;
+        d_index->get_slots_by_age(slots);
+
+        for (vector<pair<time_t, uint64_t> >::iterator i = slots.begin(), e = slots.end();
+            i != e && d_index->get_size() > d_target_size; ++i) {
+            unsigned int shard = d_index->slot_shard(i->second);
+            if (!d_index->try_lock_shard(shard, F_WRLCK)) continue;
+
+            try {
+                // The slot may have changed since it was read
+                string name;
+                uint64_t size;
+                if (d_index->get_slot(i->second, name, size) && name != new_file) {
+                    int cfile_fd;
+                    if (getExclusiveLockNB(name, cfile_fd)) {
+                        BESDEBUG(CACHE, prolog << "purge: " << name << " removed." << endl);
+
+                        if (unlink(name.c_str()) != 0)
+                            throw BESInternalError(
+                                prolog + "Unable to purge the file " + name + " from the cache: " + get_errno(), __FILE__,
+                                __LINE__);
+
+                        unlock(cfile_fd);
+                        d_index->remove_slot(i->second);
+                    }
+                    else if (access(name.c_str(), F_OK) != 0 && errno == ENOENT) {
+                        // Removed by something other than this class
+                        d_index->remove_slot(i->second);
+                    }
+                }
+            }
+            catch (...) {
+                d_index->unlock_shard(shard);
+                throw;
+            }
+
+            d_index->unlock_shard(shard);
+        }
+    }
+    catch (...) {
+        d_index->unlock_purge();
+        throw;
+    }
+
+    d_index->unlock_purge();
+
+    BESDEBUG(CACHE, prolog << "Current and target size (in MB) "
+        << d_index->get_size()/BYTES_PER_MEG << ", " << d_target_size/BYTES_PER_MEG << endl);
+}
+
 
 /** @brief Purge files from the cache
  *
@@ -927,6 +1181,10 @@ bool BESFileLockingCache::get_exclusive_lock_nb(const string &target, int &fd)
  * added to the cache. Using fcntl(2) locking there is no way this process can
  * detect its own lock, so the shared read lock on the new file won't keep this
  * process from deleting it (but will keep other processes from deleting it).
+ *
+ * @note With a cache index, the cache is not locked; see m_purge_with_index().
+ * If the index is not valid, the purge reads the cache directory and then
+ * rebuilds the index from the files that are left.
  */
 void BESFileLockingCache::update_and_purge(const string &new_file)
 {
@@ -937,6 +1195,11 @@ void BESFileLockingCache::update_and_purge(const string &new_file)
         return;
     }
 
+    if (m_use_index()) {
+        m_purge_with_index(new_file);
+        return;
+    }
+
     try {
         lock_cache_write();
 
@@ -976,8 +1239,11 @@ void BESFileLockingCache::update_and_purge(const string &new_file)
 
                     unlock(cfile_fd);
                     computed_size -= i->size;
+                    i = contents.erase(i);
+                }
+                else {
+                    ++i;
                 }
-                ++i;
 
                 BESDEBUG(CACHE,prolog << "Current and target size (in MB) "
                     << computed_size/BYTES_PER_MEG << ", " << d_target_size/BYTES_PER_MEG << endl);
@@ -989,6 +1255,8 @@ void BESFileLockingCache::update_and_purge(const string &new_file)
 
         if (write(d_cache_info_fd, &computed_size, sizeof(unsigned long long)) != sizeof(unsigned long long))
             throw BESInternalError(prolog + "Could not write size info to the cache info file!", __FILE__, __LINE__);
+
+        if (d_index) m_build_index(contents);
 #if 0
         if (BESISDEBUG( "cache_contents" )) {
             contents.clear();
@@ -1079,6 +1347,24 @@ void BESFileLockingCache::purge_file(const string &file)
 {
     BESDEBUG(CACHE, prolog << "Starting the purge" << endl);
 
+    if (m_use_index()) {
+        BESCacheIndex::ShardLock shard_lock(*d_index, file, F_WRLCK);
+
+        int cfile_fd;
+        if (getExclusiveLock(file, cfile_fd)) {
+            BESDEBUG(CACHE,  prolog << "file: " << file << " removed." << endl);
+
+            if (unlink(file.c_str()) != 0)
+                throw BESInternalError(prolog + "Unable to purge the file " + file + " from the cache: " + get_errno(), __FILE__,
+                    __LINE__);
+
+            unlock(cfile_fd);
+        }
+
+        d_index->remove(file);
+        return;
+    }
+
     try {
         lock_cache_write();
 
@@ -1148,5 +1434,8 @@ void BESFileLockingCache::dump(ostream &strm) const
     strm << BESIndent::LMarg << "cache dir: " << d_cache_dir << endl;
     strm << BESIndent::LMarg << "prefix: " << d_prefix << endl;
     strm << BESIndent::LMarg << "size (bytes): " << d_max_cache_size_in_bytes << endl;
+    if (d_index)
+        strm << BESIndent::LMarg << "index: " << d_index->get_path() << (d_index->is_valid() ? "" : " (not valid)")
+            << ", " << d_index->get_count() << " of " << d_index->get_capacity() << " entries" << endl;
     BESIndent::UnIndent();
 }
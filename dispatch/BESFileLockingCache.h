@@ -49,6 +49,8 @@ typedef struct {
 
 typedef std::list<cache_entry> CacheFiles;
 
+class BESCacheIndex;
+
 /**
  * @brief Implementation of a caching mechanism for compressed data.
  *
@@ -75,6 +77,14 @@ typedef std::list<cache_entry> CacheFiles;
  * close + unlock operations are performed atomically. Other methods that operate
  * on the cache info file must only be called when the lock has been obtained.
  *
+ * If the BES key BES.FileLockingCache.UseIndex is true, the cache keeps a
+ * BESCacheIndex of its files. Adding, finding and removing a file then lock
+ * only the index shard that holds the file's name, the cache size is kept
+ * in the index and a purge chooses the files to remove from the index
+ * instead of reading the cache directory. Only one process purges at a
+ * time; the others do not wait for it. The whole-cache locks also lock all
+ * of the index's shards.
+ *
  * @note The locking mechanism uses Unix fcntl(2) and so is _per process_. That
  * means that while getting an exclusive lock in one process will keep other
  * processes from also getting an exclusive lock, it _will not_ prevent other
@@ -109,15 +119,23 @@ private:
     std::string d_cache_info;
     int d_cache_info_fd;
 
+    // Null unless BES.FileLockingCache.UseIndex is true
+    BESCacheIndex *d_index;
+
     // map that relates files to the descriptor used to obtain a lock
     typedef std::multimap<std::string, int> FilesAndLockDescriptors;
     FilesAndLockDescriptors d_locks;
 
     bool m_check_ctor_params();
     bool m_initialize_cache_info();
+    void m_initialize_index();
 
     unsigned long long m_collect_cache_dir_info(CacheFiles &contents);
 
+    bool m_use_index() const;
+    void m_build_index(const CacheFiles &contents);
+    void m_purge_with_index(const std::string &new_file);
+
     void m_record_descriptor(const std::string &file, int fd);
     int m_remove_descriptor(const std::string &file);
 #if USE_GET_SHARED_LOCK
@@ -130,17 +148,11 @@ private:
 public:
     // TODO Should cache_enabled be false given that cache_dir is empty? jhrg 2/18/18
     BESFileLockingCache(): d_cache_enabled(true), d_cache_dir(""), d_prefix(""), d_max_cache_size_in_bytes(0),
-        d_target_size(0), d_cache_info(""), d_cache_info_fd(-1) { }
+        d_target_size(0), d_cache_info(""), d_cache_info_fd(-1), d_index(0) { }
 
     BESFileLockingCache(const std::string &cache_dir, const std::string &prefix, unsigned long long size);
 
-    virtual ~BESFileLockingCache()
-    {
-        if (d_cache_info_fd != -1) {
-            close(d_cache_info_fd);
-            d_cache_info_fd = -1;
-        }
-    }
+    virtual ~BESFileLockingCache();
 
     void initialize(const std::string &cache_dir, const std::string &prefix, unsigned long long size);
 
@@ -0,0 +1,59 @@
+// BESFileSink.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef I_BESFileSink_h
+#define I_BESFileSink_h 1
+
+#include <sys/types.h>
+
+/**
+ * @brief A stream buffer that can send the contents of a file itself
+ *
+ * A stream buffer that writes to a file descriptor (e.g., PPTStreamBuf)
+ * implements this so that a file that is already on disk (a cached metadata
+ * response, a fileout temporary file) can be sent to the client without
+ * copying it through the ostream, using sendfile(2) where the OS has it.
+ *
+ * The dispatch code doesn't know what kind of stream buffer the response
+ * stream uses; BESUtil::file_to_stream() checks for this interface and
+ * copies the file through the stream when it's not there.
+ */
+class BESFileSink {
+public:
+    virtual ~BESFileSink() { }
+
+    /**
+     * @brief Send part of a file
+     *
+     * Anything already written to the stream buffer is sent first.
+     *
+     * @param fd Open for reading. Its file offset is not used or changed.
+     * @param offset Send the bytes starting here
+     * @param length Send this many bytes
+     * @return True if all of the bytes were sent, false if there was an error.
+     */
+    virtual bool send_file(int fd, off_t offset, off_t length) = 0;
+};
+
+#endif // I_BESFileSink_h
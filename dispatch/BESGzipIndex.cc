@@ -0,0 +1,764 @@
+// BESGzipIndex.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "BESInternalError.h"
+#include "BESDebug.h"
+#include "BESLog.h"
+
+#include "BESGzipIndex.h"
+
+#define MODULE "uncompress"
+#define prolog std::string("BESGzipIndex::").append(__func__).append("() - ")
+
+using namespace std;
+
+static const char magic[8] = "BESGZI1";
+static const uint32_t layout_version = 1;
+static const uint32_t byte_order_mark = 0x01020304;
+
+struct index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t src_size;
+    int64_t src_mtime;
+    uint64_t size;
+    uint64_t span;
+    uint64_t num_points;
+};
+
+static_assert(sizeof(index_header) == 56, "The gzip index header must be 56 bytes");
+
+// The most data deflate can refer back to
+static const unsigned int WINSIZE = 32768;
+
+// Read this much compressed data at a time
+static const unsigned int CHUNK = 16384;
+
+static void write_all(int fd, const char *data, size_t len, off_t offset, const string &what)
+{
+    while (len > 0) {
+        ssize_t bytes = pwrite(fd, data, len, offset);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            throw BESInternalError("Could not write " + what + ": " + strerror(errno), __FILE__, __LINE__);
+        data += bytes;
+        len -= bytes;
+        offset += bytes;
+    }
+}
+
+static int open_source(const string &src, struct stat &sb)
+{
+    int fd = open(src.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw BESInternalError("Could not open the compressed file " + src + ": " + strerror(errno), __FILE__,
+            __LINE__);
+
+    if (fstat(fd, &sb) != 0) {
+        close(fd);
+        throw BESInternalError("Could not stat the compressed file " + src + ": " + strerror(errno), __FILE__,
+            __LINE__);
+    }
+
+    return fd;
+}
+
+/**
+ * Record an access point
+ *
+ * @param bits Bits of the block in the byte before \arg in
+ * @param in Offset of the block in the file
+ * @param out Offset of the block's data in the decompressed data
+ * @param left Bytes left in the window, which is used as a ring buffer
+ * @param window The last 32KB written
+ */
+void BESGzipIndex::add_point(uint32_t bits, uint64_t in, uint64_t out, unsigned int left, const unsigned char *window)
+{
+    // Put the window in order, oldest data first
+    vector<unsigned char> ordered(WINSIZE);
+    if (left)
+        memcpy(ordered.data(), window + WINSIZE - left, left);
+    if (left < WINSIZE)
+        memcpy(ordered.data() + left, window, WINSIZE - left);
+
+    // Near the start of the data, only the data so far are a dictionary
+    uLong length = min(out, (uint64_t) WINSIZE);
+
+    Point point;
+    point.out = out;
+    point.in = in;
+    point.bits = bits;
+
+    if (length) {
+        uLongf compressed_length = compressBound(length);
+        vector<unsigned char> compressed(compressed_length);
+        if (compress2(compressed.data(), &compressed_length, ordered.data() + WINSIZE - length, length,
+            Z_DEFAULT_COMPRESSION) != Z_OK)
+            throw BESInternalError(prolog + "Could not compress an access point window.", __FILE__, __LINE__);
+        point.window.assign(reinterpret_cast<char *>(compressed.data()), compressed_length);
+    }
+
+    d_points.push_back(point);
+}
+
+/// @brief The last access point at or before \arg offset
+const BESGzipIndex::Point &BESGzipIndex::find_point(uint64_t offset) const
+{
+    if (d_points.empty())
+        throw BESInternalError(prolog + "The gzip index is empty.", __FILE__, __LINE__);
+
+    auto i = upper_bound(d_points.begin(), d_points.end(), offset,
+        [](uint64_t o, const Point &p) { return o < p.out; });
+
+    return *(i == d_points.begin() ? i : i - 1);
+}
+
+/**
+ * @brief Was this index made for the file \arg src as it is now?
+ *
+ * Compares the size and last modified time of \arg src with those of the
+ * file the index was built from.
+ */
+bool BESGzipIndex::is_current(const string &src) const
+{
+    struct stat sb;
+    if (empty() || stat(src.c_str(), &sb) != 0)
+        return false;
+
+    return (uint64_t) sb.st_size == d_src_size && (int64_t) sb.st_mtime == d_src_mtime;
+}
+
+/**
+ * @brief Build the index by decompressing a gzip file
+ *
+ * @param src The gzip file
+ * @param dest_fd If not -1, write the decompressed data here, from the
+ * file's current offset. The file is not closed.
+ * @exception BESInternalError if \arg src is not a gzip file, is damaged or
+ * cannot be read, or the data cannot be written.
+ */
+void BESGzipIndex::build(const string &src, int dest_fd)
+{
+    struct stat sb;
+    int fd = open_source(src, sb);
+
+    d_points.clear();
+    d_size = 0;
+    d_src_size = sb.st_size;
+    d_src_mtime = sb.st_mtime;
+
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 31) != Z_OK) {   // 31: gzip only
+        close(fd);
+        throw BESInternalError(prolog + "Could not initialize zlib.", __FILE__, __LINE__);
+    }
+
+    vector<unsigned char> input(CHUNK);
+    vector<unsigned char> window(WINSIZE);
+
+    try {
+        uint64_t totin = 0, totout = 0, last = 0;
+        int ret = Z_OK;
+        bool done = false;
+        while (!done) {
+            if (strm.avail_in == 0) {
+                ssize_t bytes = ::read(fd, input.data(), CHUNK);
+                if (bytes < 0)
+                    throw BESInternalError(prolog + "Could not read " + src + ": " + strerror(errno), __FILE__,
+                        __LINE__);
+                if (bytes == 0)
+                    throw BESInternalError(prolog + "The compressed file " + src + " is truncated.", __FILE__,
+                        __LINE__);
+                strm.avail_in = bytes;
+                strm.next_in = input.data();
+            }
+
+            // Inflate until the input is used up, a block ends or a member
+            // ends. The window is the output buffer, used as a ring.
+            do {
+                if (strm.avail_out == 0) {
+                    strm.avail_out = WINSIZE;
+                    strm.next_out = window.data();
+                }
+
+                unsigned char *written = strm.next_out;
+                totin += strm.avail_in;
+                totout += strm.avail_out;
+                ret = inflate(&strm, Z_BLOCK);
+                totin -= strm.avail_in;
+                totout -= strm.avail_out;
+
+                if (ret == Z_NEED_DICT || ret == Z_DATA_ERROR || ret == Z_MEM_ERROR)
+                    throw BESInternalError(prolog + "Could not decompress " + src + ": "
+                        + (strm.msg ? strm.msg : "zlib error " + to_string(ret)), __FILE__, __LINE__);
+
+                if (dest_fd != -1 && strm.next_out > written) {
+                    size_t len = strm.next_out - written;
+                    size_t off = 0;
+                    while (off < len) {
+                        ssize_t bytes = write(dest_fd, written + off, len - off);
+                        if (bytes < 0 && errno == EINTR)
+                            continue;
+                        if (bytes <= 0)
+                            throw BESInternalError(prolog + "Could not write uncompressed data for " + src + ": "
+                                + strerror(errno), __FILE__, __LINE__);
+                        off += bytes;
+                    }
+                }
+
+                if (ret == Z_STREAM_END)
+                    break;
+
+                // At the end of a block that is not the last one?
+                if ((strm.data_type & 128) && !(strm.data_type & 64) && (totout == 0 || totout - last > d_span)) {
+                    add_point(strm.data_type & 7, totin, totout, strm.avail_out, window.data());
+                    last = totout;
+                }
+            } while (strm.avail_in != 0);
+
+            if (ret == Z_STREAM_END) {
+                // Another gzip member may follow this one; anything else is ignored, as gzip does.
+                if (strm.avail_in == 0) {
+                    ssize_t bytes = ::read(fd, input.data(), CHUNK);
+                    if (bytes < 0)
+                        throw BESInternalError(prolog + "Could not read " + src + ": " + strerror(errno), __FILE__,
+                            __LINE__);
+                    strm.avail_in = bytes;
+                    strm.next_in = input.data();
+                }
+
+                if (strm.avail_in == 0 || strm.next_in[0] != 0x1f)
+                    done = true;
+                else
+                    inflateReset(&strm);
+            }
+        }
+
+        d_size = totout;
+    }
+    catch (...) {
+        inflateEnd(&strm);
+        close(fd);
+        d_points.clear();
+        throw;
+    }
+
+    inflateEnd(&strm);
+    close(fd);
+
+    BESDEBUG(MODULE, prolog << "Indexed " << src << ": " << d_size << " bytes, " << d_points.size()
+        << " access points" << endl);
+}
+
+/// State of a Reader's decompression
+struct BESGzipIndex::Reader::State {
+    z_stream strm;
+    vector<unsigned char> input;
+    uint64_t in;        // Offset in the file of the next input to read
+    uint64_t out;       // Offset in the decompressed data of the next output
+    bool active;        // Has start() been called?
+    bool raw;           // Decompressing a raw deflate stream from an access point?
+
+    State() : input(CHUNK), in(0), out(0), active(false), raw(false)
+    {
+        memset(&strm, 0, sizeof(strm));
+        if (inflateInit2(&strm, -15) != Z_OK)
+            throw BESInternalError("Could not initialize zlib.", __FILE__, __LINE__);
+    }
+
+    ~State()
+    {
+        inflateEnd(&strm);
+    }
+
+    void fill(int fd)
+    {
+        ssize_t bytes;
+        do {
+            bytes = pread(fd, input.data(), CHUNK, in);
+        } while (bytes < 0 && errno == EINTR);
+
+        if (bytes < 0)
+            throw BESInternalError(string("Could not read the compressed file: ") + strerror(errno), __FILE__,
+                __LINE__);
+        if (bytes == 0)
+            throw BESInternalError("The compressed file is truncated.", __FILE__, __LINE__);
+
+        in += bytes;
+        strm.avail_in = bytes;
+        strm.next_in = input.data();
+    }
+
+    void skip(int fd, size_t n)
+    {
+        while (n > 0) {
+            if (strm.avail_in == 0)
+                fill(fd);
+            size_t k = min(n, (size_t) strm.avail_in);
+            strm.next_in += k;
+            strm.avail_in -= k;
+            n -= k;
+        }
+    }
+};
+
+/**
+ * @param index The index of the file
+ * @param fd The gzip file, open for reading. Only pread(2) is used, so
+ * several Readers can share it. It is not closed.
+ */
+BESGzipIndex::Reader::Reader(const BESGzipIndex &index, int fd) :
+    d_index(index), d_fd(fd), d_offset(0), d_state(new State)
+{
+}
+
+BESGzipIndex::Reader::~Reader()
+{
+}
+
+/// Start decompressing at an access point
+void BESGzipIndex::Reader::start(const Point &point)
+{
+    State &s = *d_state;
+
+    if (inflateReset2(&s.strm, -15) != Z_OK)
+        throw BESInternalError(prolog + "Could not reset zlib.", __FILE__, __LINE__);
+
+    s.in = point.in;
+    s.strm.avail_in = 0;
+    if (point.bits) {
+        // The block starts in the byte before 'in'
+        s.in = point.in - 1;
+        s.fill(d_fd);
+        unsigned char byte = *s.strm.next_in++;
+        s.strm.avail_in--;
+        inflatePrime(&s.strm, point.bits, byte >> (8 - point.bits));
+    }
+
+    if (!point.window.empty()) {
+        vector<unsigned char> dictionary(WINSIZE);
+        uLongf length = WINSIZE;
+        if (::uncompress(dictionary.data(), &length, reinterpret_cast<const Bytef *>(point.window.data()),
+            point.window.size()) != Z_OK)
+            throw BESInternalError(prolog + "The gzip index holds a damaged window.", __FILE__, __LINE__);
+        inflateSetDictionary(&s.strm, dictionary.data(), length);
+    }
+
+    s.out = point.out;
+    s.raw = true;
+    s.active = true;
+}
+
+/// Decompress \arg len bytes into \arg buf; less only at the end of the data
+size_t BESGzipIndex::Reader::decompress(unsigned char *buf, size_t len)
+{
+    State &s = *d_state;
+
+    size_t total = 0;
+    while (total < len && s.out < d_index.d_size) {
+        if (s.strm.avail_in == 0)
+            s.fill(d_fd);
+
+        uInt want = min(len - total, (size_t) numeric_limits<uInt>::max());
+        s.strm.next_out = buf + total;
+        s.strm.avail_out = want;
+        int ret = inflate(&s.strm, Z_NO_FLUSH);
+        size_t produced = want - s.strm.avail_out;
+        total += produced;
+        s.out += produced;
+
+        if (ret == Z_STREAM_END) {
+            if (s.out >= d_index.d_size)
+                break;
+            // Another member follows. A raw stream leaves the member's
+            // trailer (CRC and length) unread; a gzip stream reads it.
+            if (s.raw)
+                s.skip(d_fd, 8);
+            if (inflateReset2(&s.strm, 31) != Z_OK)
+                throw BESInternalError(prolog + "Could not reset zlib.", __FILE__, __LINE__);
+            s.raw = false;
+        }
+        else if (ret != Z_OK && !(ret == Z_BUF_ERROR && s.strm.avail_in == 0)) {
+            throw BESInternalError(prolog + "Could not decompress: "
+                + (s.strm.msg ? s.strm.msg : "zlib error " + to_string(ret)), __FILE__, __LINE__);
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @brief Read decompressed data from the current offset
+ * @return The number of bytes read; less than \arg len only at the end of
+ * the data.
+ */
+size_t BESGzipIndex::Reader::read(char *buf, size_t len)
+{
+    if (d_offset >= d_index.d_size)
+        return 0;
+
+    len = min(len, (size_t) (d_index.d_size - d_offset));
+
+    State &s = *d_state;
+    const Point &point = d_index.find_point(d_offset);
+    if (!s.active || d_offset < s.out || point.out > s.out)
+        start(point);
+
+    unsigned char discard[CHUNK];
+    while (s.out < d_offset) {
+        size_t n = decompress(discard, min((uint64_t) CHUNK, d_offset - s.out));
+        if (n == 0)
+            throw BESInternalError(prolog + "The compressed file ended early.", __FILE__, __LINE__);
+    }
+
+    size_t n = decompress(reinterpret_cast<unsigned char *>(buf), len);
+    d_offset += n;
+
+    return n;
+}
+
+/**
+ * @brief Read decompressed data
+ *
+ * This makes a Reader for the read; use a Reader to read sequentially.
+ *
+ * @param src_fd The gzip file
+ * @param offset Offset in the decompressed data
+ * @param buf Read into this buffer
+ * @param len Read this many bytes
+ * @return The number of bytes read
+ */
+size_t BESGzipIndex::read(int src_fd, uint64_t offset, char *buf, size_t len) const
+{
+    Reader reader(*this, src_fd);
+    reader.seek(offset);
+
+    size_t total = 0;
+    while (total < len) {
+        size_t n = reader.read(buf + total, len - total);
+        if (n == 0)
+            break;
+        total += n;
+    }
+
+    return total;
+}
+
+/**
+ * @brief Decompress a gzip file using several threads
+ *
+ * The data between two access points are decompressed by one thread and
+ * written to their place in \arg dest_fd, so the file is decompressed in
+ * about the time it takes to decompress 1/threads of it.
+ *
+ * If decompressing any part fails, the first error is rethrown once the
+ * parts underway have finished.
+ *
+ * @param src The gzip file; the index must be current for it.
+ * @param dest_fd Write the data here, starting at offset zero. The file is
+ * not closed.
+ * @param threads The most threads to use, including this one
+ */
+void BESGzipIndex::extract(const string &src, int dest_fd, unsigned int threads) const
+{
+    struct stat sb;
+    int fd = open_source(src, sb);
+
+    size_t parts = d_points.size();
+    threads = min(threads, (unsigned int) parts);
+
+    BESDEBUG(MODULE, prolog << "Decompressing " << src << " in " << parts << " parts, " << threads
+        << " at a time" << endl);
+
+    std::atomic<size_t> next(0);
+    std::mutex error_lock;
+    std::exception_ptr error;
+
+    auto extractor = [&]() {
+        try {
+            Reader reader(*this, fd);
+            vector<char> buf(CHUNK * 4);
+            size_t i;
+            while ((i = next++) < parts) {
+                uint64_t offset = d_points[i].out;
+                uint64_t end = (i + 1 < parts) ? d_points[i + 1].out : d_size;
+                reader.seek(offset);
+                while (offset < end) {
+                    size_t n = reader.read(buf.data(), min((uint64_t) buf.size(), end - offset));
+                    if (n == 0)
+                        throw BESInternalError(prolog + "The compressed file " + src + " ended early.", __FILE__,
+                            __LINE__);
+                    write_all(dest_fd, buf.data(), n, offset, "uncompressed data for " + src);
+                    offset += n;
+                }
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(error_lock);
+            if (!error) error = std::current_exception();
+            next = parts;       // start no more parts
+        }
+    };
+
+    // This thread is one of the extractors
+    vector<std::thread> extractors;
+    try {
+        for (unsigned int t = 1; t < threads; ++t)
+            extractors.push_back(std::thread(extractor));
+    }
+    catch (std::system_error &e) {
+        ERROR_LOG(prolog << "Could not start a thread to decompress data: " << e.what() << endl);
+    }
+
+    extractor();
+
+    for (vector<std::thread>::iterator t = extractors.begin(), e = extractors.end(); t != e; ++t)
+        t->join();
+
+    close(fd);
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/**
+ * @brief Write the index to a file
+ *
+ * The layout, in the byte order of the host that wrote it:
+ *
+ *   "BESGZI1", uint32_t version, uint32_t byte order mark (0x01020304),
+ *   uint64_t size and int64_t mtime of the gzip file, uint64_t size of the
+ *   data, uint64_t span, uint64_t number of access points;
+ *   for each access point: uint64_t out, uint64_t in, uint32_t bits,
+ *   uint32_t length of the window, the window (compressed).
+ *
+ * @param fd Write here, starting at offset zero. The file is not closed.
+ */
+void BESGzipIndex::save(int fd) const
+{
+    index_header header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = layout_version;
+    header.byte_order_mark = byte_order_mark;
+    header.src_size = d_src_size;
+    header.src_mtime = d_src_mtime;
+    header.size = d_size;
+    header.span = d_span;
+    header.num_points = d_points.size();
+
+    string data(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (const auto &point: d_points) {
+        uint32_t window_length = point.window.size();
+        data.append(reinterpret_cast<const char *>(&point.out), sizeof(point.out));
+        data.append(reinterpret_cast<const char *>(&point.in), sizeof(point.in));
+        data.append(reinterpret_cast<const char *>(&point.bits), sizeof(point.bits));
+        data.append(reinterpret_cast<const char *>(&window_length), sizeof(window_length));
+        data.append(point.window);
+    }
+
+    write_all(fd, data.data(), data.size(), 0, "the gzip index");
+
+    BESDEBUG(MODULE, prolog << "Wrote " << data.size() << " bytes" << endl);
+}
+
+/**
+ * @brief Read an index written by save()
+ * @param fd Read from here, starting at offset zero. The file is not closed.
+ * @exception BESInternalError if the index is damaged or was written on a
+ * host with a different byte order.
+ */
+void BESGzipIndex::load(int fd)
+{
+    struct stat sb;
+    if (fstat(fd, &sb) != 0)
+        throw BESInternalError(prolog + "Could not stat the gzip index: " + strerror(errno), __FILE__, __LINE__);
+
+    string data(sb.st_size, '\0');
+    size_t total = 0;
+    while (total < data.size()) {
+        ssize_t bytes = pread(fd, &data[total], data.size() - total, total);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            throw BESInternalError(prolog + "Could not read the gzip index.", __FILE__, __LINE__);
+        total += bytes;
+    }
+
+    index_header header;
+    if (data.size() < sizeof(header))
+        throw BESInternalError(prolog + "The gzip index is truncated.", __FILE__, __LINE__);
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != layout_version)
+        throw BESInternalError(prolog + "Not a gzip index, or an unsupported version.", __FILE__, __LINE__);
+    if (header.byte_order_mark != byte_order_mark)
+        throw BESInternalError(prolog + "The gzip index was written on a host with a different byte order.",
+            __FILE__, __LINE__);
+
+    vector<Point> points;
+    size_t pos = sizeof(header);
+    for (uint64_t n = 0; n < header.num_points; ++n) {
+        Point point;
+        uint32_t window_length;
+        if (data.size() - pos < 24)
+            throw BESInternalError(prolog + "The gzip index is truncated.", __FILE__, __LINE__);
+        memcpy(&point.out, &data[pos], sizeof(point.out));
+        memcpy(&point.in, &data[pos + 8], sizeof(point.in));
+        memcpy(&point.bits, &data[pos + 16], sizeof(point.bits));
+        memcpy(&window_length, &data[pos + 20], sizeof(window_length));
+        pos += 24;
+
+        if (data.size() - pos < window_length)
+            throw BESInternalError(prolog + "The gzip index is truncated.", __FILE__, __LINE__);
+        if (point.bits > 7 || (point.bits && point.in == 0) || point.out > header.size
+            || (!points.empty() && point.out <= points.back().out))
+            throw BESInternalError(prolog + "The gzip index is damaged.", __FILE__, __LINE__);
+        point.window = data.substr(pos, window_length);
+        pos += window_length;
+
+        points.push_back(point);
+    }
+
+    if (points.empty() || points[0].out != 0)
+        throw BESInternalError(prolog + "The gzip index is damaged.", __FILE__, __LINE__);
+
+    d_points.swap(points);
+    d_src_size = header.src_size;
+    d_src_mtime = header.src_mtime;
+    d_size = header.size;
+    d_span = header.span;
+
+    BESDEBUG(MODULE, prolog << "Read " << d_points.size() << " access points" << endl);
+}
+
+/**
+ * @param index The index of \arg src; it is shared so that several streams
+ * can use one index.
+ * @param src The gzip file
+ * @param buffer_size Decompress this much at a time
+ * @exception BESInternalError if \arg src cannot be opened
+ */
+BESGzipStreamBuf::BESGzipStreamBuf(shared_ptr<const BESGzipIndex> index, const string &src, size_t buffer_size) :
+    d_index(index), d_fd(-1), d_buffer(buffer_size), d_buffer_offset(0)
+{
+    d_fd = open(src.c_str(), O_RDONLY);
+    if (d_fd < 0)
+        throw BESInternalError("Could not open the compressed file " + src + ": " + strerror(errno), __FILE__,
+            __LINE__);
+
+    d_reader.reset(new BESGzipIndex::Reader(*d_index, d_fd));
+    setg(d_buffer.data(), d_buffer.data(), d_buffer.data());
+}
+
+BESGzipStreamBuf::~BESGzipStreamBuf()
+{
+    d_reader.reset();
+    close(d_fd);
+}
+
+BESGzipStreamBuf::int_type BESGzipStreamBuf::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    d_buffer_offset += egptr() - eback();
+
+    size_t n;
+    try {
+        d_reader->seek(d_buffer_offset);
+        n = d_reader->read(d_buffer.data(), d_buffer.size());
+    }
+    catch (BESError &e) {
+        ERROR_LOG("BESGzipStreamBuf::underflow() - " << e.get_message() << endl);
+        n = 0;
+    }
+
+    setg(d_buffer.data(), d_buffer.data(), d_buffer.data() + n);
+    if (n == 0)
+        return traits_type::eof();
+
+    return traits_type::to_int_type(*gptr());
+}
+
+BESGzipStreamBuf::pos_type BESGzipStreamBuf::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    off_type base;
+    switch (dir) {
+    case ios_base::beg:
+        base = 0;
+        break;
+    case ios_base::cur:
+        base = d_buffer_offset + (gptr() - eback());
+        break;
+    case ios_base::end:
+        base = d_index->get_size();
+        break;
+    default:
+        return pos_type(off_type(-1));
+    }
+
+    return seekpos(pos_type(base + off), which);
+}
+
+BESGzipStreamBuf::pos_type BESGzipStreamBuf::seekpos(pos_type pos, ios_base::openmode which)
+{
+    off_type offset = pos;
+    if (!(which & ios_base::in) || offset < 0 || (uint64_t) offset > d_index->get_size())
+        return pos_type(off_type(-1));
+
+    // Keep the buffer if the new position is in it
+    if ((uint64_t) offset >= d_buffer_offset && (uint64_t) offset <= d_buffer_offset + (egptr() - eback())) {
+        setg(eback(), eback() + (offset - d_buffer_offset), egptr());
+    }
+    else {
+        d_buffer_offset = offset;
+        setg(d_buffer.data(), d_buffer.data(), d_buffer.data());
+    }
+
+    return pos;
+}
@@ -0,0 +1,172 @@
+// BESGzipIndex.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef BESGzipIndex_h_
+#define BESGzipIndex_h_ 1
+
+#include <cstdint>
+
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Random access to the data in a gzip file
+ *
+ * A gzip file can only be decompressed from the start, because each part of
+ * a deflate stream can refer to the 32KB of data before it. This index
+ * records, about every 'span' bytes of decompressed data, a place where
+ * decompression can start: the offset of a deflate block in the file, the
+ * bits of the block's first byte that belong to the previous block and the
+ * 32KB of data that come before it. (This is the method used by zran.c, in
+ * the zlib examples.)
+ *
+ * With the index, any part of the file can be read by decompressing from
+ * the access point before it (see Reader and BESGzipStreamBuf), and the
+ * whole file can be decompressed by several threads at once, each starting
+ * at a different access point (see extract()).
+ *
+ * The index is built by decompressing the whole file once (build()), which
+ * can write the data at the same time. It can be saved and loaded so it is
+ * built once for each file. The windows are stored compressed, so an index
+ * is small compared to the data.
+ *
+ * Files with several gzip members (e.g., made by concatenating gzip files)
+ * are supported.
+ */
+class BESGzipIndex {
+private:
+    struct Point {
+        uint64_t out;           // Offset in the decompressed data
+        uint64_t in;            // Offset in the file of the first whole byte of the block
+        uint32_t bits;          // Bits of the block in the byte before 'in'; 0-7
+        std::string window;     // The 32KB of data before 'out', compressed
+    };
+
+    std::vector<Point> d_points;
+
+    uint64_t d_span;
+    uint64_t d_size;            // Size of the decompressed data
+    uint64_t d_src_size;
+    int64_t d_src_mtime;
+
+    void add_point(uint32_t bits, uint64_t in, uint64_t out, unsigned int left, const unsigned char *window);
+    const Point &find_point(uint64_t offset) const;
+
+public:
+    /// Default distance between access points, in bytes of decompressed data
+    static const uint64_t default_span = 4 * 1024 * 1024;
+
+    /**
+     * @brief Read the decompressed data sequentially, starting anywhere
+     *
+     * A Reader keeps its decompression state, so reading sequentially does
+     * not go back to an access point for each read. Seeking backward, or
+     * forward past the next access point, starts again from the access
+     * point before the new position.
+     */
+    class Reader {
+    private:
+        struct State;
+
+        const BESGzipIndex &d_index;
+        int d_fd;
+        uint64_t d_offset;
+        std::unique_ptr<State> d_state;
+
+        void start(const Point &point);
+        size_t decompress(unsigned char *buf, size_t len);
+
+        Reader(const Reader &);
+        Reader &operator=(const Reader &);
+
+    public:
+        Reader(const BESGzipIndex &index, int fd);
+        virtual ~Reader();
+
+        /// @brief Read from here next
+        void seek(uint64_t offset) { d_offset = offset; }
+        uint64_t tell() const { return d_offset; }
+
+        size_t read(char *buf, size_t len);
+    };
+
+    explicit BESGzipIndex(uint64_t span = default_span) : d_span(span), d_size(0), d_src_size(0), d_src_mtime(0)
+    {
+    }
+
+    virtual ~BESGzipIndex()
+    {
+    }
+
+    /// @brief True until the index is built or loaded
+    bool empty() const { return d_points.empty(); }
+
+    /// @brief The size of the decompressed data
+    uint64_t get_size() const { return d_size; }
+
+    size_t get_num_points() const { return d_points.size(); }
+
+    bool is_current(const std::string &src) const;
+
+    void build(const std::string &src, int dest_fd = -1);
+
+    size_t read(int src_fd, uint64_t offset, char *buf, size_t len) const;
+
+    void extract(const std::string &src, int dest_fd, unsigned int threads) const;
+
+    void save(int fd) const;
+    void load(int fd);
+};
+
+/**
+ * @brief A seekable std::streambuf that reads the data in a gzip file
+ *
+ * Use with std::istream to read any part of a gzip file without
+ * decompressing it into a file first.
+ */
+class BESGzipStreamBuf: public std::streambuf {
+private:
+    std::shared_ptr<const BESGzipIndex> d_index;
+    int d_fd;
+    std::unique_ptr<BESGzipIndex::Reader> d_reader;
+    std::vector<char> d_buffer;
+    uint64_t d_buffer_offset;   // Offset of eback() in the decompressed data
+
+    BESGzipStreamBuf(const BESGzipStreamBuf &);
+    BESGzipStreamBuf &operator=(const BESGzipStreamBuf &);
+
+protected:
+    virtual int_type underflow();
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+public:
+    BESGzipStreamBuf(std::shared_ptr<const BESGzipIndex> index, const std::string &src,
+        size_t buffer_size = 64 * 1024);
+    virtual ~BESGzipStreamBuf();
+};
+
+#endif // BESGzipIndex_h_
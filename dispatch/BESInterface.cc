@@ -66,6 +66,8 @@
 
 #include "BESDebug.h"
 #include "BESStopWatch.h"
+#include "BESTrace.h"
+#include "BESMetrics.h"
 #include "BESTimeoutError.h"
 #include "BESInternalError.h"
 #include "BESInternalFatalError.h"
@@ -467,6 +469,12 @@ int BESInterface::execute_request(const string &from)
 #endif
     }
 
+    // Recorded in the request latency histogram by end_request()
+    d_start = std::chrono::steady_clock::now();
+
+    // Ended, and written out, by end_request()
+    BESTrace::start_request("BESInterface::execute_request");
+
     // TODO These never change for the life of a BES, so maybe they can move out of
     // code that runs for every request? jhrg 11/8/17
     d_dhi_ptr->set_output_stream(d_strm);
@@ -503,7 +511,9 @@ int BESInterface::execute_request(const string &from)
         //
         // The timeout is also set in execute_data_request_plan(). The alarm signal
         // handler (above), run when the timeout expires, will call longjmp with a
-        // return value of 1.
+        // return value of 1. The jump skips the destructors of the BESMetricScope
+        // objects opened by the plan, so their gauges are released below.
+        size_t metric_scopes = BESMetricScope::open_scopes();
         if (setjmp(timeout_jump) == 0) {
             timeout_jump_valid = true;
 
@@ -536,6 +546,8 @@ int BESInterface::execute_request(const string &from)
             timeout_jump_valid = false;
         }
         else {
+            BESMetricScope::release_scopes(metric_scopes);
+
             ostringstream oss;
             oss << "BES listener timeout after " << bes_timeout << " seconds." << ends;
             BESDEBUG("bes", oss.str() << endl );
@@ -622,12 +634,25 @@ int BESInterface::finish(int status)
 void BESInterface::end_request()
 {
     // now clean up any containers that were used in the request, release
-    // the resource
+    // the resource. The first container's type names the handler in the metrics.
+    string handler;
     d_dhi_ptr->first_container();
+    if (d_dhi_ptr->container) handler = d_dhi_ptr->container->get_container_type();
     while (d_dhi_ptr->container) {
         d_dhi_ptr->container->release();
         d_dhi_ptr->next_container();
     }
+
+    BESTrace::end_request(d_dhi_ptr->data[REQUEST_ID]);
+
+    string action = d_dhi_ptr->action.empty() ? "none" : d_dhi_ptr->action;
+    BESMetrics *metrics = BESMetrics::TheMetrics();
+    BESMetrics::observe(metrics->get_series(BESMetrics::histogram, METRICS_REQUEST_DURATION,
+        BESMetrics::label("action", action) + "," + BESMetrics::label("handler", handler.empty() ? "none" : handler),
+        "Time to execute a request and transmit the response, by action and handler"),
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - d_start).count());
+
+    metrics->write_file_if_due(time(0));
 }
 
 /** @brief dumps information about this object
@@ -33,6 +33,7 @@
 #ifndef BESInterface_h_
 #define BESInterface_h_ 1
 
+#include <chrono>
 #include <string>
 #include <ostream>
 
@@ -119,6 +120,7 @@ class BESInterface: public BESObj {
 private:
     std::ostream *d_strm;
     int d_timeout_from_keys; ///< Command timeout; can be overridden using setContext
+    std::chrono::steady_clock::time_point d_start; ///< When execute_request() was called
 
 protected:
     BESDataHandlerInterface *d_dhi_ptr; ///< Allocated by the child class
@@ -0,0 +1,706 @@
+// BESMetrics.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "BESMetrics.h"
+#include "BESInfo.h"
+#include "BESError.h"
+#include "BESInternalError.h"
+#include "BESDebug.h"
+#include "BESLog.h"
+#include "TheBESKeys.h"
+
+#define METRICS_FILE_KEY "BES.Metrics.File"
+#define METRICS_FILE_INTERVAL_KEY "BES.Metrics.FileInterval"
+#define METRICS_FILE_INTERVAL_DEFAULT 15
+#define METRICS_MAX_SERIES_KEY "BES.Metrics.MaxSeries"
+#define METRICS_MAX_SERIES_DEFAULT 512
+
+#define MODULE "metrics"
+#define prolog std::string("BESMetrics::").append(__func__).append("() - ")
+
+using namespace std;
+
+// The series live in memory shared by several processes, so the atomics
+// must not fall back on a (per process) lock.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "BESMetrics needs lock-free 64-bit atomics");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "BESMetrics needs lock-free 32-bit atomics");
+
+// Series states
+static const uint32_t EMPTY = 0;
+static const uint32_t BUSY = 1;     // Being added
+static const uint32_t READY = 2;
+
+// How long to wait for another process to add a series. A process that
+// dies while adding a series leaves it BUSY; it is then skipped.
+static const unsigned int busy_tries = 10000;
+
+// The histogram buckets written in the Prometheus format: 2^10 to 2^35
+// microseconds (about 1ms to 9.5 hours). These are bucket boundaries.
+static const unsigned int first_le_power = 10;
+static const unsigned int last_le_power = 35;
+
+static const double quantiles[] = { 0.5, 0.9, 0.99 };
+
+struct BESMetrics::Header {
+    uint32_t capacity;
+    std::atomic<uint64_t> dropped;      // Series that could not be added
+    std::atomic<int64_t> last_write;    // When BES.Metrics.File was last written
+    std::atomic<uint32_t> processes;    // Processes that have used a process gauge
+};
+
+// A process gauge's share of one process. The owner is the process' pid
+// and, in the upper half, a number no other process that used the gauges
+// has; a pid can be reused once the process that had it exits.
+struct ProcessSlot {
+    std::atomic<uint64_t> owner;
+    std::atomic<int64_t> value;
+};
+
+struct BESMetrics::Series {
+    std::atomic<uint32_t> state;
+    uint32_t type;
+    uint64_t hash;
+    char name[BESMetrics::max_name_length + 1];
+    char labels[BESMetrics::max_labels_length + 1];
+    char help[BESMetrics::max_help_length + 1];
+
+    std::atomic<int64_t> value;     // A counter or gauge; the number of observations of a histogram
+    std::atomic<uint64_t> sum_us;   // The sum of a histogram's observations
+    union {
+        std::atomic<uint64_t> buckets[BESMetrics::histogram_buckets];
+        ProcessSlot slots[BESMetrics::process_slots];    // Used by a process gauge
+    };
+};
+
+const unsigned int BESMetrics::max_name_length;
+const unsigned int BESMetrics::max_labels_length;
+const unsigned int BESMetrics::max_help_length;
+const unsigned int BESMetrics::histogram_buckets;
+const unsigned int BESMetrics::process_slots;
+const unsigned int BESMetricScope::max_open_scopes;
+
+namespace {
+
+/// A copy of a series, or a series made from others, to be written
+struct Sample {
+    string name;
+    string labels;
+    string help;
+    BESMetrics::Type type;
+    double value;
+    uint64_t sum_us;
+    vector<uint64_t> buckets;
+
+    bool operator<(const Sample &rhs) const
+    {
+        return name < rhs.name || (name == rhs.name && labels < rhs.labels);
+    }
+};
+
+/// FNV-1a of the name and labels
+uint64_t series_hash(const string &name, const string &labels)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (string::const_iterator i = name.begin(), e = name.end(); i != e; ++i) {
+        h ^= static_cast<unsigned char>(*i);
+        h *= 1099511628211ULL;
+    }
+    h ^= '{';
+    h *= 1099511628211ULL;
+    for (string::const_iterator i = labels.begin(), e = labels.end(); i != e; ++i) {
+        h ^= static_cast<unsigned char>(*i);
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+void copy_string(char *dest, const string &src, size_t max_length)
+{
+    size_t length = min(src.size(), max_length);
+    memcpy(dest, src.data(), length);
+    dest[length] = '\0';
+}
+
+const char *type_name(BESMetrics::Type type)
+{
+    switch (type) {
+    case BESMetrics::counter:
+        return "counter";
+    case BESMetrics::gauge:
+    case BESMetrics::process_gauge:
+        return "gauge";
+    case BESMetrics::histogram:
+        return "histogram";
+    }
+    return "untyped";
+}
+
+string format_double(double value)
+{
+    ostringstream oss;
+    oss << setprecision(12) << value;
+    return oss.str();
+}
+
+string series_name(const string &name, const string &labels)
+{
+    return labels.empty() ? name : name + "{" + labels + "}";
+}
+
+/// The value below which fraction q of the observations fall, in seconds
+double quantile(const Sample &sample, double q)
+{
+    uint64_t count = 0;
+    for (vector<uint64_t>::const_iterator i = sample.buckets.begin(), e = sample.buckets.end(); i != e; ++i)
+        count += *i;
+    if (count == 0) return 0;
+
+    uint64_t rank = max<uint64_t>(1, (uint64_t) ceil(q * count));
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < sample.buckets.size(); ++i) {
+        seen += sample.buckets[i];
+        if (seen >= rank) return BESMetrics::bucket_upper_bound(i) / 1.0e6;
+    }
+
+    return BESMetrics::bucket_upper_bound(sample.buckets.size() - 1) / 1.0e6;
+}
+
+/// Is the process that owns a process gauge slot running?
+bool owner_running(uint64_t owner)
+{
+    pid_t pid = static_cast<pid_t>(owner & 0xffffffff);
+    return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+} // namespace
+
+/**
+ * Map the memory for the series. It is shared with the processes this
+ * one forks from now on. If it cannot be mapped, the series are kept in
+ * this process' memory.
+ */
+BESMetrics::BESMetrics() :
+    d_map(nullptr), d_map_size(0), d_header(nullptr), d_series(nullptr), d_capacity(METRICS_MAX_SERIES_DEFAULT),
+    d_file_interval(METRICS_FILE_INTERVAL_DEFAULT), d_owner_pid(0), d_owner(0)
+{
+    // Metrics are updated by code that runs without a bes.conf (e.g., unit tests).
+    try {
+        int capacity = TheBESKeys::TheKeys()->read_int_key(METRICS_MAX_SERIES_KEY, METRICS_MAX_SERIES_DEFAULT);
+        if (capacity > 0) d_capacity = capacity;
+        d_file = TheBESKeys::TheKeys()->read_string_key(METRICS_FILE_KEY, "");
+        d_file_interval = TheBESKeys::TheKeys()->read_int_key(METRICS_FILE_INTERVAL_KEY,
+            METRICS_FILE_INTERVAL_DEFAULT);
+    }
+    catch (BESError &e) {
+        BESDEBUG(MODULE, prolog << "Using the default settings: " << e.get_message() << endl);
+    }
+
+    size_t header_bytes = (sizeof(Header) + 63) & ~(size_t) 63;
+    d_map_size = header_bytes + d_capacity * sizeof(Series);
+
+    void *map = mmap(nullptr, d_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        ERROR_LOG(prolog << "Could not map memory for the metrics (" << strerror(errno)
+            << "); each beslistener will report only its own requests." << endl);
+        map = new uint64_t[(d_map_size + sizeof(uint64_t) - 1) / sizeof(uint64_t)]();
+    }
+
+    // The memory is zero, so every series is EMPTY
+    d_map = static_cast<char *>(map);
+    d_header = new (d_map) Header;
+    d_header->capacity = d_capacity;
+    d_series = reinterpret_cast<Series *>(d_map + header_bytes);
+
+    BESDEBUG(MODULE, prolog << "Room for " << d_capacity << " series in " << d_map_size << " bytes" << endl);
+}
+
+/**
+ * @brief The metrics of this server
+ *
+ * Call this before forking processes that should add to the same series.
+ * The object is never deleted, so series can be updated while the process
+ * exits.
+ */
+BESMetrics *BESMetrics::TheMetrics()
+{
+    static BESMetrics *metrics = new BESMetrics;
+    return metrics;
+}
+
+/**
+ * @brief Find a series, adding it if needed
+ *
+ * @param type The type of the series; a series is always used as the same type
+ * @param name The name of the series, e.g. bes_cache_hits_total
+ * @param labels The labels of the series, e.g. cache="mds"; see label()
+ * @param help What the series measures; used when the series is added
+ * @return The series, or null if the table is full, the name or labels are
+ * too long or the series exists with a different type. The update methods
+ * ignore null series.
+ */
+BESMetrics::Series *
+BESMetrics::get_series(Type type, const string &name, const string &labels, const string &help)
+{
+    if (name.empty() || name.size() > max_name_length || labels.size() > max_labels_length) {
+        d_header->dropped.fetch_add(1, memory_order_relaxed);
+        return nullptr;
+    }
+
+    uint64_t h = series_hash(name, labels);
+    for (unsigned int probe = 0; probe < d_capacity; ++probe) {
+        Series &s = d_series[(h + probe) % d_capacity];
+
+        uint32_t state = s.state.load(memory_order_acquire);
+        if (state == EMPTY) {
+            if (s.state.compare_exchange_strong(state, BUSY, memory_order_acq_rel)) {
+                s.type = type;
+                s.hash = h;
+                copy_string(s.name, name, max_name_length);
+                copy_string(s.labels, labels, max_labels_length);
+                copy_string(s.help, help, max_help_length);
+                s.state.store(READY, memory_order_release);
+                return &s;
+            }
+            // Another thread or process took it; state is what it set
+        }
+
+        for (unsigned int tries = 0; state == BUSY && tries < busy_tries; ++tries) {
+            sched_yield();
+            state = s.state.load(memory_order_acquire);
+        }
+
+        if (state == READY && s.hash == h && name == s.name && labels == s.labels)
+            return s.type == (uint32_t) type ? &s : nullptr;
+    }
+
+    d_header->dropped.fetch_add(1, memory_order_relaxed);
+    return nullptr;
+}
+
+/// @brief Add to a counter or gauge; use a negative value to subtract from a gauge
+void BESMetrics::add(Series *series, int64_t value)
+{
+    if (series) series->value.fetch_add(value, memory_order_relaxed);
+}
+
+/// @brief Set a gauge
+void BESMetrics::set(Series *series, int64_t value)
+{
+    if (series) series->value.store(value, memory_order_relaxed);
+}
+
+/// @brief Add an observation to a histogram
+void BESMetrics::observe(Series *series, double seconds)
+{
+    if (!series) return;
+
+    uint64_t us = seconds > 0 ? (uint64_t) llround(seconds * 1.0e6) : 0;
+    series->buckets[bucket(us)].fetch_add(1, memory_order_relaxed);
+    series->sum_us.fetch_add(us, memory_order_relaxed);
+    series->value.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * @brief This process' slot in a process gauge
+ *
+ * The first time a process uses a process gauge it takes a slot that is
+ * free or was left by a process that has exited, and sets it to zero.
+ *
+ * @return The slot, or null if the series is null or has no slot for
+ * this process; the process then adds to the series' shared value.
+ */
+std::atomic<int64_t> *BESMetrics::process_slot(Series *series)
+{
+    if (!series || series->type != (uint32_t) process_gauge) return nullptr;
+
+    // Only one thread of a process looks for its slot at a time, so the
+    // slot is zeroed before any of them adds to it.
+    std::lock_guard<std::mutex> lock(d_slot_mtx);
+
+    pid_t pid = getpid();
+    if (d_owner_pid != pid) {
+        uint64_t number = d_header->processes.fetch_add(1, memory_order_relaxed) + 1;
+        d_owner = (number << 32) | static_cast<uint32_t>(pid);
+        d_owner_pid = pid;
+    }
+
+    for (unsigned int i = 0; i < process_slots; ++i) {
+        if (series->slots[i].owner.load(memory_order_acquire) == d_owner) return &series->slots[i].value;
+    }
+
+    for (unsigned int i = 0; i < process_slots; ++i) {
+        ProcessSlot &slot = series->slots[i];
+        uint64_t owner = slot.owner.load(memory_order_acquire);
+        if (owner != 0 && owner_running(owner)) continue;
+
+        if (slot.owner.compare_exchange_strong(owner, d_owner, memory_order_acq_rel)) {
+            slot.value.store(0, memory_order_relaxed);
+            return &slot.value;
+        }
+    }
+
+    BESDEBUG(MODULE, prolog << "No slot for process " << pid << " in " << series->name << endl);
+    return nullptr;
+}
+
+/**
+ * @brief A label in the Prometheus format
+ * @return name="value", with the value escaped
+ */
+string BESMetrics::label(const string &name, const string &value)
+{
+    string label = name + "=\"";
+    for (string::const_iterator i = value.begin(), e = value.end(); i != e; ++i) {
+        switch (*i) {
+        case '\\':
+            label.append("\\\\");
+            break;
+        case '"':
+            label.append("\\\"");
+            break;
+        case '\n':
+            label.append("\\n");
+            break;
+        default:
+            label.push_back(*i);
+        }
+    }
+
+    return label.append("\"");
+}
+
+/**
+ * @brief The histogram bucket for a number of microseconds
+ *
+ * Values below four have buckets of their own. Above that, each power of
+ * two is split into four buckets of equal width.
+ */
+unsigned int BESMetrics::bucket(uint64_t us)
+{
+    if (us < 4) return us;
+
+    unsigned int exponent = 63 - __builtin_clzll(us);
+    unsigned int bucket = 4 * (exponent - 1) + ((us >> (exponent - 2)) & 3);
+
+    return min(bucket, histogram_buckets - 1);
+}
+
+/// @brief The smallest number of microseconds above a histogram bucket
+uint64_t BESMetrics::bucket_upper_bound(unsigned int bucket)
+{
+    if (bucket < 4) return bucket + 1;
+
+    unsigned int exponent = bucket / 4 + 1;
+    return (uint64_t) (5 + bucket % 4) << (exponent - 2);
+}
+
+uint64_t BESMetrics::get_dropped() const
+{
+    return d_header->dropped.load(memory_order_relaxed);
+}
+
+// Copy the series, sorted by name, and add the hit ratio of each cache.
+static vector<Sample> snapshot(BESMetrics::Series *series, unsigned int capacity, uint64_t dropped)
+{
+    vector<Sample> samples;
+    map<string, pair<double, double> > caches;   // labels -> hits, misses
+
+    for (unsigned int i = 0; i < capacity; ++i) {
+        BESMetrics::Series &s = series[i];
+        if (s.state.load(memory_order_acquire) != READY) continue;
+
+        Sample sample;
+        sample.name = s.name;
+        sample.labels = s.labels;
+        sample.help = s.help;
+        sample.type = static_cast<BESMetrics::Type>(s.type);
+        sample.value = s.value.load(memory_order_relaxed);
+        sample.sum_us = 0;
+        if (sample.type == BESMetrics::process_gauge) {
+            // Leave out the shares of processes that have exited
+            for (unsigned int p = 0; p < BESMetrics::process_slots; ++p) {
+                uint64_t owner = s.slots[p].owner.load(memory_order_acquire);
+                if (owner != 0 && owner_running(owner)) sample.value += s.slots[p].value.load(memory_order_relaxed);
+            }
+        }
+        if (sample.type == BESMetrics::histogram) {
+            sample.sum_us = s.sum_us.load(memory_order_relaxed);
+            sample.buckets.resize(BESMetrics::histogram_buckets);
+            for (unsigned int b = 0; b < BESMetrics::histogram_buckets; ++b)
+                sample.buckets[b] = s.buckets[b].load(memory_order_relaxed);
+        }
+
+        if (sample.name == METRICS_CACHE_HITS) caches[sample.labels].first = sample.value;
+        if (sample.name == METRICS_CACHE_MISSES) caches[sample.labels].second = sample.value;
+
+        samples.push_back(sample);
+    }
+
+    for (map<string, pair<double, double> >::iterator i = caches.begin(), e = caches.end(); i != e; ++i) {
+        double lookups = i->second.first + i->second.second;
+        if (lookups == 0) continue;
+
+        Sample ratio;
+        ratio.name = METRICS_CACHE_HIT_RATIO;
+        ratio.labels = i->first;
+        ratio.help = "Fraction of cache lookups that were hits";
+        ratio.type = BESMetrics::gauge;
+        ratio.value = i->second.first / lookups;
+        ratio.sum_us = 0;
+        samples.push_back(ratio);
+    }
+
+    Sample drops;
+    drops.name = "bes_metrics_dropped_series";
+    drops.help = "Series that could not be added because BES.Metrics.MaxSeries was reached";
+    drops.type = BESMetrics::gauge;
+    drops.value = dropped;
+    drops.sum_us = 0;
+    samples.push_back(drops);
+
+    sort(samples.begin(), samples.end());
+    return samples;
+}
+
+/**
+ * @brief Write the series in the Prometheus text exposition format
+ *
+ * Histograms are written with buckets at powers of two microseconds from
+ * about 1ms to 9.5 hours.
+ */
+void BESMetrics::write_prometheus(ostream &strm) const
+{
+    vector<Sample> samples = snapshot(d_series, d_capacity, get_dropped());
+
+    string last_name;
+    for (vector<Sample>::const_iterator i = samples.begin(), e = samples.end(); i != e; ++i) {
+        if (i->name != last_name) {
+            strm << "# HELP " << i->name << " " << i->help << "\n";
+            strm << "# TYPE " << i->name << " " << type_name(i->type) << "\n";
+            last_name = i->name;
+        }
+
+        if (i->type != histogram) {
+            strm << series_name(i->name, i->labels) << " " << format_double(i->value) << "\n";
+            continue;
+        }
+
+        string prefix = i->labels.empty() ? "" : i->labels + ",";
+        uint64_t cumulative = 0;
+        unsigned int power = first_le_power;
+        for (unsigned int b = 0; b < histogram_buckets && power <= last_le_power; ++b) {
+            cumulative += i->buckets[b];
+            if (bucket_upper_bound(b) == (1ULL << power)) {
+                strm << i->name << "_bucket{" << prefix << "le=\"" << format_double((1ULL << power) / 1.0e6)
+                    << "\"} " << cumulative << "\n";
+                ++power;
+            }
+        }
+
+        uint64_t count = 0;
+        for (vector<uint64_t>::const_iterator b = i->buckets.begin(), be = i->buckets.end(); b != be; ++b)
+            count += *b;
+
+        strm << i->name << "_bucket{" << prefix << "le=\"+Inf\"} " << count << "\n";
+        strm << series_name(i->name + "_sum", i->labels) << " " << format_double(i->sum_us / 1.0e6) << "\n";
+        strm << series_name(i->name + "_count", i->labels) << " " << count << "\n";
+    }
+}
+
+/**
+ * @brief Write the series to a file in the Prometheus format
+ *
+ * The file is written under another name and then renamed, so a reader
+ * never sees part of it.
+ *
+ * @exception BESInternalError if the file cannot be written
+ */
+void BESMetrics::write_file(const string &path) const
+{
+    ostringstream tmp;
+    tmp << path << ".tmp." << getpid();
+
+    ofstream out(tmp.str().c_str(), ios::out | ios::trunc);
+    if (out) write_prometheus(out);
+    out.close();
+
+    if (!out || rename(tmp.str().c_str(), path.c_str()) == -1) {
+        string error = strerror(errno);
+        unlink(tmp.str().c_str());
+        throw BESInternalError(prolog + "Could not write the metrics to " + path + ": " + error, __FILE__, __LINE__);
+    }
+}
+
+/**
+ * @brief Write BES.Metrics.File if it is set and was last written at least
+ * BES.Metrics.FileInterval seconds ago
+ *
+ * Only one of the processes sharing the series writes the file.
+ */
+void BESMetrics::write_file_if_due(time_t now)
+{
+    if (d_file.empty()) return;
+
+    int64_t last = d_header->last_write.load(memory_order_relaxed);
+    if (now - last < d_file_interval) return;
+
+    if (d_header->last_write.compare_exchange_strong(last, now, memory_order_relaxed)) write_file(d_file);
+}
+
+/**
+ * @brief Add the series to an informational response
+ *
+ * Each series is a 'metric' element. Counters and gauges have their value
+ * as the element's text; histograms have the count, the sum and the 50th,
+ * 90th and 99th percentiles (in seconds) as attributes.
+ */
+void BESMetrics::report(BESInfo &info) const
+{
+    vector<Sample> samples = snapshot(d_series, d_capacity, get_dropped());
+
+    for (vector<Sample>::const_iterator i = samples.begin(), e = samples.end(); i != e; ++i) {
+        map<string, string> attrs;
+        attrs["name"] = i->name;
+        attrs["type"] = type_name(i->type);
+        if (!i->labels.empty()) attrs["labels"] = i->labels;
+
+        if (i->type != histogram) {
+            info.add_tag("metric", format_double(i->value), &attrs);
+            continue;
+        }
+
+        uint64_t count = 0;
+        for (vector<uint64_t>::const_iterator b = i->buckets.begin(), be = i->buckets.end(); b != be; ++b)
+            count += *b;
+
+        attrs["count"] = to_string(count);
+        attrs["sum"] = format_double(i->sum_us / 1.0e6);
+        for (unsigned int q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q)
+            attrs["p" + to_string((int) lround(quantiles[q] * 100))] = format_double(quantile(*i, quantiles[q]));
+
+        info.add_tag("metric", "", &attrs);
+    }
+}
+
+BESMetrics::Series *BESMetric::series()
+{
+    if (!d_found.load(memory_order_acquire)) {
+        d_series.store(BESMetrics::TheMetrics()->get_series(d_type, d_name, d_labels, d_help),
+            memory_order_relaxed);
+        d_found.store(true, memory_order_release);
+    }
+
+    return d_series.load(memory_order_relaxed);
+}
+
+std::atomic<int64_t> *BESMetric::slot()
+{
+    // A process forked after the slot was found needs a slot of its own
+    pid_t pid = getpid();
+    if (d_slot_pid.load(memory_order_acquire) != pid) {
+        d_slot.store(BESMetrics::TheMetrics()->process_slot(series()), memory_order_relaxed);
+        d_slot_pid.store(pid, memory_order_release);
+    }
+
+    return d_slot.load(memory_order_relaxed);
+}
+
+void BESMetric::add_to_slot(int64_t value)
+{
+    std::atomic<int64_t> *share = slot();
+    if (share)
+        share->fetch_add(value, memory_order_relaxed);
+    else
+        BESMetrics::add(series(), value);
+}
+
+void BESMetric::set_slot(int64_t value)
+{
+    std::atomic<int64_t> *share = slot();
+    if (share)
+        share->store(value, memory_order_relaxed);
+    else
+        BESMetrics::set(series(), value);
+}
+
+// The gauges of this thread's open BESMetricScope objects, outermost first.
+// The count is updated after the gauge is stored, so a longjmp() out of a
+// signal handler leaves the two consistent.
+static thread_local BESMetric *open_scope_gauges[BESMetricScope::max_open_scopes];
+static thread_local size_t open_scope_count = 0;
+
+BESMetricScope::BESMetricScope(BESMetric &gauge) : d_gauge(gauge)
+{
+    d_gauge.add(1);
+    if (open_scope_count < max_open_scopes) open_scope_gauges[open_scope_count] = &d_gauge;
+    ++open_scope_count;
+}
+
+BESMetricScope::~BESMetricScope()
+{
+    --open_scope_count;
+    d_gauge.add(-1);
+}
+
+/// @brief The number of scopes open in this thread
+size_t BESMetricScope::open_scopes()
+{
+    return open_scope_count;
+}
+
+/**
+ * @brief Subtract the gauges of scopes whose destructors were skipped
+ *
+ * Call this after a longjmp() to a point where this thread had @a keep
+ * scopes open (see open_scopes()). The scopes opened since then are
+ * released as if their destructors had run.
+ */
+void BESMetricScope::release_scopes(size_t keep)
+{
+    while (open_scope_count > keep) {
+        --open_scope_count;
+        if (open_scope_count < max_open_scopes) open_scope_gauges[open_scope_count]->add(-1);
+    }
+}
@@ -0,0 +1,231 @@
+// BESMetrics.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef BESMetrics_h_
+#define BESMetrics_h_ 1
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+class BESInfo;
+
+// Names of series used in more than one place
+#define METRICS_REQUEST_DURATION "bes_request_duration_seconds"
+#define METRICS_CACHE_HITS "bes_cache_hits_total"
+#define METRICS_CACHE_MISSES "bes_cache_misses_total"
+#define METRICS_CACHE_HIT_RATIO "bes_cache_hit_ratio"
+
+/**
+ * @brief Counters, gauges and latency histograms shared by the beslisteners
+ *
+ * The series are kept in shared memory that is mapped the first time
+ * TheMetrics() is called. ServerApp calls it before the beslistener forks,
+ * so every child adds to the same series and any of them can report the
+ * totals, either in response to the 'showMetrics' command or by writing
+ * them to BES.Metrics.File in the Prometheus text exposition format.
+ *
+ * A series is a name and a set of labels, e.g. bes_cache_hits_total with
+ * the label cache="mds". Series are added as they are first used and are
+ * never removed. When BES.Metrics.MaxSeries series have been added, new
+ * series are dropped and counted.
+ *
+ * A histogram counts latencies in buckets that are a quarter of a power of
+ * two wide (like an HDR histogram with two bits of precision), from one
+ * microsecond up to several days, so a quantile read from it is within 25%
+ * of the true value.
+ *
+ * The hit ratio of each cache with bes_cache_hits_total and
+ * bes_cache_misses_total series is reported as bes_cache_hit_ratio.
+ *
+ * A process gauge is a gauge that each process adds to in a slot of its
+ * own; its value is the sum of the slots of the processes that are still
+ * running. A beslistener that exits, or is killed, while it holds part of
+ * the gauge (e.g. during a transfer) no longer counts. It is reported as a
+ * gauge. When more processes than there are slots use the gauge, the rest
+ * share one value that is not corrected when they exit.
+ *
+ * Updating a series is an atomic add; nothing is locked.
+ */
+class BESMetrics {
+public:
+    enum Type { counter = 1, gauge, histogram, process_gauge };
+
+    /// A series; it lives in the shared memory
+    struct Series;
+
+    static const unsigned int max_name_length = 63;
+    static const unsigned int max_labels_length = 191;
+    static const unsigned int max_help_length = 127;
+
+    static const unsigned int histogram_buckets = 160;
+
+    /// Processes that can have a slot of their own in a process gauge
+    static const unsigned int process_slots = histogram_buckets / 2;
+
+private:
+    struct Header;
+
+    char *d_map;
+    size_t d_map_size;
+
+    Header *d_header;
+    Series *d_series;
+    unsigned int d_capacity;
+
+    std::string d_file;
+    int d_file_interval;
+
+    // Identifies this process in the slots of the process gauges
+    std::mutex d_slot_mtx;
+    pid_t d_owner_pid;
+    uint64_t d_owner;
+
+    BESMetrics();
+
+    BESMetrics(const BESMetrics &) = delete;
+    BESMetrics &operator=(const BESMetrics &) = delete;
+
+public:
+    static BESMetrics *TheMetrics();
+
+    Series *get_series(Type type, const std::string &name, const std::string &labels, const std::string &help);
+
+    static void add(Series *series, int64_t value);
+    static void set(Series *series, int64_t value);
+    static void observe(Series *series, double seconds);
+
+    std::atomic<int64_t> *process_slot(Series *series);
+
+    static std::string label(const std::string &name, const std::string &value);
+
+    static unsigned int bucket(uint64_t us);
+    static uint64_t bucket_upper_bound(unsigned int bucket);
+
+    /// @brief Number of series that could not be added
+    uint64_t get_dropped() const;
+
+    void write_prometheus(std::ostream &strm) const;
+    void write_file(const std::string &path) const;
+    void write_file_if_due(time_t now);
+
+    void report(BESInfo &info) const;
+};
+
+/**
+ * @brief A series with fixed labels, found the first time it is used
+ *
+ * Make these static, e.g.
+ * @code
+ * static BESMetric mds_hits(BESMetrics::counter, "bes_cache_hits_total", "Cache lookups that were hits",
+ *     "cache=\"mds\"");
+ * mds_hits.add();
+ * @endcode
+ */
+class BESMetric {
+private:
+    BESMetrics::Type d_type;
+    const char *d_name;
+    const char *d_help;
+    const char *d_labels;
+
+    std::atomic<BESMetrics::Series *> d_series;
+    std::atomic<bool> d_found;
+
+    // The slot of a process gauge used by the process d_slot_pid
+    std::atomic<std::atomic<int64_t> *> d_slot;
+    std::atomic<pid_t> d_slot_pid;
+
+    BESMetrics::Series *series();
+    std::atomic<int64_t> *slot();
+
+    void add_to_slot(int64_t value);
+    void set_slot(int64_t value);
+
+public:
+    BESMetric(BESMetrics::Type type, const char *name, const char *help, const char *labels = "") :
+        d_type(type), d_name(name), d_help(help), d_labels(labels), d_series(nullptr), d_found(false),
+        d_slot(nullptr), d_slot_pid(0)
+    {
+    }
+
+    BESMetric(const BESMetric &) = delete;
+    BESMetric &operator=(const BESMetric &) = delete;
+
+    void add(int64_t value = 1)
+    {
+        if (d_type == BESMetrics::process_gauge)
+            add_to_slot(value);
+        else
+            BESMetrics::add(series(), value);
+    }
+
+    void set(int64_t value)
+    {
+        if (d_type == BESMetrics::process_gauge)
+            set_slot(value);
+        else
+            BESMetrics::set(series(), value);
+    }
+
+    void observe(double seconds)
+    {
+        BESMetrics::observe(series(), seconds);
+    }
+};
+
+/**
+ * @brief Add one to a gauge until the end of a scope
+ *
+ * The request timeout leaves a request with longjmp(), which skips the
+ * destructors of the scopes open at the time. Each thread records its open
+ * scopes so that BESInterface can subtract the ones that were skipped; see
+ * open_scopes() and release_scopes().
+ */
+class BESMetricScope {
+private:
+    BESMetric &d_gauge;
+
+public:
+    /// The most nested scopes a thread records; deeper ones are not released
+    static const unsigned int max_open_scopes = 32;
+
+    explicit BESMetricScope(BESMetric &gauge);
+    ~BESMetricScope();
+
+    BESMetricScope(const BESMetricScope &) = delete;
+    BESMetricScope &operator=(const BESMetricScope &) = delete;
+
+    static size_t open_scopes();
+    static void release_scopes(size_t keep);
+};
+
+#endif // BESMetrics_h_
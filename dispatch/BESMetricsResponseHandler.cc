@@ -0,0 +1,95 @@
+// BESMetricsResponseHandler.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include "BESMetricsResponseHandler.h"
+#include "BESMetrics.h"
+#include "BESInfoList.h"
+#include "BESInfo.h"
+#include "BESIndent.h"
+#include "BESInternalError.h"
+#include "BESResponseNames.h"
+
+using std::endl;
+using std::ostream;
+using std::string;
+
+BESMetricsResponseHandler::BESMetricsResponseHandler(const string &name) :
+    BESResponseHandler(name)
+{
+}
+
+BESMetricsResponseHandler::~BESMetricsResponseHandler()
+{
+}
+
+/** @brief executes the command 'show metrics;' by returning the series
+ * recorded by all of the beslisteners
+ *
+ * @param dhi structure that holds request and response information
+ * @see BESMetrics::report()
+ */
+void BESMetricsResponseHandler::execute(BESDataHandlerInterface &dhi)
+{
+    BESInfo *info = BESInfoList::TheList()->build_info();
+    d_response_object = info;
+    dhi.action_name = METRICS_RESPONSE_STR;
+    info->begin_response(METRICS_RESPONSE_STR, dhi);
+    BESMetrics::TheMetrics()->report(*info);
+    info->end_response();
+}
+
+/** @brief transmit the response object built by the execute command
+ * using the specified transmitter object
+ *
+ * @param transmitter object that knows how to transmit specific basic types
+ * @param dhi structure that holds the request and response information
+ */
+void BESMetricsResponseHandler::transmit(BESTransmitter *transmitter, BESDataHandlerInterface &dhi)
+{
+    if (d_response_object) {
+        BESInfo *info = dynamic_cast<BESInfo *>(d_response_object);
+        if (!info) throw BESInternalError("cast error", __FILE__, __LINE__);
+        info->transmit(transmitter, dhi);
+    }
+}
+
+/** @brief dumps information about this object
+ *
+ * @param strm C++ i/o stream to dump the information to
+ */
+void BESMetricsResponseHandler::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "BESMetricsResponseHandler::dump - (" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    BESResponseHandler::dump(strm);
+    BESIndent::UnIndent();
+}
+
+BESResponseHandler *
+BESMetricsResponseHandler::MetricsResponseBuilder(const string &name)
+{
+    return new BESMetricsResponseHandler(name);
+}
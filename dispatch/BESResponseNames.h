@@ -85,6 +85,8 @@
 #define CONFIG_RESPONSE_STR "showConfig"
 #define STATUS_RESPONSE "show.status"
 #define STATUS_RESPONSE_STR "showStatus"
+#define METRICS_RESPONSE "show.metrics"
+#define METRICS_RESPONSE_STR "showMetrics"
 #define SERVICE_RESPONSE "show.servicedescriptions"
 #define SERVICE_RESPONSE_STR "showServiceDescriptions"
 #define SHOW_CONTEXT "show.context"
@@ -31,7 +31,9 @@
 //      jgarcia     Jose Garcia <jgarcia@ucar.edu>
 
 #include "BESStatus.h" 
+#include "BESInfo.h"
 
+using std::map;
 using std::string;
 
 string BESStatus::boot_time ;
@@ -65,5 +67,63 @@ BESStatus::~BESStatus()
     _counter-- ;
 }
 
+/** @brief The registered status reporters, by name
+ *
+ * A function-local static so that modules may register reporters regardless
+ * of the order in which static objects are initialized.
+ */
+map<string, p_status_reporter> &
+BESStatus::reporters()
+{
+    static map<string, p_status_reporter> the_reporters ;
+    return the_reporters ;
+}
+
+/** @brief Add a module's status to the 'show status' response
+ *
+ * The reporter is called with the response's informational object, inside
+ * a tag named for the reporter, each time the response is built. It should
+ * add its values using BESInfo::add_tag(). Registering a second reporter
+ * with the same name replaces the first.
+ *
+ * @param name The name of the reporter, usually the module's name
+ * @param reporter The function that adds the status values
+ */
+void
+BESStatus::add_reporter( const string &name, p_status_reporter reporter )
+{
+    reporters()[name] = reporter ;
+}
+
+/** @brief Stop adding a module's status to the 'show status' response
+ *
+ * Modules that register a reporter should remove it when they are
+ * terminated.
+ *
+ * @param name The name used to register the reporter
+ */
+void
+BESStatus::remove_reporter( const string &name )
+{
+    reporters().erase( name ) ;
+}
+
+/** @brief Add the status of each registered module to a response
+ *
+ * @param info The 'show status' response
+ */
+void
+BESStatus::report( BESInfo &info )
+{
+    map<string, p_status_reporter>::iterator i = reporters().begin() ;
+    map<string, p_status_reporter>::iterator e = reporters().end() ;
+    for( ; i != e; i++ )
+    {
+	info.begin_tag( i->first ) ;
+	i->second( info ) ;
+	info.end_tag( i->first ) ;
+    }
+}
+
 static BESStatus _static_status ;
 
@@ -35,16 +35,31 @@
 
 #include <time.h>
 #include <string>
+#include <map>
+
+class BESInfo ;
+
+/** @brief A function that adds a module's status to the 'show status'
+ * response; see BESStatus::add_reporter()
+ */
+typedef void (*p_status_reporter)( BESInfo &info ) ;
 
 class BESStatus
 {
     static int			_counter ;
     static std::string	boot_time ;
+
+    static std::map<std::string, p_status_reporter> &reporters() ;
 public:
 				BESStatus();
 				BESStatus(const BESStatus &);
   				~BESStatus();
   	std::string	get_status() { return BESStatus::boot_time ; }
+
+    static void		add_reporter( const std::string &name,
+				      p_status_reporter reporter ) ;
+    static void		remove_reporter( const std::string &name ) ;
+    static void		report( BESInfo &info ) ;
 } ;
 
 #endif // BESStatus_h_
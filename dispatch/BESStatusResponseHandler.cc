@@ -54,7 +54,8 @@ BESStatusResponseHandler::~BESStatusResponseHandler( )
  *
  * This response handler knows how to retrieve the status for the server
  * process handing this clients requests from BESStatus and stores it in a
- * BESInfo informational response object.
+ * BESInfo informational response object. The status of modules that have
+ * registered a reporter with BESStatus::add_reporter() follows.
  *
  * @param dhi structure that holds request and response information
  * @see BESDataHandlerInterface
@@ -70,6 +71,7 @@ BESStatusResponseHandler::execute( BESDataHandlerInterface &dhi )
     dhi.action_name = STATUS_RESPONSE_STR ;
     info->begin_response( STATUS_RESPONSE_STR, dhi ) ;
     info->add_tag( "status", s.get_status() ) ;
+    BESStatus::report( *info ) ;
     info->end_response() ;
 }
 
@@ -0,0 +1,511 @@
+// BESTrace.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+
+#include "BESTrace.h"
+#include "BESDebug.h"
+#include "BESLog.h"
+#include "BESUtil.h"
+#include "TheBESKeys.h"
+
+#define TRACE_DIR_KEY "BES.Trace.Dir"
+#define TRACE_FORMAT_KEY "BES.Trace.Format"
+#define TRACE_BUFFER_SIZE_KEY "BES.Trace.BufferSize"
+#define TRACE_BUFFER_SIZE_DEFAULT 8192
+
+#define MODULE "trace"
+#define prolog std::string("BESTrace::").append(__func__).append("() - ")
+
+using namespace std;
+
+atomic<uint64_t> BESTrace::d_trace_id(0);
+atomic<uint64_t> BESTrace::d_root_id(0);
+
+namespace {
+
+// A finished span
+struct SpanRecord {
+    string name;
+    uint64_t trace_id;
+    uint64_t span_id;
+    uint64_t parent_id;
+    int64_t start_us;
+    int64_t end_us;
+    unsigned int thread;
+    vector<BESTraceSpan::Attribute> attributes;
+};
+
+/**
+ * The spans finished by one thread. Only that thread adds spans and only
+ * end_request() takes them out, so the ring needs no lock.
+ */
+class SpanRing {
+private:
+    vector<SpanRecord> d_slots;
+    atomic<uint64_t> d_head;    // Next to take out
+    atomic<uint64_t> d_tail;    // Next to fill
+    atomic<uint64_t> d_dropped;
+    unsigned int d_thread;
+
+public:
+    SpanRing(size_t size, unsigned int thread) :
+        d_slots(size), d_head(0), d_tail(0), d_dropped(0), d_thread(thread)
+    {
+    }
+
+    unsigned int thread() const
+    {
+        return d_thread;
+    }
+
+    void push(SpanRecord &&record)
+    {
+        uint64_t tail = d_tail.load(memory_order_relaxed);
+        if (tail - d_head.load(memory_order_acquire) == d_slots.size()) {
+            d_dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+
+        d_slots[tail % d_slots.size()] = std::move(record);
+        d_tail.store(tail + 1, memory_order_release);
+    }
+
+    /// Move the spans of one trace to 'spans'; return the number dropped.
+    uint64_t drain(uint64_t trace_id, vector<SpanRecord> &spans)
+    {
+        uint64_t head = d_head.load(memory_order_relaxed);
+        uint64_t tail = d_tail.load(memory_order_acquire);
+        for (; head != tail; ++head) {
+            SpanRecord &record = d_slots[head % d_slots.size()];
+            if (record.trace_id == trace_id)
+                spans.push_back(std::move(record));
+        }
+        d_head.store(head, memory_order_release);
+
+        return d_dropped.exchange(0, memory_order_relaxed);
+    }
+};
+
+struct TraceState {
+    mutex lock;
+    vector<shared_ptr<SpanRing> > rings;
+    unsigned int next_thread;
+
+    bool configured;
+    string dir;
+    bool otlp;
+    size_t buffer_size;
+
+    unsigned long requests;
+    mt19937_64 random;
+
+    string root_name;
+    int64_t root_start_us;
+
+    TraceState() : next_thread(1), configured(false), otlp(false), buffer_size(TRACE_BUFFER_SIZE_DEFAULT),
+        requests(0)
+    {
+    }
+};
+
+// Never deleted, so threads that exit after main() can still record spans.
+TraceState &trace_state()
+{
+    static TraceState *state = new TraceState;
+    return *state;
+}
+
+atomic<uint64_t> next_span_id(1);
+
+thread_local BESTraceContext thread_context;
+thread_local shared_ptr<SpanRing> thread_ring;
+
+int64_t now_us()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void record(SpanRecord &&span)
+{
+    if (!thread_ring) {
+        TraceState &state = trace_state();
+        lock_guard<mutex> lock(state.lock);
+        thread_ring = make_shared<SpanRing>(state.buffer_size, state.next_thread++);
+        state.rings.push_back(thread_ring);
+    }
+
+    span.thread = thread_ring->thread();
+    thread_ring->push(std::move(span));
+}
+
+void configure(TraceState &state)
+{
+    state.configured = true;
+    state.dir = TheBESKeys::TheKeys()->read_string_key(TRACE_DIR_KEY, "");
+    state.otlp = TheBESKeys::TheKeys()->read_string_key(TRACE_FORMAT_KEY, "chrome") == "otlp";
+    int size = TheBESKeys::TheKeys()->read_int_key(TRACE_BUFFER_SIZE_KEY, TRACE_BUFFER_SIZE_DEFAULT);
+    state.buffer_size = size > 0 ? size : TRACE_BUFFER_SIZE_DEFAULT;
+    state.random.seed(random_device()());
+
+    BESDEBUG(MODULE, prolog << "Tracing " << (state.dir.empty() ? "is off" : "to " + state.dir) << endl);
+}
+
+string hex_id(uint64_t id)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) id);
+    return buf;
+}
+
+void write_json_string(ostream &out, const string &value)
+{
+    out << '"';
+    for (unsigned char c: value) {
+        switch (c) {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        case '\n':
+            out << "\\n";
+            break;
+        case '\t':
+            out << "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out << buf;
+            }
+            else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+// Chrome trace events: one 'complete' event per span
+void write_chrome_trace(ostream &out, const vector<SpanRecord> &spans, uint64_t trace_id,
+    const string &request_id, uint64_t dropped)
+{
+    out << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"request_id\":";
+    write_json_string(out, request_id);
+    out << ",\"trace_id\":\"" << hex_id(trace_id) << "\",\"dropped_spans\":" << dropped << "},\n";
+    out << "\"traceEvents\":[";
+
+    bool first = true;
+    for (const SpanRecord &span: spans) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+
+        out << "{\"name\":";
+        write_json_string(out, span.name);
+        out << ",\"cat\":\"bes\",\"ph\":\"X\",\"ts\":" << span.start_us << ",\"dur\":" << span.end_us - span.start_us
+            << ",\"pid\":" << getpid() << ",\"tid\":" << span.thread
+            << ",\"args\":{\"span_id\":\"" << hex_id(span.span_id) << "\",\"parent_id\":\"" << hex_id(span.parent_id)
+            << "\"";
+        for (const BESTraceSpan::Attribute &attribute: span.attributes) {
+            out << ",";
+            write_json_string(out, attribute.key);
+            out << ":";
+            if (attribute.type == BESTraceSpan::string_value)
+                write_json_string(out, attribute.value);
+            else
+                out << attribute.value;
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+}
+
+// OTLP/JSON, as written by the OpenTelemetry file exporter
+void write_otlp_trace(ostream &out, const vector<SpanRecord> &spans, uint64_t trace_id,
+    const string &request_id, uint64_t dropped)
+{
+    out << "{\"resourceSpans\":[{\"resource\":{\"attributes\":["
+        << "{\"key\":\"service.name\",\"value\":{\"stringValue\":\"bes\"}},"
+        << "{\"key\":\"process.pid\",\"value\":{\"intValue\":\"" << getpid() << "\"}},"
+        << "{\"key\":\"bes.request_id\",\"value\":{\"stringValue\":";
+    write_json_string(out, request_id);
+    out << "}},{\"key\":\"bes.dropped_spans\",\"value\":{\"intValue\":\"" << dropped << "\"}}]},\n";
+    out << "\"scopeSpans\":[{\"scope\":{\"name\":\"bes\"},\"spans\":[";
+
+    bool first = true;
+    for (const SpanRecord &span: spans) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+
+        out << "{\"traceId\":\"" << hex_id(0) << hex_id(trace_id) << "\",\"spanId\":\"" << hex_id(span.span_id) << "\"";
+        if (span.parent_id)
+            out << ",\"parentSpanId\":\"" << hex_id(span.parent_id) << "\"";
+        out << ",\"name\":";
+        write_json_string(out, span.name);
+        out << ",\"kind\":1,\"startTimeUnixNano\":\"" << span.start_us * 1000 << "\",\"endTimeUnixNano\":\""
+            << span.end_us * 1000 << "\",\"attributes\":[{\"key\":\"thread.id\",\"value\":{\"intValue\":\""
+            << span.thread << "\"}}";
+        for (const BESTraceSpan::Attribute &attribute: span.attributes) {
+            out << ",{\"key\":";
+            write_json_string(out, attribute.key);
+            switch (attribute.type) {
+            case BESTraceSpan::string_value:
+                out << ",\"value\":{\"stringValue\":";
+                write_json_string(out, attribute.value);
+                out << "}}";
+                break;
+            case BESTraceSpan::int_value:
+                out << ",\"value\":{\"intValue\":\"" << attribute.value << "\"}}";
+                break;
+            case BESTraceSpan::bool_value:
+                out << ",\"value\":{\"boolValue\":" << attribute.value << "}}";
+                break;
+            }
+        }
+        out << "]}";
+    }
+    out << "\n]}]}]}\n";
+}
+
+}
+
+/**
+ * @brief Start the trace of a request
+ *
+ * Reads the BES.Trace keys the first time it's called. Does nothing if
+ * BES.Trace.Dir is not set.
+ *
+ * @param name The name of the request's span
+ */
+void BESTrace::start_request(const string &name)
+{
+    TraceState &state = trace_state();
+    uint64_t trace_id;
+    {
+        lock_guard<mutex> lock(state.lock);
+        if (!state.configured) configure(state);
+        if (state.dir.empty()) return;
+
+        do {
+            trace_id = state.random();
+        } while (trace_id == 0);
+
+        state.root_name = name;
+        state.root_start_us = now_us();
+    }
+
+    uint64_t root_id = next_span_id.fetch_add(1);
+    d_root_id.store(root_id);
+    d_trace_id.store(trace_id);
+    thread_context = BESTraceContext(trace_id, root_id);
+}
+
+/**
+ * @brief Finish the trace of a request and write it to a file
+ *
+ * The file is named bes_trace_<pid>_<n>.json, where n counts the requests
+ * this process has traced. Errors are logged; they don't stop the request.
+ *
+ * @param request_id The request's ID, recorded in the file
+ */
+void BESTrace::end_request(const string &request_id)
+{
+    uint64_t trace_id = d_trace_id.exchange(0);
+    if (!trace_id) return;
+
+    TraceState &state = trace_state();
+
+    SpanRecord root;
+    root.trace_id = trace_id;
+    root.span_id = d_root_id.load();
+    root.parent_id = 0;
+    root.end_us = now_us();
+    root.name = state.root_name;
+    root.start_us = state.root_start_us;
+    root.thread = thread_ring ? thread_ring->thread() : 0;
+    root.attributes.push_back(BESTraceSpan::Attribute { "bes.request_id", request_id, BESTraceSpan::string_value });
+    thread_context = BESTraceContext();
+
+    // The root span is not put in a ring, so it is never dropped.
+    vector<SpanRecord> spans(1, std::move(root));
+    uint64_t dropped = 0;
+    string path;
+    {
+        lock_guard<mutex> lock(state.lock);
+        for (auto i = state.rings.begin(); i != state.rings.end();) {
+            dropped += (*i)->drain(trace_id, spans);
+            // The ring of a thread that has exited is held only here
+            if (i->use_count() == 1)
+                i = state.rings.erase(i);
+            else
+                ++i;
+        }
+
+        ostringstream name;
+        name << "bes_trace_" << getpid() << "_" << ++state.requests << ".json";
+        path = BESUtil::assemblePath(state.dir, name.str());
+    }
+
+    string tmp_path = path + ".tmp";
+    ofstream out(tmp_path.c_str(), ios::out | ios::trunc);
+    if (state.otlp)
+        write_otlp_trace(out, spans, trace_id, request_id, dropped);
+    else
+        write_chrome_trace(out, spans, trace_id, request_id, dropped);
+    out.close();
+
+    if (!out || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        ERROR_LOG(prolog << "Could not write the trace file " << path << ": " << strerror(errno) << endl);
+        unlink(tmp_path.c_str());
+        return;
+    }
+
+    BESDEBUG(MODULE, prolog << "Wrote " << spans.size() << " spans to " << path << endl);
+}
+
+/**
+ * @brief The span this thread is in
+ *
+ * A thread that is not in a span of the current trace is in the request's
+ * span. If no request is being traced, the context is empty.
+ */
+BESTraceContext BESTrace::current()
+{
+    uint64_t trace_id = d_trace_id.load(memory_order_relaxed);
+    if (!trace_id) return BESTraceContext();
+
+    if (thread_context.trace_id == trace_id) return thread_context;
+
+    return BESTraceContext(trace_id, d_root_id.load(memory_order_relaxed));
+}
+
+/**
+ * @brief Wrap a task so its spans are children of this thread's span
+ *
+ * For tasks run by other threads.
+ */
+function<void()> BESTrace::bind(function<void()> task)
+{
+    if (!is_enabled()) return task;
+
+    BESTraceContext context = current();
+    return [context, task]() {
+        BESTraceScope scope(context);
+        task();
+    };
+}
+
+BESTraceSpan::BESTraceSpan(const char *name) : d_name(name), d_parent_id(0), d_start_us(0)
+{
+    uint64_t trace_id = BESTrace::d_trace_id.load(memory_order_relaxed);
+    if (!trace_id) return;
+
+    d_previous = thread_context;
+    d_parent_id = thread_context.trace_id == trace_id ? thread_context.span_id : BESTrace::d_root_id.load();
+    d_context = BESTraceContext(trace_id, next_span_id.fetch_add(1, memory_order_relaxed));
+    d_start_us = now_us();
+
+    thread_context = d_context;
+}
+
+BESTraceSpan::~BESTraceSpan()
+{
+    if (!is_recording()) return;
+
+    thread_context = d_previous;
+
+    SpanRecord span;
+    span.name = d_name;
+    span.trace_id = d_context.trace_id;
+    span.span_id = d_context.span_id;
+    span.parent_id = d_parent_id;
+    span.start_us = d_start_us;
+    span.end_us = now_us();
+    span.attributes = std::move(d_attributes);
+    record(std::move(span));
+}
+
+void BESTraceSpan::add_attribute(const string &key, const string &value, AttributeType type)
+{
+    d_attributes.push_back(Attribute { key, value, type });
+}
+
+void BESTraceSpan::set_attribute(const string &key, const string &value)
+{
+    if (is_recording()) add_attribute(key, value, string_value);
+}
+
+void BESTraceSpan::set_attribute(const string &key, const char *value)
+{
+    if (is_recording()) add_attribute(key, value, string_value);
+}
+
+void BESTraceSpan::set_attribute(const string &key, bool value)
+{
+    if (is_recording()) add_attribute(key, value ? "true" : "false", bool_value);
+}
+
+/**
+ * @brief Record the host of a URL as the attribute 'url.host'
+ */
+void BESTraceSpan::set_url_attribute(const string &url)
+{
+    if (!is_recording()) return;
+
+    string::size_type start = url.find("://");
+    start = (start == string::npos) ? 0 : start + 3;
+    string::size_type end = url.find_first_of("/?#", start);
+    string host = url.substr(start, end == string::npos ? string::npos : end - start);
+
+    // Drop any user name and password
+    string::size_type at = host.rfind('@');
+    if (at != string::npos) host.erase(0, at + 1);
+
+    add_attribute("url.host", host, string_value);
+}
+
+BESTraceScope::BESTraceScope(const BESTraceContext &context) : d_previous(thread_context)
+{
+    thread_context = context;
+}
+
+BESTraceScope::~BESTraceScope()
+{
+    thread_context = d_previous;
+}
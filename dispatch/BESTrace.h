@@ -0,0 +1,161 @@
+// BESTrace.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef BESTrace_h_
+#define BESTrace_h_ 1
+
+#include <cstdint>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// The span a thread is in; passed to the threads that do work for it.
+struct BESTraceContext {
+    uint64_t trace_id;
+    uint64_t span_id;
+
+    BESTraceContext() : trace_id(0), span_id(0)
+    {
+    }
+
+    BESTraceContext(uint64_t trace, uint64_t span) : trace_id(trace), span_id(span)
+    {
+    }
+};
+
+/**
+ * @brief Record where the time goes in a request
+ *
+ * When BES.Trace.Dir is set, each request is traced: BESInterface starts a
+ * root span when the request arrives, and code that wants to be seen in the
+ * trace makes a BESTraceSpan on the stack. A span's parent is the span the
+ * thread is in when it starts. Work handed to another thread keeps its
+ * parent if the other thread makes a BESTraceScope with the context of the
+ * thread that handed it over (see current() and bind()).
+ *
+ * A finished span is put in a ring buffer that belongs to the thread, so
+ * threads do not lock anything to record spans. When the request ends, the
+ * spans are written to a file in BES.Trace.Dir, in the Chrome trace format
+ * (open it with chrome://tracing or Perfetto) or, when BES.Trace.Format is
+ * 'otlp', as OTLP/JSON. If a thread records more than BES.Trace.BufferSize
+ * spans in a request, the extra spans are dropped and counted.
+ *
+ * When tracing is off, a BESTraceSpan costs one atomic load.
+ */
+class BESTrace {
+private:
+    static std::atomic<uint64_t> d_trace_id;   // Of the request being traced; 0 if none
+    static std::atomic<uint64_t> d_root_id;    // The request's span
+
+    BESTrace() = delete;
+
+    friend class BESTraceSpan;
+
+public:
+    /// The trace of a request, or no trace.
+    static bool is_enabled()
+    {
+        return d_trace_id.load(std::memory_order_relaxed) != 0;
+    }
+
+    static void start_request(const std::string &name);
+    static void end_request(const std::string &request_id);
+
+    static BESTraceContext current();
+    static std::function<void()> bind(std::function<void()> task);
+};
+
+/**
+ * @brief A span of time, from when this is made until it's destroyed
+ *
+ * Attributes describe the work done, e.g. the number of bytes read or
+ * whether a cache was hit.
+ */
+class BESTraceSpan {
+public:
+    enum AttributeType { string_value, int_value, bool_value };
+
+    struct Attribute {
+        std::string key;
+        std::string value;
+        AttributeType type;
+    };
+
+private:
+    const char *d_name;
+    BESTraceContext d_context;
+    BESTraceContext d_previous;
+    uint64_t d_parent_id;
+    int64_t d_start_us;
+    std::vector<Attribute> d_attributes;
+
+    void add_attribute(const std::string &key, const std::string &value, AttributeType type);
+
+public:
+    explicit BESTraceSpan(const char *name);
+    ~BESTraceSpan();
+
+    BESTraceSpan(const BESTraceSpan &) = delete;
+    BESTraceSpan &operator=(const BESTraceSpan &) = delete;
+
+    bool is_recording() const
+    {
+        return d_context.span_id != 0;
+    }
+
+    void set_attribute(const std::string &key, const std::string &value);
+    void set_attribute(const std::string &key, const char *value);
+    void set_attribute(const std::string &key, bool value);
+
+    template<typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type set_attribute(const std::string &key, T value)
+    {
+        if (is_recording()) add_attribute(key, std::to_string(value), int_value);
+    }
+
+    void set_url_attribute(const std::string &url);
+};
+
+/**
+ * @brief Make the spans started by this thread children of another thread's span
+ *
+ * The thread's previous span is restored when this is destroyed.
+ */
+class BESTraceScope {
+private:
+    BESTraceContext d_previous;
+
+public:
+    explicit BESTraceScope(const BESTraceContext &context);
+    ~BESTraceScope();
+
+    BESTraceScope(const BESTraceScope &) = delete;
+    BESTraceScope &operator=(const BESTraceScope &) = delete;
+};
+
+#endif // BESTrace_h_
@@ -30,6 +30,9 @@
 //      pwest       Patrick West <pwest@ucar.edu>
 //      jgarcia     Jose Garcia <jgarcia@ucar.edu>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <zlib.h>
 
 #include <cstdio>
@@ -41,6 +44,7 @@ using std::ostringstream;
 using std::string;
 
 #include "BESUncompress3GZ.h"
+#include "BESGzipIndex.h"
 #include "BESInternalError.h"
 // #include "BESDebug.h"
 
@@ -91,3 +95,44 @@ void BESUncompress3GZ::uncompress(const string &src, int dest_fd)
     gzclose(gsrc);
 }
 
+
+/** @brief uncompress a file with the .gz file extension using an index
+ *
+ * If \arg index has been loaded for \arg src, the file is decompressed by
+ * up to \arg threads threads, each starting at a different access point.
+ * Otherwise the file is decompressed from start to end and the index is
+ * built at the same time, so it can be saved for the next time.
+ *
+ * A file that is not gzip compressed is copied as it is (as the other
+ * uncompress() does) and \arg index is left empty.
+ *
+ * @param src file that will be uncompressed
+ * @param dest_fd the decompressed data are written to this open file; it is
+ * not closed.
+ * @param index The index of \arg src
+ * @param threads The most threads to use
+ */
+void BESUncompress3GZ::uncompress(const string &src, int dest_fd, BESGzipIndex &index, unsigned int threads)
+{
+    if (!index.empty() && index.is_current(src)) {
+        index.extract(src, dest_fd, threads);
+        return;
+    }
+
+    // Is this a gzip file? If not, gzread() copies it.
+    unsigned char id[2] = { 0, 0 };
+    int fd = open(src.c_str(), O_RDONLY);
+    if (fd < 0) {
+        string err = "Could not open the compressed file " + src;
+        throw BESInternalError(err, __FILE__, __LINE__);
+    }
+    ssize_t bytes = read(fd, id, sizeof(id));
+    close(fd);
+
+    if (bytes != sizeof(id) || id[0] != 0x1f || id[1] != 0x8b) {
+        uncompress(src, dest_fd);
+        return;
+    }
+
+    index.build(src, dest_fd);
+}
@@ -37,6 +37,8 @@
 
 #include "BESObj.h"
 
+class BESGzipIndex;
+
 /** @brief Function to uncompress files with .gz extension
  *
  * The static function is responsible for uncompressing gz files. If the
@@ -54,6 +56,7 @@
 class BESUncompress3GZ: public BESObj {
 public:
     static void uncompress(const std::string &src, int dest_fd);
+    static void uncompress(const std::string &src, int dest_fd, BESGzipIndex &index, unsigned int threads);
 };
 
 #endif // BESUncompress3GZ_h_
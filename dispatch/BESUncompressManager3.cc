@@ -27,6 +27,8 @@
 
 #include "config.h"
 
+#include <unistd.h>
+
 #include <sstream>
 
 using std::istringstream;
@@ -38,14 +40,19 @@ using std::string;
 #include "BESUncompress3GZ.h"
 #include "BESUncompress3BZ2.h"
 #include "BESUncompress3Z.h"
+#include "BESGzipIndex.h"
 
 #include "BESFileLockingCache.h"
 
 #include "BESInternalError.h"
 #include "BESDebug.h"
+#include "BESLog.h"
 
 #include "TheBESKeys.h"
 
+#define GZIP_INDEX_KEY "BES.Uncompress.GzipIndex"
+#define THREADS_KEY "BES.Uncompress.Threads"
+
 BESUncompressManager3 *BESUncompressManager3::_instance = 0;
 
 /** @brief constructs an uncompression manager adding gz, z, and bz2
@@ -53,15 +60,24 @@ BESUncompressManager3 *BESUncompressManager3::_instance = 0;
  *
  * Adds methods to uncompress gz, bz2, and Z files.
  *
- * Looks for a configuration parameter for the number of times to try to
- * lock the cache (BES.Uncompress.NumTries) and the time in microseconds
- * between tries (BES.Uncompress.Retry).
+ * Looks for configuration parameters that say whether gzip files should be
+ * indexed (BES.Uncompress.GzipIndex) and how many threads may decompress
+ * an indexed file (BES.Uncompress.Threads).
  */
-BESUncompressManager3::BESUncompressManager3()
+BESUncompressManager3::BESUncompressManager3() : d_gzip_index(false), d_threads(1)
 {
     add_method("gz", BESUncompress3GZ::uncompress);
     add_method("bz2", BESUncompress3BZ2::uncompress);
     add_method("Z", BESUncompress3Z::uncompress);
+
+    try {
+        d_gzip_index = TheBESKeys::TheKeys()->read_bool_key(GZIP_INDEX_KEY, false);
+        int threads = TheBESKeys::TheKeys()->read_int_key(THREADS_KEY, 1);
+        d_threads = threads > 1 ? threads : 1;
+    }
+    catch (BESError &e) {
+        BESDEBUG("uncompress", "BESUncompressManager3::BESUncompressManager3() - " << e.get_message() << endl);
+    }
 }
 
 /** @brief create_and_lock a uncompress method to the list
@@ -102,6 +118,73 @@ p_bes_uncompress BESUncompressManager3::find_method(const string &name)
     return 0;
 }
 
+/**
+ * @brief Load the index of a gzip file from the cache
+ *
+ * A damaged index, or one for an older version of \arg src, is ignored;
+ * \arg index is left empty.
+ */
+void BESUncompressManager3::load_gzip_index(const string &src, const string &index_file, BESFileLockingCache *cache,
+    BESGzipIndex &index)
+{
+    int fd;
+    if (!cache->get_read_lock(index_file, fd))
+        return;
+
+    try {
+        index.load(fd);
+        if (!index.is_current(src))
+            index = BESGzipIndex();
+    }
+    catch (BESError &e) {
+        ERROR_LOG("BESUncompressManager3::load_gzip_index() - Ignoring the index of " << src << ": "
+            << e.get_message() << endl);
+        index = BESGzipIndex();
+    }
+
+    cache->unlock_and_close(index_file);
+
+    BESDEBUG("uncompress", "BESUncompressManager3::load_gzip_index() - " << index_file
+        << (index.empty() ? " not used" : " loaded") << endl);
+}
+
+/**
+ * @brief Add the index of a gzip file to the cache
+ *
+ * Call this holding no exclusive lock, since it may wait for other
+ * processes to release the cache. If the cache holds an out of date index
+ * of the file, it is left until it is purged; waiting here to remove it
+ * could deadlock with a process reading it.
+ */
+void BESUncompressManager3::save_gzip_index(const string &index_file, BESFileLockingCache *cache,
+    const BESGzipIndex &index)
+{
+    int fd;
+    if (!cache->create_and_lock(index_file, fd)) {
+        BESDEBUG("uncompress", "BESUncompressManager3::save_gzip_index() - " << index_file << " exists" << endl);
+        return;
+    }
+
+    try {
+        index.save(fd);
+    }
+    catch (BESError &e) {
+        ERROR_LOG("BESUncompressManager3::save_gzip_index() - " << e.get_message() << endl);
+        // Not yet counted in the cache size, so just remove it
+        unlink(index_file.c_str());
+        cache->unlock_and_close(index_file);
+        return;
+    }
+
+    cache->exclusive_to_shared_lock(fd);
+    unsigned long long size = cache->update_cache_info(index_file);
+    if (cache->cache_too_big(size))
+        cache->update_and_purge(index_file);
+    cache->unlock_and_close(index_file);
+
+    BESDEBUG("uncompress", "BESUncompressManager3::save_gzip_index() - cached " << index_file << endl);
+}
+
 /** @brief If the file 'src' should be uncompressed, do so and return a
  *  new file name on the value-result param 'target'.
  *
@@ -185,6 +268,18 @@ bool BESUncompressManager3::uncompress(const string &src, string &cache_file, BE
             return true;
         }
 
+        // An index of a gzip file lets several threads decompress it. Load it
+        // before locking the new file so this process never waits on the cache
+        // while other processes wait for it.
+        BESGzipIndex index;
+        bool use_index = d_gzip_index && ext == "gz";
+        string index_file;
+        if (use_index) {
+            index_file = cache->get_cache_file_name(src + ".gzi");
+            load_gzip_index(src, index_file, cache, index);
+        }
+        bool index_loaded = !index.empty();
+
         // Now we actually try to uncompress the file, given that there's not a decomp'd version
         // in the cache. First make an empty file and get an exclusive lock on it.
         if (cache->create_and_lock(cache_file, fd)) {
@@ -192,7 +287,10 @@ bool BESUncompressManager3::uncompress(const string &src, string &cache_file, BE
 
             // uncompress. Make sure that the decompression function does not close
             // the file descriptor.
-            p(src, fd);
+            if (use_index)
+                BESUncompress3GZ::uncompress(src, fd, index, d_threads);
+            else
+                p(src, fd);
 
             // Change the exclusive lock on the new file to a shared lock. This keeps
             // other processes from purging the new file and ensures that the reading
@@ -206,6 +304,11 @@ bool BESUncompressManager3::uncompress(const string &src, string &cache_file, BE
             if (cache->cache_too_big(size))
             	cache->update_and_purge(cache_file);
 
+            // The new file is only share locked now, so saving the index
+            // cannot keep a reader waiting on it from finishing.
+            if (use_index && !index_loaded && !index.empty())
+                save_gzip_index(index_file, cache, index);
+
             return true;
         }
         else {
@@ -33,6 +33,7 @@
 #include "BESObj.h"
 
 class BESFileLockingCache;
+class BESGzipIndex;
 
 typedef void (*p_bes_uncompress)(const std::string &src, int fd);
 
@@ -58,8 +59,15 @@ private:
     std::map<std::string, p_bes_uncompress> _uncompress_list;
     typedef std::map<std::string, p_bes_uncompress>::const_iterator UCIter;
 
+    bool d_gzip_index;
+    unsigned int d_threads;
+
     BESUncompressManager3(void);
 
+    void load_gzip_index(const std::string &src, const std::string &index_file, BESFileLockingCache *cache,
+        BESGzipIndex &index);
+    void save_gzip_index(const std::string &index_file, BESFileLockingCache *cache, const BESGzipIndex &index);
+
 public:
     virtual ~BESUncompressManager3(void)
     {
@@ -47,6 +47,7 @@
 #include <cassert>
 #include <vector>
 #include <list>
+#include <algorithm>
 
 #include <sstream>
 #include <iostream>
@@ -59,9 +60,11 @@ using std::vector;
 using std::string;
 using std::list;
 using std::ostream;
+using std::min;
 
 #include "TheBESKeys.h"
 #include "BESUtil.h"
+#include "BESFileSink.h"
 #include "BESDebug.h"
 #include "BESForbiddenError.h"
 #include "BESNotFoundError.h"
@@ -981,6 +984,78 @@ void BESUtil::conditional_timeout_cancel()
     if (cancel_timeout_on_send) alarm(0);
 }
 
+/**
+ * @brief Write the rest of an open file to a stream
+ *
+ * The bytes from the file's current offset to its end are written and the
+ * offset is left at the end of the file.
+ *
+ * @param fd Open for reading
+ * @param os Write the file here
+ * @exception BESInternalError if the file cannot be read or sent
+ * @see file_to_stream(int, off_t, off_t, std::ostream &)
+ */
+void BESUtil::file_to_stream(int fd, ostream &os)
+{
+    struct stat sb;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset != -1 && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size >= offset) {
+        file_to_stream(fd, offset, sb.st_size - offset, os);
+        lseek(fd, sb.st_size, SEEK_SET);
+        return;
+    }
+
+    // Not a regular file; read until there's nothing left
+    vector<char> buf(65536);
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, &buf[0], buf.size())) > 0)
+        os.write(&buf[0], bytes_read);
+
+    if (bytes_read < 0)
+        throw BESInternalError(string("Could not read the file: ") + strerror(errno), __FILE__, __LINE__);
+}
+
+/**
+ * @brief Write part of a file to a stream
+ *
+ * If the stream's buffer is a BESFileSink (e.g., the PPT connection to the
+ * front end) the file is handed to it, so it can go to the socket without
+ * being copied through the stream; otherwise it is copied. The file's
+ * offset is not used or changed.
+ *
+ * @param fd Open for reading
+ * @param offset Write the bytes starting here
+ * @param length Write this many bytes
+ * @param os Write the bytes here
+ * @exception BESInternalError if the file cannot be read or sent
+ */
+void BESUtil::file_to_stream(int fd, off_t offset, off_t length, ostream &os)
+{
+    BESFileSink *sink = dynamic_cast<BESFileSink*>(os.rdbuf());
+    if (sink) {
+        BESDEBUG(debug_key, prolog << "Sending " << length << " bytes from fd " << fd << endl);
+        // Whatever has been written to the stream goes ahead of the file
+        os.flush();
+        if (!sink->send_file(fd, offset, length))
+            throw BESInternalError(string("Could not send the file: ") + strerror(errno), __FILE__, __LINE__);
+        return;
+    }
+
+    vector<char> buf(min(length, (off_t) 65536));
+    while (length > 0) {
+        ssize_t bytes_read = pread(fd, &buf[0], min(length, (off_t) buf.size()), offset);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read <= 0)
+            throw BESInternalError(string("Could not read the file: ")
+                + (bytes_read < 0 ? strerror(errno) : "it is too short"), __FILE__, __LINE__);
+
+        os.write(&buf[0], bytes_read);
+        offset += bytes_read;
+        length -= bytes_read;
+    }
+}
+
 /**
  * @brief Operates on the string 's' to replaces every occurrence of the value of the string
  * 'find_this' with the value of the string 'replace_with_this'
@@ -33,6 +33,8 @@
 #ifndef E_BESUtil_h
 #define E_BESUtil_h 1
 
+#include <sys/types.h>
+
 #include <string>
 #include <list>
 #include <iostream>
@@ -108,6 +110,9 @@ public:
     static bool endsWith(std::string const &fullString, std::string const &ending);
     static void conditional_timeout_cancel();
 
+    static void file_to_stream(int fd, std::ostream &os);
+    static void file_to_stream(int fd, off_t offset, off_t length, std::ostream &os);
+
     static void replace_all(std::string &s, std::string find_this, std::string replace_with_this);
     static std::string normalize_path(const std::string &path, bool leading_separator, bool trailing_separator, const std::string separator = "/");
     static void tokenize(const std::string& str, std::vector<std::string>& tokens, const std::string& delimiters = "/");
@@ -454,7 +454,8 @@ int TheBESKeys::read_int_key(const string &key, int default_value)
         std::istringstream iss(value);
         int int_val;
         iss >> int_val;
-        if (iss.eof() || iss.bad() || iss.fail())
+        // eof() is true once all of a well-formed value is read; only a failed read is an error
+        if (iss.bad() || iss.fail())
             return default_value;
         else
             return int_val;
@@ -0,0 +1,359 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <GetOpt.h>
+
+#include "BESGzipIndex.h"
+#include "BESUncompress3GZ.h"
+#include "BESInternalError.h"
+#include "BESDebug.h"
+#include "BESUtil.h"
+
+#include "test_config.h"
+
+using namespace std;
+using namespace CppUnit;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+// Small, so the test files have many access points
+static const uint64_t span = 64 * 1024;
+
+static const string test_dir = BESUtil::assemblePath(TEST_BUILD_DIR, "gzip_index_test");
+
+class GzipIndexTest: public TestFixture {
+private:
+    string d_data;
+
+    // Text-like data that compresses about as well as real data
+    static string make_data(size_t size, unsigned int seed)
+    {
+        string data(size, ' ');
+        for (size_t i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = "abcdefghij 0123\n"[(seed >> 16) % 16];
+        }
+        return data;
+    }
+
+    static void write_gzip(const string &path, const string &data, const char *mode = "wb")
+    {
+        gzFile file = gzopen(path.c_str(), mode);
+        CPPUNIT_ASSERT(file);
+        CPPUNIT_ASSERT(gzwrite(file, data.data(), data.size()) == (int) data.size());
+        gzclose(file);
+    }
+
+    static string read_file(int fd)
+    {
+        string contents;
+        char buf[4096];
+        ssize_t bytes;
+        lseek(fd, 0, SEEK_SET);
+        while ((bytes = read(fd, buf, sizeof(buf))) > 0)
+            contents.append(buf, bytes);
+        return contents;
+    }
+
+    static int open_output(const string &name)
+    {
+        int fd = open(BESUtil::assemblePath(test_dir, name).c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        CPPUNIT_ASSERT(fd >= 0);
+        return fd;
+    }
+
+    // Read from many places and compare with the data
+    void check_reads(const BESGzipIndex &index, const string &src, const string &data)
+    {
+        int fd = open(src.c_str(), O_RDONLY);
+        CPPUNIT_ASSERT(fd >= 0);
+
+        unsigned int seed = 17;
+        for (int i = 0; i < 100; ++i) {
+            seed = seed * 1103515245 + 12345;
+            uint64_t offset = seed % data.size();
+            seed = seed * 1103515245 + 12345;
+            size_t len = seed % (3 * span);
+
+            vector<char> buf(len);
+            size_t bytes = index.read(fd, offset, buf.data(), len);
+            CPPUNIT_ASSERT(bytes == min(len, (size_t) (data.size() - offset)));
+            CPPUNIT_ASSERT(memcmp(buf.data(), data.data() + offset, bytes) == 0);
+        }
+
+        close(fd);
+    }
+
+public:
+    GzipIndexTest()
+    {
+    }
+
+    ~GzipIndexTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,uncompress");
+
+        mkdir(test_dir.c_str(), 0755);
+
+        d_data = make_data(1024 * 1024, 1);
+        write_gzip(BESUtil::assemblePath(test_dir, "test.gz"), d_data);
+    }
+
+    void tearDown()
+    {
+    }
+
+    CPPUNIT_TEST_SUITE( GzipIndexTest );
+
+    CPPUNIT_TEST(build_test);
+    CPPUNIT_TEST(read_test);
+    CPPUNIT_TEST(save_load_test);
+    CPPUNIT_TEST(load_damaged_test);
+    CPPUNIT_TEST(extract_test);
+    CPPUNIT_TEST(multiple_member_test);
+    CPPUNIT_TEST(not_gzip_test);
+    CPPUNIT_TEST(stream_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    void build_test()
+    {
+        BESGzipIndex index(span);
+        CPPUNIT_ASSERT(index.empty());
+
+        int fd = open_output("build.out");
+        index.build(BESUtil::assemblePath(test_dir, "test.gz"), fd);
+        string data = read_file(fd);
+        close(fd);
+
+        DBG(cerr << "Access points: " << index.get_num_points() << endl);
+
+        CPPUNIT_ASSERT(data == d_data);
+        CPPUNIT_ASSERT(index.get_size() == d_data.size());
+        CPPUNIT_ASSERT(index.get_num_points() > 1);
+        CPPUNIT_ASSERT(index.is_current(BESUtil::assemblePath(test_dir, "test.gz")));
+    }
+
+    void read_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "test.gz");
+        BESGzipIndex index(span);
+        index.build(src);
+
+        check_reads(index, src, d_data);
+    }
+
+    void save_load_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "test.gz");
+        BESGzipIndex index(span);
+        index.build(src);
+
+        int fd = open_output("test.gzi");
+        index.save(fd);
+
+        BESGzipIndex loaded;
+        loaded.load(fd);
+        close(fd);
+
+        CPPUNIT_ASSERT(loaded.get_size() == index.get_size());
+        CPPUNIT_ASSERT(loaded.get_num_points() == index.get_num_points());
+        CPPUNIT_ASSERT(loaded.is_current(src));
+        check_reads(loaded, src, d_data);
+
+        // A new version of the file makes the index out of date
+        write_gzip(src, d_data + "more");
+        CPPUNIT_ASSERT(!loaded.is_current(src));
+    }
+
+    void load_damaged_test()
+    {
+        int fd = open_output("damaged.gzi");
+        CPPUNIT_ASSERT(write(fd, "BESGZI1\0garbage", 15) == 15);
+
+        BESGzipIndex index;
+        CPPUNIT_ASSERT_THROW(index.load(fd), BESInternalError);
+        CPPUNIT_ASSERT(index.empty());
+        close(fd);
+    }
+
+    void extract_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "test.gz");
+        BESGzipIndex index(span);
+        index.build(src);
+
+        int fd = open_output("extract.out");
+        index.extract(src, fd, 4);
+        CPPUNIT_ASSERT(read_file(fd) == d_data);
+        close(fd);
+
+        // The same, using BESUncompress3GZ with a current index
+        fd = open_output("uncompress.out");
+        BESUncompress3GZ::uncompress(src, fd, index, 4);
+        CPPUNIT_ASSERT(read_file(fd) == d_data);
+        close(fd);
+    }
+
+    void multiple_member_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "members.gz");
+        string second = make_data(200 * 1024, 2);
+        string third = make_data(300 * 1024, 3);
+        write_gzip(src, d_data);
+        write_gzip(src, second, "ab");
+        write_gzip(src, third, "ab");
+        string data = d_data + second + third;
+
+        BESGzipIndex index(span);
+        int fd = open_output("members.out");
+        BESUncompress3GZ::uncompress(src, fd, index, 4);
+        CPPUNIT_ASSERT(read_file(fd) == data);
+        close(fd);
+
+        CPPUNIT_ASSERT(index.get_size() == data.size());
+        check_reads(index, src, data);
+
+        fd = open_output("members_extract.out");
+        index.extract(src, fd, 4);
+        CPPUNIT_ASSERT(read_file(fd) == data);
+        close(fd);
+    }
+
+    void not_gzip_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "plain.gz");
+        int fd = open_output("plain.gz");
+        CPPUNIT_ASSERT(write(fd, "Not compressed", 14) == 14);
+        close(fd);
+
+        // Copied, as gzread() does, and not indexed
+        BESGzipIndex index(span);
+        fd = open_output("plain.out");
+        BESUncompress3GZ::uncompress(src, fd, index, 4);
+        CPPUNIT_ASSERT(read_file(fd) == "Not compressed");
+        CPPUNIT_ASSERT(index.empty());
+        close(fd);
+    }
+
+    void stream_test()
+    {
+        string src = BESUtil::assemblePath(test_dir, "test.gz");
+        shared_ptr<BESGzipIndex> index(new BESGzipIndex(span));
+        index->build(src);
+
+        BESGzipStreamBuf buf(index, src, 4096);
+        istream is(&buf);
+
+        char chars[20];
+        is.seekg(3 * span - 10);
+        is.read(chars, sizeof(chars));
+        CPPUNIT_ASSERT(is);
+        CPPUNIT_ASSERT(memcmp(chars, d_data.data() + 3 * span - 10, sizeof(chars)) == 0);
+        CPPUNIT_ASSERT(is.tellg() == streampos(3 * span + 10));
+
+        // Backward
+        is.seekg(5);
+        is.read(chars, sizeof(chars));
+        CPPUNIT_ASSERT(memcmp(chars, d_data.data() + 5, sizeof(chars)) == 0);
+
+        is.seekg(-7, ios::end);
+        string end((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+        CPPUNIT_ASSERT(end == d_data.substr(d_data.size() - 7));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(GzipIndexTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: GzipIndexTest has the following tests:" << endl;
+            const vector<Test*> &tests = GzipIndexTest::suite()->getTests();
+            unsigned int prefix_len = GzipIndexTest::suite()->getName().append("::").length();
+            for (vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = GzipIndexTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
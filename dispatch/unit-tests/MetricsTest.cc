@@ -0,0 +1,383 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GetOpt.h>
+
+#include "BESMetrics.h"
+#include "BESDebug.h"
+#include "BESUtil.h"
+#include "TheBESKeys.h"
+
+#include "test_config.h"
+
+using namespace std;
+using namespace CppUnit;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+static const string test_dir = BESUtil::assemblePath(TEST_BUILD_DIR, "metrics_test");
+
+class MetricsTest: public TestFixture {
+private:
+    static string prometheus()
+    {
+        ostringstream oss;
+        BESMetrics::TheMetrics()->write_prometheus(oss);
+        DBG(cerr << oss.str() << endl);
+        return oss.str();
+    }
+
+    static bool has_line(const string &text, const string &line)
+    {
+        return text.find("\n" + line + "\n") != string::npos || text.find(line + "\n") == 0;
+    }
+
+public:
+    MetricsTest()
+    {
+    }
+
+    ~MetricsTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,metrics");
+
+        mkdir(test_dir.c_str(), 0755);
+
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append("/bes.conf");
+    }
+
+    void tearDown()
+    {
+    }
+
+    CPPUNIT_TEST_SUITE( MetricsTest );
+
+    CPPUNIT_TEST(bucket_test);
+    CPPUNIT_TEST(label_test);
+    CPPUNIT_TEST(counter_test);
+    CPPUNIT_TEST(histogram_test);
+    CPPUNIT_TEST(hit_ratio_test);
+    CPPUNIT_TEST(type_test);
+    CPPUNIT_TEST(fork_test);
+    CPPUNIT_TEST(process_gauge_test);
+    CPPUNIT_TEST(release_scopes_test);
+    CPPUNIT_TEST(file_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    void bucket_test()
+    {
+        CPPUNIT_ASSERT(BESMetrics::bucket(0) == 0);
+        CPPUNIT_ASSERT(BESMetrics::bucket(3) == 3);
+
+        // Each value is in [upper bound of the previous bucket, upper bound of its bucket)
+        for (uint64_t us = 0; us < 100000; ++us) {
+            unsigned int b = BESMetrics::bucket(us);
+            CPPUNIT_ASSERT(us < BESMetrics::bucket_upper_bound(b));
+            if (b > 0) CPPUNIT_ASSERT(us >= BESMetrics::bucket_upper_bound(b - 1));
+        }
+
+        // Buckets are no more than a quarter of their lower bound wide
+        for (unsigned int b = 5; b < BESMetrics::histogram_buckets; ++b) {
+            uint64_t lower = BESMetrics::bucket_upper_bound(b - 1);
+            CPPUNIT_ASSERT(BESMetrics::bucket_upper_bound(b) - lower <= lower / 4);
+        }
+
+        CPPUNIT_ASSERT(BESMetrics::bucket(~0ULL) == BESMetrics::histogram_buckets - 1);
+    }
+
+    void label_test()
+    {
+        CPPUNIT_ASSERT(BESMetrics::label("action", "get.dods") == "action=\"get.dods\"");
+        CPPUNIT_ASSERT(BESMetrics::label("path", "a\"b\\c\nd") == "path=\"a\\\"b\\\\c\\nd\"");
+    }
+
+    void counter_test()
+    {
+        static BESMetric counter(BESMetrics::counter, "test_counter_total", "A counter", "a=\"1\"");
+        counter.add();
+        counter.add(2);
+
+        static BESMetric gauge(BESMetrics::gauge, "test_gauge", "A gauge");
+        {
+            BESMetricScope scope(gauge);
+            CPPUNIT_ASSERT(has_line(prometheus(), "test_gauge 1"));
+        }
+
+        string text = prometheus();
+        CPPUNIT_ASSERT(has_line(text, "# HELP test_counter_total A counter"));
+        CPPUNIT_ASSERT(has_line(text, "# TYPE test_counter_total counter"));
+        CPPUNIT_ASSERT(has_line(text, "test_counter_total{a=\"1\"} 3"));
+        CPPUNIT_ASSERT(has_line(text, "# TYPE test_gauge gauge"));
+        CPPUNIT_ASSERT(has_line(text, "test_gauge 0"));
+    }
+
+    void histogram_test()
+    {
+        BESMetrics *metrics = BESMetrics::TheMetrics();
+        BESMetrics::Series *series = metrics->get_series(BESMetrics::histogram, "test_duration_seconds",
+            BESMetrics::label("action", "test"), "A histogram");
+        CPPUNIT_ASSERT(series);
+        CPPUNIT_ASSERT(series == metrics->get_series(BESMetrics::histogram, "test_duration_seconds",
+            BESMetrics::label("action", "test"), "A histogram"));
+
+        BESMetrics::observe(series, 0.002);
+        BESMetrics::observe(series, 0.002);
+        BESMetrics::observe(series, 0.002);
+        BESMetrics::observe(series, 0.5);
+
+        string text = prometheus();
+        CPPUNIT_ASSERT(has_line(text, "# TYPE test_duration_seconds histogram"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_bucket{action=\"test\",le=\"0.001024\"} 0"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_bucket{action=\"test\",le=\"0.002048\"} 3"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_bucket{action=\"test\",le=\"0.524288\"} 4"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_bucket{action=\"test\",le=\"+Inf\"} 4"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_sum{action=\"test\"} 0.506"));
+        CPPUNIT_ASSERT(has_line(text, "test_duration_seconds_count{action=\"test\"} 4"));
+    }
+
+    void hit_ratio_test()
+    {
+        static BESMetric hits(BESMetrics::counter, METRICS_CACHE_HITS, "Hits", "cache=\"test\"");
+        static BESMetric misses(BESMetrics::counter, METRICS_CACHE_MISSES, "Misses", "cache=\"test\"");
+        hits.add(3);
+        misses.add(1);
+
+        CPPUNIT_ASSERT(has_line(prometheus(), "bes_cache_hit_ratio{cache=\"test\"} 0.75"));
+    }
+
+    void type_test()
+    {
+        BESMetrics *metrics = BESMetrics::TheMetrics();
+        CPPUNIT_ASSERT(metrics->get_series(BESMetrics::counter, "test_type", "", "A counter"));
+        CPPUNIT_ASSERT(!metrics->get_series(BESMetrics::gauge, "test_type", "", "A gauge"));
+
+        // Updating a series that could not be added does nothing
+        uint64_t dropped = metrics->get_dropped();
+        BESMetrics::Series *series = metrics->get_series(BESMetrics::counter, string(BESMetrics::max_name_length + 1,
+            'x'), "", "Too long");
+        CPPUNIT_ASSERT(!series);
+        BESMetrics::add(series, 1);
+        CPPUNIT_ASSERT(metrics->get_dropped() == dropped + 1);
+    }
+
+    // Processes forked after the metrics are made add to the same series
+    void fork_test()
+    {
+        static BESMetric counter(BESMetrics::counter, "test_fork_total", "Added to by children");
+        counter.add();
+
+        const int children = 4;
+        vector<pid_t> pids;
+        for (int i = 0; i < children; ++i) {
+            pid_t pid = fork();
+            CPPUNIT_ASSERT(pid != -1);
+            if (pid == 0) {
+                for (int n = 0; n < 1000; ++n)
+                    counter.add();
+                // A series the parent has not seen
+                BESMetrics::add(BESMetrics::TheMetrics()->get_series(BESMetrics::counter, "test_child_total", "",
+                    "Added by children"), 1);
+                _exit(0);
+            }
+            pids.push_back(pid);
+        }
+
+        for (vector<pid_t>::iterator i = pids.begin(), e = pids.end(); i != e; ++i) {
+            int status;
+            CPPUNIT_ASSERT(waitpid(*i, &status, 0) == *i);
+            CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+
+        string text = prometheus();
+        CPPUNIT_ASSERT(has_line(text, "test_fork_total 4001"));
+        CPPUNIT_ASSERT(has_line(text, "test_child_total 4"));
+    }
+
+    // A process that exits while it holds part of a process gauge no longer counts
+    void process_gauge_test()
+    {
+        static BESMetric gauge(BESMetrics::process_gauge, "test_process_gauge", "Held by processes");
+        gauge.add(1);
+
+        int ready[2], done[2];
+        CPPUNIT_ASSERT(pipe(ready) == 0 && pipe(done) == 0);
+
+        pid_t pid = fork();
+        CPPUNIT_ASSERT(pid != -1);
+        if (pid == 0) {
+            // Leave the gauge without subtracting, as a killed beslistener would
+            gauge.add(5);
+            char c = 'R';
+            if (write(ready[1], &c, 1) != 1) _exit(1);
+            if (read(done[0], &c, 1) != 1) _exit(1);
+            _exit(0);
+        }
+
+        char c;
+        CPPUNIT_ASSERT(read(ready[0], &c, 1) == 1);
+        string text = prometheus();
+        CPPUNIT_ASSERT(has_line(text, "# TYPE test_process_gauge gauge"));
+        CPPUNIT_ASSERT(has_line(text, "test_process_gauge 6"));
+
+        CPPUNIT_ASSERT(write(done[1], &c, 1) == 1);
+        int status;
+        CPPUNIT_ASSERT(waitpid(pid, &status, 0) == pid);
+        CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        close(ready[0]); close(ready[1]); close(done[0]); close(done[1]);
+
+        CPPUNIT_ASSERT(has_line(prometheus(), "test_process_gauge 1"));
+
+        // A new process gets a slot of its own, starting at zero
+        pid = fork();
+        CPPUNIT_ASSERT(pid != -1);
+        if (pid == 0) {
+            gauge.add(1);
+            string text = prometheus();
+            _exit(has_line(text, "test_process_gauge 2") ? 0 : 1);
+        }
+        CPPUNIT_ASSERT(waitpid(pid, &status, 0) == pid);
+        CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        gauge.add(-1);
+        CPPUNIT_ASSERT(has_line(prometheus(), "test_process_gauge 0"));
+    }
+
+    // Scopes skipped by a longjmp(), like the one the request timeout uses, are released
+    void release_scopes_test()
+    {
+        static BESMetric gauge(BESMetrics::process_gauge, "test_scope_gauge", "Held by scopes");
+
+        size_t keep = BESMetricScope::open_scopes();
+        BESMetricScope outer(gauge);
+
+        jmp_buf jump;
+        size_t open = BESMetricScope::open_scopes();
+        if (setjmp(jump) == 0) {
+            jump_from_scopes(gauge, jump);
+        }
+        else {
+            CPPUNIT_ASSERT(BESMetricScope::open_scopes() == open + 2);
+            CPPUNIT_ASSERT(has_line(prometheus(), "test_scope_gauge 3"));
+            BESMetricScope::release_scopes(open);
+        }
+
+        CPPUNIT_ASSERT(BESMetricScope::open_scopes() == keep + 1);
+        CPPUNIT_ASSERT(has_line(prometheus(), "test_scope_gauge 1"));
+    }
+
+    static void jump_from_scopes(BESMetric &gauge, jmp_buf &jump)
+    {
+        BESMetricScope first(gauge);
+        BESMetricScope second(gauge);
+        longjmp(jump, 1);
+    }
+
+    void file_test()
+    {
+        static BESMetric counter(BESMetrics::counter, "test_file_total", "Written to a file");
+        counter.add(7);
+
+        string path = BESUtil::assemblePath(test_dir, "metrics.prom");
+        BESMetrics::TheMetrics()->write_file(path);
+
+        ifstream in(path.c_str());
+        ostringstream text;
+        text << in.rdbuf();
+        unlink(path.c_str());
+
+        CPPUNIT_ASSERT(has_line(text.str(), "test_file_total 7"));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MetricsTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: MetricsTest has the following tests:" << endl;
+            const vector<Test*> &tests = MetricsTest::suite()->getTests();
+            unsigned int prefix_len = MetricsTest::suite()->getName().append("::").length();
+            for (vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = MetricsTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
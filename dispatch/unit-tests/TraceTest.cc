@@ -0,0 +1,263 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <GetOpt.h>
+
+#include "BESTrace.h"
+#include "BESDebug.h"
+#include "BESUtil.h"
+#include "TheBESKeys.h"
+
+#include "test_config.h"
+
+using namespace std;
+using namespace CppUnit;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+static const string test_dir = BESUtil::assemblePath(TEST_BUILD_DIR, "trace_test");
+
+class TraceTest: public TestFixture {
+private:
+    static string hex_id(uint64_t id)
+    {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) id);
+        return buf;
+    }
+
+    // The text of the trace file written by end_request(); the file is removed
+    static string read_trace()
+    {
+        string name;
+        DIR *dir = opendir(test_dir.c_str());
+        CPPUNIT_ASSERT(dir);
+        while (struct dirent *entry = readdir(dir)) {
+            if (string(entry->d_name).find("bes_trace_") == 0) name = entry->d_name;
+        }
+        closedir(dir);
+        CPPUNIT_ASSERT(!name.empty());
+
+        string path = BESUtil::assemblePath(test_dir, name);
+        ifstream in(path.c_str());
+        ostringstream trace;
+        trace << in.rdbuf();
+        unlink(path.c_str());
+
+        DBG(cerr << trace.str() << endl);
+        return trace.str();
+    }
+
+    // The trace has a span with this id and parent
+    static bool has_span(const string &trace, uint64_t span_id, uint64_t parent_id)
+    {
+        return trace.find("\"span_id\":\"" + hex_id(span_id) + "\",\"parent_id\":\"" + hex_id(parent_id) + "\"")
+            != string::npos;
+    }
+
+public:
+    TraceTest()
+    {
+    }
+
+    ~TraceTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,trace");
+
+        mkdir(test_dir.c_str(), 0755);
+
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append("/bes.conf");
+        TheBESKeys::TheKeys()->set_key("BES.Trace.Dir", test_dir);
+    }
+
+    void tearDown()
+    {
+    }
+
+    CPPUNIT_TEST_SUITE( TraceTest );
+
+    CPPUNIT_TEST(no_request_test);
+    CPPUNIT_TEST(request_test);
+    CPPUNIT_TEST(thread_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    void no_request_test()
+    {
+        CPPUNIT_ASSERT(!BESTrace::is_enabled());
+
+        BESTraceSpan span("not traced");
+        span.set_attribute("bytes", 10);
+        CPPUNIT_ASSERT(!span.is_recording());
+        CPPUNIT_ASSERT(BESTrace::current().trace_id == 0);
+    }
+
+    void request_test()
+    {
+        BESTrace::start_request("request");
+        CPPUNIT_ASSERT(BESTrace::is_enabled());
+        uint64_t root_id = BESTrace::current().span_id;
+
+        uint64_t outer_id, inner_id;
+        {
+            BESTraceSpan outer("outer");
+            CPPUNIT_ASSERT(outer.is_recording());
+            outer_id = BESTrace::current().span_id;
+            outer.set_attribute("bytes", 1024ULL);
+            outer.set_attribute("cache.hit", true);
+            outer.set_url_attribute("https://user:pw@data.example.com:8080/path/file.nc?x=\"1\"");
+            {
+                BESTraceSpan inner("inner");
+                inner_id = BESTrace::current().span_id;
+            }
+            CPPUNIT_ASSERT(BESTrace::current().span_id == outer_id);
+        }
+
+        BESTrace::end_request("test-request-1");
+        CPPUNIT_ASSERT(!BESTrace::is_enabled());
+
+        string trace = read_trace();
+        CPPUNIT_ASSERT(trace.find("\"traceEvents\"") != string::npos);
+        CPPUNIT_ASSERT(trace.find("\"request_id\":\"test-request-1\"") != string::npos);
+        CPPUNIT_ASSERT(has_span(trace, root_id, 0));
+        CPPUNIT_ASSERT(has_span(trace, outer_id, root_id));
+        CPPUNIT_ASSERT(has_span(trace, inner_id, outer_id));
+        CPPUNIT_ASSERT(trace.find("\"bytes\":1024") != string::npos);
+        CPPUNIT_ASSERT(trace.find("\"cache.hit\":true") != string::npos);
+        CPPUNIT_ASSERT(trace.find("\"url.host\":\"data.example.com:8080\"") != string::npos);
+    }
+
+    void thread_test()
+    {
+        BESTrace::start_request("request");
+        uint64_t root_id = BESTrace::current().span_id;
+
+        uint64_t parent_id, scoped_id, bound_id, unscoped_id;
+        {
+            BESTraceSpan parent("parent");
+            parent_id = BESTrace::current().span_id;
+
+            BESTraceContext context = BESTrace::current();
+            thread scoped([context, &scoped_id]() {
+                BESTraceScope scope(context);
+                BESTraceSpan span("scoped");
+                scoped_id = BESTrace::current().span_id;
+            });
+            scoped.join();
+
+            thread bound(BESTrace::bind([&bound_id]() {
+                BESTraceSpan span("bound");
+                bound_id = BESTrace::current().span_id;
+            }));
+            bound.join();
+
+            // Without a scope, a thread's spans are children of the request
+            thread unscoped([&unscoped_id]() {
+                BESTraceSpan span("unscoped");
+                unscoped_id = BESTrace::current().span_id;
+            });
+            unscoped.join();
+        }
+
+        BESTrace::end_request("test-request-2");
+
+        string trace = read_trace();
+        CPPUNIT_ASSERT(has_span(trace, parent_id, root_id));
+        CPPUNIT_ASSERT(has_span(trace, scoped_id, parent_id));
+        CPPUNIT_ASSERT(has_span(trace, bound_id, parent_id));
+        CPPUNIT_ASSERT(has_span(trace, unscoped_id, root_id));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TraceTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: TraceTest has the following tests:" << endl;
+            const vector<Test*> &tests = TraceTest::suite()->getTests();
+            unsigned int prefix_len = TraceTest::suite()->getName().append("::").length();
+            for (vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = TraceTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
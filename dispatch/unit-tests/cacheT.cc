@@ -56,6 +56,7 @@ using std::ostringstream;
 #include <BESDebug.h>
 #include <BESUtil.h>
 #include <BESFileLockingCache.h>
+#include <BESCacheIndex.h>
 
 #include "test_config.h"
 
@@ -491,6 +492,51 @@ public:
         DBG(cerr << __func__ << "() - END " << endl);
     }
 
+    // The same purge, using a cache index. The index is built from the files
+    // already in the cache and the purge chooses the files from the index.
+    void test_cache_purge_with_index()
+    {
+        DBG(cerr << endl << __func__ << "() - BEGIN " << endl);
+
+        init_cache(TEST_CACHE_DIR);
+        TheBESKeys::TheKeys()->set_key("BES.FileLockingCache.UseIndex", "yes");
+
+        try {
+            BESFileLockingCache cache(TEST_CACHE_DIR, CACHE_PREFIX, 1);
+            CPPUNIT_ASSERT(cache.d_index);
+            CPPUNIT_ASSERT(cache.d_index->is_valid());
+            CPPUNIT_ASSERT_EQUAL((uint64_t) 8, cache.d_index->get_count());
+            CPPUNIT_ASSERT(cache.cache_too_big(cache.get_cache_size()));
+
+            string latest_cache_file = cache.get_cache_file_name("/usr/local/data/template01.txt");
+            cache.update_and_purge(latest_cache_file);
+
+            check_cache(TEST_CACHE_DIR, "bes_cache#usr#local#data#template01.txt", 4);
+            CPPUNIT_ASSERT_EQUAL((uint64_t) 4, cache.d_index->get_count());
+            CPPUNIT_ASSERT(cache.get_cache_size() <= cache.d_target_size);
+
+            // Removing a file from the cache removes it from the index
+            unsigned long long size = cache.get_cache_size();
+            cache.purge_file(latest_cache_file);
+            CPPUNIT_ASSERT_EQUAL((uint64_t) 3, cache.d_index->get_count());
+            CPPUNIT_ASSERT(cache.get_cache_size() < size);
+
+            // Adding one adds it to the index
+            string cmd = "cp -f " + BESUtil::assemblePath(TEST_CACHE_DIR, "template.txt") + " " + latest_cache_file;
+            run_sys(cmd);
+            CPPUNIT_ASSERT_EQUAL(size, cache.update_cache_info(latest_cache_file));
+            CPPUNIT_ASSERT_EQUAL((uint64_t) 4, cache.d_index->get_count());
+        }
+        catch (BESError &e) {
+            TheBESKeys::TheKeys()->set_key("BES.FileLockingCache.UseIndex", "no");
+            CPPUNIT_FAIL("purge failed: " + e.get_message());
+        }
+
+        TheBESKeys::TheKeys()->set_key("BES.FileLockingCache.UseIndex", "no");
+
+        DBG(cerr << __func__ << "() - END " << endl);
+    }
+
     void test_64_bit_cache_sizes()
     {
         if (RUN_64_BIT_CACHE_TEST) {
@@ -516,6 +562,7 @@ CPPUNIT_TEST_SUITE( cacheT );
     CPPUNIT_TEST(test_check_cache_for_non_existent_compressed_file);
     CPPUNIT_TEST(test_find_exisiting_cached_file);
     CPPUNIT_TEST(test_cache_purge);
+    CPPUNIT_TEST(test_cache_purge_with_index);
     CPPUNIT_TEST(test_64_bit_cache_sizes);
 
     CPPUNIT_TEST_SUITE_END();
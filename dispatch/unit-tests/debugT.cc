@@ -83,6 +83,7 @@ public:
 CPPUNIT_TEST_SUITE( debugT );
 
     CPPUNIT_TEST(do_test);
+    CPPUNIT_TEST(channel_test);
 
     CPPUNIT_TEST_SUITE_END()
     ;
@@ -215,6 +216,47 @@ CPPUNIT_TEST_SUITE( debugT );
         cout << "*****************************************" << endl;
         cout << "Returning from debugT::run" << endl;
     }
+
+    void channel_test()
+    {
+        static BESDebugChannel<> h5("h5");
+        static BESDebugChannel<BES_DEBUG_MAX_LEVEL + 1> h5_verbose("h5:verbose");
+
+        ostringstream strm;
+        BESDebug::SetStrm(&strm, false);
+
+        BESDebug::Set("h5", false);
+        CPPUNIT_ASSERT(!BESDebug::IsSet(h5));
+        BESDEBUG(h5, "should not produce debug output");
+        CPPUNIT_ASSERT(strm.str().empty());
+
+        // The handle has been used, so it must see this change
+        BESDebug::Set("h5", true);
+        CPPUNIT_ASSERT(BESDebug::IsSet(h5));
+        string debug_str = "Testing h5 debug";
+        BESDEBUG(h5, debug_str);
+        compare_debug(strm.str(), debug_str);
+
+        // Channels above BES_DEBUG_MAX_LEVEL are compiled out
+        BESDebug::Set("h5:verbose", true);
+        CPPUNIT_ASSERT(BESDebug::IsSet(h5_verbose));
+        ostringstream verbose;
+        BESDebug::SetStrm(&verbose, false);
+        BESDEBUG(h5_verbose, "should not produce debug output");
+        CPPUNIT_ASSERT(verbose.str().empty());
+
+        BESDebug::Set("h5", false);
+        CPPUNIT_ASSERT(!BESDebug::IsSet(h5));
+        BESDebug::Set("all", true);
+        CPPUNIT_ASSERT(BESDebug::IsSet(h5));
+
+        BESDebug::Set("all", false);
+        BESDebug::Set("h5", false);
+        BESDebug::Set("h5:verbose", false);
+        CPPUNIT_ASSERT(!BESDebug::IsSet(h5));
+        CPPUNIT_ASSERT(!BESDebug::IsSet("h5"));
+        BESDebug::SetStrm(0, false);
+    }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(debugT);
@@ -213,6 +213,16 @@ public:
         if(debug) cout << __func__ << END << endl;
     }
 
+    void read_int_key_test(){
+        if(debug) cout << endl << HR << endl << __func__ << BEGIN << endl;
+        TheBESKeys::TheKeys()->set_key("BES.INT_KEY", "42");
+        CPPUNIT_ASSERT_EQUAL(42, TheBESKeys::TheKeys()->read_int_key("BES.INT_KEY", 7));
+        TheBESKeys::TheKeys()->set_key("BES.INT_KEY", "forty-two");
+        CPPUNIT_ASSERT_EQUAL(7, TheBESKeys::TheKeys()->read_int_key("BES.INT_KEY", 7));
+        CPPUNIT_ASSERT_EQUAL(7, TheBESKeys::TheKeys()->read_int_key("BES.NOTFOUND", 7));
+        if(debug) cout << __func__ << END << endl;
+    }
+
     /**
      *
      */
@@ -728,6 +738,7 @@ CPPUNIT_TEST_SUITE( keysT );
     CPPUNIT_TEST(get_multi_valued_key_test);
     CPPUNIT_TEST(get_value_on_multi_valued_key_test);
     CPPUNIT_TEST(get_missing_key_test);
+    CPPUNIT_TEST(read_int_key_test);
     CPPUNIT_TEST(get_empty_valued_key_test);
     CPPUNIT_TEST(get_empty_valued_key_from_included_file_test);
     CPPUNIT_TEST(set_bad_key_missing_equals_test);
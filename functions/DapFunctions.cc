@@ -113,6 +113,8 @@ void DapFunctions::initialize(const string &modname)
     // jhrg 5/21/20
     stare_storage_path = TheBESKeys::TheKeys()->read_string_key(STARE_STORAGE_PATH_KEY, stare_storage_path);
     stare_sidecar_suffix = TheBESKeys::TheKeys()->read_string_key(STARE_SIDECAR_SUFFIX_KEY, stare_sidecar_suffix);
+    int cache_entries = TheBESKeys::TheKeys()->read_int_key(STARE_INDEX_CACHE_ENTRIES_KEY, stare_index_cache_entries);
+    stare_index_cache_entries = cache_entries > 0 ? cache_entries : 0;
 #endif
 
     GDALAllRegister();
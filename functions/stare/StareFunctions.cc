@@ -22,9 +22,20 @@
 
 #include "config.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <sstream>
 #include <memory>
+#include <list>
+#include <mutex>
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 
 #include <STARE.h>
 #include <hdf5.h>
@@ -54,6 +65,7 @@
 #include "BESSyntaxUserError.h"
 
 #include "StareFunctions.h"
+#include "StareIndex.h"
 
 // Used with BESDEBUG
 #define STARE "stare"
@@ -69,6 +81,7 @@ namespace functions {
 // place as the data file. jhrg 5/26/20
 string stare_storage_path = "";
 string stare_sidecar_suffix = "_sidecar";
+unsigned int stare_index_cache_entries = 2;
 
 /**
  * @brief Write a collection of STARE Matches to an ostream
@@ -147,27 +160,34 @@ extract_uint64_array(Array *var, vector<dods_uint64> &values) {
 /**
  * @brief Do any of the targetIndices STARE indices overlap the dataset's STARE indices?
  * @param target_indices - stare values from a constraint expression
- * @param data_stare_indices - stare values being compared, retrieved from the sidecar file. These
- * are the index values that describe the coverage of the dataset.
+ * @param dataset_index - the index values that describe the coverage of the dataset,
+ * retrieved from the sidecar file.
  */
 bool
-target_in_dataset(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &data_stare_indices) {
+target_in_dataset(const vector<dods_uint64> &target_indices, const StareIndex &dataset_index) {
     // Changes to the range-for loop, fixed the type (was unsigned long long
     // which works on OSX but not CentOS7). jhrg 11/5/19
     for (const dods_uint64 &i : target_indices) {
-        for (const dods_uint64 &j :data_stare_indices ) {
-            // Check to see if the index 'i' overlaps the index 'j'. The cmpSpatial()
-            // function returns -1, 0, 1 depending on i in j, no overlap or, j in i.
-            // testing for !0 covers the general overlap case.
-            int result = cmpSpatial(i, j);
-            if (result != 0)
-                return true;
-        }
+        // Does the index 'i' overlap any of the dataset's indices? That is, is
+        // 'i' in one of them or one of them in 'i'? This is cmpSpatial() != 0.
+        if (dataset_index.overlaps_any(i))
+            return true;
     }
 
     return false;
 }
 
+/**
+ * @brief Do any of the targetIndices STARE indices overlap the dataset's STARE indices?
+ * @param target_indices - stare values from a constraint expression
+ * @param data_stare_indices - stare values being compared, retrieved from the sidecar file. These
+ * are the index values that describe the coverage of the dataset.
+ */
+bool
+target_in_dataset(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &data_stare_indices) {
+    return target_in_dataset(target_indices, StareIndex(data_stare_indices));
+}
+
 /**
  * @brief How many of the dataset's STARE indices overlap the target STARE indices?
  *
@@ -176,34 +196,60 @@ target_in_dataset(const vector<dods_uint64> &target_indices, const vector<dods_u
  * STARE indices.
  *
  * @param target_indices - stare values from a constraint expression
- * @param dataset_indices - stare values being compared, retrieved from the sidecar file. These
- * are the index values that describe the coverage of the dataset.
+ * @param dataset_index - the index values that describe the coverage of the dataset,
+ * retrieved from the sidecar file.
  * @param all_target_matches If true this function counts every target index that
  * overlaps every dataset index. The default counts 1 for each datset index that matches _any_
  * target index.
  */
 unsigned int
-count(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &dataset_indices, bool all_target_matches /*= false*/) {
+count(const vector<dods_uint64> &target_indices, const StareIndex &dataset_index, bool all_target_matches /*= false*/) {
     unsigned int counter = 0;
-    for (const dods_uint64 &i : dataset_indices) {
+
+    if (all_target_matches) {
         for (const dods_uint64 &j : target_indices)
-            // Here we are counting the number of target indices that overlap the
-            // dataset indices.
-            if (cmpSpatial(i, j) != 0) {
-                counter++;
-                BESDEBUG(STARE, "Matching (dataset, target) indices: " << i << ", " << j << endl);
-                if (!all_target_matches)
-                    break;  // exit the inner loop
-            }
+            dataset_index.for_each_overlap(j, [&counter](unsigned int) { counter++; });
+    }
+    else {
+        // Count each dataset index once, no matter how many targets it matches
+        vector<bool> matched(dataset_index.size(), false);
+        for (const dods_uint64 &j : target_indices) {
+            dataset_index.for_each_overlap(j, [&](unsigned int pos) {
+                if (!matched[pos]) {
+                    matched[pos] = true;
+                    counter++;
+                    BESDEBUG(STARE, "Matching (dataset, target) indices: " << dataset_index.indices()[pos] << ", " << j << endl);
+                }
+            });
+        }
     }
 
     return counter;
 }
 
+/**
+ * @brief How many of the dataset's STARE indices overlap the target STARE indices?
+ *
+ * @param target_indices - stare values from a constraint expression
+ * @param dataset_indices - stare values being compared, retrieved from the sidecar file. These
+ * are the index values that describe the coverage of the dataset.
+ * @param all_target_matches If true this function counts every target index that
+ * overlaps every dataset index. The default counts 1 for each datset index that matches _any_
+ * target index.
+ */
+unsigned int
+count(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &dataset_indices, bool all_target_matches /*= false*/) {
+    return count(target_indices, StareIndex(dataset_indices), all_target_matches);
+}
+
 /**
  * @brief Return a collection of STARE Matches
+ *
+ * The matches are ordered by dataset index and, for each dataset index,
+ * by target index.
+ *
  * @param target_indices Target STARE indices (passed in by a client)
- * @param dataset_indices STARE indices of this dataset
+ * @param dataset_index STARE indices of this dataset
  * @param dataset_x_coords Matching X indices for the corresponding dataset STARE index
  * @param dataset_y_coords Matching Y indices for the corresponding dataset STARE index
  * @return A STARE Matches collection. Contains the X, Y, and 'matching' dataset indices
@@ -211,31 +257,56 @@ count(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &data
  * @see stare_matches
  */
 unique_ptr<stare_matches>
-stare_subset_helper(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &dataset_indices,
+stare_subset_helper(const vector<dods_uint64> &target_indices, const StareIndex &dataset_index,
                     const vector<int> &dataset_x_coords, const vector<int> &dataset_y_coords)
 {
-    assert(dataset_indices.size() == dataset_x_coords.size());
-    assert(dataset_indices.size() == dataset_y_coords.size());
+    assert(dataset_index.size() == dataset_x_coords.size());
+    assert(dataset_index.size() == dataset_y_coords.size());
+
+    // (dataset position, target position) for each overlapping pair, in target order
+    vector< pair<unsigned int, unsigned int> > pairs;
+    for (unsigned int t = 0; t < target_indices.size(); ++t) {
+        dataset_index.for_each_overlap(target_indices[t], [&pairs, t](unsigned int pos) {
+            pairs.push_back(make_pair(pos, t));
+        });
+    }
+
+    // The stable sort keeps the targets for each dataset index in order
+    stable_sort(pairs.begin(), pairs.end(),
+        [](const pair<unsigned int, unsigned int> &a, const pair<unsigned int, unsigned int> &b) {
+            return a.first < b.first;
+        });
 
     //auto subset = new stare_matches;
     unique_ptr<stare_matches> subset(new stare_matches());
 
-    auto x = dataset_x_coords.begin();
-    auto y = dataset_y_coords.begin();
-    for (const dods_uint64 &i : dataset_indices) {
-        for (const dods_uint64 &j : target_indices) {
-            if (cmpSpatial(i, j) != 0) {    // != 0 --> i is in j OR j is in i
-                subset->add(*x, *y, i, j);
-                // TODO Add a break call here? jhrg 6/17/20
-            }
-        }
-        ++x;
-        ++y;
+    const vector<dods_uint64> &dataset_indices = dataset_index.indices();
+    for (const pair<unsigned int, unsigned int> &p : pairs) {
+        // i is in j OR j is in i
+        subset->add(dataset_x_coords[p.first], dataset_y_coords[p.first], dataset_indices[p.first],
+                    target_indices[p.second]);
     }
 
     return subset;
 }
 
+/**
+ * @brief Return a collection of STARE Matches
+ * @param target_indices Target STARE indices (passed in by a client)
+ * @param dataset_indices STARE indices of this dataset
+ * @param dataset_x_coords Matching X indices for the corresponding dataset STARE index
+ * @param dataset_y_coords Matching Y indices for the corresponding dataset STARE index
+ * @return A STARE Matches collection. Contains the X, Y, and 'matching' dataset indices
+ * for the given set of target indices.
+ * @see stare_matches
+ */
+unique_ptr<stare_matches>
+stare_subset_helper(const vector<dods_uint64> &target_indices, const vector<dods_uint64> &dataset_indices,
+                    const vector<int> &dataset_x_coords, const vector<int> &dataset_y_coords)
+{
+    return stare_subset_helper(target_indices, StareIndex(dataset_indices), dataset_x_coords, dataset_y_coords);
+}
+
 /**
  * @brief Build the result data as masked values from src_data
  *
@@ -248,28 +319,45 @@ stare_subset_helper(const vector<dods_uint64> &target_indices, const vector<dods
  * @param result_data A vector<T> initialized to all mask values
  * @param src_data  The source data. Values are transferred as apropriate to result_data.
  * @param target_indices The STARE indices that define a region of interest.
+ * @param dataset_index The STARE indices that describe the coverage of the data.
+ */
+template <class T>
+void stare_subset_array_helper(vector<T> &result_data, const vector<T> &src_data,
+        const vector<dods_uint64> &target_indices, const StareIndex &dataset_index)
+{
+    assert(dataset_index.size() == src_data.size());
+    assert(dataset_index.size() == result_data.size());
+
+    for (const dods_uint64 &j : target_indices) {
+        // i is in j OR j is in i
+        dataset_index.for_each_overlap(j, [&result_data, &src_data](unsigned int pos) {
+            result_data[pos] = src_data[pos];
+        });
+    }
+}
+
+/**
+ * @brief Build the result data as masked values from src_data
+ *
+ * @tparam T The array element datatype (e.g., Byte, Int32, ...)
+ * @param result_data A vector<T> initialized to all mask values
+ * @param src_data  The source data. Values are transferred as apropriate to result_data.
+ * @param target_indices The STARE indices that define a region of interest.
  * @param dataset_indices The STARE indices that describe the coverage of the data.
  */
 template <class T>
 void stare_subset_array_helper(vector<T> &result_data, const vector<T> &src_data,
         const vector<dods_uint64> &target_indices, const vector<dods_uint64> &dataset_indices)
 {
-    assert(dataset_indices.size() == src_data.size());
-    assert(dataset_indices.size() == result_data.size());
-
-    auto r = result_data.begin();
-    auto s = src_data.begin();
-    for (const dods_uint64 &i : dataset_indices) {
-        for (const dods_uint64 &j : target_indices) {
-            if (cmpSpatial(i, j) != 0) {        // != 0 --> i is in j OR j is in i
-                *r = *s;
-                break;
-            }
-        }
-        ++r; ++s;
-    }
+    stare_subset_array_helper(result_data, src_data, target_indices, StareIndex(dataset_indices));
 }
 
+// Instantiate these for the types build_masked_data() uses
+template void stare_subset_array_helper(vector<dods_int16> &, const vector<dods_int16> &,
+        const vector<dods_uint64> &, const vector<dods_uint64> &);
+template void stare_subset_array_helper(vector<dods_float32> &, const vector<dods_float32> &,
+        const vector<dods_uint64> &, const vector<dods_uint64> &);
+
 /**
  * @brief Mask the data in dependent_var using the target_s_indices
  *
@@ -288,7 +376,7 @@ void stare_subset_array_helper(vector<T> &result_data, const vector<T> &src_data
  * returned using this libdap::Array
  */
 template <class T>
-void StareSubsetArrayFunction::build_masked_data(Array *dependent_var, const vector<dods_uint64> &dep_var_stare_indices,
+void StareSubsetArrayFunction::build_masked_data(Array *dependent_var, const StareIndex &dep_var_stare_indices,
                                                  const vector<dods_uint64> &target_s_indices, unique_ptr<Array> &result) {
     vector<T> src_data(dependent_var->length());
     dependent_var->read();  // TODO Do we need to call read() here? jhrg 6/16/20
@@ -338,47 +426,113 @@ get_sidecar_file_pathname(const string &pathName, const string &token)
 
 }
 
+/// Close an HDF5 object when it goes out of scope
+class hdf5_handle {
+    hid_t d_id;
+    herr_t (*d_close)(hid_t);
+
+    hdf5_handle(const hdf5_handle &);
+    hdf5_handle &operator=(const hdf5_handle &);
+
+public:
+    hdf5_handle(hid_t id, herr_t (*close)(hid_t)) : d_id(id), d_close(close) { }
+    ~hdf5_handle() { if (d_id >= 0) d_close(d_id); }
+
+    hid_t get() const { return d_id; }
+};
+
 /**
  * @brief Read the 32-bit integer array data
- * @param file The HDF5 Id of an open file
+ * @param filename The sidecar file
+ * @param variable The name of the array
  * @param values Value-result parameter, a vector that can hold dods_int32 values
  */
 void
 get_sidecar_int32_values(const string &filename, const string &variable, vector<dods_int32> &values)
 {
     //Read the file and store the datasets
-    hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file < 0)
+    hdf5_handle file(H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+    if (file.get() < 0)
         throw BESInternalError("Could not open file " + filename, __FILE__, __LINE__);
 
-    hid_t dataset = H5Dopen(file, variable.c_str(), H5P_DEFAULT);
-    if (dataset < 0)
+    hdf5_handle dataset(H5Dopen(file.get(), variable.c_str(), H5P_DEFAULT), H5Dclose);
+    if (dataset.get() < 0)
         throw BESInternalError(string("Could not open dataset: ").append(variable), __FILE__, __LINE__);
 
-    hid_t dspace = H5Dget_space(dataset);
-    const int ndims = H5Sget_simple_extent_ndims(dspace);
-    vector<hsize_t> dims(ndims);
+    //We need to get the filespace before reading the values from each dataset
+    hdf5_handle filespace(H5Dget_space(dataset.get()), H5Sclose);
 
-    //Get the size of the dimension so that we know how big to make the memory space
-    //Each of the dataspaces should be the same size, if in the future they are different
-    // sizes then the size of each dataspace will need to be calculated.
-    H5Sget_simple_extent_dims(dspace, &dims[0], NULL);
+    //Get the number of elements in the dataspace and use that to appropriate the proper size of the vectors
+    values.resize(H5Sget_select_npoints(filespace.get()));
+    if (values.empty())
+        return;
 
-    //We need to get the filespace and memspace before reading the values from each dataset
-    hid_t filespace = H5Dget_space(dataset);
+    //Read the data file and store the values of each dataset into an array
+    if (H5Dread(dataset.get(), H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0]) < 0)
+        throw BESInternalError(string("Could not read dataset: ").append(variable), __FILE__, __LINE__);
+}
 
-    hid_t memspace = H5Screate_simple(ndims, &dims[0], NULL);
+/**
+ * @brief Copy a contiguous, unfiltered dataset's values from a memory map of the file
+ *
+ * This skips the HDF5 library's read machinery and the extra copy it makes
+ * through its own buffers; the kernel pages the values in directly.
+ *
+ * @param filename The HDF5 file
+ * @param dataset The open dataset
+ * @param values Value-result parameter, already sized to hold the dataset
+ * @return False if the dataset is not stored as one block of native
+ * unsigned 64-bit integers or the file could not be mapped. The caller should
+ * use H5Dread() instead.
+ */
+static bool
+mmap_uint64_values(const string &filename, hid_t dataset, vector<dods_uint64> &values)
+{
+    // HADDR_UNDEF for chunked (possibly compressed) and compact datasets and
+    // for those with no storage allocated.
+    haddr_t offset = H5Dget_offset(dataset);
+    if (offset == HADDR_UNDEF)
+        return false;
+
+    hdf5_handle type(H5Dget_type(dataset), H5Tclose);
+    if (type.get() < 0 || H5Tequal(type.get(), H5T_NATIVE_ULLONG) <= 0)
+        return false;
+
+    size_t bytes = values.size() * sizeof(dods_uint64);
+    if (H5Dget_storage_size(dataset) != bytes)
+        return false;
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    // mmap() needs an offset that's a multiple of the page size
+    off_t page_size = sysconf(_SC_PAGESIZE);
+    off_t map_offset = offset - (offset % page_size);
+    size_t map_length = bytes + (offset - map_offset);
+
+    void *map = mmap(0, map_length, PROT_READ, MAP_PRIVATE, fd, map_offset);
+    close(fd);
+    if (map == MAP_FAILED) {
+        BESDEBUG(STARE, "Could not map " << filename << ": " << strerror(errno) << endl);
+        return false;
+    }
 
-    //Get the number of elements in the dataspace and use that to appropriate the proper size of the vectors
-    values.resize(H5Sget_select_npoints(filespace));
+    madvise(map, map_length, MADV_SEQUENTIAL);
+    memcpy(&values[0], static_cast<char*>(map) + (offset - map_offset), bytes);
+    munmap(map, map_length);
 
-    //Read the data file and store the values of each dataset into an array
-    H5Dread(dataset, H5T_NATIVE_INT, memspace, filespace, H5P_DEFAULT, &values[0]);
+    return true;
 }
 
 /**
  * @brief Read the unsigned 64-bit integer array data
- * @param file The HDF5 Id of an open file
+ *
+ * The sidecar files store the STARE indices as one contiguous block, so
+ * they are usually read from a memory map of the file. Indices stored
+ * any other way are read using the HDF5 library.
+ *
+ * @param filename The sidecar file
  * @param variable Get the stare indices for this dependent variable
  * @param values Value-result parameter, a vector that can hold dods_uint64 values
  */
@@ -386,36 +540,91 @@ void
 get_sidecar_uint64_values(const string &filename, BaseType */*variable*/, vector<dods_uint64> &values)
 {
     //Read the file and store the datasets
-    hid_t file = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-    if (file < 0)
+    hdf5_handle file(H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose);
+    if (file.get() < 0)
         throw BESInternalError("Could not open file " + filename, __FILE__, __LINE__);
 
     // Here we look up the name of the stare index data for 'variable.' For now,
     // use the name stored in 's_index_name'. jhrg 6/3/20
 
-    hid_t dataset = H5Dopen(file, s_index_name.c_str(), H5P_DEFAULT);
-    if (dataset < 0)
+    hdf5_handle dataset(H5Dopen(file.get(), s_index_name.c_str(), H5P_DEFAULT), H5Dclose);
+    if (dataset.get() < 0)
         throw BESInternalError(string("Could not open dataset: ").append(s_index_name), __FILE__, __LINE__);
 
-    hid_t dspace = H5Dget_space(dataset);
-    const int ndims = H5Sget_simple_extent_ndims(dspace);
-    vector<hsize_t> dims(ndims);
+    //We need to get the filespace before reading the values from each dataset
+    hdf5_handle filespace(H5Dget_space(dataset.get()), H5Sclose);
 
-    //Get the size of the dimension so that we know how big to make the memory space
-    //Each of the dataspaces should be the same size, if in the future they are different
-    // sizes then the size of each dataspace will need to be calculated.
-    H5Sget_simple_extent_dims(dspace, &dims[0], NULL);
+    //Get the number of elements in the dataspace and use that to appropriate the proper size of the vectors
+    values.resize(H5Sget_select_npoints(filespace.get()));
+    if (values.empty())
+        return;
 
-    //We need to get the filespace and memspace before reading the values from each dataset
-    hid_t filespace = H5Dget_space(dataset);
+    if (mmap_uint64_values(filename, dataset.get(), values))
+        return;
 
-    hid_t memspace = H5Screate_simple(ndims, &dims[0], NULL);
+    //Read the data file and store the values of each dataset into an array
+    if (H5Dread(dataset.get(), H5T_NATIVE_ULLONG, H5S_ALL, H5S_ALL, H5P_DEFAULT, &values[0]) < 0)
+        throw BESInternalError(string("Could not read dataset: ").append(s_index_name), __FILE__, __LINE__);
+}
 
-    //Get the number of elements in the dataspace and use that to appropriate the proper size of the vectors
-    values.resize(H5Sget_select_npoints(filespace));
+/**
+ * @brief Get the index of a sidecar file's STARE indices
+ *
+ * Building the index means reading and sorting all of the sidecar's
+ * indices, so the most recently used indices are kept, up to the value of
+ * FUNCTIONS.stareIndexCacheEntries. A cached index is used only while the
+ * sidecar file's size and modification time are unchanged.
+ *
+ * @param filename The sidecar file
+ * @param variable Get the stare indices for this dependent variable
+ * @return The index, shared with the cache
+ */
+shared_ptr<const StareIndex>
+get_sidecar_index(const string &filename, BaseType *variable)
+{
+    struct cached_index {
+        string filename;
+        time_t mtime;
+        off_t size;
+        shared_ptr<const StareIndex> index;
+    };
+    static list<cached_index> cache;   // most recently used first
+    static mutex cache_lock;
+
+    struct stat sb;
+    if (stat(filename.c_str(), &sb) != 0)
+        throw BESInternalError("Could not open file " + filename, __FILE__, __LINE__);
 
-    //Read the data file and store the values of each dataset into an array
-    H5Dread(dataset, H5T_NATIVE_ULLONG, memspace, filespace, H5P_DEFAULT, &values[0]);
+    {
+        lock_guard<mutex> lock(cache_lock);
+        for (auto i = cache.begin(); i != cache.end(); ++i) {
+            if (i->filename != filename)
+                continue;
+
+            if (i->mtime == sb.st_mtime && i->size == sb.st_size) {
+                BESDEBUG(STARE, "Using the cached STARE index for " << filename << endl);
+                cache.splice(cache.begin(), cache, i);
+                return cache.front().index;
+            }
+
+            cache.erase(i); // stale
+            break;
+        }
+    }
+
+    vector<dods_uint64> values;
+    get_sidecar_uint64_values(filename, variable, values);
+    shared_ptr<const StareIndex> index(new StareIndex(std::move(values)));
+
+    if (stare_index_cache_entries > 0) {
+        lock_guard<mutex> lock(cache_lock);
+        cached_index entry = { filename, sb.st_mtime, sb.st_size, index };
+        cache.push_front(entry);
+        while (cache.size() > stare_index_cache_entries)
+            cache.pop_back();
+    }
+
+    return index;
 }
 
 void
@@ -462,14 +671,13 @@ StareIntersectionFunction::stare_intersection_dap4_function(D4RValueList *args,
     BaseType *raw_stare_indices = args->get_rvalue(1)->value(dmr);
 
      //Read the data file and store the values of each dataset into an array
-    vector<dods_uint64> dep_var_stare_indices;
-    get_sidecar_uint64_values(fullPath, dependent_var, dep_var_stare_indices);
+    shared_ptr<const StareIndex> dep_var_stare_indices = get_sidecar_index(fullPath, dependent_var);
 
     // TODO: We can dump the values in 'stare_indices' here
     vector<dods_uint64> target_s_indices;
     read_stare_indices_from_function_argument(raw_stare_indices, target_s_indices);
 
-    bool status = target_in_dataset(target_s_indices, dep_var_stare_indices);
+    bool status = target_in_dataset(target_s_indices, *dep_var_stare_indices);
 
 #if 0
      Int32 *result = new Int32("result");
@@ -519,14 +727,13 @@ StareCountFunction::stare_count_dap4_function(D4RValueList *args, DMR &dmr)
     BaseType *raw_stare_indices = args->get_rvalue(1)->value(dmr);
 
     //Read the data file and store the values of each dataset into an array
-    vector<dods_uint64> dep_var_stare_indices;
-    get_sidecar_uint64_values(fullPath, dependent_var, dep_var_stare_indices);
+    shared_ptr<const StareIndex> dep_var_stare_indices = get_sidecar_index(fullPath, dependent_var);
 
     // TODO: We can dump the values in 'stare_indices' here
     vector<dods_uint64> target_s_indices;
     read_stare_indices_from_function_argument(raw_stare_indices, target_s_indices);
 
-    int num = count(target_s_indices, dep_var_stare_indices);
+    int num = count(target_s_indices, *dep_var_stare_indices);
 
 #if 0
     Int32 *result = new Int32("result");
@@ -566,8 +773,7 @@ StareSubsetFunction::stare_subset_dap4_function(D4RValueList *args, DMR &dmr)
     BaseType *raw_stare_indices = args->get_rvalue(1)->value(dmr);
 
     //Read the data file and store the values of each dataset into an array
-    vector<dods_uint64> dep_var_stare_indices;
-    get_sidecar_uint64_values(fullPath, dependent_var, dep_var_stare_indices);
+    shared_ptr<const StareIndex> dep_var_stare_indices = get_sidecar_index(fullPath, dependent_var);
 
     // TODO: We can dump the values in 'stare_indices' here
     vector<dods_uint64> target_s_indices;
@@ -578,7 +784,7 @@ StareSubsetFunction::stare_subset_dap4_function(D4RValueList *args, DMR &dmr)
     vector<dods_int32> dataset_y_coords;
     get_sidecar_int32_values(fullPath, "Y", dataset_y_coords);
 
-    unique_ptr <stare_matches> subset = stare_subset_helper(target_s_indices, dep_var_stare_indices, dataset_x_coords, dataset_y_coords);
+    unique_ptr <stare_matches> subset = stare_subset_helper(target_s_indices, *dep_var_stare_indices, dataset_x_coords, dataset_y_coords);
 
     // When no subset is found (none of the target indices match those in the dataset)
     if (subset->stare_indices.size() == 0) {
@@ -637,8 +843,7 @@ StareSubsetArrayFunction::stare_subset_array_dap4_function(D4RValueList *args, D
         throw BESSyntaxUserError("stare_subset_array() expected an Array as the third argument.", __FILE__, __LINE__);
 
     //Read the data file and store the values of each dataset into an array
-    vector<dods_uint64> dep_var_stare_indices;
-    get_sidecar_uint64_values(fullPath, dependent_var, dep_var_stare_indices);
+    shared_ptr<const StareIndex> dep_var_stare_indices = get_sidecar_index(fullPath, dependent_var);
 
     vector<dods_uint64> target_s_indices;
     read_stare_indices_from_function_argument(raw_stare_indices, target_s_indices);
@@ -649,11 +854,11 @@ StareSubsetArrayFunction::stare_subset_array_dap4_function(D4RValueList *args, D
     // TODO Add more types. jhrg 6/17/20
     switch(dependent_var->var()->type()) {
         case dods_int16_c: {
-            build_masked_data<dods_int16>(dependent_var, dep_var_stare_indices, target_s_indices, result);
+            build_masked_data<dods_int16>(dependent_var, *dep_var_stare_indices, target_s_indices, result);
             break;
         }
         case dods_float32_c: {
-            build_masked_data<dods_float32>(dependent_var, dep_var_stare_indices, target_s_indices, result);
+            build_masked_data<dods_float32>(dependent_var, *dep_var_stare_indices, target_s_indices, result);
             break;
         }
 
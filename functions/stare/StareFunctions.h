@@ -22,6 +22,7 @@
 
 #include <string>
 #include <utility>
+#include <memory>
 
 #include <dods-datatypes.h>
 
@@ -30,6 +31,8 @@
 
 #include "ServerFunction.h"
 
+#include "StareIndex.h"
+
 namespace libdap {
 class BaseType;
 class DDS;
@@ -43,25 +46,35 @@ const string s_index_name = "Stare_Index";
 
 const std::string STARE_STORAGE_PATH_KEY = "FUNCTIONS.stareStoragePath";
 const std::string STARE_SIDECAR_SUFFIX_KEY = "FUNCTIONS.stareSidecarSuffix";
+const std::string STARE_INDEX_CACHE_ENTRIES_KEY = "FUNCTIONS.stareIndexCacheEntries";
 
 // These default values can be overridden using BES keys.
 // See DapFunctions.cc. jhrg 5/21/20
 extern string stare_storage_path;
 extern string stare_sidecar_suffix;
+extern unsigned int stare_index_cache_entries;
 
 std::string get_sidecar_file_pathname(const std::string &pathName, const string &token = "_sidecar");
-void get_sidecar_int32_values(hid_t file, const std::string &variable, std::vector<libdap::dods_int32> &values);
-void get_sidecar_uint64_values(hid_t file, const std::string &variable, std::vector<libdap::dods_uint64> &values);
+void get_sidecar_int32_values(const std::string &filename, const std::string &variable, std::vector<libdap::dods_int32> &values);
+void get_sidecar_uint64_values(const std::string &filename, libdap::BaseType *variable, std::vector<libdap::dods_uint64> &values);
+std::shared_ptr<const StareIndex> get_sidecar_index(const std::string &filename, libdap::BaseType *variable);
 
 bool target_in_dataset(const std::vector<libdap::dods_uint64> &target_indices,
         const std::vector<libdap::dods_uint64> &data_stare_indices);
+bool target_in_dataset(const std::vector<libdap::dods_uint64> &target_indices, const StareIndex &dataset_index);
 unsigned int count(const std::vector<libdap::dods_uint64> &target_indices,
         const std:: vector<libdap::dods_uint64> &dataset_indices, bool all_target_matches = false);
+unsigned int count(const std::vector<libdap::dods_uint64> &target_indices, const StareIndex &dataset_index,
+        bool all_target_matches = false);
 
 template <class T>
 void stare_subset_array_helper(vector<T> &result_data, const vector<T> &src_data,
                                const vector<libdap::dods_uint64> &target_indices,
                                const vector<libdap::dods_uint64> &dataset_indices);
+template <class T>
+void stare_subset_array_helper(vector<T> &result_data, const vector<T> &src_data,
+                               const vector<libdap::dods_uint64> &target_indices,
+                               const StareIndex &dataset_index);
 #if 0
 /// X and Y coordinates of a point
 struct point {
@@ -111,6 +124,9 @@ struct stare_matches {
 unique_ptr<stare_matches> stare_subset_helper(const std::vector<libdap::dods_uint64> &target_indices,
                                               const std::vector<libdap::dods_uint64> &dataset_indices,
                                               const std::vector<int> &dataset_x_coords, const std::vector<int> &dataset_y_coords);
+unique_ptr<stare_matches> stare_subset_helper(const std::vector<libdap::dods_uint64> &target_indices,
+                                              const StareIndex &dataset_index,
+                                              const std::vector<int> &dataset_x_coords, const std::vector<int> &dataset_y_coords);
 
 class StareIntersectionFunction : public libdap::ServerFunction {
 public:
@@ -196,7 +212,7 @@ public:
     }
 
     template <class T>
-    static void build_masked_data(libdap::Array *dependent_var, const vector<libdap::dods_uint64> &dep_var_stare_indices,
+    static void build_masked_data(libdap::Array *dependent_var, const StareIndex &dep_var_stare_indices,
                                 const vector<libdap::dods_uint64> &target_s_indices, unique_ptr<libdap::Array> &result);
 };
 
@@ -0,0 +1,117 @@
+// This file is part of libdap, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Authors: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "StareIndex.h"
+
+using namespace libdap;
+using namespace std;
+
+namespace functions {
+
+// The low five bits hold the level
+#define LEVEL_MASK 0x1FULL
+
+StareIndex::StareIndex(const vector<dods_uint64> &indices) : d_indices(indices)
+{
+    build();
+}
+
+StareIndex::StareIndex(vector<dods_uint64> &&indices) : d_indices(std::move(indices))
+{
+    build();
+}
+
+void StareIndex::build()
+{
+    d_entries.reserve(d_indices.size());
+
+    unsigned int pos = 0;
+    for (const dods_uint64 &s : d_indices) {
+        Entry e;
+        dods_uint64 hi;
+        if (get_interval(s, e.lo, hi, e.level)) {
+            e.pos = pos;
+            d_entries.push_back(e);
+        }
+        ++pos;
+    }
+
+    sort(d_entries.begin(), d_entries.end());
+}
+
+/**
+ * @brief The interval of level 27 indices covered by a STARE index
+ *
+ * @param s_index The STARE index
+ * @param lo Value-result parameter; the start of the interval
+ * @param hi Value-result parameter; the end of the interval
+ * @param level Value-result parameter; the level of s_index
+ * @return False if s_index is not a valid index (its level is more than 27),
+ * true otherwise.
+ */
+bool StareIndex::get_interval(dods_uint64 s_index, dods_uint64 &lo, dods_uint64 &hi, unsigned int &level)
+{
+    level = s_index & LEVEL_MASK;
+    if (level > max_level)
+        return false;
+
+    dods_uint64 mask = level_mask(level);
+    lo = s_index & ~mask;
+    hi = s_index | mask;
+
+    return true;
+}
+
+/**
+ * @brief Does any dataset index overlap s_index?
+ * @param s_index A STARE index
+ * @return True if one or more of the dataset's indices is in s_index or
+ * contains it.
+ */
+bool StareIndex::overlaps_any(dods_uint64 s_index) const
+{
+    dods_uint64 lo, hi;
+    unsigned int level;
+    if (!get_interval(s_index, lo, hi, level))
+        return false;
+
+    Entry key = { lo, 0, 0 };
+    auto i = lower_bound(d_entries.begin(), d_entries.end(), key);
+    if (i != d_entries.end() && i->lo <= hi)
+        return true;
+
+    for (unsigned int l = 0; l < level; ++l) {
+        Entry ancestor = { lo & ~level_mask(l), l, 0 };
+        if (binary_search(d_entries.begin(), d_entries.end(), ancestor))
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace functions
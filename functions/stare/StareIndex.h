@@ -0,0 +1,135 @@
+// This file is part of libdap, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Authors: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _stare_index_h
+#define _stare_index_h
+
+#include <vector>
+#include <algorithm>
+
+#include <dods-datatypes.h>
+
+namespace functions {
+
+/**
+ * @brief A sorted index of a dataset's STARE indices
+ *
+ * A STARE spatial index names a trixel (a triangle on the sphere) at one of
+ * 28 levels. The level is stored in the low five bits; the bits above name
+ * the trixel, most significant first, with the bits below the level's depth
+ * set to zero. So each index covers a contiguous interval of level 27
+ * indices and the intervals of two indices are either nested or disjoint.
+ * Two indices overlap (cmpSpatial() != 0) exactly when their intervals
+ * intersect.
+ *
+ * This class sorts the dataset's indices by the start of their intervals.
+ * The indices that overlap a query index are then those that start inside
+ * the query's interval, found with a binary search, plus any that contain
+ * it, which must start at the query's ancestor at a coarser level, one
+ * binary search per level. A query costs O(log N + matches), so matching M
+ * targets against N dataset indices costs about O((N + M) log N) instead of
+ * the O(N * M) of comparing every pair.
+ *
+ * Values with a level above 27 (e.g., the fill value used in the sidecar
+ * files) never overlap anything.
+ */
+class StareIndex {
+private:
+    struct Entry {
+        libdap::dods_uint64 lo;     // start of the index's interval
+        unsigned int level;
+        unsigned int pos;           // position in the dataset
+
+        bool operator<(const Entry &rhs) const {
+            return lo < rhs.lo || (lo == rhs.lo && level < rhs.level);
+        }
+    };
+
+    std::vector<libdap::dods_uint64> d_indices;
+    std::vector<Entry> d_entries;
+
+    StareIndex(const StareIndex &);
+    StareIndex &operator=(const StareIndex &);
+
+    void build();
+
+    /// The bits below a trixel at 'level'; two bits per level below the top-level trixel's bits
+    static libdap::dods_uint64 level_mask(unsigned int level) { return (1ULL << (60 - 2 * level)) - 1; }
+
+public:
+    static const unsigned int max_level = 27;
+
+    explicit StareIndex(const std::vector<libdap::dods_uint64> &indices);
+    explicit StareIndex(std::vector<libdap::dods_uint64> &&indices);
+
+    virtual ~StareIndex() { }
+
+    /// @brief The dataset's STARE indices, in dataset order
+    const std::vector<libdap::dods_uint64> &indices() const { return d_indices; }
+
+    /// @brief The number of dataset STARE indices
+    std::size_t size() const { return d_indices.size(); }
+
+    static bool get_interval(libdap::dods_uint64 s_index, libdap::dods_uint64 &lo, libdap::dods_uint64 &hi,
+        unsigned int &level);
+
+    bool overlaps_any(libdap::dods_uint64 s_index) const;
+
+    /**
+     * @brief Call f(pos) for each dataset index that overlaps s_index
+     *
+     * @param s_index A STARE index
+     * @param f Called with the position, in dataset order, of each
+     * overlapping index. The positions are not in any particular order.
+     */
+    template <class F>
+    void for_each_overlap(libdap::dods_uint64 s_index, F f) const
+    {
+        libdap::dods_uint64 lo, hi;
+        unsigned int level;
+        if (!get_interval(s_index, lo, hi, level))
+            return;
+
+        // Indices that start inside s_index's interval are inside it or
+        // (at a coarser level) start where it does and contain it.
+        Entry key = { lo, 0, 0 };
+        auto i = std::lower_bound(d_entries.begin(), d_entries.end(), key);
+        for (; i != d_entries.end() && i->lo <= hi; ++i)
+            f(i->pos);
+
+        // Indices that start before s_index and contain it
+        for (unsigned int l = 0; l < level; ++l) {
+            libdap::dods_uint64 ancestor_lo = lo & ~level_mask(l);
+            if (ancestor_lo == lo)
+                continue;   // found above
+
+            Entry ancestor = { ancestor_lo, l, 0 };
+            auto r = std::equal_range(d_entries.begin(), d_entries.end(), ancestor);
+            for (auto j = r.first; j != r.second; ++j)
+                f(j->pos);
+        }
+    }
+};
+
+} // namespace functions
+
+#endif // _stare_index_h
@@ -0,0 +1,179 @@
+// This file is part of libdap, A C++ implementation of the OPeNDAP Data
+// Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Authors: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+// Time matching a region of interest against the STARE indices of a
+// MODIS-sized granule using StareIndex and using cmpSpatial() on every pair.
+// The granule is a synthetic swath of 2030 x 1354 level 27 indices (a MODIS
+// 1km, 5 minute granule); the targets cover a circle, as a client would send.
+// The pairwise comparison is too slow to run on the whole granule, so it is
+// timed on a sample of the swath's rows and scaled up. The two methods must
+// find the same matches for those rows.
+//
+// Build with 'make stare_index_bench'.
+
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+#include <STARE.h>
+
+#include "StareIndex.h"
+
+using namespace std;
+using namespace libdap;
+using namespace functions;
+
+static void usage(const char *name) {
+    cerr << name << " [-v -x <columns> -y <rows> -a <lat center> -o <lon center> -r <radius> -l <level> -s <rows>] | -h" << endl;
+}
+
+static double seconds_since(const chrono::steady_clock::time_point &start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+    bool verbose = false;
+    unsigned int columns = 1354, rows = 2030;
+    float64 lat_center = 40.0, lon_center = -100.0, radius_degrees = 3.0;
+    int level = 10;
+    unsigned int sample_rows = 10;
+
+    int c;
+    while ((c = getopt(argc, argv, "vhx:y:a:o:r:l:s:")) != -1) {
+        switch (c) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'x':
+                columns = atoi(optarg);
+                break;
+            case 'y':
+                rows = atoi(optarg);
+                break;
+            case 'a':
+                lat_center = atof(optarg);
+                break;
+            case 'o':
+                lon_center = atof(optarg);
+                break;
+            case 'r':
+                radius_degrees = atof(optarg);
+                break;
+            case 'l':
+                level = atoi(optarg);
+                break;
+            case 's':
+                sample_rows = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    if (sample_rows == 0 || sample_rows > rows)
+        sample_rows = rows;
+
+    STARE stare;
+
+    // About 2330 km across and 2030 km along the track, tilted like a
+    // descending pass.
+    auto start = chrono::steady_clock::now();
+    vector<dods_uint64> dataset_indices(columns * rows);
+    for (unsigned int y = 0; y < rows; ++y) {
+        for (unsigned int x = 0; x < columns; ++x) {
+            float64 along = (y - rows / 2.0) * (18.3 / rows);
+            float64 across = (x - columns / 2.0) * (21.0 / columns);
+            float64 lat = lat_center + along + 0.15 * across;
+            float64 lon = lon_center + (across - 0.15 * along) / cos(lat * M_PI / 180.0);
+            dataset_indices[y * columns + x] = stare.ValueFromLatLonDegrees(lat, lon);
+        }
+    }
+    cerr << "Made " << dataset_indices.size() << " dataset indices in " << seconds_since(start) << "s" << endl;
+
+    // The cover may include intervals; the terminators are not valid indices
+    STARE_SpatialIntervals cover = stare.CoverCircleFromLatLonRadiusDegrees(lat_center, lon_center, radius_degrees,
+                                                                            level);
+    vector<dods_uint64> target_indices;
+    for (STARE_ArrayIndexSpatialValue s : cover) {
+        dods_uint64 lo, hi;
+        unsigned int l;
+        if (StareIndex::get_interval(s, lo, hi, l))
+            target_indices.push_back(s);
+    }
+    cerr << "Using " << target_indices.size() << " target indices" << endl;
+
+    start = chrono::steady_clock::now();
+    StareIndex index(dataset_indices);
+    cerr << "Built the index in " << seconds_since(start) << "s" << endl;
+
+    start = chrono::steady_clock::now();
+    vector<unsigned int> matches(dataset_indices.size(), 0);
+    unsigned long pairs = 0;
+    for (const dods_uint64 &t : target_indices) {
+        index.for_each_overlap(t, [&matches, &pairs](unsigned int pos) { ++matches[pos]; ++pairs; });
+    }
+    double index_time = seconds_since(start);
+
+    unsigned long matched = 0;
+    for (unsigned int m : matches)
+        if (m) ++matched;
+    cerr << "Index: " << matched << " dataset indices, " << pairs << " pairs matched in " << index_time << "s" << endl;
+
+    // The same for a sample of the rows, one pair at a time
+    start = chrono::steady_clock::now();
+    unsigned long mismatches = 0;
+    unsigned int row_step = rows / sample_rows;
+    for (unsigned int n = 0; n < sample_rows; ++n) {
+        unsigned int y = n * row_step;
+        for (unsigned int x = 0; x < columns; ++x) {
+            unsigned int pos = y * columns + x;
+            unsigned int m = 0;
+            for (const dods_uint64 &t : target_indices)
+                if (cmpSpatial(dataset_indices[pos], t) != 0)
+                    ++m;
+
+            if (m != matches[pos]) {
+                ++mismatches;
+                if (verbose)
+                    cerr << "Mismatch at (" << x << ", " << y << "): " << dataset_indices[pos] << ", " << m
+                        << " != " << matches[pos] << endl;
+            }
+        }
+    }
+    double pairwise_time = seconds_since(start) * rows / sample_rows;
+
+    cerr << "Pairwise (from " << sample_rows << " rows): about " << pairwise_time << "s" << endl;
+    cerr << "Speedup: about " << pairwise_time / index_time << "x" << endl;
+
+    if (mismatches) {
+        cerr << "Error: " << mismatches << " of the sampled dataset indices matched differently" << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
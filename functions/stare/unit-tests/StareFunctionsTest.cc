@@ -21,6 +21,7 @@
 // You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
 
 #include <unistd.h>
+#include <random>
 
 #include <cppunit/TextTestRunner.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -48,6 +49,7 @@
 #include <BESDebug.h>
 
 #include "StareFunctions.h"
+#include "StareIndex.h"
 
 #include "test_config.h"
 
@@ -115,6 +117,9 @@ public:
     CPPUNIT_TEST(test_count_3);
     CPPUNIT_TEST(test_stare_subset);
 
+    CPPUNIT_TEST(test_stare_index_fill_value);
+    CPPUNIT_TEST(test_stare_index_vs_cmpSpatial);
+
     CPPUNIT_TEST(intersection_function_test);
     CPPUNIT_TEST(count_function_test);
     CPPUNIT_TEST(subset_function_test);
@@ -264,6 +269,108 @@ public:
         CPPUNIT_ASSERT(target_in_dataset(target_indices, data_indices));
     }
 
+    // The fill value in the sidecar files never matches
+    void test_stare_index_fill_value() {
+        DBG(cerr << "--- test_stare_index_fill_value() test - BEGIN ---" << endl);
+
+        vector<dods_uint64> data_indices = {9223372034707292159, 3440012343008821258, 3440016191299518474};
+        StareIndex index(data_indices);
+
+        CPPUNIT_ASSERT(index.size() == 3);
+        CPPUNIT_ASSERT(!index.overlaps_any(9223372034707292159));
+        CPPUNIT_ASSERT(index.overlaps_any(3440016191299518474));
+    }
+
+    static dods_uint64 level_mask(unsigned int level) {
+        return (1ULL << (60 - 2 * level)) - 1;
+    }
+
+    // A random STARE index at 'level' inside the trixel 'parent'
+    static dods_uint64 make_index(dods_uint64 parent, unsigned int level, mt19937_64 &gen) {
+        unsigned int parent_level = parent & 0x1F;
+        dods_uint64 parent_mask = level_mask(parent_level < level ? parent_level : level);
+        return (parent & ~parent_mask) | (gen() & parent_mask & ~level_mask(level)) | level;
+    }
+
+    // Compare the indexed matching with cmpSpatial() on every pair. The indices
+    // are descendants of a few trixels so that they nest and overlap a lot.
+    void test_stare_index_vs_cmpSpatial() {
+        DBG(cerr << "--- test_stare_index_vs_cmpSpatial() test - BEGIN ---" << endl);
+
+        mt19937_64 gen(20210419);
+        const dods_uint64 top_level_bits = 0x7000000000000000ULL;   // one of the eight level 0 trixels
+        vector<dods_uint64> roots;
+        for (int i = 0; i < 4; ++i)
+            roots.push_back(make_index(gen() & top_level_bits, gen() % 6, gen));
+
+        auto random_index = [&]() {
+            dods_uint64 root = roots[gen() % roots.size()];
+            unsigned int root_level = root & 0x1F;
+            unsigned int level = root_level + gen() % (StareIndex::max_level - root_level + 1);
+            // Some are anywhere
+            return make_index(gen() % 8 ? root : gen() & top_level_bits, level, gen);
+        };
+
+        vector<dods_uint64> data_indices;
+        for (int i = 0; i < 2000; ++i)
+            data_indices.push_back(random_index());
+        data_indices.push_back(9223372034707292159);
+        data_indices.push_back(data_indices[0]);    // a duplicate
+
+        vector<dods_uint64> target_indices = roots;
+        for (int i = 0; i < 200; ++i)
+            target_indices.push_back(random_index());
+
+        StareIndex index(data_indices);
+
+        unsigned int expected_count = 0, expected_all = 0;
+        for (const dods_uint64 &i : data_indices) {
+            bool matched = false;
+            for (const dods_uint64 &j : target_indices) {
+                if (cmpSpatial(i, j) != 0) {
+                    matched = true;
+                    ++expected_all;
+                }
+            }
+            if (matched) ++expected_count;
+        }
+
+        DBG(cerr << "count: " << expected_count << ", all matches: " << expected_all << endl);
+        CPPUNIT_ASSERT(expected_count > 0 && expected_count < data_indices.size());
+        CPPUNIT_ASSERT_EQUAL(expected_count, count(target_indices, index));
+        CPPUNIT_ASSERT_EQUAL(expected_all, count(target_indices, index, true));
+
+        for (const dods_uint64 &j : target_indices) {
+            bool expected = false;
+            for (const dods_uint64 &i : data_indices)
+                if (cmpSpatial(i, j) != 0) expected = true;
+
+            CPPUNIT_ASSERT_EQUAL(expected, index.overlaps_any(j));
+        }
+
+        // The subset holds the matches in the same order as the pairwise loops
+        vector<int> x_indices(data_indices.size()), y_indices(data_indices.size());
+        for (unsigned int i = 0; i < data_indices.size(); ++i) {
+            x_indices[i] = i;
+            y_indices[i] = -i;
+        }
+        unique_ptr<stare_matches> subset = stare_subset_helper(target_indices, index, x_indices, y_indices);
+
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < data_indices.size(); ++i) {
+            for (const dods_uint64 &j : target_indices) {
+                if (cmpSpatial(data_indices[i], j) != 0) {
+                    CPPUNIT_ASSERT(n < subset->stare_indices.size());
+                    CPPUNIT_ASSERT_EQUAL((dods_int32)i, subset->x_indices[n]);
+                    CPPUNIT_ASSERT_EQUAL(data_indices[i], subset->stare_indices[n]);
+                    CPPUNIT_ASSERT_EQUAL(j, subset->target_indices[n]);
+                    ++n;
+                }
+            }
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)n, subset->stare_indices.size());
+    }
+
     void intersection_function_test() {
 		DBG(cerr << "--- intersection_function_test() test - BEGIN ---" << endl);
 
@@ -61,10 +61,11 @@ namespace http {
     /**
      * @brief Returns true if URL is reusable, false otherwise.
      *
+     * @param now Test the URL as of this time
      * @return Returns true if the query string parameters or response headers received with the EffectiveUrl indicate
      *  that the URL may be reused. False otherwise
      */
-    bool EffectiveUrl::is_expired() {
+    bool EffectiveUrl::is_expired_at(time_t now) {
 
         BESDEBUG(MODULE, prolog << "BEGIN" << endl);
         bool expired = false;
@@ -74,8 +75,6 @@ namespace http {
         get_header(CACHE_CONTROL_HEADER_KEY, cc_hdr_val, found);
         if (found) {
             BESDEBUG(MODULE, prolog << CACHE_CONTROL_HEADER_KEY << " '" << cc_hdr_val << "'" << endl);
-            time_t now;
-            time(&now);  /* get current time; same as: timer = time(NULL)  */
             BESDEBUG(MODULE, prolog << "now: " << now << endl);
 
             // Example: 'Cache-Control: private, max-age=600'
@@ -96,7 +95,7 @@ namespace http {
             }
         }
         if (!expired) {
-            expired = url::is_expired();
+            expired = url::is_expired_at(now);
         }
         BESDEBUG(MODULE, prolog << "END expired: " << (expired ? "true" : "false") << endl);
         return expired;
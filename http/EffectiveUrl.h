@@ -61,12 +61,15 @@ namespace http {
 
         virtual ~EffectiveUrl(){ }
 
-        bool is_expired() override;
+        bool is_expired_at(time_t now) override;
 
         void get_header(const std::string &name, std::string &value, bool &found );
 
         void ingest_response_headers(const std::vector<std::string> &resp_hdrs);
 
+        /// @brief The response headers, as they were ingested
+        const std::vector<std::string> &response_header_lines() const { return d_resp_hdr_lines; }
+
         void url(std::string url){
             parse(url);
         }
@@ -30,10 +30,15 @@
 #include <stdlib.h>
 #endif
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include <mutex>
 
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <system_error>
 
 #include "EffectiveUrlCache.h"
 
@@ -41,10 +46,12 @@
 #include "TheBESKeys.h"
 #include "BESDebug.h"
 #include "BESStopWatch.h"
+#include "BESTrace.h"
 #include "BESUtil.h"
 #include "BESLog.h"
 #include "CurlUtils.h"
 #include "HttpNames.h"
+#include "HttpCache.h"
 #include "EffectiveUrl.h"
 
 using namespace std;
@@ -53,6 +60,9 @@ using namespace std;
 #define MODULE_DUMPER "euc:dump"
 #define prolog std::string("EffectiveUrlCache::").append(__func__).append("() - ")
 
+// Effective URLs kept in the HttpCache are named with this in place of a user id
+#define SHARED_CACHE_UID "euc"
+
 namespace http {
 
 EffectiveUrlCache *EffectiveUrlCache::d_instance = nullptr;
@@ -104,6 +114,18 @@ void EffectiveUrlCache::delete_instance()
  */
 EffectiveUrlCache::~EffectiveUrlCache()
 {
+    {
+        std::lock_guard<std::mutex> lock_me(d_cache_lock_mutex);
+        d_stop_refresher = true;
+    }
+    d_refresh_cond.notify_all();
+    if (d_refresher) {
+        if (d_refresher_pid == getpid())
+            d_refresher->join();
+        else
+            d_refresher.release();  // The thread belongs to the parent process
+    }
+
     map<string , http::EffectiveUrl *>::iterator it;
     for(it = d_effective_urls.begin(); it!= d_effective_urls.end(); it++){
         delete it->second;
@@ -183,20 +205,33 @@ http::EffectiveUrl *EffectiveUrlCache::get(const std::string  &source_url){
  * Find the terminal (effective) url for the source_url. If the source_url matches the
  * skip_regex then it will not be cached.
  *
+ * The cache is locked only while it is searched and updated. If another thread is already
+ * following the redirects for source_url, this waits for its result rather than following
+ * them too. If the cached URL will expire soon, it is returned and a new one is found in
+ * the background.
+ *
  * @param source_url
  * @returns The effective URL
 */
 string EffectiveUrlCache::get_effective_url(const string &source_url)
 {
+    BESDEBUG(MODULE, prolog << "BEGIN url: " << source_url << endl);
 
-    // This lock is a RAII implementation. It will block until the mutex is
-    // available and the lock will be released when the instance is destroyed.
-    std::lock_guard<std::mutex> lock_me(d_cache_lock_mutex);
+    BESTraceSpan span("EffectiveUrlCache::get_effective_url");
+    span.set_url_attribute(source_url);
 
-    BESDEBUG(MODULE, prolog << "BEGIN url: " << source_url << endl);
-    string effective_url_str = source_url;
+    std::promise<string> resolution;
+    std::shared_future<string> pending;
+    bool shared;
+    {
+        // This lock is a RAII implementation. It will block until the mutex is
+        // available and the lock will be released when the instance is destroyed.
+        std::lock_guard<std::mutex> lock_me(d_cache_lock_mutex);
 
-    if(is_enabled()){
+        if (!is_enabled()) {
+            BESDEBUG(MODULE, prolog << "CACHE IS DISABLED." << endl);
+            return source_url;
+        }
 
         BESDEBUG(MODULE_DUMPER, prolog << "dump: " << endl << dump() << endl);
 
@@ -205,7 +240,7 @@ string EffectiveUrlCache::get_effective_url(const string &source_url)
         // if it's not an HTTP url there is nothing to cache.
         if (source_url.find("http://") != 0 && source_url.find("https://") != 0) {
             BESDEBUG(MODULE, prolog << "END Not an HTTP request, SKIPPING." << endl);
-            return effective_url_str;
+            return source_url;
         }
 
         BESRegex *skip_regex = get_skip_regex();
@@ -215,7 +250,7 @@ string EffectiveUrlCache::get_effective_url(const string &source_url)
                 BESDEBUG(MODULE, prolog << "END Candidate url matches the "
                                            "no_redirects_regex_pattern [" << skip_regex->pattern() <<
                                         "][match_length=" << match_length << "] SKIPPING." << endl);
-                return effective_url_str;
+                return source_url;
             }
             BESDEBUG(MODULE, prolog << "Candidate url: '" << source_url << "' does NOT match the "
                                                                            "skip_regex pattern [" << skip_regex->pattern() << "]" << endl);
@@ -224,41 +259,279 @@ string EffectiveUrlCache::get_effective_url(const string &source_url)
             BESDEBUG(MODULE, prolog << "The cache_effective_urls_skip_regex() was NOT SET "<< endl);
         }
 
-        http::EffectiveUrl *effective_url = get(source_url);
-
         // See if the data_access_url has already been processed into a terminal URL
-        bool retrieve_and_cache = !effective_url; // If there's no effective_url we gotta go get it.
-        if(effective_url){
+        http::EffectiveUrl *effective_url = get(source_url);
+        if (effective_url && !effective_url->is_expired()) {
             BESDEBUG(MODULE, prolog << "Cache hit for: " << source_url << endl);
-            retrieve_and_cache = effective_url->is_expired();
-            BESDEBUG(MODULE, prolog << "Cached target URL is " << (retrieve_and_cache?"":"not ") << "expired." << endl);
+            span.set_attribute("cache.hit", true);
+            if (get_refresh_ahead() > 0 && d_pending.find(source_url) == d_pending.end()
+                && effective_url->is_expired_at(time(nullptr) + d_refresh_ahead))
+                queue_refresh(source_url);
+
+            BESDEBUG(MODULE, prolog << "END" << endl);
+            return effective_url->str();
+        }
+
+        // It not found or expired, reload - unless another thread is doing that now.
+        auto it = d_pending.find(source_url);
+        if (it != d_pending.end())
+            pending = it->second;
+        else
+            d_pending[source_url] = resolution.get_future().share();
+
+        shared = is_shared();
+    }
+
+    span.set_attribute("cache.hit", false);
+
+    if (pending.valid()) {
+        BESDEBUG(MODULE, prolog << "Waiting for the effective URL of " << source_url << endl);
+        return pending.get();
+    }
+
+    string effective_url_str = resolve(source_url, resolution, shared, time(nullptr));
+    BESDEBUG(MODULE, prolog << "END" << endl);
+    return effective_url_str;
+}
+
+/**
+ * Find the effective URL for source_url and cache it. Call this without holding the
+ * cache lock, having added source_url to d_pending; the result (or the error) is given
+ * to the threads waiting on \arg resolution.
+ *
+ * @param source_url
+ * @param resolution Set to the effective URL or the error
+ * @param shared If true, look in and update the shared store
+ * @param fresh_until An effective URL from the shared store must not expire before this
+ * @return The effective URL
+ */
+string EffectiveUrlCache::resolve(const string &source_url, std::promise<string> &resolution, bool shared,
+    time_t fresh_until)
+{
+    try {
+        http::EffectiveUrl *effective_url = nullptr;
+        if (shared) {
+            effective_url = load_shared(source_url);
+            if (effective_url && effective_url->is_expired_at(fresh_until)) {
+                delete effective_url;
+                effective_url = nullptr;
+            }
         }
-        // It not found or expired, reload.
-        if(retrieve_and_cache){
-            BESDEBUG(MODULE, prolog << "Acquiring effective URL for  " << source_url << endl);
 
+        if (!effective_url) {
+            BESDEBUG(MODULE, prolog << "Acquiring effective URL for  " << source_url << endl);
             {
                 BESStopWatch sw;
                 if(BESDebug::IsSet(MODULE) || BESDebug::IsSet(TIMING_LOG_KEY)) sw.start(prolog + "Retrieve and cache effective url for source url: " + source_url);
                 effective_url = curl::retrieve_effective_url(source_url);
             }
-            BESDEBUG(MODULE, prolog << "   source_url: " << source_url << endl);
-            BESDEBUG(MODULE, prolog << "effective_url: " << effective_url->dump() << endl);
 
-            d_effective_urls[source_url] = effective_url;
+            if (shared)
+                save_shared(source_url, effective_url);
+        }
+        BESDEBUG(MODULE, prolog << "   source_url: " << source_url << endl);
+        BESDEBUG(MODULE, prolog << "effective_url: " << effective_url->dump() << endl);
+
+        string effective_url_str = effective_url->str();
+        {
+            std::lock_guard<std::mutex> lock_me(d_cache_lock_mutex);
+            auto it = d_effective_urls.find(source_url);
+            if (it != d_effective_urls.end()) {
+                delete it->second;
+                it->second = effective_url;
+            }
+            else {
+                d_effective_urls[source_url] = effective_url;
+            }
+            d_pending.erase(source_url);
 
             BESDEBUG(MODULE, prolog << "Updated record for "<< source_url << " cache size: " << d_effective_urls.size() << endl);
         }
-        effective_url_str = effective_url->str();
-        BESDEBUG(MODULE_DUMPER, prolog << "dump: " << endl << dump() << endl);
-    } // EucLock dat_lock is released when the point of execution reaches this brace and dat_lock goes out of scope.
-    else {
-        BESDEBUG(MODULE, prolog << "CACHE IS DISABLED." << endl);
+
+        resolution.set_value(effective_url_str);
+        return effective_url_str;
+    }
+    catch (...) {
+        {
+            std::lock_guard<std::mutex> lock_me(d_cache_lock_mutex);
+            d_pending.erase(source_url);
+        }
+        resolution.set_exception(std::current_exception());
+        throw;
     }
-    BESDEBUG(MODULE, prolog << "END" << endl);
-    return effective_url_str;
 }
 
+/**
+ * Have the refresher thread find a new effective URL for source_url. Call this holding
+ * the cache lock. The refresher is started the first time it is needed in a process.
+ *
+ * @param source_url
+ */
+void EffectiveUrlCache::queue_refresh(const string &source_url)
+{
+    BESDEBUG(MODULE, prolog << "Refreshing " << source_url << endl);
+
+    // A process forked from one that started the refresher has neither the thread
+    // nor the refreshes queued for it.
+    if (d_refresher && d_refresher_pid != getpid()) {
+        for (const auto &job: d_refresh_queue)
+            d_pending.erase(job.first);
+        d_refresh_queue.clear();
+        d_refresher.release();
+    }
+
+    if (!d_refresher) {
+        try {
+            d_refresher.reset(new std::thread(&EffectiveUrlCache::refresher, this));
+            d_refresher_pid = getpid();
+        }
+        catch (std::system_error &e) {
+            ERROR_LOG(prolog << "Could not start a thread to refresh effective URLs: " << e.what() << endl);
+            return;
+        }
+    }
+
+    std::shared_ptr<std::promise<string> > resolution(new std::promise<string>);
+    d_pending[source_url] = resolution->get_future().share();
+    d_refresh_queue.push_back(make_pair(source_url, resolution));
+
+    d_refresh_cond.notify_one();
+}
+
+/**
+ * The refresher thread. Finds new effective URLs for the URLs queued by queue_refresh()
+ * until the cache is deleted.
+ */
+void EffectiveUrlCache::refresher()
+{
+    std::unique_lock<std::mutex> lock_me(d_cache_lock_mutex);
+    while (true) {
+        while (!d_stop_refresher && d_refresh_queue.empty())
+            d_refresh_cond.wait(lock_me);
+        if (d_stop_refresher)
+            break;
+
+        auto job = d_refresh_queue.front();
+        d_refresh_queue.pop_front();
+        bool shared = is_shared();
+        time_t fresh_until = time(nullptr) + d_refresh_ahead;
+
+        lock_me.unlock();
+        try {
+            resolve(job.first, *job.second, shared, fresh_until);
+        }
+        catch (BESError &e) {
+            ERROR_LOG(prolog << "Could not refresh the effective URL for " << job.first << ": " << e.get_message() << endl);
+        }
+        catch (std::exception &e) {
+            ERROR_LOG(prolog << "Could not refresh the effective URL for " << job.first << ": " << e.what() << endl);
+        }
+        catch (...) {
+            // An exception that leaves this thread would terminate the process
+            ERROR_LOG(prolog << "Could not refresh the effective URL for " << job.first << ": unknown error" << endl);
+        }
+        lock_me.lock();
+    }
+}
+
+/**
+ * Read an effective URL from the shared store. The record is the effective URL, the
+ * time it was found and the response headers, one per line. The threads of this process
+ * use the store one at a time.
+ *
+ * @param source_url
+ * @return The effective URL, or null if the store does not have it.
+ */
+http::EffectiveUrl *EffectiveUrlCache::load_shared(const string &source_url)
+{
+    std::lock_guard<std::mutex> lock_store(d_shared_store_mutex);
+
+    HttpCache *cache = HttpCache::get_instance();
+    if (!cache)
+        return nullptr;
+
+    string file = cache->get_cache_file_name(SHARED_CACHE_UID, source_url);
+    int fd;
+    if (!cache->get_read_lock(file, fd))
+        return nullptr;
+
+    http::EffectiveUrl *effective_url = nullptr;
+    try {
+        ifstream record(file.c_str());
+        string url_str, ingest_time;
+        getline(record, url_str);
+        getline(record, ingest_time);
+
+        vector<string> resp_hdrs;
+        string line;
+        while (getline(record, line))
+            resp_hdrs.push_back(line);
+
+        if (record.eof() && !url_str.empty()) {
+            effective_url = new http::EffectiveUrl(url_str, resp_hdrs);
+            effective_url->set_ingest_time(stoll(ingest_time));
+        }
+    }
+    catch (std::exception &e) {
+        ERROR_LOG(prolog << "Could not read the effective URL record " << file << ": " << e.what() << endl);
+        delete effective_url;
+        effective_url = nullptr;
+    }
+    cache->unlock_and_close(file);
+
+    BESDEBUG(MODULE, prolog << "Shared store " << (effective_url ? "hit" : "miss") << " for " << source_url << endl);
+    return effective_url;
+}
+
+/**
+ * Write an effective URL to the shared store. An existing record is replaced only if no
+ * other process is using it; waiting for it could deadlock with a process that holds it
+ * and is waiting for the cache. The replaced record's few bytes are counted in the cache
+ * size until the cache is next purged.
+ *
+ * @param source_url
+ * @param effective_url
+ */
+void EffectiveUrlCache::save_shared(const string &source_url, http::EffectiveUrl *effective_url)
+{
+    std::lock_guard<std::mutex> lock_store(d_shared_store_mutex);
+
+    HttpCache *cache = HttpCache::get_instance();
+    if (!cache)
+        return;
+
+    string file = cache->get_cache_file_name(SHARED_CACHE_UID, source_url);
+    int fd;
+    if (!cache->create_and_lock(file, fd)) {
+        if (!cache->get_exclusive_lock_nb(file, fd))
+            return;
+        unlink(file.c_str());
+        close(fd);
+        if (!cache->create_and_lock(file, fd))
+            return;
+    }
+
+    stringstream record;
+    record << effective_url->str() << endl << effective_url->ingest_time() << endl;
+    for (const auto &line: effective_url->response_header_lines())
+        record << line << endl;
+    string data = record.str();
+
+    if (write(fd, data.data(), data.size()) != (ssize_t) data.size()) {
+        ERROR_LOG(prolog << "Could not write the effective URL record " << file << endl);
+        unlink(file.c_str());
+        cache->unlock_and_close(file);
+        return;
+    }
+
+    cache->exclusive_to_shared_lock(fd);
+    unsigned long long size = cache->update_cache_info(file);
+    if (cache->cache_too_big(size))
+        cache->update_and_purge(file);
+    cache->unlock_and_close(file);
+
+    BESDEBUG(MODULE, prolog << "Saved the effective URL for " << source_url << " in " << file << endl);
+}
 
 /**
  *
@@ -279,6 +552,40 @@ bool EffectiveUrlCache::is_enabled()
     return d_enabled;
 }
 
+/**
+ * @return Seconds before an effective URL expires that it should be refreshed; 0 if
+ * URLs should not be refreshed before they expire.
+ */
+int EffectiveUrlCache::get_refresh_ahead()
+{
+    if (d_refresh_ahead < 0) {
+        d_refresh_ahead = TheBESKeys::TheKeys()->read_int_key(HTTP_CACHE_EFFECTIVE_URLS_REFRESH_AHEAD_KEY,
+            HTTP_CACHE_EFFECTIVE_URLS_REFRESH_AHEAD_DEFAULT);
+        if (d_refresh_ahead < 0)
+            d_refresh_ahead = 0;
+        BESDEBUG(MODULE, prolog << HTTP_CACHE_EFFECTIVE_URLS_REFRESH_AHEAD_KEY << ": " << d_refresh_ahead << endl);
+    }
+    return d_refresh_ahead;
+}
+
+/**
+ * @return True if effective URLs should be shared with other processes using the HttpCache
+ */
+bool EffectiveUrlCache::is_shared()
+{
+    if (d_shared < 0) {
+        d_shared = TheBESKeys::TheKeys()->read_bool_key(HTTP_CACHE_EFFECTIVE_URLS_SHARED_KEY, false);
+        BESDEBUG(MODULE, prolog << HTTP_CACHE_EFFECTIVE_URLS_SHARED_KEY << ": " << (d_shared ? "true" : "false") << endl);
+
+        // Make the HttpCache here, under the lock, so the threads that use it do not race to make it.
+        if (d_shared && !HttpCache::get_instance()) {
+            ERROR_LOG(prolog << "The HttpCache is not configured; effective URLs will not be shared." << endl);
+            d_shared = 0;
+        }
+    }
+    return d_shared;
+}
+
 /**
  *
  * @return
@@ -27,9 +27,17 @@
 #ifndef _bes_http_EffectiveUrlCache_h_
 #define _bes_http_EffectiveUrlCache_h_ 1
 
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <map>
+#include <memory>
 #include <string>
 #include <mutex>
+#include <thread>
+#include <utility>
 
 #include "BESObj.h"
 #include "BESDataHandlerInterface.h"
@@ -46,18 +54,40 @@ namespace http {
  * before the requested resource is retrieved. This final location, from which the requested bytes are transmitted,
  * is termed the "effective url" and that is stored in an in memory cache (std::map) so that later requests may
  * skip the redirects and just get required bytes from the actual source.
+ *
+ * The cache's lock is held only while the maps are read or changed, never while following redirects. When
+ * several threads ask for the same URL at once, one of them follows the redirects and the others wait for its
+ * result. A URL that will expire within Http.cache.effective.urls.refresh.ahead seconds is returned as it is
+ * and replaced by a thread that follows the redirects again in the background. When
+ * Http.cache.effective.urls.shared is true, effective URLs are also kept in the HttpCache so the other
+ * beslistener processes on the host can use them.
  */
 class EffectiveUrlCache: public BESObj {
 private:
     static EffectiveUrlCache * d_instance;
     std::mutex d_cache_lock_mutex;
+    // HttpCache is not thread-safe, and its file locks do not keep the threads of one
+    // process apart; held only while the shared store is read or written.
+    std::mutex d_shared_store_mutex;
 
     std::map<std::string , http::EffectiveUrl *> d_effective_urls;
 
+    // URLs whose redirects are being followed now; lookups of them wait for these.
+    std::map<std::string, std::shared_future<std::string> > d_pending;
+
+    // URLs to refresh before they expire, and the thread that refreshes them.
+    std::deque<std::pair<std::string, std::shared_ptr<std::promise<std::string> > > > d_refresh_queue;
+    std::condition_variable d_refresh_cond;
+    std::unique_ptr<std::thread> d_refresher;
+    pid_t d_refresher_pid;
+    bool d_stop_refresher;
+
     // Things that match get skipped.
     BESRegex *d_skip_regex;
 
     int d_enabled;
+    int d_refresh_ahead;
+    int d_shared;
 
     static void initialize_instance();
     static void delete_instance();
@@ -66,8 +96,19 @@ private:
     http::EffectiveUrl *get(const std::string  &source_url);
     BESRegex *get_skip_regex();
     bool is_enabled();
+    int get_refresh_ahead();
+    bool is_shared();
+
+    std::string resolve(const std::string &source_url, std::promise<std::string> &resolution, bool shared,
+        time_t fresh_until);
+    void queue_refresh(const std::string &source_url);
+    void refresher();
+
+    http::EffectiveUrl *load_shared(const std::string &source_url);
+    void save_shared(const std::string &source_url, http::EffectiveUrl *effective_url);
 
-    EffectiveUrlCache(): d_skip_regex(nullptr), d_enabled(-1){}
+    EffectiveUrlCache(): d_refresher_pid(0), d_stop_refresher(false), d_skip_regex(nullptr), d_enabled(-1),
+        d_refresh_ahead(-1), d_shared(-1){}
 
     ~EffectiveUrlCache() override;
 
@@ -65,6 +65,9 @@
 #define HTTP_NO_RETRY_URL_REGEX_KEY "Http.No.Retry.Regex"
 #define HTTP_CACHE_EFFECTIVE_URLS_KEY "Http.cache.effective.urls"
 #define HTTP_CACHE_EFFECTIVE_URLS_SKIP_REGEX_KEY "Http.cache.effective.urls.skip.regex.pattern"
+#define HTTP_CACHE_EFFECTIVE_URLS_REFRESH_AHEAD_KEY "Http.cache.effective.urls.refresh.ahead"
+#define HTTP_CACHE_EFFECTIVE_URLS_REFRESH_AHEAD_DEFAULT 300
+#define HTTP_CACHE_EFFECTIVE_URLS_SHARED_KEY "Http.cache.effective.urls.shared"
 
 #define AMS_EXPIRES_HEADER_KEY "X-Amz-Expires"
 #define AWS_DATE_HEADER_KEY "X-Amz-Date"
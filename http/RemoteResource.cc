@@ -41,6 +41,7 @@
 #include "BESTimeoutError.h"
 
 #include "BESDebug.h"
+#include "BESMetrics.h"
 #include "BESUtil.h"
 
 #include "HttpCache.h"
@@ -59,6 +60,11 @@ using namespace std;
 #define prolog std::string("RemoteResource::").append(__func__).append("() - ")
 #define MODULE "rr"
 
+static BESMetric http_cache_hits(BESMetrics::counter, METRICS_CACHE_HITS, "Cache lookups that were hits",
+    "cache=\"http\"");
+static BESMetric http_cache_misses(BESMetrics::counter, METRICS_CACHE_MISSES, "Cache lookups that were misses",
+    "cache=\"http\"");
+
 namespace http {
 
     RemoteResource::RemoteResource(const std::string &url,const std::string &uid, long long expiredInterval){
@@ -303,10 +309,12 @@ namespace http {
 
                 if (is_cached_resource_expired(d_resourceCacheFileName, d_uid)) {
                     BESDEBUG(MODULE, prolog << "EXISTS - UPDATING " << endl);
+                    http_cache_misses.add();
                     update_file_and_headers(content_filters);
                     cache->exclusive_to_shared_lock(d_fd);
                 } else {
                     BESDEBUG(MODULE, prolog << "EXISTS - LOADING " << endl);
+                    http_cache_hits.add();
                     cache->exclusive_to_shared_lock(d_fd);
                     load_hdrs_from_file();
                 }
@@ -318,9 +326,11 @@ namespace http {
                 // First make an empty file and get an exclusive lock on it.
                 if (cache->create_and_lock(d_resourceCacheFileName, d_fd)) {
                     BESDEBUG(MODULE, prolog << "DOESN'T EXIST - CREATING " << endl);
+                    http_cache_misses.add();
                     update_file_and_headers(content_filters);
                 } else {
                     BESDEBUG(MODULE, prolog << " WAS CREATED - LOADING " << endl);
+                    http_cache_hits.add();
                     cache->get_read_lock(d_resourceCacheFileName, d_fd);
                     load_hdrs_from_file();
                 }
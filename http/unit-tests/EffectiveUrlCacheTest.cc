@@ -21,11 +21,15 @@
 //
 // You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
 
+#include <chrono>
+#include <future>
 #include <memory>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <thread>
 #include <time.h>
+#include <vector>
 
 #include <cppunit/TextTestRunner.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -42,6 +46,7 @@
 #include "BESContextManager.h"
 
 #include "HttpNames.h"
+#include "HttpCache.h"
 #include "EffectiveUrlCache.h"
 
 #include "test_config.h"
@@ -302,6 +307,190 @@ namespace http {
 
 
 
+        // A lookup of a URL whose redirects another thread is following waits for that thread.
+        void pending_url_test() {
+            if(debug) cerr << prolog << "BEGIN" << endl;
+            EffectiveUrlCache *cache = EffectiveUrlCache::TheCache();
+            cache->d_enabled = true;
+
+            string source_url = "http://test.opendap.org/pending/url";
+            std::promise<string> resolution;
+            cache->d_pending[source_url] = resolution.get_future().share();
+
+            string result_url;
+            std::thread lookup([&]() { result_url = cache->get_effective_url(source_url); });
+            resolution.set_value("https://test.opendap.org/resolved/url");
+            lookup.join();
+            cache->d_pending.erase(source_url);
+
+            CPPUNIT_ASSERT( result_url == "https://test.opendap.org/resolved/url" );
+            // Only the thread that follows the redirects adds the URL to the cache.
+            CPPUNIT_ASSERT( cache->d_effective_urls.find(source_url) == cache->d_effective_urls.end() );
+            if(debug) cerr << prolog << "END" << endl;
+        }
+
+        // A URL with an Expires parameter expires_in seconds from now. url::is_expired_at()
+        // treats a URL that expires within 600s of the given time as expired.
+        static string expiring_url(const string &path, time_t expires_in) {
+            return "https://test.opendap.org/" + path + "?Expires=" + to_string(time(nullptr) + expires_in);
+        }
+
+        // An effective URL written to the shared store is read back unchanged
+        void shared_round_trip_test() {
+            if(debug) cerr << prolog << "BEGIN" << endl;
+            EffectiveUrlCache *cache = EffectiveUrlCache::TheCache();
+            CPPUNIT_ASSERT( HttpCache::get_instance() );
+
+            string source_url = "http://test.opendap.org/shared/round_trip";
+            vector<string> resp_hdrs = { "content-type: text/plain", "x-test: round trip" };
+            http::EffectiveUrl saved(expiring_url("shared/round_trip", 3600), resp_hdrs);
+            saved.set_ingest_time(1234567890);
+            cache->save_shared(source_url, &saved);
+
+            unique_ptr<http::EffectiveUrl> loaded(cache->load_shared(source_url));
+            CPPUNIT_ASSERT( loaded );
+            CPPUNIT_ASSERT( loaded->str() == saved.str() );
+            CPPUNIT_ASSERT( loaded->ingest_time() == 1234567890 );
+            CPPUNIT_ASSERT( loaded->response_header_lines() == resp_hdrs );
+
+            // A new record replaces the old one
+            http::EffectiveUrl replacement(expiring_url("shared/replacement", 3600));
+            replacement.set_ingest_time(1234567891);
+            cache->save_shared(source_url, &replacement);
+
+            loaded.reset(cache->load_shared(source_url));
+            CPPUNIT_ASSERT( loaded );
+            CPPUNIT_ASSERT( loaded->str() == replacement.str() );
+            CPPUNIT_ASSERT( loaded->ingest_time() == 1234567891 );
+            CPPUNIT_ASSERT( loaded->response_header_lines().empty() );
+
+            CPPUNIT_ASSERT( !cache->load_shared("http://test.opendap.org/shared/never_saved") );
+            if(debug) cerr << prolog << "END" << endl;
+        }
+
+        // A cached URL that expires within the refresh window is returned and queued for a refresh
+        void refresh_queued_test() {
+            if(debug) cerr << prolog << "BEGIN" << endl;
+            EffectiveUrlCache *cache = EffectiveUrlCache::TheCache();
+            cache->d_enabled = true;
+            cache->d_refresh_ahead = 300;
+            cache->d_shared = 0;
+
+            string source_url = "http://test.opendap.org/refresh/queued";
+            auto *expiring = new http::EffectiveUrl(expiring_url("refresh/expiring", 600 + 120));
+            CPPUNIT_ASSERT( !expiring->is_expired() );
+            CPPUNIT_ASSERT( expiring->is_expired_at(time(nullptr) + 300) );
+            cache->d_effective_urls[source_url] = expiring;
+
+            // Stop the refresher as soon as it starts, so the refresh stays queued
+            cache->d_stop_refresher = true;
+
+            CPPUNIT_ASSERT( cache->get_effective_url(source_url) == expiring->str() );
+            {
+                std::lock_guard<std::mutex> lock(cache->d_cache_lock_mutex);
+                CPPUNIT_ASSERT( cache->d_refresh_queue.size() == 1 );
+                CPPUNIT_ASSERT( cache->d_refresh_queue.front().first == source_url );
+                CPPUNIT_ASSERT( cache->d_pending.find(source_url) != cache->d_pending.end() );
+            }
+
+            // A URL is queued once, however often it is read
+            CPPUNIT_ASSERT( cache->get_effective_url(source_url) == expiring->str() );
+            CPPUNIT_ASSERT( cache->d_refresh_queue.size() == 1 );
+
+            // A URL outside the window is not queued
+            string fresh_source_url = "http://test.opendap.org/refresh/fresh";
+            auto *fresh = new http::EffectiveUrl(expiring_url("refresh/fresh", 3600));
+            cache->d_effective_urls[fresh_source_url] = fresh;
+            CPPUNIT_ASSERT( cache->get_effective_url(fresh_source_url) == fresh->str() );
+            CPPUNIT_ASSERT( cache->d_refresh_queue.size() == 1 );
+
+            cache->d_refresher->join();
+            cache->d_refresher.reset();
+            cache->d_refresh_queue.clear();
+            cache->d_pending.clear();
+            cache->d_stop_refresher = false;
+            cache->d_refresh_ahead = -1;
+            cache->d_shared = -1;
+            if(debug) cerr << prolog << "END" << endl;
+        }
+
+        // The refresher replaces a URL in the refresh window with one from the shared store
+        void refresh_from_shared_test() {
+            if(debug) cerr << prolog << "BEGIN" << endl;
+            EffectiveUrlCache *cache = EffectiveUrlCache::TheCache();
+            cache->d_enabled = true;
+            cache->d_refresh_ahead = 300;
+            cache->d_shared = 1;
+            CPPUNIT_ASSERT( HttpCache::get_instance() );
+
+            string source_url = "http://test.opendap.org/refresh/shared";
+            http::EffectiveUrl refreshed(expiring_url("refresh/refreshed", 7200));
+            refreshed.set_ingest_time(time(nullptr));
+            cache->save_shared(source_url, &refreshed);
+
+            auto *expiring = new http::EffectiveUrl(expiring_url("refresh/expiring", 600 + 120));
+            cache->d_effective_urls[source_url] = expiring;
+            string expiring_str = expiring->str();
+
+            CPPUNIT_ASSERT( cache->get_effective_url(source_url) == expiring_str );
+
+            // The refresher runs in the background; give it up to five seconds
+            bool replaced = false;
+            for (int i = 0; i < 500 && !replaced; ++i) {
+                {
+                    std::lock_guard<std::mutex> lock(cache->d_cache_lock_mutex);
+                    replaced = cache->d_pending.find(source_url) == cache->d_pending.end()
+                        && cache->d_effective_urls[source_url]->str() == refreshed.str();
+                }
+                if (!replaced) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            CPPUNIT_ASSERT( replaced );
+            CPPUNIT_ASSERT( cache->get_effective_url(source_url) == refreshed.str() );
+
+            cache->d_refresh_ahead = -1;
+            cache->d_shared = -1;
+            if(debug) cerr << prolog << "END" << endl;
+        }
+
+        // Several threads write and read the shared store at once, each for its own URLs
+        void shared_threads_test() {
+            if(debug) cerr << prolog << "BEGIN" << endl;
+            EffectiveUrlCache *cache = EffectiveUrlCache::TheCache();
+            cache->d_enabled = true;
+            cache->d_refresh_ahead = 0;
+            cache->d_shared = 1;
+            CPPUNIT_ASSERT( HttpCache::get_instance() );
+
+            const unsigned int num_threads = 8;
+            const unsigned int urls_per_thread = 20;
+            vector<std::future<unsigned int> > results;
+            for (unsigned int t = 0; t < num_threads; ++t) {
+                results.push_back(std::async(std::launch::async, [cache, t, urls_per_thread]() {
+                    unsigned int found = 0;
+                    for (unsigned int i = 0; i < urls_per_thread; ++i) {
+                        string path = "shared/threads/" + to_string(t) + "/" + to_string(i);
+                        string source_url = "http://test.opendap.org/" + path;
+                        http::EffectiveUrl saved(expiring_url(path + "/effective", 3600));
+                        saved.set_ingest_time(time(nullptr));
+                        cache->save_shared(source_url, &saved);
+
+                        // Not in this process' cache, so it's read from the shared store
+                        if (cache->get_effective_url(source_url) == saved.str())
+                            ++found;
+                    }
+                    return found;
+                }));
+            }
+
+            for (auto &result: results)
+                CPPUNIT_ASSERT( result.get() == urls_per_thread );
+            CPPUNIT_ASSERT( cache->d_effective_urls.size() == num_threads * urls_per_thread );
+
+            cache->d_refresh_ahead = -1;
+            cache->d_shared = -1;
+            if(debug) cerr << prolog << "END" << endl;
+        }
+
         void euc_ghrc_tea_url_test() {
             if(!ngap_tests){
                 if(debug) cerr << prolog << "SKIPPING." << endl;
@@ -429,6 +618,11 @@ namespace http {
             CPPUNIT_TEST(cache_test_00);
             CPPUNIT_TEST(cache_test_01);
             CPPUNIT_TEST(skip_regex_test);
+            CPPUNIT_TEST(pending_url_test);
+            CPPUNIT_TEST(shared_round_trip_test);
+            CPPUNIT_TEST(refresh_queued_test);
+            CPPUNIT_TEST(refresh_from_shared_test);
+            CPPUNIT_TEST(shared_threads_test);
             CPPUNIT_TEST(euc_ghrc_tea_url_test);
             CPPUNIT_TEST(euc_harmony_url_test);
 
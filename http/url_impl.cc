@@ -259,10 +259,23 @@ void url::kvp(map<string,string>  &kvp){
  *
  */
 bool url::is_expired()
+{
+    return is_expired_at(time(nullptr));
+}
+
+/**
+ * @brief Will the URL be expired at the given time?
+ *
+ * Like is_expired(), but for a time other than now, so callers can tell
+ * whether the URL will need to be replaced soon.
+ *
+ * @param now The time to test
+ * @return True if \arg now is within the REFRESH_THRESHOLD of the URL's
+ * expires time.
+ */
+bool url::is_expired_at(time_t now)
 {
     bool is_expired;
-    time_t now;
-    time(&now);  /* get current time; same as: timer = time(NULL)  */
     BESDEBUG(MODULE, prolog << "now: " << now << endl);
 
     time_t expires = now;
@@ -84,6 +84,7 @@ public:
     virtual void query_parameter_values(const std::string &key, std::vector<std::string> &values) const;
 
     virtual bool is_expired();
+    virtual bool is_expired_at(time_t now);
 
     virtual std::string dump();
 
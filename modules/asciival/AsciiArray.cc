@@ -46,12 +46,56 @@ using namespace std;
 #include "InternalErr.h"
 #include "debug.h"
 
+#include <TextFormatter.h>
+
 #include "AsciiArray.h"
 #include "util.h"
 #include "get_ascii.h"
 
 using namespace dap_asciival;
 
+// Print 'number' values starting at 'index', separated by commas, straight
+// from the array's buffer. The text is what the values' print_val() methods
+// print; Float32 uses six digits and Float64 fifteen.
+template<typename T>
+static void print_values(ostream &strm, Array *a, int index, int number, int precision)
+{
+    bes::TextFormatter out(strm);
+    out.precision(precision);
+    out.put_values(reinterpret_cast<const T*>(a->get_buf()) + index, number, ", ");
+}
+
+// Returns false if the array does not hold numbers; print those one at a
+// time with print_ascii().
+static bool print_numeric_values(ostream &strm, Array *a, int index, int number)
+{
+    switch (a->var()->type()) {
+    case dods_byte_c:
+        print_values<dods_byte>(strm, a, index, number, 6);
+        return true;
+    case dods_int16_c:
+        print_values<dods_int16>(strm, a, index, number, 6);
+        return true;
+    case dods_uint16_c:
+        print_values<dods_uint16>(strm, a, index, number, 6);
+        return true;
+    case dods_int32_c:
+        print_values<dods_int32>(strm, a, index, number, 6);
+        return true;
+    case dods_uint32_c:
+        print_values<dods_uint32>(strm, a, index, number, 6);
+        return true;
+    case dods_float32_c:
+        print_values<dods_float32>(strm, a, index, number, 6);
+        return true;
+    case dods_float64_c:
+        print_values<dods_float64>(strm, a, index, number, 15);
+        return true;
+    default:
+        return false;
+    }
+}
+
 BaseType *
 AsciiArray::ptr_duplicate()
 {
@@ -126,6 +170,9 @@ void AsciiArray::print_vector(ostream &strm, bool print_name)
     if (dimension_size(dim_begin(), true) > 0) {
         int end = /*bt->*/dimension_size(/*bt->*/dim_begin(), true) - 1;
 
+        if (print_numeric_values(strm, bt, 0, end + 1))
+            return;
+
         for (int i = 0; i < end; ++i) {
             BaseType *curr_var = basetype_to_asciitype(bt->var(i));
             dynamic_cast<AsciiOutput &>(*curr_var).print_ascii(strm, false);
@@ -162,6 +209,9 @@ int AsciiArray::print_row(ostream &strm, int index, int number)
     // Changed to >= 0 to catch the edge case where the rightmost dimension
     // is constrained to be just one element. jhrg 6/9/16 (See Hyrax-225)
     if (number >= 0) {
+        if (print_numeric_values(strm, bt, index, number + 1))
+            return index + number + 1;
+
         for (int i = 0; i < number; ++i) {
             BaseType *curr_var = basetype_to_asciitype(bt->var(index++));
             dynamic_cast<AsciiOutput &>(*curr_var).print_ascii(strm, false);
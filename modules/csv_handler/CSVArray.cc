@@ -0,0 +1,116 @@
+// CSVArray.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include <BESDebug.h>
+#include <BESInternalError.h>
+
+#include "CSVArray.h"
+#include "CSV_Table.h"
+
+using namespace libdap;
+using std::string;
+using std::vector;
+using std::endl;
+
+#define prolog std::string("CSVArray::").append(__func__).append("() - ")
+#define MODULE "csv"
+
+CSVArray::CSVArray(const string &name, BaseType *proto, std::shared_ptr<CSV_Table> table, unsigned int column) :
+    Array(name, proto), d_table(table), d_column(column)
+{
+}
+
+CSVArray::CSVArray(const CSVArray &rhs) :
+    Array(rhs), d_table(rhs.d_table), d_column(rhs.d_column)
+{
+}
+
+CSVArray &CSVArray::operator=(const CSVArray &rhs)
+{
+    if (this == &rhs) return *this;
+
+    Array::operator=(rhs);
+    d_table = rhs.d_table;
+    d_column = rhs.d_column;
+
+    return *this;
+}
+
+BaseType *CSVArray::ptr_duplicate()
+{
+    return new CSVArray(*this);
+}
+
+template<typename T> static void read_column(CSVArray &array, const CSV_Table &table, unsigned int column,
+    size_t start, size_t stride, size_t count)
+{
+    vector<T> values;
+    table.readColumn(column, start, stride, count, values);
+    array.set_value(values, values.size());
+}
+
+/**
+ * @brief Read the values of the column selected by the constraint
+ */
+bool CSVArray::read()
+{
+    if (read_p()) return true;
+
+    Dim_iter d = dim_begin();
+    size_t start = dimension_start(d, true);
+    size_t stride = dimension_stride(d, true);
+    size_t count = length();
+
+    BESDEBUG(MODULE, prolog << "Reading " << name() << " from record " << start << " by " << stride << ", "
+        << count << " values" << endl);
+
+    switch (var()->type()) {
+    case dods_str_c:
+        read_column<string>(*this, *d_table, d_column, start, stride, count);
+        break;
+    case dods_int16_c:
+        read_column<dods_int16>(*this, *d_table, d_column, start, stride, count);
+        break;
+    case dods_int32_c:
+        read_column<dods_int32>(*this, *d_table, d_column, start, stride, count);
+        break;
+    case dods_float32_c:
+        read_column<dods_float32>(*this, *d_table, d_column, start, stride, count);
+        break;
+    case dods_float64_c:
+        read_column<dods_float64>(*this, *d_table, d_column, start, stride, count);
+        break;
+    default:
+        throw BESInternalError(prolog + "Unknown type for field " + name(), __FILE__, __LINE__);
+    }
+
+    set_read_p(true);
+
+    return true;
+}
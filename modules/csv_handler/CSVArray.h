@@ -0,0 +1,63 @@
+// CSVArray.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef I_CSVArray_h
+#define I_CSVArray_h 1
+
+#include <memory>
+#include <string>
+
+#include <Array.h>
+
+class CSV_Table;
+
+/**
+ * @brief One column of a CSV file
+ *
+ * The values are read from the file's CSV_Table when the array is read,
+ * and only the values selected by the constraint are parsed.
+ */
+class CSVArray: public libdap::Array {
+private:
+    std::shared_ptr<CSV_Table> d_table;
+    unsigned int d_column;
+
+public:
+    CSVArray(const std::string &name, libdap::BaseType *proto, std::shared_ptr<CSV_Table> table,
+        unsigned int column);
+
+    CSVArray(const CSVArray &rhs);
+
+    virtual ~CSVArray()
+    {
+    }
+
+    CSVArray &operator=(const CSVArray &rhs);
+
+    virtual libdap::BaseType *ptr_duplicate();
+
+    virtual bool read();
+};
+
+#endif // I_CSVArray_h
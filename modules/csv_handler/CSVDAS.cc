@@ -40,42 +40,21 @@
 #include "DAS.h"
 #include "Error.h"
 
-#include "CSV_Obj.h"
+#include "CSV_Table.h"
 
-#include <BESNotFoundError.h>
 #include <BESDebug.h>
 
-using std::auto_ptr;
+using std::shared_ptr;
 using std::endl;
 
 void csv_read_attributes(DAS &das, const string &filename)
 {
-#if 0
-    AttrTable *attr_table_ptr = NULL;
-    string type;
-#endif
+    shared_ptr<CSV_Table> table = CSV_Table::open(filename);
 
-#if 0
-    CSV_Obj* csvObj = new CSV_Obj();
-#endif
-
-    auto_ptr<CSV_Obj> csvObj(new CSV_Obj);
-
-    if (!csvObj->open(filename)) {
-#if 0
-        string err = (string) "Unable to open file " + filename;
-        delete csvObj;
-#endif
-
-        throw BESNotFoundError(string("Unable to open file ").append(filename), __FILE__, __LINE__);
-    }
-
-    csvObj->load();
-
-    BESDEBUG( "csv", "File Loaded:" << endl << *csvObj << endl );
+    BESDEBUG( "csv", "File indexed:" << endl << *table << endl );
 
     vector<string> fieldList;
-    csvObj->getFieldList(fieldList);
+    table->getFieldList(fieldList);
 
     //loop through all the fields
     vector<string>::iterator it = fieldList.begin();
@@ -86,13 +65,7 @@ void csv_read_attributes(DAS &das, const string &filename)
         if (!attr_table_ptr) attr_table_ptr = das.add_table(string(*it), new AttrTable);
 
         //only one attribute, field type, called "type"
-        string type = csvObj->getFieldType(*it);
+        string type = table->getFieldType(*it);
         attr_table_ptr->append_attr("type", "String", type);
     }
-
-#if 0
-    delete csvObj;
-#endif
-
 }
-
@@ -34,6 +34,8 @@
 
 #include "config.h"
 
+#include <sstream>
+
 #include <DDS.h>
 #include <DAS.h>
 #include <DataDDS.h>
@@ -62,6 +64,7 @@
 #include <BESConstraintFuncs.h>
 #include <BESDapError.h>
 #include <BESDebug.h>
+#include <TheBESKeys.h>
 
 #include "CSVDDS.h"
 #include "CSVDAS.h"
@@ -71,9 +74,30 @@
 #define prolog std::string("CSVRequestHandler::").append(__func__).append("() - ")
 #define MODULE "csv"
 
+#define CSV_PARSE_THREADS_KEY "CSV.ParseThreads"
+#define CSV_TABLE_CACHE_SIZE_KEY "CSV.TableCacheSize"
+
+unsigned int CSVRequestHandler::d_parse_threads = 4;
+unsigned int CSVRequestHandler::d_table_cache_size = 16;
+
+static void read_key_value(const std::string &key_name, unsigned int &key_value)
+{
+	bool key_found = false;
+	string value;
+	TheBESKeys::TheKeys()->get_value(key_name, value, key_found);
+	if (key_found) {
+		std::istringstream iss(value);
+		iss >> key_value;
+	}
+}
+
 CSVRequestHandler::CSVRequestHandler(string name) :
 		BESRequestHandler(name)
 {
+	read_key_value(CSV_PARSE_THREADS_KEY, d_parse_threads);
+	read_key_value(CSV_TABLE_CACHE_SIZE_KEY, d_table_cache_size);
+	BESDEBUG(MODULE, prolog << "Parse threads: " << d_parse_threads << ", table cache size: " << d_table_cache_size << endl);
+
 	add_method(DAS_RESPONSE, CSVRequestHandler::csv_build_das);
 	add_method(DDS_RESPONSE, CSVRequestHandler::csv_build_dds);
 	add_method(DATA_RESPONSE, CSVRequestHandler::csv_build_data);
@@ -310,6 +334,8 @@ void CSVRequestHandler::dump(ostream &strm) const
 {
 	strm << BESIndent::LMarg << "CSVRequestHandler::dump - (" << (void *) this << ")" << endl;
 	BESIndent::Indent();
+	strm << BESIndent::LMarg << "parse threads: " << d_parse_threads << endl;
+	strm << BESIndent::LMarg << "table cache size: " << d_table_cache_size << endl;
 	BESRequestHandler::dump(strm);
 	BESIndent::UnIndent();
 }
@@ -44,6 +44,11 @@ public:
 
 	virtual void dump(std::ostream &strm) const;
 
+	// Threads used to index a file and to read a column (CSV.ParseThreads)
+	static unsigned int d_parse_threads;
+	// Number of indexed files kept (CSV.TableCacheSize)
+	static unsigned int d_table_cache_size;
+
 	static bool csv_build_das(BESDataHandlerInterface &dhi);
 	static bool csv_build_dds(BESDataHandlerInterface &dhi);
 	static bool csv_build_data(BESDataHandlerInterface &dhi);
@@ -39,6 +39,13 @@
 
 #include <BESObj.h>
 
+static const char STRING[]  = "String";
+static const char BYTE[]    = "Byte";
+static const char INT32[]   = "Int32";
+static const char INT16[]   = "Int16";
+static const char FLOAT64[] = "Float64";
+static const char FLOAT32[] = "Float32";
+
 class CSV_Field: public BESObj {
 private:
 	std::string _name;
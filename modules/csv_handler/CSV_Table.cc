@@ -0,0 +1,547 @@
+// CSV_Table.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <list>
+#include <mutex>
+#include <sstream>
+
+#include <BESDebug.h>
+#include <BESInternalError.h>
+#include <BESNotFoundError.h>
+#include <BESSyntaxUserError.h>
+#include <BESLog.h>
+
+#include "CSV_Table.h"
+#include "CSV_Header.h"
+#include "CSV_Utils.h"
+#include "CSVRequestHandler.h"
+
+using std::string;
+using std::vector;
+using std::list;
+using std::shared_ptr;
+using std::ostream;
+using std::endl;
+using std::ostringstream;
+
+#define prolog std::string("CSV_Table::").append(__func__).append("() - ")
+#define MODULE "csv"
+
+// Files smaller than this are indexed by one thread
+static const size_t min_segment_bytes = 4 * 1024 * 1024;
+
+// Columns with fewer values than this are read by one thread
+static const size_t min_thread_values = 64 * 1024;
+
+static std::mutex &cache_mutex()
+{
+    static std::mutex *m = new std::mutex;
+    return *m;
+}
+
+// Most recently used first
+static list<shared_ptr<CSV_Table> > &table_cache()
+{
+    static list<shared_ptr<CSV_Table> > *cache = new list<shared_ptr<CSV_Table> >;
+    return *cache;
+}
+
+static unsigned int parse_threads()
+{
+    return std::max(1U, CSVRequestHandler::d_parse_threads);
+}
+
+static inline const char *line_end(const char *p, const char *end)
+{
+    const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+    return eol ? eol : end;
+}
+
+// Empty lines and lines that start with '#' are not records
+static inline bool skip_line(const char *p, const char *eol)
+{
+    return p == eol || *p == '#';
+}
+
+/**
+ * @brief Find the end of the field that starts at p
+ *
+ * Quoted fields are found the way BESUtil::explode() finds them, so a file
+ * is split into the same fields, and rejected with the same errors, as
+ * when each line was split using CSV_Utils::split().
+ *
+ * @param p The start of the field
+ * @param eol The end of the line
+ * @param field_end Value-result parameter; the end of the field
+ * @return The start of the next field or null if this is the last field
+ */
+static const char *next_field(const char *p, const char *eol, const char *&field_end)
+{
+    if (p != eol && *p == '"') {
+        const char *q = p + 1;
+        const char *quote;
+        while (true) {
+            quote = static_cast<const char *>(memchr(q, '"', eol - q));
+            if (!quote)
+                throw BESInternalError("BESUtil::explode - No end quote after value " + string(p, eol), __FILE__,
+                    __LINE__);
+            // an escaped quote does not end the value, but an escaped escape does
+            if (quote[-1] != '\\' || quote[-2] == '\\') break;
+            q = quote + 1;
+        }
+
+        field_end = quote + 1;
+        if (field_end != eol && *field_end != ',')
+            throw BESInternalError("BESUtil::explode - No delim after end quote " + string(p, field_end), __FILE__,
+                __LINE__);
+    }
+    else {
+        const char *delim = static_cast<const char *>(memchr(p, ',', eol - p));
+        field_end = delim ? delim : eol;
+    }
+
+    return field_end == eol ? 0 : field_end + 1;
+}
+
+static size_t count_fields(const char *p, const char *eol)
+{
+    // Most records have no quotes; for those, count the delimiters. The
+    // compiler vectorizes this loop.
+    if (!memchr(p, '"', eol - p)) return std::count(p, eol, ',') + 1;
+
+    size_t fields = 0;
+    const char *field_end;
+    do {
+        p = next_field(p, eol, field_end);
+        ++fields;
+    } while (p);
+
+    return fields;
+}
+
+/// The records found in one part of a file
+struct Segment {
+    vector<size_t> records;
+    // The record after the last one in 'records' has too few fields
+    bool short_record;
+    std::exception_ptr error;
+
+    Segment() : short_record(false)
+    {
+    }
+};
+
+/**
+ * @brief Find the records that start in [p, end)
+ *
+ * Stops at the first record with too few fields or with a malformed quoted
+ * value.
+ */
+static void index_segment(const char *base, const char *p, const char *end, unsigned int field_count,
+    Segment &segment)
+{
+    try {
+        while (p < end) {
+            const char *eol = line_end(p, end);
+            if (!skip_line(p, eol)) {
+                if (count_fields(p, eol) < field_count) {
+                    segment.short_record = true;
+                    return;
+                }
+                segment.records.push_back(p - base);
+            }
+            if (eol == end) break;
+            p = eol + 1;
+        }
+    }
+    catch (...) {
+        segment.error = std::current_exception();
+    }
+}
+
+static inline void convert(const char *begin, const char *end, string &value)
+{
+    value.assign(begin, end);
+}
+
+// atoi() and atof() need a terminated string
+class TerminatedValue {
+private:
+    char d_buf[64];
+    string d_value;
+    const char *d_c_str;
+
+public:
+    TerminatedValue(const char *begin, const char *end)
+    {
+        size_t length = end - begin;
+        if (length < sizeof(d_buf)) {
+            memcpy(d_buf, begin, length);
+            d_buf[length] = '\0';
+            d_c_str = d_buf;
+        }
+        else {
+            d_value.assign(begin, end);
+            d_c_str = d_value.c_str();
+        }
+    }
+
+    const char *c_str() const
+    {
+        return d_c_str;
+    }
+};
+
+static inline void convert(const char *begin, const char *end, short &value)
+{
+    value = atoi(TerminatedValue(begin, end).c_str());
+}
+
+static inline void convert(const char *begin, const char *end, int &value)
+{
+    value = atoi(TerminatedValue(begin, end).c_str());
+}
+
+static inline void convert(const char *begin, const char *end, float &value)
+{
+    value = atof(TerminatedValue(begin, end).c_str());
+}
+
+static inline void convert(const char *begin, const char *end, double &value)
+{
+    value = atof(TerminatedValue(begin, end).c_str());
+}
+
+CSV_Table::CSV_Table(const string &path) :
+    d_path(path), d_dev(0), d_ino(0), d_size(0), d_mtime(0), d_begin(0), d_end(0), d_header(new CSV_Header),
+        d_field_count(0)
+{
+    try {
+        map_file();
+
+        // The header is the first line that is not empty or a comment
+        const char *p = d_begin;
+        const char *eol = d_begin;
+        while (p < d_end) {
+            eol = line_end(p, d_end);
+            if (!skip_line(p, eol)) break;
+            p = eol < d_end ? eol + 1 : d_end;
+        }
+
+        if (p < d_end) {
+            vector<string> tokens;
+            CSV_Utils::split(string(p, eol), ',', tokens);
+            d_header->populate(&tokens);
+            d_field_count = tokens.size();
+
+            if (eol < d_end) index_records(eol + 1);
+        }
+    }
+    catch (...) {
+        release();
+        throw;
+    }
+}
+
+CSV_Table::~CSV_Table()
+{
+    release();
+}
+
+void CSV_Table::release()
+{
+    if (d_begin) {
+        munmap(const_cast<char *>(d_begin), d_end - d_begin);
+        d_begin = d_end = 0;
+    }
+
+    delete d_header;
+    d_header = 0;
+}
+
+void CSV_Table::map_file()
+{
+    int fd = ::open(d_path.c_str(), O_RDONLY);
+    if (fd < 0) throw BESNotFoundError(string("Unable to open file ").append(d_path), __FILE__, __LINE__);
+
+    struct stat buf;
+    if (fstat(fd, &buf) != 0) {
+        int error = errno;
+        close(fd);
+        throw BESInternalError(prolog + "Could not stat " + d_path + ": " + strerror(error), __FILE__, __LINE__);
+    }
+
+    d_dev = buf.st_dev;
+    d_ino = buf.st_ino;
+    d_size = buf.st_size;
+    d_mtime = buf.st_mtime;
+
+    // mmap() will not map an empty file
+    if (d_size > 0) {
+        void *map = mmap(0, d_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int error = errno;
+            close(fd);
+            throw BESInternalError(prolog + "Could not map " + d_path + ": " + strerror(error), __FILE__, __LINE__);
+        }
+
+        d_begin = static_cast<const char *>(map);
+        d_end = d_begin + d_size;
+    }
+
+    // The mapping holds its own reference to the file
+    close(fd);
+}
+
+/**
+ * @brief Record where each record starts
+ *
+ * Large files are split into one segment per thread; each segment starts
+ * at the beginning of a line. Errors are reported for the first bad record
+ * in the file, with the line number the handler has always used: the header
+ * is line one and comments and empty lines are not counted.
+ *
+ * @param first The first character after the header
+ */
+void CSV_Table::index_records(const char *first)
+{
+    size_t bytes = d_end - first;
+    unsigned int threads = std::max<size_t>(1, std::min<size_t>(parse_threads(), bytes / min_segment_bytes));
+
+    vector<const char *> bounds(threads + 1);
+    bounds[0] = first;
+    bounds[threads] = d_end;
+    for (unsigned int i = 1; i < threads; ++i) {
+        const char *p = first + i * (bytes / threads);
+        if (p[-1] != '\n') {
+            p = line_end(p, d_end);
+            if (p < d_end) ++p;
+        }
+        bounds[i] = std::max(p, bounds[i - 1]);
+    }
+
+    vector<Segment> segments(threads);
+    vector<std::future<void> > futures;
+    for (unsigned int i = 1; i < threads; ++i) {
+        futures.push_back(std::async(std::launch::async, index_segment, d_begin, bounds[i], bounds[i + 1],
+            d_field_count, std::ref(segments[i])));
+    }
+    index_segment(d_begin, bounds[0], bounds[1], d_field_count, segments[0]);
+
+    for (auto &f : futures)
+        f.get();
+
+    size_t total = 0;
+    for (auto &segment : segments)
+        total += segment.records.size();
+    d_records.reserve(total);
+
+    for (auto &segment : segments) {
+        d_records.insert(d_records.end(), segment.records.begin(), segment.records.end());
+
+        if (segment.error) std::rethrow_exception(segment.error);
+
+        if (segment.short_record) {
+            ostringstream err;
+            err << "Error in CSV dataset, too few data elements on line " << d_records.size() + 2;
+            ERROR_LOG(err.str());
+            throw BESSyntaxUserError(err.str(), __FILE__, __LINE__);
+        }
+    }
+
+    BESDEBUG(MODULE, prolog << "Indexed " << d_records.size() << " records in " << d_path << " using " << threads
+        << " thread(s)" << endl);
+}
+
+/**
+ * @brief Find a value
+ *
+ * Leading and trailing double quotes are removed, as CSV_Utils::slim()
+ * removes them.
+ */
+void CSV_Table::get_field(size_t record, unsigned int column, const char *&begin, const char *&end) const
+{
+    const char *p = d_begin + d_records[record];
+    const char *eol = line_end(p, d_end);
+    const char *field_end;
+
+    // Every record was checked for enough fields when it was indexed
+    if (!memchr(p, '"', eol - p)) {
+        for (unsigned int i = 0; i < column; ++i)
+            p = static_cast<const char *>(memchr(p, ',', eol - p)) + 1;
+        const char *delim = static_cast<const char *>(memchr(p, ',', eol - p));
+        field_end = delim ? delim : eol;
+    }
+    else {
+        for (unsigned int i = 0; i < column; ++i)
+            p = next_field(p, eol, field_end);
+        next_field(p, eol, field_end);
+    }
+
+    begin = p;
+    end = field_end;
+    if (begin != end && *begin == '"' && end[-1] == '"') {
+        ++begin;
+        end = std::max(begin, end - 1);
+    }
+}
+
+template<typename T>
+void CSV_Table::read_values(unsigned int column, size_t start, size_t stride, size_t count, vector<T> &values) const
+{
+    if (column >= d_field_count || stride == 0 || (count > 0 && start + (count - 1) * stride >= d_records.size())) {
+        ostringstream err;
+        err << "Could not read column " << column << " of " << d_path << " from record " << start << " by " << stride
+            << " for " << count << " values";
+        throw BESInternalError(err.str(), __FILE__, __LINE__);
+    }
+
+    values.resize(count);
+
+    auto read = [this, column, start, stride, &values](size_t first, size_t last) {
+        const char *begin, *end;
+        for (size_t i = first; i < last; ++i) {
+            get_field(start + i * stride, column, begin, end);
+            convert(begin, end, values[i]);
+        }
+    };
+
+    unsigned int threads = std::max<size_t>(1, std::min<size_t>(parse_threads(), count / min_thread_values));
+    size_t chunk = count / threads;
+
+    vector<std::future<void> > futures;
+    for (unsigned int i = 1; i < threads; ++i)
+        futures.push_back(std::async(std::launch::async, read, i * chunk, i == threads - 1 ? count : (i + 1) * chunk));
+    read(0, threads == 1 ? count : chunk);
+
+    for (auto &f : futures)
+        f.get();
+}
+
+void CSV_Table::readColumn(unsigned int column, size_t start, size_t stride, size_t count, vector<string> &values) const
+{
+    read_values(column, start, stride, count, values);
+}
+
+void CSV_Table::readColumn(unsigned int column, size_t start, size_t stride, size_t count, vector<short> &values) const
+{
+    read_values(column, start, stride, count, values);
+}
+
+void CSV_Table::readColumn(unsigned int column, size_t start, size_t stride, size_t count, vector<int> &values) const
+{
+    read_values(column, start, stride, count, values);
+}
+
+void CSV_Table::readColumn(unsigned int column, size_t start, size_t stride, size_t count, vector<float> &values) const
+{
+    read_values(column, start, stride, count, values);
+}
+
+void CSV_Table::readColumn(unsigned int column, size_t start, size_t stride, size_t count, vector<double> &values) const
+{
+    read_values(column, start, stride, count, values);
+}
+
+void CSV_Table::getFieldList(vector<string> &list)
+{
+    d_header->getFieldList(list);
+}
+
+const string CSV_Table::getFieldType(const string &fieldName)
+{
+    return d_header->getFieldType(fieldName);
+}
+
+/**
+ * @brief Get the table for a file
+ *
+ * @param path The file
+ * @return The table, from the cache if the file has not changed since it
+ * was indexed
+ * @exception BESNotFoundError if the file cannot be opened
+ */
+shared_ptr<CSV_Table> CSV_Table::open(const string &path)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) != 0)
+        throw BESNotFoundError(string("Unable to open file ").append(path), __FILE__, __LINE__);
+
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex());
+        list<shared_ptr<CSV_Table> > &cache = table_cache();
+        for (auto i = cache.begin(), e = cache.end(); i != e; ++i) {
+            const CSV_Table &table = **i;
+            if (table.d_path != path) continue;
+
+            if (table.d_dev == buf.st_dev && table.d_ino == buf.st_ino && table.d_size == buf.st_size
+                && table.d_mtime == buf.st_mtime) {
+                BESDEBUG(MODULE, prolog << "Using the cached table for " << path << endl);
+                cache.splice(cache.begin(), cache, i);
+                return cache.front();
+            }
+
+            cache.erase(i);
+            break;
+        }
+    }
+
+    shared_ptr<CSV_Table> table(new CSV_Table(path));
+
+    if (CSVRequestHandler::d_table_cache_size > 0) {
+        std::lock_guard<std::mutex> lock(cache_mutex());
+        list<shared_ptr<CSV_Table> > &cache = table_cache();
+        cache.push_front(table);
+        while (cache.size() > CSVRequestHandler::d_table_cache_size)
+            cache.pop_back();
+    }
+
+    return table;
+}
+
+void CSV_Table::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "CSV_Table::dump - (" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    strm << BESIndent::LMarg << "path: " << d_path << endl;
+    strm << BESIndent::LMarg << "size: " << d_size << endl;
+    strm << BESIndent::LMarg << "fields: " << d_field_count << endl;
+    strm << BESIndent::LMarg << "records: " << d_records.size() << endl;
+    d_header->dump(strm);
+    BESIndent::UnIndent();
+}
@@ -0,0 +1,110 @@
+// CSV_Table.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef I_CSV_Table_h
+#define I_CSV_Table_h 1
+
+#include <sys/types.h>
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <BESObj.h>
+
+class CSV_Header;
+
+/**
+ * @brief A CSV file, mapped into memory, with an index of where each record starts
+ *
+ * Opening a table maps the file, reads the header and records the offset of
+ * each record. The records are checked as they are indexed, so a file with a
+ * short record is rejected when it is opened, as it was when the whole file
+ * was loaded. Values are not parsed until a column is read, and then only
+ * the values of that column in the requested records are parsed. Because
+ * the records are indexed, reading a hyperslab of a column does not scan
+ * the records before the first one read.
+ *
+ * Large files are indexed, and large columns read, using up to
+ * CSV.ParseThreads threads, each working on its own part of the file.
+ *
+ * Tables are kept in a small cache (CSV.TableCacheSize) so the DAS, DDS
+ * and data responses for a file share one index. A cached table is used
+ * only while the file's size and modification time are unchanged.
+ */
+class CSV_Table: public BESObj {
+private:
+    std::string d_path;
+    dev_t d_dev;
+    ino_t d_ino;
+    off_t d_size;
+    time_t d_mtime;
+
+    const char *d_begin;
+    const char *d_end;
+
+    CSV_Header *d_header;
+    unsigned int d_field_count;
+
+    // Offset of the first character of each record
+    std::vector<size_t> d_records;
+
+    explicit CSV_Table(const std::string &path);
+
+    CSV_Table(const CSV_Table &) = delete;
+    CSV_Table &operator=(const CSV_Table &) = delete;
+
+    void map_file();
+    void index_records(const char *first);
+    void release();
+
+    void get_field(size_t record, unsigned int column, const char *&begin, const char *&end) const;
+
+    template<typename T> void read_values(unsigned int column, size_t start, size_t stride, size_t count,
+        std::vector<T> &values) const;
+
+public:
+    virtual ~CSV_Table();
+
+    static std::shared_ptr<CSV_Table> open(const std::string &path);
+
+    void getFieldList(std::vector<std::string> &list);
+    const std::string getFieldType(const std::string &fieldName);
+
+    size_t getRecordCount() const
+    {
+        return d_records.size();
+    }
+
+    void readColumn(unsigned int column, size_t start, size_t stride, size_t count, std::vector<std::string> &values) const;
+    void readColumn(unsigned int column, size_t start, size_t stride, size_t count, std::vector<short> &values) const;
+    void readColumn(unsigned int column, size_t start, size_t stride, size_t count, std::vector<int> &values) const;
+    void readColumn(unsigned int column, size_t start, size_t stride, size_t count, std::vector<float> &values) const;
+    void readColumn(unsigned int column, size_t start, size_t stride, size_t count, std::vector<double> &values) const;
+
+    virtual void dump(std::ostream &strm) const;
+};
+
+#endif // I_CSV_Table_h
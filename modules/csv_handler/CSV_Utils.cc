@@ -70,7 +70,7 @@ CSV_Utils::split(const string &str, char delimiter, vector<string> &tokens) {
  */
 void
 CSV_Utils::slim(string &str) {
-    if (*(--str.end()) == '\"' and *str.begin() == '\"')
+    if (!str.empty() && *(--str.end()) == '\"' and *str.begin() == '\"')
         str = str.substr(1, str.length() - 2);
 }
 
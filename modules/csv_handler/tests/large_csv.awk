@@ -0,0 +1,15 @@
+# Write a CSV file too large to distribute with the tests; see Makefile.am.
+#
+# awk -v records=<n> [-v short=<i>] -f large_csv.awk
+#
+# Record i is written with too few fields if i == short.
+
+BEGIN {
+    print "\"Station<String>\",\"latitude<Float32>\",\"longitude<Float32>\",\"temperature_K<Float32>\",\"Notes<String>\""
+    for (i = 0; i < records; i++) {
+        if (short != "" && i == short + 0)
+            printf "\"S%07d\",%.1f\n", i, (i % 180) - 89.5
+        else
+            printf "\"S%07d\",%.1f,%.2f,%.2f,\"Note %d\"\n", i, (i % 180) - 89.5, (i % 360) - 179.75, 200 + (i % 100) / 4, i
+    }
+}
@@ -0,0 +1,299 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+// Tests for CSV_Table's cache and its parallel indexing. The response
+// tests are in ../tests.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "config.h"
+
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GetOpt.h>
+
+#include <BESDebug.h>
+#include <BESSyntaxUserError.h>
+#include <TheBESKeys.h>
+
+#include "CSV_Table.h"
+#include "CSVRequestHandler.h"
+
+#include "test_config.h"
+
+using namespace CppUnit;
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+static const string small_file = string(TEST_BUILD_DIR) + "/table_test.csv";
+static const string large_file = string(TEST_BUILD_DIR) + "/table_test_large.csv";
+
+static const char *header = "\"Station<String>\",\"temperature_K<Float32>\"\n";
+
+// Write 'records' records; the temperature of record i is offset + i.
+// If 'short_record' is not -1, that record has too few fields.
+static void write_table(const string &path, int records, int offset, int short_record = -1)
+{
+    ofstream out(path.c_str());
+    out << header;
+    for (int i = 0; i < records; ++i) {
+        out << "\"S" << 1000000 + i << "\"";
+        if (i != short_record) out << "," << offset + i << ".5";
+        out << "\n";
+    }
+}
+
+static void set_mtime(const string &path, time_t mtime)
+{
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    CPPUNIT_ASSERT(utime(path.c_str(), &times) == 0);
+}
+
+static time_t get_mtime(const string &path)
+{
+    struct stat buf;
+    CPPUNIT_ASSERT(stat(path.c_str(), &buf) == 0);
+    return buf.st_mtime;
+}
+
+class CSVTableTest: public TestFixture {
+private:
+    unsigned int d_parse_threads;
+    unsigned int d_table_cache_size;
+
+    static float first_temperature(shared_ptr<CSV_Table> table)
+    {
+        vector<float> values;
+        table->readColumn(1, 0, 1, 1, values);
+        return values[0];
+    }
+
+public:
+    CSVTableTest() : d_parse_threads(0), d_table_cache_size(0)
+    {
+    }
+
+    ~CSVTableTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,csv");
+        TheBESKeys::ConfigFile = string(TEST_SRC_DIR).append("/csv_table_test.ini");
+
+        d_parse_threads = CSVRequestHandler::d_parse_threads;
+        d_table_cache_size = CSVRequestHandler::d_table_cache_size;
+
+        // Each test's file gets its own modification time; otherwise one
+        // written in the same second, and maybe with a reused inode, would
+        // match a table cached by an earlier test.
+        static time_t mtime = time(0) - 100000;
+        write_table(small_file, 10, 100);
+        set_mtime(small_file, mtime += 100);
+    }
+
+    void tearDown()
+    {
+        CSVRequestHandler::d_parse_threads = d_parse_threads;
+        CSVRequestHandler::d_table_cache_size = d_table_cache_size;
+
+        remove(small_file.c_str());
+        remove(large_file.c_str());
+    }
+
+    CPPUNIT_TEST_SUITE( CSVTableTest );
+
+    CPPUNIT_TEST(cache_hit_test);
+    CPPUNIT_TEST(cache_mtime_test);
+    CPPUNIT_TEST(cache_inode_test);
+    CPPUNIT_TEST(cache_disabled_test);
+    CPPUNIT_TEST(parallel_index_test);
+    CPPUNIT_TEST(parallel_short_record_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    void cache_hit_test()
+    {
+        shared_ptr<CSV_Table> first = CSV_Table::open(small_file);
+        shared_ptr<CSV_Table> second = CSV_Table::open(small_file);
+        CPPUNIT_ASSERT(first == second);
+        CPPUNIT_ASSERT_EQUAL((size_t) 10, second->getRecordCount());
+    }
+
+    // Same size and inode, new modification time
+    void cache_mtime_test()
+    {
+        time_t mtime = get_mtime(small_file);
+        shared_ptr<CSV_Table> first = CSV_Table::open(small_file);
+        CPPUNIT_ASSERT_EQUAL(100.5f, first_temperature(first));
+
+        write_table(small_file, 10, 200);
+        set_mtime(small_file, mtime + 10);
+
+        shared_ptr<CSV_Table> second = CSV_Table::open(small_file);
+        CPPUNIT_ASSERT(first != second);
+        CPPUNIT_ASSERT_EQUAL(200.5f, first_temperature(second));
+    }
+
+    // Same size and modification time, new inode
+    void cache_inode_test()
+    {
+        time_t mtime = get_mtime(small_file);
+        shared_ptr<CSV_Table> first = CSV_Table::open(small_file);
+
+        string replacement = small_file + ".new";
+        write_table(replacement, 10, 300);
+        set_mtime(replacement, mtime);
+        CPPUNIT_ASSERT(rename(replacement.c_str(), small_file.c_str()) == 0);
+
+        shared_ptr<CSV_Table> second = CSV_Table::open(small_file);
+        CPPUNIT_ASSERT(first != second);
+        CPPUNIT_ASSERT_EQUAL(300.5f, first_temperature(second));
+    }
+
+    void cache_disabled_test()
+    {
+        CSVRequestHandler::d_table_cache_size = 0;
+        write_table(small_file, 10, 400);   // not the file the other tests cached
+
+        shared_ptr<CSV_Table> first = CSV_Table::open(small_file);
+        shared_ptr<CSV_Table> second = CSV_Table::open(small_file);
+        CPPUNIT_ASSERT(first != second);
+    }
+
+    // A file large enough to be indexed in four segments reads the same as
+    // one indexed by a single thread, including across the segment boundaries.
+    void parallel_index_test()
+    {
+        const int records = 1000000;    // about 20MB
+        write_table(large_file, records, 0);
+
+        CSVRequestHandler::d_table_cache_size = 0;
+        CSVRequestHandler::d_parse_threads = 1;
+        shared_ptr<CSV_Table> serial = CSV_Table::open(large_file);
+        CSVRequestHandler::d_parse_threads = 4;
+        shared_ptr<CSV_Table> parallel = CSV_Table::open(large_file);
+
+        CPPUNIT_ASSERT_EQUAL((size_t) records, serial->getRecordCount());
+        CPPUNIT_ASSERT_EQUAL((size_t) records, parallel->getRecordCount());
+
+        vector<string> serial_stations, parallel_stations;
+        serial->readColumn(0, 1, 7, records / 7, serial_stations);
+        parallel->readColumn(0, 1, 7, records / 7, parallel_stations);
+        CPPUNIT_ASSERT(serial_stations == parallel_stations);
+
+        vector<float> temperatures;
+        parallel->readColumn(1, records - 3, 1, 3, temperatures);
+        CPPUNIT_ASSERT_EQUAL((float) records - 2.5f, temperatures[0]);
+        CPPUNIT_ASSERT_EQUAL((float) records - 0.5f, temperatures[2]);
+        DBG(cerr << "last station: " << parallel_stations.back() << endl);
+    }
+
+    // A short record in the last segment is reported with its line number
+    void parallel_short_record_test()
+    {
+        const int records = 1000000;
+        write_table(large_file, records, 0, records - 10);
+
+        CSVRequestHandler::d_parse_threads = 4;
+        try {
+            CSV_Table::open(large_file);
+            CPPUNIT_FAIL("Expected a BESSyntaxUserError");
+        }
+        catch (BESSyntaxUserError &e) {
+            DBG(cerr << e.get_message() << endl);
+            ostringstream line;
+            line << "line " << records - 10 + 2;
+            CPPUNIT_ASSERT(e.get_message().find(line.str()) != string::npos);
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CSVTableTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: CSVTableTest has the following tests:" << endl;
+            const std::vector<Test*> &tests = CSVTableTest::suite()->getTests();
+            unsigned int prefix_len = CSVTableTest::suite()->getName().append("::").length();
+            for (std::vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = CSVTableTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
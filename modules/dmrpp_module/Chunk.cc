@@ -27,19 +27,20 @@
 #include <cstring>
 #include <cassert>
 
-#include <zlib.h>
-
 #include <BESDebug.h>
 #include <BESLog.h>
 #include <BESInternalError.h>
 #include <BESSyntaxUserError.h>
 #include <BESForbiddenError.h>
 #include <BESContextManager.h>
+#include <BESUtil.h>
+#include <BESTrace.h>
 #include <url_impl.h>
 
 #include "xml2json/include/xml2json.hpp"
 
 #include "Chunk.h"
+#include "FilterRegistry.h"
 #include "CurlUtils.h"
 #include "CurlHandlePool.h"
 #include "EffectiveUrlCache.h"
@@ -51,6 +52,9 @@ using http::EffectiveUrlCache;
 
 #define prolog std::string("Chunk::").append(__func__).append("() - ")
 
+// chunk_write_data() logs each buffer libcurl passes to it
+static BESDebugChannel<> dmrpp_1(MODULE);
+
 namespace dmrpp {
 
 
@@ -74,9 +78,10 @@ size_t chunk_header_callback(char *buffer, size_t /*size*/, size_t nitems, void
     // -2 strips of the CRLF at the end of the header
     string header(buffer, buffer + nitems - 2);
 
-    // Look for the content type header and store its value in the Chunk
+    // Look for the content type header and store its value in the Chunk. HTTP/2
+    // servers send the header names in lower case.
     string::size_type pos;
-    if ((pos = header.find("Content-Type")) != string::npos) {
+    if ((pos = BESUtil::lowercase(header).find("content-type")) != string::npos) {
         // Header format 'Content-Type: <value>'
         auto c_ptr = reinterpret_cast<Chunk *>(data);
         c_ptr->set_response_content_type(header.substr(header.find_last_of(' ') + 1));
@@ -102,7 +107,7 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
     size_t nbytes = size * nmemb;
     auto chunk = reinterpret_cast<Chunk *>(data);
 
-    BESDEBUG(MODULE, prolog << "BEGIN chunk->get_response_content_type():" << chunk->get_response_content_type()
+    BESDEBUG(dmrpp_1, prolog << "BEGIN chunk->get_response_content_type():" << chunk->get_response_content_type()
                             << " chunk->get_data_url(): " << chunk->get_data_url() << endl);
 
     // When Content-Type is 'application/xml,' that's an error. jhrg 6/9/20
@@ -129,7 +134,7 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
                 stringstream msg;
                 msg << prolog << "ACCESS DENIED - The underlying object store has refused access to: ";
                 msg << chunk->get_data_url() << " Object Store Message: " << json_message;
-                BESDEBUG(MODULE, msg.str() << endl);
+                BESDEBUG(dmrpp_1, msg.str() << endl);
                 VERBOSE(msg.str() << endl);
                 throw BESForbiddenError(msg.str(), __FILE__, __LINE__);
             }
@@ -137,7 +142,7 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
                 stringstream msg;
                 msg << prolog << "ERROR - The underlying object store returned an error. ";
                 msg << "(Tried: " << chunk->get_data_url() << ") Object Store Message: " << json_message;
-                BESDEBUG(MODULE, msg.str() << endl);
+                BESDEBUG(dmrpp_1, msg.str() << endl);
                 VERBOSE(msg.str() << endl);
                 throw BESInternalError(msg.str(), __FILE__, __LINE__);
             }
@@ -151,7 +156,7 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
             stringstream msg;
             msg << prolog << "Caught std::exception when accessing object store data. (Tried: " << chunk->get_data_url() << ")" <<
                 " Message: " << e.what();
-            BESDEBUG(MODULE, msg.str() << endl);
+            BESDEBUG(dmrpp_1, msg.str() << endl);
             throw BESSyntaxUserError(msg.str(), __FILE__, __LINE__);
         }
     }
@@ -167,7 +172,7 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
         stringstream msg;
         msg << prolog << "ERROR! The number of bytes_read: " << bytes_read << " plus the number of bytes to read: "
             << nbytes << " is larger than the target buffer size: " << chunk->get_rbuf_size();
-        BESDEBUG(MODULE, msg.str() << endl);
+        BESDEBUG(dmrpp_1, msg.str() << endl);
         DmrppRequestHandler::curl_handle_pool->release_all_handles();
         throw BESInternalError(msg.str(), __FILE__, __LINE__);
     }
@@ -175,185 +180,11 @@ size_t chunk_write_data(void *buffer, size_t size, size_t nmemb, void *data) {
     memcpy(chunk->get_rbuf() + bytes_read, buffer, nbytes);
     chunk->set_bytes_read(bytes_read + nbytes);
 
-    BESDEBUG(MODULE, prolog << "END" << endl);
+    BESDEBUG(dmrpp_1, prolog << "END" << endl);
 
     return nbytes;
 }
 
-/**
- * @brief Deflate data. This is the zlib algorithm.
- *
- * @note Stolen from the HDF5 library and hacked to fit.
- *
- * @param dest Write the 'inflated' data here
- * @param dest_len Size of the destination buffer
- * @param src Compressed data
- * @param src_len Size of the compressed data
- */
-void inflate(char *dest, unsigned long long dest_len, char *src, unsigned long long src_len) {
-    /* Sanity check */
-    assert(src_len > 0);
-    assert(src);
-    assert(dest_len > 0);
-    assert(dest);
-
-    /* Input; uncompress */
-    z_stream z_strm; /* zlib parameters */
-
-    /* Set the uncompression parameters */
-    memset(&z_strm, 0, sizeof(z_strm));
-    z_strm.next_in = (Bytef *) src;
-    z_strm.avail_in = src_len;
-    z_strm.next_out = (Bytef *) dest;
-    z_strm.avail_out = dest_len;
-
-    /* Initialize the uncompression routines */
-    if (Z_OK != inflateInit(&z_strm))
-        throw BESError("Failed to initialize inflate software.", BES_INTERNAL_ERROR, __FILE__, __LINE__);
-
-    /* Loop to uncompress the buffer */
-    int status = Z_OK;
-    do {
-        /* Uncompress some data */
-        status = inflate(&z_strm, Z_SYNC_FLUSH);
-
-        /* Check if we are done uncompressing data */
-        if (Z_STREAM_END == status) break; /*done*/
-
-        /* Check for error */
-        if (Z_OK != status) {
-            (void) inflateEnd(&z_strm);
-            throw BESError("Failed to inflate data chunk.", BES_INTERNAL_ERROR, __FILE__, __LINE__);
-        }
-        else {
-            /* If we're not done and just ran out of buffer space, it's an error.
-             * The HDF5 library code would extend the buffer as needed, but for
-             * this handler, we always know the size of the uncompressed chunk.
-             */
-            if (0 == z_strm.avail_out) {
-                throw BESError("Data buffer is not big enough for uncompressed data.", BES_INTERNAL_ERROR, __FILE__,
-                               __LINE__);
-#if 0
-                /* Here's how to extend the buffer if needed. This might be useful some day... */
-                void *new_outbuf; /* Pointer to new output buffer */
-
-                /* Allocate a buffer twice as big */
-                nalloc *= 2;
-                if (NULL == (new_outbuf = H5MM_realloc(outbuf, nalloc))) {
-                    (void) inflateEnd(&z_strm);
-                    HGOTO_ERROR(H5E_RESOURCE, H5E_NOSPACE, 0, "memory allocation failed for inflate decompression")
-                } /* end if */
-                outbuf = new_outbuf;
-
-                /* Update pointers to buffer for next set of uncompressed data */
-                z_strm.next_out = (unsigned char*) outbuf + z_strm.total_out;
-                z_strm.avail_out = (uInt) (nalloc - z_strm.total_out);
-#endif
-            } /* end if */
-        } /* end else */
-    } while (status == Z_OK);
-
-    /* Finish uncompressing the stream */
-    (void) inflateEnd(&z_strm);
-
-
-}
-
-// #define this to enable the duff's device loop unrolling code.
-// jhrg 1/19/17
-#define DUFFS_DEVICE
-
-/**
- * @brief Un-shuffle data.
- *
- * @note Stolen from HDF5 and hacked to fit
- *
- * @note We use src size as a param because the buffer might be larger than
- * elems * width (e.g., 1020 byte buffer will hold 127 doubles with 4 extra).
- * If we used elems * width, the the buffer size will be too small for those
- * extra bytes. Code at the end of this function will transfer them.
- *
- * @note Do not call this when the number of elements or the element width
- * is 1. In the HDF5 library chunks that fit that description are never shuffled
- * (because there really is nothing to shuffle). The function will handle that
- * case, but by not calling it you can save the allocation of a buffer and a
- * call to memcpy.
- *
- * @param dest Put the result here.
- * @param src Shuffled data source
- * @param src_size Number of bytes in both src and dest
- * @param width Number of bytes in an element
- */
-void unshuffle(char *dest, const char *src, unsigned long long src_size, unsigned long long width) {
-    unsigned long long elems = src_size / width;  // int division rounds down
-
-    /* Don't do anything for 1-byte elements, or "fractional" elements */
-    if (!(width > 1 && elems > 1)) {
-        memcpy(dest, const_cast<char *>(src), src_size);
-    }
-    else {
-        /* Get the pointer to the source buffer (Alias for source buffer) */
-        char *_src = const_cast<char *>(src);
-        char *_dest = 0;   // Alias for destination buffer
-
-        /* Input; unshuffle */
-        for (unsigned int i = 0; i < width; i++) {
-            _dest = dest + i;
-#ifndef DUFFS_DEVICE
-            size_t j = elems;
-            while(j > 0) {
-                *_dest = *_src++;
-                _dest += width;
-
-                j--;
-            }
-#else /* DUFFS_DEVICE */
-            {
-                size_t duffs_index = (elems + 7) / 8;   /* Counting index for Duff's device */
-                switch (elems % 8) {
-                    default:
-                        assert(0 && "This Should never be executed!");
-                        break;
-                    case 0:
-                        do {
-                            // This macro saves repeating the same line 8 times
-#define DUFF_GUTS       *_dest = *_src++; _dest += width;
-
-                            DUFF_GUTS
-                            case 7:
-                            DUFF_GUTS
-                            case 6:
-                            DUFF_GUTS
-                            case 5:
-                            DUFF_GUTS
-                            case 4:
-                            DUFF_GUTS
-                            case 3:
-                            DUFF_GUTS
-                            case 2:
-                            DUFF_GUTS
-                            case 1:
-                            DUFF_GUTS
-                        } while (--duffs_index > 0);
-                } /* end switch */
-            } /* end block */
-#endif /* DUFFS_DEVICE */
-
-        } /* end for i = 0 to width*/
-
-        /* Compute the leftover bytes if there are any */
-        size_t leftover = src_size % width;
-
-        /* Add leftover to the end of data */
-        if (leftover > 0) {
-            /* Adjust back to end of shuffled bytes */
-            _dest -= (width - 1); /*lint !e794 _dest is initialized */
-            memcpy((void *) _dest, (void *) _src, leftover);
-        }
-    } /* end if width and elems both > 1 */
-}
-
-
 void Chunk::parse_chunk_position_in_array_string(const string &pia, vector<unsigned long long> &cpia_vect){
     if (pia.empty()) return;
 
@@ -527,56 +358,75 @@ void *inflate_chunk(void *arg_list)
  * @param shuffle True if the chunk should be 'unshuffled'
  * @param chunk_size The _expected_ chunk size, in elements; used to allocate storage
  * @param elem_width The number of bytes per element
+ * @see filter_chunk()
  */
 void Chunk::inflate_chunk(bool deflate, bool shuffle, unsigned long long chunk_size, unsigned long long elem_width) {
-    // This code is pretty naive - there are apparently a number of
-    // different ways HDF5 can compress data, and it does also use a scheme
-    // where several algorithms can be applied in sequence. For now, get
-    // simple zlib deflate working.jhrg 1/15/17
-    // Added support for shuffle. Assuming unshuffle always is applied _after_
-    // inflating the data (reversing the shuffle --> deflate process). It is
-    // possible that data could just be deflated or shuffled (because we
-    // have test data are use only shuffle). jhrg 1/20/17
-    // The file that implements the deflate filter is H5Zdeflate.c in the hdf5 source.
-    // The file that implements the shuffle filter is H5Zshuffle.c.
+    vector<unsigned int> filters;
+    if (deflate)
+        filters.push_back(FILTER_DEFLATE);
+    if (shuffle)
+        filters.push_back(FILTER_SHUFFLE);
+
+    filter_chunk(filters, chunk_size, elem_width);
+}
+
+/**
+ * @brief Decode the data in the chunk, managing the Chunk's data buffers
+ *
+ * This method tracks if a chunk has already been decoded, so, like read_chunk()
+ * it can be called for a chunk that has already been decoded without error.
+ *
+ * The filters are run by the FilterRegistry, which decodes the chunk straight
+ * into its new read buffer; there is one allocation per chunk no matter how
+ * many filters there are. If the chunk has a destination (set_destination())
+ * there are none: the chunk is decoded into its place in the Array.
+ *
+ * @param filters The HDF5 ids of the filters used to encode the chunk. If empty,
+ * the chunk is left as it is, or copied to its destination.
+ * @param chunk_size The _expected_ chunk size, in elements; used to allocate storage
+ * @param elem_width The number of bytes per element
+ * @param integer_type True if the elements are integers. Only some filters care.
+ */
+void Chunk::filter_chunk(const vector<unsigned int> &filters, unsigned long long chunk_size,
+                         unsigned long long elem_width, bool integer_type) {
+    // HDF5 can apply several filters to a chunk, in sequence. The files that
+    // implement the HDF5 filters are H5Z*.c in the hdf5 source; see FilterRegistry
+    // for the ones we support and the order they are undone in.
 
     if (d_is_inflated)
         return;
 
     chunk_size *= elem_width;
 
-    if (deflate) {
-        char *dest = new char[chunk_size];
-        try {
-            inflate(dest, chunk_size, get_rbuf(), get_rbuf_size());
-            // This replaces (and deletes) the original read_buffer with dest.
-#if DMRPP_USE_SUPER_CHUNKS
-            set_read_buffer(dest, chunk_size, chunk_size, true);
-#else
-            set_rbuf(dest, chunk_size);
-#endif
-        }
-        catch (...) {
-            delete[] dest;
-            throw;
+    if (filters.empty()) {
+        // Values that were not read straight into their place in the Array get copied there.
+        if (d_destination && get_rbuf() != d_destination) {
+            if (get_bytes_read() > chunk_size)
+                throw BESInternalError(prolog + "The chunk is larger than its place in the array.", __FILE__, __LINE__);
+            memcpy(d_destination, get_rbuf(), get_bytes_read());
+            set_read_buffer(d_destination, chunk_size, get_bytes_read(), false);
         }
+        d_is_inflated = true;
+        return;
     }
 
-    if (shuffle) {
-        // The internal buffer is chunk's full size at this point.
-        char *dest = new char[get_rbuf_size()];
-        try {
-            unshuffle(dest, get_rbuf(), get_rbuf_size(), elem_width);
+    char *dest = d_destination ? d_destination : new char[chunk_size];
+    try {
+        filter_args args(elem_width, integer_type, d_byte_order == "BE");
+        unsigned long long bytes = FilterRegistry::TheRegistry()->decode(filters, get_rbuf(), get_rbuf_size(),
+                                                                         dest, chunk_size, args);
+        // This replaces (and deletes) the original read_buffer with dest. The chunk
+        // only owns dest if it's not the chunk's part of the Array.
 #if DMRPP_USE_SUPER_CHUNKS
-            set_read_buffer(dest,get_rbuf_size(),get_rbuf_size(), true);
+        set_read_buffer(dest, chunk_size, bytes, !d_destination);
 #else
-            set_rbuf(dest, get_rbuf_size());
+        set_rbuf(dest, chunk_size);
 #endif
-        }
-        catch (...) {
+    }
+    catch (...) {
+        if (!d_destination)
             delete[] dest;
-            throw;
-        }
+        throw;
     }
 
     d_is_inflated = true;
@@ -606,10 +456,15 @@ void Chunk::inflate_chunk(bool deflate, bool shuffle, unsigned long long chunk_s
  */
 void Chunk::read_chunk() {
     if (d_is_read) {
-        BESDEBUG(MODULE, prolog << "Already been read! Returning." << endl);
+        BESDEBUG(dmrpp_1, prolog << "Already been read! Returning." << endl);
         return;
     }
 
+    BESTraceSpan span("Chunk::read_chunk");
+    span.set_attribute("chunk.offset", get_offset());
+    span.set_attribute("bytes", get_size());
+    span.set_url_attribute(get_data_url());
+
     set_rbuf_to_size();
 
     dmrpp_easy_handle *handle = DmrppRequestHandler::curl_handle_pool->get_easy_handle(this);
@@ -670,7 +525,7 @@ string Chunk::to_string() const {
 std::string Chunk::get_data_url() const {
 
     string data_url = EffectiveUrlCache::TheCache()->get_effective_url(d_data_url);
-    BESDEBUG(MODULE, prolog << "Using data_url: " << data_url << endl);
+    BESDEBUG(dmrpp_1, prolog << "Using data_url: " << data_url << endl);
 
     // A conditional call to void Chunk::add_tracking_query_param()
     // here for the NASA cost model work THG's doing. jhrg 8/7/18
@@ -85,11 +85,16 @@ private:
     bool d_is_inflated;
     std::string d_response_content_type;
 
+    // If not null, filter_chunk() decodes the chunk here, the chunk's place in
+    // the Array's buffer, and not into memory of its own. Not owned.
+    char *d_destination;
+
     // static const std::string tracking_context;
 
     friend class ChunkTest;
     friend class DmrppCommonTest;
     friend class MockChunk;
+    friend class ChunkTable;
 
 protected:
 
@@ -102,6 +107,7 @@ protected:
         d_read_buffer_size = 0;
         d_is_read = false;
         d_is_inflated = false;
+        d_destination = nullptr;
 
         d_size = bs.d_size;
         d_offset = bs.d_offset;
@@ -125,7 +131,7 @@ public:
     Chunk() :
         d_data_url(""), d_query_marker(""), d_byte_order(""), d_size(0), d_offset(0),
         d_read_buffer_is_mine(true), d_bytes_read(0), d_read_buffer(nullptr),
-        d_read_buffer_size(0), d_is_read(false), d_is_inflated(false)
+        d_read_buffer_size(0), d_is_read(false), d_is_inflated(false), d_destination(nullptr)
     {
     }
 
@@ -144,7 +150,7 @@ public:
             d_data_url(std::move(data_url)), d_query_marker(""),
             d_byte_order(std::move(order)), d_size(size), d_offset(offset),
             d_read_buffer_is_mine(true), d_bytes_read(0), d_read_buffer(nullptr),
-            d_read_buffer_size(0), d_is_read(false), d_is_inflated(false)
+            d_read_buffer_size(0), d_is_read(false), d_is_inflated(false), d_destination(nullptr)
     {
         add_tracking_query_param();
         set_position_in_array(pia_str);
@@ -164,7 +170,7 @@ public:
             unsigned long long offset, const std::vector<unsigned long long> &pia_vec) :
             d_data_url(std::move(data_url)), d_query_marker(""), d_byte_order(std::move(order)), d_size(size), d_offset(offset),
             d_read_buffer_is_mine(true), d_bytes_read(0), d_read_buffer(nullptr),
-            d_read_buffer_size(0), d_is_read(false), d_is_inflated(false)
+            d_read_buffer_size(0), d_is_read(false), d_is_inflated(false), d_destination(nullptr)
     {
         add_tracking_query_param();
         set_position_in_array(pia_vec);
@@ -362,6 +368,22 @@ public:
 
     virtual void inflate_chunk(bool deflate, bool shuffle, unsigned long long chunk_size, unsigned long long elem_width);
 
+    virtual void filter_chunk(const std::vector<unsigned int> &filters, unsigned long long chunk_size,
+                              unsigned long long elem_width, bool integer_type = false);
+
+    /**
+     * @brief Decode this chunk straight into its place in the Array.
+     *
+     * Only use this if the decoded chunk is one run of values in the Array's
+     * buffer and all of it fits there. Once filter_chunk() has run, the
+     * values are in place and the read buffer is \arg dest.
+     *
+     * @param dest Where the chunk's first value goes, or null to decode the
+     * chunk into a buffer of its own.
+     */
+    virtual void set_destination(char *dest) { d_destination = dest; }
+    virtual char *get_destination() const { return d_destination; }
+
     virtual bool get_is_read() { return d_is_read; }
     virtual void set_is_read(bool state) { d_is_read = state; }
 
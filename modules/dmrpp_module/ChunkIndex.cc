@@ -0,0 +1,339 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <BESInternalError.h>
+#include <BESDebug.h>
+
+#include "Chunk.h"
+#include "ChunkIndex.h"
+#include "DmrppNames.h"
+
+using namespace std;
+
+#define prolog std::string("ChunkIndex::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+const uint32_t ChunkIndex::empty;
+const uint64_t ChunkIndex::node_size;
+const uint64_t ChunkIndex::cache_bytes;
+
+/**
+ * @brief Build the index
+ * @param chunks The array's chunks; the index refers to them by their
+ * position in this vector.
+ * @param chunk_shape The size of a chunk in each dimension
+ * @param array_shape The size of the array in each dimension
+ * @exception BESInternalError if a chunk's position does not have a value
+ * for each of the array's dimensions.
+ */
+ChunkIndex::ChunkIndex(const vector<shared_ptr<Chunk>> &chunks, const vector<unsigned long long> &chunk_shape,
+    const vector<unsigned long long> &array_shape) :
+    d_rank(chunk_shape.size()), d_count(chunks.size()), d_regular(false)
+{
+    // A zero-size dimension would make last() wrap around.
+    for (auto size: chunk_shape)
+        d_chunk_shape.push_back(size ? size : 1);
+
+    d_positions.resize(d_rank * d_count);
+    for (uint64_t i = 0; i < d_count; ++i) {
+        const vector<unsigned long long> &pia = chunks[i]->get_position_in_array();
+        if (pia.size() != d_rank)
+            throw BESInternalError(prolog + "A chunk's position does not match the array's rank.", __FILE__,
+                __LINE__);
+        for (unsigned int dim = 0; dim < d_rank; ++dim)
+            d_positions[dim * d_count + i] = pia[dim];
+    }
+
+    d_regular = build_grid(vector<uint64_t>(array_shape.begin(), array_shape.end()));
+    if (!d_regular)
+        build_tree();
+
+    BESDEBUG(MODULE, prolog << "Indexed " << d_count << " chunks using a "
+        << (d_regular ? "regular grid." : "packed R-tree.") << endl);
+}
+
+/**
+ * @brief Build the grid, if the chunks lie on one
+ * @return False if they do not, or if the grid would have many more cells
+ * than there are chunks.
+ */
+bool ChunkIndex::build_grid(const vector<uint64_t> &array_shape)
+{
+    if (d_rank == 0 || array_shape.size() != d_rank || d_count >= empty)
+        return false;
+
+    // Allow for unwritten chunks, but not a grid that's mostly empty.
+    const uint64_t max_cells = max<uint64_t>(4 * d_count, 65536);
+
+    uint64_t cells = 1;
+    d_grid_shape.clear();
+    for (unsigned int dim = 0; dim < d_rank; ++dim) {
+        uint64_t n = (array_shape[dim] + d_chunk_shape[dim] - 1) / d_chunk_shape[dim];
+        if (n == 0 || n > max_cells / cells)
+            return false;
+        cells *= n;
+        d_grid_shape.push_back(n);
+    }
+
+    d_grid.assign(cells, empty);
+    for (uint64_t i = 0; i < d_count; ++i) {
+        uint64_t cell = 0;
+        for (unsigned int dim = 0; dim < d_rank; ++dim) {
+            uint64_t p = position(i, dim);
+            if (p % d_chunk_shape[dim] || p / d_chunk_shape[dim] >= d_grid_shape[dim])
+                return false;
+            cell = cell * d_grid_shape[dim] + p / d_chunk_shape[dim];
+        }
+
+        if (d_grid[cell] != empty)
+            return false;   // Two chunks at one position
+        d_grid[cell] = i;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Build the packed R-tree
+ *
+ * The chunks are sorted by position so that each node holds chunks that are
+ * near one another, then grouped node_size at a time, level by level, until
+ * one node covers them all.
+ */
+void ChunkIndex::build_tree()
+{
+    d_grid.clear();
+    d_grid_shape.clear();
+
+    d_order.resize(d_count);
+    for (uint64_t i = 0; i < d_count; ++i)
+        d_order[i] = i;
+    sort(d_order.begin(), d_order.end(), [this](uint64_t a, uint64_t b) {
+        for (unsigned int dim = 0; dim < d_rank; ++dim) {
+            if (position(a, dim) != position(b, dim))
+                return position(a, dim) < position(b, dim);
+        }
+        return a < b;
+    });
+
+    d_levels.clear();
+    uint64_t entries = d_count;
+    do {
+        Level level;
+        level.size = (entries + node_size - 1) / node_size;
+        level.lo.assign(d_rank * level.size, UINT64_MAX);
+        level.hi.assign(d_rank * level.size, 0);
+
+        for (uint64_t e = 0; e < entries; ++e) {
+            uint64_t node = e / node_size;
+            for (unsigned int dim = 0; dim < d_rank; ++dim) {
+                uint64_t lo, hi;
+                if (d_levels.empty()) {
+                    lo = position(d_order[e], dim);
+                    hi = last(d_order[e], dim);
+                }
+                else {
+                    const Level &below = d_levels.back();
+                    lo = below.lo[dim * below.size + e];
+                    hi = below.hi[dim * below.size + e];
+                }
+                uint64_t &node_lo = level.lo[dim * level.size + node];
+                uint64_t &node_hi = level.hi[dim * level.size + node];
+                node_lo = min(node_lo, lo);
+                node_hi = max(node_hi, hi);
+            }
+        }
+
+        entries = level.size;
+        d_levels.push_back(move(level));
+    } while (entries > 1);
+}
+
+void ChunkIndex::find_in_grid(const vector<pair<uint64_t, uint64_t>> &ranges, vector<uint64_t> &chunks) const
+{
+    vector<uint64_t> first(d_rank), stop(d_rank);
+    for (unsigned int dim = 0; dim < d_rank; ++dim) {
+        if (ranges[dim].first > ranges[dim].second || ranges[dim].first / d_chunk_shape[dim] >= d_grid_shape[dim])
+            return;
+        first[dim] = ranges[dim].first / d_chunk_shape[dim];
+        stop[dim] = min(ranges[dim].second / d_chunk_shape[dim], d_grid_shape[dim] - 1);
+    }
+
+    // Step through the cells in the subset like an odometer.
+    vector<uint64_t> cell = first;
+    while (true) {
+        uint64_t index = 0;
+        for (unsigned int dim = 0; dim < d_rank; ++dim)
+            index = index * d_grid_shape[dim] + cell[dim];
+        if (d_grid[index] != empty)
+            chunks.push_back(d_grid[index]);
+
+        int dim = d_rank - 1;
+        while (dim >= 0 && cell[dim] == stop[dim]) {
+            cell[dim] = first[dim];
+            --dim;
+        }
+        if (dim < 0)
+            break;
+        ++cell[dim];
+    }
+}
+
+void ChunkIndex::find_in_tree(unsigned int level, uint64_t node, const vector<pair<uint64_t, uint64_t>> &ranges,
+    vector<uint64_t> &chunks) const
+{
+    const Level &l = d_levels[level];
+    for (unsigned int dim = 0; dim < d_rank; ++dim) {
+        if (l.lo[dim * l.size + node] > ranges[dim].second || l.hi[dim * l.size + node] < ranges[dim].first)
+            return;
+    }
+
+    if (level == 0) {
+        uint64_t end = min((node + 1) * node_size, d_count);
+        for (uint64_t e = node * node_size; e < end; ++e) {
+            uint64_t chunk = d_order[e];
+            bool intersects = true;
+            for (unsigned int dim = 0; dim < d_rank && intersects; ++dim)
+                intersects = position(chunk, dim) <= ranges[dim].second && last(chunk, dim) >= ranges[dim].first;
+            if (intersects)
+                chunks.push_back(chunk);
+        }
+    }
+    else {
+        uint64_t end = min((node + 1) * node_size, d_levels[level - 1].size);
+        for (uint64_t child = node * node_size; child < end; ++child)
+            find_in_tree(level - 1, child, ranges, chunks);
+    }
+}
+
+/**
+ * @brief Find the chunks that hold any of the elements in a subset
+ *
+ * @param ranges The first and last element of the subset in each dimension
+ * @param chunks Value-result parameter; the numbers of the chunks that
+ * intersect the subset, in increasing order. Any values already in the
+ * vector are removed.
+ * @exception BESInternalError if \arg ranges does not have a range for each
+ * dimension.
+ */
+void ChunkIndex::find(const vector<pair<uint64_t, uint64_t>> &ranges, vector<uint64_t> &chunks) const
+{
+    if (ranges.size() != d_rank)
+        throw BESInternalError(prolog + "The subset does not match the array's rank.", __FILE__, __LINE__);
+
+    chunks.clear();
+    if (d_count == 0)
+        return;
+
+    if (d_regular)
+        find_in_grid(ranges, chunks);
+    else
+        find_in_tree(d_levels.size() - 1, 0, ranges, chunks);
+
+    // Read the chunks in the order they appear in the DMR++, which is
+    // usually their order in the file.
+    sort(chunks.begin(), chunks.end());
+}
+
+/// @brief About how much memory the index uses
+uint64_t ChunkIndex::bytes() const
+{
+    uint64_t bytes = sizeof(ChunkIndex) + (d_positions.size() + d_order.size()) * sizeof(uint64_t)
+        + d_grid.size() * sizeof(uint32_t);
+    for (const auto &level: d_levels)
+        bytes += (level.lo.size() + level.hi.size()) * sizeof(uint64_t);
+
+    return bytes;
+}
+
+// The indexes kept by find_or_make(), most recently used first
+static std::mutex index_cache_mtx;
+static list<pair<string, shared_ptr<const ChunkIndex>>> index_cache;
+static unordered_map<string, list<pair<string, shared_ptr<const ChunkIndex>>>::iterator> index_cache_keys;
+static uint64_t index_cache_bytes = 0;
+
+/**
+ * @brief The index of a chunk table that was read from a file
+ *
+ * Each request reads the DMR++ again, so a DmrppArray's own index would be
+ * built for every request. This keeps the indexes of the chunk tables read
+ * from binary DMR++ files, up to cache_bytes of them, and drops the least
+ * recently used ones first.
+ *
+ * @param key The chunk table's key (ChunkTable::get_key()). The same key
+ * must always name the same chunks, chunk shape and array shape.
+ * @param chunks The array's chunks, made from the chunk table
+ * @param chunk_shape The size of a chunk in each dimension
+ * @param array_shape The size of the array in each dimension
+ * @return The index
+ */
+shared_ptr<const ChunkIndex> ChunkIndex::find_or_make(const string &key, const vector<shared_ptr<Chunk>> &chunks,
+    const vector<unsigned long long> &chunk_shape, const vector<unsigned long long> &array_shape)
+{
+    {
+        std::lock_guard<std::mutex> lock(index_cache_mtx);
+        auto it = index_cache_keys.find(key);
+        if (it != index_cache_keys.end() && it->second->second->size() == chunks.size()) {
+            index_cache.splice(index_cache.begin(), index_cache, it->second);
+            BESDEBUG(MODULE, prolog << "Found the index of " << key << endl);
+            return it->second->second;
+        }
+    }
+
+    // Build it without the lock; two threads may both build it, which is harmless
+    shared_ptr<const ChunkIndex> index = make_shared<ChunkIndex>(chunks, chunk_shape, array_shape);
+    uint64_t bytes = index->bytes();
+    if (bytes > cache_bytes)
+        return index;
+
+    std::lock_guard<std::mutex> lock(index_cache_mtx);
+    auto it = index_cache_keys.find(key);
+    if (it != index_cache_keys.end()) {
+        index_cache_bytes -= it->second->second->bytes();
+        index_cache.erase(it->second);
+        index_cache_keys.erase(it);
+    }
+
+    index_cache.emplace_front(key, index);
+    index_cache_keys[key] = index_cache.begin();
+    index_cache_bytes += bytes;
+
+    while (index_cache_bytes > cache_bytes) {
+        index_cache_bytes -= index_cache.back().second->bytes();
+        index_cache_keys.erase(index_cache.back().first);
+        index_cache.pop_back();
+    }
+
+    return index;
+}
+
+} // namespace dmrpp
@@ -0,0 +1,131 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _ChunkIndex_h
+#define _ChunkIndex_h 1
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace dmrpp {
+
+class Chunk;
+
+/**
+ * @brief Find the chunks of an array that intersect a subset
+ *
+ * DmrppArray uses this to find the chunks it must read for a constrained
+ * request without looking at every one of the array's chunks.
+ *
+ * When the chunks lie on a regular grid - each chunk's position is a
+ * multiple of the chunk shape, which is how HDF5 and netCDF-4 store them -
+ * the index is an array with a cell for each grid position that holds the
+ * number of the chunk there. The chunks in a subset are found by computing
+ * the range of grid cells it covers, so a search costs time in proportion
+ * to the number of chunks in the subset and not the number in the array.
+ * Grid positions with no chunk (e.g., unwritten HDF5 chunks) are allowed.
+ *
+ * Other layouts use a packed R-tree built over the chunks' bounding boxes.
+ *
+ * Building the index reads every chunk's position, so it costs as much as
+ * one pass over the chunks. It saves time when the index is searched more
+ * than once or when the chunks come from a binary DMR++: find_or_make()
+ * keeps the indexes of chunk tables read from files, so the index of a
+ * variable in a binary DMR++ is built once per process, not once per
+ * request.
+ *
+ * The chunk positions are stored one dimension after another (all of the
+ * chunks' positions in the first dimension, then the second, ...), so
+ * searching the index does not touch the Chunk objects.
+ */
+class ChunkIndex {
+private:
+    unsigned int d_rank;
+    uint64_t d_count;
+    std::vector<uint64_t> d_chunk_shape;
+
+    // d_positions[dim * d_count + i] is chunk i's position in dimension 'dim'
+    std::vector<uint64_t> d_positions;
+
+    // The regular grid; d_grid holds chunk numbers or 'empty'
+    bool d_regular;
+    std::vector<uint64_t> d_grid_shape;
+    std::vector<uint32_t> d_grid;
+
+    // The packed R-tree. d_order holds the chunk numbers sorted by position;
+    // level 0 nodes each cover node_size consecutive entries of d_order, and
+    // the nodes of level n + 1 each cover node_size nodes of level n. The
+    // bounding boxes are stored like d_positions, one dimension after another.
+    struct Level {
+        uint64_t size;
+        std::vector<uint64_t> lo;
+        std::vector<uint64_t> hi;
+    };
+    std::vector<uint64_t> d_order;
+    std::vector<Level> d_levels;
+
+    static const uint32_t empty = UINT32_MAX;
+    static const uint64_t node_size = 16;
+
+    uint64_t position(uint64_t chunk, unsigned int dim) const { return d_positions[dim * d_count + chunk]; }
+    uint64_t last(uint64_t chunk, unsigned int dim) const { return position(chunk, dim) + d_chunk_shape[dim] - 1; }
+
+    bool build_grid(const std::vector<uint64_t> &array_shape);
+    void build_tree();
+
+    void find_in_grid(const std::vector<std::pair<uint64_t, uint64_t>> &ranges, std::vector<uint64_t> &chunks) const;
+    void find_in_tree(unsigned int level, uint64_t node, const std::vector<std::pair<uint64_t, uint64_t>> &ranges,
+        std::vector<uint64_t> &chunks) const;
+
+    friend class ChunkIndexTest;
+
+public:
+    ChunkIndex(const std::vector<std::shared_ptr<Chunk>> &chunks, const std::vector<unsigned long long> &chunk_shape,
+        const std::vector<unsigned long long> &array_shape);
+
+    virtual ~ChunkIndex() = default;
+
+    /// @brief The number of chunks indexed
+    uint64_t size() const { return d_count; }
+
+    /// @brief True if the chunks lie on a regular grid
+    bool is_regular() const { return d_regular; }
+
+    uint64_t bytes() const;
+
+    void find(const std::vector<std::pair<uint64_t, uint64_t>> &ranges, std::vector<uint64_t> &chunks) const;
+
+    /// The most memory the indexes kept by find_or_make() use
+    static const uint64_t cache_bytes = 64 * 1024 * 1024;
+
+    static std::shared_ptr<const ChunkIndex> find_or_make(const std::string &key,
+        const std::vector<std::shared_ptr<Chunk>> &chunks, const std::vector<unsigned long long> &chunk_shape,
+        const std::vector<unsigned long long> &array_shape);
+};
+
+} // namespace dmrpp
+
+#endif // _ChunkIndex_h
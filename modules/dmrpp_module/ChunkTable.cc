@@ -0,0 +1,356 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <BESInternalError.h>
+
+#include "Chunk.h"
+#include "ChunkTable.h"
+
+using namespace std;
+
+namespace dmrpp {
+
+namespace {
+
+const char zeros[8] = { 0 };
+
+// Pad to the next 8-byte boundary so the arrays that follow are aligned
+void write_padding(ostream &os, uint64_t written)
+{
+    if (written % 8) os.write(zeros, 8 - written % 8);
+}
+
+template<typename T> void write_value(ostream &os, T value)
+{
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/**
+ * The layout of a chunk table; all values are in the host's byte order and
+ * the table starts on an 8-byte boundary.
+ *
+ *   uint64_t count, uint32_t rank, uint32_t number of hrefs,
+ *   uint32_t length of the byte order, uint32_t zero,
+ *   the byte order, each href as a uint32_t length and the characters,
+ *   padding to an 8-byte boundary,
+ *   uint64_t offsets[count], uint64_t sizes[count], uint64_t positions[count * rank],
+ *   uint32_t href indexes[count] (only when there is more than one href),
+ *   padding to an 8-byte boundary.
+ */
+void write_table(ostream &os, const string &byte_order, const vector<string> &hrefs, uint64_t count, uint32_t rank,
+    const uint64_t *offsets, const uint64_t *sizes, const uint64_t *positions, const uint32_t *href_index)
+{
+    uint64_t written = 0;
+
+    write_value<uint64_t>(os, count);
+    write_value<uint32_t>(os, rank);
+    write_value<uint32_t>(os, hrefs.size());
+    write_value<uint32_t>(os, byte_order.size());
+    write_value<uint32_t>(os, 0);
+    written += 24;
+
+    os.write(byte_order.data(), byte_order.size());
+    written += byte_order.size();
+    for (const auto &href: hrefs) {
+        write_value<uint32_t>(os, href.size());
+        os.write(href.data(), href.size());
+        written += 4 + href.size();
+    }
+    write_padding(os, written);
+
+    os.write(reinterpret_cast<const char *>(offsets), count * sizeof(uint64_t));
+    os.write(reinterpret_cast<const char *>(sizes), count * sizeof(uint64_t));
+    os.write(reinterpret_cast<const char *>(positions), count * rank * sizeof(uint64_t));
+    if (hrefs.size() > 1) {
+        os.write(reinterpret_cast<const char *>(href_index), count * sizeof(uint32_t));
+        write_padding(os, count * sizeof(uint32_t));
+    }
+}
+
+// Check that 'n' more bytes can be read
+void need(const char *pos, const char *end, uint64_t n)
+{
+    if (pos > end || (uint64_t) (end - pos) < n)
+        throw BESInternalError("The binary DMR++ chunk table is truncated.", __FILE__, __LINE__);
+}
+
+template<typename T> T read_value(const char *&pos, const char *end)
+{
+    need(pos, end, sizeof(T));
+    T value;
+    memcpy(&value, pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+string read_string(const char *&pos, const char *end, uint64_t length)
+{
+    need(pos, end, length);
+    string s(pos, length);
+    pos += length;
+    return s;
+}
+
+void skip_padding(const char *&pos, const char *start)
+{
+    uint64_t used = pos - start;
+    if (used % 8) pos += 8 - used % 8;
+}
+
+} // namespace
+
+/**
+ * @brief Set the URLs the chunks are read from
+ * @param resolve Called with each distinct href in the table, returns the
+ * URL to use for it.
+ */
+void ChunkTable::resolve_urls(const function<string(const string &)> &resolve)
+{
+    d_urls.clear();
+    for (const auto &href: d_hrefs)
+        d_urls.push_back(resolve(href));
+}
+
+/**
+ * @brief Make a Chunk for each entry in the table
+ * @param chunks Append the Chunks to this vector
+ */
+void ChunkTable::make_chunks(vector<shared_ptr<Chunk>> &chunks) const
+{
+    chunks.reserve(chunks.size() + d_count);
+
+    vector<unsigned long long> position(d_rank);
+    for (uint64_t i = 0; i < d_count; ++i) {
+        const uint64_t *p = get_position(i);
+        position.assign(p, p + d_rank);
+        chunks.push_back(make_shared<Chunk>(get_url(i), d_byte_order, d_sizes[i], d_offsets[i], position));
+    }
+}
+
+/**
+ * @brief Write the table
+ * The stream must be at an 8-byte boundary (counting from the start of the
+ * binary DMR++); it is left at one.
+ */
+void ChunkTable::write(ostream &os) const
+{
+    write_table(os, d_byte_order, d_hrefs, d_count, d_rank, d_offsets, d_sizes, d_positions, d_href_index);
+}
+
+/**
+ * @brief Read a table written by write()
+ *
+ * The table's arrays are not copied; they point into \arg storage.
+ *
+ * @param storage The memory holding the table
+ * @param pos The start of the table, which must be 8-byte aligned. Set to
+ * the byte following the table.
+ * @param end The end of the memory holding the table
+ * @return The table; its URLs are its hrefs until resolve_urls() is called.
+ * @exception BESInternalError if the table is malformed
+ */
+shared_ptr<ChunkTable>
+ChunkTable::read(const shared_ptr<const char> &storage, const char *&pos, const char *end)
+{
+    if (reinterpret_cast<uintptr_t>(pos) % 8)
+        throw BESInternalError("The binary DMR++ chunk table is not aligned.", __FILE__, __LINE__);
+
+    const char *start = pos;
+    shared_ptr<ChunkTable> table(new ChunkTable());
+    table->d_storage = storage;
+
+    table->d_count = read_value<uint64_t>(pos, end);
+    table->d_rank = read_value<uint32_t>(pos, end);
+    uint32_t num_hrefs = read_value<uint32_t>(pos, end);
+    uint32_t byte_order_length = read_value<uint32_t>(pos, end);
+    (void) read_value<uint32_t>(pos, end);
+
+    if (num_hrefs == 0)
+        throw BESInternalError("The binary DMR++ chunk table has no hrefs.", __FILE__, __LINE__);
+
+    table->d_byte_order = read_string(pos, end, byte_order_length);
+    for (uint32_t i = 0; i < num_hrefs; ++i)
+        table->d_hrefs.push_back(read_string(pos, end, read_value<uint32_t>(pos, end)));
+    table->d_urls = table->d_hrefs;
+    skip_padding(pos, start);
+
+    // Check the sizes so that multiplying them by the count cannot overflow.
+    uint64_t count = table->d_count;
+    need(pos, end, 0);
+    if (count > (uint64_t) (end - pos) / 16 || (table->d_rank && count * 8 > (uint64_t) (end - pos) / table->d_rank))
+        throw BESInternalError("The binary DMR++ chunk table is truncated.", __FILE__, __LINE__);
+
+    need(pos, end, count * (2 + table->d_rank) * sizeof(uint64_t));
+    table->d_offsets = reinterpret_cast<const uint64_t *>(pos);
+    pos += count * sizeof(uint64_t);
+    table->d_sizes = reinterpret_cast<const uint64_t *>(pos);
+    pos += count * sizeof(uint64_t);
+    table->d_positions = reinterpret_cast<const uint64_t *>(pos);
+    pos += count * table->d_rank * sizeof(uint64_t);
+
+    if (num_hrefs > 1) {
+        need(pos, end, count * sizeof(uint32_t));
+        table->d_href_index = reinterpret_cast<const uint32_t *>(pos);
+        for (uint64_t i = 0; i < count; ++i) {
+            if (table->d_href_index[i] >= num_hrefs)
+                throw BESInternalError("The binary DMR++ chunk table has a bad href index.", __FILE__, __LINE__);
+        }
+        pos += count * sizeof(uint32_t);
+        skip_padding(pos, start);
+    }
+
+    return table;
+}
+
+/**
+ * @brief Make a table for Chunks that were not read from a table
+ *
+ * This is how build_dmrpp, which adds the Chunks one at a time, writes a
+ * binary DMR++.
+ *
+ * @param chunks The Chunks of one variable
+ * @param dataset_href Chunks that read from this URL (or from "") are
+ * written with an empty href.
+ */
+shared_ptr<ChunkTable>
+ChunkTable::from_chunks(const vector<shared_ptr<Chunk>> &chunks, const string &dataset_href)
+{
+    ChunkTableBuilder builder(chunks.empty() ? "" : chunks.front()->d_byte_order);
+    for (const auto &chunk: chunks) {
+        const string &url = chunk->d_data_url;
+        builder.add_chunk(url == dataset_href ? "" : url, chunk->d_offset, chunk->d_size,
+            chunk->d_chunk_position_in_array);
+    }
+
+    return builder.build();
+}
+
+uint32_t ChunkTableBuilder::href_index(const string &href)
+{
+    // Nearly always, every chunk uses the same href.
+    if (!d_hrefs.empty() && d_hrefs.back() == href)
+        return d_hrefs.size() - 1;
+
+    auto i = d_href_map.find(href);
+    if (i != d_href_map.end())
+        return i->second;
+
+    d_hrefs.push_back(href);
+    d_href_map[href] = d_hrefs.size() - 1;
+    return d_hrefs.size() - 1;
+}
+
+void ChunkTableBuilder::set_rank(uint32_t rank)
+{
+    if (!d_rank_set) {
+        d_rank = rank;
+        d_rank_set = true;
+    }
+    else if (rank != d_rank) {
+        throw BESInternalError("while parsing a DMR++, chunk positions of one variable have different ranks",
+            __FILE__, __LINE__);
+    }
+}
+
+/**
+ * @brief Add a chunk
+ * @param href The chunk's href; empty for the dataset's href
+ * @param offset
+ * @param size
+ * @param position_in_array The chunk's position, as written in the DMR++
+ * (e.g., "[0,100]"); empty if the variable is not chunked.
+ */
+void ChunkTableBuilder::add_chunk(const string &href, uint64_t offset, uint64_t size, const string &position_in_array)
+{
+    if (position_in_array.empty()) {
+        add_chunk(href, offset, size, vector<unsigned long long>());
+        return;
+    }
+
+    // The same checks as Chunk::parse_chunk_position_in_array_string()
+    if (position_in_array.find('[') == string::npos || position_in_array.find(']') == string::npos
+        || position_in_array.length() < 3)
+        throw BESInternalError("while parsing a DMR++, chunk position string malformed", __FILE__, __LINE__);
+
+    if (position_in_array.find_first_not_of("[]1234567890,") != string::npos)
+        throw BESInternalError("while parsing a DMR++, chunk position string illegal character(s)", __FILE__,
+            __LINE__);
+
+    size_t before = d_positions.size();
+    const char *p = position_in_array.c_str() + 1;
+    const char *end = position_in_array.c_str() + position_in_array.length() - 1;
+    while (p < end) {
+        char *next;
+        d_positions.push_back(strtoull(p, &next, 10));
+        if (next == p) next++;  // a stray separator
+        else if (*next == ',') next++;
+        p = next;
+    }
+
+    set_rank(d_positions.size() - before);
+
+    d_offsets.push_back(offset);
+    d_sizes.push_back(size);
+    d_href_index.push_back(href_index(href));
+}
+
+void ChunkTableBuilder::add_chunk(const string &href, uint64_t offset, uint64_t size,
+    const vector<unsigned long long> &position_in_array)
+{
+    set_rank(position_in_array.size());
+
+    d_positions.insert(d_positions.end(), position_in_array.begin(), position_in_array.end());
+    d_offsets.push_back(offset);
+    d_sizes.push_back(size);
+    d_href_index.push_back(href_index(href));
+}
+
+/**
+ * @brief Pack the chunks into a table
+ * @return The table, with its URLs set to its hrefs
+ */
+shared_ptr<ChunkTable> ChunkTableBuilder::build() const
+{
+    // Write the table the way it's stored in a binary DMR++ and read that;
+    // the table's storage is the string.
+    ostringstream oss;
+    vector<string> hrefs = d_hrefs.empty() ? vector<string>(1, "") : d_hrefs;
+    write_table(oss, d_byte_order, hrefs, d_offsets.size(), d_rank, d_offsets.data(), d_sizes.data(),
+        d_positions.data(), d_href_index.data());
+
+    shared_ptr<string> buf = make_shared<string>(oss.str());
+    shared_ptr<const char> storage(buf, buf->data());
+
+    const char *pos = buf->data();
+    return ChunkTable::read(storage, pos, pos + buf->size());
+}
+
+} // namespace dmrpp
@@ -0,0 +1,153 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _ChunkTable_h
+#define _ChunkTable_h 1
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dmrpp {
+
+class Chunk;
+
+/**
+ * @brief The chunks of one variable, packed into arrays
+ *
+ * A DMR++ can describe hundreds of thousands of chunks, but most requests
+ * read only a few of its variables. Making a Chunk object for every
+ * dmrpp:chunk element as the document is parsed costs more than parsing
+ * the element, so the parser packs the offset, size and position of each
+ * of a variable's chunks into a ChunkTable instead. DmrppCommon makes the
+ * Chunk objects from the table the first time the variable's chunks are
+ * used.
+ *
+ * The table is stored the same way in memory and in a binary DMR++ (see
+ * DmrppBinary), so a table read from a memory-mapped file points into the
+ * mapping. The table holds a reference to its storage, which keeps the
+ * mapping (or buffer) alive for as long as the table is used.
+ *
+ * The chunk hrefs are kept as they appear in the DMR++ - the empty string
+ * is the dataset's dmrpp:href - so the table can be written back out. The
+ * URLs the Chunks read are set using resolve_urls().
+ */
+class ChunkTable {
+private:
+    std::shared_ptr<const char> d_storage;
+    const uint64_t *d_offsets;
+    const uint64_t *d_sizes;
+    const uint64_t *d_positions;    // d_rank values for each chunk
+    const uint32_t *d_href_index;   // null when all the chunks use d_hrefs[0]
+    uint64_t d_count;
+    uint32_t d_rank;
+    std::string d_byte_order;
+    std::vector<std::string> d_hrefs;
+    std::vector<std::string> d_urls;
+    std::string d_key;
+
+    ChunkTable() : d_offsets(nullptr), d_sizes(nullptr), d_positions(nullptr), d_href_index(nullptr),
+        d_count(0), d_rank(0) { }
+
+    friend class ChunkTableTest;
+
+public:
+    virtual ~ChunkTable() = default;
+
+    /// @brief The number of chunks
+    uint64_t size() const { return d_count; }
+
+    /// @brief The number of values in each chunk's position in the array; zero if there are none
+    uint32_t rank() const { return d_rank; }
+
+    uint64_t get_offset(uint64_t i) const { return d_offsets[i]; }
+    uint64_t get_size(uint64_t i) const { return d_sizes[i]; }
+
+    /// @brief The rank() values of the i-th chunk's position in the array
+    const uint64_t *get_position(uint64_t i) const { return d_positions + i * d_rank; }
+
+    /// @brief The href of the i-th chunk as it appears in the DMR++; empty for the dataset's href
+    const std::string &get_href(uint64_t i) const { return d_hrefs[d_href_index ? d_href_index[i] : 0]; }
+
+    /// @brief The URL the i-th chunk's data are read from
+    const std::string &get_url(uint64_t i) const { return d_urls[d_href_index ? d_href_index[i] : 0]; }
+
+    const std::string &get_byte_order() const { return d_byte_order; }
+
+    /// @brief Names this table in the file it was read from; empty unless the table was read from a file
+    const std::string &get_key() const { return d_key; }
+    void set_key(const std::string &key) { d_key = key; }
+
+    void resolve_urls(const std::function<std::string(const std::string &)> &resolve);
+
+    void make_chunks(std::vector<std::shared_ptr<Chunk>> &chunks) const;
+
+    void write(std::ostream &os) const;
+
+    static std::shared_ptr<ChunkTable> read(const std::shared_ptr<const char> &storage, const char *&pos,
+        const char *end);
+
+    static std::shared_ptr<ChunkTable> from_chunks(const std::vector<std::shared_ptr<Chunk>> &chunks,
+        const std::string &dataset_href);
+};
+
+/**
+ * @brief Collect the chunks of a variable and pack them into a ChunkTable
+ */
+class ChunkTableBuilder {
+private:
+    std::string d_byte_order;
+    std::vector<uint64_t> d_offsets;
+    std::vector<uint64_t> d_sizes;
+    std::vector<uint64_t> d_positions;
+    std::vector<uint32_t> d_href_index;
+    std::vector<std::string> d_hrefs;
+    std::unordered_map<std::string, uint32_t> d_href_map;
+    uint32_t d_rank;
+    bool d_rank_set;
+
+    uint32_t href_index(const std::string &href);
+    void set_rank(uint32_t rank);
+
+public:
+    explicit ChunkTableBuilder(const std::string &byte_order) : d_byte_order(byte_order), d_rank(0),
+        d_rank_set(false) { }
+
+    virtual ~ChunkTableBuilder() = default;
+
+    bool empty() const { return d_offsets.empty(); }
+
+    void add_chunk(const std::string &href, uint64_t offset, uint64_t size, const std::string &position_in_array);
+    void add_chunk(const std::string &href, uint64_t offset, uint64_t size,
+        const std::vector<unsigned long long> &position_in_array);
+
+    std::shared_ptr<ChunkTable> build() const;
+};
+
+} // namespace dmrpp
+
+#endif // _ChunkTable_h
@@ -40,14 +40,17 @@
 
 #include "BESLog.h"
 #include "BESDebug.h"
+#include "BESMetrics.h"
 #include "BESInternalError.h"
 #include "BESForbiddenError.h"
 #include "AllowedHosts.h"
 
 #include "DmrppCommon.h"
 #include "DmrppNames.h"
+#include "DmrppRequestHandler.h"
 #include "awsv4.h"
 #include "CurlHandlePool.h"
+#include "TransferStats.h"
 #include "Chunk.h"
 #include "CredentialsManager.h"
 #include "AccessCredentials.h"
@@ -57,6 +60,11 @@
 
 #define prolog std::string("CurlHandlePool::").append(__func__).append("() - ")
 
+// These are the same series as the ones in CurlMultiEngine.cc
+static BESMetric bytes_fetched(BESMetrics::counter, "bes_dmrpp_bytes_fetched_total", "Bytes of data read by DMR++");
+static BESMetric transfers_in_flight(BESMetrics::process_gauge, "bes_dmrpp_transfers_in_flight",
+    "DMR++ data transfers in progress");
+
 #if 0
 // Shutdown this block of unsed variables. ndp - 3/1/21
 //static const int MAX_WAIT_MSECS = 30 * 1000; // Wait max. 30 seconds
@@ -227,52 +235,64 @@ int curl_trace(CURL */*handle*/, curl_infotype type, char *data, size_t /*size*/
 }
 #endif
 
-dmrpp_easy_handle::dmrpp_easy_handle() : d_request_headers(0) {
-
+/**
+ * @brief Set the options that every DMR++ chunk transfer handle uses.
+ *
+ * These do not depend on the Chunk being read, so a handle needs them only
+ * once. Used by dmrpp_easy_handle and by the CurlMultiEngine.
+ *
+ * @param handle The libcurl easy handle
+ * @param errbuf The handle's error buffer, CURL_ERROR_SIZE bytes
+ */
+void dmrpp::init_chunk_transfer_handle(CURL *handle, char *errbuf) {
     CURLcode res;
 
-    d_handle = curl_easy_init();
-    if (!d_handle) throw BESInternalError("Could not allocate CURL handle", __FILE__, __LINE__);
-
-    curl::set_error_buffer(d_handle, d_errbuf);
+    curl::set_error_buffer(handle, errbuf);
 
-    res =  curl_easy_setopt(d_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
-    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_SSLVERSION", d_errbuf, __FILE__, __LINE__);
+    res =  curl_easy_setopt(handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_SSLVERSION", errbuf, __FILE__, __LINE__);
 
 
 #if CURL_VERBOSE
-    res = curl_easy_setopt(d_handle, CURLOPT_DEBUGFUNCTION, curl_trace);
-    curl::check_setopt_result(res, prolog, "CURLOPT_DEBUGFUNCTION", d_errbuf, __FILE__, __LINE__);
+    res = curl_easy_setopt(handle, CURLOPT_DEBUGFUNCTION, curl_trace);
+    curl::check_setopt_result(res, prolog, "CURLOPT_DEBUGFUNCTION", errbuf, __FILE__, __LINE__);
    // Many tests fail with this option, but it's still useful to see how connections
    // are treated. jhrg 10/2/18
-   res = curl_easy_setopt(d_handle, CURLOPT_VERBOSE, 1L);
-   curl::check_setopt_result(res, prolog, "CURLOPT_VERBOSE", d_errbuf, __FILE__, __LINE__);
+   res = curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
+   curl::check_setopt_result(res, prolog, "CURLOPT_VERBOSE", errbuf, __FILE__, __LINE__);
 #endif
 
-    res = curl_easy_setopt(d_handle, CURLOPT_HEADERFUNCTION, chunk_header_callback);
-    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HEADERFUNCTION", d_errbuf, __FILE__, __LINE__);
+    res = curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, chunk_header_callback);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HEADERFUNCTION", errbuf, __FILE__, __LINE__);
 
     // Pass all data to the 'write_data' function
-    res = curl_easy_setopt(d_handle, CURLOPT_WRITEFUNCTION, chunk_write_data);
-    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEFUNCTION", d_errbuf, __FILE__, __LINE__);
+    res = curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, chunk_write_data);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEFUNCTION", errbuf, __FILE__, __LINE__);
 
 #ifdef CURLOPT_TCP_KEEPALIVE
     /* enable TCP keep-alive for this transfer */
-    res = curl_easy_setopt(d_handle, CURLOPT_TCP_KEEPALIVE, 1L);
-    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPALIVE", d_errbuf, __FILE__, __LINE__);
+    res = curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPALIVE", errbuf, __FILE__, __LINE__);
 #endif
 
 #ifdef CURLOPT_TCP_KEEPIDLE
     /* keep-alive idle time to 120 seconds */
-     res = curl_easy_setopt(d_handle, CURLOPT_TCP_KEEPIDLE, 120L);
-    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPIDLE", d_errbuf, __FILE__, __LINE__);
+     res = curl_easy_setopt(handle, CURLOPT_TCP_KEEPIDLE, 120L);
+    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPIDLE", errbuf, __FILE__, __LINE__);
 #endif
 
 #ifdef CURLOPT_TCP_KEEPINTVL
     /* interval time between keep-alive probes: 120 seconds */
-    res = curl_easy_setopt(d_handle, CURLOPT_TCP_KEEPINTVL, 120L)
-    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPINTVL", d_errbuf, __FILE__, __LINE__);
+    res = curl_easy_setopt(handle, CURLOPT_TCP_KEEPINTVL, 120L)
+    curl::check_setopt_result(res, prolog, "CURLOPT_TCP_KEEPINTVL", errbuf, __FILE__, __LINE__);
 #endif
+}
+
+dmrpp_easy_handle::dmrpp_easy_handle() : d_request_headers(0) {
+    d_handle = curl_easy_init();
+    if (!d_handle) throw BESInternalError("Could not allocate CURL handle", __FILE__, __LINE__);
+
+    init_chunk_transfer_handle(d_handle, d_errbuf);
 
     d_in_use = false;
     d_url = "";
@@ -297,9 +317,13 @@ dmrpp_easy_handle::~dmrpp_easy_handle() {
  * all cleanup.
  */
 void dmrpp_easy_handle::read_data() {
+    BESMetricScope in_flight(transfers_in_flight);
+
     // Treat HTTP/S requests specially; retry some kinds of failures.
     if (d_url.find("https://") == 0 || d_url.find("http://") == 0) {
         curl::super_easy_perform(d_handle);
+        if (DmrppRequestHandler::d_super_chunk_auto_gap)
+            TransferStats::TheStats()->record(d_url, d_handle, d_chunk->get_bytes_read());
     }
     else {
         CURLcode curl_code = curl_easy_perform(d_handle);
@@ -310,6 +334,7 @@ void dmrpp_easy_handle::read_data() {
     }
 
     d_chunk->set_is_read(true);
+    bytes_fetched.add(d_chunk->get_bytes_read());
 }
 
 #if 0
@@ -375,6 +400,140 @@ static struct curl_slist *append_http_header(curl_slist *slist, const string &he
 #endif
 
 
+/**
+ * @brief Configure a libcurl easy handle to read the bytes of a Chunk.
+ *
+ * Sets the URL, byte range, the Chunk used by the header and write callbacks,
+ * cookie, redirect and authentication options and, for S3 credentials, the
+ * AWS V4 signature headers. Used by CurlHandlePool::get_easy_handle() and by
+ * the CurlMultiEngine so both fetch engines make identical requests.
+ *
+ * @param handle The libcurl easy handle, already set up by init_chunk_transfer_handle()
+ * @param chunk Read the data for this Chunk
+ * @param errbuf The handle's error buffer
+ * @return The request headers set on the handle, or null if none. The caller
+ * must free these once the transfer is complete.
+ */
+curl_slist *dmrpp::set_chunk_transfer_options(CURL *handle, Chunk *chunk, char *errbuf) {
+    string url = chunk->get_data_url();
+    curl_slist *request_headers = nullptr;
+
+    CURLcode res = curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_URL", errbuf, __FILE__, __LINE__);
+
+    // get the offset to offset + size bytes
+    res = curl_easy_setopt(handle, CURLOPT_RANGE, chunk->get_curl_range_arg_string().c_str());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_RANGE", errbuf, __FILE__, __LINE__);
+
+    // Pass this to chunk_header_callback as the fourth argument
+    res = curl_easy_setopt(handle, CURLOPT_HEADERDATA, reinterpret_cast<void *>(chunk));
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HEADERDATA", errbuf, __FILE__, __LINE__);
+
+    // Pass this to chunk_write_data as the fourth argument
+    res = curl_easy_setopt(handle, CURLOPT_WRITEDATA, reinterpret_cast<void *>(chunk));
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEDATA", errbuf, __FILE__, __LINE__);
+
+    // Enabled cookies
+    res = curl_easy_setopt(handle, CURLOPT_COOKIEFILE, curl::get_cookie_filename().c_str());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_COOKIEFILE", errbuf, __FILE__, __LINE__);
+
+    res = curl_easy_setopt(handle, CURLOPT_COOKIEJAR, curl::get_cookie_filename().c_str());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_COOKIEJAR", errbuf, __FILE__, __LINE__);
+
+    // Follow 302 (redirect) responses
+    res = curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_FOLLOWLOCATION", errbuf, __FILE__, __LINE__);
+
+    res = curl_easy_setopt(handle, CURLOPT_MAXREDIRS, curl::max_redirects());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_MAXREDIRS", errbuf, __FILE__, __LINE__);
+
+    // Set the user agent something otherwise TEA will never redirect to URS.
+    res = curl_easy_setopt(handle, CURLOPT_USERAGENT, curl::hyrax_user_agent().c_str());
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_USERAGENT", errbuf, __FILE__, __LINE__);
+
+    // This means libcurl will use Basic, Digest, GSS Negotiate, or NTLM,
+    // choosing the the 'safest' one supported by the server.
+    // This requires curl 7.10.6 which is still in pre-release. 07/25/03 jhrg
+    res = curl_easy_setopt(handle, CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HTTPAUTH", errbuf, __FILE__, __LINE__);
+
+    // Enable using the .netrc credentials file.
+    res = curl_easy_setopt(handle, CURLOPT_NETRC, CURL_NETRC_OPTIONAL);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_NETRC", errbuf, __FILE__, __LINE__);
+
+    // If the configuration specifies a particular .netrc credentials file, use it.
+    // TODO move this operation into constructor and stash the value.
+    string netrc_file = curl::get_netrc_filename();
+    if (!netrc_file.empty()) {
+        res = curl_easy_setopt(handle, CURLOPT_NETRC_FILE, netrc_file.c_str());
+        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_NETRC_FILE", errbuf, __FILE__, __LINE__);
+    }
+    //VERBOSE(__FILE__ << "::get_easy_handle() is using the netrc file '"
+    //<< ((!netrc_file.empty()) ? netrc_file : "~/.netrc") << "'" << endl);
+
+    AccessCredentials *credentials = CredentialsManager::theCM()->get(url);
+    if (credentials && credentials->is_s3_cred()) {
+        BESDEBUG(DMRPP_CURL,
+                 prolog << "Got AccessCredentials instance: " << endl << credentials->to_json() << endl);
+        // If there are available credentials, and they are S3 credentials then we need to sign
+        // the request
+        const std::time_t request_time = std::time(0);
+
+        const std::string auth_header =
+                AWSV4::compute_awsv4_signature(
+                        url,
+                        request_time,
+                        credentials->get(AccessCredentials::ID_KEY),
+                        credentials->get(AccessCredentials::KEY_KEY),
+                        credentials->get(AccessCredentials::REGION_KEY),
+                        "s3");
+
+
+        request_headers = curl::append_http_header((curl_slist *)0, "Authorization", auth_header);
+        request_headers = curl::append_http_header(request_headers, "x-amz-content-sha256",
+                                              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        request_headers = curl::append_http_header(request_headers, "x-amz-date", AWSV4::ISO8601_date(request_time));
+#if 0
+
+        // passing nullptr for the first call allocates the curl_slist
+        // The following code builds the slist that holds the headers. This slist is freed
+        // once the URL is dereferenced in dmrpp_easy_handle::read_data(). jhrg 11/26/19
+        request_headers = append_http_header(0, "Authorization:", auth_header);
+        if (!request_headers)
+            throw BESInternalError(
+                    string("CURL Error setting Authorization header: ").append(
+                            curl::error_message(res, errbuf)), __FILE__, __LINE__);
+
+        // We pre-compute the sha256 hash of a null message body
+        curl_slist *temp = append_http_header(request_headers, "x-amz-content-sha256:",
+                                              "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        if (!temp)
+            throw BESInternalError(
+                    string("CURL Error setting x-amz-content-sha256: ").append(
+                            curl::error_message(res, errbuf)),
+                    __FILE__, __LINE__);
+        request_headers = temp;
+
+        temp = append_http_header(request_headers, "x-amz-date:", AWSV4::ISO8601_date(request_time));
+        if (!temp)
+            throw BESInternalError(
+                    string("CURL Error setting x-amz-date header: ").append(
+                            curl::error_message(res, errbuf)),
+                    __FILE__, __LINE__);
+        request_headers = temp;
+#endif
+
+        // request_headers = curl::add_auth_headers(request_headers);
+    }
+
+    // Always set this, even to null, so a reused handle never sends (or
+    // points at) the headers of its previous transfer.
+    res = curl_easy_setopt(handle, CURLOPT_HTTPHEADER, request_headers);
+    curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HTTPHEADER", errbuf, __FILE__, __LINE__);
+
+    return request_headers;
+}
+
 /**
  * Get a CURL easy handle to transfer data from \arg url into the given \arg chunk.
  *
@@ -415,120 +574,15 @@ CurlHandlePool::get_easy_handle(Chunk *chunk) {
 
         handle->d_chunk = chunk;
 
-        CURLcode res = curl_easy_setopt(handle->d_handle, CURLOPT_URL, chunk->get_data_url().c_str());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_URL", handle->d_errbuf, __FILE__, __LINE__);
-
-        // get the offset to offset + size bytes
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_RANGE, chunk->get_curl_range_arg_string().c_str());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_RANGE", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Pass this to chunk_header_callback as the fourth argument
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_HEADERDATA, reinterpret_cast<void *>(chunk));
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HEADERDATA", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Pass this to chunk_write_data as the fourth argument
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_WRITEDATA, reinterpret_cast<void *>(chunk));
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEDATA", handle->d_errbuf, __FILE__, __LINE__);
+        if (handle->d_request_headers) {
+            curl_slist_free_all(handle->d_request_headers);
+            handle->d_request_headers = 0;
+        }
+        handle->d_request_headers = set_chunk_transfer_options(handle->d_handle, chunk, handle->d_errbuf);
 
         // store the easy_handle so that we can call release_handle in multi_handle::read_data()
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_PRIVATE, reinterpret_cast<void *>(handle));
+        CURLcode res = curl_easy_setopt(handle->d_handle, CURLOPT_PRIVATE, reinterpret_cast<void *>(handle));
         curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_PRIVATE", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Enabled cookies
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_COOKIEFILE, curl::get_cookie_filename().c_str());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_COOKIEFILE", handle->d_errbuf, __FILE__, __LINE__);
-
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_COOKIEJAR, curl::get_cookie_filename().c_str());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_COOKIEJAR", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Follow 302 (redirect) responses
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_FOLLOWLOCATION, 1);
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_FOLLOWLOCATION", handle->d_errbuf, __FILE__, __LINE__);
-
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_MAXREDIRS, curl::max_redirects());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_MAXREDIRS", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Set the user agent something otherwise TEA will never redirect to URS.
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_USERAGENT, curl::hyrax_user_agent().c_str());
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_USERAGENT", handle->d_errbuf, __FILE__, __LINE__);
-
-        // This means libcurl will use Basic, Digest, GSS Negotiate, or NTLM,
-        // choosing the the 'safest' one supported by the server.
-        // This requires curl 7.10.6 which is still in pre-release. 07/25/03 jhrg
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_HTTPAUTH, (long) CURLAUTH_ANY);
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HTTPAUTH", handle->d_errbuf, __FILE__, __LINE__);
-
-        // Enable using the .netrc credentials file.
-        res = curl_easy_setopt(handle->d_handle, CURLOPT_NETRC, CURL_NETRC_OPTIONAL);
-        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_NETRC", handle->d_errbuf, __FILE__, __LINE__);
-
-        // If the configuration specifies a particular .netrc credentials file, use it.
-        // TODO move this operation into constructor and stash the value.
-        string netrc_file = curl::get_netrc_filename();
-        if (!netrc_file.empty()) {
-            res = curl_easy_setopt(handle->d_handle, CURLOPT_NETRC_FILE, netrc_file.c_str());
-            curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_NETRC_FILE", handle->d_errbuf, __FILE__, __LINE__);
-        }
-        //VERBOSE(__FILE__ << "::get_easy_handle() is using the netrc file '"
-        //<< ((!netrc_file.empty()) ? netrc_file : "~/.netrc") << "'" << endl);
-
-        AccessCredentials *credentials = CredentialsManager::theCM()->get(handle->d_url);
-        if (credentials && credentials->is_s3_cred()) {
-            BESDEBUG(DMRPP_CURL,
-                     prolog << "Got AccessCredentials instance: " << endl << credentials->to_json() << endl);
-            // If there are available credentials, and they are S3 credentials then we need to sign
-            // the request
-            const std::time_t request_time = std::time(0);
-
-            const std::string auth_header =
-                    AWSV4::compute_awsv4_signature(
-                            handle->d_url,
-                            request_time,
-                            credentials->get(AccessCredentials::ID_KEY),
-                            credentials->get(AccessCredentials::KEY_KEY),
-                            credentials->get(AccessCredentials::REGION_KEY),
-                            "s3");
-
-
-            handle->d_request_headers = curl::append_http_header((curl_slist *)0, "Authorization", auth_header);
-            handle->d_request_headers = curl::append_http_header(handle->d_request_headers, "x-amz-content-sha256",
-                                                  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
-            handle->d_request_headers = curl::append_http_header(handle->d_request_headers, "x-amz-date", AWSV4::ISO8601_date(request_time));
-#if 0
-
-            // passing nullptr for the first call allocates the curl_slist
-            // The following code builds the slist that holds the headers. This slist is freed
-            // once the URL is dereferenced in dmrpp_easy_handle::read_data(). jhrg 11/26/19
-            handle->d_request_headers = append_http_header(0, "Authorization:", auth_header);
-            if (!handle->d_request_headers)
-                throw BESInternalError(
-                        string("CURL Error setting Authorization header: ").append(
-                                curl::error_message(res, handle->d_errbuf)), __FILE__, __LINE__);
-
-            // We pre-compute the sha256 hash of a null message body
-            curl_slist *temp = append_http_header(handle->d_request_headers, "x-amz-content-sha256:",
-                                                  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
-            if (!temp)
-                throw BESInternalError(
-                        string("CURL Error setting x-amz-content-sha256: ").append(
-                                curl::error_message(res, handle->d_errbuf)),
-                        __FILE__, __LINE__);
-            handle->d_request_headers = temp;
-
-            temp = append_http_header(handle->d_request_headers, "x-amz-date:", AWSV4::ISO8601_date(request_time));
-            if (!temp)
-                throw BESInternalError(
-                        string("CURL Error setting x-amz-date header: ").append(
-                                curl::error_message(res, handle->d_errbuf)),
-                        __FILE__, __LINE__);
-            handle->d_request_headers = temp;
-#endif
-
-            // handle->d_request_headers = curl::add_auth_headers(handle->d_request_headers);
-
-            res = curl_easy_setopt(handle->d_handle, CURLOPT_HTTPHEADER, handle->d_request_headers);
-            curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_HTTPHEADER", handle->d_errbuf, __FILE__, __LINE__);
-        }
     }
 
     return handle;
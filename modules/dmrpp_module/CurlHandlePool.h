@@ -35,6 +35,9 @@ namespace dmrpp {
 
 class Chunk;
 
+void init_chunk_transfer_handle(CURL *handle, char *errbuf);
+curl_slist *set_chunk_transfer_options(CURL *handle, Chunk *chunk, char *errbuf);
+
 /**
  * RAII. Lock access to the get_easy_handle() and release_handle() methods.
  */
@@ -0,0 +1,510 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <sstream>
+#include <memory>
+#include <future>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "CurlUtils.h"
+
+#include "BESLog.h"
+#include "BESDebug.h"
+#include "BESMetrics.h"
+#include "BESIndent.h"
+#include "BESInternalError.h"
+#include "BESForbiddenError.h"
+#include "AllowedHosts.h"
+
+#include "DmrppNames.h"
+#include "DmrppRequestHandler.h"
+#include "CurlHandlePool.h"
+#include "CurlMultiEngine.h"
+#include "TransferStats.h"
+#include "Chunk.h"
+
+#define prolog std::string("CurlMultiEngine::").append(__func__).append("() - ")
+
+// These are the same series as the ones in CurlHandlePool.cc
+static BESMetric bytes_fetched(BESMetrics::counter, "bes_dmrpp_bytes_fetched_total", "Bytes of data read by DMR++");
+static BESMetric transfers_in_flight(BESMetrics::process_gauge, "bes_dmrpp_transfers_in_flight",
+    "DMR++ data transfers in progress");
+
+#define ENGINE_MODULE "dmrpp:multi"
+
+using namespace std;
+using namespace bes;
+
+namespace dmrpp {
+
+// Same policy as curl::super_easy_perform()
+static const unsigned int retry_limit = 10; // Amazon's suggestion
+static const long first_retry_ms = 250;     // Doubled for each retry
+
+// How long the event loop sleeps in curl_multi_wait() when nothing happens.
+// Submissions and libcurl's own timers wake it sooner.
+static const long max_wait_ms = 1000;
+
+static std::mutex engine_init_mtx;
+static CurlMultiEngine *the_engine = nullptr;
+
+/**
+ * @brief Build an engine and start its event loop thread.
+ * @param max_in_flight The most transfers to run at once; zero is treated as one.
+ * @param max_host_connections The most connections to open to any one host.
+ * Zero means no limit.
+ */
+CurlMultiEngine::CurlMultiEngine(unsigned int max_in_flight, unsigned int max_host_connections) :
+        d_multi(nullptr), d_max_in_flight(max_in_flight ? max_in_flight : 1),
+        d_max_host_connections(max_host_connections), d_shutdown(false), d_in_flight(0), d_peak_in_flight(0),
+        d_completed(0), d_bytes(0), d_retries(0), d_owner_pid(getpid())
+{
+    d_multi = curl_multi_init();
+    if (!d_multi) throw BESInternalError(prolog + "Could not allocate a libcurl multi handle.", __FILE__, __LINE__);
+
+#ifdef CURLPIPE_MULTIPLEX
+    // Run the requests to a given HTTP/2 host over shared connections
+    curl_multi_setopt(d_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x071e00
+    curl_multi_setopt(d_multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(d_max_host_connections));
+#endif
+
+    // Writing to this pipe wakes the event loop when a transfer is submitted.
+    if (pipe(d_wakeup_pipe) != 0) {
+        curl_multi_cleanup(d_multi);
+        throw BESInternalError(prolog + "Could not make the event loop's wake up pipe.", __FILE__, __LINE__);
+    }
+    for (int fd: d_wakeup_pipe) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    d_loop = std::thread(&CurlMultiEngine::event_loop, this);
+
+    BESDEBUG(ENGINE_MODULE, prolog << "Started the event loop. max_in_flight: " << d_max_in_flight
+                                   << " max_host_connections: " << d_max_host_connections << endl);
+}
+
+/**
+ * @brief Stop the event loop.
+ *
+ * Transfers that have not finished are ended and their completion handlers
+ * are passed an error.
+ */
+CurlMultiEngine::~CurlMultiEngine()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mtx);
+        d_shutdown = true;
+    }
+    wake_up();
+    if (d_loop.joinable()) d_loop.join();
+
+    auto error = std::make_exception_ptr(
+            BESInternalError(prolog + "The transfer engine was shut down.", __FILE__, __LINE__));
+
+    for (auto t: d_active) {
+        curl_multi_remove_handle(d_multi, t->d_handle);
+        transfers_in_flight.add(-1);
+        complete(t, error);
+    }
+    d_active.clear();
+
+    for (auto t: d_submitted)
+        complete(t, error);
+    d_submitted.clear();
+
+    for (auto handle: d_idle_handles)
+        curl_easy_cleanup(handle);
+
+    curl_multi_cleanup(d_multi);
+    close(d_wakeup_pipe[0]);
+    close(d_wakeup_pipe[1]);
+}
+
+void CurlMultiEngine::wake_up()
+{
+    // If the pipe is full the loop is already due to wake up.
+    char c = 1;
+    ssize_t status = write(d_wakeup_pipe[1], &c, 1);
+    (void) status;
+}
+
+/**
+ * @brief Get an easy handle, reusing one from a finished transfer if possible.
+ */
+CURL *CurlMultiEngine::get_handle()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_mtx);
+        if (!d_idle_handles.empty()) {
+            CURL *handle = d_idle_handles.back();
+            d_idle_handles.pop_back();
+            curl_easy_reset(handle);
+            return handle;
+        }
+    }
+
+    CURL *handle = curl_easy_init();
+    if (!handle) throw BESInternalError(prolog + "Could not allocate CURL handle", __FILE__, __LINE__);
+    return handle;
+}
+
+/**
+ * @brief The libcurl write callback for the engine's transfers.
+ *
+ * Passes the bytes to chunk_write_data(). That function throws when the
+ * object store returns an error document. An exception must never unwind
+ * through curl_multi_perform() (it would abandon every other transfer), so
+ * it is saved for the transfer's completion handler and the transfer is
+ * aborted.
+ */
+size_t CurlMultiEngine::write_data(void *buffer, size_t size, size_t nmemb, void *data)
+{
+    auto t = reinterpret_cast<transfer *>(data);
+    try {
+        return chunk_write_data(buffer, size, nmemb, t->d_chunk);
+    }
+    catch (...) {
+        t->d_callback_error = std::current_exception();
+        return 0;
+    }
+}
+
+/**
+ * @brief Start reading a Chunk.
+ *
+ * The easy handle is configured on the calling thread, so errors in the
+ * request itself (e.g., a URL that is not an AllowedHost) are thrown from
+ * here. Errors in the transfer are passed to \arg on_done.
+ *
+ * @param chunk Read this Chunk's bytes into its read buffer. The Chunk must
+ * not be destroyed before \arg on_done is called.
+ * @param on_done Called on the event loop thread once the Chunk has been read
+ * or the transfer has failed.
+ */
+void CurlMultiEngine::submit(Chunk *chunk, completion_handler on_done)
+{
+    string url = chunk->get_data_url();
+    if (!AllowedHosts::theHosts()->is_allowed(url)) {
+        string msg = "ERROR!! The chunk url " + url + " does not match any of the AllowedHost rules. ";
+        throw BESForbiddenError(msg, __FILE__, __LINE__);
+    }
+
+    unique_ptr<transfer> t(new transfer());
+    t->d_chunk = chunk;
+    t->d_on_done = std::move(on_done);
+    t->d_url = url;
+    t->d_request_headers = nullptr;
+    t->d_errbuf[0] = 0;
+    t->d_callback_error = nullptr;
+    t->d_attempts = 1;
+    t->d_handle = get_handle();
+
+    try {
+        init_chunk_transfer_handle(t->d_handle, t->d_errbuf);
+        t->d_request_headers = set_chunk_transfer_options(t->d_handle, chunk, t->d_errbuf);
+
+        CURLcode res = curl_easy_setopt(t->d_handle, CURLOPT_WRITEFUNCTION, CurlMultiEngine::write_data);
+        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEFUNCTION", t->d_errbuf, __FILE__, __LINE__);
+
+        res = curl_easy_setopt(t->d_handle, CURLOPT_WRITEDATA, reinterpret_cast<void *>(t.get()));
+        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_WRITEDATA", t->d_errbuf, __FILE__, __LINE__);
+
+        res = curl_easy_setopt(t->d_handle, CURLOPT_PRIVATE, reinterpret_cast<void *>(t.get()));
+        curl::eval_curl_easy_setopt_result(res, prolog, "CURLOPT_PRIVATE", t->d_errbuf, __FILE__, __LINE__);
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+        // Use HTTP/2 with servers that offer it over TLS and wait for a connection
+        // that can be multiplexed rather than opening a new one. The HTTP/2 option
+        // fails harmlessly when libcurl was built without HTTP/2 support.
+        curl_easy_setopt(t->d_handle, CURLOPT_HTTP_VERSION, static_cast<long>(CURL_HTTP_VERSION_2TLS));
+        curl_easy_setopt(t->d_handle, CURLOPT_PIPEWAIT, 1L);
+#endif
+    }
+    catch (...) {
+        if (t->d_request_headers) curl_slist_free_all(t->d_request_headers);
+        std::lock_guard<std::mutex> lock(d_mtx);
+        d_idle_handles.push_back(t->d_handle);
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(d_mtx);
+        d_submitted.push_back(t.release());
+    }
+    wake_up();
+}
+
+/**
+ * @brief Read a Chunk and wait for it.
+ *
+ * @note Never call this from a completion handler.
+ * @param chunk Read this Chunk's bytes into its read buffer.
+ * @exception Throws the transfer's error, if any.
+ */
+void CurlMultiEngine::read_data(Chunk *chunk)
+{
+    std::promise<void> done;
+    std::future<void> result = done.get_future();
+
+    submit(chunk, [&done](std::exception_ptr error) {
+        if (error)
+            done.set_exception(error);
+        else
+            done.set_value();
+    });
+
+    result.get();
+}
+
+/**
+ * @brief Add submitted transfers to the multi handle, up to d_max_in_flight.
+ *
+ * Runs on the event loop thread.
+ *
+ * @return How long, in milliseconds, the loop may sleep before a transfer
+ * that is waiting out its retry back off is due to start.
+ */
+unsigned int CurlMultiEngine::start_transfers()
+{
+    long wait_ms = max_wait_ms;
+    auto now = std::chrono::steady_clock::now();
+    vector<pair<transfer *, string>> failed;
+
+    std::unique_lock<std::mutex> lock(d_mtx);
+    for (auto i = d_submitted.begin(); i != d_submitted.end() && d_in_flight < d_max_in_flight;) {
+        transfer *t = *i;
+        if (t->d_not_before > now) {
+            long ms = std::chrono::duration_cast<std::chrono::milliseconds>(t->d_not_before - now).count() + 1;
+            if (ms < wait_ms) wait_ms = ms;
+            ++i;
+            continue;
+        }
+        i = d_submitted.erase(i);
+
+        CURLMcode mc = curl_multi_add_handle(d_multi, t->d_handle);
+        if (mc != CURLM_OK) {
+            failed.emplace_back(t, prolog + "ERROR - Could not add a transfer to the multi handle: "
+                                   + curl_multi_strerror(mc));
+            continue;
+        }
+
+        d_active.insert(t);
+        transfers_in_flight.add(1);
+        unsigned long long n = ++d_in_flight;
+        if (n > d_peak_in_flight) d_peak_in_flight = n;
+    }
+    lock.unlock();
+
+    for (auto &f: failed)
+        complete(f.first, std::make_exception_ptr(BESInternalError(f.second, __FILE__, __LINE__)));
+
+    return static_cast<unsigned int>(wait_ms);
+}
+
+void CurlMultiEngine::event_loop()
+{
+    BESDEBUG(ENGINE_MODULE, prolog << "BEGIN" << endl);
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(d_mtx);
+            if (d_shutdown) break;
+        }
+
+        unsigned int wait_ms = start_transfers();
+
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(d_multi, &running);
+        if (mc != CURLM_OK)
+            ERROR_LOG(prolog << "ERROR - curl_multi_perform() failed: " << curl_multi_strerror(mc) << endl);
+
+        bool finished_some = false;
+        int msgs_left = 0;
+        CURLMsg *msg;
+        while ((msg = curl_multi_info_read(d_multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            char *private_data = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &private_data);
+            // Read the result before the message is invalidated by removing the handle
+            CURLcode code = msg->data.result;
+            finish_transfer(reinterpret_cast<transfer *>(private_data), code);
+            finished_some = true;
+        }
+
+        // There may be room for more transfers now; start them before sleeping.
+        if (finished_some) continue;
+
+        struct curl_waitfd wakeup;
+        wakeup.fd = d_wakeup_pipe[0];
+        wakeup.events = CURL_WAIT_POLLIN;
+        wakeup.revents = 0;
+        curl_multi_wait(d_multi, &wakeup, 1, static_cast<int>(wait_ms), nullptr);
+
+        if (wakeup.revents) {
+            char buf[64];
+            while (read(d_wakeup_pipe[0], buf, sizeof(buf)) > 0);
+        }
+    }
+
+    BESDEBUG(ENGINE_MODULE, prolog << "END" << endl);
+}
+
+/**
+ * @brief Evaluate a transfer that libcurl reports is done.
+ *
+ * Uses the same tests as curl::super_easy_perform() and dmrpp_easy_handle::read_data().
+ * A retryable failure puts the transfer back on the submitted queue with
+ * an exponential back off; otherwise the transfer is completed.
+ *
+ * Runs on the event loop thread.
+ */
+void CurlMultiEngine::finish_transfer(transfer *t, CURLcode code)
+{
+    curl_multi_remove_handle(d_multi, t->d_handle);
+    d_active.erase(t);
+    d_in_flight--;
+    transfers_in_flight.add(-1);
+
+    std::exception_ptr error = t->d_callback_error;
+    bool success = false;
+    if (!error) {
+        try {
+            if (t->d_url.find("https://") == 0 || t->d_url.find("http://") == 0) {
+                success = curl::eval_curl_easy_perform_code(t->d_handle, t->d_url, code, t->d_errbuf, t->d_attempts);
+                if (success)
+                    success = curl::eval_http_get_response(t->d_handle, t->d_errbuf, t->d_url);
+
+                if (!success && t->d_attempts == retry_limit) {
+                    string msg = prolog + "ERROR - Problem with data transfer. Number of re-tries exceeded. Giving up.";
+                    ERROR_LOG(msg << endl);
+                    throw BESInternalError(msg, __FILE__, __LINE__);
+                }
+            }
+            else if (code != CURLE_OK) {
+                string msg = prolog + "ERROR - Data transfer error: ";
+                throw BESInternalError(msg.append(curl::error_message(code, t->d_errbuf)), __FILE__, __LINE__);
+            }
+            else {
+                success = true;
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+            success = false;
+        }
+    }
+
+    if (!success && !error) {
+        ERROR_LOG(prolog << "ERROR - Problem with data transfer. Will retry (url: " << t->d_url << " attempt: "
+                         << t->d_attempts << ")." << endl);
+        long back_off_ms = first_retry_ms << (t->d_attempts - 1);
+        t->d_attempts++;
+        t->d_errbuf[0] = 0;
+        t->d_chunk->set_bytes_read(0);
+        t->d_chunk->set_response_content_type("");
+        t->d_not_before = std::chrono::steady_clock::now() + std::chrono::milliseconds(back_off_ms);
+        d_retries++;
+
+        std::lock_guard<std::mutex> lock(d_mtx);
+        d_submitted.push_back(t);
+        return;
+    }
+
+    if (success) {
+        t->d_chunk->set_is_read(true);
+        d_bytes += t->d_chunk->get_bytes_read();
+        bytes_fetched.add(t->d_chunk->get_bytes_read());
+        if (DmrppRequestHandler::d_super_chunk_auto_gap)
+            TransferStats::TheStats()->record(t->d_url, t->d_handle, t->d_chunk->get_bytes_read());
+    }
+
+    complete(t, error);
+}
+
+/**
+ * @brief Recycle a transfer's handle, free it and call its completion handler.
+ */
+void CurlMultiEngine::complete(transfer *t, std::exception_ptr error)
+{
+    if (t->d_request_headers) curl_slist_free_all(t->d_request_headers);
+    {
+        std::lock_guard<std::mutex> lock(d_mtx);
+        d_idle_handles.push_back(t->d_handle);
+    }
+    d_completed++;
+
+    completion_handler on_done = std::move(t->d_on_done);
+    delete t;
+
+    try {
+        on_done(error);
+    }
+    catch (...) {
+        ERROR_LOG(prolog << "ERROR - A transfer's completion handler threw an exception." << endl);
+    }
+}
+
+void CurlMultiEngine::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "CurlMultiEngine::" << __func__ << "(" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    strm << BESIndent::LMarg << "max_in_flight: " << d_max_in_flight << endl;
+    strm << BESIndent::LMarg << "max_host_connections: " << d_max_host_connections << endl;
+    strm << BESIndent::LMarg << "in_flight: " << in_flight() << endl;
+    strm << BESIndent::LMarg << "peak_in_flight: " << peak_in_flight() << endl;
+    strm << BESIndent::LMarg << "transfers_completed: " << transfers_completed() << endl;
+    strm << BESIndent::LMarg << "bytes_transferred: " << bytes_transferred() << endl;
+    strm << BESIndent::LMarg << "retries: " << retry_count() << endl;
+    BESIndent::UnIndent();
+}
+
+/**
+ * @brief The engine used to read SuperChunks when DMRPP.UseCurlMulti is set.
+ *
+ * If the engine was made by a parent process its thread is gone; the old
+ * object is abandoned and a new one started for this process.
+ *
+ * @return The process-wide engine, sized by DMRPP.CurlMultiMaxInFlight and
+ * DMRPP.CurlMultiMaxHostConnections
+ */
+CurlMultiEngine *CurlMultiEngine::TheEngine()
+{
+    std::lock_guard<std::mutex> lock(engine_init_mtx);
+    if (!the_engine || the_engine->owner_pid() != getpid())
+        the_engine = new CurlMultiEngine(DmrppRequestHandler::d_curl_multi_max_in_flight,
+                                         DmrppRequestHandler::d_curl_multi_max_host_connections);
+    return the_engine;
+}
+
+} // namespace dmrpp
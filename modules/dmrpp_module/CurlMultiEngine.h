@@ -0,0 +1,165 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _CurlMultiEngine_h
+#define _CurlMultiEngine_h 1
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <exception>
+#include <ostream>
+
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+namespace dmrpp {
+
+class Chunk;
+
+/**
+ * @brief Read Chunks using one libcurl 'multi' event loop per process.
+ *
+ * CurlHandlePool runs one blocking curl_easy_perform() per thread, so the
+ * number of transfers in flight is bounded by the number of threads. This
+ * engine instead runs every transfer on a single thread that drives a libcurl
+ * multi handle: callers submit Chunks and are told when each one is done by
+ * a completion handler. Hundreds of range GETs can be in flight at once while
+ * the multi handle's connection cache reuses connections and, for HTTP/2
+ * servers such as S3, multiplexes the requests over a few connections to
+ * the same host.
+ *
+ * The easy handles are configured exactly as CurlHandlePool configures its
+ * handles (see set_chunk_transfer_options()) and failed transfers are
+ * evaluated and retried as curl::super_easy_perform() does, except that a
+ * transfer waiting out its retry back off does not hold up the others.
+ *
+ * Like the WorkStealingPools, the process-wide engine is started the first
+ * time it is used in a given process so that each beslistener child gets its
+ * own event loop thread.
+ *
+ * @note The completion handlers run on the event loop thread. They must be
+ * short and must never wait on another transfer; hand longer work off to a
+ * WorkStealingPool.
+ */
+class CurlMultiEngine {
+public:
+    /// Called once per submitted Chunk, with null on success or the error.
+    typedef std::function<void(std::exception_ptr)> completion_handler;
+
+private:
+    struct transfer {
+        Chunk *d_chunk;
+        completion_handler d_on_done;
+        std::string d_url;
+        CURL *d_handle;
+        curl_slist *d_request_headers;
+        char d_errbuf[CURL_ERROR_SIZE];
+        std::exception_ptr d_callback_error;
+        unsigned int d_attempts;
+        std::chrono::steady_clock::time_point d_not_before;
+    };
+
+    CURLM *d_multi;
+    unsigned int d_max_in_flight;
+    unsigned int d_max_host_connections;
+
+    std::thread d_loop;
+    int d_wakeup_pipe[2];
+
+    // Guards the fields below. The multi handle itself is only touched by the
+    // event loop thread.
+    std::mutex d_mtx;
+    std::deque<transfer *> d_submitted;
+    std::vector<CURL *> d_idle_handles;
+    bool d_shutdown;
+
+    std::set<transfer *> d_active;   // Event loop thread only
+
+    std::atomic<unsigned long long> d_in_flight;
+    std::atomic<unsigned long long> d_peak_in_flight;
+    std::atomic<unsigned long long> d_completed;
+    std::atomic<unsigned long long> d_bytes;
+    std::atomic<unsigned long long> d_retries;
+
+    pid_t d_owner_pid;
+
+    void wake_up();
+    void event_loop();
+    unsigned int start_transfers();
+    void finish_transfer(transfer *t, CURLcode code);
+    void complete(transfer *t, std::exception_ptr error);
+    CURL *get_handle();
+
+    static size_t write_data(void *buffer, size_t size, size_t nmemb, void *data);
+
+    friend class CurlMultiEngineTest;
+
+public:
+    CurlMultiEngine(unsigned int max_in_flight, unsigned int max_host_connections);
+
+    CurlMultiEngine(const CurlMultiEngine &) = delete;
+    CurlMultiEngine &operator=(const CurlMultiEngine &) = delete;
+
+    virtual ~CurlMultiEngine();
+
+    void submit(Chunk *chunk, completion_handler on_done);
+
+    void read_data(Chunk *chunk);
+
+    /// @brief The most transfers this engine will run at once.
+    unsigned int max_in_flight() const { return d_max_in_flight; }
+
+    /// @brief The number of transfers running now.
+    unsigned long long in_flight() const { return d_in_flight; }
+
+    /// @brief The largest number of transfers that have been running at once.
+    unsigned long long peak_in_flight() const { return d_peak_in_flight; }
+
+    /// @brief The number of transfers that have finished, successfully or not.
+    unsigned long long transfers_completed() const { return d_completed; }
+
+    /// @brief The number of bytes read by the successful transfers.
+    unsigned long long bytes_transferred() const { return d_bytes; }
+
+    /// @brief The number of times a transfer has been retried.
+    unsigned long long retry_count() const { return d_retries; }
+
+    /// @brief The pid of the process that started the event loop thread.
+    pid_t owner_pid() const { return d_owner_pid; }
+
+    virtual void dump(std::ostream &strm) const;
+
+    static CurlMultiEngine *TheEngine();
+};
+
+} // namespace dmrpp
+
+#endif // _CurlMultiEngine_h
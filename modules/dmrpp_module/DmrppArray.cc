@@ -46,11 +46,13 @@
 #include <D4Attributes.h>
 #include <D4Maps.h>
 #include <D4Group.h>
+#include <util.h>
 
 #include "BESInternalError.h"
 #include "BESDebug.h"
 #include "BESLog.h"
 #include "BESStopWatch.h"
+#include "BESTrace.h"
 
 #include "byteswap_compat.h"
 #include "CurlHandlePool.h"
@@ -58,11 +60,13 @@
 #include "DmrppArray.h"
 #include "DmrppRequestHandler.h"
 #include "DmrppNames.h"
+#include "WorkStealingPool.h"
 #include "Base64.h"
 
 // Used with BESDEBUG
-#define dmrpp_3 "dmrpp:3"
-#define dmrpp_4 "dmrpp:4"
+static BESDebugChannel<> dmrpp_1("dmrpp");
+static BESDebugChannel<3> dmrpp_3("dmrpp:3");
+static BESDebugChannel<4> dmrpp_4("dmrpp:4");
 
 using namespace libdap;
 using namespace std;
@@ -200,53 +204,16 @@ bool one_child_chunk_thread_new(unique_ptr<one_child_chunk_args_new> args)
 
 
 
-/**
- * @brief A single argument wrapper for process_super_chunk() for use with std::async().
- * @param args A unique_ptr to an instance of one_super_chunk_args.
- * @return True unless an exception is throw in which case neither true or false apply.
- */
-bool one_super_chunk_transfer_thread(unique_ptr<one_super_chunk_args> args)
-{
-
-#if DMRPP_ENABLE_THREAD_TIMERS
-    stringstream timer_tag;
-    timer_tag << prolog << "tid: 0x" << std::hex << std::this_thread::get_id() <<
-    " parent_tid: 0x" << std::hex << args->parent_thread_id << " sc_id: " << args->super_chunk->id();
-    BESStopWatch sw(TRANSFER_THREADS);
-    sw.start(timer_tag.str());
-#endif
-
-    args->super_chunk->read();
-    return true;
-}
-
-/**
- * @brief A single argument wrapper for process_super_chunk_unconstrained() for use with std::async().
- * @param args A unique_ptr to an instance of one_super_chunk_args.
- * @return True unless an exception is throw in which case neither true or false apply.
- */
-bool one_super_chunk_unconstrained_transfer_thread(unique_ptr<one_super_chunk_args> args)
-{
-
-#if DMRPP_ENABLE_THREAD_TIMERS
-    stringstream timer_tag;
-    timer_tag << prolog << "tid: 0x" << std::hex << std::this_thread::get_id() <<
-    " parent_tid: 0x" << std::hex << args->parent_thread_id  << " sc_id: " << args->super_chunk->id();
-    BESStopWatch sw(TRANSFER_THREADS);
-    sw.start(timer_tag.str());
-#endif
-
-    args->super_chunk->read_unconstrained();
-    return true;
-}
-
-
 bool start_one_child_chunk_thread(list<std::future<bool>> &futures, unique_ptr<one_child_chunk_args_new> args) {
     bool retval = false;
     std::unique_lock<std::mutex> lck (transfer_thread_pool_mtx);
     if (transfer_thread_counter < DmrppRequestHandler::d_max_transfer_threads) {
         transfer_thread_counter++;
-        futures.push_back( std::async(std::launch::async, one_child_chunk_thread_new, std::move(args)));
+        BESTraceContext trace = BESTrace::current();
+        futures.push_back( std::async(std::launch::async, [trace](unique_ptr<one_child_chunk_args_new> args) {
+            BESTraceScope scope(trace);
+            return one_child_chunk_thread_new(std::move(args));
+        }, std::move(args)));
         retval = true;
         BESDEBUG(dmrpp_3, prolog << "Got std::future '" << futures.size() <<
                                  "' from std::async for " << args->child_chunk->to_string() << endl);
@@ -256,139 +223,111 @@ bool start_one_child_chunk_thread(list<std::future<bool>> &futures, unique_ptr<o
 
 
 /**
- * @brief Starts the super_chunk_thread function using std::async() and places the returned future in the queue futures.
- * @param futures The queue into which to place the std::future returned by std::async().
- * @param args The arguments for the super_chunk_thread function
- * @return Returns true if the std::async() call was made and a future was returned, false if the
- * transfer_thread_counter has reached the maximum allowable size.
- */
-bool start_super_chunk_transfer_thread(list<std::future<bool>> &futures, unique_ptr<one_super_chunk_args> args) {
-    bool retval = false;
-    std::unique_lock<std::mutex> lck (transfer_thread_pool_mtx);
-    if (transfer_thread_counter < DmrppRequestHandler::d_max_transfer_threads) {
-        transfer_thread_counter++;
-        futures.push_back(std::async(std::launch::async, one_super_chunk_transfer_thread, std::move(args)));
-        retval = true;
-        BESDEBUG(dmrpp_3, prolog << "Got std::future '" << futures.size() <<
-                                            "' from std::async for " << args->super_chunk->to_string(false) << endl);
-    }
-    return retval;
-}
-
-/**
- * @brief Starts the one_super_chunk_unconstrained_transfer_thread function using std::async() and places the returned future in the queue futures.
- * @param futures The queue into which to place the future returned by std::async().
- * @param args The arguments for the super_chunk_thread function
- * @return Returns true if the async call was made and a future was returned, false if the transfer_thread_counter has
- * reached the maximum allowable size.
- */
-bool start_super_chunk_unconstrained_transfer_thread(list<std::future<bool>> &futures, unique_ptr<one_super_chunk_args> args) {
-    bool retval = false;
-    std::unique_lock<std::mutex> lck (transfer_thread_pool_mtx);
-    if(transfer_thread_counter < DmrppRequestHandler::d_max_transfer_threads) {
-        transfer_thread_counter++;
-        futures.push_back(std::async(std::launch::async, one_super_chunk_unconstrained_transfer_thread, std::move(args)));
-        retval = true;
-        BESDEBUG(dmrpp_3, prolog << "Got std::future '" << futures.size() <<
-                                            "' from std::async, transfer_thread_counter: " << transfer_thread_counter << endl);
-    }
-    return retval;
-}
-
-
-/**
- * @brief Uses std::async() and std::future to process the SuperChunks in super_chunks into the DmrppArray array.
+ * @brief Read the SuperChunks using the transfer and compute WorkStealingPools.
  *
- * For each SuperChunk in the queue, retrive the chunked data by using std::async() to generate a std::future which will
- * perform the data retrieval and subsequent computational steps(inflate/shuffle/etc) and finally insertion into the
- * DmrppArray's internal data buffer.
+ * Each SuperChunk is read by a task in the transfer pool. When its bytes have
+ * arrived, that task queues one task per child Chunk in the compute pool to
+ * inflate/unshuffle the Chunk and insert its values into the array. The two
+ * stages overlap: while some SuperChunks are still in transit, the Chunks of
+ * the ones that have arrived are being decompressed. The calling thread sleeps
+ * until the last task is done; there is no polling.
  *
- * NOTE: There are 4 variants of this function:
+ * When DMRPP.UseCurlMulti is set the transfers are run by the CurlMultiEngine
+ * instead of the transfer pool, so the number in flight is not limited by
+ * the number of transfer threads.
  *
- *  - process_chunks_concurrent()
- *  - process_chunks_unconstrained_concurrent()
- *  - read_super_chunks_concurrent()
- *  - read_super_chunks_unconstrained_concurrent
- *
- *  If structural/algorithmic changes need to be made to this function it is almost certain that similar changes will
- *  be required in the other 3 functions.
- *
- * @param super_chunks The queue of SuperChunk objects to process.
+ * @param super_chunks The queue of SuperChunk objects to process. Emptied by this function.
  * @param array The DmrppArray into which the chunk data will be placed.
+ * @param constrained True if the array is constrained, false if all of its chunks are read.
  */
-void read_super_chunks_unconstrained_concurrent(queue<shared_ptr<SuperChunk>> &super_chunks, DmrppArray *array)
+static void read_super_chunks_pipelined(queue<shared_ptr<SuperChunk>> &super_chunks, DmrppArray *array, bool constrained)
 {
-    BESStopWatch sw;
-    if (BESDebug::IsSet(TIMING_LOG_KEY)) sw.start(prolog + " name: "+array->name(), "");
-
-    // Parallel version based on read_chunks_unconstrained(). There is
-    // substantial duplication of the code in read_chunks_unconstrained(), but
-    // wait to remove that when we move to C++11 which has threads integrated.
-
-    // We maintain a list  of futures to track our parallel activities.
-    list<future<bool>> futures;
+    WorkStealingPool *transfer_pool = WorkStealingPool::TheTransferPool();
+    WorkStealingPool *compute_pool = WorkStealingPool::TheComputePool();
+    bool use_compute_pool = DmrppRequestHandler::d_use_compute_threads;
+    bool use_curl_multi = DmrppRequestHandler::d_use_curl_multi;
+
+    // The size in elements of each of the array's dimensions (constrained) and of the chunks.
+    const vector<unsigned long long> array_shape = array->get_shape(true);
+    const vector<unsigned long long> chunk_shape = array->get_chunk_dimension_sizes();
+
+    // Inflate/shuffle one chunk and copy its values into the array
+    auto process_chunk = [array, constrained, &array_shape, &chunk_shape](const shared_ptr<Chunk> &chunk) {
+        if (constrained)
+            process_one_chunk(chunk, array, array_shape);
+        else
+            process_one_chunk_unconstrained(chunk, chunk_shape, array, array_shape);
+    };
+
+    BESTraceSpan span("read_super_chunks");
+    span.set_attribute("super_chunks", super_chunks.size());
+    // The CurlMultiEngine runs completion handlers on its own thread
+    BESTraceContext trace = BESTrace::current();
+
+    TaskGroup group;
     try {
-        bool done = false;
-        bool future_finished = true;
-        while (!done) {
-
-            if(!futures.empty())
-                future_finished = get_next_future(futures, transfer_thread_counter, DMRPP_WAIT_FOR_FUTURE_MS, prolog);
-
-            // If future_finished is true this means that the chunk_processing_thread_counter has been decremented,
-            // because future::get() was called or a call to future::valid() returned false.
-            BESDEBUG(dmrpp_3, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
-
-            if (!super_chunks.empty()){
-                // Next we try to add a new Chunk compute thread if we can - there might be room.
-                bool thread_started = true;
-                while(thread_started && !super_chunks.empty()) {
-                    auto super_chunk = super_chunks.front();
-                    BESDEBUG(dmrpp_3, prolog << "Starting thread for " << super_chunk->to_string(false) << endl);
-
-                    auto args = unique_ptr<one_super_chunk_args>(new one_super_chunk_args(super_chunk, array));
-                    thread_started = start_super_chunk_unconstrained_transfer_thread(futures, std::move(args));
-
-                    if (thread_started) {
-                        super_chunks.pop();
-                        BESDEBUG(dmrpp_3, prolog << "STARTED thread for " << super_chunk->to_string(false) << endl);
-                    } else {
-                        // Thread did not start, ownership of the arguments was not passed to the thread.
-                        BESDEBUG(dmrpp_3, prolog << "Thread not started. args deleted, Chunk remains in queue.)" <<
-                                                            " transfer_thread_counter: " << transfer_thread_counter <<
-                                                            " futures.size(): " << futures.size() << endl);
-                    }
+        while (!super_chunks.empty()) {
+            auto super_chunk = super_chunks.front();
+            super_chunks.pop();
+            BESDEBUG(dmrpp_3, prolog << "Queuing transfer for " << super_chunk->to_string(false) << endl);
+
+            if (use_curl_multi) {
+                // The engine's event loop runs the transfer; its completion handler only
+                // queues the Chunks, it never processes them on the event loop thread.
+                group.task_started();
+                try {
+                    super_chunk->retrieve_data_async(
+                            [super_chunk, transfer_pool, compute_pool, use_compute_pool, &group, &process_chunk, trace]
+                                    (std::exception_ptr error) {
+                                BESTraceScope scope(trace);
+                                if (!error) {
+                                    for (const auto &chunk: super_chunk->get_chunks()) {
+                                        WorkStealingPool *pool = use_compute_pool ? compute_pool : transfer_pool;
+                                        // The chunk's data is in the SuperChunk's read buffer
+                                        group.run(*pool, [super_chunk, chunk, &process_chunk]() {
+                                            process_chunk(chunk);
+                                        });
+                                    }
+                                }
+                                group.task_finished(error);
+                            });
                 }
+                catch (...) {
+                    group.task_finished(std::current_exception());
+                    throw;
+                }
+                continue;
             }
-            else {
-                // No more Chunks and no futures means we're done here.
-                if(futures.empty())
-                    done = true;
-            }
-            future_finished = false;
+
+            group.run(*transfer_pool, [super_chunk, compute_pool, use_compute_pool, &group, &process_chunk]() {
+                super_chunk->retrieve_data();
+                for (const auto &chunk: super_chunk->get_chunks()) {
+                    // The chunk's data is in the SuperChunk's read buffer, which is freed
+                    // with the SuperChunk; this task may outlive the transfer task.
+                    if (use_compute_pool)
+                        group.run(*compute_pool, [super_chunk, chunk, &process_chunk]() { process_chunk(chunk); });
+                    else
+                        process_chunk(chunk);
+                }
+            });
         }
     }
     catch (...) {
-        // Complete all of the futures, otherwise we'll have threads out there using up resources
-        while(!futures.empty()){
-            if(futures.back().valid())
-                futures.back().get();
-            futures.pop_back();
-        }
-        // re-throw the exception
+        // The tasks already queued reference locals in this frame; let them finish.
+        try { group.wait(); } catch (...) { }
         throw;
     }
-}
-
 
+    group.wait();
 
+    BESDEBUG(dmrpp_3, prolog << "transfer pool - queue_depth: " << transfer_pool->queue_depth()
+                             << " steals: " << transfer_pool->steal_count() << endl);
+    BESDEBUG(dmrpp_3, prolog << "compute pool - queue_depth: " << compute_pool->queue_depth()
+                             << " steals: " << compute_pool->steal_count() << endl);
+}
 
 /**
- * @brief Uses std::async and std::future to process the SuperChunks in super_chunks into the DmrppArray array.
- *
- * For each SuperChunk in the queue, retrive the chunked data by using std::async() to generate a std::future which will
- * perform the data retrieval and subsequent computational steps(inflate/shuffle/etc) and finally insertion into the
- * DmrppArray's internal data buffer.
+ * @brief Read the SuperChunks of an unconstrained array concurrently.
  *
  * NOTE: There are 4 variants of this function:
  *
@@ -397,74 +336,33 @@ void read_super_chunks_unconstrained_concurrent(queue<shared_ptr<SuperChunk>> &s
  *  - read_super_chunks_concurrent()
  *  - read_super_chunks_unconstrained_concurrent
  *
- *  If structural/algorithmic changes need to be made to this function it is almost certain that similar changes will
- *  be required in the other 3 functions.
+ * The last two are both implemented by read_super_chunks_pipelined(), which
+ * uses the process-wide WorkStealingPools instead of starting new threads.
  *
  * @param super_chunks The queue of SuperChunk objects to process.
  * @param array The DmrppArray into which the chunk data will be placed.
  */
-void read_super_chunks_concurrent(queue<shared_ptr<SuperChunk>> &super_chunks, DmrppArray *array)
+void read_super_chunks_unconstrained_concurrent(queue<shared_ptr<SuperChunk>> &super_chunks, DmrppArray *array)
 {
     BESStopWatch sw;
     if (BESDebug::IsSet(TIMING_LOG_KEY)) sw.start(prolog + " name: "+array->name(), "");
 
-    // Parallel version based on read_chunks_unconstrained(). There is
-    // substantial duplication of the code in read_chunks_unconstrained(), but
-    // wait to remove that when we move to C++11 which has threads integrated.
+    read_super_chunks_pipelined(super_chunks, array, false);
+}
 
-    // We maintain a list  of futures to track our parallel activities.
-    list<future<bool>> futures;
-    try {
-        bool done = false;
-        bool future_finished = true;
-        while (!done) {
-
-            if(!futures.empty())
-                future_finished = get_next_future(futures, transfer_thread_counter, DMRPP_WAIT_FOR_FUTURE_MS, prolog);
-
-            // If future_finished is true this means that the chunk_processing_thread_counter has been decremented,
-            // because future::get() was called or a call to future::valid() returned false.
-            BESDEBUG(dmrpp_3, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
-
-            if (!super_chunks.empty()){
-                // Next we try to add a new Chunk compute thread if we can - there might be room.
-                bool thread_started = true;
-                while(thread_started && !super_chunks.empty()) {
-                    auto super_chunk = super_chunks.front();
-                    BESDEBUG(dmrpp_3, prolog << "Starting thread for " << super_chunk->to_string(false) << endl);
-
-                    auto args = unique_ptr<one_super_chunk_args>(new one_super_chunk_args(super_chunk, array));
-                    thread_started = start_super_chunk_transfer_thread(futures, std::move(args));
-
-                    if (thread_started) {
-                        super_chunks.pop();
-                        BESDEBUG(dmrpp_3, prolog << "STARTED thread for " << super_chunk->to_string(false) << endl);
-                    } else {
-                        // Thread did not start, ownership of the arguments was not passed to the thread.
-                        BESDEBUG(dmrpp_3, prolog << "Thread not started. args deleted, Chunk remains in queue.)" <<
-                                                            " transfer_thread_counter: " << transfer_thread_counter <<
-                                                            " futures.size(): " << futures.size() << endl);
-                    }
-                }
-            }
-            else {
-                // No more Chunks and no futures means we're done here.
-                if(futures.empty())
-                    done = true;
-            }
-            future_finished = false;
-        }
-    }
-    catch (...) {
-        // Complete all of the futures, otherwise we'll have threads out there using up resources
-        while(!futures.empty()){
-            if(futures.back().valid())
-                futures.back().get();
-            futures.pop_back();
-        }
-        // re-throw the exception
-        throw;
-    }
+/**
+ * @brief Read the SuperChunks of a constrained array concurrently.
+ *
+ * @see read_super_chunks_unconstrained_concurrent()
+ * @param super_chunks The queue of SuperChunk objects to process.
+ * @param array The DmrppArray into which the chunk data will be placed.
+ */
+void read_super_chunks_concurrent(queue<shared_ptr<SuperChunk>> &super_chunks, DmrppArray *array)
+{
+    BESStopWatch sw;
+    if (BESDebug::IsSet(TIMING_LOG_KEY)) sw.start(prolog + " name: "+array->name(), "");
+
+    read_super_chunks_pipelined(super_chunks, array, true);
 }
 
 /**
@@ -551,6 +449,8 @@ static unsigned long multiplier(const vector<unsigned long long> &shape, unsigne
 
 void DmrppArray::_duplicate(const DmrppArray &)
 {
+    // The index refers to the chunks by number; rebuild it when it's needed.
+    d_chunk_index.reset();
 }
 
 DmrppArray::DmrppArray(const string &n, BaseType *v) :
@@ -667,7 +567,7 @@ void DmrppArray::insert_constrained_contiguous(Dim_iter dim_iter, unsigned long
                                                vector<unsigned long long> &subset_addr,
                                                const vector<unsigned long long> &array_shape, char /*Chunk*/*src_buf)
 {
-    BESDEBUG("dmrpp", "DmrppArray::" << __func__ << "() - subsetAddress.size(): " << subset_addr.size() << endl);
+    BESDEBUG(dmrpp_1, "DmrppArray::" << __func__ << "() - subsetAddress.size(): " << subset_addr.size() << endl);
 
     unsigned int bytes_per_elem = prototype()->width();
 
@@ -862,8 +762,8 @@ void DmrppArray::read_contiguous()
     }
 
     // Now that the_one_chunk has been read, we do the needful...
-    if (is_deflate_compression() || is_shuffle_compression())
-       the_one_chunk->inflate_chunk(is_deflate_compression(), is_shuffle_compression(), get_chunk_size_in_elements(),var()->width());
+    the_one_chunk->filter_chunk(get_filters(), get_chunk_size_in_elements(), var()->width(),
+                                is_integer_type(var()->type()));
 
     // The 'the_one_chunk' now holds the data values. Transfer it to the Array.
     if (!is_projected()) {  // if there is no projection constraint
@@ -947,6 +847,63 @@ void DmrppArray::insert_chunk_unconstrained(shared_ptr<Chunk> chunk, unsigned in
     }
 }
 
+/**
+ * @brief Point each chunk that is one run of the array's values at its place in the array.
+ *
+ * Chunks with a destination are decoded (or, if not compressed, read) straight into
+ * the array's buffer and are not copied by insert_chunk_unconstrained(). A chunk is
+ * one run of values when its leading dimensions are all 1 except for one, k, and the
+ * dimensions after k are the same size as the array's. For example, chunks of a
+ * [time][lat][lon] array that hold one or more whole [lat][lon] planes, or part of
+ * one [lon] row. The last chunk along k is padded past the end of the array, so it's
+ * left to insert_chunk_unconstrained().
+ *
+ * @param array_shape The size of the array's dimensions
+ * @param chunk_shape The size of the chunk's dimensions
+ * @return True if any chunk was given a destination.
+ */
+bool DmrppArray::set_chunk_destinations(const vector<unsigned long long> &array_shape,
+                                        const vector<unsigned long long> &chunk_shape)
+{
+    char *buf = get_buf();
+    if (!DmrppRequestHandler::d_direct_chunk_placement || !buf || chunk_shape.size() != array_shape.size())
+        return false;
+
+    unsigned int rank = chunk_shape.size();
+    unsigned int k = 0;
+    while (k < rank - 1 && chunk_shape[k] == 1)
+        ++k;
+
+    for (unsigned int dim = k + 1; dim < rank; ++dim) {
+        if (chunk_shape[dim] != array_shape[dim])
+            return false;
+    }
+
+    unsigned int elem_width = prototype()->width();
+    bool placed = false;
+    for (const auto &chunk: get_chunks()) {
+        const vector<unsigned long long> &chunk_origin = chunk->get_position_in_array();
+        if (chunk_origin[k] + chunk_shape[k] > array_shape[k])
+            continue;
+
+        chunk->set_destination(buf + get_index(chunk_origin, array_shape) * elem_width);
+        placed = true;
+    }
+
+    BESDEBUG(dmrpp_3, prolog << name() << ": " << (placed ? "chunks are" : "no chunks are")
+                             << " decoded into the array." << endl);
+    return placed;
+}
+
+/**
+ * @brief Forget the chunks' destinations; the array's buffer may change after read().
+ */
+void DmrppArray::clear_chunk_destinations()
+{
+    for (const auto &chunk: get_chunks())
+        chunk->set_destination(nullptr);
+}
+
 /**
  * @brief Read data for an unconstrained chunked array
  *
@@ -996,31 +953,39 @@ void DmrppArray::read_chunks_unconstrained()
     // The size, in elements, of each of the chunk's dimensions
     const vector<unsigned long long> chunk_shape = get_chunk_dimension_sizes();
 
+    bool placed = set_chunk_destinations(array_shape, chunk_shape);
+    try {
+        BESDEBUG(dmrpp_3, prolog << "d_use_transfer_threads: " << (DmrppRequestHandler::d_use_transfer_threads ? "true" : "false") << endl);
+        BESDEBUG(dmrpp_3, prolog << "d_max_transfer_threads: " << DmrppRequestHandler::d_max_transfer_threads << endl);
 
-    BESDEBUG(dmrpp_3, prolog << "d_use_transfer_threads: " << (DmrppRequestHandler::d_use_transfer_threads ? "true" : "false") << endl);
-    BESDEBUG(dmrpp_3, prolog << "d_max_transfer_threads: " << DmrppRequestHandler::d_max_transfer_threads << endl);
-
-    if (!DmrppRequestHandler::d_use_transfer_threads) {  // Serial transfers
+        if (!DmrppRequestHandler::d_use_transfer_threads) {  // Serial transfers
 #if DMRPP_ENABLE_THREAD_TIMERS
-        BESStopWatch sw(dmrpp_3);
-        sw.start(prolog + "Serial SuperChunk Processing.");
+            BESStopWatch sw(dmrpp_3.name());
+            sw.start(prolog + "Serial SuperChunk Processing.");
 #endif
-        while(!super_chunks.empty()) {
-            auto super_chunk = super_chunks.front();
-            super_chunks.pop();
-            BESDEBUG(dmrpp_3, prolog << super_chunk->to_string(true) << endl );
-            super_chunk->read();
+            while(!super_chunks.empty()) {
+                auto super_chunk = super_chunks.front();
+                super_chunks.pop();
+                BESDEBUG(dmrpp_3, prolog << super_chunk->to_string(true) << endl );
+                super_chunk->read();
+            }
         }
-    }
-    else {      // Parallel transfers
+        else {      // Parallel transfers
 #if DMRPP_ENABLE_THREAD_TIMERS
-        stringstream timer_name;
-        timer_name << prolog << "Concurrent SuperChunk Processing. d_max_transfer_threads: " << DmrppRequestHandler::d_max_transfer_threads;
-        BESStopWatch sw(dmrpp_3);
-        sw.start(timer_name.str());
+            stringstream timer_name;
+            timer_name << prolog << "Concurrent SuperChunk Processing. d_max_transfer_threads: " << DmrppRequestHandler::d_max_transfer_threads;
+            BESStopWatch sw(dmrpp_3.name());
+            sw.start(timer_name.str());
 #endif
-        read_super_chunks_unconstrained_concurrent(super_chunks, this);
+            read_super_chunks_unconstrained_concurrent(super_chunks, this);
+        }
     }
+    catch (...) {
+        if (placed) clear_chunk_destinations();
+        throw;
+    }
+
+    if (placed) clear_chunk_destinations();
     set_read_p(true);
 }
 
@@ -1246,6 +1211,31 @@ void DmrppArray::insert_chunk(
 
 
 
+/**
+ * @brief The index of this array's chunks, built the first time it's needed
+ *
+ * The index of chunks read from a binary DMR++ file is shared by every
+ * request for that file; see ChunkIndex::find_or_make().
+ *
+ * @param chunks The array's chunks
+ */
+const ChunkIndex &DmrppArray::get_chunk_index(const vector<shared_ptr<Chunk>> &chunks)
+{
+    if (!d_chunk_index || d_chunk_index->size() != chunks.size()) {
+        vector<unsigned long long> array_shape;
+        for (auto dim = dim_begin(), end = dim_end(); dim != end; ++dim)
+            array_shape.push_back(dim->size);
+
+        if (!get_chunk_table_key().empty())
+            d_chunk_index = ChunkIndex::find_or_make(get_chunk_table_key(), chunks, get_chunk_dimension_sizes(),
+                array_shape);
+        else
+            d_chunk_index = make_shared<ChunkIndex>(chunks, get_chunk_dimension_sizes(), array_shape);
+    }
+
+    return *d_chunk_index;
+}
+
 /**
  * @brief Read chunked data by building SuperChunks from the required chunks and reading the SuperChunks
  *
@@ -1271,9 +1261,21 @@ void DmrppArray::read_chunks()
     //  the current offset. When an add_chunk() call fails, prior to making a new SuperChunk
     //  we might want want try adding the rejected Chunk to the other existing SuperChunks to see
     //  if it's contiguous there.
-    // Find the required Chunks and put them into SuperChunks.
-    for(const auto& chunk: get_chunks()){
-        vector<unsigned long long> target_element_address = chunk->get_position_in_array();
+    // Find the required Chunks and put them into SuperChunks. The index finds
+    // the chunks that intersect the constraint without looking at the others;
+    // find_needed_chunks() then checks those against the constraint's strides.
+    vector<pair<uint64_t, uint64_t>> ranges;
+    for (auto dim = dim_begin(), end = dim_end(); dim != end; ++dim)
+        ranges.push_back(make_pair((uint64_t) dim->start, (uint64_t) dim->stop));
+
+    vector<uint64_t> candidates;
+    get_chunk_index(chunk_refs).find(ranges, candidates);
+    BESDEBUG(dmrpp_3, prolog << "The constraint intersects " << candidates.size() << " of " << chunk_refs.size()
+        << " chunks." << endl);
+
+    vector<unsigned long long> target_element_address(ranges.size());
+    for (auto i: candidates) {
+        const auto &chunk = chunk_refs[i];
         auto needed = find_needed_chunks(0 /* dimension */, &target_element_address, chunk);
         if (needed){
             bool added = current_super_chunk->add_chunk(chunk);
@@ -1303,7 +1305,7 @@ void DmrppArray::read_chunks()
         // This version is the 'serial' version of the code. It reads a chunk, inserts it,
         // reads the next one, and so on.
 #if DMRPP_ENABLE_THREAD_TIMERS
-        BESStopWatch sw(dmrpp_3);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(prolog + "Serial SuperChunk Processing.");
 #endif
         while (!super_chunks.empty()) {
@@ -1317,7 +1319,7 @@ void DmrppArray::read_chunks()
 #if DMRPP_ENABLE_THREAD_TIMERS
         stringstream timer_name;
         timer_name << prolog << "Concurrent SuperChunk Processing. d_max_transfer_threads: " << DmrppRequestHandler::d_max_transfer_threads;
-        BESStopWatch sw(dmrpp_3);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(timer_name.str());
 #endif
         read_super_chunks_concurrent(super_chunks, this);
@@ -1351,7 +1353,7 @@ void DmrppArray::read_chunks()
 void DmrppArray::insert_chunk_serial(unsigned int dim, vector<unsigned int> *target_element_address, vector<unsigned int> *chunk_element_address,
     Chunk *chunk)
 {
-    BESDEBUG("dmrpp", __func__ << " dim: "<< dim << " BEGIN "<< endl);
+    BESDEBUG(dmrpp_1, __func__ << " dim: "<< dim << " BEGIN "<< endl);
 
     // The size, in elements, of each of the chunk's dimensions.
     const vector<unsigned int> &chunk_shape = get_chunk_dimension_sizes();
@@ -1389,7 +1391,7 @@ void DmrppArray::insert_chunk_serial(unsigned int dim, vector<unsigned int> *tar
         // Read and Process chunk
         chunk->read_chunk();
 
-        chunk->inflate_chunk(is_deflate_compression(), is_shuffle_compression(), get_chunk_size_in_elements(), var()->width());
+        chunk->filter_chunk(get_filters(), get_chunk_size_in_elements(), var()->width(), is_integer_type(var()->type()));
 
         char *source_buffer = chunk->get_rbuf();
         char *target_buffer = get_buf();
@@ -1441,7 +1443,7 @@ void DmrppArray::insert_chunk_serial(unsigned int dim, vector<unsigned int> *tar
 
 void DmrppArray::read_chunks_serial()
 {
-    BESDEBUG("dmrpp", __func__ << " for variable '" << name() << "' - BEGIN" << endl);
+    BESDEBUG(dmrpp_1, __func__ << " for variable '" << name() << "' - BEGIN" << endl);
 
     vector<Chunk> &chunk_refs = get_chunk_vec();
     if (chunk_refs.size() == 0) throw BESInternalError(string("Expected one or more chunks for variable ") + name(), __FILE__, __LINE__);
@@ -1467,7 +1469,7 @@ void DmrppArray::read_chunks_serial()
 
     set_read_p(true);
 
-    BESDEBUG("dmrpp", "DmrppArray::"<< __func__ << "() for " << name() << " END"<< endl);
+    BESDEBUG(dmrpp_1, "DmrppArray::"<< __func__ << "() for " << name() << " END"<< endl);
 }
 #endif
 
@@ -1687,7 +1689,7 @@ void DmrppArray::print_dap4(XMLWriter &xml, bool constrained /*false*/)
 
     // Only print the chunks info if there. This is the code added to libdap::Array::print_dap4().
     // jhrg 5/10/18
-    if (DmrppCommon::d_print_chunks && get_immutable_chunks().size() > 0)
+    if (DmrppCommon::d_print_chunks && get_chunk_count() > 0)
         print_chunks_element(xml, DmrppCommon::d_ns_prefix);
 
     // If this variable uses the COMPACT layout, encode the values for
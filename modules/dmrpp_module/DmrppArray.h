@@ -37,6 +37,7 @@
 
 #include "DmrppCommon.h"
 #include "SuperChunk.h"
+#include "ChunkIndex.h"
 
 // The 'read_serial()' method is more closely related to the original code
 // used to read data when the DMR++ handler was initially developed for NASA.
@@ -68,6 +69,9 @@ namespace dmrpp {
 class DmrppArray : public libdap::Array, public dmrpp::DmrppCommon {
 
 private:
+    // Built the first time a subset of the chunked array is read
+    std::shared_ptr<const ChunkIndex> d_chunk_index;
+
     void _duplicate(const DmrppArray &ts);
 
     bool is_projected();
@@ -106,6 +110,12 @@ private:
     void read_chunks();
     void read_chunks_unconstrained();
 
+    const ChunkIndex &get_chunk_index(const std::vector<std::shared_ptr<Chunk>> &chunks);
+
+    bool set_chunk_destinations(const std::vector<unsigned long long> &array_shape,
+                                const std::vector<unsigned long long> &chunk_shape);
+    void clear_chunk_destinations();
+
     unsigned long long get_chunk_start(const dimension &thisDim, unsigned int chunk_origin_for_dim);
 
     std::shared_ptr<Chunk> find_needed_chunks(unsigned int dim, std::vector<unsigned long long> *target_element_address, std::shared_ptr<Chunk> chunk);
@@ -144,19 +154,6 @@ private:
     virtual void dump(ostream &strm) const;
 };
 
-/**
- * Args for threads that process SuperChunks, constrained or not.
- */
-struct one_super_chunk_args {
-    std::thread::id parent_thread_id;
-    std::shared_ptr<SuperChunk> super_chunk;
-    DmrppArray *array;
-
-    one_super_chunk_args(std::shared_ptr<SuperChunk> sc, DmrppArray *a)
-            : parent_thread_id(std::this_thread::get_id()), super_chunk(std::move(sc)), array(a) {}
-};
-
-
 /**
  * Chunk data insert args for use with pthreads. Used for reading contiguous data
  * in parallel.
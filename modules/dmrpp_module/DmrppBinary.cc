@@ -0,0 +1,354 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <DMR.h>
+#include <D4Group.h>
+#include <Constructor.h>
+#include <BaseType.h>
+#include <XMLWriter.h>
+
+#include <BESInternalError.h>
+#include <BESDebug.h>
+
+#include "DMRpp.h"
+#include "DmrppCommon.h"
+#include "DmrppNames.h"
+#include "DmrppTypeFactory.h"
+#include "DmrppParserSax2.h"
+#include "ChunkTable.h"
+#include "DmrppBinary.h"
+
+using namespace std;
+using namespace libdap;
+
+#define prolog std::string("DmrppBinary::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+namespace {
+
+const char binary_magic[8] = { 'D', 'M', 'R', 'P', 'P', 'B', 'I', 'N' };
+const uint32_t byte_order_mark = 0x01020304;
+
+struct binary_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t xml_offset;
+    uint64_t xml_size;
+    uint64_t tables_offset;
+    uint64_t num_tables;
+};
+
+static_assert(sizeof(binary_header) == 48, "The binary DMR++ header must be 48 bytes");
+
+const char zeros[8] = { 0 };
+
+uint64_t padding(uint64_t n)
+{
+    return n % 8 ? 8 - n % 8 : 0;
+}
+
+// Restore DmrppCommon::d_print_chunk_tables_only, even if printing throws
+class PrintChunkTablesOnly {
+    bool d_saved;
+public:
+    PrintChunkTablesOnly() : d_saved(DmrppCommon::d_print_chunk_tables_only)
+    {
+        DmrppCommon::d_print_chunk_tables_only = true;
+    }
+
+    ~PrintChunkTablesOnly()
+    {
+        DmrppCommon::d_print_chunk_tables_only = d_saved;
+    }
+};
+
+} // namespace
+
+void DmrppBinary::add_variable(BaseType *btp, vector<BaseType *> &vars)
+{
+    if (dynamic_cast<DmrppCommon *>(btp))
+        vars.push_back(btp);
+
+    if (btp->is_constructor_type()) {
+        Constructor *c = static_cast<Constructor *>(btp);
+        for (auto i = c->var_begin(), e = c->var_end(); i != e; ++i)
+            add_variable(*i, vars);
+    }
+}
+
+/**
+ * @brief The variables that can have chunks, in the order the tables refer to them
+ *
+ * The variables of each group (and the members of its Structures) come
+ * before those of its child groups.
+ *
+ * @param group Start here
+ * @param vars Value-result parameter; the variables are appended
+ */
+void DmrppBinary::get_variables(D4Group *group, vector<BaseType *> &vars)
+{
+    for (auto i = group->var_begin(), e = group->var_end(); i != e; ++i)
+        add_variable(*i, vars);
+
+    for (auto g = group->grp_begin(), e = group->grp_end(); g != e; ++g)
+        get_variables(*g, vars);
+}
+
+/// @brief Does this buffer hold a binary DMR++?
+bool DmrppBinary::is_binary(const char *data, size_t size)
+{
+    return data && size >= sizeof(binary_header) && memcmp(data, binary_magic, sizeof(binary_magic)) == 0;
+}
+
+/// @brief Is this file a binary DMR++? False if it cannot be read.
+bool DmrppBinary::is_binary_file(const string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    char buf[sizeof(binary_header)];
+    ssize_t bytes = pread(fd, buf, sizeof(buf), 0);
+    close(fd);
+
+    return bytes == sizeof(buf) && is_binary(buf, sizeof(buf));
+}
+
+/**
+ * @brief Write a DMR++ as a binary DMR++
+ *
+ * The variables' chunks are written from their ChunkTables; variables whose
+ * Chunks were added one at a time (e.g., by build_dmrpp) get a table made
+ * from the Chunks.
+ *
+ * @param dmrpp The DMR++
+ * @param href The dataset's dmrpp:href; chunks that read from this URL are
+ * written without an href.
+ * @param os Write here; open it in binary mode.
+ * @exception BESInternalError if the stream cannot be written
+ */
+void DmrppBinary::write(DMRpp &dmrpp, const string &href, ostream &os)
+{
+    XMLWriter xml;
+    {
+        PrintChunkTablesOnly tables_only;
+        dmrpp.print_dmrpp(xml, href, false /*constrained*/, true /*print_chunks*/);
+    }
+    string doc = xml.get_doc();
+
+    vector<BaseType *> vars;
+    get_variables(dmrpp.root(), vars);
+
+    vector<pair<uint64_t, shared_ptr<const ChunkTable>>> tables;
+    for (uint64_t i = 0; i < vars.size(); ++i) {
+        DmrppCommon *dc = dynamic_cast<DmrppCommon *>(vars[i]);
+        shared_ptr<const ChunkTable> table = dc->get_chunk_table();
+        if (!table) {
+            vector<shared_ptr<Chunk>> chunks = dc->get_immutable_chunks();
+            if (chunks.empty())
+                continue;
+            table = ChunkTable::from_chunks(chunks, href);
+        }
+        tables.push_back(make_pair(i, table));
+    }
+
+    binary_header header;
+    memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = version;
+    header.byte_order_mark = byte_order_mark;
+    header.xml_offset = sizeof(binary_header);
+    header.xml_size = doc.size();
+    header.tables_offset = header.xml_offset + doc.size() + padding(doc.size());
+    header.num_tables = tables.size();
+
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    os.write(doc.data(), doc.size());
+    os.write(zeros, padding(doc.size()));
+
+    for (const auto &entry: tables) {
+        string fqn = vars[entry.first]->FQN();
+        uint64_t index = entry.first;
+        uint32_t fqn_length = fqn.size();
+        uint32_t zero = 0;
+        os.write(reinterpret_cast<const char *>(&index), sizeof(index));
+        os.write(reinterpret_cast<const char *>(&fqn_length), sizeof(fqn_length));
+        os.write(reinterpret_cast<const char *>(&zero), sizeof(zero));
+        os.write(fqn.data(), fqn.size());
+        os.write(zeros, padding(fqn.size()));
+
+        entry.second->write(os);
+    }
+
+    if (!os)
+        throw BESInternalError(prolog + "Could not write the binary DMR++.", __FILE__, __LINE__);
+
+    BESDEBUG(MODULE, prolog << "Wrote " << doc.size() << " bytes of XML and " << tables.size() << " chunk tables." << endl);
+}
+
+/**
+ * @brief Convert a DMR++ XML document to a binary DMR++
+ * @param document The DMR++ XML
+ * @param os Write the binary DMR++ here
+ */
+void DmrppBinary::convert(const string &document, ostream &os)
+{
+    DmrppTypeFactory factory;
+    DMRpp dmrpp(&factory);
+
+    DmrppParserSax2 parser;
+    parser.intern(document, &dmrpp);
+
+    write(dmrpp, parser.get_dmrpp_dataset_href(), os);
+}
+
+/**
+ * @brief Build a DMR from a binary DMR++
+ *
+ * The variables get their chunks as ChunkTables that point into \arg data;
+ * the tables keep \arg data alive.
+ *
+ * @param data The binary DMR++; must be 8-byte aligned
+ * @param size The number of bytes in \arg data
+ * @param dmr Value-result parameter. Its factory must make the DMR++ types.
+ * @param source Names \arg data, e.g. the file it was read from. If given,
+ * each table's key (see ChunkTable::get_key()) is this and the table's
+ * offset, so things made from the table can be kept for the next time the
+ * same file is read.
+ * @exception BESInternalError if the binary DMR++ is malformed or was
+ * written on a host with a different byte order.
+ */
+void DmrppBinary::read(const shared_ptr<const char> &data, size_t size, DMR *dmr, const string &source)
+{
+    if (!is_binary(data.get(), size))
+        throw BESInternalError(prolog + "Not a binary DMR++.", __FILE__, __LINE__);
+
+    binary_header header;
+    memcpy(&header, data.get(), sizeof(header));
+
+    if (header.version != version)
+        throw BESInternalError(prolog + "Unsupported binary DMR++ version: " + to_string(header.version), __FILE__,
+            __LINE__);
+
+    if (header.byte_order_mark != byte_order_mark)
+        throw BESInternalError(prolog + "The binary DMR++ was written on a host with a different byte order.",
+            __FILE__, __LINE__);
+
+    if (header.xml_offset > size || header.xml_size > size - header.xml_offset || header.xml_size > INT_MAX
+        || header.tables_offset > size)
+        throw BESInternalError(prolog + "The binary DMR++ is truncated.", __FILE__, __LINE__);
+
+    DmrppParserSax2 parser;
+    parser.intern(data.get() + header.xml_offset, (int) header.xml_size, dmr);
+
+    vector<BaseType *> vars;
+    get_variables(dmr->root(), vars);
+
+    const char *pos = data.get() + header.tables_offset;
+    const char *end = data.get() + size;
+    for (uint64_t n = 0; n < header.num_tables; ++n) {
+        uint64_t index;
+        uint32_t fqn_length;
+        if (end - pos < 16)
+            throw BESInternalError(prolog + "The binary DMR++ is truncated.", __FILE__, __LINE__);
+        memcpy(&index, pos, sizeof(index));
+        memcpy(&fqn_length, pos + 8, sizeof(fqn_length));
+        pos += 16;
+
+        if ((uint64_t) (end - pos) < fqn_length)
+            throw BESInternalError(prolog + "The binary DMR++ is truncated.", __FILE__, __LINE__);
+        string fqn(pos, fqn_length);
+        pos += fqn_length + padding(fqn_length);
+
+        if (index >= vars.size() || vars[index]->FQN() != fqn)
+            throw BESInternalError(prolog + "The binary DMR++ chunk table for '" + fqn + "' does not match a variable.",
+                __FILE__, __LINE__);
+
+        size_t table_offset = pos - data.get();
+        shared_ptr<ChunkTable> table = ChunkTable::read(data, pos, end);
+        if (!source.empty())
+            table->set_key(source + '@' + to_string(table_offset));
+        table->resolve_urls([&parser](const string &href) { return parser.get_data_url(href); });
+        dynamic_cast<DmrppCommon *>(vars[index])->set_chunk_table(table);
+    }
+
+    BESDEBUG(MODULE, prolog << "Read " << header.num_tables << " chunk tables." << endl);
+}
+
+/**
+ * @brief Build a DMR from a binary DMR++ file
+ *
+ * The file is memory-mapped, so the pages holding the chunk tables of
+ * variables that are not read are never read.
+ *
+ * @param path The binary DMR++ file
+ * @param dmr Value-result parameter. Its factory must make the DMR++ types.
+ */
+void DmrppBinary::read_file(const string &path, DMR *dmr)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw BESInternalError(prolog + "Could not open '" + path + "': " + strerror(errno), __FILE__, __LINE__);
+
+    struct stat sb;
+    if (fstat(fd, &sb) != 0 || sb.st_size == 0) {
+        close(fd);
+        throw BESInternalError(prolog + "Could not read '" + path + "'.", __FILE__, __LINE__);
+    }
+
+    size_t size = sb.st_size;
+    void *addr = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        throw BESInternalError(prolog + "Could not map '" + path + "': " + strerror(errno), __FILE__, __LINE__);
+
+    shared_ptr<const char> data(static_cast<const char *>(addr),
+        [size](const char *p) { munmap(const_cast<char *>(p), size); });
+
+    BESDEBUG(MODULE, prolog << "Mapped " << size << " bytes from " << path << endl);
+
+    // A file replaced by another has a new inode or modification time
+    ostringstream source;
+    source << path << ':' << sb.st_dev << ':' << sb.st_ino << ':' << sb.st_size << ':' << sb.st_mtime;
+
+    read(data, size, dmr, source.str());
+}
+
+} // namespace dmrpp
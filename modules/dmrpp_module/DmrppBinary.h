@@ -0,0 +1,88 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _DmrppBinary_h
+#define _DmrppBinary_h 1
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace libdap {
+class DMR;
+class D4Group;
+class BaseType;
+}
+
+namespace dmrpp {
+
+class DMRpp;
+
+/**
+ * @brief Read and write binary DMR++ documents
+ *
+ * Nearly all of a large DMR++ document is dmrpp:chunk elements. A binary
+ * DMR++ holds the document without them - the variables, attributes and
+ * the dmrpp:chunks elements with the compression, byte order and chunk
+ * sizes - followed by a ChunkTable for each variable. The XML is small and
+ * quick to parse, and the tables are used as they are, from a memory-mapped
+ * file, so the Chunks of a variable are made only if it is read.
+ *
+ * The layout, in the byte order of the host that wrote it; the XML and each
+ * table start on an 8-byte boundary:
+ *
+ *   "DMRPPBIN", uint32_t version, uint32_t byte order mark (0x01020304),
+ *   uint64_t offset and size of the XML, uint64_t offset and number of the tables;
+ *   the DMR++ XML without the dmrpp:chunk elements;
+ *   for each variable with chunks: uint64_t the variable's index (see
+ *   get_variables()), uint32_t length of the variable's FQN, uint32_t zero,
+ *   the FQN, padding and the ChunkTable.
+ *
+ * A file written on a host with the other byte order is rejected; remake it
+ * from the XML.
+ */
+class DmrppBinary {
+private:
+    static void add_variable(libdap::BaseType *btp, std::vector<libdap::BaseType *> &vars);
+
+public:
+    static const unsigned int version = 1;
+
+    static void get_variables(libdap::D4Group *group, std::vector<libdap::BaseType *> &vars);
+
+    static bool is_binary(const char *data, size_t size);
+    static bool is_binary_file(const std::string &path);
+
+    static void write(DMRpp &dmrpp, const std::string &href, std::ostream &os);
+    static void convert(const std::string &document, std::ostream &os);
+
+    static void read(const std::shared_ptr<const char> &data, size_t size, libdap::DMR *dmr,
+        const std::string &source = "");
+    static void read_file(const std::string &path, libdap::DMR *dmr);
+};
+
+} // namespace dmrpp
+
+#endif // _DmrppBinary_h
@@ -26,6 +26,7 @@
 #include <sstream>
 #include <vector>
 #include <iterator>
+#include <mutex>
 #include <cstdlib>
 #include <cstring>
 
@@ -44,6 +45,7 @@
 #include "DmrppCommon.h"
 #include "DmrppArray.h"
 #include "Chunk.h"
+#include "FilterRegistry.h"
 #include "util.h"
 
 using namespace std;
@@ -58,6 +60,7 @@ static const string dmrpp_3 = "dmrpp:3";
 static const string dmrpp_4 = "dmrpp:4";
 
 bool DmrppCommon::d_print_chunks = false;
+bool DmrppCommon::d_print_chunk_tables_only = false;
 string DmrppCommon::d_dmrpp_ns = "http://xml.opendap.org/dap/dmrpp/1.0.0#";
 string DmrppCommon::d_ns_prefix = "dmrpp";
 
@@ -136,10 +139,14 @@ void DmrppCommon::parse_chunk_dimension_sizes(const string &chunk_dims_string)
 }
 
 /**
- * @brief Parses the text content of the XML element h4:chunkDimensionSizes
- * into the internal vector<unsigned int> representation.
+ * @brief Parses the text content of the XML attribute compressionType.
  *
- * @param compression_type_string One of "deflate" or "shuffle."
+ * The value is a list of filter names separated by spaces or commas, e.g.,
+ * "deflate shuffle". Besides "deflate" and "shuffle", any name known to the
+ * FilterRegistry is accepted. Names that are not known are remembered so that
+ * reading the data fails with a useful message; the metadata can still be used.
+ *
+ * @param compression_type_string The filter names.
  */
 void DmrppCommon::ingest_compression_type(const string &compression_type_string)
 {
@@ -148,18 +155,63 @@ void DmrppCommon::ingest_compression_type(const string &compression_type_string)
     // Clear previous state
     d_deflate = false;
     d_shuffle = false;
+    d_filters.clear();
+    d_unsupported_filters.clear();
 
     string deflate("deflate");
     string shuffle("shuffle");
 
     // Process content
-    if (compression_type_string.find(deflate) != string::npos) {
-        d_deflate = true;
+    istringstream iss(compression_type_string);
+    string word;
+    while (getline(iss, word, ' ')) {
+        istringstream names(word);
+        string name;
+        while (getline(names, name, ',')) {
+            if (name.empty())
+                continue;
+
+            if (name == deflate) {
+                d_deflate = true;
+            }
+            else if (name == shuffle) {
+                d_shuffle = true;
+            }
+            else {
+                const filter_info *info = FilterRegistry::TheRegistry()->find(name);
+                if (info) {
+                    d_filters.push_back(info->id);
+                }
+                else {
+                    BESDEBUG(dmrpp_3, prolog << "Unknown compression type: " << name << endl);
+                    d_unsupported_filters.append(d_unsupported_filters.empty() ? "" : " ").append(name);
+                }
+            }
+        }
     }
+}
 
-    if (compression_type_string.find(shuffle) != string::npos) {
-        d_shuffle = true;
-    }
+/**
+ * @brief The HDF5 ids of all the filters used to encode this variable's data.
+ *
+ * This is the list to pass to Chunk::filter_chunk().
+ *
+ * @exception BESInternalError if the DMR++ named a filter this handler does
+ * not know.
+ */
+vector<unsigned int> DmrppCommon::get_filters() const
+{
+    if (!d_unsupported_filters.empty())
+        throw BESInternalError(prolog + "Unsupported compression type(s): " + d_unsupported_filters, __FILE__, __LINE__);
+
+    vector<unsigned int> filters;
+    if (is_deflate_compression())
+        filters.push_back(FILTER_DEFLATE);
+    if (is_shuffle_compression())
+        filters.push_back(FILTER_SHUFFLE);
+    filters.insert(filters.end(), d_filters.begin(), d_filters.end());
+
+    return filters;
 }
 
 /**
@@ -216,6 +268,8 @@ unsigned long DmrppCommon::add_chunk(
         unsigned long long offset,
         const vector<unsigned long long> &position_in_array)
 {
+    load_chunks();
+
     std::shared_ptr<Chunk> chunk(new Chunk(data_url, byte_order, size, offset, position_in_array));
 #if 0
     auto array = dynamic_cast<dmrpp::DmrppArray *>(this);
@@ -260,9 +314,54 @@ unsigned long DmrppCommon::add_chunk(
 #endif
 
     d_chunks.push_back(chunk);
+    d_chunk_table_key.clear();
     return d_chunks.size();
 }
 
+// Serializes making the Chunks of a variable from its ChunkTable
+static std::mutex chunk_table_mtx;
+
+/**
+ * @brief Make the Chunks from the ChunkTable
+ *
+ * The parser stores a variable's chunks in a ChunkTable and the Chunk
+ * objects are made only when something asks for them, so the chunks of
+ * variables a request does not read are never made.
+ */
+void DmrppCommon::load_chunks() const
+{
+    std::lock_guard<std::mutex> lock(chunk_table_mtx);
+    if (d_chunk_table) {
+        d_chunk_table->make_chunks(d_chunks);
+        d_chunk_table.reset();
+    }
+}
+
+/**
+ * @brief Set the chunks for this variable using a ChunkTable
+ *
+ * The Chunk objects are made from the table the first time get_chunks() or
+ * get_immutable_chunks() is called.
+ *
+ * @param table The chunks; replaces any chunks already added.
+ */
+void DmrppCommon::set_chunk_table(std::shared_ptr<const ChunkTable> table)
+{
+    std::lock_guard<std::mutex> lock(chunk_table_mtx);
+    d_chunks.clear();
+    d_chunk_table = table;
+    d_chunk_table_key = table ? table->get_key() : "";
+}
+
+/**
+ * @brief The number of chunks, without making Chunk objects for them
+ */
+unsigned long long DmrppCommon::get_chunk_count() const
+{
+    std::lock_guard<std::mutex> lock(chunk_table_mtx);
+    return d_chunks.size() + (d_chunk_table ? d_chunk_table->size() : 0);
+}
+
 /**
  * @brief read method for the atomic types
  *
@@ -313,18 +412,33 @@ DmrppCommon::print_chunks_element(XMLWriter &xml, const string &name_space)
     else if (is_deflate_compression())
         compression.append("deflate");
 
+    for (auto filter_id: d_filters) {
+        const filter_info *info = FilterRegistry::TheRegistry()->find(filter_id);
+        if (!info)
+            throw BESInternalError(prolog + "Unknown HDF5 filter: " + std::to_string(filter_id), __FILE__, __LINE__);
+        compression.append(compression.empty() ? "" : " ").append(info->name);
+    }
+    if (!d_unsupported_filters.empty())
+        compression.append(compression.empty() ? "" : " ").append(d_unsupported_filters);
+
     if (!compression.empty())
         if (xmlTextWriterWriteAttribute(xml.get_writer(), (const xmlChar*) "compressionType", (const xmlChar*) compression.c_str()) < 0)
             throw BESInternalError("Could not write compression attribute.", __FILE__, __LINE__);
 
 
-    if(!get_chunks().empty()){
-        auto first_chunk = get_chunks().front();
-        if (!first_chunk->get_byte_order().empty()) {
-            if (xmlTextWriterWriteAttribute(xml.get_writer(), (const xmlChar *) "byteOrder",
-                                        (const xmlChar *) first_chunk->get_byte_order().c_str()) < 0)
+    // When only the chunks element is printed (for a binary DMR++), the
+    // chunks are not made from the table just to get their byte order.
+    string byte_order;
+    shared_ptr<const ChunkTable> table = get_chunk_table();
+    if (d_print_chunk_tables_only && table)
+        byte_order = table->get_byte_order();
+    else if (!get_chunks().empty())
+        byte_order = get_chunks().front()->get_byte_order();
+
+    if (!byte_order.empty()) {
+        if (xmlTextWriterWriteAttribute(xml.get_writer(), (const xmlChar *) "byteOrder",
+                                        (const xmlChar *) byte_order.c_str()) < 0)
             throw BESInternalError("Could not write attribute byteOrder", __FILE__, __LINE__);
-        }
     }
 
     if (d_chunk_dimension_sizes.size() > 0) {
@@ -341,7 +455,11 @@ DmrppCommon::print_chunks_element(XMLWriter &xml, const string &name_space)
     // Start elements "chunk" with dmrpp namespace and attributes:
     // for (vector<Chunk>::iterator i = get_chunks().begin(), e = get_chunks().end(); i != e; ++i) {
 
-    for(auto chunk: get_chunks()){
+    vector<shared_ptr<Chunk>> chunks;
+    if (!d_print_chunk_tables_only)
+        chunks = get_chunks();
+
+    for(auto chunk: chunks){
 
         if (xmlTextWriterStartElementNS(xml.get_writer(), (const xmlChar*)name_space.c_str(), (const xmlChar*) "chunk", NULL) < 0)
             throw BESInternalError("Could not start element chunk", __FILE__, __LINE__);
@@ -424,7 +542,7 @@ void DmrppCommon::print_dmrpp(XMLWriter &xml, bool constrained /*false*/)
         bt.get_attr_table().print_xml_writer(xml);
 
     // This is the code added to libdap::BaseType::print_dap4(). jhrg 5/10/18
-    if (DmrppCommon::d_print_chunks && get_immutable_chunks().size() > 0)
+    if (DmrppCommon::d_print_chunks && get_chunk_count() > 0)
         print_chunks_element(xml, DmrppCommon::d_ns_prefix);
 
     if (xmlTextWriterEndElement(xml.get_writer()) < 0)
@@ -435,6 +553,11 @@ void DmrppCommon::dump(ostream & strm) const
 {
     strm << BESIndent::LMarg << "is_deflate:             " << (is_deflate_compression() ? "true" : "false") << endl;
     strm << BESIndent::LMarg << "is_shuffle_compression: " << (is_shuffle_compression() ? "true" : "false") << endl;
+    strm << BESIndent::LMarg << "other filters:          [";
+    for (unsigned int i = 0; i < d_filters.size(); i++) {
+        strm << (i ? "][" : "") << d_filters[i];
+    }
+    strm << "]" << (d_unsupported_filters.empty() ? "" : " unsupported: " + d_unsupported_filters) << endl;
 
     const vector<unsigned long long> &chunk_dim_sizes = get_chunk_dimension_sizes();
 
@@ -33,6 +33,7 @@
 
 #include "dods-datatypes.h"
 #include "Chunk.h"
+#include "ChunkTable.h"
 #include "SuperChunk.h"
 
 #include "config.h"
@@ -74,19 +75,31 @@ class DmrppCommon {
 private:
 	bool d_deflate;
 	bool d_shuffle;
+	std::vector<unsigned int> d_filters;    // HDF5 ids of filters other than deflate and shuffle
+	std::string d_unsupported_filters;      // Names in the compressionType we don't know
 	bool d_compact;
 	std::string d_byte_order;
 	std::vector<unsigned long long> d_chunk_dimension_sizes;
-	std::vector<std::shared_ptr<Chunk>> d_chunks;
+	mutable std::vector<std::shared_ptr<Chunk>> d_chunks;
+	// The chunks as parsed; made into d_chunks the first time they are used
+	mutable std::shared_ptr<const ChunkTable> d_chunk_table;
+	// The key of the ChunkTable d_chunks were made from, if they were not changed since
+	std::string d_chunk_table_key;
 	bool d_twiddle_bytes;
 
+	void load_chunks() const;
+
 protected:
     void m_duplicate_common(const DmrppCommon &dc) {
     	d_deflate = dc.d_deflate;
     	d_shuffle = dc.d_shuffle;
+    	d_filters = dc.d_filters;
+    	d_unsupported_filters = dc.d_unsupported_filters;
     	d_compact = dc.d_compact;
     	d_chunk_dimension_sizes = dc.d_chunk_dimension_sizes;
     	d_chunks = dc.d_chunks;
+    	d_chunk_table = dc.d_chunk_table;
+    	d_chunk_table_key = dc.d_chunk_table_key;
     	d_byte_order = dc.d_byte_order;
     	d_twiddle_bytes = dc.d_twiddle_bytes;
     }
@@ -94,6 +107,7 @@ protected:
     /// @brief Returns a reference to the internal Chunk vector.
     /// @see get_immutable_chunks()
     virtual std::vector<std::shared_ptr<Chunk>> get_chunks() {
+        load_chunks();
     	return d_chunks;
     }
 
@@ -101,6 +115,7 @@ protected:
 
 public:
     static bool d_print_chunks;     ///< if true, print_dap4() prints chunk elements
+    static bool d_print_chunk_tables_only;  ///< if true, print only the chunks element, not each chunk
     static std::string d_dmrpp_ns;       ///< The DMR++ XML namespace
     static std::string d_ns_prefix;      ///< The XML namespace prefix to use
 
@@ -135,6 +150,13 @@ public:
         d_shuffle = value;
     }
 
+    /// @brief Add a filter (other than deflate or shuffle) by its HDF5 id.
+    void add_filter(unsigned int filter_id) {
+        d_filters.push_back(filter_id);
+    }
+
+    virtual std::vector<unsigned int> get_filters() const;
+
     /// @brief Returns true if this object utilizes COMPACT layout.
     virtual bool is_compact_layout() const {
         return d_compact;
@@ -151,9 +173,20 @@ public:
     /// @brief A const reference to the vector of chunks
     /// @see get_chunks()
     virtual std::vector< std::shared_ptr<Chunk>> get_immutable_chunks() const {
+        load_chunks();
         return d_chunks;
     }
 
+    virtual unsigned long long get_chunk_count() const;
+
+    void set_chunk_table(std::shared_ptr<const ChunkTable> table);
+
+    /// @brief The chunks that have not been made into Chunk objects yet; null if there are none
+    std::shared_ptr<const ChunkTable> get_chunk_table() const { return d_chunk_table; }
+
+    /// @brief The key of the ChunkTable the chunks came from; empty if it has none or chunks were added
+    const std::string &get_chunk_table_key() const { return d_chunk_table_key; }
+
     virtual const std::vector<unsigned long long> &get_chunk_dimension_sizes() const {
     	return d_chunk_dimension_sizes;
     }
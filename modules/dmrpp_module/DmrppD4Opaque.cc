@@ -145,7 +145,7 @@ void DmrppD4Opaque::read_chunks_parallel()
                 Chunk *chunk = chunks_to_insert.front();
                 chunks_to_insert.pop();
 
-                chunk->inflate_chunk(is_deflate_compression(), is_shuffle_compression(), get_chunk_size_in_elements(), 1 /*elem width*/);
+                chunk->filter_chunk(get_filters(), get_chunk_size_in_elements(), 1 /*elem width*/);
 
                 insert_chunk(chunk);
             }
@@ -160,7 +160,7 @@ void DmrppD4Opaque::read_chunks_parallel()
 
             chunk->read_chunk();
 
-            chunk->inflate_chunk(is_deflate_compression(), is_shuffle_compression(), get_chunk_size_in_elements(), 1 /*elem width*/);
+            chunk->filter_chunk(get_filters(), get_chunk_size_in_elements(), 1 /*elem width*/);
 
             insert_chunk(chunk);
         }
@@ -174,7 +174,7 @@ void DmrppD4Opaque::read_chunks()
 {
     for (auto chunk : get_chunks()) {
         chunk->read_chunk();
-        chunk->inflate_chunk(is_deflate_compression(), is_shuffle_compression(), get_chunk_size_in_elements(), 1 /*elem width*/);
+        chunk->filter_chunk(get_filters(), get_chunk_size_in_elements(), 1 /*elem width*/);
         insert_chunk(chunk);
     }
 
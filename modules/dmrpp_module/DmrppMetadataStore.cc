@@ -39,6 +39,7 @@
 
 #include "DmrppParserSax2.h"
 #include "DmrppTypeFactory.h"
+#include "DmrppBinary.h"
 #include "DmrppMetadataStore.h"
 
 #include "DMRpp.h"
@@ -181,6 +182,11 @@ void DmrppMetadataStore::StreamDMRpp::operator()(ostream &os)
     }
 }
 
+void DmrppMetadataStore::StreamDMRppBinary::operator()(ostream &os)
+{
+    os.write(d_bytes.data(), d_bytes.size());
+}
+
 /**
  * @brief Add the DAP4 metadata responses using a DMR
  *
@@ -232,6 +238,55 @@ DmrppMetadataStore::add_dmrpp_response(libdap::DMR *dmrpp, const std::string &na
     return(stored_dmrpp);
 }
 
+/**
+ * @brief Add a binary DMR++ to the store
+ *
+ * The DMR++ handler uses this to keep the binary form of the DMR++ XML
+ * documents it reads (see DmrppBinary), so each document is parsed in
+ * full only once.
+ *
+ * @param bytes The binary DMR++
+ * @param name The name of the binary DMR++. The handler uses the pathname,
+ * size and modification time of the XML document so that a changed
+ * document gets a new entry.
+ * @return True if the binary DMR++ was stored, false if it was already there.
+ */
+bool
+DmrppMetadataStore::add_dmrpp_binary_response(const string &bytes, const string &name)
+{
+    d_ledger_entry = string("add DMR++ binary ").append(name);
+
+    StreamDMRppBinary write_the_binary_response(bytes);
+    bool stored = store_dap_response(write_the_binary_response, get_hash(name + "dmrpp_b"), name, "DMR++ binary");
+
+    write_ledger(); // write the index line
+
+    return stored;
+}
+
+/**
+ * @brief Build a DMR from a binary DMR++ in the store
+ *
+ * The stored file is memory-mapped; the mapping stays valid after the read
+ * lock is released, even if the entry is purged.
+ *
+ * @param name The name used with add_dmrpp_binary_response()
+ * @param dmr Value-result parameter. Its factory must make the DMR++ types.
+ * @return True if the binary DMR++ was found and read, false if it is not
+ * in the store.
+ */
+bool
+DmrppMetadataStore::get_dmrpp_binary(const string &name, DMR *dmr)
+{
+    MDSReadLock lock = get_read_lock_helper(name, "dmrpp_b", "DMR++ binary");
+    if (!lock())
+        return false;
+
+    DmrppBinary::read_file(get_cache_file_name(get_hash(name + "dmrpp_b"), false), dmr);
+
+    return true;
+}
+
 /**
  * @brief Use the DMR response to build a DMR with Dmrpp Types
  * @param name The pathname to the dataset, relative to the BES
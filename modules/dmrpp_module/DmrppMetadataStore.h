@@ -102,6 +102,13 @@ protected:
         virtual void operator()(std::ostream &os);
     };
 
+    /// Write a binary DMR++ (see DmrppBinary) that has already been made
+    struct StreamDMRppBinary : public StreamDAP {
+        const std::string &d_bytes;
+        StreamDMRppBinary(const std::string &bytes) : StreamDAP(static_cast<libdap::DMR*>(0)), d_bytes(bytes) {}
+        virtual void operator()(std::ostream &os);
+    };
+
     DmrppMetadataStore(const DmrppMetadataStore &src) : bes::GlobalMetadataStore(src) { }
 
     // Only get_instance() should be used to instantiate this class
@@ -120,6 +127,9 @@ public:
     virtual bool add_responses(libdap::DMR *dmrpp, const std::string &name);
     virtual bool add_dmrpp_response(libdap::DMR *dmrpp, const std::string &name);
 
+    virtual bool add_dmrpp_binary_response(const std::string &bytes, const std::string &name);
+    virtual bool get_dmrpp_binary(const std::string &name, libdap::DMR *dmr);
+
     virtual libdap::DMR *get_dmr_object(const string &name);
 
     virtual dmrpp::DMRpp *get_dmrpp_object(const std::string &name);
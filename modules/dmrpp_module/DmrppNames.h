@@ -42,6 +42,21 @@
 #define DMRPP_USE_COMPUTE_THREADS_KEY "DMRPP.UseComputeThreads"
 #define DMRPP_MAX_COMPUTE_THREADS_KEY "DMRPP.MaxComputeThreads"
 
+#define DMRPP_USE_CURL_MULTI_KEY "DMRPP.UseCurlMulti"
+#define DMRPP_CURL_MULTI_MAX_IN_FLIGHT_KEY "DMRPP.CurlMultiMaxInFlight"
+#define DMRPP_CURL_MULTI_MAX_HOST_CONNECTIONS_KEY "DMRPP.CurlMultiMaxHostConnections"
+#define DMRPP_DEFAULT_CURL_MULTI_MAX_IN_FLIGHT 256
+#define DMRPP_DEFAULT_CURL_MULTI_MAX_HOST_CONNECTIONS 16
+
+#define DMRPP_SUPER_CHUNK_MAX_GAP_KEY "DMRPP.SuperChunkMaxGap"
+#define DMRPP_SUPER_CHUNK_MAX_SIZE_KEY "DMRPP.SuperChunkMaxSize"
+#define DMRPP_SUPER_CHUNK_AUTO_GAP_KEY "DMRPP.SuperChunkAutoGap"
+#define DMRPP_SUPER_CHUNK_AUTO_GAP_LIMIT_KEY "DMRPP.SuperChunkAutoGapLimit"
+#define DMRPP_DEFAULT_SUPER_CHUNK_AUTO_GAP_LIMIT (1024*1024)
+
+#define DMRPP_DIRECT_CHUNK_PLACEMENT_KEY "DMRPP.DirectChunkPlacement"
+#define DMRPP_USE_BINARY_CACHE_KEY "DMRPP.UseBinaryCache"
+
 #define DMRPP_WAIT_FOR_FUTURE_MS 1
 
 #define DMRPP_DEFAULT_CONTIGUOUS_CONCURRENT_THRESHOLD  (2*1024*1024)
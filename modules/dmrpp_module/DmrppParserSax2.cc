@@ -27,6 +27,7 @@
 #include <iostream>
 #include <sstream>
 
+#include <cstdlib>
 #include <cstring>
 #include <cstdarg>
 #include <cassert>
@@ -809,6 +810,8 @@ void DmrppParserSax2::dmr_start_document(void * p)
     DmrppParserSax2 *parser = static_cast<DmrppParserSax2*>(p);
     parser->error_msg = "";
     parser->char_data = "";
+    parser->d_chunk_table_builder.reset();
+    parser->d_data_urls.clear();
 
     // Set this in intern_helper so that the loop test for the parser_end
     // state works for the first iteration. It seems like XMLParseChunk calls this
@@ -1123,75 +1126,26 @@ void DmrppParserSax2::dmr_start_element(void *p, const xmlChar *l, const xmlChar
                 BESDEBUG(PARSER, prolog << "There was no 'byteOrder' attribute associated with the variable '" << bt->type_name()
                          << " " << bt->name() << "'" << endl);
             }
+
+            // The chunk elements are collected in a ChunkTable; see the end of this element.
+            parser->d_chunk_table_builder.reset(new ChunkTableBuilder(dc->get_byte_order()));
         }
         // Ingest an dmrpp:chunk element and its attributes
         else if (strcmp(localname, "chunk") == 0) {
-            string data_url = "unknown_data_location";
+            // An empty href means the dataset's dmrpp:href. The URLs are worked out once
+            // for each distinct href; see get_data_url().
+            string href;
             if (parser->check_attribute("href", attributes, nb_attributes)) {
-#if 0
-                istringstream data_url_ss(parser->xml_attrs["href"].value);
-                data_url = data_url_ss.str();
-                BESDEBUG(PARSER, prolog << "Processing 'href' value into data_url. href: " <<
-                data_url_ss.str() << endl);
-#endif
-
-                data_url = parser->get_attribute_val("href", attributes, nb_attributes);
-                BESDEBUG(PARSER, prolog << "Processing 'href' value into data_url. href: " << data_url << endl);
-                // We may have to cache the last accessed/redirect URL for data_url here because this URL
-                // may be unique to this chunk.
-                BESDEBUG(PARSER, prolog << "Attempting to locate and cache the effective URL for Chunk URL: " << parser->dmrpp_dataset_href << endl);
-                string effective_url = EffectiveUrlCache::TheCache()->get_effective_url(data_url);
-                BESDEBUG(PARSER, prolog << "EffectiveUrlCache::get_effective_url() returned: " << effective_url << endl);
-            }
-            else {
-                BESDEBUG(PARSER, prolog << "No attribute 'href' located. Trying Dataset/@dmrpp:href..." << endl);
-                // This bit of magic sets the URL used to get the data and it's
-                // magic in part because it may be a file or an http URL
-                data_url = parser->dmrpp_dataset_href;
-                // We don't have to conditionally cache parser->dmrpp_dataset_href  here because that was
-                // done in the evaluation of the parser_start case.
-                BESDEBUG(PARSER, prolog << "Processing dmrpp:href into data_url. dmrpp:href='" << data_url << "'" << endl);
+                href = parser->get_attribute_val("href", attributes, nb_attributes);
+                BESDEBUG(PARSER, prolog << "Processed attribute 'href=\"" << href << "\"'" << endl);
             }
-            // First we see if it's an HTTP URL, and if not we
-            // make a local file url based on the Catalog Root
-#if 0
-            std::string http("http://");
-            std::string https("https://");
-            std::string file("file://");
-            if (data_url.compare(0, http.size(), http) && data_url.compare(0, https.size(), https)
-                && data_url.compare(0, file.size(), file))
-#endif
-
-            if (data_url.find("http://") != 0 && data_url.find("https://") != 0 && data_url.find("file://") != 0) {
-                BESDEBUG(PARSER, prolog << "data_url does NOT start with 'http://', 'https://' or 'file://'. "
-                    "Retrieving default catalog root directory" << endl);
-
-                // Now we try to find the default catalog. If we can't find it we punt and leave it be.
-                BESCatalog *defcat = BESCatalogList::TheCatalogList()->default_catalog();
-                if (!defcat) {
-                    BESDEBUG(PARSER, prolog << "Not able to find the default catalog." << endl);
-                }
-                else {
-                    // Found the catalog so we get the root dir; make a file URL.
-                    BESCatalogUtils *utils = BESCatalogList::TheCatalogList()->default_catalog()->get_catalog_utils();
-
-                    BESDEBUG(PARSER, prolog << "Found default catalog root_dir: '" << utils->get_root_dir() << "'" << endl);
-
-                    data_url = BESUtil::assemblePath(utils->get_root_dir(), data_url, true);
-                    data_url = "file://" + data_url;
-                }
-            }
-
-            BESDEBUG(PARSER, prolog << "Processed data_url: '" << data_url << "'" << endl);
 
             unsigned long long offset = 0;
             unsigned long long size = 0;
             string chunk_position_in_array("");
-            std::string byte_order = dc->get_byte_order();
 
             if (parser->check_required_attribute("offset", attributes, nb_attributes)) {
-                istringstream offset_ss(parser->get_attribute_val("offset", attributes, nb_attributes));
-                offset_ss >> offset;
+                offset = strtoull(parser->get_attribute_val("offset", attributes, nb_attributes).c_str(), 0, 10);
                 BESDEBUG(PARSER, prolog << "Processed attribute 'offset=\"" << offset << "\"'" << endl);
             }
             else {
@@ -1199,8 +1153,7 @@ void DmrppParserSax2::dmr_start_element(void *p, const xmlChar *l, const xmlChar
             }
 
             if (parser->check_required_attribute("nBytes", attributes, nb_attributes)) {
-                istringstream size_ss(parser->get_attribute_val("nBytes", attributes, nb_attributes));
-                size_ss >> size;
+                size = strtoull(parser->get_attribute_val("nBytes", attributes, nb_attributes).c_str(), 0, 10);
                 BESDEBUG(PARSER, prolog << "Processed attribute 'nBytes=\"" << size << "\"'" << endl);
             }
             else {
@@ -1208,15 +1161,16 @@ void DmrppParserSax2::dmr_start_element(void *p, const xmlChar *l, const xmlChar
             }
 
             if (parser->check_attribute("chunkPositionInArray", attributes, nb_attributes)) {
-                istringstream chunk_position_ss(parser->get_attribute_val("chunkPositionInArray", attributes, nb_attributes));
-                chunk_position_in_array = chunk_position_ss.str();
-                BESDEBUG(PARSER, prolog << "Found attribute 'chunkPositionInArray' value: " << chunk_position_ss.str() << endl);
+                chunk_position_in_array = parser->get_attribute_val("chunkPositionInArray", attributes, nb_attributes);
+                BESDEBUG(PARSER, prolog << "Found attribute 'chunkPositionInArray' value: " << chunk_position_in_array << endl);
             }
             else {
                 BESDEBUG(PARSER, prolog << "No attribute 'chunkPositionInArray' located" << endl);
             }
 
-            dc->add_chunk(data_url, byte_order, size, offset, chunk_position_in_array);
+            if (!parser->d_chunk_table_builder)
+                parser->d_chunk_table_builder.reset(new ChunkTableBuilder(dc->get_byte_order()));
+            parser->d_chunk_table_builder->add_chunk(href, offset, size, chunk_position_in_array);
         }
     }
     break;
@@ -1478,6 +1432,21 @@ void DmrppParserSax2::dmr_end_element(void *p, const xmlChar *l, const xmlChar *
 
     case inside_dmrpp_object: {
         BESDEBUG(PARSER, prolog << "End of dmrpp namespace element: " << localname << endl);
+
+        // The variable's Chunk objects are made from the table when they are first used.
+        if (strcmp(localname, "chunks") == 0 && parser->d_chunk_table_builder) {
+            DmrppCommon *dc = dynamic_cast<DmrppCommon*>(parser->top_basetype());
+            if (!dc)
+                throw BESInternalError("Could not cast BaseType to DmrppType in the drmpp handler.", __FILE__, __LINE__);
+
+            if (!parser->d_chunk_table_builder->empty()) {
+                shared_ptr<ChunkTable> table = parser->d_chunk_table_builder->build();
+                table->resolve_urls([parser](const string &href) { return parser->get_data_url(href); });
+                dc->set_chunk_table(table);
+            }
+            parser->d_chunk_table_builder.reset();
+        }
+
         parser->pop_state();
         break;
     }
@@ -1753,6 +1722,71 @@ void DmrppParserSax2::intern(const string &document, DMR *dest_dmr)
     intern(document.c_str(), document.length(), dest_dmr);
 }
 
+/**
+ * @brief The URL used to read the chunks with this href
+ *
+ * If \arg href is empty, the dataset's dmrpp:href is used. If the URL is
+ * not an http, https or file URL, it is taken to be a path relative to the
+ * default catalog's root directory. The URLs are remembered so this is done
+ * once for each distinct href in the document.
+ *
+ * @param href The href attribute of a dmrpp:chunk element; empty if there is none
+ * @return The URL
+ */
+string DmrppParserSax2::get_data_url(const string &href)
+{
+    auto i = d_data_urls.find(href);
+    if (i != d_data_urls.end())
+        return i->second;
+
+    string data_url;
+    if (!href.empty()) {
+        data_url = href;
+        BESDEBUG(PARSER, prolog << "Processing 'href' value into data_url. href: " << data_url << endl);
+        // We may have to cache the last accessed/redirect URL for data_url here because this URL
+        // may be unique to this chunk.
+        BESDEBUG(PARSER, prolog << "Attempting to locate and cache the effective URL for Chunk URL: " << data_url << endl);
+        string effective_url = EffectiveUrlCache::TheCache()->get_effective_url(data_url);
+        BESDEBUG(PARSER, prolog << "EffectiveUrlCache::get_effective_url() returned: " << effective_url << endl);
+    }
+    else {
+        BESDEBUG(PARSER, prolog << "No attribute 'href' located. Trying Dataset/@dmrpp:href..." << endl);
+        // This bit of magic sets the URL used to get the data and it's
+        // magic in part because it may be a file or an http URL
+        data_url = dmrpp_dataset_href;
+        // We don't have to conditionally cache dmrpp_dataset_href  here because that was
+        // done in the evaluation of the parser_start case.
+        BESDEBUG(PARSER, prolog << "Processing dmrpp:href into data_url. dmrpp:href='" << data_url << "'" << endl);
+    }
+
+    // First we see if it's an HTTP URL, and if not we
+    // make a local file url based on the Catalog Root
+    if (data_url.find("http://") != 0 && data_url.find("https://") != 0 && data_url.find("file://") != 0) {
+        BESDEBUG(PARSER, prolog << "data_url does NOT start with 'http://', 'https://' or 'file://'. "
+            "Retrieving default catalog root directory" << endl);
+
+        // Now we try to find the default catalog. If we can't find it we punt and leave it be.
+        BESCatalog *defcat = BESCatalogList::TheCatalogList()->default_catalog();
+        if (!defcat) {
+            BESDEBUG(PARSER, prolog << "Not able to find the default catalog." << endl);
+        }
+        else {
+            // Found the catalog so we get the root dir; make a file URL.
+            BESCatalogUtils *utils = BESCatalogList::TheCatalogList()->default_catalog()->get_catalog_utils();
+
+            BESDEBUG(PARSER, prolog << "Found default catalog root_dir: '" << utils->get_root_dir() << "'" << endl);
+
+            data_url = BESUtil::assemblePath(utils->get_root_dir(), data_url, true);
+            data_url = "file://" + data_url;
+        }
+    }
+
+    BESDEBUG(PARSER, prolog << "Processed data_url: '" << data_url << "'" << endl);
+
+    d_data_urls[href] = data_url;
+    return data_url;
+}
+
 /** Parse a DMR document stored in a char *buffer.
  *
  * @param document Read the DMR from this string.
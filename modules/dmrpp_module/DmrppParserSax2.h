@@ -33,6 +33,7 @@
 #include <string>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <stack>
 
@@ -41,6 +42,7 @@
 #include <Type.h>   // from libdap
 #include "BESRegex.h"
 #include "EffectiveUrlCache.h"
+#include "ChunkTable.h"
 
 #define CRLF "\r\n"
 #define D4_PARSE_BUFF_SIZE 1048576
@@ -178,6 +180,9 @@ private:
 
     std::string dmrpp_dataset_href;
 
+    std::unique_ptr<ChunkTableBuilder> d_chunk_table_builder;  // The chunks of the current variable
+    std::map<std::string, std::string> d_data_urls;             // href -> URL; see get_data_url()
+
     class XMLAttribute {
         public:
         std::string prefix;
@@ -291,6 +296,11 @@ public:
     void intern(const std::string &document, libdap::DMR *dest_dmr);
     void intern(const char *buffer, int size, libdap::DMR *dest_dmr);
 
+    std::string get_data_url(const std::string &href);
+
+    /// @brief The Dataset element's dmrpp:href attribute, as written in the document
+    const std::string &get_dmrpp_dataset_href() const { return dmrpp_dataset_href; }
+
     /**
      * @defgroup strict The 'strict' mode
      * @{
@@ -25,9 +25,11 @@
 #include <string>
 #include <memory>
 #include <sstream>
+#include <fstream>
 
 #include <curl/curl.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include <Ancillary.h>
 #include <ObjMemCache.h>
@@ -69,6 +71,7 @@
 #include "DmrppRequestHandler.h"
 #include "CurlHandlePool.h"
 #include "DmrppMetadataStore.h"
+#include "DmrppBinary.h"
 #include "CredentialsManager.h"
 
 using namespace bes;
@@ -97,6 +100,24 @@ unsigned int DmrppRequestHandler::d_max_compute_threads = 8;
 // Default minimum value is 2MB: 2 * (1024*1024)
 unsigned long long DmrppRequestHandler::d_contiguous_concurrent_threshold = DMRPP_DEFAULT_CONTIGUOUS_CONCURRENT_THRESHOLD;
 
+// When true, SuperChunk transfers are run by the CurlMultiEngine's event loop
+// instead of one blocking transfer per thread.
+bool DmrppRequestHandler::d_use_curl_multi = false;
+unsigned int DmrppRequestHandler::d_curl_multi_max_in_flight = DMRPP_DEFAULT_CURL_MULTI_MAX_IN_FLIGHT;
+unsigned int DmrppRequestHandler::d_curl_multi_max_host_connections = DMRPP_DEFAULT_CURL_MULTI_MAX_HOST_CONNECTIONS;
+
+// SuperChunk coalescing. By default only Chunks that abut one another are read
+// by one request and there is no limit on the size of that request.
+unsigned long long DmrppRequestHandler::d_super_chunk_max_gap = 0;
+unsigned long long DmrppRequestHandler::d_super_chunk_max_size = 0;
+bool DmrppRequestHandler::d_super_chunk_auto_gap = false;
+unsigned long long DmrppRequestHandler::d_super_chunk_auto_gap_limit = DMRPP_DEFAULT_SUPER_CHUNK_AUTO_GAP_LIMIT;
+bool DmrppRequestHandler::d_direct_chunk_placement = true;
+
+// When true, the DMR++ XML documents are converted to binary DMR++ documents
+// that are kept in the MDS and read in place of the XML.
+bool DmrppRequestHandler::d_use_binary_cache = false;
+
 static void read_key_value(const std::string &key_name, bool &key_value)
 {
     bool key_found = false;
@@ -176,6 +197,45 @@ DmrppRequestHandler::DmrppRequestHandler(const string &name) :
     read_key_value(DMRPP_CONTIGUOUS_CONCURRENT_THRESHOLD_KEY, d_contiguous_concurrent_threshold);
     msg << prolog << "Contiguous Concurrency Threshold: " << d_contiguous_concurrent_threshold << " bytes." << endl;
     INFO_LOG(msg.str() );
+    msg.str(std::string());
+
+    read_key_value(DMRPP_USE_CURL_MULTI_KEY, d_use_curl_multi);
+    read_key_value(DMRPP_CURL_MULTI_MAX_IN_FLIGHT_KEY, d_curl_multi_max_in_flight);
+    read_key_value(DMRPP_CURL_MULTI_MAX_HOST_CONNECTIONS_KEY, d_curl_multi_max_host_connections);
+    msg << prolog << "libcurl multi transfer engine: ";
+    if (d_use_curl_multi) {
+        msg << "Enabled. max_in_flight: " << d_curl_multi_max_in_flight
+            << " max_host_connections: " << d_curl_multi_max_host_connections << endl;
+    }
+    else {
+        msg << "Disabled." << endl;
+    }
+    INFO_LOG(msg.str() );
+    msg.str(std::string());
+
+    read_key_value(DMRPP_SUPER_CHUNK_MAX_GAP_KEY, d_super_chunk_max_gap);
+    read_key_value(DMRPP_SUPER_CHUNK_MAX_SIZE_KEY, d_super_chunk_max_size);
+    read_key_value(DMRPP_SUPER_CHUNK_AUTO_GAP_KEY, d_super_chunk_auto_gap);
+    read_key_value(DMRPP_SUPER_CHUNK_AUTO_GAP_LIMIT_KEY, d_super_chunk_auto_gap_limit);
+    msg << prolog << "SuperChunk max gap: " << d_super_chunk_max_gap << " bytes, max size: "
+        << d_super_chunk_max_size << " bytes (0 is unlimited), auto gap: ";
+    if (d_super_chunk_auto_gap) {
+        msg << "Enabled. limit: " << d_super_chunk_auto_gap_limit << " bytes." << endl;
+    }
+    else {
+        msg << "Disabled." << endl;
+    }
+    INFO_LOG(msg.str() );
+    msg.str(std::string());
+
+    read_key_value(DMRPP_DIRECT_CHUNK_PLACEMENT_KEY, d_direct_chunk_placement);
+    msg << prolog << "Direct chunk placement: " << (d_direct_chunk_placement ? "Enabled." : "Disabled.") << endl;
+    INFO_LOG(msg.str() );
+    msg.str(std::string());
+
+    read_key_value(DMRPP_USE_BINARY_CACHE_KEY, d_use_binary_cache);
+    msg << prolog << "Binary DMR++ cache: " << (d_use_binary_cache ? "Enabled." : "Disabled.") << endl;
+    INFO_LOG(msg.str() );
 
 
 #if !HAVE_CURL_MULTI_API
@@ -209,10 +269,49 @@ void DmrppRequestHandler::build_dmr_from_file(BESContainer *container, DMR* dmr)
     DmrppTypeFactory BaseFactory;   // Use the factory for this handler's types
     dmr->set_factory(&BaseFactory);
 
-    DmrppParserSax2 parser;
-    ifstream in(data_pathname.c_str(), ios::in);
+    // A binary DMR++ is read in place; only the chunks of the variables that
+    // are read are made.
+    if (DmrppBinary::is_binary_file(data_pathname)) {
+        DmrppBinary::read_file(data_pathname, dmr);
+        dmr->set_factory(0);
+        return;
+    }
+
+    // The binary form of the document is made the first time it is read and
+    // kept in the MDS, so later requests, from any BES process, skip the parse.
+    bes::DmrppMetadataStore *mds = d_use_binary_cache ? bes::DmrppMetadataStore::get_instance() : 0;
+    struct stat buf;
+    if (mds && stat(data_pathname.c_str(), &buf) == 0) {
+        // A document replaced by another has a new inode or modification time
+        ostringstream key;
+        key << "dmrpp:" << data_pathname << ':' << buf.st_ino << ':' << buf.st_size << ':';
+#if !defined(_POSIX_C_SOURCE) || defined(_DARWIN_C_SOURCE)
+        key << buf.st_mtimespec.tv_sec << '.' << buf.st_mtimespec.tv_nsec;
+#else
+        key << buf.st_mtim.tv_sec << '.' << buf.st_mtim.tv_nsec;
+#endif
+
+        if (mds->get_dmrpp_binary(key.str(), dmr)) {
+            dmr->set_factory(0);
+            return;
+        }
+
+        ifstream in(data_pathname.c_str(), ios::in);
+        ostringstream document;
+        document << in.rdbuf();
 
-    parser.intern(in, dmr);
+        ostringstream binary;
+        DmrppBinary::convert(document.str(), binary);
+        shared_ptr<string> bytes(new string(binary.str()));
+        mds->add_dmrpp_binary_response(*bytes, key.str());
+
+        DmrppBinary::read(shared_ptr<const char>(bytes, bytes->data()), bytes->size(), dmr, key.str());
+    }
+    else {
+        DmrppParserSax2 parser;
+        ifstream in(data_pathname.c_str(), ios::in);
+        parser.intern(in, dmr);
+    }
 
     dmr->set_factory(0);
 }
@@ -66,6 +66,19 @@ public:
 
     static unsigned long long d_contiguous_concurrent_threshold;
 
+    static bool d_use_curl_multi;
+    static unsigned int d_curl_multi_max_in_flight;
+    static unsigned int d_curl_multi_max_host_connections;
+
+    static unsigned long long d_super_chunk_max_gap;
+    static unsigned long long d_super_chunk_max_size;
+    static bool d_super_chunk_auto_gap;
+    static unsigned long long d_super_chunk_auto_gap_limit;
+
+    static bool d_direct_chunk_placement;
+
+    static bool d_use_binary_cache;
+
 	static bool dap_build_dmr(BESDataHandlerInterface &dhi);
 	static bool dap_build_dap4data(BESDataHandlerInterface &dhi);
     static bool dap_build_das(BESDataHandlerInterface &dhi);
@@ -0,0 +1,908 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+
+#include <zlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#if HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+#if HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#if HAVE_LIBBLOSC
+#include <blosc.h>
+#endif
+
+#include "BESError.h"
+#include "BESInternalError.h"
+#include "BESDebug.h"
+#include "BESIndent.h"
+
+#include "FilterRegistry.h"
+
+#define prolog std::string("FilterRegistry::").append(__func__).append("() - ")
+
+#define FILTERS_MODULE "dmrpp:filters"
+
+using namespace std;
+
+namespace dmrpp {
+
+/**
+ * @brief Deflate data. This is the zlib algorithm.
+ *
+ * @note Stolen from the HDF5 library and hacked to fit.
+ *
+ * @param dest Write the 'inflated' data here
+ * @param dest_len Size of the destination buffer
+ * @param src Compressed data
+ * @param src_len Size of the compressed data
+ * @return The number of bytes written to dest
+ */
+static unsigned long long zlib_inflate(char *dest, unsigned long long dest_len, const char *src, unsigned long long src_len) {
+    /* Sanity check */
+    assert(src_len > 0);
+    assert(src);
+    assert(dest_len > 0);
+    assert(dest);
+
+    /* Input; uncompress */
+    z_stream z_strm; /* zlib parameters */
+
+    /* Set the uncompression parameters */
+    memset(&z_strm, 0, sizeof(z_strm));
+    z_strm.next_in = (Bytef *) const_cast<char *>(src);
+    z_strm.avail_in = src_len;
+    z_strm.next_out = (Bytef *) dest;
+    z_strm.avail_out = dest_len;
+
+    /* Initialize the uncompression routines */
+    if (Z_OK != inflateInit(&z_strm))
+        throw BESError("Failed to initialize inflate software.", BES_INTERNAL_ERROR, __FILE__, __LINE__);
+
+    /* Loop to uncompress the buffer */
+    int status = Z_OK;
+    do {
+        /* Uncompress some data */
+        status = inflate(&z_strm, Z_SYNC_FLUSH);
+
+        /* Check if we are done uncompressing data */
+        if (Z_STREAM_END == status) break; /*done*/
+
+        /* Check for error */
+        if (Z_OK != status) {
+            (void) inflateEnd(&z_strm);
+            throw BESError("Failed to inflate data chunk.", BES_INTERNAL_ERROR, __FILE__, __LINE__);
+        }
+        else {
+            /* If we're not done and just ran out of buffer space, it's an error.
+             * The HDF5 library code would extend the buffer as needed, but for
+             * this handler, we always know the size of the uncompressed chunk.
+             */
+            if (0 == z_strm.avail_out) {
+                (void) inflateEnd(&z_strm);
+                throw BESError("Data buffer is not big enough for uncompressed data.", BES_INTERNAL_ERROR, __FILE__,
+                               __LINE__);
+#if 0
+                /* Here's how to extend the buffer if needed. This might be useful some day... */
+                void *new_outbuf; /* Pointer to new output buffer */
+
+                /* Allocate a buffer twice as big */
+                nalloc *= 2;
+                if (NULL == (new_outbuf = H5MM_realloc(outbuf, nalloc))) {
+                    (void) inflateEnd(&z_strm);
+                    HGOTO_ERROR(H5E_RESOURCE, H5E_NOSPACE, 0, "memory allocation failed for inflate decompression")
+                } /* end if */
+                outbuf = new_outbuf;
+
+                /* Update pointers to buffer for next set of uncompressed data */
+                z_strm.next_out = (unsigned char*) outbuf + z_strm.total_out;
+                z_strm.avail_out = (uInt) (nalloc - z_strm.total_out);
+#endif
+            } /* end if */
+        } /* end else */
+    } while (status == Z_OK);
+
+    /* Finish uncompressing the stream */
+    (void) inflateEnd(&z_strm);
+
+    return z_strm.total_out;
+}
+
+// #define this to enable the duff's device loop unrolling code.
+// jhrg 1/19/17
+#define DUFFS_DEVICE
+
+/**
+ * @brief Un-shuffle data, one byte at a time.
+ *
+ * @note Stolen from HDF5 and hacked to fit
+ *
+ * @note We use src size as a param because the buffer might be larger than
+ * elems * width (e.g., 1020 byte buffer will hold 127 doubles with 4 extra).
+ * If we used elems * width, the the buffer size will be too small for those
+ * extra bytes. Code at the end of this function will transfer them.
+ *
+ * @note Do not call this when the number of elements or the element width
+ * is 1. In the HDF5 library chunks that fit that description are never shuffled
+ * (because there really is nothing to shuffle). The function will handle that
+ * case, but by not calling it you can save the allocation of a buffer and a
+ * call to memcpy.
+ *
+ * @param dest Put the result here.
+ * @param src Shuffled data source
+ * @param src_size Number of bytes in both src and dest
+ * @param width Number of bytes in an element
+ */
+void unshuffle_scalar(char *dest, const char *src, unsigned long long src_size, unsigned long long width) {
+    unsigned long long elems = src_size / width;  // int division rounds down
+
+    /* Don't do anything for 1-byte elements, or "fractional" elements */
+    if (!(width > 1 && elems > 1)) {
+        memcpy(dest, const_cast<char *>(src), src_size);
+    }
+    else {
+        /* Get the pointer to the source buffer (Alias for source buffer) */
+        char *_src = const_cast<char *>(src);
+        char *_dest = 0;   // Alias for destination buffer
+
+        /* Input; unshuffle */
+        for (unsigned int i = 0; i < width; i++) {
+            _dest = dest + i;
+#ifndef DUFFS_DEVICE
+            size_t j = elems;
+            while(j > 0) {
+                *_dest = *_src++;
+                _dest += width;
+
+                j--;
+            }
+#else /* DUFFS_DEVICE */
+            {
+                size_t duffs_index = (elems + 7) / 8;   /* Counting index for Duff's device */
+                switch (elems % 8) {
+                    default:
+                        assert(0 && "This Should never be executed!");
+                        break;
+                    case 0:
+                        do {
+                            // This macro saves repeating the same line 8 times
+#define DUFF_GUTS       *_dest = *_src++; _dest += width;
+
+                            DUFF_GUTS
+                            case 7:
+                            DUFF_GUTS
+                            case 6:
+                            DUFF_GUTS
+                            case 5:
+                            DUFF_GUTS
+                            case 4:
+                            DUFF_GUTS
+                            case 3:
+                            DUFF_GUTS
+                            case 2:
+                            DUFF_GUTS
+                            case 1:
+                            DUFF_GUTS
+                        } while (--duffs_index > 0);
+                } /* end switch */
+            } /* end block */
+#endif /* DUFFS_DEVICE */
+
+        } /* end for i = 0 to width*/
+
+        /* Compute the leftover bytes if there are any */
+        size_t leftover = src_size % width;
+
+        /* Add leftover to the end of data */
+        if (leftover > 0) {
+            /* Adjust back to end of shuffled bytes */
+            _dest -= (width - 1); /*lint !e794 _dest is initialized */
+            memcpy((void *) _dest, (void *) _src, leftover);
+        }
+    } /* end if width and elems both > 1 */
+}
+
+
+
+#ifdef __SSE2__
+/**
+ * @brief Un-shuffle 2-byte elements 16 at a time.
+ * @see unshuffle_scalar() for the other parameters
+ * @param elems The number of whole elements in src
+ */
+static void unshuffle_sse2_2(char *dest, const char *src, unsigned long long elems)
+{
+    const char *b0 = src;
+    const char *b1 = src + elems;
+
+    unsigned long long i = 0;
+    for (; i + 16 <= elems; i += 16) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b0 + i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i));
+        __m128i *out = reinterpret_cast<__m128i *>(dest + 2 * i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi8(v0, v1));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(v0, v1));
+    }
+    for (; i < elems; i++) {
+        dest[2 * i] = b0[i];
+        dest[2 * i + 1] = b1[i];
+    }
+}
+
+/**
+ * @brief Un-shuffle 4-byte elements 16 at a time.
+ */
+static void unshuffle_sse2_4(char *dest, const char *src, unsigned long long elems)
+{
+    const char *b0 = src;
+    const char *b1 = src + elems;
+    const char *b2 = src + 2 * elems;
+    const char *b3 = src + 3 * elems;
+
+    unsigned long long i = 0;
+    for (; i + 16 <= elems; i += 16) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b0 + i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b1 + i));
+        __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b2 + i));
+        __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b3 + i));
+
+        // Pairs of bytes, then whole elements
+        __m128i v01_lo = _mm_unpacklo_epi8(v0, v1);
+        __m128i v01_hi = _mm_unpackhi_epi8(v0, v1);
+        __m128i v23_lo = _mm_unpacklo_epi8(v2, v3);
+        __m128i v23_hi = _mm_unpackhi_epi8(v2, v3);
+
+        __m128i *out = reinterpret_cast<__m128i *>(dest + 4 * i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(v01_lo, v23_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(v01_lo, v23_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(v01_hi, v23_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(v01_hi, v23_hi));
+    }
+    for (; i < elems; i++) {
+        dest[4 * i] = b0[i];
+        dest[4 * i + 1] = b1[i];
+        dest[4 * i + 2] = b2[i];
+        dest[4 * i + 3] = b3[i];
+    }
+}
+
+/**
+ * @brief Un-shuffle 8-byte elements 16 at a time.
+ */
+static void unshuffle_sse2_8(char *dest, const char *src, unsigned long long elems)
+{
+    unsigned long long i = 0;
+    for (; i + 16 <= elems; i += 16) {
+        __m128i v[8];
+        for (int b = 0; b < 8; b++)
+            v[b] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + b * elems + i));
+
+        // Pairs of bytes
+        __m128i p[8];
+        for (int b = 0; b < 4; b++) {
+            p[2 * b] = _mm_unpacklo_epi8(v[2 * b], v[2 * b + 1]);
+            p[2 * b + 1] = _mm_unpackhi_epi8(v[2 * b], v[2 * b + 1]);
+        }
+
+        // Quads: q[0..3] hold bytes 0-3 of elements 0-3, 4-7, 8-11, 12-15;
+        // q[4..7] bytes 4-7 of the same elements.
+        __m128i q[8];
+        for (int h = 0; h < 2; h++) {
+            q[4 * h] = _mm_unpacklo_epi16(p[4 * h], p[4 * h + 2]);
+            q[4 * h + 1] = _mm_unpackhi_epi16(p[4 * h], p[4 * h + 2]);
+            q[4 * h + 2] = _mm_unpacklo_epi16(p[4 * h + 1], p[4 * h + 3]);
+            q[4 * h + 3] = _mm_unpackhi_epi16(p[4 * h + 1], p[4 * h + 3]);
+        }
+
+        __m128i *out = reinterpret_cast<__m128i *>(dest + 8 * i);
+        for (int k = 0; k < 4; k++) {
+            _mm_storeu_si128(out + 2 * k, _mm_unpacklo_epi32(q[k], q[k + 4]));
+            _mm_storeu_si128(out + 2 * k + 1, _mm_unpackhi_epi32(q[k], q[k + 4]));
+        }
+    }
+    for (; i < elems; i++) {
+        for (int b = 0; b < 8; b++)
+            dest[8 * i + b] = src[b * elems + i];
+    }
+}
+#endif // __SSE2__
+
+/**
+ * @brief Un-shuffle data.
+ *
+ * Elements 2, 4 or 8 bytes wide - nearly all the shuffled data there is - are
+ * un-shuffled using SSE2 when the compiler targets it (all x86-64 compilers
+ * do); everything else is handled by unshuffle_scalar().
+ *
+ * @param dest Put the result here.
+ * @param src Shuffled data source
+ * @param src_size Number of bytes in both src and dest
+ * @param width Number of bytes in an element
+ */
+void unshuffle(char *dest, const char *src, unsigned long long src_size, unsigned long long width)
+{
+#ifdef __SSE2__
+    unsigned long long elems = src_size / width;
+    if (elems > 1 && (width == 2 || width == 4 || width == 8)) {
+        switch (width) {
+            case 2:
+                unshuffle_sse2_2(dest, src, elems);
+                break;
+            case 4:
+                unshuffle_sse2_4(dest, src, elems);
+                break;
+            default:
+                unshuffle_sse2_8(dest, src, elems);
+                break;
+        }
+
+        // The leftover bytes are not shuffled
+        unsigned long long leftover = src_size % width;
+        if (leftover > 0)
+            memcpy(dest + elems * width, src + elems * width, leftover);
+        return;
+    }
+#endif
+
+    unshuffle_scalar(dest, src, src_size, width);
+}
+
+/**
+ * @brief Decompress zlib (HDF5 'deflate') data.
+ *
+ * This uses libdeflate when the handler is built with it - it is often twice
+ * as fast as zlib for whole buffers - and zlib otherwise. A zlib-ng built in
+ * its zlib compatible mode needs nothing special; it is used in place of zlib.
+ *
+ * @param dest Write the 'inflated' data here
+ * @param dest_len Size of the destination buffer
+ * @param src Compressed data
+ * @param src_len Size of the compressed data
+ * @return The number of bytes written to dest
+ */
+unsigned long long inflate(char *dest, unsigned long long dest_len, const char *src, unsigned long long src_len)
+{
+#if HAVE_LIBDEFLATE
+    // A decompressor is not thread safe, but is cheap to reuse. Make one per thread.
+    struct decompressor_deleter {
+        void operator()(libdeflate_decompressor *d) const { libdeflate_free_decompressor(d); }
+    };
+    static thread_local unique_ptr<libdeflate_decompressor, decompressor_deleter> decompressor(
+            libdeflate_alloc_decompressor());
+    if (!decompressor)
+        throw BESInternalError("Failed to allocate a libdeflate decompressor.", __FILE__, __LINE__);
+
+    size_t actual_out = 0;
+    libdeflate_result result = libdeflate_zlib_decompress(decompressor.get(), src, src_len, dest, dest_len,
+                                                          &actual_out);
+    switch (result) {
+        case LIBDEFLATE_SUCCESS:
+            return actual_out;
+        case LIBDEFLATE_INSUFFICIENT_SPACE:
+            throw BESInternalError("Data buffer is not big enough for uncompressed data.", __FILE__, __LINE__);
+        default:
+            throw BESInternalError("Failed to inflate data chunk.", __FILE__, __LINE__);
+    }
+#else
+    return zlib_inflate(dest, dest_len, src, src_len);
+#endif
+}
+
+/**
+ * @brief The 'deflate' filter.
+ */
+static unsigned long long deflate_decoder(const char *src, unsigned long long src_len, char *dest,
+                                          unsigned long long dest_len, const filter_args &)
+{
+    return inflate(dest, dest_len, src, src_len);
+}
+
+/**
+ * @brief The 'shuffle' filter.
+ */
+static unsigned long long shuffle_decoder(const char *src, unsigned long long src_len, char *dest,
+                                          unsigned long long dest_len, const filter_args &args)
+{
+    if (src_len > dest_len)
+        throw BESInternalError("Data buffer is not big enough for unshuffled data.", __FILE__, __LINE__);
+
+    unshuffle(dest, src, src_len, args.elem_width);
+    return src_len;
+}
+
+/**
+ * @brief The integer part of the HDF5 scale-offset filter.
+ *
+ * Each chunk starts with a 21 byte header that holds the number of bits used
+ * for each value (minbits) and the minimum value (minval). The values, less
+ * minval, follow, packed minbits to a value with the most significant bits
+ * first. See H5Zscaleoffset.c in the HDF5 source.
+ *
+ * Two things the filter can do need parameters that HDF5 stores with the
+ * dataset and not with each chunk, and the DMR++ does not record them:
+ * floating point values and datasets with a user-defined fill value. The
+ * first is an error; for the second, values equal to the fill value are not
+ * restored.
+ */
+static unsigned long long scaleoffset_decoder(const char *src, unsigned long long src_len, char *dest,
+                                              unsigned long long dest_len, const filter_args &args)
+{
+    const unsigned int header_size = 21;
+
+    if (!args.integer_type)
+        throw BESInternalError("The scale-offset filter is only supported for integer data.", __FILE__, __LINE__);
+
+    unsigned long long width = args.elem_width;
+    if (width != 1 && width != 2 && width != 4 && width != 8) {
+        ostringstream oss;
+        oss << "The scale-offset filter cannot decode " << width << " byte integers.";
+        throw BESInternalError(oss.str(), __FILE__, __LINE__);
+    }
+
+    if (src_len < header_size)
+        throw BESInternalError("The scale-offset data are too short for their header.", __FILE__, __LINE__);
+
+    auto buf = reinterpret_cast<const unsigned char *>(src);
+
+    unsigned int minbits = 0;
+    for (unsigned int i = 0; i < 4; i++)
+        minbits |= static_cast<unsigned int>(buf[i]) << (i * 8);
+
+    unsigned int minval_size = std::min(static_cast<unsigned int>(sizeof(unsigned long long)),
+                                        static_cast<unsigned int>(buf[4]));
+    unsigned long long minval = 0;
+    for (unsigned int i = 0; i < minval_size; i++)
+        minval |= static_cast<unsigned long long>(buf[5 + i]) << (i * 8);
+
+    unsigned long long elems = dest_len / width;
+    unsigned long long size_out = elems * width;
+    unsigned int dtype_len = width * 8;
+    const unsigned char *data_in = buf + header_size;
+    unsigned long long data_in_len = src_len - header_size;
+
+    auto out = reinterpret_cast<unsigned char *>(dest);
+
+    const uint16_t endian_test = 1;
+    bool native_le = *reinterpret_cast<const unsigned char *>(&endian_test) == 1;
+
+    if (minbits > dtype_len) {
+        ostringstream oss;
+        oss << "The scale-offset header is corrupt (minbits: " << minbits << ").";
+        throw BESInternalError(oss.str(), __FILE__, __LINE__);
+    }
+    else if (minbits == dtype_len) {
+        // Stored without packing
+        if (data_in_len < size_out)
+            throw BESInternalError("The scale-offset data are too short.", __FILE__, __LINE__);
+        memcpy(out, data_in, size_out);
+    }
+    else if (minbits == 0) {
+        // Every value is minval
+        memset(out, 0, size_out);
+    }
+    else {
+        if (data_in_len < (elems * minbits + 7) / 8)
+            throw BESInternalError("The scale-offset data are too short.", __FILE__, __LINE__);
+
+        memset(out, 0, size_out);
+
+        // Unpack minbits bits per value, most significant byte first, into
+        // native byte order. This is H5Z__scaleoffset_decompress_one_atomic().
+        unsigned long long j = 0;   // index into data_in
+        unsigned int buf_len = 8;   // unread bits in data_in[j]
+        unsigned int first_byte_bits = 8 - (dtype_len - minbits) % 8;
+        int skipped_bytes = (dtype_len - minbits) / 8;
+
+        for (unsigned long long e = 0; e < elems; e++) {
+            unsigned char *value = out + e * width;
+            for (int n = 0; n < static_cast<int>(width) - skipped_bytes; n++) {
+                // n counts from the most significant stored byte
+                int k = native_le ? static_cast<int>(width) - 1 - skipped_bytes - n : skipped_bytes + n;
+                unsigned int dat_len = (n == 0) ? first_byte_bits : 8;
+
+                unsigned int val = data_in[j];
+                if (buf_len > dat_len) {
+                    value[k] = static_cast<unsigned char>((val >> (buf_len - dat_len)) & ~(~0U << dat_len));
+                    buf_len -= dat_len;
+                }
+                else {
+                    value[k] = static_cast<unsigned char>((val & ~(~0U << buf_len)) << (dat_len - buf_len));
+                    dat_len -= buf_len;
+                    ++j;
+                    buf_len = 8;
+                    if (dat_len == 0)
+                        continue;
+
+                    val = data_in[j];
+                    value[k] |= static_cast<unsigned char>((val >> (buf_len - dat_len)) & ~(~0U << dat_len));
+                    buf_len -= dat_len;
+                }
+            }
+        }
+    }
+
+    // Add minval back. Addition modulo 2^n is the same for signed and
+    // unsigned values, so the sign of the type does not matter.
+    if (minbits != dtype_len) {
+        for (unsigned long long e = 0; e < elems; e++) {
+            switch (width) {
+                case 1:
+                    out[e] = static_cast<uint8_t>(out[e] + static_cast<uint8_t>(minval));
+                    break;
+                case 2: {
+                    uint16_t v;
+                    memcpy(&v, out + 2 * e, 2);
+                    v = static_cast<uint16_t>(v + static_cast<uint16_t>(minval));
+                    memcpy(out + 2 * e, &v, 2);
+                    break;
+                }
+                case 4: {
+                    uint32_t v;
+                    memcpy(&v, out + 4 * e, 4);
+                    v = static_cast<uint32_t>(v + static_cast<uint32_t>(minval));
+                    memcpy(out + 4 * e, &v, 4);
+                    break;
+                }
+                default: {
+                    uint64_t v;
+                    memcpy(&v, out + 8 * e, 8);
+                    v += minval;
+                    memcpy(out + 8 * e, &v, 8);
+                    break;
+                }
+            }
+        }
+    }
+
+    // The values are in native byte order now; the rest of the handler expects
+    // the byte order of the file.
+    if (width > 1 && native_le == args.big_endian) {
+        for (unsigned long long e = 0; e < elems; e++)
+            std::reverse(out + e * width, out + (e + 1) * width);
+    }
+
+    return size_out;
+}
+
+#if HAVE_LIBLZ4
+/**
+ * @brief The HDF5 LZ4 filter (32004).
+ *
+ * The data start with the uncompressed size (8 bytes) and the block size
+ * (4 bytes), both big-endian. Each block follows as its compressed size (4
+ * bytes, big-endian) and its data; a block that did not compress is stored
+ * as is. See H5Zlz4.c in the HDF5 plugins.
+ */
+static unsigned long long lz4_decoder(const char *src, unsigned long long src_len, char *dest,
+                                      unsigned long long dest_len, const filter_args &)
+{
+    auto be_uint = [](const char *p, int bytes) {
+        unsigned long long value = 0;
+        for (int i = 0; i < bytes; i++)
+            value = (value << 8) | static_cast<unsigned char>(p[i]);
+        return value;
+    };
+
+    if (src_len < 12)
+        throw BESInternalError("The LZ4 data are too short for their header.", __FILE__, __LINE__);
+
+    unsigned long long orig_size = be_uint(src, 8);
+    unsigned long long block_size = be_uint(src + 8, 4);
+    if (orig_size > dest_len)
+        throw BESInternalError("Data buffer is not big enough for uncompressed data.", __FILE__, __LINE__);
+    if (block_size == 0 && orig_size > 0)
+        throw BESInternalError("The LZ4 header is corrupt.", __FILE__, __LINE__);
+
+    const char *in = src + 12;
+    const char *in_end = src + src_len;
+    unsigned long long decoded = 0;
+    while (decoded < orig_size) {
+        unsigned long long this_block = std::min(block_size, orig_size - decoded);
+        if (in_end - in < 4)
+            throw BESInternalError("The LZ4 data are truncated.", __FILE__, __LINE__);
+        unsigned long long compressed_size = be_uint(in, 4);
+        in += 4;
+        if (static_cast<unsigned long long>(in_end - in) < compressed_size)
+            throw BESInternalError("The LZ4 data are truncated.", __FILE__, __LINE__);
+
+        if (compressed_size == this_block) {
+            memcpy(dest + decoded, in, this_block);
+        }
+        else {
+            int n = LZ4_decompress_safe(in, dest + decoded, static_cast<int>(compressed_size),
+                                        static_cast<int>(this_block));
+            if (n < 0 || static_cast<unsigned long long>(n) != this_block)
+                throw BESInternalError("Failed to decompress LZ4 data chunk.", __FILE__, __LINE__);
+        }
+
+        in += compressed_size;
+        decoded += this_block;
+    }
+
+    return decoded;
+}
+#endif
+
+#if HAVE_LIBZSTD
+/**
+ * @brief The HDF5 Zstandard filter (32015). The data are one Zstandard frame.
+ */
+static unsigned long long zstd_decoder(const char *src, unsigned long long src_len, char *dest,
+                                       unsigned long long dest_len, const filter_args &)
+{
+    struct dctx_deleter {
+        void operator()(ZSTD_DCtx *d) const { ZSTD_freeDCtx(d); }
+    };
+    static thread_local unique_ptr<ZSTD_DCtx, dctx_deleter> dctx(ZSTD_createDCtx());
+    if (!dctx)
+        throw BESInternalError("Failed to allocate a Zstandard decompression context.", __FILE__, __LINE__);
+
+    size_t n = ZSTD_decompressDCtx(dctx.get(), dest, dest_len, src, src_len);
+    if (ZSTD_isError(n)) {
+        string msg = "Failed to decompress Zstandard data chunk: ";
+        throw BESInternalError(msg.append(ZSTD_getErrorName(n)), __FILE__, __LINE__);
+    }
+
+    return n;
+}
+#endif
+
+#if HAVE_LIBBLOSC
+/**
+ * @brief The HDF5 Blosc filter (32001). Blosc frames hold their own shuffle and codec settings.
+ */
+static unsigned long long blosc_decoder(const char *src, unsigned long long src_len, char *dest,
+                                        unsigned long long dest_len, const filter_args &)
+{
+    size_t nbytes = 0, cbytes = 0, blocksize = 0;
+    if (src_len < BLOSC_MIN_HEADER_LENGTH)
+        throw BESInternalError("The Blosc data are too short for their header.", __FILE__, __LINE__);
+    blosc_cbuffer_sizes(src, &nbytes, &cbytes, &blocksize);
+    if (cbytes > src_len)
+        throw BESInternalError("The Blosc data are truncated.", __FILE__, __LINE__);
+    if (nbytes > dest_len)
+        throw BESInternalError("Data buffer is not big enough for uncompressed data.", __FILE__, __LINE__);
+
+    // One internal thread: the handler already decodes chunks in parallel.
+    int n = blosc_decompress_ctx(src, dest, dest_len, 1);
+    if (n < 0)
+        throw BESInternalError("Failed to decompress Blosc data chunk.", __FILE__, __LINE__);
+
+    return n;
+}
+#endif
+
+FilterRegistry *FilterRegistry::d_instance = nullptr;
+static std::once_flag d_fr_init_once;
+
+/**
+ * @brief Get the singleton FilterRegistry instance.
+ */
+FilterRegistry *
+FilterRegistry::TheRegistry()
+{
+    std::call_once(d_fr_init_once, FilterRegistry::initialize_instance);
+
+    return d_instance;
+}
+
+/**
+ * private static that only get's called once by using std::call_once()
+ */
+void FilterRegistry::initialize_instance()
+{
+    d_instance = new FilterRegistry;
+#ifdef HAVE_ATEXIT
+    atexit(delete_instance);
+#endif
+}
+
+void FilterRegistry::delete_instance()
+{
+    delete d_instance;
+    d_instance = nullptr;
+}
+
+/**
+ * @brief Register the built-in filters.
+ */
+FilterRegistry::FilterRegistry()
+{
+    add_filter(filter_info(FILTER_DEFLATE, "deflate", compression_stage, deflate_decoder));
+    add_filter(filter_info(FILTER_SHUFFLE, "shuffle", reorder_stage, shuffle_decoder));
+    // The checksum follows the data; drop it without checking it.
+    add_filter(filter_info(FILTER_FLETCHER32, "fletcher32", checksum_stage, nullptr, 4));
+    add_filter(filter_info(FILTER_SCALEOFFSET, "scaleoffset", transform_stage, scaleoffset_decoder));
+
+#if HAVE_LIBLZ4
+    add_filter(filter_info(FILTER_LZ4, "lz4", compression_stage, lz4_decoder));
+#else
+    add_filter(filter_info(FILTER_LZ4, "lz4", compression_stage, nullptr));
+#endif
+
+#if HAVE_LIBZSTD
+    add_filter(filter_info(FILTER_ZSTD, "zstd", compression_stage, zstd_decoder));
+#else
+    add_filter(filter_info(FILTER_ZSTD, "zstd", compression_stage, nullptr));
+#endif
+
+#if HAVE_LIBBLOSC
+    add_filter(filter_info(FILTER_BLOSC, "blosc", compression_stage, blosc_decoder));
+#else
+    add_filter(filter_info(FILTER_BLOSC, "blosc", compression_stage, nullptr));
+#endif
+}
+
+/**
+ * @brief Add a filter, replacing any filter with the same id.
+ * @param info The filter
+ */
+void FilterRegistry::add_filter(const filter_info &info)
+{
+    auto i = d_filters.find(info.id);
+    if (i != d_filters.end())
+        i->second = info;
+    else
+        d_filters.insert(make_pair(info.id, info));
+}
+
+/**
+ * @brief Find a filter by its HDF5 id.
+ * @return The filter or null if there is no filter with that id.
+ */
+const filter_info *FilterRegistry::find(unsigned int id) const
+{
+    auto i = d_filters.find(id);
+    return (i == d_filters.end()) ? nullptr : &(i->second);
+}
+
+/**
+ * @brief Find a filter by the name used for it in DMR++ documents.
+ * @return The filter or null if there is no filter with that name.
+ */
+const filter_info *FilterRegistry::find(const string &name) const
+{
+    for (const auto &f: d_filters) {
+        if (f.second.name == name)
+            return &(f.second);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Run a chain of filters backwards, decoding a chunk.
+ *
+ * The result is written to the caller's buffer. A chain with more than one
+ * filter that transforms the data uses one other buffer for the intermediate
+ * results; it belongs to the calling thread and is reused, so decoding a
+ * chunk allocates nothing once a thread has decoded a chunk as large.
+ *
+ * @param filters The HDF5 ids of the filters, in any order
+ * @param src The encoded data
+ * @param src_len The number of bytes in src
+ * @param dest Write the decoded data here
+ * @param dest_len The size of dest
+ * @param args Information about the values in the chunk
+ * @return The number of bytes written to dest
+ * @exception BESInternalError if a filter is unknown or not available, dest
+ * is not large enough or the data cannot be decoded.
+ */
+unsigned long long FilterRegistry::decode(const vector<unsigned int> &filters, const char *src,
+                                          unsigned long long src_len, char *dest, unsigned long long dest_len,
+                                          const filter_args &args) const
+{
+    vector<const filter_info *> chain;
+    chain.reserve(filters.size());
+    for (auto id: filters) {
+        const filter_info *info = find(id);
+        if (!info) {
+            ostringstream oss;
+            oss << "Unknown HDF5 filter: " << id;
+            throw BESInternalError(oss.str(), __FILE__, __LINE__);
+        }
+        if (!info->available()) {
+            ostringstream oss;
+            oss << "The DMR++ handler was built without support for the " << info->name << " filter (" << id << ").";
+            throw BESInternalError(oss.str(), __FILE__, __LINE__);
+        }
+        chain.push_back(info);
+    }
+
+    stable_sort(chain.begin(), chain.end(), [](const filter_info *a, const filter_info *b) {
+        return a->stage < b->stage;
+    });
+
+    // Filters that only drop a trailer don't need a buffer of their own.
+    vector<const filter_info *> decoders;
+    for (auto info: chain) {
+        if (info->decoder) {
+            decoders.push_back(info);
+        }
+        else {
+            if (info->trailer_bytes > src_len)
+                throw BESInternalError("Chunk is too small for its " + info->name + " trailer.", __FILE__, __LINE__);
+            src_len -= info->trailer_bytes;
+        }
+    }
+
+    if (decoders.empty()) {
+        if (src_len > dest_len)
+            throw BESInternalError("Data buffer is not big enough for the chunk.", __FILE__, __LINE__);
+        memcpy(dest, src, src_len);
+        return src_len;
+    }
+
+    // Alternate between dest and the scratch buffer so that the last filter
+    // writes to dest.
+    static thread_local vector<char> scratch;
+    if (decoders.size() > 1 && scratch.size() < dest_len)
+        scratch.resize(dest_len);
+
+    const char *in = src;
+    unsigned long long in_len = src_len;
+    for (size_t i = 0; i < decoders.size(); i++) {
+        char *out = ((decoders.size() - 1 - i) % 2 == 0) ? dest : scratch.data();
+        BESDEBUG(FILTERS_MODULE, prolog << decoders[i]->name << ": " << in_len << " bytes" << endl);
+        in_len = decoders[i]->decoder(in, in_len, out, dest_len, args);
+        in = out;
+    }
+
+    return in_len;
+}
+
+void FilterRegistry::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "FilterRegistry::" << __func__ << "(" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    for (const auto &f: d_filters) {
+        strm << BESIndent::LMarg << f.first << ": " << f.second.name << " stage: " << f.second.stage
+             << (f.second.available() ? "" : " (not available)") << endl;
+    }
+    BESIndent::UnIndent();
+}
+
+} // namespace dmrpp
@@ -0,0 +1,150 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _FilterRegistry_h
+#define _FilterRegistry_h 1
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace dmrpp {
+
+/**
+ * HDF5 filter identifiers. The values below 256 are defined in H5Zpublic.h;
+ * the others are from The HDF Group's list of registered third-party filters.
+ * The names are not the H5Z_FILTER_* macros so that this header can be used
+ * along with the HDF5 headers (e.g., by build_dmrpp).
+ */
+enum filter_id : unsigned int {
+    FILTER_DEFLATE = 1,
+    FILTER_SHUFFLE = 2,
+    FILTER_FLETCHER32 = 3,
+    FILTER_SCALEOFFSET = 6,
+    FILTER_BLOSC = 32001,
+    FILTER_LZ4 = 32004,
+    FILTER_ZSTD = 32015
+};
+
+/**
+ * When a chunk is decoded its filters are run in the order of these stages,
+ * whatever order the DMR++ lists them in. This matches how HDF5 writes data
+ * (scale-offset, then shuffle, then compression, then a checksum) and means
+ * DMR++ documents that say "deflate shuffle" work as they always have.
+ */
+enum filter_stage {
+    checksum_stage = 0,     ///< Remove a trailing checksum
+    compression_stage = 1,  ///< Decompress
+    reorder_stage = 2,      ///< Undo a byte reordering such as shuffle
+    transform_stage = 3     ///< Undo a transformation of the values
+};
+
+/**
+ * @brief What a filter needs to know about the values in a chunk.
+ */
+struct filter_args {
+    unsigned long long elem_width;  ///< Bytes per element
+    bool integer_type;              ///< The elements are integers
+    bool big_endian;                ///< The byte order of the data in the file
+
+    explicit filter_args(unsigned long long width, bool integer = false, bool big = false) :
+            elem_width(width), integer_type(integer), big_endian(big) {}
+};
+
+/**
+ * @brief Decode src into dest.
+ *
+ * @return The number of bytes written to dest. Must throw BESInternalError if
+ * dest_len bytes is not enough or the data cannot be decoded.
+ */
+typedef unsigned long long (*filter_decoder)(const char *src, unsigned long long src_len, char *dest,
+                                            unsigned long long dest_len, const filter_args &args);
+
+/**
+ * @brief One entry in the FilterRegistry.
+ */
+struct filter_info {
+    unsigned int id;                    ///< The HDF5 filter id
+    std::string name;                   ///< The name used in the DMR++ compressionType attribute
+    filter_stage stage;
+    filter_decoder decoder;             ///< Null if the handler was built without support for the filter
+    unsigned long long trailer_bytes;   ///< If not zero, the filter only removes this many bytes from the end
+
+    filter_info(unsigned int i, const std::string &n, filter_stage s, filter_decoder d,
+                unsigned long long trailer = 0) :
+            id(i), name(n), stage(s), decoder(d), trailer_bytes(trailer) {}
+
+    bool available() const { return decoder || trailer_bytes; }
+};
+
+/**
+ * @brief The filters the handler can use to decode chunk data, keyed by HDF5 filter id.
+ *
+ * The built-in filters are: deflate (zlib, or libdeflate when it is present),
+ * shuffle (SSE2 when the compiler targets it), fletcher32 (the checksum is
+ * dropped, not verified), integer scale-offset and, when the handler is built
+ * with their libraries, LZ4, Zstandard and Blosc. Filters the handler knows
+ * about but cannot decode are still registered so that their names are
+ * recognized and the error message says why the data cannot be read.
+ *
+ * More filters can be registered with add_filter(), but only before the
+ * handler starts to serve requests; lookups are not locked.
+ */
+class FilterRegistry {
+private:
+    static FilterRegistry *d_instance;
+
+    std::map<unsigned int, filter_info> d_filters;
+
+    FilterRegistry();
+
+    static void initialize_instance();
+    static void delete_instance();
+
+    friend class FilterRegistryTest;
+
+public:
+    virtual ~FilterRegistry() = default;
+
+    static FilterRegistry *TheRegistry();
+
+    void add_filter(const filter_info &info);
+
+    const filter_info *find(unsigned int id) const;
+    const filter_info *find(const std::string &name) const;
+
+    unsigned long long decode(const std::vector<unsigned int> &filters, const char *src, unsigned long long src_len,
+                              char *dest, unsigned long long dest_len, const filter_args &args) const;
+
+    virtual void dump(std::ostream &strm) const;
+};
+
+unsigned long long inflate(char *dest, unsigned long long dest_len, const char *src, unsigned long long src_len);
+
+void unshuffle(char *dest, const char *src, unsigned long long src_size, unsigned long long width);
+void unshuffle_scalar(char *dest, const char *src, unsigned long long src_size, unsigned long long width);
+
+} // namespace dmrpp
+
+#endif // _FilterRegistry_h
@@ -26,20 +26,26 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <algorithm>
+
+#include <util.h>
 
 #include "BESInternalError.h"
 #include "BESDebug.h"
+#include "BESTrace.h"
 
 #include "DmrppRequestHandler.h"
 #include "CurlHandlePool.h"
+#include "CurlMultiEngine.h"
 #include "DmrppArray.h"
 #include "DmrppNames.h"
 #include "Chunk.h"
 #include "SuperChunk.h"
+#include "TransferStats.h"
 
 #define prolog std::string("SuperChunk::").append(__func__).append("() - ")
 
-#define SUPER_CHUNK_MODULE "dmrpp:3"
+static BESDebugChannel<3> dmrpp_3("dmrpp:3");
 
 using std::stringstream;
 using std::string;
@@ -72,22 +78,27 @@ atomic_uint chunk_processing_thread_counter(0);
  */
 void process_one_chunk(shared_ptr<Chunk> chunk, DmrppArray *array, const vector<unsigned long long> &constrained_array_shape)
 {
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "BEGIN" << endl );
+    BESDEBUG(dmrpp_3, prolog << "BEGIN" << endl );
+
+    BESTraceSpan span("process_one_chunk");
+    span.set_attribute("chunk.offset", chunk->get_offset());
 
     chunk->read_chunk();
 
     if(array) {
-        if (array->is_deflate_compression() || array->is_shuffle_compression())
-            chunk->inflate_chunk(array->is_deflate_compression(), array->is_shuffle_compression(),
-                                 array->get_chunk_size_in_elements(), array->var()->width());
+        chunk->filter_chunk(array->get_filters(), array->get_chunk_size_in_elements(), array->var()->width(),
+                            libdap::is_integer_type(array->var()->type()));
 
-        vector<unsigned long long> target_element_address = chunk->get_position_in_array();
-        vector<unsigned long long> chunk_source_address(array->dimensions(), 0);
+        // A chunk with a destination is already in place; see DmrppArray::set_chunk_destinations()
+        if (!chunk->get_destination()) {
+            vector<unsigned long long> target_element_address = chunk->get_position_in_array();
+            vector<unsigned long long> chunk_source_address(array->dimensions(), 0);
 
-        array->insert_chunk(0 /* dimension */, &target_element_address, &chunk_source_address, chunk,
-                            constrained_array_shape);
+            array->insert_chunk(0 /* dimension */, &target_element_address, &chunk_source_address, chunk,
+                                constrained_array_shape);
+        }
     }
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "END" << endl );
+    BESDEBUG(dmrpp_3, prolog << "END" << endl );
 }
 
 /**
@@ -112,18 +123,21 @@ void process_one_chunk(shared_ptr<Chunk> chunk, DmrppArray *array, const vector<
 void process_one_chunk_unconstrained(shared_ptr<Chunk> chunk, const vector<unsigned long long> &chunk_shape,
                                      DmrppArray *array, const vector<unsigned long long> &array_shape)
 {
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "BEGIN" << endl );
+    BESDEBUG(dmrpp_3, prolog << "BEGIN" << endl );
+
+    BESTraceSpan span("process_one_chunk_unconstrained");
+    span.set_attribute("chunk.offset", chunk->get_offset());
 
     chunk->read_chunk();
 
     if(array){
-        if (array->is_deflate_compression() || array->is_shuffle_compression())
-            chunk->inflate_chunk(array->is_deflate_compression(), array->is_shuffle_compression(),
-                                 array->get_chunk_size_in_elements(),
-                                 array->var()->width());
-        array->insert_chunk_unconstrained(chunk, 0, 0, array_shape, 0, chunk_shape, chunk->get_position_in_array());
+        chunk->filter_chunk(array->get_filters(), array->get_chunk_size_in_elements(), array->var()->width(),
+                            libdap::is_integer_type(array->var()->type()));
+        // A chunk with a destination is already in place; see DmrppArray::set_chunk_destinations()
+        if (!chunk->get_destination())
+            array->insert_chunk_unconstrained(chunk, 0, 0, array_shape, 0, chunk_shape, chunk->get_position_in_array());
     }
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "END" << endl );
+    BESDEBUG(dmrpp_3, prolog << "END" << endl );
 }
 
 
@@ -179,12 +193,12 @@ bool one_chunk_unconstrained_compute_thread(unique_ptr<one_chunk_unconstrained_a
 bool start_one_chunk_compute_thread(list<std::future<bool>> &futures, unique_ptr<one_chunk_args> args) {
     bool retval = false;
     std::unique_lock<std::mutex> lck (chunk_processing_thread_pool_mtx);
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "d_max_compute_threads: " << DmrppRequestHandler::d_max_compute_threads << " chunk_processing_thread_counter: " << chunk_processing_thread_counter << endl);
+    BESDEBUG(dmrpp_3, prolog << "d_max_compute_threads: " << DmrppRequestHandler::d_max_compute_threads << " chunk_processing_thread_counter: " << chunk_processing_thread_counter << endl);
     if (chunk_processing_thread_counter < DmrppRequestHandler::d_max_compute_threads) {
         chunk_processing_thread_counter++;
         futures.push_back(std::async(std::launch::async, one_chunk_compute_thread, std::move(args)));
         retval = true;
-        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Got std::future '" << futures.size() <<
+        BESDEBUG(dmrpp_3, prolog << "Got std::future '" << futures.size() <<
                                             "' from std::async, chunk_processing_thread_counter: " << chunk_processing_thread_counter << endl);
     }
     return retval;
@@ -207,7 +221,7 @@ bool start_one_chunk_unconstrained_compute_thread(list<std::future<bool>> &futur
         futures.push_back(std::async(std::launch::async, one_chunk_unconstrained_compute_thread, std::move(args)));
         chunk_processing_thread_counter++;
         retval = true;
-        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Got std::future '" << futures.size() <<
+        BESDEBUG(dmrpp_3, prolog << "Got std::future '" << futures.size() <<
                                             "' from std::async, chunk_processing_thread_counter: " << chunk_processing_thread_counter << endl);
     }
     return retval;
@@ -253,24 +267,24 @@ void process_chunks_concurrent(
 
             // If future_finished is true this means that the chunk_processing_thread_counter has been decremented,
             // because future::get() was called or a call to future::valid() returned false.
-            BESDEBUG(SUPER_CHUNK_MODULE, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
+            BESDEBUG(dmrpp_3, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
 
             if (!chunks.empty()){
                 // Next we try to add a new Chunk compute thread if we can - there might be room.
                 bool thread_started = true;
                 while(thread_started && !chunks.empty()) {
                     auto chunk = chunks.front();
-                    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Starting thread for " << chunk->to_string() << endl);
+                    BESDEBUG(dmrpp_3, prolog << "Starting thread for " << chunk->to_string() << endl);
 
                     auto args = unique_ptr<one_chunk_args>(new one_chunk_args(super_chunk_id, chunk, array, constrained_array_shape));
                     thread_started = start_one_chunk_compute_thread(futures, std::move(args));
 
                     if (thread_started) {
                         chunks.pop();
-                        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "STARTED thread for " << chunk->to_string() << endl);
+                        BESDEBUG(dmrpp_3, prolog << "STARTED thread for " << chunk->to_string() << endl);
                     } else {
                         // Thread did not start, ownership of the arguments was not passed to the thread.
-                        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Thread not started. args deleted, Chunk remains in queue.) " <<
+                        BESDEBUG(dmrpp_3, prolog << "Thread not started. args deleted, Chunk remains in queue.) " <<
                                                             "chunk_processing_thread_counter: " << chunk_processing_thread_counter << " futures.size(): " << futures.size() << endl);
                     }
                 }
@@ -339,14 +353,14 @@ void process_chunks_unconstrained_concurrent(
 
             // If future_finished is true this means that the chunk_processing_thread_counter has been decremented,
             // because future::get() was called or a call to future::valid() returned false.
-            BESDEBUG(SUPER_CHUNK_MODULE, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
+            BESDEBUG(dmrpp_3, prolog << "future_finished: " << (future_finished ? "true" : "false") << endl);
 
             if (!chunks.empty()){
                 // Next we try to add a new Chunk compute thread if we can - there might be room.
                 bool thread_started = true;
                 while(thread_started && !chunks.empty()) {
                     auto chunk = chunks.front();
-                    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Starting thread for " << chunk->to_string() << endl);
+                    BESDEBUG(dmrpp_3, prolog << "Starting thread for " << chunk->to_string() << endl);
 
                     auto args = unique_ptr<one_chunk_unconstrained_args>(
                             new one_chunk_unconstrained_args(super_chunk_id, chunk, array, array_shape, chunk_shape) );
@@ -354,10 +368,10 @@ void process_chunks_unconstrained_concurrent(
 
                     if (thread_started) {
                         chunks.pop();
-                        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "STARTED thread for " << chunk->to_string() << endl);
+                        BESDEBUG(dmrpp_3, prolog << "STARTED thread for " << chunk->to_string() << endl);
                     } else {
                         // Thread did not start, ownership of the arguments was not passed to the thread.
-                        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "Thread not started. args deleted, Chunk remains in queue.)" <<
+                        BESDEBUG(dmrpp_3, prolog << "Thread not started. args deleted, Chunk remains in queue.)" <<
                                                             " chunk_processing_thread_counter: " << chunk_processing_thread_counter <<
                                                             " futures.size(): " << futures.size() << endl);
                     }
@@ -391,11 +405,31 @@ void process_chunks_unconstrained_concurrent(
 // = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
 
 
+/**
+ * @brief Make an empty SuperChunk.
+ *
+ * The gap and size limits used to decide which Chunks can be added are taken
+ * from the DMRPP.SuperChunkMaxGap and DMRPP.SuperChunkMaxSize keys.
+ *
+ * @param sc_id An identifier used in debugging output.
+ * @param parent The DmrppArray that holds the Chunks.
+ */
+SuperChunk::SuperChunk(const std::string sc_id, DmrppArray *parent) :
+        d_id(sc_id), d_parent_array(parent), d_data_url(""), d_offset(0), d_size(0), d_is_read(false),
+        d_read_buffer(nullptr), d_read_buffer_is_mine(true), d_max_gap(DmrppRequestHandler::d_super_chunk_max_gap),
+        d_max_size(DmrppRequestHandler::d_super_chunk_max_size)
+{
+}
+
 /**
  * @brief Attempts to add a new Chunk to this SuperChunk.
  *
  * If the passed chunk has the same data url, and is it is contiguous with the
  * current end if the SuperChunk the Chunk is added, otherwise it is skipped.
+ *
+ * When DMRPP.SuperChunkAutoGap is set, the first Chunk added also raises the
+ * gap limit to the one TransferStats suggests for its data URL's host.
+ *
  * @param candidate_chunk The Chunk to add.
  * @return True when the chunk is added, false otherwise.
  */
@@ -406,11 +440,16 @@ bool SuperChunk::add_chunk(const std::shared_ptr<Chunk> candidate_chunk) {
         d_offset = candidate_chunk->get_offset();
         d_size = candidate_chunk->get_size();
         d_data_url = candidate_chunk->get_data_url();
+        if (DmrppRequestHandler::d_super_chunk_auto_gap) {
+            d_max_gap = std::max(d_max_gap, TransferStats::TheStats()->suggested_gap(d_data_url,
+                                                        DmrppRequestHandler::d_super_chunk_auto_gap_limit));
+        }
         chunk_was_added =  true;
     }
     else if(is_contiguous(candidate_chunk) ){
         this->d_chunks.push_back(candidate_chunk);
-        d_size += candidate_chunk->get_size();
+        // This includes any gap between the previous Chunk and this one.
+        d_size = candidate_chunk->get_offset() + candidate_chunk->get_size() - d_offset;
         chunk_was_added =  true;
     }
     return chunk_was_added;
@@ -423,43 +462,49 @@ bool SuperChunk::add_chunk(const std::shared_ptr<Chunk> candidate_chunk) {
  * Returns true if the implemented rule for contiguousity determines that the candidate_chunk is
  * contiguous with this SuperChunk and false otherwise.
  *
- * Currently the rule is that the offset of the candidate_chunk must be the same as the current
- * offset + size of the SuperChunk, and the data_url is the same as the one in the SuperChunk.
+ * The rule is that the data_url is the same as the one in the SuperChunk, that the candidate_chunk
+ * starts no earlier than the current offset + size of the SuperChunk and no more than d_max_gap bytes
+ * after it, and that, when d_max_size is not zero, adding the candidate_chunk (and the gap) does not
+ * make the SuperChunk larger than d_max_size. With the default d_max_gap of zero the candidate_chunk
+ * must start exactly where the SuperChunk ends.
  *
  * @param candidate_chunk The Chunk to evaluate for contiguousness with this SuperChunk.
  * @return True if chunk isdeemed contiguous, false otherwise.
  */
 bool SuperChunk::is_contiguous(const std::shared_ptr<Chunk> candidate_chunk) {
     // Are the URLs the same?
-    bool contiguous  = candidate_chunk->get_data_url() == d_data_url;
-    if(contiguous){
-        // If the URLs match then see if the locations are matching
-        contiguous = (d_offset + d_size) == candidate_chunk->get_offset();
-    }
-    return contiguous;
+    if (candidate_chunk->get_data_url() != d_data_url)
+        return false;
+
+    // If the URLs match then see if the locations are close enough
+    unsigned long long end = d_offset + d_size;
+    unsigned long long candidate_offset = candidate_chunk->get_offset();
+    if (candidate_offset < end || candidate_offset - end > d_max_gap)
+        return false;
+
+    return d_max_size == 0 || (candidate_offset + candidate_chunk->get_size() - d_offset) <= d_max_size;
 }
 
 /**
  * @brief  Assigns each Chunk held by the SuperChunk a read buffer.
  *
  * Each Chunks read buffer is mapped to the corresponding section of the SuperChunk's
- * enclosing read buffer.
+ * enclosing read buffer. The bytes of any gaps between the Chunks are read into the
+ * enclosing buffer along with the Chunks but are never seen by them.
  *
  * This is a convenience/helper function for SuperChunk::read()
  */
 void SuperChunk::map_chunks_to_buffer()
 {
-    unsigned long long bindex = 0;
     for(const auto &chunk : d_chunks){
-        chunk->set_read_buffer(d_read_buffer + bindex, chunk->get_size(),0, false);
-        bindex += chunk->get_size();
-        if(bindex>d_size){
+        unsigned long long bindex = chunk->get_offset() - d_offset;
+        if(bindex + chunk->get_size() > d_size){
             stringstream msg;
-            msg << "ERROR The computed buffer index, " << bindex << " is larger than expected size of the SuperChunk. ";
+            msg << "ERROR The computed buffer index, " << bindex + chunk->get_size() << " is larger than expected size of the SuperChunk. ";
             msg << "d_size: " << d_size;
             throw BESInternalError(msg.str(), __FILE__, __LINE__);
-
         }
+        chunk->set_read_buffer(d_read_buffer + bindex, chunk->get_size(),0, false);
     }
 }
 
@@ -469,6 +514,11 @@ void SuperChunk::map_chunks_to_buffer()
  */
 void SuperChunk::read_aggregate_bytes()
 {
+    BESTraceSpan span("SuperChunk::read_aggregate_bytes");
+    span.set_attribute("bytes", d_size);
+    span.set_attribute("chunks", d_chunks.size());
+    span.set_url_attribute(d_data_url);
+
     // Since we already have a good infrastructure for reading Chunks, we just make a big-ol-Chunk to
     // use for grabbing bytes. Then, once read, we'll use the child Chunks to do the dirty work of inflating
     // and moving the results into the DmrppCommon object.
@@ -476,19 +526,89 @@ void SuperChunk::read_aggregate_bytes()
 
     chunk.set_read_buffer(d_read_buffer, d_size,0,false);
 
-    dmrpp_easy_handle *handle = DmrppRequestHandler::curl_handle_pool->get_easy_handle(&chunk);
-    if (!handle)
-        throw BESInternalError(prolog + "No more libcurl handles.", __FILE__, __LINE__);
+    if (DmrppRequestHandler::d_use_curl_multi) {
+        CurlMultiEngine::TheEngine()->read_data(&chunk);  // throws if error
+    }
+    else {
+        dmrpp_easy_handle *handle = DmrppRequestHandler::curl_handle_pool->get_easy_handle(&chunk);
+        if (!handle)
+            throw BESInternalError(prolog + "No more libcurl handles.", __FILE__, __LINE__);
 
-    try {
-        handle->read_data();  // throws if error
-        DmrppRequestHandler::curl_handle_pool->release_handle(handle);
+        try {
+            handle->read_data();  // throws if error
+            DmrppRequestHandler::curl_handle_pool->release_handle(handle);
+        }
+        catch(...) {
+            DmrppRequestHandler::curl_handle_pool->release_handle(handle);
+            throw;
+        }
     }
-    catch(...) {
-        DmrppRequestHandler::curl_handle_pool->release_handle(handle);
-        throw;
+
+    aggregate_bytes_read(chunk);
+}
+
+/**
+ * @brief Where the SuperChunk can be read straight into the parent Array, if it can.
+ *
+ * That's possible when the Array's data are not filtered, the Chunks follow one
+ * another with no gaps and each Chunk's destination (see Chunk::set_destination())
+ * is just after that of the Chunk before it.
+ *
+ * @return The first Chunk's destination or null.
+ */
+char *SuperChunk::get_array_destination() const
+{
+    if (!d_parent_array || d_chunks.empty() || !d_parent_array->get_filters().empty())
+        return nullptr;
+
+    unsigned long long chunk_bytes = d_parent_array->get_chunk_size_in_elements() * d_parent_array->var()->width();
+    char *first = d_chunks.front()->get_destination();
+    char *dest = first;
+    unsigned long long offset = d_offset;
+    for (const auto &chunk: d_chunks) {
+        if (!dest || chunk->get_destination() != dest || chunk->get_offset() != offset
+            || chunk->get_size() != chunk_bytes)
+            return nullptr;
+        dest += chunk_bytes;
+        offset += chunk_bytes;
     }
 
+    return (offset == d_offset + d_size) ? first : nullptr;
+}
+
+/**
+ * @brief Allocate the receive buffer and point the child Chunks at their parts of it.
+ *
+ * If the SuperChunk's bytes are the values of its part of the parent Array, as
+ * they are, in order, then the Array's buffer is the receive buffer.
+ */
+void SuperChunk::prepare_read_buffer()
+{
+    if(!d_read_buffer){
+        d_read_buffer = get_array_destination();
+        d_read_buffer_is_mine = !d_read_buffer;
+        if (d_read_buffer_is_mine) {
+            // Allocate memory for SuperChunk receive buffer.
+            // release memory in destructor.
+            d_read_buffer = new char[d_size];
+        }
+        else {
+            BESDEBUG(dmrpp_3, prolog << "Reading " << d_id << " straight into the array." << endl);
+        }
+    }
+
+    // Massage the chunks so that their read/receive/intern data buffer
+    // points to the correct section of the d_read_buffer memory.
+    // "Slice it up!"
+    map_chunks_to_buffer();
+}
+
+/**
+ * @brief Check the transfer of the SuperChunk's bytes and mark the child Chunks read.
+ * @param chunk The Chunk used to transfer the SuperChunk's bytes.
+ */
+void SuperChunk::aggregate_bytes_read(const Chunk &chunk)
+{
     // If the expected byte count was not read, it's an error.
     if (d_size != chunk.get_bytes_read()) {
         ostringstream oss;
@@ -496,6 +616,15 @@ void SuperChunk::read_aggregate_bytes()
         throw BESInternalError(oss.str(), __FILE__, __LINE__);
     }
     d_is_read = true;
+
+    // Set each Chunk's read state to true.
+    // Set each chunks byte count to the expected
+    // size for the chunk - because upstream events
+    // have assured this to be true.
+    for(auto child : d_chunks){
+        child->set_is_read(true);
+        child->set_bytes_read(child->get_size());
+    }
 }
 
 
@@ -504,34 +633,53 @@ void SuperChunk::read_aggregate_bytes()
  */
 void SuperChunk::retrieve_data() {
     if (d_is_read) {
-        BESDEBUG(SUPER_CHUNK_MODULE, prolog << "SuperChunk (" << (void **) this << ") has already been read! Returning." << endl);
+        BESDEBUG(dmrpp_3, prolog << "SuperChunk (" << (void **) this << ") has already been read! Returning." << endl);
         return;
     }
 
-    if(!d_read_buffer){
-        // Allocate memory for SuperChunk receive buffer.
-        // release memory in destructor.
-        d_read_buffer = new char[d_size];
-    }
-
-    // Massage the chunks so that their read/receive/intern data buffer
-    // points to the correct section of the d_read_buffer memory.
-    // "Slice it up!"
-    map_chunks_to_buffer();
+    prepare_read_buffer();
 
     // Read the bytes from the target URL. (pthreads, maybe depends on size...)
     // Use one (or possibly more) thread(s) depending on d_size
     // and utilize our friend cURL to stuff the bytes into d_read_buffer
     read_aggregate_bytes();
+}
 
-    // Set each Chunk's read state to true.
-    // Set each chunks byte count to the expected
-    // size for the chunk - because upstream events
-    // have assured this to be true.
-    for(auto chunk : d_chunks){
-        chunk->set_is_read(true);
-        chunk->set_bytes_read(chunk->get_size());
+/**
+ * @brief Start reading the SuperChunk using the CurlMultiEngine.
+ *
+ * Returns once the transfer has been queued. The caller must keep this
+ * SuperChunk alive until \arg on_done has been called.
+ *
+ * @param on_done Called on the engine's event loop thread once the SuperChunk
+ * and its child Chunks are read, with null, or with the error if the transfer
+ * failed. Keep it short; see CurlMultiEngine.
+ */
+void SuperChunk::retrieve_data_async(std::function<void(std::exception_ptr)> on_done) {
+    if (d_is_read) {
+        BESDEBUG(dmrpp_3, prolog << "SuperChunk (" << (void **) this << ") has already been read! Returning." << endl);
+        on_done(nullptr);
+        return;
     }
+
+    prepare_read_buffer();
+
+    // The engine writes into this Chunk until the completion handler runs, so it
+    // lives in the handler.
+    auto chunk = std::make_shared<Chunk>(d_data_url, "NOT_USED", d_size, d_offset);
+    chunk->set_read_buffer(d_read_buffer, d_size, 0, false);
+
+    CurlMultiEngine::TheEngine()->submit(chunk.get(), [this, chunk, on_done](std::exception_ptr error) {
+        if (!error) {
+            try {
+                aggregate_bytes_read(*chunk);
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+        on_done(error);
+    });
 }
 
 
@@ -540,16 +688,16 @@ void SuperChunk::retrieve_data() {
  * @param target_array The array into which to write the data.
  */
 void SuperChunk::process_child_chunks() {
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "BEGIN" << endl );
+    BESDEBUG(dmrpp_3, prolog << "BEGIN" << endl );
     retrieve_data();
 
     vector<unsigned long long> constrained_array_shape = d_parent_array->get_shape(true);
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "d_use_compute_threads: " << (DmrppRequestHandler::d_use_compute_threads ? "true" : "false") << endl);
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "d_max_compute_threads: " << DmrppRequestHandler::d_max_compute_threads << endl);
+    BESDEBUG(dmrpp_3, prolog << "d_use_compute_threads: " << (DmrppRequestHandler::d_use_compute_threads ? "true" : "false") << endl);
+    BESDEBUG(dmrpp_3, prolog << "d_max_compute_threads: " << DmrppRequestHandler::d_max_compute_threads << endl);
 
     if(!DmrppRequestHandler::d_use_compute_threads){
 #if DMRPP_ENABLE_THREAD_TIMERS
-        BESStopWatch sw(SUPER_CHUNK_MODULE);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(prolog+"Serial Chunk Processing. id: " + d_id);
 #endif
         for(const auto &chunk :get_chunks()){
@@ -560,7 +708,7 @@ void SuperChunk::process_child_chunks() {
 #if DMRPP_ENABLE_THREAD_TIMERS
         stringstream timer_name;
         timer_name << prolog << "Concurrent Chunk Processing. id: " << d_id;
-        BESStopWatch sw(SUPER_CHUNK_MODULE);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(timer_name.str());
 #endif
         queue<shared_ptr<Chunk>> chunks_to_process;
@@ -569,7 +717,7 @@ void SuperChunk::process_child_chunks() {
 
         process_chunks_concurrent(d_id, chunks_to_process, d_parent_array, constrained_array_shape);
     }
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "END" << endl );
+    BESDEBUG(dmrpp_3, prolog << "END" << endl );
 }
 
 
@@ -579,7 +727,7 @@ void SuperChunk::process_child_chunks() {
  */
 void SuperChunk::process_child_chunks_unconstrained() {
 
-    BESDEBUG(SUPER_CHUNK_MODULE, prolog << "BEGIN" << endl );
+    BESDEBUG(dmrpp_3, prolog << "BEGIN" << endl );
     retrieve_data();
 
     // The size in element of each of the array's dimensions
@@ -589,7 +737,7 @@ void SuperChunk::process_child_chunks_unconstrained() {
 
     if(!DmrppRequestHandler::d_use_compute_threads){
 #if DMRPP_ENABLE_THREAD_TIMERS
-        BESStopWatch sw(SUPER_CHUNK_MODULE);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(prolog + "Serial Chunk Processing. sc_id: " + d_id );
 #endif
         for(auto &chunk :get_chunks()){
@@ -600,7 +748,7 @@ void SuperChunk::process_child_chunks_unconstrained() {
 #if DMRPP_ENABLE_THREAD_TIMERS
         stringstream timer_name;
         timer_name << prolog << "Concurrent Chunk Processing. sc_id: " << d_id;
-        BESStopWatch sw(SUPER_CHUNK_MODULE);
+        BESStopWatch sw(dmrpp_3.name());
         sw.start(timer_name.str());
 #endif
         queue<shared_ptr<Chunk>> chunks_to_process;
@@ -30,6 +30,8 @@
 #include <thread>
 #include <queue>
 #include <sstream>
+#include <functional>
+#include <exception>
 
 
 #include "Chunk.h"
@@ -54,18 +56,27 @@ private:
     unsigned long long d_size;
     bool d_is_read;
     char *d_read_buffer;
+    bool d_read_buffer_is_mine; // False when the SuperChunk is read into its parent Array's buffer
+
+    // Chunks separated by at most d_max_gap unused bytes are read with one
+    // request; d_max_size (when not zero) caps the size of that request.
+    unsigned long long d_max_gap;
+    unsigned long long d_max_size;
 
     bool is_contiguous(std::shared_ptr<Chunk> candidate_chunk);
     void map_chunks_to_buffer();
     void read_aggregate_bytes();
+    char *get_array_destination() const;
+    void prepare_read_buffer();
+    void aggregate_bytes_read(const Chunk &chunk);
 
 public:
 
-    explicit SuperChunk(const std::string sc_id, DmrppArray *parent=nullptr):
-    d_id(sc_id), d_parent_array(parent), d_data_url(""), d_offset(0), d_size(0), d_is_read(false), d_read_buffer(nullptr){}
+    explicit SuperChunk(const std::string sc_id, DmrppArray *parent=nullptr);
 
     virtual ~SuperChunk(){
-        delete[] d_read_buffer;
+        if (d_read_buffer_is_mine)
+            delete[] d_read_buffer;
     }
 
     virtual std::string id(){ return d_id; }
@@ -76,6 +87,11 @@ public:
     virtual unsigned long long get_size(){ return d_size; }
     virtual unsigned long long get_offset(){ return d_offset; }
 
+    virtual unsigned long long get_max_gap() const { return d_max_gap; }
+    virtual void set_max_gap(unsigned long long max_gap){ d_max_gap = max_gap; }
+    virtual unsigned long long get_max_size() const { return d_max_size; }
+    virtual void set_max_size(unsigned long long max_size){ d_max_size = max_size; }
+
     virtual void read(){
         retrieve_data();
         process_child_chunks();
@@ -86,6 +102,7 @@ public:
     }
 
     virtual void retrieve_data();
+    virtual void retrieve_data_async(std::function<void(std::exception_ptr)> on_done);
     virtual void process_child_chunks();
     virtual void process_child_chunks_unconstrained();
 
@@ -132,6 +149,12 @@ struct one_chunk_unconstrained_args {
             array(a), array_shape(a_s), chunk_shape(c_s) {}
 };
 
+void process_one_chunk(std::shared_ptr<Chunk> chunk, DmrppArray *array,
+        const std::vector<unsigned long long> &constrained_array_shape);
+
+void process_one_chunk_unconstrained(std::shared_ptr<Chunk> chunk, const std::vector<unsigned long long> &chunk_shape,
+        DmrppArray *array, const std::vector<unsigned long long> &array_shape);
+
 void process_chunks_concurrent(
         const string &super_chunk_id,
         std::queue<shared_ptr<Chunk>> &chunks,
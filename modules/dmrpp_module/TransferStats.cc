@@ -0,0 +1,178 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <cstdlib>
+
+#include <curl/curl.h>
+
+#include "BESDebug.h"
+#include "BESIndent.h"
+
+#include "TransferStats.h"
+
+#define prolog std::string("TransferStats::").append(__func__).append("() - ")
+
+#define STATS_MODULE "dmrpp:stats"
+
+using namespace std;
+
+namespace dmrpp {
+
+// Weight of the newest sample in the moving averages
+static const double ewma_weight = 0.2;
+
+// Transfers shorter than this (after the first byte) say little about bandwidth
+static const double min_bandwidth_sample_time = 0.001;  // seconds
+static const unsigned long long min_bandwidth_sample_bytes = 64 * 1024;
+
+TransferStats *TransferStats::d_instance = nullptr;
+static std::once_flag d_ts_init_once;
+
+/**
+ * @brief Get the singleton TransferStats instance.
+ */
+TransferStats *
+TransferStats::TheStats()
+{
+    std::call_once(d_ts_init_once, TransferStats::initialize_instance);
+
+    return d_instance;
+}
+
+/**
+ * private static that only get's called once by using std::call_once()
+ */
+void TransferStats::initialize_instance()
+{
+    d_instance = new TransferStats;
+#ifdef HAVE_ATEXIT
+    atexit(delete_instance);
+#endif
+}
+
+void TransferStats::delete_instance()
+{
+    delete d_instance;
+    d_instance = nullptr;
+}
+
+/**
+ * @brief The scheme and host (with the port, if any) part of a URL.
+ *
+ * S3 URLs for different objects in one bucket share a host, and so share
+ * their statistics.
+ */
+string TransferStats::host(const string &url)
+{
+    string::size_type start = url.find("://");
+    start = (start == string::npos) ? 0 : start + 3;
+    string::size_type end = url.find('/', start);
+    return url.substr(0, end);
+}
+
+/**
+ * @brief Add one transfer to the estimates for its host.
+ *
+ * @param url The URL that was read
+ * @param latency Seconds from the start of the request to the first byte
+ * @param bytes The number of bytes read
+ * @param transfer_time Seconds from the first to the last byte
+ */
+void TransferStats::add_sample(const string &url, double latency, unsigned long long bytes, double transfer_time)
+{
+    string key = host(url);
+
+    std::lock_guard<std::mutex> lock(d_mtx);
+    host_stats &stats = d_hosts[key];
+
+    if (latency > 0.0) {
+        stats.latency = stats.latency_samples ? stats.latency + ewma_weight * (latency - stats.latency) : latency;
+        stats.latency_samples++;
+    }
+
+    if (transfer_time > min_bandwidth_sample_time && bytes >= min_bandwidth_sample_bytes) {
+        double bandwidth = bytes / transfer_time;
+        stats.bandwidth = stats.bandwidth_samples ? stats.bandwidth + ewma_weight * (bandwidth - stats.bandwidth) : bandwidth;
+        stats.bandwidth_samples++;
+    }
+
+    BESDEBUG(STATS_MODULE, prolog << key << " latency: " << stats.latency << " s, bandwidth: " << stats.bandwidth
+                                  << " bytes/s" << endl);
+}
+
+/**
+ * @brief Add a transfer that a libcurl easy handle has just completed.
+ *
+ * @param url The URL that was read
+ * @param handle The handle that read it
+ * @param bytes The number of bytes read
+ */
+void TransferStats::record(const string &url, CURL *handle, unsigned long long bytes)
+{
+    double start_transfer = 0.0;
+    double total = 0.0;
+    if (curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME, &start_transfer) != CURLE_OK
+        || curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME, &total) != CURLE_OK)
+        return;
+
+    add_sample(url, start_transfer, bytes, total - start_transfer);
+}
+
+/**
+ * @brief The largest gap between Chunks that is cheaper to read through than to skip.
+ *
+ * @param url The data URL of the SuperChunk
+ * @param limit Never suggest a gap larger than this
+ * @return latency * bandwidth for the URL's host, at most \arg limit, or zero
+ * if there are not yet estimates of both for the host.
+ */
+unsigned long long TransferStats::suggested_gap(const string &url, unsigned long long limit) const
+{
+    std::lock_guard<std::mutex> lock(d_mtx);
+    auto i = d_hosts.find(host(url));
+    if (i == d_hosts.end() || !i->second.latency_samples || !i->second.bandwidth_samples)
+        return 0;
+
+    double gap = i->second.latency * i->second.bandwidth;
+    return (gap >= static_cast<double>(limit)) ? limit : static_cast<unsigned long long>(gap);
+}
+
+void TransferStats::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "TransferStats::" << __func__ << "(" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    std::lock_guard<std::mutex> lock(d_mtx);
+    for (const auto &h: d_hosts) {
+        strm << BESIndent::LMarg << h.first << " latency: " << h.second.latency << " s ("
+             << h.second.latency_samples << " samples), bandwidth: " << h.second.bandwidth << " bytes/s ("
+             << h.second.bandwidth_samples << " samples)" << endl;
+    }
+    BESIndent::UnIndent();
+}
+
+} // namespace dmrpp
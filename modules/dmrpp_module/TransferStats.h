@@ -0,0 +1,89 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _TransferStats_h
+#define _TransferStats_h 1
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <ostream>
+
+#include <curl/curl.h>
+
+namespace dmrpp {
+
+/**
+ * @brief Per-host latency and bandwidth estimates made from completed transfers.
+ *
+ * This singleton is used to tune how far apart two Chunks may be and still
+ * be read by one SuperChunk request (DMRPP.SuperChunkAutoGap). Skipping a
+ * gap of g bytes with a separate request costs about one round trip, while
+ * reading through it costs g / bandwidth, so it pays to read through any gap
+ * smaller than latency * bandwidth.
+ *
+ * The estimates are exponentially weighted moving averages, so they follow
+ * changes in a host's performance without being thrown off by one slow
+ * request.
+ */
+class TransferStats {
+private:
+    struct host_stats {
+        double latency;         ///< Seconds to the first byte
+        double bandwidth;       ///< Bytes/second after the first byte
+        unsigned long long latency_samples;
+        unsigned long long bandwidth_samples;
+
+        host_stats() : latency(0.0), bandwidth(0.0), latency_samples(0), bandwidth_samples(0) {}
+    };
+
+    static TransferStats *d_instance;
+
+    mutable std::mutex d_mtx;
+    std::map<std::string, host_stats> d_hosts;
+
+    static void initialize_instance();
+    static void delete_instance();
+
+    friend class TransferStatsTest;
+
+public:
+    TransferStats() = default;
+    virtual ~TransferStats() = default;
+
+    static TransferStats *TheStats();
+
+    static std::string host(const std::string &url);
+
+    void add_sample(const std::string &url, double latency, unsigned long long bytes, double transfer_time);
+
+    void record(const std::string &url, CURL *handle, unsigned long long bytes);
+
+    unsigned long long suggested_gap(const std::string &url, unsigned long long limit) const;
+
+    virtual void dump(std::ostream &strm) const;
+};
+
+} // namespace dmrpp
+
+#endif // _TransferStats_h
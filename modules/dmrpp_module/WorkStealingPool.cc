@@ -0,0 +1,339 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "BESDebug.h"
+#include "BESIndent.h"
+#include "BESInternalError.h"
+#include "BESTrace.h"
+
+#include "DmrppRequestHandler.h"
+#include "WorkStealingPool.h"
+
+#define prolog std::string("WorkStealingPool::").append(__func__).append("() - ")
+
+#define POOL_MODULE "dmrpp:pool"
+
+using namespace std;
+
+namespace dmrpp {
+
+// The worker that is running on this thread, if any. These let submit() tell
+// a task submitted by one of a pool's own workers from one submitted by some
+// other thread.
+static thread_local WorkStealingPool *tl_current_pool = nullptr;
+static thread_local unsigned int tl_current_index = 0;
+
+// The process-wide pools. They are rebuilt in a child process because the
+// threads of the parent's pools do not survive fork().
+static std::mutex pool_init_mtx;
+static WorkStealingPool *transfer_pool = nullptr;
+static WorkStealingPool *compute_pool = nullptr;
+
+/**
+ * @brief Build a pool and start its worker threads.
+ * @param name The pool's name, used in debugging output
+ * @param num_workers The number of worker threads; a value of zero is
+ * treated as one.
+ */
+WorkStealingPool::WorkStealingPool(const string &name, unsigned int num_workers) :
+        d_name(name), d_shutdown(false), d_queue_depth(0), d_steals(0), d_executed(0), d_next_queue(0),
+        d_owner_pid(getpid())
+{
+    if (num_workers == 0) num_workers = 1;
+
+    for (unsigned int i = 0; i < num_workers; ++i)
+        d_queues.emplace_back(new worker_queue());
+
+    d_workers.reserve(num_workers);
+    for (unsigned int i = 0; i < num_workers; ++i)
+        d_workers.emplace_back(&WorkStealingPool::worker_loop, this, i);
+
+    BESDEBUG(POOL_MODULE, prolog << "Started pool '" << d_name << "' with " << num_workers << " workers." << endl);
+}
+
+/**
+ * @brief Stop the workers once the queued tasks have run.
+ */
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(d_idle_mtx);
+        d_shutdown = true;
+    }
+    d_idle_cv.notify_all();
+
+    for (auto &worker: d_workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+/**
+ * @brief Queue a task.
+ *
+ * A task submitted by one of this pool's workers goes onto that worker's
+ * own deque; other tasks are spread round-robin across the workers.
+ *
+ * @param task The work to do. Exceptions thrown by the task are the caller's
+ * concern; use TaskGroup to collect them.
+ */
+void WorkStealingPool::submit(std::function<void()> task)
+{
+    unsigned int index;
+    if (tl_current_pool == this)
+        index = tl_current_index;
+    else
+        index = d_next_queue++ % d_queues.size();
+
+    // Bump the depth first, and while holding the idle mutex, so that a worker
+    // about to sleep cannot miss this task and the count never goes negative.
+    {
+        std::lock_guard<std::mutex> lock(d_idle_mtx);
+        d_queue_depth++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(d_queues[index]->d_mtx);
+        d_queues[index]->d_tasks.push_back(std::move(task));
+    }
+
+    d_idle_cv.notify_one();
+}
+
+/**
+ * @brief Take the newest task from a worker's own deque.
+ */
+bool WorkStealingPool::pop_local(unsigned int index, std::function<void()> &task)
+{
+    std::lock_guard<std::mutex> lock(d_queues[index]->d_mtx);
+    if (d_queues[index]->d_tasks.empty()) return false;
+
+    task = std::move(d_queues[index]->d_tasks.back());
+    d_queues[index]->d_tasks.pop_back();
+    d_queue_depth--;
+    return true;
+}
+
+/**
+ * @brief Take the oldest task from some other worker's deque.
+ */
+bool WorkStealingPool::steal(unsigned int thief, std::function<void()> &task)
+{
+    unsigned int n = static_cast<unsigned int>(d_queues.size());
+    for (unsigned int i = 1; i < n; ++i) {
+        unsigned int victim = (thief + i) % n;
+        std::unique_lock<std::mutex> lock(d_queues[victim]->d_mtx, std::try_to_lock);
+        if (!lock.owns_lock() || d_queues[victim]->d_tasks.empty()) continue;
+
+        task = std::move(d_queues[victim]->d_tasks.front());
+        d_queues[victim]->d_tasks.pop_front();
+        d_queue_depth--;
+        d_steals++;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::worker_loop(unsigned int index)
+{
+    tl_current_pool = this;
+    tl_current_index = index;
+
+    while (true) {
+        std::function<void()> task;
+        if (pop_local(index, task) || steal(index, task)) {
+            // Count the task before it runs; once it finishes, a TaskGroup
+            // may wake a thread that reads the count.
+            d_executed++;
+            try {
+                task();
+            }
+            catch (...) {
+                // Tasks are expected to handle their own errors (TaskGroup does).
+                // Never let one escape and take down the worker.
+                BESDEBUG(POOL_MODULE, prolog << "Pool '" << d_name << "' worker " << index
+                                             << " caught an exception from a task." << endl);
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(d_idle_mtx);
+        // A try_lock in steal() may have skipped a busy deque; only sleep when
+        // there is really nothing queued anywhere.
+        d_idle_cv.wait(lock, [this] { return d_shutdown || d_queue_depth > 0; });
+        if (d_shutdown && d_queue_depth == 0) break;
+    }
+
+    tl_current_pool = nullptr;
+}
+
+void WorkStealingPool::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "WorkStealingPool::" << __func__ << "(" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    strm << BESIndent::LMarg << "name: " << d_name << endl;
+    strm << BESIndent::LMarg << "workers: " << size() << endl;
+    strm << BESIndent::LMarg << "queue_depth: " << queue_depth() << endl;
+    strm << BESIndent::LMarg << "steals: " << steal_count() << endl;
+    strm << BESIndent::LMarg << "tasks_executed: " << tasks_executed() << endl;
+    BESIndent::UnIndent();
+}
+
+/**
+ * Build the transfer and compute pools for this process. If the pools were
+ * made by a parent process their threads are gone; the old objects are
+ * abandoned (joining threads that do not exist would hang).
+ */
+void WorkStealingPool::make_pools()
+{
+    pid_t pid = getpid();
+
+    if (!transfer_pool || transfer_pool->owner_pid() != pid)
+        transfer_pool = new WorkStealingPool("transfer", DmrppRequestHandler::d_max_transfer_threads);
+
+    if (!compute_pool || compute_pool->owner_pid() != pid)
+        compute_pool = new WorkStealingPool("compute", DmrppRequestHandler::d_max_compute_threads);
+}
+
+/**
+ * @brief The pool used for the data transfers of SuperChunks.
+ * @return The process-wide transfer pool, sized by DMRPP.MaxParallelTransfers
+ */
+WorkStealingPool *WorkStealingPool::TheTransferPool()
+{
+    std::lock_guard<std::mutex> lock(pool_init_mtx);
+    make_pools();
+    return transfer_pool;
+}
+
+/**
+ * @brief The pool used to decompress chunks and insert them into arrays.
+ * @return The process-wide compute pool, sized by DMRPP.MaxComputeThreads
+ */
+WorkStealingPool *WorkStealingPool::TheComputePool()
+{
+    std::lock_guard<std::mutex> lock(pool_init_mtx);
+    make_pools();
+    return compute_pool;
+}
+
+//#####################################################################################################################
+//
+// TaskGroup
+//
+// = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = = =
+
+/**
+ * The tasks hold a reference to the group, so the group cannot go away
+ * until they are done. Errors are dropped here; call wait() to see them.
+ */
+TaskGroup::~TaskGroup()
+{
+    std::unique_lock<std::mutex> lock(d_mtx);
+    d_done_cv.wait(lock, [this] { return d_pending == 0; });
+}
+
+/**
+ * @brief Count a task that runs outside of a WorkStealingPool.
+ *
+ * Work that completes asynchronously somewhere else, e.g., a transfer run
+ * by the CurlMultiEngine, can be made part of the group by calling this
+ * before it starts and task_finished() when it is done.
+ */
+void TaskGroup::task_started()
+{
+    std::lock_guard<std::mutex> lock(d_mtx);
+    ++d_pending;
+}
+
+/**
+ * @brief Mark one of the group's tasks as done.
+ * @param error The exception the task threw, or null.
+ */
+void TaskGroup::task_finished(std::exception_ptr error)
+{
+    std::lock_guard<std::mutex> lock(d_mtx);
+    if (error && !d_error) {
+        d_error = error;
+        d_cancelled = true;
+    }
+    if (--d_pending == 0)
+        d_done_cv.notify_all();
+}
+
+/**
+ * @brief Run a task in a pool as part of this group.
+ *
+ * The group's count is incremented before the task is queued, so a task
+ * that starts more tasks in the same group keeps wait() from returning
+ * until its children are done too.
+ *
+ * @param pool Run the task using this pool's workers
+ * @param task The task.
+ */
+void TaskGroup::run(WorkStealingPool &pool, std::function<void()> task)
+{
+    task_started();
+
+    // The task's spans are children of the span that queued it
+    task = BESTrace::bind(std::move(task));
+
+    pool.submit([this, task]() {
+        std::exception_ptr error = nullptr;
+        if (!d_cancelled) {
+            try {
+                task();
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+        task_finished(error);
+    });
+}
+
+/**
+ * @brief Block until every task in the group has finished.
+ *
+ * @exception Rethrows the first exception thrown by one of the group's tasks.
+ */
+void TaskGroup::wait()
+{
+    std::exception_ptr error = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(d_mtx);
+        d_done_cv.wait(lock, [this] { return d_pending == 0; });
+        error = d_error;
+        d_error = nullptr;
+    }
+
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace dmrpp
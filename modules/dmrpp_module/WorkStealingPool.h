@@ -0,0 +1,167 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _WorkStealingPool_h
+#define _WorkStealingPool_h 1
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <ostream>
+
+#include <unistd.h>
+
+namespace dmrpp {
+
+/**
+ * @brief A long-lived pool of worker threads that share work by stealing.
+ *
+ * Each worker owns a deque of tasks. A task submitted by one of the pool's
+ * own workers is pushed onto that worker's deque (and popped LIFO by it),
+ * which keeps follow-on work close to the data that produced it. Tasks
+ * submitted from outside the pool are spread round-robin across the workers.
+ * An idle worker first drains its own deque and then steals (FIFO) from
+ * the other workers before going to sleep on the pool's condition variable.
+ *
+ * The DMR++ handler uses two of these: one sized for the data transfers
+ * (DMRPP.MaxParallelTransfers) and one sized for decompression and array
+ * insertion (DMRPP.MaxComputeThreads). They are created the first time they
+ * are used in a given process so that the beslistener children, which are
+ * forked after the module is loaded, each get their own workers.
+ *
+ * @note Never wait on a TaskGroup from a task running in the same pool
+ * the group's tasks run in; that can deadlock a small pool.
+ */
+class WorkStealingPool {
+private:
+    struct worker_queue {
+        std::mutex d_mtx;
+        std::deque<std::function<void()>> d_tasks;
+    };
+
+    std::string d_name;
+    std::vector<std::unique_ptr<worker_queue>> d_queues;
+    std::vector<std::thread> d_workers;
+
+    std::mutex d_idle_mtx;
+    std::condition_variable d_idle_cv;
+    bool d_shutdown;
+
+    std::atomic<unsigned long long> d_queue_depth;
+    std::atomic<unsigned long long> d_steals;
+    std::atomic<unsigned long long> d_executed;
+    std::atomic<unsigned int> d_next_queue;
+
+    pid_t d_owner_pid;
+
+    bool pop_local(unsigned int index, std::function<void()> &task);
+    bool steal(unsigned int thief, std::function<void()> &task);
+    void worker_loop(unsigned int index);
+
+    static void make_pools();
+
+    friend class WorkStealingPoolTest;
+
+public:
+    WorkStealingPool(const std::string &name, unsigned int num_workers);
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    virtual ~WorkStealingPool();
+
+    void submit(std::function<void()> task);
+
+    /// @brief The name of this pool, used in debugging output.
+    std::string name() const { return d_name; }
+
+    /// @brief The number of worker threads in the pool.
+    unsigned int size() const { return static_cast<unsigned int>(d_workers.size()); }
+
+    /// @brief The number of tasks waiting to run, summed across all of the workers.
+    unsigned long long queue_depth() const { return d_queue_depth; }
+
+    /// @brief The number of tasks one worker has taken from another worker's deque.
+    unsigned long long steal_count() const { return d_steals; }
+
+    /// @brief The number of tasks the workers have started; those running now are included.
+    unsigned long long tasks_executed() const { return d_executed; }
+
+    /// @brief The pid of the process that started this pool's threads.
+    pid_t owner_pid() const { return d_owner_pid; }
+
+    virtual void dump(std::ostream &strm) const;
+
+    static WorkStealingPool *TheTransferPool();
+    static WorkStealingPool *TheComputePool();
+};
+
+/**
+ * @brief Track a set of tasks submitted to one or more WorkStealingPools.
+ *
+ * The group counts the tasks it has started that are not yet finished.
+ * Tasks may add more tasks to the same group (e.g., a transfer task can
+ * start the decompression tasks for the chunks it read) and wait() will
+ * not return until all of them are done. No polling is involved; the last
+ * task to finish wakes the waiting thread.
+ *
+ * If a task throws, the first exception is saved, the tasks that have not
+ * yet started are skipped and wait() rethrows the saved exception.
+ */
+class TaskGroup {
+private:
+    std::mutex d_mtx;
+    std::condition_variable d_done_cv;
+    unsigned long long d_pending;
+    std::exception_ptr d_error;
+    std::atomic<bool> d_cancelled;
+
+public:
+    TaskGroup() : d_pending(0), d_error(nullptr), d_cancelled(false) {}
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    virtual ~TaskGroup();
+
+    void run(WorkStealingPool &pool, std::function<void()> task);
+
+    void task_started();
+    void task_finished(std::exception_ptr error);
+
+    void wait();
+
+    /// @brief True once one of the group's tasks has thrown an exception.
+    bool cancelled() const { return d_cancelled; }
+};
+
+} // namespace dmrpp
+
+#endif // _WorkStealingPool_h
@@ -80,6 +80,8 @@ typedef struct H5D_chunk_rec_t {
 #include "DmrppTypeFactory.h"
 #include "DmrppD4Group.h"
 #include "DmrppMetadataStore.h"
+#include "DmrppBinary.h"
+#include "FilterRegistry.h"
 #include "BESDapNames.h"
 
 using namespace std;
@@ -449,7 +451,30 @@ static void set_filter_information(hid_t dataset_id, DmrppCommon *dc) {
                     VERBOSE(cerr << "H5Z_FILTER_SHUFFLE" << endl);
                     dc->set_shuffle(true);
                     break;
+                case H5Z_FILTER_FLETCHER32:
+                    VERBOSE(cerr << "H5Z_FILTER_FLETCHER32" << endl);
+                    dc->add_filter(FILTER_FLETCHER32);
+                    break;
+                case H5Z_FILTER_SCALEOFFSET: {
+                    VERBOSE(cerr << "H5Z_FILTER_SCALEOFFSET" << endl);
+                    // The DMR++ doesn't hold the scale factor floating point values need.
+                    hid_t type_id = H5Dget_type(dataset_id);
+                    H5T_class_t type_class = H5Tget_class(type_id);
+                    H5Tclose(type_id);
+                    if (type_class != H5T_INTEGER)
+                        throw BESInternalError("The scale-offset filter is only supported for integer data.", __FILE__, __LINE__);
+                    dc->add_filter(FILTER_SCALEOFFSET);
+                    break;
+                }
                 default: {
+                    // Registered filters the handler knows, e.g., LZ4, Zstandard and Blosc
+                    auto info = (filter_type > 0) ? FilterRegistry::TheRegistry()->find((unsigned int) filter_type) : nullptr;
+                    if (info) {
+                        VERBOSE(cerr << info->name << endl);
+                        dc->add_filter(info->id);
+                        break;
+                    }
+
                     ostringstream oss("Unsupported HDF5 filter: ", std::ios::ate);
                     oss << filter_type;
                     throw BESInternalError(oss.str(), __FILE__, __LINE__);
@@ -773,15 +798,30 @@ static void get_chunks_for_all_variables(hid_t file, D4Group *group) {
         get_chunks_for_all_variables(file, *g++);
 }
 
+/**
+ * @brief Write the DMR++ as a binary DMR++ (see DmrppBinary)
+ * @param dmrpp The DMR++, with its chunks
+ * @param href The dataset's dmrpp:href
+ * @param binary_name Write the binary DMR++ to this file
+ */
+static void write_binary_dmrpp(DMRpp &dmrpp, const string &href, const string &binary_name)
+{
+    ofstream out(binary_name.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out)
+        throw BESInternalError("Could not open '" + binary_name + "' to write the binary DMR++.", __FILE__, __LINE__);
+
+    DmrppBinary::write(dmrpp, href, out);
+}
 
 int main(int argc, char *argv[]) {
     string h5_file_name = "";
     string h5_dset_path = "";
     string dmr_name = "";
     string url_name = "";
+    string binary_name = "";
     int status = 0;
 
-    GetOpt getopt(argc, argv, "c:f:r:u:dhv");
+    GetOpt getopt(argc, argv, "b:c:f:r:u:dhv");
     int option_char;
     while ((option_char = getopt()) != -1) {
         switch (option_char) {
@@ -802,12 +842,15 @@ int main(int argc, char *argv[]) {
             case 'u':
                 url_name = getopt.optarg;
                 break;
+            case 'b':
+                binary_name = getopt.optarg;
+                break;
             case 'c':
                 TheBESKeys::ConfigFile = getopt.optarg;
                 break;
             case 'h':
                 cerr
-                        << "build_dmrpp [-v] -c <bes.conf> -f <data file>  [-u <href url>] | build_dmrpp -f <data file> -r <dmr file> | build_dmrpp -h"
+                        << "build_dmrpp [-v] -c <bes.conf> -f <data file>  [-u <href url>] [-b <binary dmr++ file>] | build_dmrpp -f <data file> -r <dmr file> [-b <binary dmr++ file>] | build_dmrpp -h"
                         << endl;
                 exit(1);
             default:
@@ -852,6 +895,9 @@ int main(int argc, char *argv[]) {
             dmrpp->print_dmrpp(writer, url_name);
 
             cout << writer.get_doc();
+
+            if (!binary_name.empty())
+                write_binary_dmrpp(*dmrpp, url_name, binary_name);
         } else {
             bool found;
             string bes_data_root;
@@ -908,6 +954,9 @@ int main(int argc, char *argv[]) {
                 dmrpp->print_dap4(writer);
 
                 cout << writer.get_doc();
+
+                if (!binary_name.empty())
+                    write_binary_dmrpp(*dmrpp, url_name, binary_name);
             } else {
                 cerr << "Error: Could not get a lock on the DMR for '" + h5_file_path + "'." << endl;
                 return 1;
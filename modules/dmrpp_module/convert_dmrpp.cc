@@ -0,0 +1,127 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <GetOpt.h>
+#include <Error.h>
+
+#include <TheBESKeys.h>
+#include <BESError.h>
+#include <BESDebug.h>
+
+#include "DmrppNames.h"
+#include "DmrppBinary.h"
+
+using namespace std;
+using namespace dmrpp;
+
+static void usage()
+{
+    cerr << "convert_dmrpp [-v] [-d] [-c <bes.conf>] <dmr++ file> <binary dmr++ file> | convert_dmrpp -h" << endl;
+}
+
+/**
+ * Convert a DMR++ XML document to a binary DMR++ (see DmrppBinary).
+ */
+int main(int argc, char *argv[])
+{
+    bool verbose = false;
+
+    GetOpt getopt(argc, argv, "c:dhv");
+    int option_char;
+    while ((option_char = getopt()) != -1) {
+        switch (option_char) {
+            case 'v':
+                verbose = true;
+                break;
+            case 'd':
+                BESDebug::SetUp(string("cerr,").append(MODULE));
+                break;
+            case 'c':
+                TheBESKeys::ConfigFile = getopt.optarg;
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - getopt.optind != 2) {
+        usage();
+        return 1;
+    }
+
+    string dmrpp_name = argv[getopt.optind];
+    string binary_name = argv[getopt.optind + 1];
+
+    try {
+        if (DmrppBinary::is_binary_file(dmrpp_name)) {
+            cerr << "'" << dmrpp_name << "' is already a binary DMR++." << endl;
+            return 1;
+        }
+
+        ifstream in(dmrpp_name.c_str());
+        if (!in) {
+            cerr << "Could not open '" << dmrpp_name << "'." << endl;
+            return 1;
+        }
+        ostringstream document;
+        document << in.rdbuf();
+
+        ofstream out(binary_name.c_str(), ios::out | ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "Could not open '" << binary_name << "'." << endl;
+            return 1;
+        }
+
+        DmrppBinary::convert(document.str(), out);
+        out.close();
+
+        if (verbose)
+            cerr << "Converted " << document.str().size() << " bytes of DMR++ to a binary DMR++ in '"
+                << binary_name << "'." << endl;
+    }
+    catch (BESError &e) {
+        cerr << "BESError: " << e.get_message() << endl;
+        return 1;
+    }
+    catch (libdap::Error &e) {
+        cerr << "Error: " << e.get_error_message() << endl;
+        return 1;
+    }
+    catch (std::exception &e) {
+        cerr << "std::exception: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
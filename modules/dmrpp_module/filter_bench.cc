@@ -0,0 +1,264 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+// Measure how fast the FilterRegistry decodes chunks. For each chunk size and
+// filter chain, the chunk is encoded once and then decoded repeatedly; the
+// throughput is the number of decoded bytes per second.
+//
+// Usage: filter_bench [-t seconds] [chunk_size ...]
+// The default chunk sizes are 64 KiB, 1 MiB and 4 MiB.
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <functional>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#if HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+#if HAVE_LIBZSTD
+#include <zstd.h>
+#endif
+
+#if HAVE_LIBBLOSC
+#include <blosc.h>
+#endif
+
+#include "BESError.h"
+
+#include "FilterRegistry.h"
+
+using namespace std;
+using namespace dmrpp;
+
+static double min_seconds = 0.5;
+
+/**
+ * Float32 values that vary smoothly, like most gridded science data. The
+ * exponent bytes repeat, so shuffling helps the compressors as it does with
+ * real data.
+ */
+static vector<char> make_float_data(unsigned long long bytes)
+{
+    vector<char> data(bytes);
+    unsigned long long n = bytes / sizeof(float);
+    for (unsigned long long i = 0; i < n; i++) {
+        float v = 280.0f + 15.0f * sinf(i / 500.0f) + (i % 7) * 0.01f;
+        memcpy(data.data() + i * sizeof(float), &v, sizeof(float));
+    }
+    return data;
+}
+
+static vector<char> encode_shuffle(const vector<char> &data, unsigned long long width)
+{
+    vector<char> out(data.size());
+    unsigned long long elems = data.size() / width;
+    for (unsigned long long i = 0; i < elems; i++)
+        for (unsigned long long b = 0; b < width; b++)
+            out[b * elems + i] = data[i * width + b];
+    memcpy(out.data() + elems * width, data.data() + elems * width, data.size() % width);
+    return out;
+}
+
+static vector<char> encode_deflate(const vector<char> &data)
+{
+    uLongf len = compressBound(data.size());
+    vector<char> out(len);
+    if (compress2(reinterpret_cast<Bytef *>(out.data()), &len, reinterpret_cast<const Bytef *>(data.data()),
+                  data.size(), 4) != Z_OK)
+        throw runtime_error("compress2() failed");
+    out.resize(len);
+    return out;
+}
+
+#if HAVE_LIBLZ4
+// One block, in the HDF5 LZ4 filter's framing
+static vector<char> encode_lz4(const vector<char> &data)
+{
+    vector<char> out(12 + 4 + LZ4_compressBound(data.size()));
+    unsigned long long size = data.size();
+    for (int i = 0; i < 8; i++) out[i] = static_cast<char>(size >> (56 - 8 * i));
+    for (int i = 0; i < 4; i++) out[8 + i] = static_cast<char>(size >> (24 - 8 * i));
+    int n = LZ4_compress_default(data.data(), out.data() + 16, data.size(), out.size() - 16);
+    for (int i = 0; i < 4; i++) out[12 + i] = static_cast<char>(n >> (24 - 8 * i));
+    out.resize(16 + n);
+    return out;
+}
+#endif
+
+#if HAVE_LIBZSTD
+static vector<char> encode_zstd(const vector<char> &data)
+{
+    vector<char> out(ZSTD_compressBound(data.size()));
+    size_t n = ZSTD_compress(out.data(), out.size(), data.data(), data.size(), 3);
+    out.resize(n);
+    return out;
+}
+#endif
+
+#if HAVE_LIBBLOSC
+static vector<char> encode_blosc(const vector<char> &data)
+{
+    vector<char> out(data.size() + BLOSC_MAX_OVERHEAD);
+    int n = blosc_compress(5, BLOSC_SHUFFLE, sizeof(float), data.size(), data.data(), out.data(), out.size());
+    out.resize(n);
+    return out;
+}
+#endif
+
+/**
+ * Decode the encoded chunk until min_seconds have passed, check the result
+ * once and print the throughput.
+ */
+static void run(const string &label, const vector<char> &original, const vector<char> &encoded,
+                const function<void(char *)> &decode)
+{
+    vector<char> dest(original.size());
+
+    decode(dest.data());
+    if (dest != original) {
+        cout << setw(28) << left << label << " decoded data do not match!" << endl;
+        return;
+    }
+
+    unsigned long long iterations = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        decode(dest.data());
+        iterations++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < min_seconds);
+
+    double mb_per_sec = (original.size() * iterations) / elapsed / (1024.0 * 1024.0);
+    cout << setw(28) << left << label << setw(12) << right << fixed << setprecision(1) << mb_per_sec << " MB/s"
+         << setw(10) << setprecision(2) << (double) original.size() / encoded.size() << ":1" << endl;
+}
+
+static void bench(unsigned long long chunk_size)
+{
+    const filter_args args(sizeof(float));
+    const FilterRegistry *registry = FilterRegistry::TheRegistry();
+
+    vector<char> data = make_float_data(chunk_size);
+    vector<char> shuffled = encode_shuffle(data, sizeof(float));
+
+    cout << endl << "Chunk size: " << chunk_size << " bytes" << endl;
+    cout << setw(28) << left << "filter" << setw(17) << right << "decode" << setw(12) << "ratio" << endl;
+
+    run("shuffle (scalar)", data, shuffled, [&](char *dest) {
+        unshuffle_scalar(dest, shuffled.data(), shuffled.size(), sizeof(float));
+    });
+    run("shuffle", data, shuffled, [&](char *dest) {
+        registry->decode({FILTER_SHUFFLE}, shuffled.data(), shuffled.size(), dest, chunk_size, args);
+    });
+
+    vector<char> with_checksum(data);
+    with_checksum.resize(data.size() + 4);
+    run("fletcher32", data, with_checksum, [&](char *dest) {
+        registry->decode({FILTER_FLETCHER32}, with_checksum.data(), with_checksum.size(), dest, chunk_size, args);
+    });
+
+    vector<char> deflated = encode_deflate(data);
+    run("deflate", data, deflated, [&](char *dest) {
+        registry->decode({FILTER_DEFLATE}, deflated.data(), deflated.size(), dest, chunk_size, args);
+    });
+
+    vector<char> shuffled_deflated = encode_deflate(shuffled);
+    run("deflate shuffle", data, shuffled_deflated, [&](char *dest) {
+        registry->decode({FILTER_DEFLATE, FILTER_SHUFFLE}, shuffled_deflated.data(), shuffled_deflated.size(), dest,
+                         chunk_size, args);
+    });
+
+#if HAVE_LIBLZ4
+    vector<char> lz4_shuffled = encode_lz4(shuffled);
+    run("lz4 shuffle", data, lz4_shuffled, [&](char *dest) {
+        registry->decode({FILTER_LZ4, FILTER_SHUFFLE}, lz4_shuffled.data(), lz4_shuffled.size(), dest, chunk_size,
+                         args);
+    });
+#endif
+
+#if HAVE_LIBZSTD
+    vector<char> zstd_shuffled = encode_zstd(shuffled);
+    run("zstd shuffle", data, zstd_shuffled, [&](char *dest) {
+        registry->decode({FILTER_ZSTD, FILTER_SHUFFLE}, zstd_shuffled.data(), zstd_shuffled.size(), dest,
+                         chunk_size, args);
+    });
+#endif
+
+#if HAVE_LIBBLOSC
+    vector<char> blosc_data = encode_blosc(data);
+    run("blosc", data, blosc_data, [&](char *dest) {
+        registry->decode({FILTER_BLOSC}, blosc_data.data(), blosc_data.size(), dest, chunk_size, args);
+    });
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    int option_char;
+    while ((option_char = getopt(argc, argv, "t:h")) != -1) {
+        switch (option_char) {
+            case 't':
+                min_seconds = atof(optarg);
+                break;
+            case 'h':
+            default:
+                cerr << "Usage: " << argv[0] << " [-t seconds] [chunk_size ...]" << endl;
+                return 1;
+        }
+    }
+
+    vector<unsigned long long> sizes;
+    for (int i = optind; i < argc; i++)
+        sizes.push_back(strtoull(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = {64 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+
+    try {
+        for (auto size: sizes)
+            bench(size);
+    }
+    catch (BESError &e) {
+        cerr << "Error: " << e.get_message() << endl;
+        return 1;
+    }
+    catch (std::exception &e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
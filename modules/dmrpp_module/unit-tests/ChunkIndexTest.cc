@@ -0,0 +1,294 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+#include <debug.h>
+
+#include "BESError.h"
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+
+#include "Chunk.h"
+#include "ChunkIndex.h"
+
+#include "test_config.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+static string bes_conf_file = "/bes.conf";
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("ChunkIndexTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+class ChunkIndexTest: public CppUnit::TestFixture {
+private:
+    typedef vector<pair<uint64_t, uint64_t>> ranges_t;
+
+    // The chunks of a rows x cols array with chunk_rows x chunk_cols chunks
+    vector<shared_ptr<Chunk>> make_grid(unsigned long long rows, unsigned long long cols,
+        unsigned long long chunk_rows, unsigned long long chunk_cols)
+    {
+        vector<shared_ptr<Chunk>> chunks;
+        for (unsigned long long r = 0; r < rows; r += chunk_rows)
+            for (unsigned long long c = 0; c < cols; c += chunk_cols)
+                chunks.push_back(make_shared<Chunk>("", "LE", 100, chunks.size() * 100,
+                    vector<unsigned long long>{ r, c }));
+        return chunks;
+    }
+
+    // The chunks that intersect 'ranges', found by looking at every one
+    vector<uint64_t> scan(const vector<shared_ptr<Chunk>> &chunks, const vector<unsigned long long> &chunk_shape,
+        const ranges_t &ranges)
+    {
+        vector<uint64_t> found;
+        for (uint64_t i = 0; i < chunks.size(); ++i) {
+            const vector<unsigned long long> &p = chunks[i]->get_position_in_array();
+            bool intersects = true;
+            for (size_t dim = 0; dim < p.size(); ++dim)
+                intersects = intersects && p[dim] <= ranges[dim].second
+                    && p[dim] + chunk_shape[dim] - 1 >= ranges[dim].first;
+            if (intersects) found.push_back(i);
+        }
+        return found;
+    }
+
+public:
+    // Called once before everything gets tested
+    ChunkIndexTest()
+    {
+    }
+
+    // Called at the end of the test
+    ~ChunkIndexTest()
+    {
+    }
+
+    // Called before each test
+    void setUp()
+    {
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append(bes_conf_file);
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp");
+        DBG(cerr << endl);
+    }
+
+    // Called after each test
+    void tearDown()
+    {
+    }
+
+    void grid_test()
+    {
+        // 100 x 100 array, 10 x 10 chunks
+        vector<shared_ptr<Chunk>> chunks = make_grid(100, 100, 10, 10);
+        ChunkIndex index(chunks, { 10, 10 }, { 100, 100 });
+        CPPUNIT_ASSERT(index.is_regular());
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 100, index.size());
+
+        vector<uint64_t> found;
+        index.find({ { 15, 15 }, { 25, 25 } }, found);
+        CPPUNIT_ASSERT(found == vector<uint64_t>{ 12 });
+
+        index.find({ { 5, 15 }, { 5, 25 } }, found);
+        CPPUNIT_ASSERT(found == (vector<uint64_t>{ 0, 1, 2, 10, 11, 12 }));
+
+        index.find({ { 0, 99 }, { 0, 99 } }, found);
+        CPPUNIT_ASSERT_EQUAL((size_t) 100, found.size());
+    }
+
+    // The last row and column of chunks extend past the array
+    void partial_grid_test()
+    {
+        vector<shared_ptr<Chunk>> chunks = make_grid(95, 33, 10, 10);
+        ChunkIndex index(chunks, { 10, 10 }, { 95, 33 });
+        CPPUNIT_ASSERT(index.is_regular());
+
+        ranges_t ranges = { { 90, 94 }, { 31, 32 } };
+        vector<uint64_t> found;
+        index.find(ranges, found);
+        CPPUNIT_ASSERT(found == scan(chunks, { 10, 10 }, ranges));
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, found.size());
+    }
+
+    // Chunks that were never written are missing from the grid
+    void sparse_grid_test()
+    {
+        vector<shared_ptr<Chunk>> chunks = make_grid(100, 100, 10, 10);
+        chunks.erase(chunks.begin() + 50, chunks.begin() + 60);
+        ChunkIndex index(chunks, { 10, 10 }, { 100, 100 });
+        CPPUNIT_ASSERT(index.is_regular());
+
+        ranges_t ranges = { { 45, 65 }, { 0, 99 } };
+        vector<uint64_t> found;
+        index.find(ranges, found);
+        CPPUNIT_ASSERT(found == scan(chunks, { 10, 10 }, ranges));
+        CPPUNIT_ASSERT_EQUAL((size_t) 20, found.size());
+    }
+
+    // Positions that are not multiples of the chunk shape use the R-tree
+    void irregular_test()
+    {
+        vector<shared_ptr<Chunk>> chunks;
+        srandom(1);
+        for (unsigned long long i = 0; i < 1000; ++i)
+            chunks.push_back(make_shared<Chunk>("", "LE", 100, i * 100,
+                vector<unsigned long long>{ (unsigned long long) random() % 1000, (unsigned long long) random() % 1000,
+                    i % 3 }));
+
+        vector<unsigned long long> chunk_shape = { 7, 13, 1 };
+        ChunkIndex index(chunks, chunk_shape, { 1010, 1010, 3 });
+        CPPUNIT_ASSERT(!index.is_regular());
+
+        vector<uint64_t> found;
+        for (int n = 0; n < 100; ++n) {
+            uint64_t r = random() % 1000, c = random() % 1000;
+            ranges_t ranges = { { r, r + random() % 100 }, { c, c + random() % 100 }, { 0, (uint64_t) random() % 3 } };
+            index.find(ranges, found);
+            CPPUNIT_ASSERT(found == scan(chunks, chunk_shape, ranges));
+        }
+    }
+
+    // The index of a chunk table read from a file is built once
+    void find_or_make_test()
+    {
+        vector<shared_ptr<Chunk>> chunks = make_grid(100, 100, 10, 10);
+        auto index = ChunkIndex::find_or_make("test.dmrpp@0", chunks, { 10, 10 }, { 100, 100 });
+        CPPUNIT_ASSERT(index->is_regular());
+        CPPUNIT_ASSERT(index->bytes() > 0);
+
+        // The next request's DmrppArray has new Chunks from the same table
+        vector<shared_ptr<Chunk>> again = make_grid(100, 100, 10, 10);
+        CPPUNIT_ASSERT(ChunkIndex::find_or_make("test.dmrpp@0", again, { 10, 10 }, { 100, 100 }) == index);
+
+        // Another table has an index of its own
+        auto other = ChunkIndex::find_or_make("test.dmrpp@4096", again, { 10, 10 }, { 100, 100 });
+        CPPUNIT_ASSERT(other != index);
+
+        // An index for a different number of chunks is not used
+        vector<shared_ptr<Chunk>> fewer = make_grid(50, 100, 10, 10);
+        auto replaced = ChunkIndex::find_or_make("test.dmrpp@0", fewer, { 10, 10 }, { 50, 100 });
+        CPPUNIT_ASSERT(replaced != index);
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 50, replaced->size());
+        CPPUNIT_ASSERT(ChunkIndex::find_or_make("test.dmrpp@0", fewer, { 10, 10 }, { 50, 100 }) == replaced);
+    }
+
+    // The least recently used indexes are dropped when they use more than cache_bytes
+    void find_or_make_eviction_test()
+    {
+        // Each index holds 128K chunks' positions, 2MB or more
+        vector<shared_ptr<Chunk>> chunks = make_grid(512, 256, 1, 1);
+        auto first = ChunkIndex::find_or_make("evict@0", chunks, { 1, 1 }, { 512, 256 });
+        unsigned int fit = ChunkIndex::cache_bytes / first->bytes();
+        DBG(cerr << prolog << "index bytes: " << first->bytes() << ", " << fit << " fit in the cache" << endl);
+        CPPUNIT_ASSERT(fit > 2);
+
+        auto second = ChunkIndex::find_or_make("evict@1", chunks, { 1, 1 }, { 512, 256 });
+        for (unsigned int i = 2; i < fit; ++i) {
+            // Keep the first index recently used
+            CPPUNIT_ASSERT(ChunkIndex::find_or_make("evict@0", chunks, { 1, 1 }, { 512, 256 }) == first);
+            ChunkIndex::find_or_make("evict@" + to_string(i), chunks, { 1, 1 }, { 512, 256 });
+        }
+        ChunkIndex::find_or_make("evict@" + to_string(fit), chunks, { 1, 1 }, { 512, 256 });
+
+        CPPUNIT_ASSERT(ChunkIndex::find_or_make("evict@0", chunks, { 1, 1 }, { 512, 256 }) == first);
+        CPPUNIT_ASSERT(ChunkIndex::find_or_make("evict@1", chunks, { 1, 1 }, { 512, 256 }) != second);
+    }
+
+    void bad_rank_test()
+    {
+        vector<shared_ptr<Chunk>> chunks = make_grid(100, 100, 10, 10);
+        ChunkIndex index(chunks, { 10 }, { 100 });
+        CPPUNIT_FAIL("ChunkIndex() should throw when the chunk positions do not match the rank");
+    }
+
+    CPPUNIT_TEST_SUITE( ChunkIndexTest );
+
+    CPPUNIT_TEST(grid_test);
+    CPPUNIT_TEST(partial_grid_test);
+    CPPUNIT_TEST(sparse_grid_test);
+    CPPUNIT_TEST(irregular_test);
+    CPPUNIT_TEST(find_or_make_test);
+    CPPUNIT_TEST(find_or_make_eviction_test);
+
+    CPPUNIT_TEST_EXCEPTION(bad_rank_test, BESError);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChunkIndexTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::ChunkIndexTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
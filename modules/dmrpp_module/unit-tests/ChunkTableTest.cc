@@ -0,0 +1,312 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+#include <debug.h>
+
+#include "BESError.h"
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+
+#include "Chunk.h"
+#include "ChunkTable.h"
+
+#include "test_config.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+static string bes_conf_file = "/bes.conf";
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("ChunkTableTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+class ChunkTableTest: public CppUnit::TestFixture {
+private:
+    // Write 'table' and read it back, as DmrppBinary does
+    shared_ptr<ChunkTable> round_trip(const ChunkTable &table)
+    {
+        ostringstream oss;
+        table.write(oss);
+        shared_ptr<string> bytes(new string(oss.str()));
+        CPPUNIT_ASSERT(bytes->size() % 8 == 0);
+
+        const char *pos = bytes->data();
+        const char *end = pos + bytes->size();
+        shared_ptr<ChunkTable> copy = ChunkTable::read(shared_ptr<const char>(bytes, bytes->data()), pos, end);
+        CPPUNIT_ASSERT(pos == end);
+
+        return copy;
+    }
+
+    void check_same(const ChunkTable &a, const ChunkTable &b)
+    {
+        CPPUNIT_ASSERT_EQUAL(a.size(), b.size());
+        CPPUNIT_ASSERT_EQUAL(a.rank(), b.rank());
+        CPPUNIT_ASSERT_EQUAL(a.get_byte_order(), b.get_byte_order());
+        for (uint64_t i = 0; i < a.size(); ++i) {
+            CPPUNIT_ASSERT_EQUAL(a.get_offset(i), b.get_offset(i));
+            CPPUNIT_ASSERT_EQUAL(a.get_size(i), b.get_size(i));
+            CPPUNIT_ASSERT_EQUAL(a.get_href(i), b.get_href(i));
+            for (uint32_t r = 0; r < a.rank(); ++r)
+                CPPUNIT_ASSERT_EQUAL(a.get_position(i)[r], b.get_position(i)[r]);
+        }
+    }
+
+public:
+    // Called once before everything gets tested
+    ChunkTableTest()
+    {
+    }
+
+    // Called at the end of the test
+    ~ChunkTableTest()
+    {
+    }
+
+    // Called before each test
+    void setUp()
+    {
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append(bes_conf_file);
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp");
+        DBG(cerr << endl);
+    }
+
+    // Called after each test
+    void tearDown()
+    {
+    }
+
+    void build_test()
+    {
+        ChunkTableBuilder builder("LE");
+        CPPUNIT_ASSERT(builder.empty());
+        builder.add_chunk("", 4016, 1024, "[0,0]");
+        builder.add_chunk("", 5040, 1000, "[0,32]");
+        builder.add_chunk("", 6040, 1010, "[32,0]");
+        CPPUNIT_ASSERT(!builder.empty());
+
+        shared_ptr<ChunkTable> table = builder.build();
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 3, table->size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 2, table->rank());
+        CPPUNIT_ASSERT_EQUAL(string("LE"), table->get_byte_order());
+
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 5040, table->get_offset(1));
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 1000, table->get_size(1));
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 32, table->get_position(1)[1]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 32, table->get_position(2)[0]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 0, table->get_position(2)[1]);
+        CPPUNIT_ASSERT_EQUAL(string(""), table->get_href(2));
+    }
+
+    void no_position_test()
+    {
+        ChunkTableBuilder builder("BE");
+        builder.add_chunk("", 100, 400, "");
+
+        shared_ptr<ChunkTable> table = builder.build();
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 1, table->size());
+        CPPUNIT_ASSERT_EQUAL((uint32_t) 0, table->rank());
+
+        check_same(*table, *round_trip(*table));
+    }
+
+    void hrefs_test()
+    {
+        ChunkTableBuilder builder("LE");
+        builder.add_chunk("", 0, 10, "[0]");
+        builder.add_chunk("http://a.org/one.h5", 10, 10, "[10]");
+        builder.add_chunk("", 20, 10, "[20]");
+        builder.add_chunk("http://a.org/two.h5", 30, 10, "[30]");
+
+        shared_ptr<ChunkTable> table = builder.build();
+        CPPUNIT_ASSERT_EQUAL(string(""), table->get_href(0));
+        CPPUNIT_ASSERT_EQUAL(string("http://a.org/one.h5"), table->get_href(1));
+        CPPUNIT_ASSERT_EQUAL(string(""), table->get_href(2));
+        CPPUNIT_ASSERT_EQUAL(string("http://a.org/two.h5"), table->get_href(3));
+
+        // Each distinct href is resolved once
+        int calls = 0;
+        table->resolve_urls([&calls](const string &href) {
+            ++calls;
+            return href.empty() ? string("file:///data/granule.h5") : href;
+        });
+        CPPUNIT_ASSERT_EQUAL(3, calls);
+        CPPUNIT_ASSERT_EQUAL(string("file:///data/granule.h5"), table->get_url(2));
+        CPPUNIT_ASSERT_EQUAL(string("http://a.org/two.h5"), table->get_url(3));
+
+        check_same(*table, *round_trip(*table));
+    }
+
+    void round_trip_test()
+    {
+        ChunkTableBuilder builder("LE");
+        for (unsigned long long i = 0; i < 1000; ++i)
+            builder.add_chunk("", i * 4096, 4000 + i % 7, vector<unsigned long long>{ i / 100 * 10, i % 100 * 20, 0 });
+
+        shared_ptr<ChunkTable> table = builder.build();
+        shared_ptr<ChunkTable> copy = round_trip(*table);
+        check_same(*table, *copy);
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 99 * 4096, copy->get_offset(99));
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 180, copy->get_position(109)[1]);
+    }
+
+    void make_chunks_test()
+    {
+        ChunkTableBuilder builder("BE");
+        builder.add_chunk("", 4016, 1024, "[0,0]");
+        builder.add_chunk("", 5040, 1000, "[0,32]");
+
+        vector<shared_ptr<Chunk>> chunks;
+        builder.build()->make_chunks(chunks);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, chunks.size());
+        CPPUNIT_ASSERT_EQUAL(4016ULL, chunks[0]->get_offset());
+        CPPUNIT_ASSERT_EQUAL(1000ULL, chunks[1]->get_size());
+        CPPUNIT_ASSERT_EQUAL(string("BE"), chunks[1]->get_byte_order());
+        CPPUNIT_ASSERT(chunks[1]->get_position_in_array() == (vector<unsigned long long>{ 0, 32 }));
+    }
+
+    void from_chunks_test()
+    {
+        vector<shared_ptr<Chunk>> chunks;
+        chunks.push_back(make_shared<Chunk>("file:///data/granule.h5", "LE", 1024, 4016, "[0,0]"));
+        chunks.push_back(make_shared<Chunk>("http://a.org/other.h5", "LE", 1000, 5040, "[0,32]"));
+
+        shared_ptr<ChunkTable> table = ChunkTable::from_chunks(chunks, "file:///data/granule.h5");
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 2, table->size());
+        CPPUNIT_ASSERT_EQUAL(string(""), table->get_href(0));
+        CPPUNIT_ASSERT_EQUAL(string("http://a.org/other.h5"), table->get_href(1));
+        CPPUNIT_ASSERT_EQUAL((uint64_t) 32, table->get_position(1)[1]);
+    }
+
+    void bad_position_test()
+    {
+        ChunkTableBuilder builder("LE");
+        builder.add_chunk("", 0, 10, "[1,2");
+        CPPUNIT_FAIL("add_chunk() should throw on a missing bracket");
+    }
+
+    void bad_position_test_2()
+    {
+        ChunkTableBuilder builder("LE");
+        builder.add_chunk("", 0, 10, "[1,x]");
+        CPPUNIT_FAIL("add_chunk() should throw on an illegal character");
+    }
+
+    void different_ranks_test()
+    {
+        ChunkTableBuilder builder("LE");
+        builder.add_chunk("", 0, 10, "[1,2]");
+        builder.add_chunk("", 10, 10, "[1,2,3]");
+        CPPUNIT_FAIL("add_chunk() should throw when the ranks differ");
+    }
+
+    void truncated_test()
+    {
+        ChunkTableBuilder builder("LE");
+        builder.add_chunk("", 0, 10, "[1,2]");
+        builder.add_chunk("", 10, 10, "[3,4]");
+
+        ostringstream oss;
+        builder.build()->write(oss);
+        shared_ptr<string> bytes(new string(oss.str().substr(0, oss.str().size() - 8)));
+
+        const char *pos = bytes->data();
+        ChunkTable::read(shared_ptr<const char>(bytes, bytes->data()), pos, pos + bytes->size());
+        CPPUNIT_FAIL("read() should throw on a truncated table");
+    }
+
+    CPPUNIT_TEST_SUITE( ChunkTableTest );
+
+    CPPUNIT_TEST(build_test);
+    CPPUNIT_TEST(no_position_test);
+    CPPUNIT_TEST(hrefs_test);
+    CPPUNIT_TEST(round_trip_test);
+    CPPUNIT_TEST(make_chunks_test);
+    CPPUNIT_TEST(from_chunks_test);
+
+    CPPUNIT_TEST_EXCEPTION(bad_position_test, BESError);
+    CPPUNIT_TEST_EXCEPTION(bad_position_test_2, BESError);
+    CPPUNIT_TEST_EXCEPTION(different_ranks_test, BESError);
+    CPPUNIT_TEST_EXCEPTION(truncated_test, BESError);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ChunkTableTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::ChunkTableTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -0,0 +1,419 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <curl/curl.h>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+
+#include "BESError.h"
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+
+#include "Chunk.h"
+#include "CurlMultiEngine.h"
+
+#include "test_config.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("CurlMultiEngineTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+/**
+ * A stand-in for S3: an HTTP/1.1 server on 127.0.0.1 that answers range GETs
+ * with a known byte pattern after a fixed delay (the 'latency' of the object
+ * store). It counts the requests it is working on at once so the tests can
+ * see how many transfers the engine really had in flight.
+ *
+ * Paths: /data returns 206 and the bytes; /missing returns 404; /flaky
+ * returns 503 to its first request and then behaves like /data.
+ */
+class RangeServer {
+private:
+    int d_listen_fd;
+    unsigned short d_port;
+    unsigned int d_latency_ms;
+    std::thread d_accept_thread;
+    std::mutex d_mtx;
+    std::vector<std::thread> d_connection_threads;
+    std::vector<int> d_connection_fds;
+    std::atomic<bool> d_stop;
+    std::atomic<bool> d_flaky_failed;
+
+    void accept_loop()
+    {
+        while (!d_stop) {
+            int fd = accept(d_listen_fd, nullptr, nullptr);
+            if (fd < 0) break;
+            connections++;
+            std::lock_guard<std::mutex> lock(d_mtx);
+            d_connection_fds.push_back(fd);
+            d_connection_threads.emplace_back(&RangeServer::serve, this, fd);
+        }
+    }
+
+    static bool send_all(int fd, const char *buf, size_t len)
+    {
+        while (len > 0) {
+            ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+            if (n <= 0) return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // Answer requests on one keep-alive connection until the client closes it.
+    void serve(int fd)
+    {
+        string pending;
+        char buf[4096];
+        while (!d_stop) {
+            size_t end;
+            while ((end = pending.find("\r\n\r\n")) == string::npos) {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if (n <= 0) return;
+                pending.append(buf, n);
+            }
+            string request = pending.substr(0, end);
+            pending.erase(0, end + 4);
+
+            unsigned long long first = 0, last = 0;
+            size_t pos = request.find("Range: bytes=");
+            if (pos != string::npos)
+                sscanf(request.c_str() + pos, "Range: bytes=%llu-%llu", &first, &last);
+            string path = request.substr(request.find(' ') + 1);
+            path = path.substr(0, path.find(' '));
+
+            unsigned long long n = ++active;
+            {
+                std::lock_guard<std::mutex> lock(d_mtx);
+                if (n > peak_active) peak_active = n;
+            }
+            requests++;
+
+            this_thread::sleep_for(chrono::milliseconds(d_latency_ms));
+
+            ostringstream oss;
+            string body;
+            if (path == "/missing") {
+                oss << "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+            }
+            else if (path == "/flaky" && !d_flaky_failed.exchange(true)) {
+                oss << "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+            }
+            else {
+                body.resize(last - first + 1);
+                for (unsigned long long i = first; i <= last; ++i)
+                    body[i - first] = pattern(i);
+                oss << "HTTP/1.1 206 Partial Content\r\n"
+                    << "Content-Type: application/octet-stream\r\n"
+                    << "Content-Range: bytes " << first << "-" << last << "/*\r\n"
+                    << "Content-Length: " << body.size() << "\r\n\r\n";
+            }
+            string header = oss.str();
+
+            active--;
+            if (!send_all(fd, header.data(), header.size()) || !send_all(fd, body.data(), body.size()))
+                return;
+        }
+    }
+
+public:
+    std::atomic<unsigned long long> active;
+    unsigned long long peak_active;
+    std::atomic<unsigned long long> requests;
+    std::atomic<unsigned long long> connections;
+
+    explicit RangeServer(unsigned int latency_ms) :
+            d_listen_fd(-1), d_port(0), d_latency_ms(latency_ms), d_stop(false), d_flaky_failed(false), active(0),
+            peak_active(0), requests(0), connections(0)
+    {
+        d_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(d_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        if (bind(d_listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(d_listen_fd, 512) != 0)
+            throw std::runtime_error("Could not start the test HTTP server.");
+
+        socklen_t len = sizeof(addr);
+        getsockname(d_listen_fd, (struct sockaddr *) &addr, &len);
+        d_port = ntohs(addr.sin_port);
+
+        d_accept_thread = std::thread(&RangeServer::accept_loop, this);
+    }
+
+    ~RangeServer()
+    {
+        d_stop = true;
+        shutdown(d_listen_fd, SHUT_RDWR);
+        close(d_listen_fd);
+        d_accept_thread.join();
+
+        // No new connections now; the serve() threads may still need d_mtx.
+        for (int fd: d_connection_fds) shutdown(fd, SHUT_RDWR);
+        for (auto &t: d_connection_threads) t.join();
+        for (int fd: d_connection_fds) close(fd);
+    }
+
+    string url(const string &path) const
+    {
+        ostringstream oss;
+        oss << "http://127.0.0.1:" << d_port << path;
+        return oss.str();
+    }
+
+    /// The value of the byte at \arg offset in every 'object' this server has.
+    static char pattern(unsigned long long offset)
+    {
+        return static_cast<char>((offset * 31 + 7) & 0xff);
+    }
+};
+
+class CurlMultiEngineTest: public CppUnit::TestFixture {
+private:
+
+    static bool check_pattern(const Chunk &chunk, unsigned long long offset)
+    {
+        const char *data = const_cast<Chunk &>(chunk).get_rbuf();
+        for (unsigned long long i = 0; i < chunk.get_bytes_read(); ++i) {
+            if (data[i] != RangeServer::pattern(offset + i)) return false;
+        }
+        return true;
+    }
+
+public:
+    // Called once before everything gets tested
+    CurlMultiEngineTest()
+    {
+    }
+
+    // Called at the end of the test
+    ~CurlMultiEngineTest()
+    {
+    }
+
+    // Called before each test
+    void setUp()
+    {
+        TheBESKeys::ConfigFile = string(TEST_BUILD_DIR).append("/bes.conf");
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp:multi,curl");
+        curl_global_init(CURL_GLOBAL_ALL);
+    }
+
+    // Called after each test
+    void tearDown()
+    {
+        curl_global_cleanup();
+    }
+
+    void read_one_chunk_test()
+    {
+        RangeServer server(0);
+        CurlMultiEngine engine(8, 4);
+
+        Chunk chunk(server.url("/data"), "", 1000, 12345);
+        chunk.set_rbuf_to_size();
+        engine.read_data(&chunk);
+
+        CPPUNIT_ASSERT(chunk.get_is_read());
+        CPPUNIT_ASSERT(chunk.get_bytes_read() == 1000);
+        CPPUNIT_ASSERT(check_pattern(chunk, 12345));
+        CPPUNIT_ASSERT(engine.transfers_completed() == 1);
+    }
+
+    // With a 'slow' object store, the number of transfers in flight at once
+    // and so the throughput is set by the engine's limit, not by a number of
+    // threads.
+    void many_in_flight_test()
+    {
+        const unsigned int num_chunks = 400;
+        const unsigned long long chunk_size = 64 * 1024;
+        const unsigned int max_in_flight = 64;
+
+        RangeServer server(25);
+        CurlMultiEngine engine(max_in_flight, max_in_flight);
+
+        vector<unique_ptr<Chunk>> chunks;
+        for (unsigned int i = 0; i < num_chunks; ++i) {
+            chunks.emplace_back(new Chunk(server.url("/data"), "", chunk_size, i * chunk_size));
+            chunks.back()->set_rbuf_to_size();
+        }
+
+        std::mutex mtx;
+        std::condition_variable cv;
+        unsigned int done = 0;
+        unsigned int errors = 0;
+
+        auto start = chrono::steady_clock::now();
+        for (auto &chunk: chunks) {
+            engine.submit(chunk.get(), [&](std::exception_ptr error) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (error) errors++;
+                if (++done == num_chunks) cv.notify_one();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [&] { return done == num_chunks; });
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        double mbytes = num_chunks * chunk_size / (1024.0 * 1024.0);
+        DBG(cerr << prolog << num_chunks << " transfers, " << mbytes << " MB in " << seconds << " s: "
+                 << mbytes / seconds << " MB/s, " << num_chunks / seconds << " requests/s" << endl);
+        DBG(cerr << prolog << "engine peak in flight: " << engine.peak_in_flight() << " server peak concurrent requests: "
+                 << server.peak_active << " server connections: " << server.connections << endl);
+
+        CPPUNIT_ASSERT(errors == 0);
+        for (unsigned int i = 0; i < num_chunks; ++i) {
+            CPPUNIT_ASSERT(chunks[i]->get_bytes_read() == chunk_size);
+            CPPUNIT_ASSERT(check_pattern(*chunks[i], i * chunk_size));
+        }
+        CPPUNIT_ASSERT(engine.bytes_transferred() == num_chunks * chunk_size);
+        CPPUNIT_ASSERT(engine.peak_in_flight() <= max_in_flight);
+        // Far more requests at once than the default of eight transfer threads
+        CPPUNIT_ASSERT(engine.peak_in_flight() > 8);
+        CPPUNIT_ASSERT(server.peak_active > 8);
+        // Connections are reused, not opened per request
+        CPPUNIT_ASSERT(server.connections <= max_in_flight + 1);
+    }
+
+    void not_found_test()
+    {
+        RangeServer server(0);
+        CurlMultiEngine engine(8, 4);
+
+        Chunk chunk(server.url("/missing"), "", 100, 0);
+        chunk.set_rbuf_to_size();
+        CPPUNIT_ASSERT_THROW(engine.read_data(&chunk), BESError);
+        CPPUNIT_ASSERT(!chunk.get_is_read());
+
+        // The engine still works after a failed transfer.
+        Chunk good(server.url("/data"), "", 100, 0);
+        good.set_rbuf_to_size();
+        engine.read_data(&good);
+        CPPUNIT_ASSERT(check_pattern(good, 0));
+    }
+
+    void retry_test()
+    {
+        RangeServer server(0);
+        CurlMultiEngine engine(8, 4);
+
+        Chunk chunk(server.url("/flaky"), "", 100, 50);
+        chunk.set_rbuf_to_size();
+        engine.read_data(&chunk);
+
+        CPPUNIT_ASSERT(engine.retry_count() == 1);
+        CPPUNIT_ASSERT(chunk.get_bytes_read() == 100);
+        CPPUNIT_ASSERT(check_pattern(chunk, 50));
+    }
+
+    CPPUNIT_TEST_SUITE( CurlMultiEngineTest );
+
+        CPPUNIT_TEST(read_one_chunk_test);
+        CPPUNIT_TEST(many_in_flight_test);
+        CPPUNIT_TEST(not_found_test);
+        CPPUNIT_TEST(retry_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CurlMultiEngineTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::CurlMultiEngineTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
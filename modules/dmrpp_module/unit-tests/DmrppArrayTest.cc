@@ -195,9 +195,131 @@ public:
         DBG(cerr << prolog << "END" << endl);
     }
 
+    // A [5][3][4] array of bytes, split into chunks of chunk_shape; chunk_shape[2] must be 4
+    void make_chunked_array(DmrppArray &array, const vector<size_t> &chunk_shape)
+    {
+        array.append_dim(5, "x");
+        array.append_dim(3, "y");
+        array.append_dim(4, "z");
+        array.set_chunk_dimension_sizes(chunk_shape);
+
+        unsigned long long chunk_bytes = chunk_shape[0] * chunk_shape[1] * chunk_shape[2];
+        unsigned long long offset = 0;
+        for (unsigned long long x = 0; x < 5; x += chunk_shape[0]) {
+            for (unsigned long long y = 0; y < 3; y += chunk_shape[1]) {
+                vector<unsigned long long> position_in_array = {x, y, 0};
+                array.add_chunk("file:///not/read", "LE", chunk_bytes, offset, position_in_array);
+                offset += chunk_bytes;
+            }
+        }
+        array.reserve_value_capacity(array.get_size());
+    }
+
+    void chunk_destinations_test() {
+        DmrppArray array(string("foo"), new libdap::Byte("foo"));
+        make_chunked_array(array, {2, 3, 4});
+
+        CPPUNIT_ASSERT(array.set_chunk_destinations(array.get_shape(true), array.get_chunk_dimension_sizes()));
+        auto chunks = array.get_immutable_chunks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 3, chunks.size());
+        CPPUNIT_ASSERT(chunks[0]->get_destination() == array.get_buf());
+        CPPUNIT_ASSERT(chunks[1]->get_destination() == array.get_buf() + 2 * 3 * 4);
+        // This one extends past the end of the array
+        CPPUNIT_ASSERT(chunks[2]->get_destination() == nullptr);
+
+        array.clear_chunk_destinations();
+        CPPUNIT_ASSERT(chunks[0]->get_destination() == nullptr);
+    }
+
+    void chunk_destinations_row_test() {
+        // Each chunk is one whole [z] row
+        DmrppArray array(string("foo"), new libdap::Byte("foo"));
+        make_chunked_array(array, {1, 1, 4});
+
+        CPPUNIT_ASSERT(array.set_chunk_destinations(array.get_shape(true), array.get_chunk_dimension_sizes()));
+        auto chunks = array.get_immutable_chunks();
+        CPPUNIT_ASSERT_EQUAL((size_t) 15, chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i)
+            CPPUNIT_ASSERT(chunks[i]->get_destination() == array.get_buf() + i * 4);
+    }
+
+    void chunk_destinations_not_contiguous_test() {
+        // Chunks that do not span the whole [y] dimension are not contiguous in the array
+        DmrppArray array(string("foo"), new libdap::Byte("foo"));
+        make_chunked_array(array, {2, 2, 4});
+
+        CPPUNIT_ASSERT(!array.set_chunk_destinations(array.get_shape(true), array.get_chunk_dimension_sizes()));
+        for (const auto &chunk: array.get_immutable_chunks())
+            CPPUNIT_ASSERT(chunk->get_destination() == nullptr);
+
+        // Nor are any when direct placement is turned off
+        DmrppArray array2(string("foo"), new libdap::Byte("foo"));
+        make_chunked_array(array2, {2, 3, 4});
+        DmrppRequestHandler::d_direct_chunk_placement = false;
+        CPPUNIT_ASSERT(!array2.set_chunk_destinations(array2.get_shape(true), array2.get_chunk_dimension_sizes()));
+        DmrppRequestHandler::d_direct_chunk_placement = true;
+    }
+
+    // Read a [100][11] array of bytes from big_ole_chunky_test.txt in ten
+    // [10][11] chunks. The chunks are adjacent in the file, so they are read
+    // as one SuperChunk, and with direct placement off they are read into the
+    // SuperChunk's own buffer. Run this with --enable-asan to check that the
+    // buffer outlives the tasks that process the chunks.
+    void read_super_chunk(bool use_compute_threads, bool use_curl_multi) {
+        string data_url = string("file://").append(TEST_DATA_DIR).append("/").append("big_ole_chunky_test.txt");
+
+        DmrppArray array(string("foo"), new libdap::Byte("foo"));
+        array.append_dim(100, "x");
+        array.append_dim(11, "y");
+        array.set_shuffle(false);
+        array.set_deflate(false);
+        array.set_chunk_dimension_sizes({10, 11});
+        for (unsigned long long x = 0; x < 100; x += 10) {
+            vector<unsigned long long> position_in_array = {x, 0};
+            array.add_chunk(data_url, "LE", 110, x * 11, position_in_array);
+        }
+
+        bool direct_chunk_placement = DmrppRequestHandler::d_direct_chunk_placement;
+        bool compute_threads = DmrppRequestHandler::d_use_compute_threads;
+        bool curl_multi = DmrppRequestHandler::d_use_curl_multi;
+        DmrppRequestHandler::d_direct_chunk_placement = false;
+        DmrppRequestHandler::d_use_compute_threads = use_compute_threads;
+        DmrppRequestHandler::d_use_curl_multi = use_curl_multi;
+        try {
+            array.read();
+        }
+        catch (BESError &be) {
+            DmrppRequestHandler::d_direct_chunk_placement = direct_chunk_placement;
+            DmrppRequestHandler::d_use_compute_threads = compute_threads;
+            DmrppRequestHandler::d_use_curl_multi = curl_multi;
+            CPPUNIT_FAIL("Caught BESError. Message: " + be.get_verbose_message());
+        }
+        DmrppRequestHandler::d_direct_chunk_placement = direct_chunk_placement;
+        DmrppRequestHandler::d_use_compute_threads = compute_threads;
+        DmrppRequestHandler::d_use_curl_multi = curl_multi;
+
+        const string expected = "ThisIsATest";
+        const char *result = array.get_buf();
+        for (unsigned int i = 0; i < 100 * 11; ++i)
+            CPPUNIT_ASSERT_EQUAL(expected[i % 11], result[i]);
+    }
+
+    void read_super_chunk_compute_pool_test() {
+        read_super_chunk(true, false);
+    }
+
+    void read_super_chunk_curl_multi_test() {
+        read_super_chunk(true, true);
+    }
+
     CPPUNIT_TEST_SUITE( DmrppArrayTest );
         CPPUNIT_TEST(read_contiguous_sc_test);
         CPPUNIT_TEST(read_contiguous_test);
+        CPPUNIT_TEST(chunk_destinations_test);
+        CPPUNIT_TEST(chunk_destinations_row_test);
+        CPPUNIT_TEST(chunk_destinations_not_contiguous_test);
+        CPPUNIT_TEST(read_super_chunk_compute_pool_test);
+        CPPUNIT_TEST(read_super_chunk_curl_multi_test);
 
     CPPUNIT_TEST_SUITE_END();
 };
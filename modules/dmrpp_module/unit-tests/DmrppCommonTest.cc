@@ -37,6 +37,7 @@
 #include <BESDebug.h>
 
 #include "DmrppCommon.h"
+#include "FilterRegistry.h"
 
 #include "read_test_baseline.h"
 #include "test_config.h"
@@ -226,6 +227,27 @@ public:
         CPPUNIT_ASSERT(baseline == string (writer.get_doc()));
     }
 
+    void test_ingest_compression_type_6()
+    {
+        d_dc.ingest_compression_type("deflate shuffle fletcher32");
+        CPPUNIT_ASSERT(d_dc.d_deflate == true);
+        CPPUNIT_ASSERT(d_dc.d_shuffle == true);
+
+        vector<unsigned int> filters = d_dc.get_filters();
+        CPPUNIT_ASSERT(filters.size() == 3);
+        CPPUNIT_ASSERT(filters.at(0) == FILTER_DEFLATE);
+        CPPUNIT_ASSERT(filters.at(1) == FILTER_SHUFFLE);
+        CPPUNIT_ASSERT(filters.at(2) == FILTER_FLETCHER32);
+    }
+
+    void test_ingest_compression_type_7()
+    {
+        // Unknown names are kept; the metadata are fine but the data cannot be read
+        d_dc.ingest_compression_type("shuffle,foobar");
+        CPPUNIT_ASSERT(d_dc.d_shuffle == true);
+        CPPUNIT_ASSERT_THROW(d_dc.get_filters(), BESError);
+    }
+
     void test_print_chunks_element_3()
     {
         d_dc.d_deflate = true;
@@ -292,6 +314,8 @@ public:
     CPPUNIT_TEST(test_ingest_compression_type_3);
     CPPUNIT_TEST(test_ingest_compression_type_4);
     CPPUNIT_TEST(test_ingest_compression_type_5);
+    CPPUNIT_TEST(test_ingest_compression_type_6);
+    CPPUNIT_TEST(test_ingest_compression_type_7);
 
     CPPUNIT_TEST(test_add_chunk_1);
     CPPUNIT_TEST(test_add_chunk_2);
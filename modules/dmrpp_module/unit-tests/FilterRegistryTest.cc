@@ -0,0 +1,314 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+#include <zlib.h>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+
+#include "BESError.h"
+#include "BESDebug.h"
+
+#include "FilterRegistry.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("FilterRegistryTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+// What the HDF5 shuffle filter does
+static vector<char> shuffle(const vector<char> &data, unsigned long long width)
+{
+    vector<char> out(data.size());
+    unsigned long long elems = data.size() / width;
+    for (unsigned long long i = 0; i < elems; i++)
+        for (unsigned long long b = 0; b < width; b++)
+            out[b * elems + i] = data[i * width + b];
+    memcpy(out.data() + elems * width, data.data() + elems * width, data.size() % width);
+    return out;
+}
+
+static vector<char> compress(const vector<char> &data)
+{
+    uLongf len = compressBound(data.size());
+    vector<char> out(len);
+    compress2(reinterpret_cast<Bytef *>(out.data()), &len, reinterpret_cast<const Bytef *>(data.data()),
+              data.size(), 6);
+    out.resize(len);
+    return out;
+}
+
+static vector<char> pattern(unsigned long long bytes)
+{
+    vector<char> data(bytes);
+    for (unsigned long long i = 0; i < bytes; i++)
+        data[i] = static_cast<char>((i * 31 + i / 7) & 0xff);
+    return data;
+}
+
+/**
+ * Pack little-endian int32 values the way the HDF5 scale-offset filter does
+ * (H5Z__scaleoffset_compress): a 21 byte header with minbits and minval, then
+ * the values less minval, minbits each, most significant bit first.
+ */
+static vector<char> scaleoffset_encode(const vector<int32_t> &values, unsigned int minbits)
+{
+    int32_t minval = values[0];
+    for (auto v: values) minval = std::min(minval, v);
+
+    vector<char> out(21, 0);
+    for (int i = 0; i < 4; i++) out[i] = static_cast<char>((minbits >> (8 * i)) & 0xff);
+    out[4] = sizeof(unsigned long long);
+    auto uminval = static_cast<unsigned long long>(static_cast<long long>(minval));
+    for (int i = 0; i < 8; i++) out[5 + i] = static_cast<char>((uminval >> (8 * i)) & 0xff);
+
+    unsigned char byte = 0;
+    int bits_in_byte = 0;
+    for (auto v: values) {
+        uint32_t d = static_cast<uint32_t>(v) - static_cast<uint32_t>(minval);
+        for (int b = minbits - 1; b >= 0; b--) {
+            byte = static_cast<unsigned char>((byte << 1) | ((d >> b) & 1));
+            if (++bits_in_byte == 8) {
+                out.push_back(static_cast<char>(byte));
+                byte = 0;
+                bits_in_byte = 0;
+            }
+        }
+    }
+    if (bits_in_byte)
+        out.push_back(static_cast<char>(byte << (8 - bits_in_byte)));
+
+    return out;
+}
+
+class FilterRegistryTest: public CppUnit::TestFixture {
+public:
+    FilterRegistryTest() = default;
+    ~FilterRegistryTest() = default;
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp:filters");
+    }
+
+    void tearDown()
+    {
+    }
+
+    void find_test()
+    {
+        FilterRegistry *registry = FilterRegistry::TheRegistry();
+        CPPUNIT_ASSERT(registry->find(FILTER_DEFLATE));
+        CPPUNIT_ASSERT(registry->find(FILTER_DEFLATE)->name == "deflate");
+        CPPUNIT_ASSERT(registry->find("shuffle"));
+        CPPUNIT_ASSERT(registry->find("shuffle")->id == FILTER_SHUFFLE);
+        CPPUNIT_ASSERT(registry->find("zstd"));
+        CPPUNIT_ASSERT(registry->find("zstd")->id == FILTER_ZSTD);
+        CPPUNIT_ASSERT(!registry->find("foobar"));
+        CPPUNIT_ASSERT(!registry->find(4)); // szip
+    }
+
+    // The SSE2 code handles 16 elements at a time; check the sizes around that
+    void unshuffle_test()
+    {
+        for (unsigned long long width: {1ULL, 2ULL, 3ULL, 4ULL, 8ULL, 16ULL}) {
+            for (unsigned long long bytes: {1ULL, 15ULL, 16ULL, 17ULL, 255ULL, 256ULL, 1021ULL, 65536ULL}) {
+                vector<char> data = pattern(bytes);
+                vector<char> shuffled = shuffle(data, width);
+
+                vector<char> result(bytes);
+                unshuffle(result.data(), shuffled.data(), bytes, width);
+                DBG(cerr << prolog << "width: " << width << ", bytes: " << bytes << endl);
+                CPPUNIT_ASSERT(result == data);
+
+                vector<char> scalar_result(bytes);
+                unshuffle_scalar(scalar_result.data(), shuffled.data(), bytes, width);
+                CPPUNIT_ASSERT(scalar_result == data);
+            }
+        }
+    }
+
+    void deflate_shuffle_test()
+    {
+        vector<char> data = pattern(100000);
+        vector<char> encoded = compress(shuffle(data, 4));
+
+        vector<char> result(data.size());
+        // The order of the filters in the list does not matter
+        unsigned long long n = FilterRegistry::TheRegistry()->decode({FILTER_SHUFFLE, FILTER_DEFLATE},
+                encoded.data(), encoded.size(), result.data(), result.size(), filter_args(4));
+        CPPUNIT_ASSERT_EQUAL(data.size(), (size_t) n);
+        CPPUNIT_ASSERT(result == data);
+    }
+
+    void fletcher32_test()
+    {
+        vector<char> data = pattern(4096);
+        vector<char> encoded = compress(data);
+        encoded.insert(encoded.end(), {'c', 'h', 'k', 's'});
+
+        vector<char> result(data.size());
+        unsigned long long n = FilterRegistry::TheRegistry()->decode({FILTER_DEFLATE, FILTER_FLETCHER32},
+                encoded.data(), encoded.size(), result.data(), result.size(), filter_args(1));
+        CPPUNIT_ASSERT_EQUAL(data.size(), (size_t) n);
+        CPPUNIT_ASSERT(result == data);
+
+        // On its own, the checksum is dropped and the data are copied
+        vector<char> plain(data);
+        plain.insert(plain.end(), {'c', 'h', 'k', 's'});
+        n = FilterRegistry::TheRegistry()->decode({FILTER_FLETCHER32}, plain.data(), plain.size(), result.data(),
+                                                  result.size(), filter_args(1));
+        CPPUNIT_ASSERT_EQUAL(data.size(), (size_t) n);
+        CPPUNIT_ASSERT(result == data);
+    }
+
+    void scaleoffset_test()
+    {
+        vector<int32_t> values;
+        for (int i = 0; i < 1001; i++)
+            values.push_back(-500 + (i * 37) % 1000);
+
+        // 1000 different values need 10 bits
+        vector<char> encoded = scaleoffset_encode(values, 10);
+
+        vector<int32_t> result(values.size());
+        unsigned long long n = FilterRegistry::TheRegistry()->decode({FILTER_SCALEOFFSET}, encoded.data(),
+                encoded.size(), reinterpret_cast<char *>(result.data()), result.size() * 4, filter_args(4, true));
+        CPPUNIT_ASSERT_EQUAL(values.size() * 4, (size_t) n);
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i] != result[i])
+                DBG(cerr << prolog << i << ": " << values[i] << " != " << result[i] << endl);
+            CPPUNIT_ASSERT_EQUAL(values[i], result[i]);
+        }
+
+        // Floating point values are not supported
+        CPPUNIT_ASSERT_THROW(FilterRegistry::TheRegistry()->decode({FILTER_SCALEOFFSET}, encoded.data(),
+                encoded.size(), reinterpret_cast<char *>(result.data()), result.size() * 4, filter_args(4, false)),
+                BESError);
+    }
+
+    void scaleoffset_constant_test()
+    {
+        // minbits is zero when all the values are the same
+        vector<int32_t> values(100, 42);
+        vector<char> encoded = scaleoffset_encode(values, 0);
+
+        vector<int32_t> result(values.size());
+        FilterRegistry::TheRegistry()->decode({FILTER_SCALEOFFSET}, encoded.data(), encoded.size(),
+                reinterpret_cast<char *>(result.data()), result.size() * 4, filter_args(4, true));
+        CPPUNIT_ASSERT(result == values);
+    }
+
+    void errors_test()
+    {
+        vector<char> data = pattern(1024);
+        vector<char> result(512);
+
+        // Unknown filter
+        CPPUNIT_ASSERT_THROW(FilterRegistry::TheRegistry()->decode({12345}, data.data(), data.size(), result.data(),
+                                                                   result.size(), filter_args(1)), BESError);
+
+        // Not enough room
+        vector<char> encoded = compress(data);
+        CPPUNIT_ASSERT_THROW(FilterRegistry::TheRegistry()->decode({FILTER_DEFLATE}, encoded.data(), encoded.size(),
+                                                                   result.data(), result.size(), filter_args(1)),
+                             BESError);
+
+        // Not deflated
+        result.resize(data.size());
+        CPPUNIT_ASSERT_THROW(FilterRegistry::TheRegistry()->decode({FILTER_DEFLATE}, data.data(), data.size(),
+                                                                   result.data(), result.size(), filter_args(1)),
+                             BESError);
+    }
+
+    CPPUNIT_TEST_SUITE( FilterRegistryTest );
+
+        CPPUNIT_TEST(find_test);
+        CPPUNIT_TEST(unshuffle_test);
+        CPPUNIT_TEST(deflate_shuffle_test);
+        CPPUNIT_TEST(fletcher32_test);
+        CPPUNIT_TEST(scaleoffset_test);
+        CPPUNIT_TEST(scaleoffset_constant_test);
+        CPPUNIT_TEST(errors_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FilterRegistryTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::FilterRegistryTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
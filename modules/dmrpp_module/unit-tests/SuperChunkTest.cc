@@ -319,11 +319,86 @@ public:
         DBG( cerr << prolog << "END" << endl);
     }
 
+    /**
+     * With a gap limit of two bytes the Chunks for "This", "is" and "a" are read
+     * by one SuperChunk; the separating bytes are read but no Chunk sees them.
+     * A size limit stops the SuperChunk from growing past it.
+     */
+    void sc_gap_test() {
+        DBG(cerr << prolog << "BEGIN" << endl);
+
+        // this_is_a_test.txt is 1106 bytes and contains human readable text chunk content.
+        string data_url = string("file://").append(TEST_DATA_DIR).append("/").append("this_is_a_test.txt");
+        DBG(cerr << prolog << "data_url: " << data_url << endl);
+
+        string chunk_position_in_array = "[0]";
+        try  {
+            vector<shared_ptr<Chunk>> chunks;
+            chunks.emplace_back(new Chunk(data_url, "", 100, 0, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 100, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 200, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 300, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 402, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 502, chunk_position_in_array));
+            chunks.emplace_back(new Chunk(data_url, "", 100, 604, chunk_position_in_array));
+            // Starts three bytes after the end of the "a" Chunk
+            shared_ptr<Chunk> t0(new Chunk(data_url, "", 100, 707, chunk_position_in_array));
+            // Overlaps the end of the "a" Chunk
+            shared_ptr<Chunk> overlap(new Chunk(data_url, "", 100, 700, chunk_position_in_array));
+
+            SuperChunk this_is_a(prolog+"this_is_a");
+            this_is_a.set_max_gap(2);
+            for (const auto &chunk: chunks) {
+                CPPUNIT_ASSERT(this_is_a.add_chunk(chunk));
+            }
+            CPPUNIT_ASSERT_MESSAGE("A three byte gap should be rejected", !this_is_a.add_chunk(t0));
+            CPPUNIT_ASSERT_MESSAGE("An overlapping Chunk should be rejected", !this_is_a.add_chunk(overlap));
+            CPPUNIT_ASSERT_EQUAL((unsigned long long) 0, this_is_a.get_offset());
+            CPPUNIT_ASSERT_EQUAL((unsigned long long) 704, this_is_a.get_size());
+
+            this_is_a.retrieve_data();
+            char target[] = "Thisisa";
+            size_t letter_index=0;
+            for(const auto& chunk: this_is_a.get_chunks()) {
+                CPPUNIT_ASSERT(chunk->get_is_read());
+                CPPUNIT_ASSERT(chunk->get_bytes_read() == 100);
+                char *rbuf = chunk->get_rbuf();
+                for (size_t i = 0; i < 100; i++) {
+                    CPPUNIT_ASSERT(rbuf[i] == target[letter_index]);
+                }
+                letter_index++;
+            }
+
+            SuperChunk capped(prolog+"capped");
+            capped.set_max_gap(2);
+            capped.set_max_size(500);
+            for (size_t i = 0; i < 4; i++) {
+                CPPUNIT_ASSERT(capped.add_chunk(chunks[i]));
+            }
+            CPPUNIT_ASSERT_MESSAGE("The size limit should be enforced", !capped.add_chunk(chunks[4]));
+            CPPUNIT_ASSERT_EQUAL((unsigned long long) 400, capped.get_size());
+        }
+        catch( BESError be){
+            stringstream msg;
+            msg << prolog << "CAUGHT BESError: " << be.get_verbose_message() << endl;
+            cerr << msg.str();
+            CPPUNIT_FAIL(msg.str());
+        }
+        catch( std::exception se ){
+            stringstream msg;
+            msg << "CAUGHT std::exception: " << se.what() << endl;
+            cerr << msg.str();
+            CPPUNIT_FAIL(msg.str());
+        }
+        DBG( cerr << prolog << "END" << endl);
+    }
+
     CPPUNIT_TEST_SUITE( SuperChunkTest );
 
         CPPUNIT_TEST(sc_one_chunk_test);
         CPPUNIT_TEST(sc_chunks_test_01);
         CPPUNIT_TEST(sc_chunks_test_02);
+        CPPUNIT_TEST(sc_gap_test);
 
     CPPUNIT_TEST_SUITE_END();
 };
@@ -0,0 +1,166 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+
+#include "BESDebug.h"
+
+#include "TransferStats.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("TransferStatsTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+class TransferStatsTest: public CppUnit::TestFixture {
+public:
+    TransferStatsTest() = default;
+    ~TransferStatsTest() = default;
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp:stats");
+    }
+
+    void tearDown()
+    {
+    }
+
+    void host_test()
+    {
+        CPPUNIT_ASSERT_EQUAL(string("https://bucket.s3.amazonaws.com"),
+                             TransferStats::host("https://bucket.s3.amazonaws.com/granule/one.h5"));
+        CPPUNIT_ASSERT_EQUAL(string("http://localhost:8080"), TransferStats::host("http://localhost:8080/data"));
+        CPPUNIT_ASSERT_EQUAL(string("file://"), TransferStats::host("file:///tmp/data.h5"));
+        CPPUNIT_ASSERT_EQUAL(string("https://example.com"), TransferStats::host("https://example.com"));
+    }
+
+    void no_samples_test()
+    {
+        TransferStats stats;
+        CPPUNIT_ASSERT_EQUAL(0ULL, stats.suggested_gap("https://example.com/a", 1024 * 1024));
+
+        // Latency alone is not enough to make a suggestion
+        stats.add_sample("https://example.com/a", 0.05, 100, 0.0001);
+        CPPUNIT_ASSERT_EQUAL(0ULL, stats.suggested_gap("https://example.com/a", 1024 * 1024));
+    }
+
+    void suggested_gap_test()
+    {
+        TransferStats stats;
+        // 20 ms to the first byte, then 1 MB in 100 ms: 10 MB/s, so ~200 KB
+        stats.add_sample("https://example.com/a", 0.02, 1000000, 0.1);
+        unsigned long long gap = stats.suggested_gap("https://example.com/b", 1024 * 1024);
+        DBG(cerr << prolog << "gap: " << gap << endl);
+        CPPUNIT_ASSERT(gap > 199000 && gap < 201000);
+
+        // The limit caps the suggestion
+        CPPUNIT_ASSERT_EQUAL(4096ULL, stats.suggested_gap("https://example.com/b", 4096));
+
+        // Other hosts are not affected
+        CPPUNIT_ASSERT_EQUAL(0ULL, stats.suggested_gap("https://other.com/a", 1024 * 1024));
+    }
+
+    void moving_average_test()
+    {
+        TransferStats stats;
+        stats.add_sample("https://example.com/a", 0.02, 1000000, 0.1);
+        // One slow request moves the estimate, but only part way
+        stats.add_sample("https://example.com/a", 0.52, 1000000, 0.1);
+        unsigned long long gap = stats.suggested_gap("https://example.com/a", 100 * 1024 * 1024);
+        DBG(cerr << prolog << "gap: " << gap << endl);
+        CPPUNIT_ASSERT(gap > 1190000 && gap < 1210000);
+
+        // Small transfers do not change the bandwidth estimate
+        stats.add_sample("https://example.com/a", 0.12, 100, 0.00001);
+        gap = stats.suggested_gap("https://example.com/a", 100 * 1024 * 1024);
+        DBG(cerr << prolog << "gap: " << gap << endl);
+        CPPUNIT_ASSERT(gap > 1190000 && gap < 1210000);
+    }
+
+    CPPUNIT_TEST_SUITE( TransferStatsTest );
+
+        CPPUNIT_TEST(host_test);
+        CPPUNIT_TEST(no_samples_test);
+        CPPUNIT_TEST(suggested_gap_test);
+        CPPUNIT_TEST(moving_average_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TransferStatsTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::TransferStatsTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
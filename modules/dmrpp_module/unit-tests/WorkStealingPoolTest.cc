@@ -0,0 +1,226 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of the BES
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: Nathan Potter <ndp@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <GetOpt.h>
+
+#include "BESDebug.h"
+#include "BESInternalError.h"
+
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) x; } while(false)
+#define prolog std::string("WorkStealingPoolTest::").append(__func__).append("() - ")
+
+namespace dmrpp {
+
+class WorkStealingPoolTest: public CppUnit::TestFixture {
+private:
+
+public:
+    // Called once before everything gets tested
+    WorkStealingPoolTest()
+    {
+    }
+
+    // Called at the end of the test
+    ~WorkStealingPoolTest()
+    {
+    }
+
+    // Called before each test
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,dmrpp:pool");
+    }
+
+    // Called after each test
+    void tearDown()
+    {
+    }
+
+    void run_all_tasks_test()
+    {
+        WorkStealingPool pool("test", 4);
+        atomic<unsigned int> count(0);
+        {
+            TaskGroup group;
+            for (unsigned int i = 0; i < 1000; ++i)
+                group.run(pool, [&count]() { count++; });
+            group.wait();
+        }
+        DBG(cerr << prolog << "count: " << count << endl);
+        CPPUNIT_ASSERT(count == 1000);
+        CPPUNIT_ASSERT(pool.queue_depth() == 0);
+    }
+
+    // Tasks in one pool start tasks in another; wait() must cover both stages.
+    void pipeline_test()
+    {
+        WorkStealingPool transfer("transfer", 2);
+        WorkStealingPool compute("compute", 3);
+        atomic<unsigned int> transfers(0);
+        atomic<unsigned int> computes(0);
+
+        TaskGroup group;
+        for (unsigned int i = 0; i < 50; ++i) {
+            group.run(transfer, [&group, &compute, &transfers, &computes]() {
+                this_thread::sleep_for(chrono::microseconds(100));
+                transfers++;
+                for (unsigned int j = 0; j < 20; ++j)
+                    group.run(compute, [&computes]() { computes++; });
+            });
+        }
+        group.wait();
+
+        DBG(cerr << prolog << "transfers: " << transfers << " computes: " << computes << endl);
+        DBG(cerr << prolog << "compute steals: " << compute.steal_count() << endl);
+        CPPUNIT_ASSERT(transfers == 50);
+        CPPUNIT_ASSERT(computes == 1000);
+        CPPUNIT_ASSERT(compute.tasks_executed() == 1000);
+    }
+
+    // A task submitted by a worker lands on that worker's deque. That worker
+    // is kept busy until all of them have run, so the others must steal each one.
+    void steal_test()
+    {
+        WorkStealingPool pool("test", 4);
+        atomic<unsigned int> count(0);
+
+        TaskGroup group;
+        group.run(pool, [&group, &pool, &count]() {
+            for (unsigned int i = 0; i < 200; ++i)
+                group.run(pool, [&count]() {
+                    this_thread::sleep_for(chrono::microseconds(50));
+                    count++;
+                });
+            while (count < 200)
+                this_thread::sleep_for(chrono::microseconds(100));
+        });
+        group.wait();
+
+        DBG(cerr << prolog << "steals: " << pool.steal_count() << endl);
+        CPPUNIT_ASSERT(count == 200);
+        CPPUNIT_ASSERT(pool.steal_count() >= 200);
+    }
+
+    void exception_test()
+    {
+        WorkStealingPool pool("test", 2);
+        TaskGroup group;
+        for (unsigned int i = 0; i < 100; ++i) {
+            group.run(pool, [i]() {
+                if (i == 10) throw BESInternalError("Chunk failed", __FILE__, __LINE__);
+            });
+        }
+        CPPUNIT_ASSERT_THROW(group.wait(), BESInternalError);
+        CPPUNIT_ASSERT(group.cancelled());
+
+        // The pool is still usable after a task throws.
+        atomic<unsigned int> count(0);
+        TaskGroup group2;
+        for (unsigned int i = 0; i < 10; ++i)
+            group2.run(pool, [&count]() { count++; });
+        group2.wait();
+        CPPUNIT_ASSERT(count == 10);
+    }
+
+    void process_pools_test()
+    {
+        WorkStealingPool *transfer = WorkStealingPool::TheTransferPool();
+        WorkStealingPool *compute = WorkStealingPool::TheComputePool();
+        CPPUNIT_ASSERT(transfer);
+        CPPUNIT_ASSERT(compute);
+        CPPUNIT_ASSERT(transfer != compute);
+        CPPUNIT_ASSERT(transfer == WorkStealingPool::TheTransferPool());
+        CPPUNIT_ASSERT(transfer->owner_pid() == getpid());
+    }
+
+    CPPUNIT_TEST_SUITE( WorkStealingPoolTest );
+
+        CPPUNIT_TEST(run_all_tasks_test);
+        CPPUNIT_TEST(pipeline_test);
+        CPPUNIT_TEST(steal_test);
+        CPPUNIT_TEST(exception_test);
+        CPPUNIT_TEST(process_pools_test);
+
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(WorkStealingPoolTest);
+
+} // namespace dmrpp
+
+int main(int argc, char*argv[])
+{
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    GetOpt getopt(argc, argv, "dD");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = true;  // debug is a static global
+            break;
+        case 'D':
+            debug = true;  // debug is a static global
+            bes_debug = true;  // debug is a static global
+            break;
+        default:
+            break;
+        }
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = dmrpp::WorkStealingPoolTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -56,6 +56,7 @@ using std::istringstream;
 #include <BESDebug.h>
 #include <BESInternalError.h>
 #include <DapFunctionUtils.h>
+#include <TextFormatter.h>
 #include "FoDapCovJsonTransform.h"
 #include "focovjson_utils.h"
 
@@ -168,7 +169,7 @@ bool FoDapCovJsonTransform::canConvert()
 }
 
 template<typename T>
-unsigned int FoDapCovJsonTransform::covjsonSimpleTypeArrayWorker(ostream *strm, T *values, unsigned int indx,
+unsigned int FoDapCovJsonTransform::covjsonSimpleTypeArrayWorker(bes::TextFormatter &out, const T *values, unsigned int indx,
     vector<unsigned int> *shape, unsigned int currentDim)
 {
     unsigned int currentDimSize = (*shape)[currentDim];
@@ -177,29 +178,42 @@ unsigned int FoDapCovJsonTransform::covjsonSimpleTypeArrayWorker(ostream *strm,
     // *strm << "\"currentDim\": \"" << currentDim << "\"" << endl;
     // *strm << "\"currentDimSize\": \"" << currentDimSize << "\"" << endl;
 
-    for(unsigned int i = 0; i < currentDimSize; i++) {
-        if(currentDim < shape->size() - 1) {
+    if(currentDim < shape->size() - 1) {
+        for(unsigned int i = 0; i < currentDimSize; i++) {
             BESDEBUG(FoDapCovJsonTransform_debug_key,
                 "covjsonSimpleTypeArrayWorker() - Recursing! indx:  " << indx << " currentDim: " << currentDim << " currentDimSize: " << currentDimSize << endl);
-            indx = covjsonSimpleTypeArrayWorker<T>(strm, values, indx, shape, currentDim + 1);
+            indx = covjsonSimpleTypeArrayWorker<T>(out, values, indx, shape, currentDim + 1);
             if(i + 1 != currentDimSize) {
-                *strm << ", ";
+                out.write(", ", 2);
             }
         }
-        else {
+    }
+    else if(typeid(T) == typeid(string)) {
+        for(unsigned int i = 0; i < currentDimSize; i++) {
             if(i) {
-                *strm << ", ";
-            }
-            if(typeid(T) == typeid(string)) {
-                // Strings need to be escaped to be included in a CovJSON object.
-                string val = reinterpret_cast<string*>(values)[indx++];
-                *strm << "\"" << focovjson::escape_for_covjson(val) << "\"";
+                out.write(", ", 2);
             }
-            else {
-                *strm << values[indx++];
+            // Strings need to be escaped to be included in a CovJSON object.
+            const string &val = reinterpret_cast<const string*>(values)[indx++];
+            out.put('"');
+            out.put(focovjson::escape_for_covjson(val));
+            out.put('"');
+        }
+    }
+    else if(typeid(T) == typeid(libdap::dods_byte)) {
+        // Byte values have always been written as characters (operator<< on
+        // an unsigned char); keep that so existing responses do not change.
+        for(unsigned int i = 0; i < currentDimSize; i++) {
+            if(i) {
+                out.write(", ", 2);
             }
+            out.put(static_cast<char>(values[indx++]));
         }
     }
+    else {
+        out.put_values(values + indx, currentDimSize, ", ");
+        indx += currentDimSize;
+    }
 
     return indx;
 }
@@ -239,12 +253,10 @@ void FoDapCovJsonTransform::covjsonSimpleTypeArray(ostream *strm, libdap::Array
             if (sendData) {
                 currAxis->values += "\"values\": [";
                 unsigned int indx = 0;
-                vector<T> src(length);
-                a->value(&src[0]);
-
-                ostringstream astrm;
-                indx = covjsonSimpleTypeArrayWorker(&astrm, &src[0], 0, &shape, 0);
-                currAxis->values += astrm.str();
+                // Format the values straight from the array's buffer
+                bes::TextFormatter avalues;
+                indx = covjsonSimpleTypeArrayWorker(avalues, reinterpret_cast<const T*>(a->get_buf()), 0, &shape, 0);
+                currAxis->values += avalues.str();
 
                 currAxis->values += "]";
 
@@ -303,12 +315,10 @@ void FoDapCovJsonTransform::covjsonSimpleTypeArray(ostream *strm, libdap::Array
         if (sendData) {
             currParameter->values += "\"values\": [";
             unsigned int indx = 0;
-            vector<T> src(length);
-            a->value(&src[0]);
-
-            ostringstream pstrm;
-            indx = covjsonSimpleTypeArrayWorker(&pstrm, &src[0], 0, &shape, 0);
-            currParameter->values += pstrm.str();
+            // Format the values straight from the array's buffer
+            bes::TextFormatter pvalues;
+            indx = covjsonSimpleTypeArrayWorker(pvalues, reinterpret_cast<const T*>(a->get_buf()), 0, &shape, 0);
+            currParameter->values += pvalues.str();
 
             currParameter->values += "]";
 
@@ -361,9 +371,9 @@ void FoDapCovJsonTransform::covjsonStringArray(ostream *strm, libdap::Array *a,
                 vector<string> sourceValues;
                 a->value(sourceValues);
 
-                ostringstream astrm;
-                indx = covjsonSimpleTypeArrayWorker(&astrm, (string *) (&sourceValues[0]), 0, &shape, 0);
-                currAxis->values += astrm.str();
+                bes::TextFormatter avalues;
+                indx = covjsonSimpleTypeArrayWorker(avalues, sourceValues.data(), 0, &shape, 0);
+                currAxis->values += avalues.str();
 
                 if (length != indx) {
                     BESDEBUG(FoDapCovJsonTransform_debug_key,
@@ -420,9 +430,9 @@ void FoDapCovJsonTransform::covjsonStringArray(ostream *strm, libdap::Array *a,
             vector<string> sourceValues;
             a->value(sourceValues);
 
-            ostringstream pstrm;
-            indx = covjsonSimpleTypeArrayWorker(&pstrm, (string *) (&sourceValues[0]), 0, &shape, 0);
-            currParameter->values += pstrm.str();
+            bes::TextFormatter pvalues;
+            indx = covjsonSimpleTypeArrayWorker(pvalues, sourceValues.data(), 0, &shape, 0);
+            currParameter->values += pvalues.str();
 
             if (length != indx) {
                 BESDEBUG(FoDapCovJsonTransform_debug_key,
@@ -43,6 +43,10 @@ class Array;
 
 class BESDataHandlerInterface;
 
+namespace bes {
+class TextFormatter;
+}
+
 /**
  * Used to transform a DDS into a CovJSON metadata or CovJSON data document.
  * The output is written to a local file whose name is passed as a parameter 
@@ -421,7 +425,7 @@ private:
      * @brief Writes each of the variables in a given container to the CovJSON stream.
      *    For each variable in the DDS, write out that variable as CovJSON.
      *
-     * @param ostrm Write the CovJSON to this output stream
+     * @param out Format the CovJSON values with this
      * @param values Source array of type T which we want to write to stream
      * @param indx variable for storing the current indexed value
      * @param shape a vector storing the shape's dimensional values
@@ -430,7 +434,7 @@ private:
      * @returns the most recently completed index
      */
     template<typename T>
-    unsigned int covjsonSimpleTypeArrayWorker(std::ostream *strm, T *values, unsigned int indx,
+    unsigned int covjsonSimpleTypeArrayWorker(bes::TextFormatter &out, const T *values, unsigned int indx,
         std::vector<unsigned int> *shape, unsigned int currentDim);
 
     /**
@@ -54,6 +54,7 @@ using std::istringstream;
 #include <BESInternalError.h>
 
 #include <DapFunctionUtils.h>
+#include <TextFormatter.h>
 
 #include "FoDapJsonTransform.h"
 #include "fojson_utils.h"
@@ -62,42 +63,6 @@ using std::istringstream;
 
 const int int_64_precision = 15; // 15 digits to the right of the decimal point. jhrg 9/14/15
 
-/**
- *  @TODO Handle String and URL Arrays including backslash escaping double quotes in values.
- *
- */
-template<typename T>
-unsigned int FoDapJsonTransform::json_simple_type_array_worker(ostream *strm, T *values, unsigned int indx,
-    vector<unsigned int> *shape, unsigned int currentDim)
-{
-    *strm << "[";
-
-    unsigned int currentDimSize = (*shape)[currentDim];
-
-    for (unsigned int i = 0; i < currentDimSize; i++) {
-        if (currentDim < shape->size() - 1) {
-//            BESDEBUG(FoDapJsonTransform_debug_key,
-//                "json_simple_type_array_worker() - Recursing! indx:  " << indx << " currentDim: " << currentDim << " currentDimSize: " << currentDimSize << endl);
-            indx = json_simple_type_array_worker<T>(strm, values, indx, shape, currentDim + 1);
-            if (i + 1 != currentDimSize) *strm << ", ";
-        }
-        else {
-            if (i) *strm << ", ";
-            if (typeid(T) == typeid(std::string)) {
-                // Strings need to be escaped to be included in a JSON object.
-                string val = reinterpret_cast<string*>(values)[indx++]; // ((string *) values)[indx++];
-                *strm << "\"" << fojson::escape_for_json(val) << "\"";
-            }
-            else {
-                *strm << values[indx++];
-            }
-        }
-    }
-    *strm << "]";
-
-    return indx;
-}
-
 /**
  * Writes the json representation of the passed DAP Array of simple types. If the
  * parameter "sendData" evaluates to true then data will also be sent.
@@ -105,7 +70,7 @@ unsigned int FoDapJsonTransform::json_simple_type_array_worker(ostream *strm, T
 template<typename T>
 void FoDapJsonTransform::json_simple_type_array(ostream *strm, libdap::Array *a, string indent, bool sendData)
 {
-    *strm << indent << "{" << endl;\
+    *strm << indent << "{\n";\
     string childindent = indent + _indent_increment;
 
     writeLeafMetadata(strm, a, childindent);
@@ -123,38 +88,31 @@ void FoDapJsonTransform::json_simple_type_array(ostream *strm, libdap::Array *a,
     *strm << "]";
 
     if (sendData) {
-        *strm << "," << endl;
+        *strm << ",\n";
 
         // Data
         *strm << childindent << "\"data\": ";
-        unsigned int indx = 0;
-        vector<T> src(length);
-        a->value(&src[0]);
+
+        // Format the values straight from the array's buffer
+        const T *src = reinterpret_cast<const T*>(a->get_buf());
 
         // I added this, and a corresponding block in FoInstance... because I fixed
         // an issue in libdap::Float64 where the precision was not properly reset
         // in it's print_val() method. Because of that error, precision was (left at)
         // 15 when this code was called until I fixed that method. Then this code
         // was not printing at the required precision. jhrg 9/14/15
-        if (typeid(T) == typeid(libdap::dods_float64)) {
-            streamsize prec = strm->precision(int_64_precision);
-            try {
-                indx = json_simple_type_array_worker(strm, &src[0], 0, &shape, 0);
-                strm->precision(prec);
-            }
-            catch(...) {
-                strm->precision(prec);
-                throw;
-            }
-        }
-        else {
-            indx = json_simple_type_array_worker(strm, &src[0], 0, &shape, 0);
-        }
+        bes::TextFormatter out(*strm);
+        if (typeid(T) == typeid(libdap::dods_float64)) out.precision(int_64_precision);
+
+        unsigned long indx = fojson::write_nested_arrays(out, shape,
+            [src](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                row.put_values(src + start, count, ", ");
+            });
 
-        assert(length == indx);
+        assert(length == (long) indx);
     }
 
-    *strm << endl << indent << "}";
+    *strm << '\n' << indent << "}";
 }
 
 /**
@@ -168,7 +126,7 @@ void FoDapJsonTransform::json_simple_type_array(ostream *strm, libdap::Array *a,
  */
 void FoDapJsonTransform::json_string_array(std::ostream *strm, libdap::Array *a, string indent, bool sendData)
 {
-    *strm << indent << "{" << endl;\
+    *strm << indent << "{\n";\
     string childindent = indent + _indent_increment;
 
     writeLeafMetadata(strm, a, childindent);
@@ -186,24 +144,26 @@ void FoDapJsonTransform::json_string_array(std::ostream *strm, libdap::Array *a,
     *strm << "]";
 
     if (sendData) {
-        *strm << "," << endl;
+        *strm << ",\n";
 
         // Data
         *strm << childindent << "\"data\": ";
-        unsigned int indx;
 
-        // The string type utilizes a specialized version of libdap:Array.value()
-        vector<std::string> sourceValues;
-        a->value(sourceValues);
-        indx = json_simple_type_array_worker(strm, (std::string *) (&sourceValues[0]), 0, &shape, 0);
+        // Strings need to be escaped to be included in a JSON object. They are
+        // copied from the array a block at a time.
+        bes::TextFormatter out(*strm);
+        unsigned long indx = fojson::write_nested_arrays(out, shape,
+            [a](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                fojson::write_string_values(row, a, start, count, true);
+            });
 
-        if (length != indx)
+        if (length != (long) indx)
             BESDEBUG(FoDapJsonTransform_debug_key,
                 "json_string_array() - indx NOT equal to content length! indx:  " << indx << "  length: " << length << endl);
 
     }
 
-    *strm << endl << indent << "}";
+    *strm << '\n' << indent << "}";
 }
 
 /**
@@ -213,11 +173,11 @@ void FoDapJsonTransform::writeDatasetMetadata(ostream *strm, libdap::DDS *dds, s
 {
 
     // Name
-    *strm << indent << "\"name\": \"" << dds->get_dataset_name() << "\"," << endl;
+    *strm << indent << "\"name\": \"" << dds->get_dataset_name() << "\",\n";
 
     //Attributes
     transform(strm, dds->get_attr_table(), indent);
-    *strm << "," << endl;
+    *strm << ",\n";
 
 }
 
@@ -229,11 +189,11 @@ void FoDapJsonTransform::writeNodeMetadata(ostream *strm, libdap::BaseType *bt,
 {
 
     // Name
-    *strm << indent << "\"name\": \"" << bt->name() << "\"," << endl;
+    *strm << indent << "\"name\": \"" << bt->name() << "\",\n";
 
     //Attributes
     transform(strm, bt->get_attr_table(), indent);
-    *strm << "," << endl;
+    *strm << ",\n";
 
 }
 
@@ -245,20 +205,20 @@ void FoDapJsonTransform::writeLeafMetadata(ostream *strm, libdap::BaseType *bt,
 {
 
     // Name
-    *strm << indent << "\"name\": \"" << bt->name() << "\"," << endl;
+    *strm << indent << "\"name\": \"" << bt->name() << "\",\n";
 
     // type
     if (bt->type() == libdap::dods_array_c) {
         libdap::Array *a = (libdap::Array *) bt;
-        *strm << indent << "\"type\": \"" << a->var()->type_name() << "\"," << endl;
+        *strm << indent << "\"type\": \"" << a->var()->type_name() << "\",\n";
     }
     else {
-        *strm << indent << "\"type\": \"" << bt->type_name() << "\"," << endl;
+        *strm << indent << "\"type\": \"" << bt->type_name() << "\",\n";
     }
 
     //Attributes
     transform(strm, bt->get_attr_table(), indent);
-    *strm << "," << endl;
+    *strm << ",\n";
 
 }
 
@@ -351,7 +311,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::Constructor *cnstrctr,
     }
 
     // Declare this node
-    *strm << indent << "{" << endl;
+    *strm << indent << "{\n";
     string child_indent = indent + _indent_increment;
 
     // Write this node's metadata (name & attributes)
@@ -359,7 +319,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::Constructor *cnstrctr,
 
     transform_node_worker(strm, leaves, nodes, child_indent, sendData);
 
-    *strm << indent << "}" << endl;
+    *strm << indent << "}\n";
 
 }
 
@@ -372,29 +332,29 @@ void FoDapJsonTransform::transform_node_worker(ostream *strm, vector<libdap::Bas
 {
     // Write down this nodes leaves
     *strm << indent << "\"leaves\": [";
-    if (leaves.size() > 0) *strm << endl;
+    if (leaves.size() > 0) *strm << '\n';
     for (std::vector<libdap::BaseType *>::size_type l = 0; l < leaves.size(); l++) {
         libdap::BaseType *v = leaves[l];
         BESDEBUG(FoDapJsonTransform_debug_key, "Processing LEAF: " << v->name() << endl);
         if (l > 0) {
             *strm << ",";
-            *strm << endl;
+            *strm << '\n';
         }
         transform(strm, v, indent + _indent_increment, sendData);
     }
-    if (leaves.size() > 0) *strm << endl << indent;
-    *strm << "]," << endl;
+    if (leaves.size() > 0) *strm << '\n' << indent;
+    *strm << "],\n";
 
     // Write down this nodes child nodes
     *strm << indent << "\"nodes\": [";
-    if (nodes.size() > 0) *strm << endl;
+    if (nodes.size() > 0) *strm << '\n';
     for (std::vector<libdap::BaseType *>::size_type n = 0; n < nodes.size(); n++) {
         libdap::BaseType *v = nodes[n];
         transform(strm, v, indent + _indent_increment, sendData);
     }
-    if (nodes.size() > 0) *strm << endl << indent;
+    if (nodes.size() > 0) *strm << '\n' << indent;
 
-    *strm << "]" << endl;
+    *strm << "]\n";
 }
 
 /**
@@ -428,7 +388,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::DDS *dds, string inden
     }
 
     // Declare this node
-    *strm << indent << "{" << endl;
+    *strm << indent << "{\n";
     string child_indent = indent + _indent_increment;
 
     // Write this node's metadata (name & attributes)
@@ -436,7 +396,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::DDS *dds, string inden
 
     transform_node_worker(strm, leaves, nodes, child_indent, sendData);
 
-    *strm << indent << "}" << endl;
+    *strm << indent << "}\n";
 }
 
 /**
@@ -503,13 +463,13 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::BaseType *bt, string i
 void FoDapJsonTransform::transformAtomic(ostream *strm, libdap::BaseType *b, string indent, bool sendData)
 {
 
-    *strm << indent << "{" << endl;
+    *strm << indent << "{\n";
 
     string childindent = indent + _indent_increment;
 
     writeLeafMetadata(strm, b, childindent);
 
-    *strm << childindent << "\"shape\": [1]," << endl;
+    *strm << childindent << "\"shape\": [1],\n";
 
     if (sendData) {
         // Data
@@ -634,7 +594,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::AttrTable &attr_table,
 
 // Only do more if there are actually attributes in the table
     if (attr_table.get_size() != 0) {
-        *strm << endl;
+        *strm << '\n';
         libdap::AttrTable::Attr_iter begin = attr_table.attr_begin();
         libdap::AttrTable::Attr_iter end = attr_table.attr_end();
 
@@ -645,25 +605,25 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::AttrTable &attr_table,
                 libdap::AttrTable *atbl = attr_table.get_attr_table(at_iter);
 
                 // not first thing? better use a comma...
-                if (at_iter != begin) *strm << "," << endl;
+                if (at_iter != begin) *strm << ",\n";
 
                 // Attribute Containers need to be opened and then a recursive call gets made
-                *strm << child_indent << "{" << endl;
+                *strm << child_indent << "{\n";
 
                 // If the table has a name, write it out as a json property.
                 if (atbl->get_name().length() > 0)
-                    *strm << child_indent + _indent_increment << "\"name\": \"" << atbl->get_name() << "\"," << endl;
+                    *strm << child_indent + _indent_increment << "\"name\": \"" << atbl->get_name() << "\",\n";
 
                 // Recursive call for child attribute table.
                 transform(strm, *atbl, child_indent + _indent_increment);
-                *strm << endl << child_indent << "}";
+                *strm << '\n' << child_indent << "}";
 
                 break;
 
             }
             default: {
                 // not first thing? better use a comma...
-                if (at_iter != begin) *strm << "," << endl;
+                if (at_iter != begin) *strm << ",\n";
 
                 // Open attribute object, write name
                 *strm << child_indent << "{\"name\": \"" << attr_table.get_name(at_iter) << "\", ";
@@ -699,7 +659,7 @@ void FoDapJsonTransform::transform(ostream *strm, libdap::AttrTable &attr_table,
             }
         }
 
-        *strm << endl << indent;
+        *strm << '\n' << indent;
     }
 
     // close AttrTable JSON
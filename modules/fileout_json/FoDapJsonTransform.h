@@ -78,9 +78,6 @@ private:
 
     void json_string_array(std::ostream *strm, libdap::Array *a, std::string indent, bool sendData);
 
-    template<typename T>
-    unsigned int json_simple_type_array_worker(std::ostream *strm, T *values, unsigned int indx,
-        std::vector<unsigned int> *shape, unsigned int currentDim);
 public:
     FoDapJsonTransform(libdap::DDS *dds);
 
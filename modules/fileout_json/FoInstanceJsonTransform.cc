@@ -49,6 +49,8 @@
 #include <BESDebug.h>
 #include <BESInternalError.h>
 
+#include <TextFormatter.h>
+
 #include "FoInstanceJsonTransform.h"
 #include "fojson_utils.h"
 
@@ -60,36 +62,6 @@ using namespace std;
 #define FoInstanceJsonTransform_debug_key "fojson"
 const int int_64_precision = 15; // See also in FODapJsonTransform.cc. jhrg 9/14/15
 
-/**
- * Writes out the values of an n-dimensional array. Uses recursion.
- */
-template<typename T>
-unsigned int FoInstanceJsonTransform::json_simple_type_array_worker(std::ostream *strm,
-    const std::vector<T> &values, unsigned int indx, const std::vector<unsigned int> &shape, unsigned int currentDim)
-{
-    *strm << "[";
-
-    unsigned int currentDimSize = shape.at(currentDim);        // at is slower than [] but safe
-
-    for (unsigned int i = 0; i < currentDimSize; i++) {
-        if (currentDim < shape.size() - 1) {
-            BESDEBUG(FoInstanceJsonTransform_debug_key,
-                "json_simple_type_array_worker() - Recursing! indx:  " << indx << " currentDim: " << currentDim << " currentDimSize: " << currentDimSize << endl);
-
-            indx = json_simple_type_array_worker<T>(strm, values, indx, shape, currentDim + 1);
-            if (i + 1 != currentDimSize) *strm << ", ";
-        }
-        else {
-            if (i) *strm << ", ";
-            *strm << values[indx++];
-        }
-    }
-
-    *strm << "]";
-
-    return indx;
-}
-
 /**
  * @brief Writes out (in a JSON instance object representation) the metadata and data values for the passed array of simple types.
  *
@@ -108,39 +80,30 @@ template<typename T> void FoInstanceJsonTransform::json_simple_type_array(std::o
         std::vector<unsigned int> shape(a->dimensions(true));
         long length = fojson::computeConstrainedShape(a, &shape);
 
-        vector<T> src(length);
-        a->value(&src[0]);
+        // Format the values straight from the array's buffer
+        const T *src = reinterpret_cast<const T*>(a->get_buf());
 
-        unsigned int indx = 0;
+        bes::TextFormatter out(*strm);
+        if (typeid(T) == typeid(libdap::dods_float64)) out.precision(int_64_precision);
 
-        if (typeid(T) == typeid(libdap::dods_float64)) {
-            streamsize prec = strm->precision(int_64_precision);
-            try {
-                indx = json_simple_type_array_worker(strm, src, 0, shape, 0);
-                strm->precision(prec);
-            }
-            catch (...) {
-                strm->precision(prec);
-                throw;
-            }
-        }
-        else {
-            indx = json_simple_type_array_worker(strm, src, 0, shape, 0);
-        }
+        unsigned long indx = fojson::write_nested_arrays(out, shape,
+            [src](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                row.put_values(src + start, count, ", ");
+            });
 
         // make this an assert?
-        assert(length == indx);
+        assert(length == (long) indx);
 #if 0
-        if (length != indx)
+        if (length != (long) indx)
         BESDEBUG(FoInstanceJsonTransform_debug_key,
             "json_simple_type_array() - indx NOT equal to content length! indx:  " << indx << "  length: " << length << endl);
 #endif
     }
     else { // otherwise send metadata
-        *strm << "{" << endl;
+        *strm << "{\n";
         //Attributes
         transform(strm, a->get_attr_table(), indent + _indent_increment);
-        *strm << endl << indent << "}";
+        *strm << '\n' << indent << "}";
     }
 }
 
@@ -162,22 +125,23 @@ void FoInstanceJsonTransform::json_string_array(std::ostream *strm, libdap::Arra
         std::vector<unsigned int> shape(a->dimensions(true));
         long length = fojson::computeConstrainedShape(a, &shape);
 
-        // The string type utilizes a specialized version of libdap::Array::value()
-        std::vector<std::string> sourceValues;
-        a->value(sourceValues);
-
-        unsigned int indx = json_simple_type_array_worker(strm, sourceValues, 0, shape, 0);
+        // The strings are copied from the array a block at a time
+        bes::TextFormatter out(*strm);
+        unsigned long indx = fojson::write_nested_arrays(out, shape,
+            [a](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                fojson::write_string_values(row, a, start, count, false);
+            });
 
         // make this an assert?
-        if (length != indx)
+        if (length != (long) indx)
             BESDEBUG(FoInstanceJsonTransform_debug_key,
                 "json_string_array() - indx NOT equal to content length! indx:  " << indx << "  length: " << length << endl);
     }
     else { // otherwise send metadata
-        *strm << "{" << endl;
+        *strm << "{\n";
         //Attributes
         transform(strm, a->get_attr_table(), indent + _indent_increment);
-        *strm << endl << indent << "}";
+        *strm << '\n' << indent << "}";
     }
 }
 
@@ -274,11 +238,11 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::DDS *dds, st
     bool sentSomething = false;
 
     // Open returned JSON object
-    *strm << "{" << endl;
+    *strm << "{\n";
 
     // Name object
     std::string name = dds->get_dataset_name();
-    *strm << indent + _indent_increment << "\"name\": \"" << fojson::escape_for_json(name) << "\"," << endl;
+    *strm << indent + _indent_increment << "\"name\": \"" << fojson::escape_for_json(name) << "\",\n";
 
     if (!sendData) {
         // Send metadata if we aren't sending data
@@ -286,7 +250,7 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::DDS *dds, st
         //Attributes
         transform(strm, dds->get_attr_table(), indent);
         if (dds->get_attr_table().get_size() > 0) *strm << ",";
-        *strm << endl;
+        *strm << '\n';
     }
 
     // Process the variables in the DDS
@@ -302,7 +266,7 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::DDS *dds, st
 
                 if (sentSomething) {
                     *strm << ",";
-                    *strm << endl;
+                    *strm << '\n';
                 }
                 transform(strm, v, indent + _indent_increment, sendData);
 
@@ -312,7 +276,7 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::DDS *dds, st
     }
 
     // Close the JSON object
-    *strm << endl << "}" << endl;
+    *strm << '\n' << "}\n";
 }
 
 /** @brief Transforms the BaseType object into a JSON instance object representation.
@@ -425,7 +389,7 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Structure *b
 
     // Open object with name of the structure
     std::string name = b->name();
-    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {" << endl;
+    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {\n";
 
     // Process the variables.
     if (b->width(true) > 0) {
@@ -443,7 +407,7 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Structure *b
                 if ((vi + 1) != ve) {
                     *strm << ",";
                 }
-                *strm << endl;
+                *strm << '\n';
             }
         }
     }
@@ -464,26 +428,26 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Grid *g, str
 
     // Open JSON property object with name of the grid
     std::string name = g->name();
-    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {" << endl;
+    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {\n";
 
     BESDEBUG(FoInstanceJsonTransform_debug_key,
         "FoInstanceJsonTransform::transform() - Processing Grid data Array: " << g->get_array()->name() << endl);
 
     // Process the data array
     transform(strm, g->get_array(), indent + _indent_increment, sendData);
-    *strm << "," << endl;
+    *strm << ",\n";
 
     // Process the MAP arrays
     for (libdap::Grid::Map_iter mapi = g->map_begin(); mapi < g->map_end(); mapi++) {
         BESDEBUG(FoInstanceJsonTransform_debug_key,
             "FoInstanceJsonTransform::transform() - Processing Grid Map Array: " << (*mapi)->name() << endl);
         if (mapi != g->map_begin()) {
-            *strm << "," << endl;
+            *strm << ",\n";
         }
         transform(strm, *mapi, indent + _indent_increment, sendData);
     }
     // Close the JSON property object
-    *strm << endl << indent << "}";
+    *strm << '\n' << indent << "}";
 
 }
 
@@ -501,17 +465,17 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Sequence *s,
 
     // Open JSON property object with name of the sequence
     std::string name = s->name();
-    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {" << endl;
+    *strm << indent << "\"" << fojson::escape_for_json(name) << "\": {\n";
 
     string child_indent = indent + _indent_increment;
 
 #if 0
     the erdap way
-    *strm << indent << "\"table\": {" << endl;
+    *strm << indent << "\"table\": {\n";
 
     string child_indent = indent + _indent_increment;
 
-    *strm << child_indent << "\"name\": \"" << s->name() << "\"," << endl;
+    *strm << child_indent << "\"name\": \"" << s->name() << "\",\n";
 
 #endif
 
@@ -521,20 +485,20 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Sequence *s,
         std::string name = (*v)->name();
         *strm << "\"" << fojson::escape_for_json(name) << "\"";
     }
-    *strm << "]," << endl;
+    *strm << "],\n";
 
     *strm << child_indent << "\"columnTypes\": [";
     for (libdap::Constructor::Vars_iter v = s->var_begin(); v < s->var_end(); v++) {
         if (v != s->var_begin()) *strm << ",";
         *strm << "\"" << (*v)->type_name() << "\"";
     }
-    *strm << "]," << endl;
+    *strm << "],\n";
 
     bool first = true;
     *strm << child_indent << "\"rows\": [";
     while (s->read()) {
         if (!first) *strm << ", ";
-        *strm << endl << child_indent << "[";
+        *strm << '\n' << child_indent << "[";
         for (libdap::Constructor::Vars_iter v = s->var_begin(); v < s->var_end(); v++) {
             if (v != s->var_begin()) *strm << child_indent << ",";
             transform(strm, (*v), child_indent + _indent_increment, sendData);
@@ -542,10 +506,10 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::Sequence *s,
         *strm << child_indent << "]";
         first = false;
     }
-    *strm << endl << child_indent << "]" << endl;
+    *strm << '\n' << child_indent << "]\n";
 
     // Close the JSON property object
-    *strm << indent << "}" << endl;
+    *strm << indent << "}\n";
 }
 
 /** @brief Transforms the Array object into a JSON instance object representation.
@@ -697,24 +661,24 @@ void FoInstanceJsonTransform::transform(std::ostream *strm, libdap::AttrTable &a
             {
                 libdap::AttrTable *atbl = attr_table.get_attr_table(at_iter);
 
-                if (at_iter != begin) *strm << "," << endl;
+                if (at_iter != begin) *strm << ",\n";
 
                 // Open a JSON property with the name of the Attribute Table and
                 std::string name = atbl->get_name();
-                *strm << child_indent << "\"" << fojson::escape_for_json(name) << "\": {" << endl;
+                *strm << child_indent << "\"" << fojson::escape_for_json(name) << "\": {\n";
 
                 // Process the Attribute Table.
                 transform(strm, *atbl, child_indent + _indent_increment);
 
                 // Close JSON property object
-                *strm << endl << child_indent << "}";
+                *strm << '\n' << child_indent << "}";
 
                 break;
 
             }
             default: // so it's not an Attribute Table. woot. time to print
                 // First?
-                if (at_iter != begin) *strm << "," << endl;
+                if (at_iter != begin) *strm << ",\n";
 
                 // Name of property
                 std::string name = attr_table.get_name(at_iter);
@@ -60,9 +60,6 @@ private:
 
     // std::ostream *_ostrm;
 
-    template<typename T> unsigned int json_simple_type_array_worker(std::ostream *strm, const std::vector<T> &values,
-        unsigned int indx, const std::vector<unsigned int> &shape, unsigned int currentDim);
-
     template<typename T> void json_simple_type_array(std::ostream *strm, libdap::Array *a, std::string indent,
         bool sendData);
     void json_string_array(std::ostream *strm, libdap::Array *a, std::string indent, bool sendData);
@@ -33,6 +33,7 @@
 
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #define utils_debug_key "fojson"
 
@@ -91,6 +92,48 @@ long computeConstrainedShape(libdap::Array *a, std::vector<unsigned int> *shape
     return totalSize;
 }
 
+/**
+ * @brief Write some of the values of a String or Url array
+ *
+ * The strings are copied from the array a block at a time so a large array
+ * is not copied all at once.
+ *
+ * @param out Write the values here, separated by ", "
+ * @param a The array
+ * @param start The first value to write
+ * @param count The number of values to write
+ * @param quote If true, escape the values and write them in double quotes
+ */
+void write_string_values(bes::TextFormatter &out, libdap::Array *a, unsigned long start, unsigned long count,
+    bool quote)
+{
+    const unsigned long block_size = 4096;
+
+    std::vector<unsigned int> index;
+    std::vector<std::string> values;
+    for (unsigned long first = start; first < start + count; first += block_size) {
+        unsigned long n = std::min(block_size, start + count - first);
+        index.resize(n);
+        for (unsigned long i = 0; i < n; ++i)
+            index[i] = first + i;
+
+        values.clear();
+        a->value(&index, values);
+
+        for (unsigned long i = 0; i < n; ++i) {
+            if (first + i != start) out.write(", ", 2);
+            if (quote) {
+                out.put('"');
+                out.put(escape_for_json(values[i]));
+                out.put('"');
+            }
+            else {
+                out.put(values[i]);
+            }
+        }
+    }
+}
+
 #if 0
 /**
  * Replace every occurrence of 'char_to_escape' with the same preceded
@@ -34,12 +34,62 @@
 
 #include <Array.h>
 
+#include <TextFormatter.h>
+
 namespace fojson {
 
 std::string escape_for_json(const std::string &source);
 
 long computeConstrainedShape(libdap::Array *a, std::vector<unsigned int> *shape );
 
+void write_string_values(bes::TextFormatter &out, libdap::Array *a, unsigned long start, unsigned long count,
+    bool quote);
+
+/**
+ * @brief Write the values of an array as nested JSON arrays
+ *
+ * For the shape [2][3] this writes [[a, b, c], [d, e, f]]. The values of
+ * the rightmost dimension are written by write_row(out, start, count),
+ * which writes 'count' values separated by ", ", starting with value
+ * 'start'. The dimensions are walked with a counter for each one, not by
+ * recursion, so the number of dimensions doesn't matter.
+ *
+ * @param out Write the text here
+ * @param shape The size of each dimension; must not be empty
+ * @param write_row Writes the values of one row
+ * @return The number of values written
+ */
+template<typename RowWriter>
+unsigned long write_nested_arrays(bes::TextFormatter &out, const std::vector<unsigned int> &shape, RowWriter write_row)
+{
+    const int last = shape.size() - 1;
+    std::vector<unsigned int> pos(shape.size(), 0);     // the next child of each dimension
+    unsigned long indx = 0;
+
+    out.put('[');
+    int d = 0;
+    while (d >= 0) {
+        if (d == last) {
+            write_row(out, indx, shape[d]);
+            indx += shape[d];
+            out.put(']');
+            --d;
+        }
+        else if (pos[d] < shape[d]) {
+            if (pos[d]) out.write(", ", 2);
+            ++pos[d];
+            pos[++d] = 0;
+            out.put('[');
+        }
+        else {
+            out.put(']');
+            --d;
+        }
+    }
+
+    return indx;
+}
+
 #if 0
 std::string backslash_escape(std::string source, char char_to_escape);
 #endif
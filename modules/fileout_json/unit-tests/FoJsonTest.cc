@@ -28,6 +28,7 @@
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/extensions/HelperMacros.h>
 #include <math.h>       /* atan */
+#include <sstream>
 
 #include <GetOpt.h>
 #include <DataDDS.h>
@@ -92,6 +93,91 @@ private:
         return string(&buffer[0]);
     }
 
+    // The recursive writer that write_nested_arrays() replaced. The tests
+    // check that the JSON text it wrote has not changed.
+    template<typename T>
+    static unsigned int recursive_worker(bes::TextFormatter &out, const T *values, unsigned int indx,
+        const vector<unsigned int> &shape, unsigned int currentDim)
+    {
+        out.put('[');
+
+        unsigned int currentDimSize = shape[currentDim];
+
+        if (currentDim < shape.size() - 1) {
+            for (unsigned int i = 0; i < currentDimSize; i++) {
+                indx = recursive_worker<T>(out, values, indx, shape, currentDim + 1);
+                if (i + 1 != currentDimSize) out.write(", ", 2);
+            }
+        }
+        else {
+            out.put_values(values + indx, currentDimSize, ", ");
+            indx += currentDimSize;
+        }
+
+        out.put(']');
+
+        return indx;
+    }
+
+    template<typename T>
+    void check_nested_arrays(const vector<T> &values, const vector<unsigned int> &shape)
+    {
+        bes::TextFormatter expected;
+        unsigned int expected_indx = recursive_worker(expected, values.data(), 0, shape, 0);
+
+        bes::TextFormatter out;
+        const T *src = values.data();
+        unsigned long indx = write_nested_arrays(out, shape,
+            [src](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                row.put_values(src + start, count, ", ");
+            });
+
+        DBG(cerr << out.str() << endl);
+
+        CPPUNIT_ASSERT_EQUAL((unsigned long) expected_indx, indx);
+        CPPUNIT_ASSERT_EQUAL(expected.str(), out.str());
+    }
+
+    /**
+     * Write 'values' as a String array with the shape 'shape', the way the
+     * transforms do, to a stream that is written every 'flush_size' bytes.
+     * Compare that to the text of the old code, which copied all of the
+     * strings and then escaped and quoted them (FoDapJsonTransform) or
+     * wrote them as they were (FoInstanceJsonTransform).
+     */
+    string check_string_values(const vector<string> &values, const vector<unsigned int> &shape, bool quote,
+        size_t flush_size)
+    {
+        libdap::Str tmpl("s");
+        libdap::Array a("s", &tmpl);
+        for (vector<unsigned int>::size_type i = 0; i < shape.size(); ++i)
+            a.append_dim(shape[i], string("dim") + char('0' + i));
+        vector<string> a_values(values);
+        a.set_value(a_values, a_values.size());
+
+        vector<string> old_values(values);
+        if (quote) {
+            for (vector<string>::size_type i = 0; i < old_values.size(); ++i)
+                old_values[i] = "\"" + escape_for_json(values[i]) + "\"";
+        }
+        bes::TextFormatter expected;
+        recursive_worker(expected, old_values.data(), 0, shape, 0);
+
+        ostringstream oss;
+        {
+            bes::TextFormatter out(oss, flush_size);
+            unsigned long indx = write_nested_arrays(out, shape,
+                [&a, quote](bes::TextFormatter &row, unsigned long start, unsigned long count) {
+                    write_string_values(row, &a, start, count, quote);
+                });
+            CPPUNIT_ASSERT_EQUAL((unsigned long) values.size(), indx);
+        }
+
+        CPPUNIT_ASSERT_EQUAL(expected.str(), oss.str());
+
+        return oss.str();
+    }
+
 public:
 
     // Called once before everything gets tested
@@ -124,6 +210,12 @@ CPPUNIT_TEST_SUITE( FoJsonTest );
     CPPUNIT_TEST(test_instance_object_metadata_representation);
     CPPUNIT_TEST(test_instance_object_data_representation);
 
+    CPPUNIT_TEST(test_nested_arrays_rank1);
+    CPPUNIT_TEST(test_nested_arrays_rank3);
+    CPPUNIT_TEST(test_nested_arrays_zero_length);
+    CPPUNIT_TEST(test_string_values_escaped);
+    CPPUNIT_TEST(test_string_values_blocks);
+
     CPPUNIT_TEST_SUITE_END()
     ;
 
@@ -392,6 +484,110 @@ CPPUNIT_TEST_SUITE( FoJsonTest );
 
     }
 
+    void test_nested_arrays_rank1()
+    {
+        vector<int> values;
+        for (int i = 0; i < 7; ++i)
+            values.push_back(i * 1000 - 3000);
+
+        check_nested_arrays(values, vector<unsigned int>(1, 7));
+        check_nested_arrays(vector<int>(1, 42), vector<unsigned int>(1, 1));
+    }
+
+    void test_nested_arrays_rank3()
+    {
+        vector<unsigned int> shape;
+        shape.push_back(2);
+        shape.push_back(3);
+        shape.push_back(4);
+
+        vector<double> values;
+        for (int i = 0; i < 24; ++i)
+            values.push_back(i / 8.0 - 1);
+        check_nested_arrays(values, shape);
+
+        vector<libdap::dods_byte> bytes;
+        for (int i = 0; i < 24; ++i)
+            bytes.push_back(i * 11);
+        check_nested_arrays(bytes, shape);
+
+        // A dimension of size one in the middle
+        shape[1] = 1;
+        values.resize(8);
+        check_nested_arrays(values, shape);
+    }
+
+    void test_nested_arrays_zero_length()
+    {
+        vector<int> none;
+
+        check_nested_arrays(none, vector<unsigned int>(1, 0));
+
+        vector<unsigned int> shape;
+        shape.push_back(2);
+        shape.push_back(0);
+        shape.push_back(3);
+        check_nested_arrays(none, shape);
+
+        shape.clear();
+        shape.push_back(3);
+        shape.push_back(0);
+        check_nested_arrays(none, shape);
+
+        shape.clear();
+        shape.push_back(0);
+        shape.push_back(4);
+        check_nested_arrays(none, shape);
+    }
+
+    void test_string_values_escaped()
+    {
+        vector<string> values;
+        values.push_back("plain");
+        values.push_back("a \"quoted\" word");
+        values.push_back("back\\slash");
+        values.push_back("two\nlines");
+        values.push_back("tab\there");
+        values.push_back(string("nul\0char", 8));
+        values.push_back("\x01\x1f");
+        values.push_back("");
+
+        vector<unsigned int> shape;
+        shape.push_back(2);
+        shape.push_back(4);
+
+        check_string_values(values, shape, true, 64 * 1024);
+        check_string_values(values, shape, false, 64 * 1024);
+
+        vector<string> two;
+        two.push_back("a\"b");
+        two.push_back("c\\d");
+        CPPUNIT_ASSERT_EQUAL(string("[\"a\\u0022b\", \"c\\u005cd\"]"),
+            check_string_values(two, vector<unsigned int>(1, 2), true, 64 * 1024));
+    }
+
+    // write_string_values() copies 4096 strings at a time; these rows are
+    // longer than that and the text is written to the stream every few
+    // bytes, so both the blocks and the stream writes split rows.
+    void test_string_values_blocks()
+    {
+        vector<string> values;
+        for (int i = 0; i < 3 * 4097; ++i) {
+            ostringstream oss;
+            oss << "value \"" << i << "\"";
+            values.push_back(oss.str());
+        }
+
+        vector<unsigned int> shape;
+        shape.push_back(3);
+        shape.push_back(4097);
+
+        check_string_values(values, shape, true, 100);
+        check_string_values(values, shape, false, 4096);
+
+        check_string_values(values, vector<unsigned int>(1, values.size()), true, 4096);
+    }
+
     libdap::DataDDS *makeSimpleTypesDDS()
     {
         // build a DataDDS of simple types and set values for each of the
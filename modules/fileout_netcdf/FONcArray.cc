@@ -480,7 +480,6 @@ void FONcArray::write(int ncid)
     }
 
     ncopts = NC_VERBOSE;
-    int stax = NC_NOERR;
 
     if (d_array_type != NC_CHAR) {
 
@@ -491,50 +490,23 @@ void FONcArray::write(int ncid)
         else {
             string var_type = d_a->var()->type_name();
 
-            // create array to hold data hyperslab
+            // The values are written from the Array's own buffer; only the
+            // types that must be widened are copied, a slab at a time.
             switch (d_array_type) {
-            case NC_BYTE: {
-                unsigned char *data = new unsigned char[d_nelements];
-                d_a->buf2val((void**) &data);
-                stax = nc_put_var_uchar(ncid, _varid, data);
-                delete[] data;
-
-                if (stax != NC_NOERR) {
-                    string err = "fileout.netcdf - Failed to create array of bytes for " + _varname;
-                    FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-                }
+            case NC_BYTE:
+                write_direct<unsigned char>(ncid, nc_put_vara_uchar, "bytes");
                 break;
-            }
-
-            case NC_SHORT: {
-                short *data = new short[d_nelements];
 
+            case NC_SHORT:
                 // Given Byte/UInt8 will always be unsigned they must map
                 // to a NetCDF type that will support unsigned bytes.  This
                 // detects the original variable was of type Byte and typecasts
                 // each data value to a short.
-                if (var_type == "Byte") {
-
-                    unsigned char *orig_data = new unsigned char[d_nelements];
-                    d_a->buf2val((void**) &orig_data);
-
-                    for (int d_i = 0; d_i < d_nelements; d_i++)
-                        data[d_i] = orig_data[d_i];
-
-                    delete[] orig_data;
-                }
-                else {
-                    d_a->buf2val((void**) &data);
-                }
-                int stax = nc_put_var_short(ncid, _varid, data);
-                delete[] data;
-
-                if (stax != NC_NOERR) {
-                    string err = (string) "fileout.netcdf - Failed to create array of shorts for " + _varname;
-                    FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-                }
+                if (var_type == "Byte")
+                    write_converted<dods_byte, short>(ncid, nc_put_vara_short, "shorts");
+                else
+                    write_direct<short>(ncid, nc_put_vara_short, "shorts");
                 break;
-            }
 
             case NC_INT: {
                 // Added as a stop-gap measure to alert SAs and inform users of a misconfigured server.
@@ -556,57 +528,23 @@ void FONcArray::write(int ncid)
                     throw BESInternalError(msg, __FILE__, __LINE__);
                 }
 
-                int *data = new int[d_nelements];
                 // Since UInt16 also maps to NC_INT, we need to obtain the data correctly
                 // KY 2012-10-25
-                if (var_type == "UInt16") {
-                    unsigned short *orig_data = new unsigned short[d_nelements];
-                    d_a->buf2val((void**) &orig_data);
-
-                    for (int d_i = 0; d_i < d_nelements; d_i++)
-                        data[d_i] = orig_data[d_i];
-
-                    delete[] orig_data;
-                }
-                else {
-                    d_a->buf2val((void**) &data);
-                }
-
-                int stax = nc_put_var_int(ncid, _varid, data);
-                delete[] data;
-
-                if (stax != NC_NOERR) {
-                    string err = (string) "fileout.netcdf - Failed to create array of ints for " + _varname;
-                    FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-                }
+                if (var_type == "UInt16")
+                    write_converted<dods_uint16, int>(ncid, nc_put_vara_int, "ints");
+                else
+                    write_direct<int>(ncid, nc_put_vara_int, "ints");
                 break;
             }
 
-            case NC_FLOAT: {
-                float *data = new float[d_nelements];
-                d_a->buf2val((void**) &data);
-                int stax = nc_put_var_float(ncid, _varid, data);
-                delete[] data;
-
-                if (stax != NC_NOERR) {
-                    string err = (string) "fileout.netcdf - Failed to create array of floats for " + _varname;
-                    FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-                }
+            case NC_FLOAT:
+                write_direct<float>(ncid, nc_put_vara_float, "floats");
                 break;
-            }
 
-            case NC_DOUBLE: {
-                double *data = new double[d_nelements];
-                d_a->buf2val((void**) &data);
-                int stax = nc_put_var_double(ncid, _varid, data);
-                delete[] data;
-
-                if (stax != NC_NOERR) {
-                    string err = (string) "fileout.netcdf - Failed to create array of doubles for " + _varname;
-                    FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-                }
+            case NC_DOUBLE:
+                write_direct<double>(ncid, nc_put_vara_double, "doubles");
                 break;
-            }
+
             // TODO: should add other DAP4 types: NC_UINT...
             }
         }
@@ -712,154 +650,131 @@ void FONcArray::dump(ostream &strm) const
 
 void FONcArray::write_for_nc4_types(int ncid) {
 
-    int stax = NC_NOERR;
-
     // create array to hold data hyperslab
     // DAP2 only supports unsigned BYTE. So here
     // we don't inlcude NC_BYTE (the signed BYTE, the same
     // as 64-bit integer). KY 2020-03-20 
     // Actually 64-bit integer is supported.
+    //
+    // Each of these types is the same as the DAP type, so the values are
+    // written from the Array's buffer without a copy.
     switch (d_array_type) {
-    case NC_BYTE: {
-        signed char *data = new signed char[d_nelements];
-        d_a->buf2val((void**) &data);
-        stax = nc_put_var_schar(ncid, _varid, data);
-        delete[] data;
-
-        if (stax != NC_NOERR) {
-            string err = "fileout.netcdf - Failed to create array of bytes for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_BYTE:
+        write_direct<signed char>(ncid, nc_put_vara_schar, "bytes");
         break;
-    }
 
-    case NC_UBYTE: {
-        unsigned char *data = new unsigned char[d_nelements];
-        d_a->buf2val((void**) &data);
-        stax = nc_put_var_uchar(ncid, _varid, data);
-        delete[] data;
-
-        if (stax != NC_NOERR) {
-            string err = "fileout.netcdf - Failed to create array of bytes for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_UBYTE:
+        write_direct<unsigned char>(ncid, nc_put_vara_uchar, "bytes");
         break;
-    }
-
-    case NC_SHORT: {
-
-        short *data = new short[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_short(ncid, _varid, data);
-        delete[] data;
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of shorts for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_SHORT:
+        write_direct<short>(ncid, nc_put_vara_short, "shorts");
         break;
-    }
-
-    case NC_INT: {
-
-        int *data = new int[d_nelements];
-        d_a->buf2val((void**) &data);
-
-        int stax = nc_put_var_int(ncid, _varid, data);
-        delete[] data;
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of ints for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_INT:
+        write_direct<int>(ncid, nc_put_vara_int, "ints");
         break;
-    }
 
-    case NC_INT64: {
+    case NC_INT64:
+        write_direct<long long>(ncid, nc_put_vara_longlong, "ints");
+        break;
 
-        int64_t *data = new int64_t[d_nelements];
-        d_a->buf2val((void**) &data);
+    case NC_FLOAT:
+        write_direct<float>(ncid, nc_put_vara_float, "floats");
+        break;
 
-        int stax = nc_put_var_longlong(ncid, _varid, (const long long*)data);
-        delete[] data;
+    case NC_DOUBLE:
+        write_direct<double>(ncid, nc_put_vara_double, "doubles");
+        break;
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of ints for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_USHORT:
+        write_direct<unsigned short>(ncid, nc_put_vara_ushort, "unsigned short");
         break;
-    }
 
-    case NC_FLOAT: {
-        float *data = new float[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_float(ncid, _varid, data);
-        delete[] data;
+    case NC_UINT:
+        write_direct<unsigned int>(ncid, nc_put_vara_uint, "unsigned int");
+        break;
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of floats for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
+    case NC_UINT64:
+        write_direct<unsigned long long>(ncid, nc_put_vara_ulonglong, "unsigned int");
         break;
+
+    default:
+        string err = (string) "Failed to transform array of unknown type in file out netcdf";
+        throw BESInternalError(err, __FILE__, __LINE__);
     }
 
-    case NC_DOUBLE: {
-        double *data = new double[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_double(ncid, _varid, data);
-        delete[] data;
+}
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of doubles for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
-        break;
+/** @brief Write the array's values straight from the DAP Array's buffer
+ *
+ * Used when the netCDF type has the same size and representation as the
+ * DAP type, so the values need not be copied.
+ *
+ * @param ncid The id of the netcdf file
+ * @param put_vara The nc_put_vara_*() function for the type
+ * @param type_desc Used in the error message
+ */
+template<typename T>
+void FONcArray::write_direct(int ncid, int (*put_vara)(int, int, const size_t *, const size_t *, const T *),
+    const string &type_desc)
+{
+    if (d_nelements == 0)
+        return;
+
+    vector<size_t> start(d_ndims, 0);
+    int stax = put_vara(ncid, _varid, &start[0], &d_dim_sizes[0], reinterpret_cast<const T*>(d_a->get_buf()));
+    if (stax != NC_NOERR) {
+        string err = (string) "fileout.netcdf - Failed to create array of " + type_desc + " for " + _varname;
+        FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
     }
+}
 
-    case NC_USHORT: {
-        unsigned short *data = new unsigned short[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_ushort(ncid, _varid, data);
-        delete[] data;
+/** @brief Write the array's values, widening them from From to To
+ *
+ * The values are converted and written in slabs of whole rows of the
+ * outermost dimension, so the conversion buffer is no larger than
+ * FONc.WriteBufferSize (or one row, if a row is bigger than that).
+ *
+ * @param ncid The id of the netcdf file
+ * @param put_vara The nc_put_vara_*() function for To
+ * @param type_desc Used in the error message
+ */
+template<typename From, typename To>
+void FONcArray::write_converted(int ncid, int (*put_vara)(int, int, const size_t *, const size_t *, const To *),
+    const string &type_desc)
+{
+    if (d_nelements == 0)
+        return;
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of unsigned short for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
-        break;
-    }
+    const size_t rows = d_dim_sizes[0];
+    const size_t row_len = d_nelements / rows;
+    const size_t max_bytes = (size_t) FONcRequestHandler::write_buffer_size * 1024;
+    const size_t slab_rows = max((size_t) 1, min(rows, max_bytes / (row_len * sizeof(To))));
 
-    case NC_UINT: {
-        unsigned int *data = new unsigned int[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_uint(ncid, _varid, data);
-        delete[] data;
+    BESDEBUG("fonc", "FONcArray::write_converted() - " << _varname << ": " << slab_rows << " of " << rows
+        << " rows at a time" << endl);
 
-        if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of unsigned int for " + _varname;
-            FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
-        }
-        break;
-    }
+    const From *values = reinterpret_cast<const From*>(d_a->get_buf());
+    vector<To> slab(slab_rows * row_len);
+
+    vector<size_t> start(d_ndims, 0);
+    vector<size_t> count(d_dim_sizes);
+    for (size_t row = 0; row < rows; row += slab_rows) {
+        count[0] = min(slab_rows, rows - row);
+        start[0] = row;
 
-    case NC_UINT64: {
-        uint64_t *data = new uint64_t[d_nelements];
-        d_a->buf2val((void**) &data);
-        int stax = nc_put_var_ulonglong(ncid, _varid, (const unsigned long long*)data);
-        delete[] data;
+        const From *in = values + row * row_len;
+        const size_t n = count[0] * row_len;
+        for (size_t i = 0; i < n; ++i)
+            slab[i] = static_cast<To>(in[i]);
 
+        int stax = put_vara(ncid, _varid, &start[0], &count[0], &slab[0]);
         if (stax != NC_NOERR) {
-            string err = (string) "fileout.netcdf - Failed to create array of unsigned int for " + _varname;
+            string err = (string) "fileout.netcdf - Failed to create array of " + type_desc + " for " + _varname;
             FONcUtils::handle_error(stax, err, __FILE__, __LINE__);
         }
-        break;
     }
-
-    default:
-        string err = (string) "Failed to transform array of unknown type in file out netcdf";
-        throw BESInternalError(err, __FILE__, __LINE__);
-    }
-
 }
 
 // This function is only used for handling _FillValue. TODO: review all cases and generalize it.
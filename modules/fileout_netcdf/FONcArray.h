@@ -102,6 +102,13 @@ private:
 
     void write_for_nc4_types(int ncid);
 
+    template<typename T>
+    void write_direct(int ncid, int (*put_vara)(int, int, const size_t *, const size_t *, const T *),
+        const std::string &type_desc);
+    template<typename From, typename To>
+    void write_converted(int ncid, int (*put_vara)(int, int, const size_t *, const size_t *, const To *),
+        const std::string &type_desc);
+
 public:
     FONcArray(libdap::BaseType *b);
     FONcArray(libdap::BaseType *b,const std::vector<int>&dim_ids,const std::vector<bool>&use_dim_ids,const std::vector<int>&rbs_nums);
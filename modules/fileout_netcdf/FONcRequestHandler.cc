@@ -67,12 +67,20 @@
 #define FONC_NO_GLOBAL_ATTRS false
 #define FONC_NO_GLOBAL_ATTRS_KEY "FONc.NoGlobalAttrs"
 
+#define FONC_STREAM_NETCDF3 false
+#define FONC_STREAM_NETCDF3_KEY "FONc.StreamNetCDF3"
+
+#define FONC_WRITE_BUFFER_SIZE 16384
+#define FONC_WRITE_BUFFER_SIZE_KEY "FONc.WriteBufferSize"
+
 std::string FONcRequestHandler::temp_dir;
 bool FONcRequestHandler::byte_to_short;
 bool FONcRequestHandler::use_compression;
 int FONcRequestHandler::chunk_size;
 bool FONcRequestHandler::classic_model;
 bool FONcRequestHandler::no_global_attrs;
+bool FONcRequestHandler::stream_netcdf3;
+int FONcRequestHandler::write_buffer_size;
 
 using namespace std;
 
@@ -122,7 +130,7 @@ static void read_key_value(const string &key_name, int &key, const int default_v
     if (key_found) {
         istringstream iss(value);
         iss >> key;
-        if (iss.eof() || iss.bad() || iss.fail()) key = default_value;
+        if (iss.bad() || iss.fail()) key = default_value;
     }
     else {
         key = default_value;
@@ -159,12 +167,18 @@ FONcRequestHandler::FONcRequestHandler( const string &name )
 
     read_key_value(FONC_NO_GLOBAL_ATTRS_KEY, FONcRequestHandler::no_global_attrs, FONC_NO_GLOBAL_ATTRS);
 
+    read_key_value(FONC_STREAM_NETCDF3_KEY, FONcRequestHandler::stream_netcdf3, FONC_STREAM_NETCDF3);
+
+    read_key_value(FONC_WRITE_BUFFER_SIZE_KEY, FONcRequestHandler::write_buffer_size, FONC_WRITE_BUFFER_SIZE);
+
     BESDEBUG("fonc", "FONcRequestHandler::temp_dir: " << FONcRequestHandler::temp_dir << endl);
     BESDEBUG("fonc", "FONcRequestHandler::byte_to_short: " << FONcRequestHandler::byte_to_short << endl);
     BESDEBUG("fonc", "FONcRequestHandler::use_compression: " << FONcRequestHandler::use_compression << endl);
     BESDEBUG("fonc", "FONcRequestHandler::chunk_size: " << FONcRequestHandler::chunk_size << endl);
     BESDEBUG("fonc", "FONcRequestHandler::classic_model: " << FONcRequestHandler::classic_model << endl);
     BESDEBUG("fonc", "FONcRequestHandler::turn_off_global_attrs: " << FONcRequestHandler::no_global_attrs << endl);
+    BESDEBUG("fonc", "FONcRequestHandler::stream_netcdf3: " << FONcRequestHandler::stream_netcdf3 << endl);
+    BESDEBUG("fonc", "FONcRequestHandler::write_buffer_size: " << FONcRequestHandler::write_buffer_size << endl);
 }
 
 /** @brief Any cleanup that needs to take place
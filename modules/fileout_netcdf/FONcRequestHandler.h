@@ -55,6 +55,8 @@ public:
     static int chunk_size;
     static bool classic_model;
     static bool no_global_attrs;
+    static bool stream_netcdf3;
+    static int write_buffer_size;
 
     static bool build_help(BESDataHandlerInterface &dhi);
     static bool build_version(BESDataHandlerInterface &dhi);
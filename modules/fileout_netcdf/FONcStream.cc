@@ -0,0 +1,299 @@
+// FONcStream.cc
+
+// This file is part of BES Netcdf File Out Module
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <netcdf.h>
+
+#include <BESUtil.h>
+#include <BESDebug.h>
+#include <BESInternalError.h>
+
+#include "FONcStream.h"
+#include "FONcUtils.h"
+
+using namespace std;
+
+#define prolog string("FONcStream::").append(__func__).append("() - ")
+
+namespace {
+
+// The tags used in the header of a netCDF-3 file
+const unsigned int NC_DIMENSION_TAG = 0x0A;
+const unsigned int NC_VARIABLE_TAG = 0x0B;
+const unsigned int NC_ATTRIBUTE_TAG = 0x0C;
+
+/**
+ * Read the header of a netCDF-3 file. The header is big-endian and every
+ * item in it is padded to four bytes.
+ */
+class HeaderReader {
+private:
+    int d_fd;
+    size_t d_pos;
+    vector<unsigned char> d_buf;
+
+    const unsigned char *get(size_t n)
+    {
+        while (d_buf.size() < d_pos + n) {
+            size_t have = d_buf.size();
+            d_buf.resize(have + max(n, (size_t) 65536));
+            ssize_t bytes = pread(d_fd, &d_buf[have], d_buf.size() - have, have);
+            if (bytes <= 0)
+                throw BESInternalError("File out netcdf, the netCDF header is truncated", __FILE__, __LINE__);
+            d_buf.resize(have + bytes);
+        }
+
+        const unsigned char *p = &d_buf[d_pos];
+        d_pos += n;
+        return p;
+    }
+
+public:
+    explicit HeaderReader(int fd) : d_fd(fd), d_pos(0) { }
+
+    unsigned int u8() { return *get(1); }
+
+    unsigned int u32()
+    {
+        const unsigned char *p = get(4);
+        return ((unsigned int) p[0] << 24) | ((unsigned int) p[1] << 16) | ((unsigned int) p[2] << 8) | p[3];
+    }
+
+    unsigned long long u64()
+    {
+        unsigned long long hi = u32();
+        return (hi << 32) | u32();
+    }
+
+    void skip(unsigned long long n) { get((n + 3) & ~3ULL); }
+
+    void skip_name() { skip(u32()); }
+
+    // Skip an attribute list (the header's global attributes or a variable's)
+    void skip_attributes()
+    {
+        unsigned int tag = u32();
+        unsigned int nattrs = u32();
+        if (tag != NC_ATTRIBUTE_TAG && (tag != 0 || nattrs != 0))
+            throw BESInternalError("File out netcdf, unexpected attribute list in the netCDF header", __FILE__, __LINE__);
+
+        for (unsigned int i = 0; i < nattrs; ++i) {
+            skip_name();
+            unsigned int type = u32();
+            unsigned long long nelems = u32();
+            switch (type) {
+            case NC_BYTE:
+            case NC_CHAR:
+                skip(nelems);
+                break;
+            case NC_SHORT:
+                skip(nelems * 2);
+                break;
+            case NC_INT:
+            case NC_FLOAT:
+                skip(nelems * 4);
+                break;
+            case NC_DOUBLE:
+                skip(nelems * 8);
+                break;
+            default:
+                throw BESInternalError("File out netcdf, unknown attribute type in the netCDF header", __FILE__, __LINE__);
+            }
+        }
+    }
+};
+
+} // namespace
+
+FONcStream::FONcStream(int fd, ostream &strm) :
+    _fd(fd), _strm(strm), _started(false), _sent(0)
+{
+}
+
+/**
+ * Find where each variable's data are from the file's header.
+ * @return False if the file can't be sent before it's closed.
+ */
+bool FONcStream::read_layout()
+{
+    HeaderReader hdr(_fd);
+
+    if (hdr.u8() != 'C' || hdr.u8() != 'D' || hdr.u8() != 'F')
+        return false;
+
+    // Only the classic (1) and 64-bit offset (2) formats
+    unsigned int version = hdr.u8();
+    if (version != 1 && version != 2)
+        return false;
+
+    (void) hdr.u32();   // numrecs
+
+    vector<unsigned int> dim_len;
+    unsigned int tag = hdr.u32();
+    unsigned int ndims = hdr.u32();
+    if (tag != NC_DIMENSION_TAG && (tag != 0 || ndims != 0))
+        return false;
+    for (unsigned int i = 0; i < ndims; ++i) {
+        hdr.skip_name();
+        dim_len.push_back(hdr.u32());
+    }
+
+    hdr.skip_attributes();
+
+    tag = hdr.u32();
+    unsigned int nvars = hdr.u32();
+    if (tag != NC_VARIABLE_TAG && (tag != 0 || nvars != 0))
+        return false;
+
+    vector<off_t> begin;
+    vector<unsigned long long> vsize;
+    for (unsigned int i = 0; i < nvars; ++i) {
+        hdr.skip_name();
+        unsigned int rank = hdr.u32();
+        for (unsigned int d = 0; d < rank; ++d) {
+            unsigned int dimid = hdr.u32();
+            // A record variable; numrecs and the record data change as the file is written
+            if (dimid >= dim_len.size() || dim_len[dimid] == 0)
+                return false;
+        }
+        hdr.skip_attributes();
+        (void) hdr.u32();   // nc_type
+        vsize.push_back(hdr.u32());
+        begin.push_back(version == 1 ? hdr.u32() : hdr.u64());
+    }
+
+    // The variables' data follow one another in the order they were defined;
+    // each one ends where the next begins.
+    _var_end.clear();
+    for (unsigned int i = 0; i < nvars; ++i) {
+        if (i + 1 < nvars) {
+            if (begin[i + 1] < begin[i])
+                return false;
+            _var_end.push_back(begin[i + 1]);
+        }
+        else if (vsize[i] == 0xFFFFFFFFULL) {
+            // Too big for vsize; only possible for the last variable
+            _var_end.push_back(-1);
+        }
+        else {
+            _var_end.push_back(begin[i] + vsize[i]);
+        }
+    }
+
+    // The header
+    _var_end.insert(_var_end.begin(), nvars ? begin[0] : 0);
+
+    return true;
+}
+
+// Send the file up to (but not including) 'end', or as much of it as
+// exists, and free the disk space it used.
+void FONcStream::send_through(off_t end)
+{
+    struct stat sb;
+    if (fstat(_fd, &sb) != 0)
+        throw BESInternalError("File out netcdf, could not stat the temporary file", __FILE__, __LINE__);
+
+    if (end < 0 || end > sb.st_size)
+        end = sb.st_size;
+    if (end <= _sent)
+        return;
+
+    BESDEBUG("fonc", prolog << "Sending bytes " << _sent << " to " << end << endl);
+    BESUtil::file_to_stream(_fd, _sent, end - _sent, _strm);
+
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+    // The library may read those blocks back, but only to rewrite data
+    // that have already been sent, so they can be dropped.
+    (void) fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, _sent, end - _sent);
+#endif
+
+    _sent = end;
+}
+
+/**
+ * @brief Send the header
+ *
+ * Call this after nc_enddef(). If the file is not a netCDF-3 file that can
+ * be streamed, nothing is sent until finish() is called.
+ *
+ * @param ncid The file being written
+ */
+void FONcStream::start(int ncid)
+{
+    int stax = nc_sync(ncid);
+    if (stax != NC_NOERR)
+        FONcUtils::handle_error(stax, "File out netcdf, unable to sync the file", __FILE__, __LINE__);
+
+    try {
+        if (!read_layout()) {
+            BESDEBUG("fonc", prolog << "This file cannot be streamed" << endl);
+            return;
+        }
+    }
+    catch (BESError &e) {
+        BESDEBUG("fonc", prolog << "This file cannot be streamed: " << e.get_message() << endl);
+        return;
+    }
+
+    _started = true;
+    send_through(_var_end[0]);
+}
+
+/**
+ * @brief Send the variables that have been written
+ *
+ * @param ncid The file being written
+ * @param nvars The variables with varids less than this have been written
+ */
+void FONcStream::vars_written(int ncid, int nvars)
+{
+    if (!_started || nvars <= 0)
+        return;
+
+    int stax = nc_sync(ncid);
+    if (stax != NC_NOERR)
+        FONcUtils::handle_error(stax, "File out netcdf, unable to sync the file", __FILE__, __LINE__);
+
+    send_through(_var_end[min((size_t) nvars, _var_end.size() - 1)]);
+}
+
+/**
+ * @brief Send the rest of the file
+ *
+ * Call this once the file has been closed.
+ */
+void FONcStream::finish()
+{
+    send_through(-1);
+}
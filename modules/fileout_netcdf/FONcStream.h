@@ -0,0 +1,78 @@
+// FONcStream.h
+
+// This file is part of BES Netcdf File Out Module
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef FONcStream_h_
+#define FONcStream_h_ 1
+
+#include <sys/types.h>
+
+#include <ostream>
+#include <vector>
+
+/** @brief Send a netCDF-3 response while it is being written
+ *
+ * A netCDF-3 file with no record variables is laid out as the header
+ * followed by the data of each variable, in the order the variables were
+ * defined. Once nc_enddef() has been called the header does not change,
+ * and once a variable has been written its data do not change. So the
+ * file can be sent as it's built: the header right after nc_enddef() and
+ * each variable once it and all of the variables before it are written.
+ * The client starts getting the response at once and the parts of the
+ * temporary file that have been sent are released (on Linux), so the file
+ * never takes up much disk space.
+ *
+ * FONcTransform calls start() after nc_enddef() and vars_written() as it
+ * writes the variables; the transmitter calls finish() after the file is
+ * closed to send whatever is left. Files that can't be sent this way
+ * (netCDF-4, record variables) are sent by finish().
+ *
+ * @note Once part of the response has been sent, an error can no longer
+ * replace it; the client gets a truncated file followed by the error.
+ */
+class FONcStream {
+private:
+    int _fd;
+    std::ostream &_strm;
+    bool _started;
+    off_t _sent;                    // bytes of the file sent so far
+    std::vector<off_t> _var_end;    // the end of each variable's data, by varid
+
+    FONcStream(const FONcStream &);
+    FONcStream &operator=(const FONcStream &);
+
+    bool read_layout();
+    void send_through(off_t end);
+
+public:
+    FONcStream(int fd, std::ostream &strm);
+    virtual ~FONcStream() { }
+
+    void start(int ncid);
+    void vars_written(int ncid, int nvars);
+    void finish();
+
+    /// @brief True if part of the file was sent before it was closed
+    bool started() const { return _started; }
+};
+
+#endif // FONcStream_h_
@@ -43,6 +43,7 @@ using std::istringstream;
 #include "FONcUtils.h"
 #include "FONcBaseType.h"
 #include "FONcAttributes.h"
+#include "FONcStream.h"
 
 #include <DDS.h>
 #include <DMR.h>
@@ -69,7 +70,7 @@ using std::istringstream;
  * file is not specified or failed to create the netcdf file
  */
 FONcTransform::FONcTransform(DDS *dds, BESDataHandlerInterface &dhi, const string &localfile, const string &ncVersion) :
-        _ncid(0), _dds(0)
+        _ncid(0), _dds(0), _dmr(0), _stream(0)
 {
     if (!dds) {
         string s = (string) "File out netcdf, " + "null DDS passed to constructor";
@@ -109,7 +110,7 @@ FONcTransform::FONcTransform(DDS *dds, BESDataHandlerInterface &dhi, const strin
  * file is not specified or failed to create the netcdf file
  */
 FONcTransform::FONcTransform(DMR *dmr, BESDataHandlerInterface &dhi, const string &localfile, const string &ncVersion) :
-        _ncid(0), _dmr(0)
+        _ncid(0), _dds(0), _dmr(0), _stream(0)
 {
     if (!dmr) {
         string s = (string) "File out netcdf, " + "null DDS passed to constructor";
@@ -244,6 +245,11 @@ void FONcTransform::transform()
         // adding attributes. To do this we must be in define mode.
         nc_redef(_ncid);
 
+        // Send a netCDF-3 file as it's written. FONcStream::start() works
+        // out if the file can be streamed.
+        bool streaming = _stream && FONcTransform::_returnAs != RETURNAS_NETCDF4;
+        vector<int> nvars_defined;
+
         // For each converted FONc object, call define on it to define
         // that object to the netcdf file. This also adds the attributes
         // for the variables to the netcdf file
@@ -253,6 +259,11 @@ void FONcTransform::transform()
             FONcBaseType *fbt = *i;
             BESDEBUG("fonc", "FONcTransform::transform() - Defining variable:  " << fbt->name() << endl);
             fbt->define(_ncid);
+
+            // Note how many variables are defined so far; see below.
+            int nvars = 0;
+            if (streaming) nc_inq_nvars(_ncid, &nvars);
+            nvars_defined.push_back(nvars);
         }
 
         if(FONcRequestHandler::no_global_attrs == false) {
@@ -275,13 +286,19 @@ void FONcTransform::transform()
             FONcUtils::handle_error(stax, "File out netcdf, unable to end the define mode: " + _localfile, __FILE__, __LINE__);
         }
 
+        if (streaming) _stream->start(_ncid);
+
         // Write everything out
         i = _fonc_vars.begin();
         e = _fonc_vars.end();
-        for (; i != e; i++) {
+        for (vector<int>::size_type n = 0; i != e; i++, n++) {
             FONcBaseType *fbt = *i;
             BESDEBUG("fonc", "FONcTransform::transform() - Writing data for variable:  " << fbt->name() << endl);
             fbt->write(_ncid);
+
+            // Each variable writes the netCDF variables it defined, so those
+            // defined by this and the ones before it are now complete.
+            if (streaming) _stream->vars_written(_ncid, nvars_defined[n]);
         }
 
         stax = nc_close(_ncid);
@@ -518,6 +535,11 @@ void FONcTransform::transform_dap4_no_group() {
         // adding attributes. To do this we must be in define mode.
         nc_redef(_ncid);
 
+        // Send a netCDF-3 file as it's written. FONcStream::start() works
+        // out if the file can be streamed.
+        bool streaming = _stream && FONcTransform::_returnAs != RETURNAS_NETCDF4;
+        vector<int> nvars_defined;
+
         // For each converted FONc object, call define on it to define
         // that object to the netcdf file. This also adds the attributes
         // for the variables to the netcdf file
@@ -528,6 +550,11 @@ void FONcTransform::transform_dap4_no_group() {
             BESDEBUG("fonc", "FONcTransform::transform_dap4_no_group() - Defining variable:  " << fbt->name() << endl);
             fbt->set_is_dap4(true);
             fbt->define(_ncid);
+
+            // Note how many variables are defined so far; see below.
+            int nvars = 0;
+            if (streaming) nc_inq_nvars(_ncid, &nvars);
+            nvars_defined.push_back(nvars);
         }
 
         if(FONcRequestHandler::no_global_attrs == false) {
@@ -559,13 +586,19 @@ void FONcTransform::transform_dap4_no_group() {
             FONcUtils::handle_error(stax, "File out netcdf, unable to end the define mode: " + _localfile, __FILE__, __LINE__);
         }
 
+        if (streaming) _stream->start(_ncid);
+
         // Write everything out
         i = _fonc_vars.begin();
         e = _fonc_vars.end();
-        for (; i != e; i++) {
+        for (vector<int>::size_type n = 0; i != e; i++, n++) {
             FONcBaseType *fbt = *i;
             BESDEBUG("fonc", "FONcTransform::transform_dap4_no_group() - Writing data for variable:  " << fbt->name() << endl);
             fbt->write(_ncid);
+
+            // Each variable writes the netCDF variables it defined, so those
+            // defined by this and the ones before it are now complete.
+            if (streaming) _stream->vars_written(_ncid, nvars_defined[n]);
         }
 
         stax = nc_close(_ncid);
@@ -49,6 +49,7 @@ using namespace::libdap ;
 #include <BESDataHandlerInterface.h>
 
 class FONcBaseType ;
+class FONcStream ;
 
 /** @brief Transformation object that converts an OPeNDAP DataDDS to a
  * netcdf file
@@ -69,6 +70,7 @@ private:
     set<string> _included_grp_names;
     map<string,unsigned long> GFQN_dimname_to_dimsize;
     map<string,unsigned long> VFQN_dimname_to_dimsize;
+    FONcStream *_stream;
     
 
 public:
@@ -88,6 +90,9 @@ public:
 	virtual void transform();
 	virtual void transform_dap4();
 
+	/// @brief Send a netCDF-3 file as it's written; see FONcStream
+	void set_stream(FONcStream *stream) { _stream = stream; }
+
 
 	virtual void dump(ostream &strm) const;
 private:
@@ -75,14 +75,11 @@
 #include "FONcRequestHandler.h"
 #include "FONcTransmitter.h"
 #include "FONcTransform.h"
+#include "FONcStream.h"
 
 using namespace libdap;
 using namespace std;
 
-// size of the buffer used to read from the temporary file built on disk and
-// send data to the client over the network connection (socket/stream)
-#define OUTPUT_FILE_BLOCK_SIZE 4096
-
 /** @brief Construct the FONcTransmitter, adding it with name netcdf to be
  * able to transmit a data response
  *
@@ -384,15 +381,20 @@ void FONcTransmitter::send_data(BESResponseObject *obj, BESDataHandlerInterface
         BESDEBUG("fonc", "FONcTransmitter::send_data - Building response file " << temp_file.get_name() << endl);
         // Note that 'RETURN_CMD' is the same as the string that determines the file type:
         // netcdf 3 or netcdf 4. Hack. jhrg 9/7/16
-        FONcTransform ft(loaded_dds, dhi, temp_file.get_name(), dhi.data[RETURN_CMD]);
-        ft.transform();
-
         ostream &strm = dhi.get_output_stream();
         if (!strm) throw BESInternalError("Output stream is not set, can not return as", __FILE__, __LINE__);
 
+        FONcTransform ft(loaded_dds, dhi, temp_file.get_name(), dhi.data[RETURN_CMD]);
+        FONcStream stream(temp_file.get_fd(), strm);
+        if (FONcRequestHandler::stream_netcdf3) ft.set_stream(&stream);
+        ft.transform();
+
         BESDEBUG("fonc", "FONcTransmitter::send_data - Transmitting temp file " << temp_file.get_name() << endl);
 
-        FONcTransmitter::write_temp_file_to_stream(temp_file.get_fd(), strm); //, loaded_dds->filename(), ncVersion);
+        if (stream.started())
+            stream.finish();
+        else
+            FONcTransmitter::write_temp_file_to_stream(temp_file.get_fd(), strm); //, loaded_dds->filename(), ncVersion);
     }
     catch (Error &e) {
         throw BESDapError("Failed to read data: " + e.get_error_message(), false, e.get_error_code(), __FILE__, __LINE__);
@@ -493,17 +495,22 @@ void FONcTransmitter::send_dap4_data(BESResponseObject *obj, BESDataHandlerInter
         BESDEBUG("fonc", "FONcTransmitter::send_dap4_data - Building response file " << temp_file.get_name() << endl);
         // Note that 'RETURN_CMD' is the same as the string that determines the file type:
         // netcdf 3 or netcdf 4. Hack. jhrg 9/7/16
+        ostream &strm = dhi.get_output_stream();
+        if (!strm) throw BESInternalError("Output stream is not set, can not return as", __FILE__, __LINE__);
+
         FONcTransform ft(loaded_dmr, dhi, temp_file.get_name(), dhi.data[RETURN_CMD]);
+        FONcStream stream(temp_file.get_fd(), strm);
+        if (FONcRequestHandler::stream_netcdf3) ft.set_stream(&stream);
 
         // Call the transform function for DAP4.
         ft.transform_dap4();
 
-        ostream &strm = dhi.get_output_stream();
-        if (!strm) throw BESInternalError("Output stream is not set, can not return as", __FILE__, __LINE__);
-
         BESDEBUG("fonc", "FONcTransmitter::send_dap4_data - Transmitting temp file " << temp_file.get_name() << endl);
 
-        FONcTransmitter::write_temp_file_to_stream(temp_file.get_fd(), strm); //, loaded_dds->filename(), ncVersion);
+        if (stream.started())
+            stream.finish();
+        else
+            FONcTransmitter::write_temp_file_to_stream(temp_file.get_fd(), strm); //, loaded_dds->filename(), ncVersion);
     }
     catch (Error &e) {
         throw BESDapError("Failed to read data: " + e.get_error_message(), false, e.get_error_code(), __FILE__, __LINE__);
@@ -533,12 +540,7 @@ void FONcTransmitter::send_dap4_data(BESResponseObject *obj, BESDataHandlerInter
  */
 void FONcTransmitter::write_temp_file_to_stream(int fd, ostream &strm) //, const string &filename, const string &ncVersion)
 {
-    char block[OUTPUT_FILE_BLOCK_SIZE];
-
-    int nbytes = read(fd, block, sizeof block);
-    while (nbytes > 0) {
-        strm.write(block, nbytes /*os.gcount()*/);
-        nbytes = read(fd, block, sizeof block);
-    }
+    // Uses sendfile() when strm is the PPT connection to the front end
+    BESUtil::file_to_stream(fd, strm);
 }
 
@@ -0,0 +1,260 @@
+// FONcArrayTest.cc
+
+// This file is part of BES Netcdf File Out Module
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <netcdf.h>
+
+#include <Array.h>
+#include <Byte.h>
+#include <Int16.h>
+#include <UInt16.h>
+
+#include <GetOpt.h>
+
+#include "FONcArray.h"
+#include "FONcRequestHandler.h"
+#include "FONcUtils.h"
+
+#include "test_config.h"
+
+using namespace std;
+using namespace libdap;
+
+static bool debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+class FONcArrayTest: public CppUnit::TestFixture {
+private:
+    string d_tmpDir;
+    int d_write_buffer_size;
+
+    static void check(int stax)
+    {
+        CPPUNIT_ASSERT_MESSAGE(nc_strerror(stax), stax == NC_NOERR);
+    }
+
+    /**
+     * Write 'values' to a netCDF-3 file as a DAP Array of DAP_T with the
+     * dimensions 'dims', using FONcArray the way FONcTransform does, and
+     * read them back. The variable's netCDF type must be 'expected_type'.
+     */
+    template<class DAP_T, typename From, typename To>
+    vector<To> write_and_read(vector<From> values, const vector<int> &dims, nc_type expected_type,
+        int (*get_var)(int, int, To *))
+    {
+        DAP_T tmpl("v");
+        Array a("v", &tmpl);
+        for (vector<int>::size_type i = 0; i < dims.size(); ++i)
+            a.append_dim(dims[i], string("dim") + char('0' + i));
+        a.set_value(values, values.size());
+
+        FONcUtils::reset();
+        FONcArray fa(&a);
+        fa.setVersion(RETURNAS_NETCDF);
+        fa.convert(vector<string>());
+
+        int ncid;
+        check(nc_create((d_tmpDir + "/array.nc").c_str(), NC_CLOBBER, &ncid));
+        fa.define(ncid);
+        check(nc_enddef(ncid));
+        fa.write(ncid);
+
+        nc_type type;
+        check(nc_inq_vartype(ncid, 0, &type));
+        CPPUNIT_ASSERT_EQUAL(expected_type, type);
+
+        vector<To> result(values.size());
+        check(get_var(ncid, 0, &result[0]));
+        check(nc_close(ncid));
+
+        return result;
+    }
+
+    template<typename From, typename To>
+    static void check_values(const vector<From> &values, const vector<To> &result)
+    {
+        CPPUNIT_ASSERT_EQUAL(values.size(), result.size());
+        for (typename vector<From>::size_type i = 0; i < values.size(); ++i)
+            CPPUNIT_ASSERT_EQUAL(static_cast<To>(values[i]), result[i]);
+    }
+
+public:
+    FONcArrayTest() :
+        d_tmpDir(string(TEST_BUILD_DIR) + "/tmp"), d_write_buffer_size(0)
+    {
+    }
+
+    ~FONcArrayTest()
+    {
+    }
+
+    // FONc.WriteBufferSize is in KBytes; one KByte holds 512 shorts or 256
+    // ints, so the arrays below are converted and written in several slabs.
+    void setUp()
+    {
+        d_write_buffer_size = FONcRequestHandler::write_buffer_size;
+        FONcRequestHandler::write_buffer_size = 1;
+    }
+
+    void tearDown()
+    {
+        FONcRequestHandler::write_buffer_size = d_write_buffer_size;
+        FONcUtils::reset();
+    }
+
+CPPUNIT_TEST_SUITE( FONcArrayTest );
+
+    CPPUNIT_TEST(byte_to_short_test);
+    CPPUNIT_TEST(byte_to_short_rank1_test);
+    CPPUNIT_TEST(uint16_to_int_test);
+    CPPUNIT_TEST(uint16_to_int_wide_row_test);
+    CPPUNIT_TEST(int16_direct_test);
+
+    CPPUNIT_TEST_SUITE_END()
+    ;
+
+    // Rows of 200 bytes once widened: slabs of 5 rows, then the last 2
+    void byte_to_short_test()
+    {
+        vector<dods_byte> values(7 * 100);
+        for (vector<dods_byte>::size_type i = 0; i < values.size(); ++i)
+            values[i] = i % 256;
+
+        vector<int> dims;
+        dims.push_back(7);
+        dims.push_back(100);
+
+        check_values(values, write_and_read<Byte>(values, dims, NC_SHORT, nc_get_var_short));
+    }
+
+    // One value per row: slabs of 512, 512 and 476 values
+    void byte_to_short_rank1_test()
+    {
+        vector<dods_byte> values(1500);
+        for (vector<dods_byte>::size_type i = 0; i < values.size(); ++i)
+            values[i] = 255 - i % 256;
+
+        vector<int> dims(1, 1500);
+
+        check_values(values, write_and_read<Byte>(values, dims, NC_SHORT, nc_get_var_short));
+    }
+
+    // Rows of 200 bytes once widened: slabs of 5 rows, then the last 4
+    void uint16_to_int_test()
+    {
+        vector<dods_uint16> values(9 * 50);
+        for (vector<dods_uint16>::size_type i = 0; i < values.size(); ++i)
+            values[i] = (i * 1499) % 65536;
+
+        vector<int> dims;
+        dims.push_back(9);
+        dims.push_back(50);
+
+        check_values(values, write_and_read<UInt16>(values, dims, NC_INT, nc_get_var_int));
+    }
+
+    // A row (1200 bytes once widened) is bigger than the buffer, so the
+    // values are written one row at a time.
+    void uint16_to_int_wide_row_test()
+    {
+        vector<dods_uint16> values(3 * 300);
+        for (vector<dods_uint16>::size_type i = 0; i < values.size(); ++i)
+            values[i] = 65535 - i * 71;
+
+        vector<int> dims;
+        dims.push_back(3);
+        dims.push_back(300);
+
+        check_values(values, write_and_read<UInt16>(values, dims, NC_INT, nc_get_var_int));
+    }
+
+    // The same type in DAP and netCDF; written from the Array's buffer
+    void int16_direct_test()
+    {
+        vector<dods_int16> values(7 * 100);
+        for (vector<dods_int16>::size_type i = 0; i < values.size(); ++i)
+            values[i] = i * 7 - 2000;
+
+        vector<int> dims;
+        dims.push_back(7);
+        dims.push_back(100);
+
+        check_values(values, write_and_read<Int16>(values, dims, NC_SHORT, nc_get_var_short));
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FONcArrayTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dh");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: FONcArrayTest has the following tests:" << endl;
+            const std::vector<CppUnit::Test*> &tests = FONcArrayTest::suite()->getTests();
+            unsigned int prefix_len = FONcArrayTest::suite()->getName().append("::").length();
+            for (std::vector<CppUnit::Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = FONcArrayTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
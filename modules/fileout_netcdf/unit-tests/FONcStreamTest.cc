@@ -0,0 +1,377 @@
+// FONcStreamTest.cc
+
+// This file is part of BES Netcdf File Out Module
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <netcdf.h>
+
+#include <GetOpt.h>
+
+#include "FONcStream.h"
+
+#include "test_config.h"
+
+using namespace std;
+
+static bool debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+class FONcStreamTest: public CppUnit::TestFixture {
+private:
+    string d_tmpDir;
+
+    static void check(int stax)
+    {
+        CPPUNIT_ASSERT_MESSAGE(nc_strerror(stax), stax == NC_NOERR);
+    }
+
+    static string read_file(const string &name)
+    {
+        ifstream is(name.c_str(), ios::binary);
+        CPPUNIT_ASSERT(is);
+        ostringstream oss;
+        oss << is.rdbuf();
+        return oss.str();
+    }
+
+    /**
+     * Write a small netCDF-3 file with three fixed-size variables and, if
+     * 'record' is true, a record variable. If 'strm' is not null the file
+     * is sent to it with FONcStream as it is written, the way FONcTransform
+     * and FONcTransmitter do it, and 'sent' gets the number of bytes sent
+     * after start() and after each call to vars_written().
+     */
+    void write_file(const string &name, int cmode, bool record, ostringstream *strm = 0, bool *started = 0,
+        vector<string::size_type> *sent = 0)
+    {
+        int ncid;
+        check(nc_create(name.c_str(), cmode | NC_CLOBBER, &ncid));
+
+        int x, y, z, time;
+        check(nc_def_dim(ncid, "x", 10, &x));
+        check(nc_def_dim(ncid, "y", 3, &y));
+        check(nc_def_dim(ncid, "z", 4, &z));
+        if (record) check(nc_def_dim(ncid, "time", NC_UNLIMITED, &time));
+
+        check(nc_put_att_text(ncid, NC_GLOBAL, "title", 10, "FONcStream"));
+
+        vector<int> varids(3);
+        check(nc_def_var(ncid, "a", NC_BYTE, 1, &x, &varids[0]));
+        check(nc_put_att_text(ncid, varids[0], "units", 1, "m"));
+        int yz[] = { y, z };
+        check(nc_def_var(ncid, "b", NC_INT, 2, yz, &varids[1]));
+        check(nc_def_var(ncid, "c", NC_DOUBLE, 1, &x, &varids[2]));
+        if (record) {
+            varids.push_back(0);
+            check(nc_def_var(ncid, "r", NC_FLOAT, 1, &time, &varids[3]));
+        }
+
+        check(nc_enddef(ncid));
+
+        int fd = open(name.c_str(), O_RDWR);
+        CPPUNIT_ASSERT(fd != -1);
+        ostringstream unused;
+        FONcStream stream(fd, strm ? *strm : unused);
+
+        if (strm) {
+            stream.start(ncid);
+            if (sent) sent->push_back(strm->str().size());
+        }
+
+        signed char a[10];
+        int b[12];
+        double c[10];
+        float r[5];
+        for (int i = 0; i < 10; ++i) {
+            a[i] = i - 5;
+            c[i] = i * 1.5;
+        }
+        for (int i = 0; i < 12; ++i)
+            b[i] = i * 1000;
+        for (int i = 0; i < 5; ++i)
+            r[i] = i / 4.0;
+
+        for (vector<int>::size_type n = 0; n < varids.size(); ++n) {
+            switch (n) {
+            case 0:
+                check(nc_put_var_schar(ncid, varids[n], a));
+                break;
+            case 1:
+                check(nc_put_var_int(ncid, varids[n], b));
+                break;
+            case 2:
+                check(nc_put_var_double(ncid, varids[n], c));
+                break;
+            default: {
+                size_t start = 0, count = 5;
+                check(nc_put_vara_float(ncid, varids[n], &start, &count, r));
+                break;
+            }
+            }
+
+            if (strm) {
+                stream.vars_written(ncid, n + 1);
+                if (sent) sent->push_back(strm->str().size());
+            }
+        }
+
+        check(nc_close(ncid));
+
+        // When the file was not streamed, finish() sends all of it, which is
+        // what FONcTransmitter::write_temp_file_to_stream() would have done.
+        if (strm) {
+            if (started) *started = stream.started();
+            stream.finish();
+        }
+
+        close(fd);
+    }
+
+    // Write the header 'header' to a file and try to stream it.
+    bool streams(const string &header, ostringstream &oss)
+    {
+        string corrupt = d_tmpDir + "/corrupt.nc";
+        ofstream os(corrupt.c_str(), ios::binary | ios::trunc);
+        os.write(header.data(), header.size());
+        os.close();
+
+        // start() syncs the file being written, so it needs a real one.
+        int ncid;
+        check(nc_create((d_tmpDir + "/target.nc").c_str(), NC_CLOBBER, &ncid));
+        check(nc_enddef(ncid));
+
+        int fd = open(corrupt.c_str(), O_RDONLY);
+        CPPUNIT_ASSERT(fd != -1);
+
+        FONcStream stream(fd, oss);
+        stream.start(ncid);
+
+        check(nc_close(ncid));
+        close(fd);
+
+        return stream.started();
+    }
+
+    void stream_test(int cmode, char version)
+    {
+        string ref_name = d_tmpDir + "/ref.nc";
+        write_file(ref_name, cmode, false);
+        string ref = read_file(ref_name);
+        CPPUNIT_ASSERT(ref.compare(0, 3, "CDF") == 0);
+        CPPUNIT_ASSERT_EQUAL(version, ref[3]);
+
+        ostringstream oss;
+        bool started = false;
+        vector<string::size_type> sent;
+        write_file(d_tmpDir + "/streamed.nc", cmode, false, &oss, &started, &sent);
+
+        CPPUNIT_ASSERT(started);
+        CPPUNIT_ASSERT_EQUAL((vector<string::size_type>::size_type) 4, sent.size());
+
+        DBG(cerr << "Header: " << sent[0] << " bytes, file: " << ref.size() << " bytes" << endl);
+
+        // The header goes out first, then each variable as it's written; by
+        // the time the last one is written, the whole file has been sent.
+        CPPUNIT_ASSERT(sent[0] > 0);
+        for (vector<string::size_type>::size_type i = 1; i < sent.size(); ++i)
+            CPPUNIT_ASSERT(sent[i] > sent[i - 1]);
+        CPPUNIT_ASSERT_EQUAL(ref.size(), sent.back());
+
+        CPPUNIT_ASSERT(oss.str() == ref);
+    }
+
+public:
+    FONcStreamTest() :
+        d_tmpDir(string(TEST_BUILD_DIR) + "/tmp")
+    {
+    }
+
+    ~FONcStreamTest()
+    {
+    }
+
+    void setUp()
+    {
+    }
+
+    void tearDown()
+    {
+    }
+
+CPPUNIT_TEST_SUITE( FONcStreamTest );
+
+    CPPUNIT_TEST(classic_test);
+    CPPUNIT_TEST(offset64_test);
+    CPPUNIT_TEST(record_variable_test);
+    CPPUNIT_TEST(truncated_header_test);
+    CPPUNIT_TEST(corrupt_header_test);
+
+    CPPUNIT_TEST_SUITE_END()
+    ;
+
+    void classic_test()
+    {
+        stream_test(0, 1);
+    }
+
+    void offset64_test()
+    {
+        stream_test(NC_64BIT_OFFSET, 2);
+    }
+
+    // A file with a record variable is not sent until it's closed
+    void record_variable_test()
+    {
+        string ref_name = d_tmpDir + "/ref.nc";
+        write_file(ref_name, 0, true);
+
+        ostringstream oss;
+        bool started = true;
+        vector<string::size_type> sent;
+        write_file(d_tmpDir + "/streamed.nc", 0, true, &oss, &started, &sent);
+
+        CPPUNIT_ASSERT(!started);
+        for (vector<string::size_type>::size_type i = 0; i < sent.size(); ++i)
+            CPPUNIT_ASSERT_EQUAL((string::size_type) 0, sent[i]);
+
+        CPPUNIT_ASSERT(oss.str() == read_file(ref_name));
+    }
+
+    void truncated_header_test()
+    {
+        ostringstream header_oss;
+        vector<string::size_type> sent;
+        write_file(d_tmpDir + "/streamed.nc", 0, false, &header_oss, 0, &sent);
+        string header = header_oss.str().substr(0, sent[0]);
+
+        string::size_type lengths[] = { 0, 3, 4, 8, 12, header.size() / 2, header.size() - 1 };
+        for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+            DBG(cerr << "Header truncated to " << lengths[i] << " bytes" << endl);
+            ostringstream oss;
+            CPPUNIT_ASSERT(!streams(header.substr(0, lengths[i]), oss));
+            CPPUNIT_ASSERT(oss.str().empty());
+        }
+
+        // The whole header does stream
+        ostringstream oss;
+        CPPUNIT_ASSERT(streams(header, oss));
+        CPPUNIT_ASSERT(oss.str() == header);
+    }
+
+    void corrupt_header_test()
+    {
+        ostringstream header_oss;
+        vector<string::size_type> sent;
+        write_file(d_tmpDir + "/streamed.nc", 0, false, &header_oss, 0, &sent);
+        const string header = header_oss.str().substr(0, sent[0]);
+
+        vector<string> bad;
+
+        string magic = header;
+        magic[2] = 'X';
+        bad.push_back(magic);
+
+        // CDF-5 (64-bit data) and an unknown version
+        string cdf5 = header;
+        cdf5[3] = 5;
+        bad.push_back(cdf5);
+        string version = header;
+        version[3] = 3;
+        bad.push_back(version);
+
+        // The variable tag where the dimension list should be
+        string dim_tag = header;
+        dim_tag[11] = 0x0B;
+        bad.push_back(dim_tag);
+
+        // A netCDF-4 (HDF5) file
+        bad.push_back(string("\x89HDF\r\n\x1a\n", 8) + header.substr(8));
+
+        for (vector<string>::size_type i = 0; i < bad.size(); ++i) {
+            DBG(cerr << "Corrupt header " << i << endl);
+            ostringstream oss;
+            CPPUNIT_ASSERT(!streams(bad[i], oss));
+            CPPUNIT_ASSERT(oss.str().empty());
+        }
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FONcStreamTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dh");
+    int option_char;
+    while ((option_char = getopt()) != -1)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: FONcStreamTest has the following tests:" << endl;
+            const std::vector<CppUnit::Test*> &tests = FONcStreamTest::suite()->getTests();
+            unsigned int prefix_len = FONcStreamTest::suite()->getName().append("::").length();
+            for (std::vector<CppUnit::Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = FONcStreamTest::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -31,6 +31,7 @@
 
 #include "ArrayAggregateOnOuterDimension.h"
 #include "AggregationException.h"
+#include "GranuleReadAhead.h"
 
 #include <DataDDS.h> // libdap::DataDDS
 #include <Marshaller.h>
@@ -179,27 +180,45 @@ bool ArrayAggregateOnOuterDimension::serialize(libdap::ConstraintEvaluator &eval
         // Keep this to do some error checking
         int nextElementIndex = 0;
 
+#if PIPELINING
+        // The granules are read ahead of the one being sent
+        GranuleReadAhead granuleReads(name(), getArrayGetterInterface(), DEBUG_CHANNEL);
+
+        try {
+            // Traverse the dataset array respecting hyperslab
+            for (int i = outerDim.start; i <= outerDim.stop && i < outerDim.size; i += outerDim.stride) {
+                granuleReads.push(*((getDatasetList())[i]), getGranuleTemplateArray());
+
+                if (granuleReads.full()) {
+                    delete bes_timing::elapsedTimeToTransmitStart;
+                    bes_timing::elapsedTimeToTransmitStart = 0;
+                    sendGranuleArray(m, *granuleReads.pop());
+                }
+
+                // Jump forward by the amount we added.
+                nextElementIndex += getGranuleTemplateArray().length();
+            }
+
+            while (!granuleReads.empty()) {
+                delete bes_timing::elapsedTimeToTransmitStart;
+                bes_timing::elapsedTimeToTransmitStart = 0;
+                sendGranuleArray(m, *granuleReads.pop());
+            }
+        }
+        catch (agg_util::AggregationException& ex) {
+            THROW_NCML_PARSE_ERROR(-1, "Got AggregationException while streaming dataset data. The error msg was: "
+                + std::string(ex.what()));
+        }
+#else
         // Traverse the dataset array respecting hyperslab
         for (int i = outerDim.start; i <= outerDim.stop && i < outerDim.size; i += outerDim.stride) {
             AggMemberDataset& dataset = *((getDatasetList())[i]);
 
             try {
-#if USE_LOCAL_TIMEOUT_SCHEME
-                dds.timeout_on();
-#endif
                 Array* pDatasetArray = AggregationUtil::readDatasetArrayDataForAggregation(getGranuleTemplateArray(),
                     name(), dataset, getArrayGetterInterface(), DEBUG_CHANNEL);
-#if USE_LOCAL_TIMEOUT_SCHEME
-                dds.timeout_off();
-#endif
-#if PIPELINING
-                delete bes_timing::elapsedTimeToTransmitStart;
-                bes_timing::elapsedTimeToTransmitStart = 0;
-                m.put_vector_part(pDatasetArray->get_buf(), getGranuleTemplateArray().length(), var()->width(),
-                    var()->type());
-#else
+
                 this->set_value_slice_from_row_major_vector(*pDatasetArray, nextElementIndex);
-#endif
 
                 pDatasetArray->clear_local_data();
             }
@@ -213,6 +232,7 @@ bool ArrayAggregateOnOuterDimension::serialize(libdap::ConstraintEvaluator &eval
             // Jump forward by the amount we added.
             nextElementIndex += getGranuleTemplateArray().length();
         }
+#endif
 
         // If we succeeded, we are at the end of the array!
         NCML_ASSERT_MSG(nextElementIndex == length(), "Logic error:\n"
@@ -163,6 +163,16 @@ ArrayAggregationBase::getArrayGetterInterface() const
     return *(_pArrayGetter.get());
 }
 
+void ArrayAggregationBase::sendGranuleArray(libdap::Marshaller& m, libdap::Array& granuleArray)
+{
+    // For joinExisting the template may have been changed for a later granule,
+    // so use the length of the Array that was read.
+    m.put_vector_part(granuleArray.get_buf(), granuleArray.length(), var()->width(), var()->type());
+
+    // Now that we have sent it - let the memory go!
+    granuleArray.clear_local_data();
+}
+
 void ArrayAggregationBase::duplicate(const ArrayAggregationBase& rhs)
 {
     // Clone the template if it isn't null.
@@ -118,6 +118,11 @@ namespace agg_util
     * but should not delete it, hence the reference. */
     const ArrayGetterInterface& getArrayGetterInterface() const;
 
+    /** Write the values of a granule's Array, read with the constraints
+     * of the granule template, to the Marshaller and then free them.
+     * Used by the pipelined serialize() methods. */
+    void sendGranuleArray(libdap::Marshaller& m, libdap::Array& granuleArray);
+
   protected: // Subclass Interface
 
     /** subclass hook from read() to setup constraints on inner dims correctly */
@@ -40,6 +40,7 @@
 
 #include "AggregationException.h" // agg_util
 #include "AggregationUtil.h" // agg_util
+#include "GranuleReadAhead.h" // agg_util
 #include "NCMLDebug.h"
 
 static const string DEBUG_CHANNEL(NCML_MODULE_DBG_CHANNEL_2);
@@ -161,6 +162,11 @@ bool ArrayJoinExistingAggregation::serialize(libdap::ConstraintEvaluator &eval,
         BESDEBUG("ncml",
             "Aggregating datasets array with outer dimension constraints: " << " start=" << outerDim.start << " stride=" << outerDim.stride << " stop=" << outerDim.stop << endl);
 
+#if PIPELINING
+        // The granules are read ahead of the one being sent
+        GranuleReadAhead granuleReads(name(), getArrayGetterInterface(), DEBUG_CHANNEL);
+#endif
+
         try {
 #if PIPELINING
             // assumes the constraints are already set properly on this
@@ -252,21 +258,22 @@ bool ArrayJoinExistingAggregation::serialize(libdap::ConstraintEvaluator &eval,
                         getArrayGetterInterface(), DEBUG_CHANNEL);
 #endif
 
+#if PIPELINING
+                    // The template is copied, so it can be changed for the next granule
+                    granuleReads.push(const_cast<AggMemberDataset&>(*pCurrDataset), getGranuleTemplateArray());
+                    if (granuleReads.full())
+                        sendGranuleArray(m, *granuleReads.pop());
+#else
                     Array* pDatasetArray = AggregationUtil::readDatasetArrayDataForAggregation(
                         getGranuleTemplateArray(), name(), const_cast<AggMemberDataset&>(*pCurrDataset),
                         getArrayGetterInterface(), DEBUG_CHANNEL);
 #if USE_LOCAL_TIMEOUT_SCHEME
                     dds.timeout_off();
 #endif
-
-#if PIPELINING
-                    m.put_vector_part(pDatasetArray->get_buf(), getGranuleTemplateArray().length(), var()->width(),
-                        var()->type());
-#else
                     this->set_value_slice_from_row_major_vector(*pDatasetArray, nextOutputBufferElementIndex);
-#endif
 
                     pDatasetArray->clear_local_data();
+#endif
 
                     // Jump output buffer index forward by the amount we added.
                     nextOutputBufferElementIndex += getGranuleTemplateArray().length();
@@ -276,6 +283,11 @@ bool ArrayJoinExistingAggregation::serialize(libdap::ConstraintEvaluator &eval,
                         " The granule index " << currDatasetIndex << " was read with constraints and copied into the aggregation output." << endl);
                 } // !currDatasetWasRead
             } // for loop over outerDim
+
+#if PIPELINING
+            while (!granuleReads.empty())
+                sendGranuleArray(m, *granuleReads.pop());
+#endif
         } // end of try
         catch (AggregationException& ex) {
             THROW_NCML_PARSE_ERROR(-1, ex.what());
@@ -0,0 +1,161 @@
+//////////////////////////////////////////////////////////////////////////////
+// This file is part of the "NcML Module" project, a BES module designed
+// to allow NcML files to be used to be used as a wrapper to add
+// AIS to existing datasets of any format.
+//
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// For more information, please also see the main website: http://opendap.org/
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// Please see the files COPYING and COPYRIGHT for more information on the GLPL.
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+/////////////////////////////////////////////////////////////////////////////
+
+#include "config.h"
+
+#include <system_error>
+
+#include <Array.h> // libdap
+
+#include "GranuleReadAhead.h"
+#include "AggMemberDataset.h" // agg_util
+#include "AggregationException.h" // agg_util
+#include "AggregationUtil.h" // agg_util
+
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+#include "NCMLDebug.h"
+
+using libdap::Array;
+using std::endl;
+using std::string;
+
+#define READ_AHEAD_KEY "NCML.Aggregation.ReadAhead"
+#define READ_AHEAD_DEFAULT 4
+
+namespace agg_util {
+
+GranuleReadAhead::GranuleReadAhead(const string &var_name, const ArrayGetterInterface &array_getter,
+    const string &debug_channel) :
+    d_var_name(var_name), d_array_getter(array_getter), d_debug_channel(debug_channel),
+        d_max_reads(get_read_ahead()), d_reads(), d_last(), d_cancelled(new std::atomic<bool>(false))
+{
+}
+
+GranuleReadAhead::~GranuleReadAhead()
+{
+    // The reads hold pointers to the caller's datasets, so don't let any outlive this
+    *d_cancelled = true;
+    for (std::deque<Read>::iterator i = d_reads.begin(), e = d_reads.end(); i != e; ++i)
+        i->result.wait();
+}
+
+/**
+ * @brief The value of NCML.Aggregation.ReadAhead
+ *
+ * The number of granules to read ahead of the one being sent. Zero turns
+ * off the read-ahead.
+ */
+unsigned int GranuleReadAhead::get_read_ahead()
+{
+    static int read_ahead = -1;
+    if (read_ahead < 0) {
+        read_ahead = TheBESKeys::TheKeys()->read_int_key(READ_AHEAD_KEY, READ_AHEAD_DEFAULT);
+        if (read_ahead < 0) read_ahead = 0;
+    }
+
+    return read_ahead;
+}
+
+/**
+ * @brief Start reading a granule
+ *
+ * The granule is read after all those pushed before it.
+ *
+ * @param dataset The granule; must outlive this object
+ * @param constrained_template Constraints for the granule's Array. This is
+ * copied, so the caller can change it for the next granule.
+ */
+void GranuleReadAhead::push(AggMemberDataset &dataset, const Array &constrained_template)
+{
+    NCML_ASSERT(!full());
+
+    std::shared_ptr<Array> tmpl(static_cast<Array*>(const_cast<Array&>(constrained_template).ptr_duplicate()));
+
+    AggMemberDataset *pDataset = &dataset;
+    const ArrayGetterInterface *pGetter = &d_array_getter;
+    string var_name = d_var_name;
+    string debug_channel = d_debug_channel;
+    std::shared_future<Array*> previous = d_last;
+    std::shared_ptr<std::atomic<bool> > cancelled = d_cancelled;
+
+    auto read = [=]() mutable -> Array* {
+        // One read at a time, in order
+        if (previous.valid()) previous.wait();
+        // Drop the reference so the finished reads are not kept in a chain
+        previous = std::shared_future<Array*>();
+        if (*cancelled) return 0;
+
+        Array *array = AggregationUtil::readDatasetArrayDataForAggregation(*tmpl, var_name, *pDataset, *pGetter,
+            debug_channel);
+        tmpl.reset();
+        return array;
+    };
+
+    Read r;
+    r.location = dataset.getLocation();
+    try {
+        r.result = std::async(d_max_reads ? std::launch::async : std::launch::deferred, read).share();
+    }
+    catch (std::system_error &e) {
+        // No thread; read it in pop()
+        BESDEBUG(d_debug_channel, "GranuleReadAhead::push() - Could not start a thread: " << e.what() << endl);
+        r.result = std::async(std::launch::deferred, read).share();
+    }
+
+    d_last = r.result;
+    d_reads.push_back(r);
+}
+
+/**
+ * @brief Get the oldest granule's Array, waiting for it to be read
+ *
+ * The Array belongs to the granule's DDS; call clear_local_data() on it
+ * once its values have been used.
+ *
+ * @return The read Array
+ * @exception AggregationException and the other exceptions thrown while
+ * reading the granule
+ */
+Array *GranuleReadAhead::pop()
+{
+    NCML_ASSERT(!d_reads.empty());
+
+    Read r = d_reads.front();
+    d_reads.pop_front();
+
+    try {
+        return r.result.get();
+    }
+    catch (AggregationException &e) {
+        throw AggregationException(string(e.what()) + " (while reading the dataset at location \"" + r.location + "\")");
+    }
+}
+
+} // namespace agg_util
@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////
+// This file is part of the "NcML Module" project, a BES module designed
+// to allow NcML files to be used to be used as a wrapper to add
+// AIS to existing datasets of any format.
+//
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// For more information, please also see the main website: http://opendap.org/
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// Please see the files COPYING and COPYRIGHT for more information on the GLPL.
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+/////////////////////////////////////////////////////////////////////////////
+
+#ifndef __AGG_UTIL__GRANULE_READ_AHEAD_H__
+#define __AGG_UTIL__GRANULE_READ_AHEAD_H__
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace libdap {
+class Array;
+}
+
+namespace agg_util {
+
+class AggMemberDataset;
+class ArrayGetterInterface;
+
+/**
+ * Read the member datasets of an aggregation ahead of the code that
+ * serializes them.
+ *
+ * The aggregation serialize() methods push() each granule they need, in
+ * output order, and pop() the read Arrays in the same order to send them
+ * with Marshaller::put_vector_part(). Up to NCML.Aggregation.ReadAhead
+ * granules are read while the caller is sending an earlier one, so reading
+ * overlaps writing to the client. At most that many plus one granule slices
+ * are held in memory.
+ *
+ * The granules are read one at a time, in order, on background threads.
+ * The reads go through the BES container and request handler machinery
+ * (see DDSLoader) and the format handlers, none of which are thread-safe,
+ * so two reads never run at the same time. With a read-ahead of zero the
+ * granules are read by pop() in the caller's thread, the original behavior.
+ */
+class GranuleReadAhead {
+private:
+    struct Read {
+        std::shared_future<libdap::Array*> result;
+        std::string location;
+    };
+
+    std::string d_var_name;
+    const ArrayGetterInterface &d_array_getter;
+    std::string d_debug_channel;
+
+    unsigned int d_max_reads;
+    std::deque<Read> d_reads;
+    std::shared_future<libdap::Array*> d_last;
+
+    // Set when the caller gives up so queued reads are skipped
+    std::shared_ptr<std::atomic<bool> > d_cancelled;
+
+    GranuleReadAhead(const GranuleReadAhead &);
+    GranuleReadAhead &operator=(const GranuleReadAhead &);
+
+public:
+    GranuleReadAhead(const std::string &var_name, const ArrayGetterInterface &array_getter,
+        const std::string &debug_channel);
+
+    virtual ~GranuleReadAhead();
+
+    void push(AggMemberDataset &dataset, const libdap::Array &constrained_template);
+    libdap::Array *pop();
+
+    /// @brief True when no more granules should be pushed before calling pop()
+    bool full() const { return d_reads.size() > d_max_reads; }
+
+    /// @brief True when every granule pushed has been popped
+    bool empty() const { return d_reads.empty(); }
+
+    static unsigned int get_read_ahead();
+};
+
+} // namespace agg_util
+
+#endif /* __AGG_UTIL__GRANULE_READ_AHEAD_H__ */
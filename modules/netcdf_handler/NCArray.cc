@@ -56,6 +56,7 @@
 
 #include "NCRequestHandler.h"
 #include "NCArray.h"
+#include "NCFileCache.h"
 #include "NCStructure.h"
 // #include "nc_util.h"
 
@@ -469,8 +470,9 @@ bool NCArray::read()
     if (read_p())  // Nothing to do
         return true;
 
-    int ncid;
-    int errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
     if (errstat != NC_NOERR)
         throw Error(errstat, string("Could not open the dataset's file (") + dataset().c_str() + string(")"));
 
@@ -503,7 +505,7 @@ bool NCArray::read()
             nels, cor, edg, step, has_stride);
     set_read_p(true);
 
-    if (nc_close(ncid) != NC_NOERR)
+    if (file.close() != NC_NOERR)
         throw InternalErr(__FILE__, __LINE__, "Could not close the dataset!");
 
     return true;
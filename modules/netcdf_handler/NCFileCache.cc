@@ -0,0 +1,225 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of nc_handler, a data handler for the OPeNDAP data
+// server.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This software is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config_nc.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <sstream>
+
+#include <netcdf.h>
+
+#include <BESInfo.h>
+#include <BESDebug.h>
+
+#include "NCFileCache.h"
+
+#define MODULE "nc"
+#define prolog std::string("NCFileCache::").append(__func__).append("() - ")
+
+using namespace std;
+
+list<NCFileCache::Entry> NCFileCache::d_entries;
+mutex NCFileCache::d_lock;
+unsigned int NCFileCache::d_max_entries = 0;
+
+unsigned long NCFileCache::d_hits = 0;
+unsigned long NCFileCache::d_misses = 0;
+
+/**
+ * @brief Open a netCDF file read-only
+ *
+ * If the file is already open and has not changed, its ncid is reused.
+ * Each successful call must be matched by a call to release().
+ *
+ * @param path The file
+ * @param ncidp Value-result parameter; the ncid of the open file
+ * @return NC_NOERR or the netCDF error code from nc_open()
+ */
+int NCFileCache::open(const string &path, int *ncidp)
+{
+    struct stat sb;
+    if (d_max_entries == 0 || stat(path.c_str(), &sb) != 0)
+        return nc_open(path.c_str(), NC_NOWRITE, ncidp);   // not cached
+
+    lock_guard<mutex> lock(d_lock);
+
+    for (list<Entry>::iterator i = d_entries.begin(), e = d_entries.end(); i != e; ++i) {
+        if (i->stale || i->path != path)
+            continue;
+
+        if (i->mtime == sb.st_mtime && i->size == sb.st_size && i->inode == sb.st_ino) {
+            ++d_hits;
+            ++i->users;
+            *ncidp = i->ncid;
+            d_entries.splice(d_entries.begin(), d_entries, i);
+            BESDEBUG(MODULE, prolog << "Using the open ncid " << *ncidp << " for " << path << endl);
+            return NC_NOERR;
+        }
+
+        BESDEBUG(MODULE, prolog << path << " has changed; reopening it" << endl);
+        if (i->users == 0) {
+            nc_close(i->ncid);
+            d_entries.erase(i);
+        }
+        else {
+            i->stale = true;
+        }
+        break;
+    }
+
+    ++d_misses;
+
+    int status = nc_open(path.c_str(), NC_NOWRITE, ncidp);
+    if (status != NC_NOERR)
+        return status;
+
+    Entry entry;
+    entry.path = path;
+    entry.mtime = sb.st_mtime;
+    entry.size = sb.st_size;
+    entry.inode = sb.st_ino;
+    entry.ncid = *ncidp;
+    entry.users = 1;
+    entry.stale = false;
+    d_entries.push_front(entry);
+
+    purge_unused();
+
+    return NC_NOERR;
+}
+
+/**
+ * @brief Release a file opened with open()
+ *
+ * The file stays open unless it has changed or the cache is over its size.
+ *
+ * @param ncid The ncid returned by open()
+ * @return NC_NOERR or the netCDF error code from nc_close()
+ */
+int NCFileCache::release(int ncid)
+{
+    {
+        lock_guard<mutex> lock(d_lock);
+
+        for (list<Entry>::iterator i = d_entries.begin(), e = d_entries.end(); i != e; ++i) {
+            if (i->ncid != ncid)
+                continue;
+
+            if (i->users > 0) --i->users;
+
+            int status = NC_NOERR;
+            if (i->users == 0 && i->stale) {
+                status = nc_close(i->ncid);
+                d_entries.erase(i);
+            }
+
+            purge_unused();
+            return status;
+        }
+    }
+
+    // Not cached
+    return nc_close(ncid);
+}
+
+// Close the least recently used files, that are not in use, until the
+// cache is no larger than its maximum size. Call with d_lock held.
+void NCFileCache::purge_unused()
+{
+    list<Entry>::iterator i = d_entries.end();
+    while (d_entries.size() > d_max_entries && i != d_entries.begin()) {
+        --i;
+        if (i->users == 0) {
+            BESDEBUG(MODULE, prolog << "Closing " << i->path << endl);
+            nc_close(i->ncid);
+            i = d_entries.erase(i);
+        }
+    }
+}
+
+/**
+ * @brief Close all of the cached files
+ *
+ * Called when the module is unloaded.
+ */
+void NCFileCache::close_all()
+{
+    lock_guard<mutex> lock(d_lock);
+
+    for (list<Entry>::iterator i = d_entries.begin(), e = d_entries.end(); i != e; ++i)
+        nc_close(i->ncid);
+
+    d_entries.clear();
+}
+
+/**
+ * @brief Set the number of files to keep open
+ *
+ * @param max_entries The number of files; zero turns the cache off
+ */
+void NCFileCache::set_max_entries(unsigned int max_entries)
+{
+    lock_guard<mutex> lock(d_lock);
+
+    d_max_entries = max_entries;
+    purge_unused();
+}
+
+unsigned long NCFileCache::get_hits()
+{
+    lock_guard<mutex> lock(d_lock);
+    return d_hits;
+}
+
+unsigned long NCFileCache::get_misses()
+{
+    lock_guard<mutex> lock(d_lock);
+    return d_misses;
+}
+
+static string ul_to_string(unsigned long value)
+{
+    ostringstream oss;
+    oss << value;
+    return oss.str();
+}
+
+/**
+ * @brief Add the cache's statistics to the 'show status' response
+ *
+ * Registered with BESStatus::add_reporter() by NCModule.
+ *
+ * @param info The response
+ */
+void NCFileCache::status(BESInfo &info)
+{
+    lock_guard<mutex> lock(d_lock);
+
+    info.add_tag("open_files", ul_to_string(d_entries.size()));
+    info.add_tag("max_open_files", ul_to_string(d_max_entries));
+    info.add_tag("open_file_hits", ul_to_string(d_hits));
+    info.add_tag("open_file_misses", ul_to_string(d_misses));
+}
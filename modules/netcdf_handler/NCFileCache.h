@@ -0,0 +1,127 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of nc_handler, a data handler for the OPeNDAP data
+// server.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This software is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef _nc_file_cache_h
+#define _nc_file_cache_h
+
+#include <sys/types.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+
+class BESInfo;
+
+/**
+ * @brief Keep netCDF files open between the reads of their variables
+ *
+ * Building a response opens the file once for the DDS or DAS and then once
+ * for each variable read. For a NetCDF-4 file each nc_open() reads all of
+ * the file's metadata, so this cache keeps up to NC.OpenFileCacheEntries
+ * files open, closing the least recently used one when it's full. A file
+ * is reopened when its modification time, size or inode changes. Zero
+ * entries turns the cache off; the files are then opened and closed as
+ * before.
+ *
+ * The cache is shared by the NC* types, ncdds.cc and ncdas.cc within a
+ * BES process. A file in use (opened but not yet released) is never
+ * closed by the cache. The hits and misses are part of the 'show status'
+ * response.
+ *
+ * Use NCFile to open a file through the cache.
+ */
+class NCFileCache {
+private:
+    struct Entry {
+        std::string path;
+        time_t mtime;
+        off_t size;
+        ino_t inode;
+        int ncid;
+        unsigned int users;
+        bool stale;     // the file changed; close it once it's released
+    };
+
+    static std::list<Entry> d_entries;   // most recently used first
+    static std::mutex d_lock;
+    static unsigned int d_max_entries;
+
+    static unsigned long d_hits;
+    static unsigned long d_misses;
+
+    static void purge_unused();
+
+public:
+    static int open(const std::string &path, int *ncidp);
+    static int release(int ncid);
+    static void close_all();
+
+    static void set_max_entries(unsigned int max_entries);
+    static unsigned int get_max_entries() { return d_max_entries; }
+
+    static unsigned long get_hits();
+    static unsigned long get_misses();
+
+    static void status(BESInfo &info);
+};
+
+/**
+ * @brief A netCDF file opened through NCFileCache
+ *
+ * Use this in place of nc_open() and nc_close(). The file is released when
+ * this object is destroyed, so it is not held open by a read that throws
+ * an exception.
+ */
+class NCFile {
+private:
+    int d_ncid;
+    bool d_open;
+
+    NCFile(const NCFile &);
+    NCFile &operator=(const NCFile &);
+
+public:
+    NCFile() : d_ncid(-1), d_open(false) { }
+    ~NCFile() { if (d_open) NCFileCache::release(d_ncid); }
+
+    /// @brief Open a file read-only; returns a netCDF status code like nc_open()
+    int open(const std::string &path)
+    {
+        int status = NCFileCache::open(path, &d_ncid);
+        d_open = (status == 0); // NC_NOERR
+        return status;
+    }
+
+    /// @brief Release the file; returns a netCDF status code like nc_close()
+    int close()
+    {
+        if (!d_open) return 0;
+        d_open = false;
+        return NCFileCache::release(d_ncid);
+    }
+
+    int ncid() const { return d_ncid; }
+};
+
+#endif // _nc_file_cache_h
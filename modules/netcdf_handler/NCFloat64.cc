@@ -44,6 +44,7 @@ static char rcsid[] not_used ={"$Id$"};
 #include <InternalErr.h>
 
 #include "NCFloat64.h"
+#include "NCFileCache.h"
 
 
 NCFloat64::NCFloat64(const string &n, const string &d) : Float64(n, d)
@@ -91,8 +92,9 @@ NCFloat64::read()
     if (read_p()) // nothing to do here
         return true;
 
-    int ncid, errstat;
-    errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
 
     if (errstat != NC_NOERR)
     {
@@ -128,7 +130,7 @@ NCFloat64::read()
 	flt64 = (dods_float64) dbl;
 	val2buf((void *) &flt64 );
 
-	if (nc_close(ncid) != NC_NOERR)
+	if (file.close() != NC_NOERR)
 	  throw InternalErr(__FILE__, __LINE__, 
 			    "Could not close the dataset!");
     }
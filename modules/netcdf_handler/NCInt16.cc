@@ -45,6 +45,7 @@ static char rcsid[] not_used ={"$Id$"};
 
 #include "NCRequestHandler.h"
 #include "NCInt16.h"
+#include "NCFileCache.h"
 
 
 NCInt16::NCInt16(const string &n, const string &d) : Int16(n, d)
@@ -82,8 +83,9 @@ bool NCInt16::read() {
     if (read_p()) // nothing to do
         return true;
 
-    int ncid, errstat;
-    errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
     if (errstat != NC_NOERR) {
         string err = "Could not open the dataset's file (" + dataset() + ")";
         throw Error(errstat, err);
@@ -131,7 +133,7 @@ bool NCInt16::read() {
     dods_int16 intg16 = (dods_int16) sht;
     val2buf(&intg16);
 
-    if (nc_close(ncid) != NC_NOERR)
+    if (file.close() != NC_NOERR)
         throw InternalErr(__FILE__, __LINE__, "Could not close the dataset!");
 
     return true;
@@ -38,9 +38,11 @@
 #include <BESCatalogDirectory.h>
 #include <BESCatalogList.h>
 #include <BESDebug.h>
+#include <BESStatus.h>
 
 #include "NCModule.h"
 #include "NCRequestHandler.h"
+#include "NCFileCache.h"
 
 using std::endl;
 using std::ostream;
@@ -71,6 +73,8 @@ void NCModule::initialize(const string & modname)
 		BESDEBUG("nc", "    storage already exists, skipping" << endl);
 	}
 
+	BESStatus::add_reporter(modname, NCFileCache::status);
+
 	BESDebug::Register("nc");
 
 	BESDEBUG("nc", "Done Initializing NC module " << modname << endl);
@@ -80,6 +84,8 @@ void NCModule::terminate(const string & modname)
 {
 	BESDEBUG("nc", "Cleaning NC module " << modname << endl);
 
+	BESStatus::remove_reporter(modname);
+
 	BESRequestHandler *rh = BESRequestHandlerList::TheList()->remove_handler(modname);
 	if (rh) delete rh;
 
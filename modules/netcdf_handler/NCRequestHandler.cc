@@ -55,11 +55,14 @@
 #include <BESDMRResponse.h>
 
 #include <ObjMemCache.h>
+#include <SharedObjMemCache.h>
+#include <SharedMetadataCache.h>
 
 #include <InternalErr.h>
 #include <Ancillary.h>
 
 #include "NCRequestHandler.h"
+#include "NCFileCache.h"
 #include "GlobalMetadataStore.h"
 
 #define NC_NAME "nc"
@@ -226,8 +229,17 @@ NCRequestHandler::NCRequestHandler(const string &name) :
     NCRequestHandler::_cache_entries = get_uint_key("NC.CacheEntries", 0);
     NCRequestHandler::_cache_purge_level = get_float_key("NC.CachePurgeLevel", 0.2);
 
+    NCFileCache::set_max_entries(get_uint_key("NC.OpenFileCacheEntries", 8));
+
     if (get_cache_entries()) {  // else it stays at its default of null
-        das_cache = new ObjMemCache(get_cache_entries(), get_cache_purge_level());
+        // Only the DAS is shared between the BES processes; the cached DDS and DMR
+        // objects hold this handler's variables, which the text responses lose.
+        bes::SharedMetadataCache *shared = bes::SharedMetadataCache::get_instance();
+        if (shared)
+            das_cache = new SharedObjMemCache(get_cache_entries(), get_cache_purge_level(), shared, "nc:das:",
+                SharedObjMemCache::serialize_das, SharedObjMemCache::deserialize_das);
+        else
+            das_cache = new ObjMemCache(get_cache_entries(), get_cache_purge_level());
         dds_cache = new ObjMemCache(get_cache_entries(), get_cache_purge_level());
         datadds_cache = new ObjMemCache(get_cache_entries(), get_cache_purge_level());
         dmr_cache = new ObjMemCache(get_cache_entries(), get_cache_purge_level());
@@ -238,6 +250,8 @@ NCRequestHandler::NCRequestHandler(const string &name) :
 
 NCRequestHandler::~NCRequestHandler()
 {
+    NCFileCache::close_all();
+
     delete das_cache;
     delete dds_cache;
     delete datadds_cache;
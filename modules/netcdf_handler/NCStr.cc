@@ -44,6 +44,7 @@ static char rcsid[] not_used = { "$Id$" };
 
 #include <InternalErr.h>
 #include "NCStr.h"
+#include "NCFileCache.h"
 
 #include <debug.h>
 
@@ -86,8 +87,9 @@ bool NCStr::read()
     if (read_p()) //has been done
         return true;
 
-    int ncid, errstat;
-    errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
 
     if (errstat != NC_NOERR) {
         string err = "Could not open the dataset's file (" + dataset() + ")";
@@ -51,6 +51,7 @@ static char rcsid[] not_used ={"$Id$"};
 
 #include "nc_util.h"
 #include "NCStructure.h"
+#include "NCFileCache.h"
 #include "NCArray.h"
 
 BaseType *
@@ -241,8 +242,9 @@ bool NCStructure::read()
     if (read_p()) // nothing to do
         return true;
 
-    int ncid;
-    int errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
     if (errstat != NC_NOERR)
         throw Error(errstat, "Could not open the dataset's file (" + dataset() + ")");
 
@@ -265,7 +267,7 @@ bool NCStructure::read()
 
     set_read_p(true);
 
-    if (nc_close(ncid) != NC_NOERR)
+    if (file.close() != NC_NOERR)
         throw InternalErr(__FILE__, __LINE__, "Could not close the dataset!");
 
     return true;
@@ -37,6 +37,7 @@ static char rcsid[] not_used = { "$Id$" };
 #include <InternalErr.h>
 
 #include "NCUInt16.h"
+#include "NCFileCache.h"
 
 NCUInt16::NCUInt16(const string &n, const string &d) :
     UInt16(n, d)
@@ -75,8 +76,9 @@ bool NCUInt16::read()
     if (read_p()) // nothing to do
         return true;
 
-    int ncid, errstat;
-    errstat = nc_open(dataset().c_str(), NC_NOWRITE, &ncid); /* netCDF id */
+    NCFile file;
+    int errstat = file.open(dataset());
+    int ncid = file.ncid(); /* netCDF id */
     if (errstat != NC_NOERR) {
         string err = "Could not open the dataset's file (" + dataset() + ")";
         throw Error(errstat, err);
@@ -120,7 +122,7 @@ bool NCUInt16::read()
     dods_uint16 uintg16 = (dods_uint16) sht;
     val2buf(&uintg16);
 
-    if (nc_close(ncid) != NC_NOERR)
+    if (file.close() != NC_NOERR)
         throw InternalErr(__FILE__, __LINE__, "Could not close the dataset!");
 
     return true;
@@ -60,6 +60,7 @@
 
 #include "NCRequestHandler.h"
 #include "nc_util.h"
+#include "NCFileCache.h"
 
 #define ATTR_STRING_QUOTE_FIX
 
@@ -553,9 +554,10 @@ void nc_read_dataset_attributes(DAS &das, const string &filename)
 {
     BESDEBUG(MODULE, prolog << "In nc_read_dataset_attributes" << endl);
 
-    int ncid, errstat;
-    errstat = nc_open(filename.c_str(), NC_NOWRITE, &ncid);
+    NCFile file;
+    int errstat = file.open(filename);
     if (errstat != NC_NOERR) throw Error(errstat, "NetCDF handler: Could not open " + filename + ".");
+    int ncid = file.ncid();
 
     // how many variables? how many global attributes?
     int nvars, ngatts;
@@ -687,7 +689,7 @@ void nc_read_dataset_attributes(DAS &das, const string &filename)
         attr_table_ptr->append_attr("Unlimited_Dimension", print_type(datatype), print_rep);
     }
 
-    if (nc_close(ncid) != NC_NOERR) throw InternalErr(__FILE__, __LINE__, "NetCDF handler: Could not close the dataset!");
+    if (file.close() != NC_NOERR) throw InternalErr(__FILE__, __LINE__, "NetCDF handler: Could not close the dataset!");
 
     BESDEBUG(MODULE, prolog << "Exiting nc_read_dataset_attributes" << endl);
 }
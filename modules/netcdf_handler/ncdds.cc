@@ -56,6 +56,7 @@
 
 #include "NCRequestHandler.h"
 #include "nc_util.h"
+#include "NCFileCache.h"
 
 #include "NCInt32.h"
 #include "NCUInt32.h"
@@ -610,12 +611,13 @@ static void read_variables(DDS &dds_table, const string &filename, int ncid, int
 void nc_read_dataset_variables(DDS &dds_table, const string &filename)
 {
     ncopts = 0;
-    int ncid, errstat;
     int nvars;
 
-    errstat = nc_open(filename.c_str(), NC_NOWRITE, &ncid);
+    NCFile file;
+    int errstat = file.open(filename);
     if (errstat != NC_NOERR)
         throw Error(errstat, "Could not open " + filename + ".");
+    int ncid = file.ncid();
 
     // how many variables?
     errstat = nc_inq_nvars(ncid, &nvars);
@@ -628,7 +630,7 @@ void nc_read_dataset_variables(DDS &dds_table, const string &filename)
     // read variables' classes
     read_variables(dds_table, filename, ncid, nvars);
 
-    if (nc_close(ncid) != NC_NOERR)
+    if (file.close() != NC_NOERR)
         throw InternalErr(__FILE__, __LINE__, "ncdds: Could not close the dataset!");
 }
 
@@ -0,0 +1,353 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of nc_handler, a data handler for the OPeNDAP data
+// server.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This is free software; you can redistribute it and/or modify it under the
+// terms of the GNU Lesser General Public License as published by the Free
+// Software Foundation; either version 2.1 of the License, or (at your
+// option) any later version.
+//
+// This software is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+// or FITNESS FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public
+// License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+// Tests for NCFileCache. The response tests are in ../tests.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "config.h"
+
+#include <utime.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <netcdf.h>
+
+#include <GetOpt.h>
+
+#include <BESDebug.h>
+
+#include "NCFileCache.h"
+
+#include "test_config.h"
+
+using namespace CppUnit;
+using namespace std;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+static const string fnoc1 = string(TEST_SRC_DIR) + "/../data/fnoc1.nc";
+static const string bears = string(TEST_SRC_DIR) + "/../data/bears.nc";
+static const string coads = string(TEST_SRC_DIR) + "/../data/coads_climatology.nc";
+
+// A copy of fnoc1.nc whose modification time the tests change
+static const string changing_file = string(TEST_BUILD_DIR) + "/nc_file_cache_test.nc";
+
+static void copy_file(const string &from, const string &to)
+{
+    ifstream in(from.c_str(), ios::binary);
+    ofstream out(to.c_str(), ios::binary);
+    out << in.rdbuf();
+    CPPUNIT_ASSERT(in && out);
+}
+
+static void set_mtime(const string &path, time_t mtime)
+{
+    struct utimbuf times;
+    times.actime = mtime;
+    times.modtime = mtime;
+    CPPUNIT_ASSERT(utime(path.c_str(), &times) == 0);
+}
+
+// Is 'ncid' an open netCDF file?
+static bool is_open(int ncid)
+{
+    int ndims;
+    return nc_inq_ndims(ncid, &ndims) == NC_NOERR;
+}
+
+// Open and then release 'path'; return the ncid it had
+static int open_and_release(const string &path)
+{
+    int ncid;
+    CPPUNIT_ASSERT(NCFileCache::open(path, &ncid) == NC_NOERR);
+    CPPUNIT_ASSERT(NCFileCache::release(ncid) == NC_NOERR);
+    return ncid;
+}
+
+class NCFileCacheTest: public TestFixture {
+private:
+    unsigned int d_max_entries;
+    unsigned long d_hits;
+    unsigned long d_misses;
+
+    unsigned long hits() const { return NCFileCache::get_hits() - d_hits; }
+    unsigned long misses() const { return NCFileCache::get_misses() - d_misses; }
+
+public:
+    NCFileCacheTest() : d_max_entries(0), d_hits(0), d_misses(0)
+    {
+    }
+
+    ~NCFileCacheTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,nc");
+
+        d_max_entries = NCFileCache::get_max_entries();
+        d_hits = NCFileCache::get_hits();
+        d_misses = NCFileCache::get_misses();
+
+        copy_file(fnoc1, changing_file);
+        set_mtime(changing_file, time(0) - 1000);
+    }
+
+    void tearDown()
+    {
+        NCFileCache::close_all();
+        NCFileCache::set_max_entries(d_max_entries);
+
+        remove(changing_file.c_str());
+    }
+
+    CPPUNIT_TEST_SUITE( NCFileCacheTest );
+
+    CPPUNIT_TEST(disabled_test);
+    CPPUNIT_TEST(disable_closes_files_test);
+    CPPUNIT_TEST(hit_test);
+    CPPUNIT_TEST(eviction_order_test);
+    CPPUNIT_TEST(in_use_test);
+    CPPUNIT_TEST(changed_file_test);
+    CPPUNIT_TEST(changed_file_in_use_test);
+    CPPUNIT_TEST(nc_file_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    // With no entries, every open() opens the file and release() closes it
+    void disabled_test()
+    {
+        NCFileCache::set_max_entries(0);
+
+        int first, second;
+        CPPUNIT_ASSERT(NCFileCache::open(fnoc1, &first) == NC_NOERR);
+        CPPUNIT_ASSERT(NCFileCache::open(fnoc1, &second) == NC_NOERR);
+        CPPUNIT_ASSERT(first != second);
+
+        CPPUNIT_ASSERT(NCFileCache::release(first) == NC_NOERR);
+        CPPUNIT_ASSERT(!is_open(first));
+        CPPUNIT_ASSERT(NCFileCache::release(second) == NC_NOERR);
+        CPPUNIT_ASSERT(!is_open(second));
+
+        CPPUNIT_ASSERT_EQUAL(0UL, hits());
+        CPPUNIT_ASSERT_EQUAL(0UL, misses());
+    }
+
+    // Setting the entries to zero closes the files that were kept open
+    void disable_closes_files_test()
+    {
+        NCFileCache::set_max_entries(4);
+
+        int ncid = open_and_release(fnoc1);
+        CPPUNIT_ASSERT(is_open(ncid));
+
+        NCFileCache::set_max_entries(0);
+        CPPUNIT_ASSERT(!is_open(ncid));
+
+        open_and_release(fnoc1);
+        CPPUNIT_ASSERT_EQUAL(0UL, hits());
+        CPPUNIT_ASSERT_EQUAL(1UL, misses());
+    }
+
+    void hit_test()
+    {
+        NCFileCache::set_max_entries(4);
+
+        int ncid = open_and_release(fnoc1);
+        CPPUNIT_ASSERT(is_open(ncid));
+        CPPUNIT_ASSERT_EQUAL(ncid, open_and_release(fnoc1));
+
+        CPPUNIT_ASSERT_EQUAL(1UL, hits());
+        CPPUNIT_ASSERT_EQUAL(1UL, misses());
+    }
+
+    // The least recently used file is closed when the cache is full
+    void eviction_order_test()
+    {
+        NCFileCache::set_max_entries(2);
+
+        int fnoc1_ncid = open_and_release(fnoc1);
+        int bears_ncid = open_and_release(bears);
+        open_and_release(fnoc1);    // bears.nc is now the least recently used
+        int coads_ncid = open_and_release(coads);
+
+        DBG(cerr << "fnoc1: " << fnoc1_ncid << ", bears: " << bears_ncid << ", coads: " << coads_ncid << endl);
+        CPPUNIT_ASSERT(is_open(fnoc1_ncid));
+        CPPUNIT_ASSERT(!is_open(bears_ncid));
+        CPPUNIT_ASSERT(is_open(coads_ncid));
+
+        CPPUNIT_ASSERT_EQUAL(1UL, hits());
+        CPPUNIT_ASSERT_EQUAL(3UL, misses());
+
+        open_and_release(coads);
+        open_and_release(fnoc1);
+        CPPUNIT_ASSERT_EQUAL(3UL, hits());
+
+        open_and_release(bears);
+        CPPUNIT_ASSERT_EQUAL(4UL, misses());
+    }
+
+    // A file in use is not closed, even when the cache is full
+    void in_use_test()
+    {
+        NCFileCache::set_max_entries(1);
+
+        int fnoc1_ncid, bears_ncid;
+        CPPUNIT_ASSERT(NCFileCache::open(fnoc1, &fnoc1_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(NCFileCache::open(bears, &bears_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(is_open(fnoc1_ncid));
+        CPPUNIT_ASSERT(is_open(bears_ncid));
+
+        // Released, fnoc1.nc is the least recently used and is closed
+        CPPUNIT_ASSERT(NCFileCache::release(fnoc1_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(!is_open(fnoc1_ncid));
+        CPPUNIT_ASSERT(is_open(bears_ncid));
+
+        CPPUNIT_ASSERT(NCFileCache::release(bears_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(is_open(bears_ncid));
+    }
+
+    // A file is reopened when its modification time changes
+    void changed_file_test()
+    {
+        NCFileCache::set_max_entries(4);
+
+        open_and_release(changing_file);
+        open_and_release(changing_file);
+        CPPUNIT_ASSERT_EQUAL(1UL, hits());
+        CPPUNIT_ASSERT_EQUAL(1UL, misses());
+
+        set_mtime(changing_file, time(0) - 500);
+        int ncid = open_and_release(changing_file);
+        CPPUNIT_ASSERT_EQUAL(1UL, hits());
+        CPPUNIT_ASSERT_EQUAL(2UL, misses());
+
+        CPPUNIT_ASSERT_EQUAL(ncid, open_and_release(changing_file));
+        CPPUNIT_ASSERT_EQUAL(2UL, hits());
+    }
+
+    // A changed file that's in use stays open until it's released
+    void changed_file_in_use_test()
+    {
+        NCFileCache::set_max_entries(4);
+
+        int old_ncid;
+        CPPUNIT_ASSERT(NCFileCache::open(changing_file, &old_ncid) == NC_NOERR);
+
+        set_mtime(changing_file, time(0) - 500);
+        int new_ncid;
+        CPPUNIT_ASSERT(NCFileCache::open(changing_file, &new_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(new_ncid != old_ncid);
+        CPPUNIT_ASSERT(is_open(old_ncid));
+        CPPUNIT_ASSERT_EQUAL(2UL, misses());
+
+        CPPUNIT_ASSERT(NCFileCache::release(old_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(!is_open(old_ncid));
+        CPPUNIT_ASSERT(NCFileCache::release(new_ncid) == NC_NOERR);
+        CPPUNIT_ASSERT(is_open(new_ncid));
+
+        CPPUNIT_ASSERT_EQUAL(new_ncid, open_and_release(changing_file));
+        CPPUNIT_ASSERT_EQUAL(1UL, hits());
+    }
+
+    // NCFile releases the file when it's destroyed
+    void nc_file_test()
+    {
+        NCFileCache::set_max_entries(0);
+
+        int ncid;
+        {
+            NCFile file;
+            CPPUNIT_ASSERT(file.open(fnoc1) == NC_NOERR);
+            ncid = file.ncid();
+            CPPUNIT_ASSERT(is_open(ncid));
+        }
+        CPPUNIT_ASSERT(!is_open(ncid));
+
+        NCFile missing;
+        CPPUNIT_ASSERT(missing.open(string(TEST_BUILD_DIR) + "/no_such_file.nc") != NC_NOERR);
+        CPPUNIT_ASSERT(missing.close() == NC_NOERR);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(NCFileCacheTest);
+
+int main(int argc, char*argv[])
+{
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: NCFileCacheTest has the following tests:" << endl;
+            const std::vector<Test*> &tests = NCFileCacheTest::suite()->getTests();
+            unsigned int prefix_len = NCFileCacheTest::suite()->getName().append("::").length();
+            for (std::vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = NCFileCacheTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -53,6 +53,7 @@ using std::istringstream;
 
 #include <BESDebug.h>
 #include <BESInternalError.h>
+#include <TextFormatter.h>
 #include <BESContextManager.h>
 #include <BESSyntaxUserError.h>
 
@@ -63,33 +64,44 @@ using std::istringstream;
  *
  */
 template<typename T>
-unsigned int W10nJsonTransform::json_simple_type_array_worker(ostream *strm, T *values,
+unsigned int W10nJsonTransform::json_simple_type_array_worker(bes::TextFormatter &out, const T *values,
     unsigned int indx, vector<unsigned int> *shape, unsigned int currentDim, bool flatten)
 {
-    if (currentDim == 0 || !flatten) *strm << "[";
+    if (currentDim == 0 || !flatten) out.put('[');
 
     unsigned int currentDimSize = (*shape)[currentDim];
 
-    for (unsigned int i = 0; i < currentDimSize; i++) {
-        if (currentDim < shape->size() - 1) {
-            indx = json_simple_type_array_worker<T>(strm, values, indx, shape, currentDim + 1, flatten);
-            if (i + 1 != currentDimSize) *strm << ", ";
+    if (currentDim < shape->size() - 1) {
+        for (unsigned int i = 0; i < currentDimSize; i++) {
+            indx = json_simple_type_array_worker<T>(out, values, indx, shape, currentDim + 1, flatten);
+            if (i + 1 != currentDimSize) out.write(", ", 2);
         }
-        else {
-            if (i) *strm << ", ";
-            if (typeid(T) == typeid(std::string)) {
-                // Strings need to be escaped to be included in a JSON object.
-                // std::string val = ((std::string *) values)[indx++]; replaced w/below jhrg 9/7/16
-                std::string val = reinterpret_cast<std::string*>(values)[indx++];
-                *strm << "\"" << w10n::escape_for_json(val) << "\"";
-            }
-            else {
-                *strm << values[indx++];
-            }
+    }
+    else if (typeid(T) == typeid(std::string)) {
+        for (unsigned int i = 0; i < currentDimSize; i++) {
+            if (i) out.write(", ", 2);
+            // Strings need to be escaped to be included in a JSON object.
+            // std::string val = ((std::string *) values)[indx++]; replaced w/below jhrg 9/7/16
+            const std::string &val = reinterpret_cast<const std::string*>(values)[indx++];
+            out.put('"');
+            out.put(w10n::escape_for_json(val));
+            out.put('"');
         }
     }
+    else if (typeid(T) == typeid(libdap::dods_byte)) {
+        // Byte values have always been written as characters (operator<< on
+        // an unsigned char); keep that so existing responses do not change.
+        for (unsigned int i = 0; i < currentDimSize; i++) {
+            if (i) out.write(", ", 2);
+            out.put(static_cast<char>(values[indx++]));
+        }
+    }
+    else {
+        out.put_values(values + indx, currentDimSize, ", ");
+        indx += currentDimSize;
+    }
 
-    if (currentDim == 0 || !flatten) *strm << "]";
+    if (currentDim == 0 || !flatten) out.put(']');
 
     return indx;
 }
@@ -168,9 +180,11 @@ template<typename T> void W10nJsonTransform::json_simple_type_array_sender(ostre
     vector<unsigned int> shape(numDim);
     long length = w10n::computeConstrainedShape(a, &shape);
 
-    vector<T> src(length);
-    a->value(&src[0]);
-    unsigned int indx = json_simple_type_array_worker(strm, &src[0], 0, &shape, 0, found_w10n_flatten);
+    // Format the values straight from the array's buffer
+    bes::TextFormatter out(*strm);
+    unsigned int indx = json_simple_type_array_worker(out, reinterpret_cast<const T*>(a->get_buf()), 0, &shape, 0,
+        found_w10n_flatten);
+    out.flush();
 
     if (length != indx)
         BESDEBUG(W10N_DEBUG_KEY,
@@ -197,8 +211,9 @@ void W10nJsonTransform::json_string_array_sender(ostream *strm, libdap::Array *a
     // The string type utilizes a specialized version of libdap:Array.value()
     vector<std::string> sourceValues;
     a->value(sourceValues);
-    unsigned int indx = json_simple_type_array_worker(strm, (std::string *) (&sourceValues[0]), 0, &shape, 0,
-        found_w10n_flatten);
+    bes::TextFormatter out(*strm);
+    unsigned int indx = json_simple_type_array_worker(out, sourceValues.data(), 0, &shape, 0, found_w10n_flatten);
+    out.flush();
 
     if (length != indx)
         BESDEBUG(W10N_DEBUG_KEY,
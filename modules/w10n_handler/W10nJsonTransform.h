@@ -42,6 +42,10 @@
 #include <BESObj.h>
 #include <BESDataHandlerInterface.h>
 
+namespace bes {
+class TextFormatter;
+}
+
 /**
  * Used to transform a DDS into a w10n JSON metadata or w10n JSON data document.
  * The output is written to a local file whose name is passed as a parameter
@@ -88,8 +92,8 @@ private:
 
     template<typename T>
     unsigned  int json_simple_type_array_worker(
-    		std::ostream *strm,
-    		T *values,
+    		bes::TextFormatter &out,
+    		const T *values,
     		unsigned int indx,
     		std::vector<unsigned int> *shape,
     		unsigned int currentDim,
@@ -74,6 +74,16 @@ public:
 		return _mySock;
 	}
 
+	/**
+	 * Use a socket that was accepted by another process; the pre-forked
+	 * beslisteners get their client sockets this way. The caller owns the
+	 * Socket.
+	 */
+	virtual void setSocket(Socket *s)
+	{
+		_mySock = s;
+	}
+
 	virtual bool isConnected()
 	{
 		if (_mySock) return _mySock->isConnected();
@@ -33,23 +33,112 @@
 #include "config.h"
 
 #include <sys/types.h>
+#include <sys/uio.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
 
+#include <cerrno>
 #include <cstdio>
+#include <cstring>
 #include <unistd.h> // for sync
-#include <sstream>
-#include <iomanip>
-#include <iostream>
+#include <ios>
+#include <algorithm>
+#include <vector>
 
-using std::ostringstream;
-using std::hex;
-using std::setw;
-using std::setfill;
+using std::min;
+using std::streamsize;
+using std::vector;
 
 #include "PPTStreamBuf.h"
 
 const char* eod_marker = "0000000d";
 const size_t eod_marker_len = 8;
 
+// A chunk header is seven hex digits for the length and 'd' for data, so
+// a chunk holds at most 0xFFFFFFF bytes.
+const size_t chunk_header_len = 8;
+const size_t max_chunk_len = 0xFFFFFFF;
+
+// Read from files in pieces this big when they can't be sent with sendfile()
+const size_t copy_buffer_len = 65536;
+
+/**
+ * Write all of the iovecs, picking up where a partial write stopped.
+ * @return False if write fails.
+ */
+static bool write_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t bytes = writev(fd, iov, iovcnt);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        while (iovcnt > 0 && (size_t) bytes >= iov->iov_len) {
+            bytes -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + bytes;
+            iov->iov_len -= bytes;
+        }
+    }
+
+    return true;
+}
+
+static bool write_all(int fd, const char *data, size_t len)
+{
+    struct iovec iov = { const_cast<char*>(data), len };
+    return write_all(fd, &iov, 1);
+}
+
+/**
+ * Copy len bytes starting at offset in the file in_fd to out_fd. Use
+ * sendfile() when it's available so the data are not copied through this
+ * process. Some kinds of files can't be sent that way; those are read and
+ * written.
+ */
+static bool copy_file(int out_fd, int in_fd, off_t offset, size_t len)
+{
+#ifdef HAVE_SYS_SENDFILE_H
+    while (len > 0) {
+        ssize_t bytes = sendfile(out_fd, in_fd, &offset, len);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EINVAL || errno == ENOSYS) break;
+            return false;
+        }
+        if (bytes == 0) return false;  // the file is shorter than it was
+
+        len -= bytes;
+    }
+
+    if (len == 0) return true;
+#endif
+
+    vector<char> buf(min(len, copy_buffer_len));
+    while (len > 0) {
+        ssize_t bytes = pread(in_fd, &buf[0], min(len, buf.size()), offset);
+        if (bytes < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (bytes == 0) return false;
+
+        if (!write_all(out_fd, &buf[0], bytes)) return false;
+
+        offset += bytes;
+        len -= bytes;
+    }
+
+    return true;
+}
+
 PPTStreamBuf::PPTStreamBuf(int fd, unsigned bufsize) :
     d_bufsize(bufsize), d_buffer(0), count(0)
 {
@@ -73,16 +162,35 @@ void PPTStreamBuf::open(int fd, unsigned bufsize)
     setp(d_buffer, d_buffer + d_bufsize);
 }
 
+/**
+ * Write one chunk made of the buffered bytes followed by data, header and
+ * all, with one system call. The two together must fit in a chunk.
+ */
+bool PPTStreamBuf::write_chunk(const char *buffered, size_t buffered_len, const char *data, size_t data_len)
+{
+    char header[chunk_header_len + 1];
+    snprintf(header, sizeof(header), "%07xd", (unsigned int) (buffered_len + data_len));
+
+    struct iovec iov[3] = {
+        { header, chunk_header_len },
+        { const_cast<char*>(buffered), buffered_len },
+        { const_cast<char*>(data), data_len }
+    };
+
+    if (!write_all(d_fd, iov, 3)) return false;
+
+    count += buffered_len + data_len;
+    return true;
+}
+
 // We're stuck with this return type because this is inherited from stdc++ streambuf. jhrg
+// Returns -1 if the buffered bytes could not be sent, so the stream sets badbit.
 int PPTStreamBuf::sync()
 {
     if (pptr() > pbase()) {
-        ostringstream strm;
-        strm << hex << setw(7) << setfill('0') << (unsigned int) (pptr() - pbase()) << "d";
-        write(d_fd, strm.str().c_str(), strm.str().length());
-
-        count += write(d_fd, d_buffer, pptr() - pbase());
+        bool sent = write_chunk(pbase(), pptr() - pbase(), 0, 0);
         setp(d_buffer, d_buffer + d_bufsize);
+        if (!sent) return -1;
     }
 
     return 0;
@@ -90,7 +198,7 @@ int PPTStreamBuf::sync()
 
 int PPTStreamBuf::overflow(int c)
 {
-    sync();
+    if (sync() == -1) return EOF;
     if (c != EOF) {
         *pptr() = static_cast<char>(c);
         pbump(1);
@@ -98,12 +206,67 @@ int PPTStreamBuf::overflow(int c)
     return c;
 }
 
+/**
+ * Writes smaller than the buffer are buffered. Bigger ones go straight to
+ * the socket, in the same chunk as whatever was buffered, instead of being
+ * copied through the buffer one buffer-full at a time.
+ *
+ * @return The number of bytes sent; less than n if the peer went away.
+ */
+streamsize PPTStreamBuf::xsputn(const char *s, streamsize n)
+{
+    if (n < (streamsize) d_bufsize)
+        return std::streambuf::xsputn(s, n);
+
+    size_t buffered_len = pptr() - pbase();
+    streamsize sent = 0;
+    while (sent < n) {
+        size_t len = min((size_t) (n - sent), max_chunk_len - buffered_len);
+        if (!write_chunk(pbase(), buffered_len, s + sent, len))
+            break;
+        sent += len;
+        buffered_len = 0;
+    }
+
+    setp(d_buffer, d_buffer + d_bufsize);
+
+    return sent;
+}
+
 void PPTStreamBuf::finish()
 {
     sync();
 
-    write(d_fd, eod_marker, eod_marker_len); // tmp_str.c_str(), tmp_str.length() ) ;
+    write_all(d_fd, eod_marker, eod_marker_len);
 
     count = 0;
 }
 
+/**
+ * @brief Send part of a file as PPT chunks
+ *
+ * Anything buffered is sent first. The file's bytes go from the file to
+ * the socket with sendfile() where that's possible.
+ *
+ * @see BESFileSink
+ */
+bool PPTStreamBuf::send_file(int fd, off_t offset, off_t length)
+{
+    sync();
+
+    while (length > 0) {
+        size_t len = min((size_t) length, max_chunk_len);
+
+        char header[chunk_header_len + 1];
+        snprintf(header, sizeof(header), "%07xd", (unsigned int) len);
+        if (!write_all(d_fd, header, chunk_header_len)) return false;
+
+        if (!copy_file(d_fd, fd, offset, len)) return false;
+
+        count += len;
+        offset += len;
+        length -= len;
+    }
+
+    return true;
+}
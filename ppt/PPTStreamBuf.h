@@ -35,7 +35,9 @@
 
 #include <streambuf>
 
-class PPTStreamBuf: public std::streambuf {
+#include "BESFileSink.h"
+
+class PPTStreamBuf: public std::streambuf, public BESFileSink {
 private:
     unsigned d_bufsize;
     int d_fd;
@@ -46,6 +48,12 @@ private:
         d_bufsize(0), d_fd(-1), d_buffer(0), count(0)
     {
     }
+
+    bool write_chunk(const char *buffered, size_t buffered_len, const char *data, size_t data_len);
+
+protected:
+    std::streamsize xsputn(const char *s, std::streamsize n);
+
 public:
     PPTStreamBuf(int fd, unsigned bufsize = 1);
     virtual ~PPTStreamBuf();
@@ -62,6 +70,8 @@ public:
     int overflow(int c);
 
     void finish();
+
+    virtual bool send_file(int fd, off_t offset, off_t length);
 };
 
 #endif // I_PPTStreamBuf_h 1
@@ -33,11 +33,17 @@
 #include "config.h"
 
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "SocketUtilities.h"
+#include "BESInternalError.h"
 
 using std::string;
 
@@ -78,3 +84,89 @@ SocketUtilities::create_temp_name()
     return s ;
 }
 
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+bool
+SocketUtilities::send_fd( int channel, int fd )
+{
+    // Send one byte of data along with the descriptor; some systems will
+    // not pass ancillary data by itself.
+    char byte = 'F' ;
+    struct iovec iov ;
+    iov.iov_base = &byte ;
+    iov.iov_len = 1 ;
+
+    char control[CMSG_SPACE(sizeof(int))] ;
+    memset( control, 0, sizeof(control) ) ;
+
+    struct msghdr msg ;
+    memset( &msg, 0, sizeof(msg) ) ;
+    msg.msg_iov = &iov ;
+    msg.msg_iovlen = 1 ;
+    msg.msg_control = control ;
+    msg.msg_controllen = sizeof(control) ;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg ) ;
+    cmsg->cmsg_level = SOL_SOCKET ;
+    cmsg->cmsg_type = SCM_RIGHTS ;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int)) ;
+    memcpy( CMSG_DATA(cmsg), &fd, sizeof(int) ) ;
+
+    ssize_t sent ;
+    while( (sent = sendmsg( channel, &msg, SEND_FLAGS )) == -1 && errno == EINTR )
+        ;
+
+    if( sent == -1 )
+    {
+        if( errno == EPIPE || errno == ECONNRESET )
+            return false ;
+
+        throw BESInternalError( string("Could not pass a socket to another process: ") + strerror(errno),
+            __FILE__, __LINE__ ) ;
+    }
+
+    return true ;
+}
+
+int
+SocketUtilities::receive_fd( int channel )
+{
+    char byte ;
+    struct iovec iov ;
+    iov.iov_base = &byte ;
+    iov.iov_len = 1 ;
+
+    char control[CMSG_SPACE(sizeof(int))] ;
+    memset( control, 0, sizeof(control) ) ;
+
+    struct msghdr msg ;
+    memset( &msg, 0, sizeof(msg) ) ;
+    msg.msg_iov = &iov ;
+    msg.msg_iovlen = 1 ;
+    msg.msg_control = control ;
+    msg.msg_controllen = sizeof(control) ;
+
+    ssize_t received ;
+    while( (received = recvmsg( channel, &msg, 0 )) == -1 && errno == EINTR )
+        ;
+
+    if( received == 0 )
+        return -1 ;
+
+    if( received == -1 )
+        throw BESInternalError( string("Could not receive a socket from another process: ") + strerror(errno),
+            __FILE__, __LINE__ ) ;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR( &msg ) ;
+    if( !cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS )
+        throw BESInternalError( "Expected a socket from another process, but none was sent.", __FILE__, __LINE__ ) ;
+
+    int fd ;
+    memcpy( &fd, CMSG_DATA(cmsg), sizeof(int) ) ;
+    return fd ;
+}
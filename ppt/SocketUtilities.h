@@ -57,6 +57,28 @@ public:
       * @return uniq name
       */
     static std::string create_temp_name() ;
+
+    /**
+      * Pass an open file descriptor to another process over a Unix
+      * domain socket (SCM_RIGHTS). The receiving process gets its own
+      * descriptor for the same open file; the sender should close its
+      * copy when it no longer needs it.
+      * @param channel A connected Unix domain socket
+      * @param fd The descriptor to pass
+      * @return true if the descriptor was sent, false if the channel is closed
+      * @throws BESInternalError if sendmsg() fails for another reason
+      */
+    static bool send_fd( int channel, int fd ) ;
+
+    /**
+      * Receive a file descriptor sent with send_fd(). Blocks until one
+      * arrives.
+      * @param channel A connected Unix domain socket
+      * @return The new descriptor or -1 if the channel was closed
+      * @throws BESInternalError if recvmsg() fails or the message holds
+      * no descriptor
+      */
+    static int receive_fd( int channel ) ;
 } ;
 
 #endif // SocketUtilities_h
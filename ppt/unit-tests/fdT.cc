@@ -0,0 +1,198 @@
+// fdT.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+using namespace CppUnit;
+using namespace std;
+
+#include "config.h"
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <cstring>
+#include <string>
+#include <iostream>
+
+#include "SocketUtilities.h"
+#include <GetOpt.h>
+
+static bool debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+// Tests for the descriptor passing used by the pre-forked beslisteners
+class fdT: public TestFixture {
+private:
+    int d_channel[2];
+
+public:
+    fdT()
+    {
+    }
+    ~fdT()
+    {
+    }
+
+    void setUp()
+    {
+        CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, d_channel) == 0);
+    }
+
+    void tearDown()
+    {
+        close(d_channel[0]);
+        close(d_channel[1]);
+    }
+
+CPPUNIT_TEST_SUITE( fdT );
+
+    CPPUNIT_TEST( same_process_test );
+    CPPUNIT_TEST( fork_test );
+    CPPUNIT_TEST( closed_channel_test );
+
+    CPPUNIT_TEST_SUITE_END()
+    ;
+
+    // The descriptor received refers to the same open file as the one sent
+    void same_process_test()
+    {
+        int pipe_fds[2];
+        CPPUNIT_ASSERT(pipe(pipe_fds) == 0);
+
+        CPPUNIT_ASSERT(SocketUtilities::send_fd(d_channel[0], pipe_fds[1]));
+        int fd = SocketUtilities::receive_fd(d_channel[1]);
+        DBG(cerr << "sent " << pipe_fds[1] << ", received " << fd << endl);
+        CPPUNIT_ASSERT(fd >= 0);
+        CPPUNIT_ASSERT(fd != pipe_fds[1]);
+        close(pipe_fds[1]);
+
+        CPPUNIT_ASSERT(write(fd, "hello", 5) == 5);
+        close(fd);
+
+        char buf[6];
+        memset(buf, 0, sizeof(buf));
+        CPPUNIT_ASSERT(read(pipe_fds[0], buf, 5) == 5);
+        CPPUNIT_ASSERT_EQUAL(string("hello"), string(buf));
+        close(pipe_fds[0]);
+    }
+
+    // This is how the master beslistener hands a client to a child listener
+    void fork_test()
+    {
+        int client[2];
+        CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, client) == 0);
+
+        pid_t pid = fork();
+        CPPUNIT_ASSERT(pid != -1);
+        if (pid == 0) {
+            close(client[0]);
+            close(client[1]);
+            int fd = SocketUtilities::receive_fd(d_channel[1]);
+            bool ok = fd >= 0 && write(fd, "from the child", 14) == 14;
+            _exit(ok ? 0 : 1);
+        }
+
+        CPPUNIT_ASSERT(SocketUtilities::send_fd(d_channel[0], client[1]));
+        close(client[1]);   // The child now holds the only copy
+
+        char buf[15];
+        memset(buf, 0, sizeof(buf));
+        CPPUNIT_ASSERT(read(client[0], buf, 14) == 14);
+        CPPUNIT_ASSERT_EQUAL(string("from the child"), string(buf));
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+        // The child exited, so the client sees the end of file
+        CPPUNIT_ASSERT(read(client[0], buf, 1) == 0);
+        close(client[0]);
+    }
+
+    void closed_channel_test()
+    {
+        close(d_channel[0]);
+        CPPUNIT_ASSERT_EQUAL(-1, SocketUtilities::receive_fd(d_channel[1]));
+
+        // Sending to a peer that has gone away is not an error
+        CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, d_channel) == 0);
+        close(d_channel[1]);
+        CPPUNIT_ASSERT(!SocketUtilities::send_fd(d_channel[0], 0));
+        d_channel[1] = dup(0);  // for tearDown()
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( fdT );
+
+int main(int argc, char*argv[])
+{
+
+    GetOpt getopt(argc, argv, "dh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: fdT has the following tests:" << endl;
+            const std::vector<Test*> &tests = fdT::suite()->getTests();
+            unsigned int prefix_len = fdT::suite()->getName().append("::").length();
+            for (std::vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = fdT::suite()->getName().append("::").append(argv[i]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+            ++i;
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -43,6 +43,7 @@ using namespace std;
 #endif
 
 #include <fcntl.h>
+#include <signal.h>
 
 #include <string>
 #include <iostream>
@@ -55,6 +56,7 @@ using std::ostringstream;
 
 #include "PPTStreamBuf.h"
 #include "PPTProtocol.h"
+#include "BESUtil.h"
 #include <GetOpt.h>
 
 static bool debug = false;
@@ -91,6 +93,9 @@ public:
 CPPUNIT_TEST_SUITE( sbT );
 
     CPPUNIT_TEST( do_test );
+    CPPUNIT_TEST( large_write_test );
+    CPPUNIT_TEST( send_file_test );
+    CPPUNIT_TEST( closed_peer_test );
 
     CPPUNIT_TEST_SUITE_END()
     ;
@@ -130,6 +135,113 @@ CPPUNIT_TEST_SUITE( sbT );
         cout << "Leaving sbT::run" << endl;
     }
 
+
+    static string read_file(const string &name)
+    {
+        string str;
+        int bytesRead = 0;
+        int fd = open(name.c_str(), O_RDONLY, S_IRUSR);
+        char buffer[4096];
+        while ((bytesRead = read(fd, (char *) buffer, 4096)) > 0) {
+            str.append(buffer, bytesRead);
+        }
+        close(fd);
+        return str;
+    }
+
+    // A write bigger than the buffer goes out in one chunk along with
+    // what was already buffered.
+    void large_write_test()
+    {
+        int fd = open("./sbT.out", O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        PPTStreamBuf fds(fd, 500);
+        std::ostream os(&fds);
+
+        string big(1200, 'x');
+        os << "<1234567890>";
+        os.write(big.data(), big.size());
+        os << "<1234567890>";
+        fds.finish();
+        close(fd);
+
+        string expected = (string) "00004bcd" + "<1234567890>" + big + "000000cd" + "<1234567890>" + "0000000d";
+        string str = read_file("./sbT.out");
+        DBG(cerr << "large_write_test: " << str.substr(0, 40) << "..." << endl);
+        CPPUNIT_ASSERT( str == expected );
+    }
+
+    // Send part of a file through the BESFileSink interface, the way
+    // cached responses are sent.
+    void send_file_test()
+    {
+        string data;
+        for (int u = 0; u < 100; u++) {
+            data += "<1234567890>";
+        }
+
+        int in = open("./sbT.in", O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        CPPUNIT_ASSERT( write(in, data.data(), data.size()) == (ssize_t) data.size() );
+        lseek(in, 12, SEEK_SET);
+
+        int fd = open("./sbT.out", O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        PPTStreamBuf fds(fd, 500);
+        std::ostream os(&fds);
+
+        os << "head";
+        BESUtil::file_to_stream(in, os);
+        CPPUNIT_ASSERT( lseek(in, 0, SEEK_CUR) == (off_t) data.size() );
+        os << "tail";
+        fds.finish();
+        close(fd);
+        close(in);
+        unlink("./sbT.in");
+
+        string expected = (string) "0000004d" + "head" + "00004a4d" + data.substr(12) + "0000004d" + "tail"
+            + "0000000d";
+        string str = read_file("./sbT.out");
+        DBG(cerr << "send_file_test: " << str.substr(0, 40) << "..." << endl);
+        CPPUNIT_ASSERT( str == expected );
+    }
+
+    // Once the peer has gone away, writes fail and the stream says so
+    // instead of sending the rest of a large write.
+    void closed_peer_test()
+    {
+        signal(SIGPIPE, SIG_IGN);
+
+        int fds[2];
+        CPPUNIT_ASSERT( pipe(fds) == 0 );
+        close(fds[0]);
+
+        {
+            PPTStreamBuf sb(fds[1], 500);
+            std::ostream os(&sb);
+            string big(3 * 1024 * 1024, 'x');
+            os.write(big.data(), big.size());
+            CPPUNIT_ASSERT( os.bad() );
+        }
+
+        {
+            PPTStreamBuf sb(fds[1], 500);
+            std::ostream os(&sb);
+            os << "<1234567890>";
+            CPPUNIT_ASSERT( os.good() );
+            os.flush();
+            CPPUNIT_ASSERT( os.bad() );
+        }
+
+        {
+            PPTStreamBuf sb(fds[1], 500);
+            std::ostream os(&sb);
+            for (int u = 0; u < 51; u++) {
+                os << "<1234567890>";
+            }
+            CPPUNIT_ASSERT( os.bad() );
+        }
+
+        close(fds[1]);
+    }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION( sbT );
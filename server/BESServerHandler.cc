@@ -45,6 +45,7 @@
 #include <map>
 
 #include "BESServerHandler.h"
+#include "BESWorkerPool.h"
 #include "Connection.h"
 #include "Socket.h"
 #include "BESXMLInterface.h"
@@ -72,7 +73,28 @@ using std::string;
 // behavior of the server. jhrg 10/4/18
 #define EXIT_ON_INTERNAL_ERROR "BES.ExitOnInternalError"
 
-BESServerHandler::BESServerHandler()
+/**
+ * Send cout to a connection's PPTStreamBuf until the end of a scope. The
+ * buffer is on execute()'s stack, so cout must not hold it once a command
+ * is done, even if sending the response throws; a pre-forked beslistener
+ * goes on to serve other connections.
+ */
+class CoutBufferGuard {
+private:
+    std::streambuf *d_holder;
+
+public:
+    explicit CoutBufferGuard(std::streambuf *buf) : d_holder(cout.rdbuf(buf))
+    {
+    }
+
+    ~CoutBufferGuard()
+    {
+        cout.rdbuf(d_holder);
+    }
+};
+
+BESServerHandler::BESServerHandler() : d_pool(0), d_num_requests(0)
 {
     bool found = false;
     try {
@@ -80,15 +102,46 @@ BESServerHandler::BESServerHandler()
     }
     catch (BESError &e) {
         cerr << "Unable to determine method to handle clients, "
-            << "single or multiple as defined by BES.ProcessManagerMethod" << ": " << e.get_message() << endl;
+            << "single, multiple or prefork as defined by BES.ProcessManagerMethod" << ": " << e.get_message() << endl;
         exit(SERVER_EXIT_FATAL_CANNOT_START);
     }
 
-    if (_method != "multiple" && _method != "single") {
+    if (_method != "multiple" && _method != "single" && _method != "prefork") {
         cerr << "Unable to determine method to handle clients, "
-            << "single or multiple as defined by BES.ProcessManagerMethod" << endl;
+            << "single, multiple or prefork as defined by BES.ProcessManagerMethod" << endl;
         exit(SERVER_EXIT_FATAL_CANNOT_START);
     }
+
+    if (_method == "prefork") {
+        try {
+            d_pool = new BESWorkerPool(this);
+        }
+        catch (BESError &e) {
+            cerr << "Unable to configure the pre-forked beslisteners: " << e.get_message() << endl;
+            exit(SERVER_EXIT_FATAL_CANNOT_START);
+        }
+    }
+}
+
+BESServerHandler::~BESServerHandler()
+{
+    delete d_pool;
+}
+
+/**
+ * @brief Start the pre-forked child listeners
+ *
+ * Does nothing unless BES.ProcessManagerMethod is "prefork". Call this
+ * once the master listener has loaded its modules and registered its
+ * signal handlers so the children inherit all of that.
+ *
+ * @param c The master listener's connection
+ * @param stopping Returns true when the master listener should stop; the
+ * pool checks it while it waits for a busy child
+ */
+void BESServerHandler::start_workers(Connection *c, bool (*stopping)())
+{
+    if (d_pool) d_pool->start(c, stopping);
 }
 
 // I'm not sure that we need to fork twice. jhrg 11/14/05
@@ -105,6 +158,12 @@ void BESServerHandler::handle(Connection *c)
         // client connection and we are done.
         execute(c);
     }
+    // _method is "prefork": hand the connection to one of the child listeners
+    // forked by start_workers(). They serve many connections each and are
+    // replaced after a number of requests (see BESWorkerPool).
+    else if (_method == "prefork") {
+        d_pool->dispatch(c);
+    }
     // _method is "multiple" which means, for each connection request, make a
     // new beslistener daemon. The OLFS can send many commands to each of these
     // before it closes the socket. In theory this should not be necessary, but
@@ -171,6 +230,9 @@ void BESServerHandler::execute(Connection *c)
 
             INFO_LOG("Received exit command." << endl);
 
+            // A pre-forked child listener goes back to the pool for the next connection
+            if (d_pool) return;
+
             exit(CHILD_SUBPROCESS_READY);
         }
 
@@ -191,17 +253,15 @@ void BESServerHandler::execute(Connection *c)
         int descript = c->getSocket()->getSocketDescriptor();
         unsigned int bufsize = c->getSendChunkSize();
         PPTStreamBuf fds(descript, bufsize);
-        std::streambuf *holder;
-        holder = cout.rdbuf();
-        cout.rdbuf(&fds);
+        CoutBufferGuard cout_guard(&fds);
 
         BESXMLInterface cmd(cmd_str, &cout);
         int status = cmd.execute_request(from);
+        ++d_num_requests;
 
         if (status == 0) {
             cmd.finish(status);
             fds.finish();
-            cout.rdbuf(holder);
         }
         else {
             BESDEBUG("server", "BESServerHandler::execute - " << "error occurred" << endl);
@@ -219,8 +279,6 @@ void BESServerHandler::execute(Connection *c)
             cmd.finish(status);
             // we are finished, send the last chunk
             fds.finish();
-            // reset the cout stream buffer
-            cout.rdbuf(holder);
 
             // If the status is fatal, then we want to exit. Otherwise,
             // continue, wait for the next request.
@@ -269,6 +327,8 @@ void BESServerHandler::dump(ostream &strm) const
     strm << BESIndent::LMarg << "BESServerHandler::dump - (" << (void *) this << ")" << endl;
     BESIndent::Indent();
     strm << BESIndent::LMarg << "server method: " << _method << endl;
+    strm << BESIndent::LMarg << "requests: " << d_num_requests << endl;
+    if (d_pool) d_pool->dump(strm);
     BESIndent::UnIndent();
 }
 
@@ -38,6 +38,7 @@
 #include "ServerHandler.h"
 
 class Connection;
+class BESWorkerPool;
 
 /**
  * This class and the ServerApp class are main code for the beslistener.
@@ -48,15 +49,26 @@ class Connection;
 class BESServerHandler: public ServerHandler {
 private:
 	std::string _method;
-    void execute(Connection *c);
+    BESWorkerPool *d_pool;          // Only used when _method is "prefork"
+
+    friend class BESWorkerPool;
+
+protected:
+    unsigned long d_num_requests;   // Commands run by this process
+
+    virtual void execute(Connection *c);
+
 public:
     BESServerHandler();
-    virtual ~BESServerHandler()
-    {
-    }
+    virtual ~BESServerHandler();
 
     virtual void handle(Connection *c);
 
+    void start_workers(Connection *c, bool (*stopping)() = 0);
+
+    /// @brief The number of commands this beslistener has run
+    unsigned long get_num_requests() const { return d_num_requests; }
+
     virtual void dump(std::ostream &strm) const;
 };
 
@@ -0,0 +1,364 @@
+// BESWorkerPool.cc
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include "config.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "BESWorkerPool.h"
+#include "BESServerHandler.h"
+#include "Connection.h"
+#include "Socket.h"
+#include "TcpSocket.h"
+#include "UnixSocket.h"
+#include "SocketUtilities.h"
+#include "TheBESKeys.h"
+#include "BESInternalError.h"
+#include "BESContextManager.h"
+#include "BESContainerStorageList.h"
+#include "BESDefinitionStorageList.h"
+#include "BESSyntaxUserError.h"
+#include "ServerExitConditions.h"
+#include "BESLog.h"
+#include "BESDebug.h"
+
+using std::endl;
+using std::ostream;
+using std::string;
+using std::vector;
+
+#define MODULE "beslistener"
+#define prolog string("BESWorkerPool::").append(__func__).append("() - ")
+
+#define MIN_WORKERS_KEY "BES.PreFork.MinWorkers"
+#define MAX_WORKERS_KEY "BES.PreFork.MaxWorkers"
+#define MAX_REQUESTS_KEY "BES.PreFork.MaxRequests"
+#define MAX_RSS_GROWTH_KEY "BES.PreFork.MaxRSSGrowth"
+
+// How long the master waits for a busy child before it checks whether it
+// should stop, in milliseconds
+#define BUSY_POLL_INTERVAL 1000
+
+BESWorkerPool::BESWorkerPool(BESServerHandler *handler) :
+    d_handler(handler), d_stopping(0), d_min_workers(0), d_max_workers(0), d_max_requests(0), d_max_rss_growth(0)
+{
+    int min_workers = TheBESKeys::TheKeys()->read_int_key(MIN_WORKERS_KEY, 4);
+    int max_workers = TheBESKeys::TheKeys()->read_int_key(MAX_WORKERS_KEY, 32);
+    int max_requests = TheBESKeys::TheKeys()->read_int_key(MAX_REQUESTS_KEY, 1000);
+    int max_rss_growth = TheBESKeys::TheKeys()->read_int_key(MAX_RSS_GROWTH_KEY, 512);
+
+    if (min_workers < 0 || max_workers < 1 || min_workers > max_workers)
+        throw BESSyntaxUserError(string("The values of ") + MIN_WORKERS_KEY + " and " + MAX_WORKERS_KEY
+            + " must satisfy 0 <= min <= max and max >= 1.", __FILE__, __LINE__);
+
+    d_min_workers = min_workers;
+    d_max_workers = max_workers;
+    d_max_requests = max_requests > 0 ? max_requests : 0;           // zero: no limit
+    d_max_rss_growth = max_rss_growth > 0 ? max_rss_growth * 1024L : 0;
+
+    INFO_LOG("Pre-forked beslisteners: " << d_min_workers << " to " << d_max_workers << ", recycled after "
+        << d_max_requests << " requests or " << max_rss_growth << "MB of growth" << endl);
+}
+
+BESWorkerPool::~BESWorkerPool()
+{
+    for (vector<Worker>::iterator i = d_workers.begin(), e = d_workers.end(); i != e; ++i)
+        close(i->channel);
+}
+
+/// The peak resident set size of this process, in KB
+long BESWorkerPool::get_max_rss()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == -1)
+        return 0;
+
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on OSX
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/**
+ * @brief Fork the minimum number of child listeners
+ *
+ * Called by the master beslistener once the modules are loaded, so the
+ * children start with all of the master's state.
+ *
+ * @param c The master's PPTServer; each child serves its connections using
+ * its copy of this.
+ * @param stopping Returns true when the master should stop; dispatch()
+ * gives up waiting for a busy child when it does. May be null.
+ */
+void BESWorkerPool::start(Connection *c, bool (*stopping)())
+{
+    d_stopping = stopping;
+
+    while (d_workers.size() < d_min_workers)
+        spawn(c);
+}
+
+void BESWorkerPool::spawn(Connection *c)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        throw BESInternalError(string("socketpair error: ") + strerror(errno), __FILE__, __LINE__);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        throw BESInternalError(string("fork error: ") + strerror(errno), __FILE__, __LINE__);
+    }
+    else if (pid == 0) { // child
+        close(fds[0]);
+
+        // Otherwise this child would hold the other children's channels
+        // (and the client socket the master is dispatching) open.
+        for (vector<Worker>::iterator i = d_workers.begin(), e = d_workers.end(); i != e; ++i)
+            close(i->channel);
+        d_workers.clear();
+
+        if (c->getSocket()) c->getSocket()->close();
+
+        run_worker(fds[1], c);   // never returns
+    }
+
+    close(fds[1]);
+    d_workers.push_back(Worker(pid, fds[0]));
+
+    BESDEBUG(MODULE, prolog << "Started beslistener " << pid << "; " << d_workers.size() << " in the pool" << endl);
+}
+
+/**
+ * Remove what one client set up so the next starts clean: the contexts
+ * (bes_timeout, xml:base, errors, ...) and the containers and definitions
+ * in the volatile stores.
+ */
+void BESWorkerPool::reset_connection_state()
+{
+    BESContextManager::TheManager()->clear_contexts();
+    BESContainerStorageList::TheList()->delete_volatile_containers();
+    BESDefinitionStorageList::TheList()->delete_volatile_definitions();
+}
+
+/**
+ * The child listener's loop. Wait for the master to pass a client socket,
+ * serve that client until it closes the connection, tell the master this
+ * process is ready and repeat. Exit when it's time to recycle this process
+ * or the master goes away.
+ */
+void BESWorkerPool::run_worker(int channel, Connection *c)
+{
+    long initial_rss = get_max_rss();
+
+    for (;;) {
+        int fd;
+        try {
+            fd = SocketUtilities::receive_fd(channel);
+        }
+        catch (BESError &e) {
+            ERROR_LOG("beslistener " << getpid() << ": " << e.get_message() << endl);
+            exit(SERVER_EXIT_ABNORMAL_TERMINATION);
+        }
+
+        if (fd == -1) // The master listener has exited
+            exit(CHILD_SUBPROCESS_READY);
+
+        struct sockaddr_storage addr;
+        socklen_t len = sizeof(addr);
+        memset(&addr, 0, sizeof(addr));
+        if (getpeername(fd, reinterpret_cast<struct sockaddr *>(&addr), &len) == -1)
+            addr.ss_family = AF_UNIX;   // the client is gone; the first read will fail
+
+        Socket *s;
+        if (addr.ss_family == AF_UNIX)
+            s = new UnixSocket(fd, reinterpret_cast<struct sockaddr *>(&addr));
+        else
+            s = new TcpSocket(fd, reinterpret_cast<struct sockaddr *>(&addr));
+
+        c->setSocket(s);
+        try {
+            d_handler->execute(c);
+        }
+        catch (BESError &e) {
+            // Most often, the client dropped the connection without sending the exit command
+            INFO_LOG("beslistener " << getpid() << ": connection closed: " << e.get_message() << endl);
+        }
+        s->close();
+        delete s;
+        c->setSocket(0);
+
+        if (d_max_requests && d_handler->get_num_requests() >= d_max_requests) {
+            INFO_LOG("beslistener " << getpid() << " served " << d_handler->get_num_requests() << " requests; exiting."
+                << endl);
+            exit(CHILD_SUBPROCESS_READY);
+        }
+
+        if (d_max_rss_growth && get_max_rss() - initial_rss > d_max_rss_growth) {
+            INFO_LOG("beslistener " << getpid() << " grew by " << (get_max_rss() - initial_rss) / 1024 << "MB; exiting."
+                << endl);
+            exit(CHILD_SUBPROCESS_READY);
+        }
+
+        reset_connection_state();
+
+        char ready = 'R';
+        if (write(channel, &ready, 1) != 1)
+            exit(CHILD_SUBPROCESS_READY);
+    }
+}
+
+/**
+ * Read the status of the children. A byte on a channel means that child
+ * is idle; the end of file means it exited, and it is reaped.
+ *
+ * @param timeout Milliseconds to wait for a child; -1 waits until one is
+ * ready or exits.
+ * @return False if no child changed state before the timeout or a signal
+ */
+bool BESWorkerPool::update(int timeout)
+{
+    if (d_workers.empty())
+        return false;
+
+    vector<struct pollfd> fds(d_workers.size());
+    for (vector<Worker>::size_type i = 0; i < d_workers.size(); ++i) {
+        fds[i].fd = d_workers[i].channel;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    int n = poll(&fds[0], fds.size(), timeout);
+    if (n <= 0) // A signal (e.g., SIGCHLD) is not an error; the caller will try again
+        return false;
+
+    vector<Worker> live;
+    for (vector<Worker>::size_type i = 0; i < d_workers.size(); ++i) {
+        Worker &w = d_workers[i];
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            char buf[16];
+            ssize_t bytes = read(w.channel, buf, sizeof(buf));
+            if (bytes <= 0) {
+                BESDEBUG(MODULE, prolog << "beslistener " << w.pid << " exited" << endl);
+                close(w.channel);
+                // Usually the child has exited by now; if not, ServerApp::run() reaps it
+                int status;
+                (void) waitpid(w.pid, &status, WNOHANG);
+                continue;
+            }
+            w.idle = true;
+        }
+        live.push_back(w);
+    }
+
+    d_workers.swap(live);
+
+    return true;
+}
+
+/**
+ * @brief Pass the connection's socket to an idle child listener
+ *
+ * Fork a new child if none are idle and the pool is not full; otherwise
+ * wait for one. The caller closes its copy of the socket.
+ *
+ * @param c The connection, already accepted and welcomed
+ * @return True if a child has the connection, false if the master should
+ * stop and the connection was not passed on
+ */
+bool BESWorkerPool::dispatch(Connection *c)
+{
+    int fd = c->getSocket()->getSocketDescriptor();
+
+    update(0);
+
+    for (;;) {
+        vector<Worker>::iterator w = d_workers.begin();
+        while (w != d_workers.end() && !w->idle)
+            ++w;
+
+        if (w == d_workers.end()) {
+            if (d_workers.size() < d_max_workers) {
+                spawn(c);
+            }
+            else if (!update(BUSY_POLL_INTERVAL) && d_stopping && d_stopping()) {
+                INFO_LOG("All " << d_workers.size() << " beslisteners are busy and the master is stopping; "
+                    "dropping the connection." << endl);
+                return false;
+            }
+            continue;
+        }
+
+        if (SocketUtilities::send_fd(w->channel, fd)) {
+            w->idle = false;
+            BESDEBUG(MODULE, prolog << "Connection passed to beslistener " << w->pid << endl);
+            break;
+        }
+
+        // That child exited after it said it was ready
+        close(w->channel);
+        d_workers.erase(w);
+    }
+
+    // Replace children that have exited
+    while (d_workers.size() < d_min_workers)
+        spawn(c);
+
+    return true;
+}
+
+vector<pid_t> BESWorkerPool::get_pids() const
+{
+    vector<pid_t> pids;
+    for (vector<Worker>::const_iterator i = d_workers.begin(), e = d_workers.end(); i != e; ++i)
+        pids.push_back(i->pid);
+    return pids;
+}
+
+void BESWorkerPool::dump(ostream &strm) const
+{
+    strm << BESIndent::LMarg << "BESWorkerPool::dump - (" << (void *) this << ")" << endl;
+    BESIndent::Indent();
+    strm << BESIndent::LMarg << "min workers: " << d_min_workers << endl;
+    strm << BESIndent::LMarg << "max workers: " << d_max_workers << endl;
+    strm << BESIndent::LMarg << "max requests: " << d_max_requests << endl;
+    strm << BESIndent::LMarg << "max RSS growth (KB): " << d_max_rss_growth << endl;
+    for (vector<Worker>::const_iterator i = d_workers.begin(), e = d_workers.end(); i != e; ++i)
+        strm << BESIndent::LMarg << "beslistener " << i->pid << (i->idle ? ": idle" : ": busy") << endl;
+    BESIndent::UnIndent();
+}
@@ -0,0 +1,103 @@
+// BESWorkerPool.h
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#ifndef BESWorkerPool_h
+#define BESWorkerPool_h 1
+
+#include <sys/types.h>
+
+#include <vector>
+
+#include "BESObj.h"
+
+class Connection;
+class BESServerHandler;
+
+/**
+ * @brief Pre-forked beslistener processes
+ *
+ * With BES.ProcessManagerMethod=prefork, the master beslistener forks a
+ * pool of child listeners and hands each accepted client connection to an
+ * idle child, passing the socket over a Unix domain socket (SCM_RIGHTS).
+ * The children inherit the master's loaded modules and configuration, and
+ * serve one connection after another, so their caches stay warm and there
+ * is no fork() per connection.
+ *
+ * A child is replaced once it has served BES.PreFork.MaxRequests commands
+ * or its resident set has grown by more than BES.PreFork.MaxRSSGrowth MB;
+ * this bounds the damage done by handlers that leak memory. The pool keeps
+ * at least BES.PreFork.MinWorkers children and, when all of them are busy,
+ * forks more up to BES.PreFork.MaxWorkers. When that many are busy, new
+ * connections wait for one to become idle.
+ *
+ * Before it takes another connection, a child removes the contexts,
+ * containers and definitions the last client made, so each connection
+ * starts the way it would in a newly forked beslistener.
+ *
+ * Each child writes a byte to its channel when it is ready for another
+ * connection; the master sees a child that has exited as the end of file
+ * on its channel and reaps it. While every child is busy the master waits
+ * for one, but checks whether it should stop (e.g., it was sent SIGTERM)
+ * at least once a second.
+ */
+class BESWorkerPool: public BESObj {
+private:
+    struct Worker {
+        pid_t pid;
+        int channel;    // master's end of the socketpair
+        bool idle;
+
+        Worker(pid_t p, int c) : pid(p), channel(c), idle(true) { }
+    };
+
+    BESServerHandler *d_handler;
+    std::vector<Worker> d_workers;
+    bool (*d_stopping)();
+
+    unsigned int d_min_workers;
+    unsigned int d_max_workers;
+    unsigned long d_max_requests;
+    long d_max_rss_growth;  // KB
+
+    void spawn(Connection *c);
+    void run_worker(int channel, Connection *c);
+    bool update(int timeout);
+
+    static long get_max_rss();
+    static void reset_connection_state();
+
+public:
+    BESWorkerPool(BESServerHandler *handler);
+    virtual ~BESWorkerPool();
+
+    void start(Connection *c, bool (*stopping)() = 0);
+    bool dispatch(Connection *c);
+
+    /// @brief The process ids of the child listeners
+    std::vector<pid_t> get_pids() const;
+
+    virtual void dump(std::ostream &strm) const;
+};
+
+#endif // BESWorkerPool_h
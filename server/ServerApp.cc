@@ -67,6 +67,7 @@ using std::string;
 #include "PPTServer.h"
 #include "BESMemoryManager.h"
 #include "BESDebug.h"
+#include "BESMetrics.h"
 #include "BESCatalogUtils.h"
 #include "BESServerUtils.h"
 
@@ -211,6 +212,13 @@ static void CatchSigTerm(int sig)
     }
 }
 
+// The pre-forked beslisteners' pool checks this while it waits for a busy
+// child, so the master still stops or restarts when every child is busy.
+static bool master_stopping()
+{
+    return sigterm || sighup;
+}
+
 /** Register the signal handlers. This registers handlers for HUP, TERM and
  *  CHLD. For each, if this OS supports restarting 'slow' system calls, enable
  *  that. For the TERM and HUP handlers, block SIGCHLD for the duration of
@@ -450,6 +458,10 @@ int ServerApp::initialize(int argc, char **argv)
     int ret = BESModuleApp::initialize(argc, argv);
     BESDEBUG("beslistener", "beslistener: done initializing loaded modules" << endl);
 
+    // Map the metrics' shared memory now, so the children forked to serve
+    // connections all add to the same series.
+    BESMetrics::TheMetrics();
+
     BESDEBUG("beslistener", "beslistener: initialized settings:" << *this);
 
     if (needhelp) {
@@ -511,6 +523,9 @@ int ServerApp::run()
 
         register_signal_handlers();
 
+        // With BES.ProcessManagerMethod=prefork, fork the child listeners now
+        handler.start_workers(_ps, master_stopping);
+
         // Loop forever, processing signals and running the code in PPTServer::initConnection().
         // NB: The code in initConnection() used to loop forever, but I moved that out to here
         // so the signal handlers could be in this class. The PPTServer::initConnection() method
@@ -0,0 +1,437 @@
+// -*- mode: c++; c-basic-offset:4 -*-
+
+// This file is part of bes, A C++ back-end server implementation framework
+// for the OPeNDAP Data Access Protocol.
+
+// Copyright (c) 2021 OPeNDAP, Inc.
+// Author: James Gallagher <jgallagher@opendap.org>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+//
+// You can contact OPeNDAP, Inc. at PO Box 112, Saunderstown, RI. 02874-0112.
+
+#include <cppunit/TextTestRunner.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "config.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <GetOpt.h>
+
+#include "BESWorkerPool.h"
+#include "BESServerHandler.h"
+#include "Connection.h"
+#include "UnixSocket.h"
+#include "BESContextManager.h"
+#include "BESContainerStorageList.h"
+#include "BESContainerStorageVolatile.h"
+#include "BESContainer.h"
+#include "BESDebug.h"
+#include "TheBESKeys.h"
+
+#include "test_config.h"
+
+using namespace std;
+using namespace CppUnit;
+
+static bool debug = false;
+static bool bes_debug = false;
+
+#undef DBG
+#define DBG(x) do { if (debug) (x); } while(false);
+
+#define TEST_STORE "volatile"
+
+/**
+ * Stands in for the master's PPTServer; the pool only uses its socket.
+ */
+class TestConnection: public Connection {
+protected:
+    virtual void send(const string &)
+    {
+    }
+    virtual void sendChunk(const string &, map<string, string> &)
+    {
+    }
+
+public:
+    virtual void initConnection()
+    {
+    }
+    virtual void closeConnection()
+    {
+    }
+    virtual string exit()
+    {
+        return "";
+    }
+    virtual void send(const string &, map<string, string> &)
+    {
+    }
+    virtual void sendExtensions(map<string, string> &)
+    {
+    }
+    virtual void sendExit()
+    {
+    }
+    virtual bool receive(map<string, string> &, ostream * = 0)
+    {
+        return true;
+    }
+    virtual unsigned int getRecvChunkSize()
+    {
+        return 0;
+    }
+    virtual unsigned int getSendChunkSize()
+    {
+        return 0;
+    }
+};
+
+/**
+ * Serves a client in place of the PPT protocol. For each command the reply
+ * is the child's pid, the value of the context 'test' and whether the
+ * container 'test_container' is defined. The command 'set' then sets both,
+ * 'grow' touches 64MB of memory and 'bye' ends the connection. Children
+ * forked while a client is connected hold a copy of its end of the socket
+ * pair, so the end of file cannot be relied on.
+ */
+class TestHandler: public BESServerHandler {
+protected:
+    virtual void execute(Connection *c)
+    {
+        int fd = c->getSocket()->getSocketDescriptor();
+        char buf[256];
+        for (;;) {
+            ssize_t n = read(fd, buf, sizeof(buf) - 1);
+            if (n <= 0) return;
+            buf[n] = '\0';
+            string cmd(buf);
+            if (cmd == "bye") return;
+            ++d_num_requests;
+
+            bool found = false;
+            string context = BESContextManager::TheManager()->get_context("test", found);
+            BESContainerStorage *store = BESContainerStorageList::TheList()->find_persistence(TEST_STORE);
+            BESContainer *container = store->look_for("test_container");
+            bool has_container = container != 0;
+            delete container;
+
+            if (cmd == "set") {
+                BESContextManager::TheManager()->set_context("test", "value");
+                store->add_container("test_container", "WorkerPoolTest.cc", "test");
+            }
+            else if (cmd == "grow") {
+                static vector<char> ballast;
+                ballast.assign(64 * 1024 * 1024, 'x');
+            }
+
+            ostringstream reply;
+            reply << getpid() << " " << (found ? context : "-") << " " << (has_container ? "container" : "-");
+            if (write(fd, reply.str().data(), reply.str().size()) < 0) return;
+        }
+    }
+};
+
+static bool stopping_flag = false;
+
+static bool stopping()
+{
+    return stopping_flag;
+}
+
+class WorkerPoolTest: public TestFixture {
+private:
+    TestHandler *d_handler;
+    BESWorkerPool *d_pool;
+    TestConnection d_conn;
+
+    void make_pool(const string &min_workers, const string &max_workers, const string &max_requests,
+        const string &max_rss_growth = "0")
+    {
+        TheBESKeys::TheKeys()->set_key("BES.PreFork.MinWorkers", min_workers);
+        TheBESKeys::TheKeys()->set_key("BES.PreFork.MaxWorkers", max_workers);
+        TheBESKeys::TheKeys()->set_key("BES.PreFork.MaxRequests", max_requests);
+        TheBESKeys::TheKeys()->set_key("BES.PreFork.MaxRSSGrowth", max_rss_growth);
+
+        d_pool = new BESWorkerPool(d_handler);
+        d_pool->start(&d_conn, stopping);
+    }
+
+    // Open a connection and pass it to the pool; returns the client's end
+    int connect(bool expect_dispatched = true)
+    {
+        int fds[2];
+        CPPUNIT_ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        UnixSocket *s = new UnixSocket(fds[1], reinterpret_cast<struct sockaddr *>(&addr));
+
+        d_conn.setSocket(s);
+        bool dispatched = d_pool->dispatch(&d_conn);
+        d_conn.setSocket(0);
+        s->close();     // as PPTServer::initConnection() does
+        delete s;
+
+        CPPUNIT_ASSERT(dispatched == expect_dispatched);
+        return fds[0];
+    }
+
+    static string ask(int fd, const string &cmd)
+    {
+        CPPUNIT_ASSERT(write(fd, cmd.data(), cmd.size()) == (ssize_t) cmd.size());
+        char buf[256];
+        ssize_t n = read(fd, buf, sizeof(buf) - 1);
+        CPPUNIT_ASSERT(n > 0);
+        buf[n] = '\0';
+        DBG(cerr << cmd << ": " << buf << endl);
+        return buf;
+    }
+
+    static void hangup(int fd)
+    {
+        CPPUNIT_ASSERT(write(fd, "bye", 3) == 3);
+        close(fd);
+    }
+
+    // One command on its own connection
+    string request(const string &cmd)
+    {
+        int fd = connect();
+        string reply = ask(fd, cmd);
+        hangup(fd);
+        return reply;
+    }
+
+    static pid_t pid_of(const string &reply)
+    {
+        return atoi(reply.c_str());
+    }
+
+public:
+    WorkerPoolTest() : d_handler(0), d_pool(0)
+    {
+    }
+
+    ~WorkerPoolTest()
+    {
+    }
+
+    void setUp()
+    {
+        if (bes_debug) BESDebug::SetUp("cerr,beslistener");
+
+        TheBESKeys::ConfigFile = string(TEST_SRC_DIR).append("/worker_pool_test.ini");
+        TheBESKeys::TheKeys()->set_key("BES.Data.RootDirectory", TEST_SRC_DIR);
+        if (!BESContainerStorageList::TheList()->find_persistence(TEST_STORE))
+            BESContainerStorageList::TheList()->add_persistence(new BESContainerStorageVolatile(TEST_STORE));
+
+        stopping_flag = false;
+        d_handler = new TestHandler;
+    }
+
+    void tearDown()
+    {
+        // Closing the channels tells the children to exit
+        delete d_pool;
+        d_pool = 0;
+        delete d_handler;
+        d_handler = 0;
+
+        // Reap them, and the ones that were recycled, like ServerApp::run()
+        int status;
+        while (waitpid(-1, &status, 0) > 0)
+            ;
+    }
+
+    CPPUNIT_TEST_SUITE( WorkerPoolTest );
+
+    CPPUNIT_TEST(start_test);
+    CPPUNIT_TEST(connection_state_test);
+    CPPUNIT_TEST(busy_spawn_test);
+    CPPUNIT_TEST(max_requests_test);
+    CPPUNIT_TEST(max_rss_test);
+    CPPUNIT_TEST(dead_worker_test);
+    CPPUNIT_TEST(stopping_test);
+
+    CPPUNIT_TEST_SUITE_END();
+
+    void start_test()
+    {
+        make_pool("2", "4", "0");
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, d_pool->get_pids().size());
+    }
+
+    // What one client sets is gone when the same child serves the next
+    void connection_state_test()
+    {
+        make_pool("1", "1", "0");
+
+        int fd = connect();
+        string first = ask(fd, "set");
+        // Within a connection, the state persists
+        string second = ask(fd, "get");
+        hangup(fd);
+        CPPUNIT_ASSERT_EQUAL(string(" value container"), second.substr(second.find(' ')));
+
+        string next = request("get");
+        CPPUNIT_ASSERT_EQUAL(pid_of(first), pid_of(next));
+        CPPUNIT_ASSERT_EQUAL(string(" - -"), next.substr(next.find(' ')));
+    }
+
+    // When every child is busy and the pool is not full, another is forked
+    void busy_spawn_test()
+    {
+        make_pool("1", "2", "0");
+
+        int busy = connect();
+        pid_t busy_pid = pid_of(ask(busy, "get"));
+
+        pid_t other = pid_of(request("get"));
+        CPPUNIT_ASSERT(other != busy_pid);
+        CPPUNIT_ASSERT_EQUAL((size_t) 2, d_pool->get_pids().size());
+
+        hangup(busy);
+    }
+
+    // A child that has run MaxRequests commands is replaced
+    void max_requests_test()
+    {
+        make_pool("1", "1", "2");
+
+        pid_t first = pid_of(request("get"));
+        CPPUNIT_ASSERT_EQUAL(first, pid_of(request("get")));
+
+        pid_t replacement = pid_of(request("get"));
+        CPPUNIT_ASSERT(replacement != first);
+        CPPUNIT_ASSERT_EQUAL((size_t) 1, d_pool->get_pids().size());
+    }
+
+    // A child that has grown by more than MaxRSSGrowth MB is replaced
+    void max_rss_test()
+    {
+        make_pool("1", "1", "0", "16");
+
+        pid_t first = pid_of(request("get"));
+        CPPUNIT_ASSERT_EQUAL(first, pid_of(request("grow")));
+
+        pid_t replacement = pid_of(request("get"));
+        CPPUNIT_ASSERT(replacement != first);
+    }
+
+    // A child that was killed is replaced and the connection goes to a live one
+    void dead_worker_test()
+    {
+        make_pool("1", "1", "0");
+
+        pid_t first = pid_of(request("get"));
+        CPPUNIT_ASSERT(kill(first, SIGKILL) == 0);
+        int status;
+        waitpid(first, &status, 0);
+
+        string reply = request("get");
+        CPPUNIT_ASSERT(pid_of(reply) != first);
+        CPPUNIT_ASSERT_EQUAL(string(" - -"), reply.substr(reply.find(' ')));
+    }
+
+    // When the pool is full and busy, dispatch() gives up once the master is stopping
+    void stopping_test()
+    {
+        make_pool("1", "1", "0");
+
+        int busy = connect();
+        ask(busy, "get");
+
+        stopping_flag = true;
+        time_t start = time(0);
+        int fd = connect(false);
+        CPPUNIT_ASSERT(time(0) - start < 5);
+
+        // The client's connection was dropped
+        char c;
+        CPPUNIT_ASSERT(read(fd, &c, 1) == 0);
+
+        close(fd);
+        hangup(busy);
+    }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(WorkerPoolTest);
+
+int main(int argc, char*argv[])
+{
+    // A write to a child that was killed must not end the test
+    signal(SIGPIPE, SIG_IGN);
+
+    GetOpt getopt(argc, argv, "dbh");
+    int option_char;
+    while ((option_char = getopt()) != EOF)
+        switch (option_char) {
+        case 'd':
+            debug = 1;  // debug is a static global
+            break;
+        case 'b':
+            bes_debug = 1;  // debug is a static global
+            break;
+        case 'h': {     // help - show test names
+            cerr << "Usage: WorkerPoolTest has the following tests:" << endl;
+            const vector<Test*> &tests = WorkerPoolTest::suite()->getTests();
+            unsigned int prefix_len = WorkerPoolTest::suite()->getName().append("::").length();
+            for (vector<Test*>::const_iterator i = tests.begin(), e = tests.end(); i != e; ++i) {
+                cerr << (*i)->getName().replace(0, prefix_len, "") << endl;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+
+    CppUnit::TextTestRunner runner;
+    runner.addTest(CppUnit::TestFactoryRegistry::getRegistry().makeTest());
+
+    bool wasSuccessful = true;
+    string test = "";
+    int i = getopt.optind;
+    if (i == argc) {
+        // run them all
+        wasSuccessful = runner.run("");
+    }
+    else {
+        while (i < argc) {
+            if (debug) cerr << "Running " << argv[i] << endl;
+            test = WorkerPoolTest::suite()->getName().append("::").append(argv[i++]);
+            wasSuccessful = wasSuccessful && runner.run(test);
+        }
+    }
+
+    return wasSuccessful ? 0 : 1;
+}
@@ -85,6 +85,7 @@ int BESXMLDefaultCommands::initialize(int, char**)
 #endif
     BESXMLCommand::add_command( VERS_RESPONSE_STR, BESXMLShowCommand::CommandBuilder);
     BESXMLCommand::add_command( STATUS_RESPONSE_STR, BESXMLShowCommand::CommandBuilder);
+    BESXMLCommand::add_command( METRICS_RESPONSE_STR, BESXMLShowCommand::CommandBuilder);
     BESXMLCommand::add_command( SERVICE_RESPONSE_STR, BESXMLShowCommand::CommandBuilder);
 
     BESXMLCommand::add_command( SET_CONTEXT_STR, BESXMLSetContextCommand::CommandBuilder);
@@ -142,6 +143,7 @@ int BESXMLDefaultCommands::terminate(void)
 #endif
     BESXMLCommand::del_command( VERS_RESPONSE_STR);
     BESXMLCommand::del_command( STATUS_RESPONSE_STR);
+    BESXMLCommand::del_command( METRICS_RESPONSE_STR);
 
     BESXMLCommand::del_command( SET_CONTEXT_STR);
     BESXMLCommand::del_command( SET_CONTEXTS_STR);
@@ -48,6 +48,7 @@ using namespace std;
 #include "BESReturnManager.h"
 #include "BESInfo.h"
 #include "BESStopWatch.h"
+#include "BESTrace.h"
 #include "TheBESKeys.h"
 
 #include "BESDebug.h"
@@ -75,6 +76,8 @@ BESXMLInterface::~BESXMLInterface()
  */
 void BESXMLInterface::build_data_request_plan()
 {
+    BESTraceSpan span("BESXMLInterface::build_data_request_plan");
+
     BESDEBUG("bes", prolog << "BEGIN" << endl);
     BESDEBUG("bes", prolog << "Building request plan for xml document: " << endl << d_xml_document << endl);
 
@@ -310,7 +313,11 @@ void BESXMLInterface::execute_data_request_plan()
             throw BESInternalError(string("The response handler '") + d_dhi_ptr->action + "' does not exist", __FILE__,
             __LINE__);
 
-        d_dhi_ptr->response_handler->execute(*d_dhi_ptr);
+        {
+            BESTraceSpan span("BESResponseHandler::execute");
+            span.set_attribute("bes.action", d_dhi_ptr->action);
+            d_dhi_ptr->response_handler->execute(*d_dhi_ptr);
+        }
 
         transmit_data();    // TODO move method body in here? jhrg 11/8/17
 
@@ -332,6 +339,8 @@ void BESXMLInterface::execute_data_request_plan()
  */
 void BESXMLInterface::transmit_data()
 {
+    BESTraceSpan span("BESXMLInterface::transmit_data");
+
     if (d_dhi_ptr->error_info) {
         VERBOSE(d_dhi_ptr->data[SERVER_PID] << " from " << d_dhi_ptr->data[REQUEST_FROM] << " ["
                 << d_dhi_ptr->data[LOG_INFO] << "] Error" << endl);